@@ -0,0 +1,63 @@
+#include "circuit_breaker.h"
+#include <algorithm>
+
+namespace EvoSpark {
+
+bool CircuitBreaker::Allow(int64_t now_ms) {
+    switch (state_) {
+        case State::CLOSED:
+            return true;
+        case State::OPEN:
+            if (now_ms - opened_at_ms_ < open_ms_) {
+                return false;
+            }
+            state_ = State::HALF_OPEN;
+            probe_in_flight_ = true;
+            return true;
+        case State::HALF_OPEN:
+            if (probe_in_flight_) {
+                return false;
+            }
+            probe_in_flight_ = true;
+            return true;
+    }
+    return true;
+}
+
+void CircuitBreaker::RecordSuccess() {
+    state_ = State::CLOSED;
+    failures_ = 0;
+    open_ms_ = base_open_ms_;
+    probe_in_flight_ = false;
+}
+
+void CircuitBreaker::RecordFailure(int64_t now_ms) {
+    if (state_ == State::HALF_OPEN) {
+        // 探测失败：重新打开，冷却时间翻倍
+        open_ms_ = std::min(open_ms_ * 2, MAX_OPEN_MS);
+        Trip(now_ms);
+        return;
+    }
+    failures_++;
+    if (state_ == State::CLOSED && failures_ >= failure_threshold_) {
+        Trip(now_ms);
+    }
+}
+
+void CircuitBreaker::Trip(int64_t now_ms) {
+    state_ = State::OPEN;
+    opened_at_ms_ = now_ms;
+    probe_in_flight_ = false;
+    trips_++;
+}
+
+const char* CircuitStateToString(CircuitBreaker::State state) {
+    switch (state) {
+        case CircuitBreaker::State::CLOSED: return "closed";
+        case CircuitBreaker::State::OPEN: return "open";
+        case CircuitBreaker::State::HALF_OPEN: return "half_open";
+        default: return "unknown";
+    }
+}
+
+} // namespace EvoSpark
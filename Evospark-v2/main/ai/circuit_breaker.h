@@ -0,0 +1,50 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <cstdint>
+
+namespace EvoSpark {
+
+// 熔断器（每个端点一个，非线程安全，由持有者加锁）
+//
+// 连续 failure_threshold 次暂时性失败后打开，冷却 open_ms 内直接拒绝，
+// 请求立刻转向备用模型或快速失败，不在已知坏掉的端点上空等超时。冷却期
+// 过后进入半开状态，只放行一个探测请求：成功则关闭，失败则重新打开，
+// 冷却时间翻倍（不超过 MAX_OPEN_MS）。
+class CircuitBreaker {
+public:
+    enum class State { CLOSED, OPEN, HALF_OPEN };
+
+    explicit CircuitBreaker(uint32_t failure_threshold = 4, uint32_t open_ms = 15000)
+        : failure_threshold_(failure_threshold), base_open_ms_(open_ms), open_ms_(open_ms) {}
+
+    // 是否放行一个请求；放行半开探测后，在结果回报前不再放行
+    bool Allow(int64_t now_ms);
+
+    void RecordSuccess();
+    void RecordFailure(int64_t now_ms);
+
+    State GetState() const { return state_; }
+    uint32_t ConsecutiveFailures() const { return failures_; }
+    uint32_t Trips() const { return trips_; }
+
+    static constexpr uint32_t MAX_OPEN_MS = 120000;
+
+private:
+    void Trip(int64_t now_ms);
+
+    uint32_t failure_threshold_;
+    uint32_t base_open_ms_;
+    uint32_t open_ms_;
+    State state_ = State::CLOSED;
+    uint32_t failures_ = 0;
+    uint32_t trips_ = 0;                // 打开次数（统计用）
+    int64_t opened_at_ms_ = 0;
+    bool probe_in_flight_ = false;
+};
+
+const char* CircuitStateToString(CircuitBreaker::State state);
+
+} // namespace EvoSpark
+
+#endif // CIRCUIT_BREAKER_H
@@ -1,14 +1,202 @@
 #include "llm_client.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "esp_crt_bundle.h"
-#include <sstream>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "sse_parser.h"
+#include "completion_parser.h"
+#include "memory_index.h"
+#include "base64.h"
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
 
 namespace EvoSpark {
 
 static const char* TAG = "LLMClient";
 
+namespace {
+
+void ApplyUsage(const CompletionUsage& usage, LLMResponse& response) {
+    if (!usage.present) {
+        return;
+    }
+    response.tokens_used = usage.total_tokens;
+    response.prompt_tokens = usage.prompt_tokens;
+    response.completion_tokens = usage.completion_tokens;
+    response.cached_tokens = usage.cached_tokens;
+}
+
+int64_t NowMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+void CountError(TransportStats& stats, LLMError error) {
+    switch (error) {
+        case LLMError::NETWORK: stats.network_errors++; break;
+        case LLMError::RATE_LIMITED: stats.rate_limited++; break;
+        case LLMError::SERVER: stats.server_errors++; break;
+        case LLMError::INVALID_RESPONSE: stats.invalid_responses++; break;
+        default: break;
+    }
+}
+
+std::string DescribeError(LLMError error, int status) {
+    std::string text = LLMErrorToString(error);
+    if (status > 0) {
+        text += " (HTTP " + std::to_string(status) + ")";
+    }
+    return text;
+}
+
+// 图像请求体：图像和文字作为最后一条用户消息的两段内容，其余消息照常。
+// 计数和实际写出用同一份写法，两遍的字节数必然一致
+template <typename Writer>
+void WriteImageRequest(Writer& json, const std::vector<Message>& messages,
+                       const std::string& model, int max_tokens, const ImageInput& image) {
+    size_t last_user = messages.size();
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (messages[i].role == Role::USER) {
+            last_user = i;
+        }
+    }
+
+    json.BeginObject();
+    json.Field("model", model);
+    json.Key("messages");
+    json.BeginArray();
+    for (size_t i = 0; i < messages.size(); i++) {
+        const Message& msg = messages[i];
+        json.BeginObject();
+        json.Field("role", RoleToString(msg.role));
+        if (i != last_user) {
+            json.Field("content", msg.content);
+            json.EndObject();
+            continue;
+        }
+        json.Key("content");
+        json.BeginArray();
+        json.BeginObject();
+        json.Field("type", "image_url");
+        json.Key("image_url");
+        json.BeginObject();
+        json.Key("url");
+        json.RawString([&image](auto& sink) {
+            static const char PREFIX[] = "data:image/jpeg;base64,";
+            sink.Append(PREFIX, sizeof(PREFIX) - 1);
+            // 计数那一遍不必真的编码
+            if constexpr (std::is_same<std::decay_t<decltype(sink)>, JsonCountingSink>::value) {
+                sink.bytes += Base64EncodedLength(image.size);
+            } else {
+                Base64EncodeTo(sink, image.data, image.size);
+            }
+        });
+        json.EndObject();
+        json.EndObject();
+        json.BeginObject();
+        json.Field("type", "text");
+        json.Field("text", msg.content);
+        json.EndObject();
+        json.EndArray();
+        json.EndObject();
+    }
+    json.EndArray();
+    json.Field("temperature", 0.7);
+    json.Field("max_tokens", max_tokens);
+    json.EndObject();
+}
+
+} // namespace
+
+// 一次流式尝试中主请求与对冲请求共享的状态。两路各在自己的任务里运行，
+// 败者可能比调用方活得久（还卡在超时里），所以由 shared_ptr 共同持有
+struct LLMClient::StreamRace {
+    explicit StreamRace(const StreamCallback& cb) : callback(cb) {
+        primary_progress = xSemaphoreCreateBinary();
+        finished = xSemaphoreCreateBinary();
+    }
+    ~StreamRace() {
+        vSemaphoreDelete(primary_progress);
+        vSemaphoreDelete(finished);
+    }
+
+    // 第一个产出 token 的一路胜出，另一路随即断开；返回本路的输出是否应交给调用方
+    bool Claim(int lane) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (winner < 0 && !abandoned) {
+            winner = lane;
+            lane_cancel[1 - lane] = true;
+        }
+        return winner == lane;
+    }
+
+    // 主请求收到数据或结束：对冲请求不必再发
+    void SignalProgress() {
+        if (!progress_signaled.exchange(true)) {
+            xSemaphoreGive(primary_progress);
+        }
+    }
+
+    // 一路结束，唤醒调用方
+    void Finish(int lane, LLMResponse&& response) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result[lane] = std::move(response);
+            done[lane] = true;
+            if (lane == 0 && !hedge_started) {
+                closed = true;
+            }
+        }
+        if (lane == 0) {
+            SignalProgress();
+        }
+        xSemaphoreGive(finished);
+    }
+
+    StreamCallback callback;
+    std::string url;
+    std::string body;
+    int64_t turn_start_us = 0;
+    int timeout_ms = 0;
+    uint32_t hedge_after_ms = 0;
+    TokenPurpose purpose = TokenPurpose::CHAT;   // 败者的用量按此记账
+    int prompt_estimate = 0;                     // 败者收不到 usage 时按此记账
+    const std::atomic<bool>* cancel = nullptr;   // 调用方放弃时断开两路连接
+    std::atomic<bool> lane_cancel[2] = {{false}, {false}};   // 每路自己的断开标志
+
+    std::mutex mutex;
+    int winner = -1;
+    bool closed = false;          // 对冲请求不能再发出
+    bool abandoned = false;       // 调用方已返回，任何一路的输出都不再交付
+    bool hedge_started = false;
+    bool done[2] = {false, false};
+    uint32_t chunks[2] = {0, 0};
+    int discarded_tokens[2] = {0, 0};   // 没能交付的输出（估算）
+    LLMResponse result[2];
+
+    std::atomic<bool> progress_signaled{false};
+    SemaphoreHandle_t primary_progress;
+    SemaphoreHandle_t finished;
+};
+
+// 结构化输出一遍请求的校验状态。cancel 的地址存在 StreamRace 里，
+// 和 StreamRace 的回调副本一起保持有效
+struct LLMClient::StructuredPass {
+    explicit StructuredPass(const JsonSchema& schema) : validator(schema) {}
+
+    StructuredOutputValidator validator;
+    std::atomic<bool> cancel{false};
+};
+
+// 流式请求任务参数
+struct LLMClient::LaneArg {
+    std::shared_ptr<StreamRace> race;
+    int lane;
+};
+
 bool LLMClient::Init(const std::string& api_key, const std::string& base_url) {
     if (api_key.empty()) {
         ESP_LOGE(TAG, "API key is empty");
@@ -20,213 +208,955 @@ bool LLMClient::Init(const std::string& api_key, const std::string& base_url) {
         base_url_ = base_url;
     }
 
+    HttpPoolOptions options;
+    options.gzip_requests = GZIP_REQUESTS;
+    options.gzip_responses = GZIP_RESPONSES;
+    HttpConnectionPool::GetInstance().Configure(options);
+
+    // 网络任务：此后所有请求都在这里执行
+    if (!RequestQueue::GetInstance().Start()) {
+        ESP_LOGE(TAG, "Failed to start network tasks");
+        return false;
+    }
+
     initialized_ = true;
-    ESP_LOGI(TAG, "LLM client initialized (model: %s)", model_.c_str());
+    ESP_LOGI(TAG, "LLM client initialized (chat: %s, fast: %s, compression: %s)",
+             router_.GetRules().chat_model.c_str(), router_.GetRules().fast_model.c_str(),
+             router_.GetRules().compression_model.c_str());
     return true;
 }
 
 LLMResponse LLMClient::Chat(const std::vector<Message>& messages) {
-    LLMResponse response;
+    Request request;
+    request.messages = messages;
+    return Await(std::move(request));
+}
+
+LLMResponse LLMClient::ChatStream(const std::vector<Message>& messages,
+                                  StreamCallback callback) {
+    Request request;
+    request.messages = messages;
+    request.on_chunk = std::move(callback);
+    return Await(std::move(request));
+}
 
+void LLMClient::Submit(Request request, CompletionCallback on_complete) {
     if (!initialized_) {
+        LLMResponse response;
+        response.error = LLMError::NOT_INITIALIZED;
         response.error_message = "LLM client not initialized";
-        return response;
+        on_complete(response);
+        return;
     }
 
-    // 构建请求
-    std::string body = BuildRequestJson(messages);
-    std::string url = base_url_ + "/chat/completions";
+    // 请求和回调由两个闭包共享，谁被调用谁交付结果
+    auto shared = std::make_shared<std::pair<Request, CompletionCallback>>(
+        std::move(request), std::move(on_complete));
+    RequestPriority priority = shared->first.priority;
+    uint32_t deadline_ms = shared->first.deadline_ms;
+    RequestQueue::GetInstance().Submit(
+        priority, deadline_ms,
+        [this, shared](int64_t deadline_us) {
+            shared->second(Run(shared->first, deadline_us));
+        },
+        [this, shared](bool rejected) {
+            LLMResponse response;
+            response.error = rejected ? LLMError::OVERLOADED : LLMError::DEADLINE;
+            response.error_message = rejected ? "request queue full" : "deadline exceeded in queue";
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                transport_stats_.failures++;
+            }
+            shared->second(response);
+        });
+}
+
+std::future<LLMResponse> LLMClient::Submit(Request request) {
+    auto promise = std::make_shared<std::promise<LLMResponse>>();
+    std::future<LLMResponse> future = promise->get_future();
+    Submit(std::move(request), [promise](const LLMResponse& response) {
+        promise->set_value(response);
+    });
+    return future;
+}
+
+LLMResponse LLMClient::Await(Request request) {
+    if (RequestQueue::GetInstance().OnNetworkTask()) {
+        int64_t deadline_us = request.deadline_ms
+            ? esp_timer_get_time() + static_cast<int64_t>(request.deadline_ms) * 1000 : 0;
+        return Run(request, deadline_us);
+    }
+    return Submit(std::move(request)).get();
+}
 
-    // 发送请求
-    std::string resp_str;
-    if (!PostRequest(url, body, resp_str)) {
-        response.error_message = "HTTP request failed";
+LLMResponse LLMClient::Run(const Request& request, int64_t deadline_us) {
+    if (request.schema) {
+        LLMResponse response = RunStructured(request, deadline_us);
+        if (request.on_chunk) {
+            request.on_chunk(std::string(), true);
+        }
         return response;
     }
 
-    // 解析响应
-    if (ParseResponseJson(resp_str, response)) {
-        response.success = true;
+    // 带图像的请求只能走视觉模型，按图像用途记账
+    bool has_image = request.image.data != nullptr;
+    LLMResponse response = Execute(has_image ? LLMTask::VISION : request.task, request.messages,
+                                   request.on_chunk && !has_image ? &request.on_chunk : nullptr,
+                                   deadline_us, nullptr, nullptr,
+                                   has_image ? &request.image : nullptr);
+
+    if (has_image) {
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            vision_stats_.requests++;
+            if (!response.success) {
+                vision_stats_.failures++;
+            }
+        }
+        if (request.on_chunk) {
+            if (response.success) {
+                request.on_chunk(response.content, false);
+            }
+            request.on_chunk(std::string(), true);
+        }
+    } else if (request.on_chunk) {
+        // 重试都在 Execute 里，这里才是流的终点：超时、HTTP 错误、中途断开也要
+        // 以 is_done 收尾，失败原因由返回的 LLMResponse 给出
+        request.on_chunk(std::string(), true);
+    }
+
+    if (response.success) {
+        TokenPurpose purpose = request.task == LLMTask::COMPRESSION ? TokenPurpose::COMPRESSION
+                             : has_image ? TokenPurpose::VISION : request.purpose;
+        TokenLedger::GetInstance().Record(purpose, response.prompt_tokens,
+                                          response.completion_tokens, response.cached_tokens);
     }
 
+    // 压缩结果只要 JSON 块
+    if (request.task == LLMTask::COMPRESSION && response.success) {
+        size_t start = response.content.find('{');
+        size_t end = response.content.rfind('}');
+        if (start != std::string::npos && end != std::string::npos) {
+            response.content = response.content.substr(start, end - start + 1);
+        }
+    }
     return response;
 }
 
-LLMResponse LLMClient::ChatWithImage(const std::vector<Message>& messages,
-                                     const std::vector<uint8_t>& image_data) {
-    // TODO: 实现多模态请求
-    // 1. 将图像编码为 base64
-    // 2. 构建包含图像的消息
-    // 3. 调用多模态模型
+LLMResponse LLMClient::RunStructured(const Request& request, int64_t deadline_us) {
+    TokenPurpose purpose = request.task == LLMTask::COMPRESSION
+        ? TokenPurpose::COMPRESSION : request.purpose;
+    TokenLedger& ledger = TokenLedger::GetInstance();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        structured_stats_.requests++;
+    }
 
+    std::vector<Message> messages = request.messages;
     LLMResponse response;
-    response.error_message = "Multimodal not implemented";
-    return response;
+    for (int pass = 0;; pass++) {
+        // 对冲请求输掉的一路可能在本函数返回后还在读取 cancel：校验器和取消标志
+        // 放在堆上，由回调（StreamRace 持有它的副本）共同持有
+        auto pass_state = std::make_shared<StructuredPass>(*request.schema);
+        StructuredOutputValidator& validator = pass_state->validator;
+        StreamCallback feed = [pass_state](const std::string& chunk, bool is_done) {
+            if (!is_done && !pass_state->validator.Feed(chunk)) {
+                pass_state->cancel = true;
+            }
+        };
+        response = Execute(request.task, messages, &feed, deadline_us, request.schema,
+                           &pass_state->cancel);
+
+        int wasted = 0;
+        if (response.success) {
+            ledger.Record(purpose, response.prompt_tokens, response.completion_tokens,
+                          response.cached_tokens);
+            if (validator.Finish()) {
+                response.content = validator.Extract(response.content);
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                structured_stats_.valid++;
+                if (pass == 0) {
+                    structured_stats_.first_pass++;
+                }
+                if (validator.Recovered()) {
+                    structured_stats_.recovered++;
+                }
+                return response;
+            }
+            wasted = response.prompt_tokens + response.completion_tokens;
+        } else if (response.error == LLMError::SCHEMA_VIOLATION) {
+            // 提前断开的流收不到 usage：按发出的消息和已收到的内容估算
+            int prompt = response.prompt_tokens;
+            int completion = response.completion_tokens;
+            if (prompt == 0) {
+                for (const Message& msg : messages) {
+                    prompt += MemoryIndex::EstimateTokens(msg.content);
+                }
+                completion = MemoryIndex::EstimateTokens(response.content);
+            }
+            ledger.Record(purpose, prompt, completion, 0);
+            wasted = prompt + completion;
+        } else {
+            // 传输层已经重试过，不再发修复请求
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            structured_stats_.failures++;
+            return response;
+        }
+
+        bool aborted = response.error == LLMError::SCHEMA_VIOLATION;
+        ESP_LOGW(TAG, "Structured output rejected%s (%s): %s, %d tokens wasted",
+                 aborted ? " mid-stream" : "", SchemaViolationToString(validator.Violation()),
+                 validator.Error().c_str(), wasted);
+        bool give_up = pass >= MAX_REPAIRS;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            structured_stats_.violations++;
+            structured_stats_.wasted_tokens += wasted;
+            if (aborted) {
+                structured_stats_.aborted++;
+            }
+            if (give_up) {
+                structured_stats_.failures++;
+            } else {
+                structured_stats_.repairs++;
+            }
+        }
+        if (give_up) {
+            response.success = false;
+            response.error = LLMError::SCHEMA_VIOLATION;
+            response.error_message = validator.Error();
+            return response;
+        }
+
+        // 修复请求：原消息原样保留（前缀缓存仍然命中），追加上次的输出和问题说明
+        messages.resize(request.messages.size());
+        messages.push_back(Message(Role::ASSISTANT, response.content.substr(0, REPAIR_ECHO_BYTES)));
+        messages.push_back(Message(Role::USER, validator.RepairInstruction()));
+    }
 }
 
-LLMResponse LLMClient::ChatStream(const std::vector<Message>& messages,
-                                  StreamCallback callback) {
-    // TODO: 实现流式响应
-    // 使用 Server-Sent Events (SSE)
+LLMResponse LLMClient::ChatWithImage(const std::vector<Message>& messages,
+                                     const std::vector<uint8_t>& image_data) {
+    return ChatWithImage(messages, image_data.data(), image_data.size());
+}
 
-    LLMResponse response;
-    response.error_message = "Streaming not implemented";
-    return response;
+LLMResponse LLMClient::ChatWithImage(const std::vector<Message>& messages,
+                                     const uint8_t* jpeg, size_t size) {
+    if (!jpeg || size == 0) {
+        LLMResponse response;
+        response.error = LLMError::BAD_REQUEST;
+        response.error_message = "Empty image";
+        return response;
+    }
+
+    Request request;
+    request.task = LLMTask::VISION;
+    request.purpose = TokenPurpose::VISION;
+    request.messages = messages;
+    // 图像总要附在一条用户消息上
+    if (request.messages.empty() || request.messages.back().role != Role::USER) {
+        request.messages.push_back(Message(Role::USER, "描述这张图片"));
+    }
+    request.image.data = jpeg;
+    request.image.size = size;
+    return Await(std::move(request));
 }
 
-LLMResponse LLMClient::CompressMemory(const std::string& prompt) {
+LLMResponse LLMClient::Execute(LLMTask task, const std::vector<Message>& messages,
+                               const StreamCallback* callback, int64_t request_deadline_us,
+                               const JsonSchema* schema, const std::atomic<bool>* cancel,
+                               const ImageInput* image) {
     LLMResponse response;
 
     if (!initialized_) {
+        response.error = LLMError::NOT_INITIALIZED;
         response.error_message = "LLM client not initialized";
         return response;
     }
 
-    // 构建压缩请求
-    std::vector<Message> messages;
-    messages.push_back(Message(Role::USER, prompt));
+    const RetryPolicy& policy = task == LLMTask::COMPRESSION ? compression_policy_ : chat_policy_;
+    // 接近 token 预算时对话走最便宜的模型并限制回复长度
+    bool economy = task != LLMTask::COMPRESSION &&
+                   TokenLedger::GetInstance().GetLevel() != BudgetLevel::NORMAL;
+    int max_tokens = economy ? ECONOMY_MAX_TOKENS : MAX_TOKENS;
+    std::vector<std::string> candidates;
+    bool chitchat = false;
+    {
+        std::lock_guard<std::mutex> lock(route_mutex_);
+        candidates = router_.Route(task, messages, economy);
+        chitchat = task == LLMTask::CHAT && router_.IsChitChat(messages);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        transport_stats_.requests++;
+        if (chitchat) {
+            transport_stats_.chitchat++;
+        }
+    }
 
-    response = Chat(messages);
+    std::string url = base_url_ + "/chat/completions";
+    int64_t start_us = esp_timer_get_time();
+    int64_t deadline_us = start_us + static_cast<int64_t>(policy.deadline_ms) * 1000;
+    if (request_deadline_us > 0) {
+        deadline_us = std::min(deadline_us, request_deadline_us);
+    }
+    size_t preferred = 0;
+    bool delivered = false;   // 流式输出已交给调用方：不能再透明重试
 
-    // 如果成功，提取 JSON 内容
-    if (response.success) {
-        // 尝试提取 JSON 块
-        size_t start = response.content.find('{');
-        size_t end = response.content.rfind('}');
-        if (start != std::string::npos && end != std::string::npos) {
-            response.content = response.content.substr(start, end - start + 1);
+    // 对冲输掉的一路由 StreamAttempt 自己记账（流式请求不带图像）
+    TokenPurpose purpose = task == LLMTask::COMPRESSION ? TokenPurpose::COMPRESSION
+                                                        : TokenPurpose::CHAT;
+    int prompt_estimate = 0;
+    if (callback) {
+        for (const Message& msg : messages) {
+            prompt_estimate += MemoryIndex::EstimateTokens(msg.content);
         }
     }
 
-    return response;
-}
+    for (int attempt = 1;; attempt++) {
+        // 单次尝试的超时不超过剩余时限
+        int64_t remaining_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (remaining_ms <= 0) {
+            response = LLMResponse();
+            response.error = LLMError::DEADLINE;
+            response.attempts = attempt - 1;
+            break;
+        }
+        // 交互流式请求的超时和对冲等待按链路估计（首 token 延迟的均值与偏差）
+        int attempt_timeout_ms = HTTP_TIMEOUT_MS;
+        uint32_t hedge_after_ms = 0;
+        if (callback && task == LLMTask::CHAT) {
+            LinkProfile link = LinkQuality::GetInstance().GetProfile();
+            attempt_timeout_ms = std::min<int>(attempt_timeout_ms, link.response_timeout_ms);
+            hedge_after_ms = adaptive_hedge_ ? link.hedge_after_ms : hedge_after_ms_;
+        }
+        int timeout_ms = static_cast<int>(std::min<int64_t>(remaining_ms, attempt_timeout_ms));
 
-std::string LLMClient::BuildRequestJson(const std::vector<Message>& messages) {
-    std::ostringstream oss;
+        std::string model;
+        size_t index = 0;
+        if (!AcquireModel(candidates, preferred, model, index)) {
+            response = LLMResponse();
+            response.error = LLMError::CIRCUIT_OPEN;
+            response.attempts = attempt - 1;
+            ESP_LOGE(TAG, "All candidate models are circuit-open");
+            break;
+        }
 
-    oss << "{";
-    oss << "\"model\":\"" << model_ << "\",";
-    oss << "\"messages\":[";
+        StructuredOutputMode mode = StructuredOutputMode::NONE;
+        if (schema) {
+            std::lock_guard<std::mutex> lock(route_mutex_);
+            if (EndpointLocked(model).response_format_ok) {
+                mode = structured_mode_;
+            }
+        }
 
-    for (size_t i = 0; i < messages.size(); i++) {
-        const Message& msg = messages[i];
-        if (i > 0) oss << ",";
+        if (image) {
+            response = UploadOnce(url, messages, model, max_tokens, *image, timeout_ms);
+        } else {
+            std::string body = BuildRequestJson(messages, model, callback != nullptr, max_tokens,
+                                                schema, mode);
+            response = callback
+                ? StreamAttempt(url, body, *callback, hedge_after_ms, timeout_ms, start_us,
+                                delivered, cancel, purpose, prompt_estimate)
+                : RequestOnce(url, body, timeout_ms);
+        }
+        if (cancel && cancel->load()) {
+            // 调用方的校验判定输出作废，连接已断开：不是传输错误
+            response.success = false;
+            response.error = LLMError::SCHEMA_VIOLATION;
+            response.error_message = "Structured output rejected";
+        }
+        response.model = model;
+        response.attempts = attempt;
+        ReportOutcome(model, response.error);
 
-        oss << "{\"role\":\"" << RoleToString(msg.role) << "\"";
-        oss << ",\"content\":\"";
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            if (index != 0) {
+                transport_stats_.fallbacks++;
+            }
+            CountError(transport_stats_, response.error);
+        }
 
-        // 转义 JSON
-        for (char c : msg.content) {
-            switch (c) {
-                case '"': oss << "\\\""; break;
-                case '\\': oss << "\\\\"; break;
-                case '\n': oss << "\\n"; break;
-                case '\r': oss << "\\r"; break;
-                case '\t': oss << "\\t"; break;
-                default: oss << c; break;
+        // 端点不认 response_format：记下来，之后对它只靠提示词要求 JSON
+        if (mode != StructuredOutputMode::NONE && response.error == LLMError::BAD_REQUEST &&
+            attempt < policy.max_attempts) {
+            {
+                std::lock_guard<std::mutex> lock(route_mutex_);
+                EndpointLocked(model).response_format_ok = false;
             }
+            ESP_LOGW(TAG, "%s rejects response_format %s, relying on the prompt",
+                     model.c_str(), StructuredOutputModeToString(mode));
+            continue;
         }
 
-        oss << "\"}";
+        if (response.success || !IsRetryable(response.error) || delivered ||
+            attempt >= policy.max_attempts) {
+            break;
+        }
+
+        // 限流和 5xx 是模型侧的问题，换下一个候选；网络错误与模型无关，原模型重试
+        if (response.error == LLMError::RATE_LIMITED || response.error == LLMError::SERVER) {
+            preferred = (index + 1) % candidates.size();
+        }
+        uint32_t delay_ms = policy.DelayMs(attempt, response.error);
+        if (esp_timer_get_time() + static_cast<int64_t>(delay_ms) * 1000 >= deadline_us) {
+            ESP_LOGW(TAG, "No time left for another attempt");
+            break;
+        }
+        ESP_LOGW(TAG, "Attempt %d on %s failed (%s), retrying in %u ms", attempt, model.c_str(),
+                 DescribeError(response.error, response.http_status).c_str(),
+                 static_cast<unsigned>(delay_ms));
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            transport_stats_.retries++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
     }
 
-    oss << "],";
-    oss << "\"temperature\":0.7,";
-    oss << "\"max_tokens\":2000";
-    oss << "}";
+    response.latency_ms = static_cast<uint32_t>((esp_timer_get_time() - start_us) / 1000);
+    if (!response.success) {
+        if (response.error_message.empty()) {
+            response.error_message = DescribeError(response.error, response.http_status);
+        }
+        if (response.error != LLMError::SCHEMA_VIOLATION) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            transport_stats_.failures++;
+            if (callback) {
+                stream_stats_.failures++;
+            }
+        }
+        return response;
+    }
 
-    return oss.str();
+    RecordUsage(response);
+    // 首次尝试、非对冲应答的首 token 延迟才代表这条链路（重试含退避等待）
+    if (callback && task == LLMTask::CHAT && response.attempts == 1 && !response.hedged) {
+        LinkQuality::GetInstance().RecordFirstByte(response.ttft_ms);
+    }
+    if (callback) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stream_stats_.streams++;
+        stream_stats_.ttft_total_ms += response.ttft_ms;
+        stream_stats_.last_ttft_ms = response.ttft_ms;
+        stream_stats_.ttft_max_ms = std::max(stream_stats_.ttft_max_ms, response.ttft_ms);
+        if (stream_stats_.streams == 1 || response.ttft_ms < stream_stats_.ttft_min_ms) {
+            stream_stats_.ttft_min_ms = response.ttft_ms;
+        }
+    }
+    ESP_LOGI(TAG, "%s done by %s in %u ms (%d attempt%s%s), TTFT %u ms, prompt %d tokens (%d cached), "
+             "completion %d tokens",
+             callback ? "Stream" : image ? "Vision" : "Chat", response.model.c_str(),
+             static_cast<unsigned>(response.latency_ms), response.attempts,
+             response.attempts == 1 ? "" : "s", response.hedged ? ", hedged" : "",
+             static_cast<unsigned>(response.ttft_ms), response.prompt_tokens,
+             response.cached_tokens, response.completion_tokens);
+    return response;
 }
 
-bool LLMClient::ParseResponseJson(const std::string& json, LLMResponse& response) {
-    // 简单 JSON 解析（生产环境应使用 cJSON 或 ArduinoJson）
+LLMResponse LLMClient::RequestOnce(const std::string& url, const std::string& body,
+                                   int timeout_ms) {
+    LLMResponse response;
 
-    // 查找 content 字段
-    std::string content_key = "\"content\":\"";
-    size_t start = json.find(content_key);
-    if (start == std::string::npos) {
-        ESP_LOGE(TAG, "Failed to find content in response");
-        return false;
+    // 响应体写入复用的 PSRAM 缓冲区；另一任务正在用时临时建一个
+    std::unique_lock<std::mutex> lease(buffer_mutex_, std::try_to_lock);
+    ResponseBuffer local_buffer;
+    ResponseBuffer& buffer = lease.owns_lock() ? response_buffer_ : local_buffer;
+
+    response.http_status = PostRequest(url, body, buffer, timeout_ms);
+    response.error = ClassifyStatus(response.http_status);
+
+    // 直接在缓冲区上解析，只有 content 被复制出来
+    if (response.error == LLMError::NONE &&
+        (buffer.Overflowed() || !ParseResponseJson(buffer.Data(), buffer.Size(), response))) {
+        response.error = LLMError::INVALID_RESPONSE;
     }
+    buffer.Clear();
+    response.success = response.error == LLMError::NONE;
+    return response;
+}
 
-    start += content_key.length();
-    size_t end = json.find("\"", start);
-    if (end == std::string::npos) {
-        return false;
+LLMResponse LLMClient::UploadOnce(const std::string& url, const std::vector<Message>& messages,
+                                  const std::string& model, int max_tokens,
+                                  const ImageInput& image, int timeout_ms) {
+    LLMResponse response;
+
+    // 第一遍只数字节，得出 Content-Length
+    JsonCountingSink counter;
+    JsonWriter<JsonCountingSink> measure(counter);
+    WriteImageRequest(measure, messages, model, max_tokens, image);
+
+    std::unique_lock<std::mutex> lease(buffer_mutex_, std::try_to_lock);
+    ResponseBuffer local_buffer;
+    ResponseBuffer& buffer = lease.owns_lock() ? response_buffer_ : local_buffer;
+    buffer.Clear();
+
+    // 第二遍边编码边写出；连接断开重连时连接池会再调用一次，每次从头计时
+    int64_t upload_us = 0;
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t heap_min = heap_before;
+    HttpConnectionPool::BodyWriter body = [&](const HttpConnectionPool::ChunkWriter& write) {
+        int64_t start = esp_timer_get_time();
+        char chunk[UPLOAD_CHUNK_BYTES];
+        JsonChunkSink sink(chunk, sizeof(chunk), [&](const char* data, size_t length) {
+            heap_min = std::min(heap_min, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+            return write(data, length);
+        });
+        JsonWriter<JsonChunkSink> json(sink);
+        WriteImageRequest(json, messages, model, max_tokens, image);
+        bool ok = sink.Finish();
+        upload_us = esp_timer_get_time() - start;
+        return ok;
+    };
+
+    ESP_LOGI(TAG, "POST (image, %u bytes) %s", static_cast<unsigned>(image.size), url.c_str());
+    response.http_status = HttpConnectionPool::GetInstance().Upload(
+        url, counter.bytes, body, BuildHeaders(false),
+        [&buffer](const char* data, size_t length) { buffer.Append(data, length); },
+        timeout_ms);
+    response.error = ClassifyStatus(response.http_status);
+    if (response.error == LLMError::NONE &&
+        (buffer.Overflowed() || !ParseResponseJson(buffer.Data(), buffer.Size(), response))) {
+        response.error = LLMError::INVALID_RESPONSE;
     }
+    buffer.Clear();
+    response.success = response.error == LLMError::NONE;
 
-    response.content = json.substr(start, end - start);
+    uint32_t upload_ms = static_cast<uint32_t>(upload_us / 1000);
+    uint32_t heap_peak = static_cast<uint32_t>(heap_before > heap_min ? heap_before - heap_min : 0);
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        vision_stats_.uploads++;
+        vision_stats_.image_bytes += image.size;
+        vision_stats_.body_bytes += counter.bytes;
+        vision_stats_.upload_total_ms += upload_ms;
+        vision_stats_.last_upload_ms = upload_ms;
+        vision_stats_.max_upload_ms = std::max(vision_stats_.max_upload_ms, upload_ms);
+        vision_stats_.heap_peak_bytes = std::max(vision_stats_.heap_peak_bytes, heap_peak);
+    }
+    ESP_LOGI(TAG, "Image upload: %u bytes JPEG, %u bytes body in %u ms, heap dipped %u bytes",
+             static_cast<unsigned>(image.size), static_cast<unsigned>(counter.bytes),
+             static_cast<unsigned>(upload_ms), static_cast<unsigned>(heap_peak));
+    return response;
+}
 
-    // 反转义
-    // TODO: 实现 JSON 反转义
+LLMResponse LLMClient::StreamAttempt(const std::string& url, const std::string& body,
+                                     const StreamCallback& callback, uint32_t hedge_after_ms,
+                                     int timeout_ms, int64_t turn_start_us, bool& delivered,
+                                     const std::atomic<bool>* cancel, TokenPurpose purpose,
+                                     int prompt_estimate) {
+    auto race = std::make_shared<StreamRace>(callback);
+    race->url = url;
+    race->body = body;
+    race->turn_start_us = turn_start_us;
+    race->timeout_ms = timeout_ms;
+    race->hedge_after_ms = hedge_after_ms;
+    bool hedge = hedge_after_ms > 0;
+    race->cancel = cancel;
+    race->purpose = purpose;
+    race->prompt_estimate = prompt_estimate;
 
-    // 查找 usage 字段
-    std::string usage_key = "\"total_tokens\":";
-    size_t usage_pos = json.find(usage_key);
-    if (usage_pos != std::string::npos) {
-        size_t num_start = usage_pos + usage_key.length();
-        response.tokens_used = std::stoi(json.substr(num_start));
+    // 对冲时两路都放到独立任务里：胜者一结束就返回，不被卡住的另一路拖到超时
+    if (hedge && !StartLane(race, 0)) {
+        hedge = false;
+    }
+    if (hedge && !StartLane(race, 1)) {
+        std::lock_guard<std::mutex> lock(race->mutex);
+        race->closed = true;
     }
 
+    LLMResponse response;
+    if (!hedge) {
+        response = StreamOnce(race, 0);
+    } else {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(race->mutex);
+                int w = race->winner;
+                if (w >= 0 && race->done[w]) {
+                    response = race->result[w];
+                    response.hedged = w == 1;
+                    break;
+                }
+                // 没有胜者：主请求结束且对冲请求未发出或也已结束
+                bool hedge_settled = race->hedge_started ? race->done[1] : race->closed;
+                if (w < 0 && race->done[0] && hedge_settled) {
+                    bool use_hedge = race->hedge_started && race->result[1].success;
+                    response = race->result[use_hedge ? 1 : 0];
+                    response.hedged = use_hedge;
+                    break;
+                }
+            }
+            xSemaphoreTake(race->finished, portMAX_DELAY);
+        }
+        if (response.hedged && response.success) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            transport_stats_.hedge_wins++;
+        }
+    }
+
+    uint32_t chunks = 0;
+    {
+        std::lock_guard<std::mutex> lock(race->mutex);
+        race->closed = true;
+        race->abandoned = true;
+        // 还在跑的一路（输掉的、或没有胜者时迟迟不结束的）都断开
+        race->lane_cancel[0] = true;
+        race->lane_cancel[1] = true;
+        delivered = race->winner >= 0;
+        chunks = delivered ? race->chunks[race->winner] : 0;
+    }
+    if (response.success) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stream_stats_.chunks += chunks;
+    }
+    return response;
+}
+
+bool LLMClient::StartLane(const std::shared_ptr<StreamRace>& race, int lane) {
+    auto* arg = new LaneArg{race, lane};
+    if (xTaskCreate(LaneTask, lane ? "llm_hedge" : "llm_stream", 8192, arg, 5, nullptr) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to start stream task");
+        delete arg;
+        return false;
+    }
     return true;
 }
 
-bool LLMClient::PostRequest(const std::string& url, const std::string& body,
-                            std::string& response) {
-    ESP_LOGI(TAG, "POST %s", url.c_str());
-    ESP_LOGD(TAG, "Body: %s", body.c_str());
+LLMResponse LLMClient::StreamOnce(const std::shared_ptr<StreamRace>& race, int lane) {
+    LLMResponse response;
+    int64_t first_token_us = 0;
 
-    esp_http_client_config_t config = {
-        .url = url.c_str(),
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 30000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-    };
+    // 每个 SSE 事件是一个 chat.completion.chunk；解析器的反转义缓冲区在整个流中复用
+    JsonReader reader;
+    SseParser parser([&](const std::string& data) {
+        std::string delta;
+        if (!ParseStreamChunk(reader, data, delta, response)) {
+            ESP_LOGW(TAG, "Skipping malformed stream event (%zu bytes)", data.size());
+            return;
+        }
+        if (delta.empty()) {
+            return;
+        }
+        if (!race->Claim(lane)) {
+            // 另一路先出了 token，本路的输出丢弃（仍要计费，记下数量）
+            race->discarded_tokens[lane] += MemoryIndex::EstimateTokens(delta);
+            return;
+        }
+        if (first_token_us == 0) {
+            first_token_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "First token after %lld ms%s",
+                     static_cast<long long>((first_token_us - race->turn_start_us) / 1000),
+                     lane ? " (hedge)" : "");
+        }
+        race->chunks[lane]++;
+        response.content += delta;
+        if (race->callback) {
+            race->callback(delta, false);
+        }
+    });
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to create HTTP client");
-        return false;
+    response.http_status = PostStream(race->url, race->body,
+                                      [&](const char* data, size_t length) {
+        if (lane == 0) {
+            race->SignalProgress();
+        }
+        parser.Feed(data, length);
+        // 连接池每段数据后检查本路的标志：调用方放弃（如校验失败）时两路都断开
+        if (race->cancel && race->cancel->load()) {
+            race->lane_cancel[lane] = true;
+        }
+    }, race->timeout_ms, &race->lane_cancel[lane]);
+    parser.Finish();
+
+    response.error = ClassifyStatus(response.http_status);
+    if (response.error == LLMError::NONE && response.content.empty()) {
+        response.error = LLMError::INVALID_RESPONSE;
+        response.error_message = "Empty stream";
+    }
+    response.success = response.error == LLMError::NONE;
+    if (response.success && !parser.IsDone()) {
+        // 连接提前关闭：已收到的内容仍然有效
+        ESP_LOGW(TAG, "Stream ended without [DONE]");
     }
+    if (first_token_us != 0) {
+        response.ttft_ms = static_cast<uint32_t>((first_token_us - race->turn_start_us) / 1000);
+    }
+    return response;
+}
 
-    // 设置请求头
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "Authorization", 
-                               ("Bearer " + api_key_).c_str());
+void LLMClient::LaneTask(void* arg) {
+    {
+        std::unique_ptr<LaneArg> lane_arg(static_cast<LaneArg*>(arg));
+        std::shared_ptr<StreamRace> race = lane_arg->race;
+        int lane = lane_arg->lane;
+        LLMClient& client = GetInstance();
 
-    // 设置请求体
-    esp_http_client_set_post_field(client, body.c_str(), body.length());
+        // 对冲请求先等主请求的首字节，超时才真正发出
+        bool run = true;
+        if (lane == 1) {
+            run = false;
+            if (xSemaphoreTake(race->primary_progress, pdMS_TO_TICKS(race->hedge_after_ms)) != pdTRUE) {
+                std::lock_guard<std::mutex> lock(race->mutex);
+                if (!race->closed) {
+                    race->hedge_started = true;
+                    run = true;
+                }
+            }
+            if (run) {
+                ESP_LOGW(TAG, "No response after %u ms, sending a hedged request",
+                         static_cast<unsigned>(race->hedge_after_ms));
+                std::lock_guard<std::mutex> lock(client.stats_mutex_);
+                client.transport_stats_.hedges++;
+            }
+        }
+        if (run) {
+            LLMResponse response = client.StreamOnce(race, lane);
+            RecordLoser(*race, lane, response);
+            race->Finish(lane, std::move(response));
+        }
+    }
+    // vTaskDelete 不返回：race 必须在此之前释放
+    vTaskDelete(nullptr);
+}
 
-    // 发送请求
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        return false;
+void LLMClient::RecordLoser(StreamRace& race, int lane, const LLMResponse& response) {
+    // 调用方只给胜者记账；败者的请求同样发出去了，收到 usage 就按 usage 记，
+    // 服务端已开始回复但中途断开的按请求和已收到的输出估算（HTTP 错误不计费）
+    bool lost = false;
+    {
+        std::lock_guard<std::mutex> lock(race.mutex);
+        lost = race.winner != lane;
+    }
+    if (!lost) {
+        return;
+    }
+    int prompt = response.prompt_tokens;
+    int completion = response.completion_tokens;
+    if (prompt == 0 && completion == 0 && response.http_status >= 200 &&
+        response.http_status < 300) {
+        prompt = race.prompt_estimate;
+        completion = race.discarded_tokens[lane];
+    }
+    if (prompt > 0 || completion > 0) {
+        TokenLedger::GetInstance().Record(race.purpose, prompt, completion, response.cached_tokens);
+        ESP_LOGD(TAG, "Hedge lane %d lost: %d prompt + %d completion tokens", lane, prompt,
+                 completion);
+    }
+}
+
+bool LLMClient::AcquireModel(const std::vector<std::string>& candidates, size_t preferred,
+                             std::string& model, size_t& index) {
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    int64_t now = NowMs();
+    for (size_t i = 0; i < candidates.size(); i++) {
+        size_t k = (preferred + i) % candidates.size();
+        if (EndpointLocked(candidates[k]).breaker.Allow(now)) {
+            model = candidates[k];
+            index = k;
+            return true;
+        }
+        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+        transport_stats_.short_circuits++;
     }
+    return false;
+}
 
-    // 获取状态码
-    int status = esp_http_client_get_status_code(client);
-    if (status != 200) {
-        ESP_LOGE(TAG, "HTTP status: %d", status);
-        esp_http_client_cleanup(client);
-        return false;
+void LLMClient::ReportOutcome(const std::string& model, LLMError error) {
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    CircuitBreaker& breaker = EndpointLocked(model).breaker;
+    if (!IsRetryable(error)) {
+        // 成功，或者服务端正常作答的 4xx：端点本身是健康的
+        breaker.RecordSuccess();
+        return;
+    }
+    uint32_t trips = breaker.Trips();
+    breaker.RecordFailure(NowMs());
+    if (breaker.Trips() != trips) {
+        ESP_LOGW(TAG, "Circuit for %s opened after %s", model.c_str(), LLMErrorToString(error));
     }
+}
 
-    // 读取响应
-    int content_length = esp_http_client_get_content_length(client);
-    if (content_length > 0) {
-        response.resize(content_length);
-        int read = esp_http_client_read(client, &response[0], content_length);
-        if (read != content_length) {
-            ESP_LOGW(TAG, "Read %d bytes, expected %d", read, content_length);
+LLMClient::Endpoint& LLMClient::EndpointLocked(const std::string& model) {
+    for (Endpoint& ep : endpoints_) {
+        if (ep.model == model) {
+            return ep;
         }
     }
+    endpoints_.push_back(Endpoint{model, CircuitBreaker()});
+    return endpoints_.back();
+}
 
-    esp_http_client_cleanup(client);
+void LLMClient::SetModel(const std::string& model) {
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    router_.SetChatModel(model);
+}
+
+void LLMClient::SetRoutingRules(const ModelRouter::Rules& rules) {
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    router_.SetRules(rules);
+}
+
+LLMResponse LLMClient::CompressMemory(const std::string& prompt, const JsonSchema* schema) {
+    Request request;
+    request.task = LLMTask::COMPRESSION;
+    request.schema = schema;
+    request.messages.push_back(Message(Role::USER, prompt));
+    request.priority = RequestPriority::BACKGROUND;
+    return Await(std::move(request));
+}
+
+std::string LLMClient::BuildRequestJson(const std::vector<Message>& messages,
+                                        const std::string& model, bool stream,
+                                        int max_tokens, const JsonSchema* schema,
+                                        StructuredOutputMode mode) {
+    std::string body;
+    JsonWriteTo(body, [&](auto& json) {
+        json.BeginObject();
+        json.Field("model", model);
+        json.Key("messages");
+        json.BeginArray();
+        for (const Message& msg : messages) {
+            json.BeginObject();
+            json.Field("role", RoleToString(msg.role));
+            json.Field("content", msg.content);
+            json.EndObject();
+        }
+        json.EndArray();
+        // 结构化输出降低随机性，格式更稳定
+        json.Field("temperature", schema ? 0.3 : 0.7);
+        json.Field("max_tokens", max_tokens);
+        if (stream) {
+            json.Field("stream", true);
+        }
+        if (schema) {
+            WriteResponseFormat(json, *schema, mode);
+        }
+        json.EndObject();
+    });
+    return body;
+}
+
+bool LLMClient::ParseResponseJson(const char* json, size_t length, LLMResponse& response) {
+    // choices[0].message.content + usage
+    CompletionUsage usage;
+    CompletionHandler handler("message", response.content, usage);
+    JsonReader reader;
+    if (reader.Parse(json, length, handler) != JsonParseError::NONE) {
+        ESP_LOGE(TAG, "Failed to parse response JSON at byte %zu", reader.ErrorOffset());
+        return false;
+    }
+    if (!handler.FoundContent()) {
+        ESP_LOGE(TAG, "Failed to find content in response");
+        return false;
+    }
+    ApplyUsage(usage, response);
+    return true;
+}
 
-    ESP_LOGD(TAG, "Response: %s", response.c_str());
+bool LLMClient::ParseStreamChunk(JsonReader& reader, const std::string& json,
+                                 std::string& delta, LLMResponse& response) {
+    // choices[0].delta.content；usage 只出现在最后一个事件。
+    // 解析器负责反转义，包括 \uXXXX 代理对
+    CompletionUsage usage;
+    CompletionHandler handler("delta", delta, usage);
+    if (reader.Parse(json, handler) != JsonParseError::NONE) {
+        return false;
+    }
+    ApplyUsage(usage, response);
     return true;
 }
 
+void LLMClient::RecordUsage(const LLMResponse& response) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    cache_stats_.requests++;
+    cache_stats_.prompt_tokens += response.prompt_tokens;
+    cache_stats_.cached_tokens += response.cached_tokens;
+    if (response.cached_tokens > 0) {
+        cache_stats_.cache_hits++;
+        cache_stats_.hit_latency_ms += response.latency_ms;
+    } else {
+        cache_stats_.miss_latency_ms += response.latency_ms;
+    }
+}
+
+PromptCacheStats LLMClient::GetCacheStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return cache_stats_;
+}
+
+StreamStats LLMClient::GetStreamStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stream_stats_;
+}
+
+StructuredOutputStats LLMClient::GetStructuredOutputStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return structured_stats_;
+}
+
+VisionStats LLMClient::GetVisionStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    VisionStats stats = vision_stats_;
+    stats.scratch_bytes = UPLOAD_CHUNK_BYTES + BASE64_CHUNK_BYTES;
+    return stats;
+}
+
+TransportStats LLMClient::GetTransportStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return transport_stats_;
+}
+
+std::vector<EndpointHealth> LLMClient::GetEndpointHealth() const {
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    std::vector<EndpointHealth> health;
+    for (const Endpoint& ep : endpoints_) {
+        EndpointHealth h;
+        h.model = ep.model;
+        h.state = ep.breaker.GetState();
+        h.consecutive_failures = ep.breaker.ConsecutiveFailures();
+        h.trips = ep.breaker.Trips();
+        health.push_back(h);
+    }
+    return health;
+}
+
+HttpConnectionPool::Headers LLMClient::BuildHeaders(bool stream) const {
+    HttpConnectionPool::Headers headers = {
+        {"Content-Type", "application/json"},
+        {"Authorization", "Bearer " + api_key_},
+    };
+    if (stream) {
+        headers.push_back({"Accept", "text/event-stream"});
+    }
+    return headers;
+}
+
+int LLMClient::PostRequest(const std::string& url, const std::string& body,
+                           ResponseBuffer& response, int timeout_ms) {
+    ESP_LOGI(TAG, "POST %s", url.c_str());
+    ESP_LOGD(TAG, "Body: %s", body.c_str());
+
+    // 经连接池发送，同一主机的请求复用已建立的 TLS 连接；
+    // 响应体逐段追加，chunked 和未知长度的响应同样完整
+    response.Clear();
+    int status = HttpConnectionPool::GetInstance().Post(
+        url, body, BuildHeaders(false),
+        [&response](const char* data, size_t length) { response.Append(data, length); },
+        timeout_ms);
+    ESP_LOGD(TAG, "Response: %zu bytes", response.Size());
+    return status;
+}
+
+int LLMClient::PostStream(const std::string& url, const std::string& body,
+                          const HttpConnectionPool::DataHandler& on_data, int timeout_ms,
+                          const std::atomic<bool>* cancel) {
+    ESP_LOGI(TAG, "POST (stream) %s", url.c_str());
+
+    // 连接池在 HTTP_EVENT_ON_DATA 中逐段转发响应体，不像 esp_http_client_read
+    // 那样要攒满缓冲区才返回，首 token 不被延后
+    return HttpConnectionPool::GetInstance().Post(url, body, BuildHeaders(true), on_data,
+                                                  timeout_ms, cancel);
+}
+
 } // namespace EvoSpark
@@ -4,19 +4,136 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <cstdint>
 #include "memory_types.h"
+#include "http_pool.h"
+#include "response_buffer.h"
+#include "retry_policy.h"
+#include "circuit_breaker.h"
+#include "model_router.h"
+#include "request_queue.h"
+#include "token_ledger.h"
+#include "structured_output.h"
+#include "link_quality.h"
 
 namespace EvoSpark {
 
+class JsonReader;
+
 // LLM 响应
 struct LLMResponse {
     std::string content;
     bool success = false;
     std::string error_message;
     int tokens_used = 0;
+    int prompt_tokens = 0;
+    int completion_tokens = 0;
+    int cached_tokens = 0;       // 命中服务端前缀缓存的 prompt token
+    uint32_t latency_ms = 0;     // 请求耗时（含重试和退避等待）
+    uint32_t ttft_ms = 0;        // 首 token 延迟（仅流式请求）
+    LLMError error = LLMError::NONE;
+    int http_status = 0;         // 最后一次尝试的状态码，网络错误为 -1
+    int attempts = 0;
+    std::string model;           // 实际应答的模型
+    bool hedged = false;         // 由对冲请求应答
+};
+
+// 前缀缓存统计
+struct PromptCacheStats {
+    uint32_t requests = 0;
+    uint32_t cache_hits = 0;          // cached_tokens > 0 的请求数
+    uint64_t prompt_tokens = 0;
+    uint64_t cached_tokens = 0;
+    uint64_t hit_latency_ms = 0;      // 命中请求的累计耗时
+    uint64_t miss_latency_ms = 0;     // 未命中请求的累计耗时
+};
+
+// 流式响应统计
+struct StreamStats {
+    uint32_t streams = 0;             // 成功的流式请求数
+    uint32_t failures = 0;
+    uint64_t chunks = 0;              // 收到的增量片段数
+    uint64_t ttft_total_ms = 0;       // 首 token 延迟累计
+    uint32_t ttft_min_ms = 0;
+    uint32_t ttft_max_ms = 0;
+    uint32_t last_ttft_ms = 0;
+};
+
+// 传输层统计：重试、熔断、对冲与各类错误次数
+struct TransportStats {
+    uint32_t requests = 0;
+    uint32_t failures = 0;            // 重试用尽仍失败的请求
+    uint32_t retries = 0;
+    uint32_t fallbacks = 0;           // 用备用模型发出的尝试
+    uint32_t short_circuits = 0;      // 因熔断跳过的候选模型
+    uint32_t hedges = 0;              // 发出的对冲请求
+    uint32_t hedge_wins = 0;          // 对冲请求先出 token
+    uint32_t chitchat = 0;            // 路由到快速模型的闲聊
+    uint32_t network_errors = 0;
+    uint32_t rate_limited = 0;
+    uint32_t server_errors = 0;
+    uint32_t invalid_responses = 0;
+};
+
+// 图像请求统计
+struct VisionStats {
+    uint32_t requests = 0;            // 带图像的请求
+    uint32_t failures = 0;
+    uint32_t uploads = 0;             // 上传次数（含重试）
+    uint64_t image_bytes = 0;         // 上传的 JPEG 字节数
+    uint64_t body_bytes = 0;          // 实际写出的请求体（JSON + base64）
+    uint64_t upload_total_ms = 0;     // 写出请求体的累计耗时
+    uint32_t last_upload_ms = 0;
+    uint32_t max_upload_ms = 0;
+    uint32_t heap_peak_bytes = 0;     // 上传期间空闲堆的最大降幅（全系统采样，含其他任务）
+    uint32_t scratch_bytes = 0;       // 上传占用的固定缓冲区（与图像大小无关）
+};
+
+// 请求附带的图像（JPEG）：只引用调用方的内存（如摄像头帧缓冲），不复制，
+// 调用方保证请求结束前有效
+struct ImageInput {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// 端点（模型）健康状态
+struct EndpointHealth {
+    std::string model;
+    CircuitBreaker::State state = CircuitBreaker::State::CLOSED;
+    uint32_t consecutive_failures = 0;
+    uint32_t trips = 0;
 };
 
 // LLM 客户端（支持多模态）
+//
+// 每个请求先由 ModelRouter 选出候选模型，再经重试循环发出：暂时性错误
+// （网络、429、5xx、残缺响应）按 full jitter 指数退避重试，受 RetryPolicy
+// 的次数和总时限约束；429/5xx 换下一个候选模型，网络错误原模型重试。
+// 每个模型（同一 base_url 下即一个端点）有一个熔断器，连续失败后直接跳过。
+//
+// 所有请求都在 RequestQueue 的网络任务上执行：Submit 立即返回，结果经
+// 回调或 future 交付；同步接口（Chat、ChatStream、CompressMemory）只是
+// 提交后等待，仍按优先级排队。
+//
+// 带 schema 的请求要求结构化输出：请求体带 response_format，内部改走流式，
+// 增量边到边交给 StructuredOutputValidator，一旦违反约定就断开连接，不再为
+// 注定作废的输出付 token。JSON 前后的代码块标记和说明文字在本地剥离；只有
+// 本地无法挽回时（类型不符、缺字段、截断、超长）才带着错误说明发一次修复
+// 请求。端点对 response_format 返回 400 时该端点改为只靠提示词。
+//
+// 带图像的请求走视觉模型。请求体不在内存里拼出来：先按同样的写法数一遍
+// 字节得出 Content-Length，再边写边发，base64 直接从调用方的图像内存
+// （摄像头帧缓冲）分段编码进一块固定的写缓冲区，峰值内存与图像大小无关。
+//
+// 交互流式请求可对冲：发出后 hedge_after_ms 仍没有收到任何字节，就在另一
+// 个连接上再发一份，谁先出 token 用谁，另一路的输出丢弃。对冲只在首字节
+// 之前触发，已开始输出的流中途断开时不重试（调用方已经显示了部分内容）。
+// 对冲等待和交互流式请求的超时取自 LinkQuality：按平滑后的首 token 延迟
+// 及其偏差算出，弱信号下卡住的连接不必等满 HTTP_TIMEOUT_MS 才重试。
 class LLMClient {
 public:
     static LLMClient& GetInstance() {
@@ -27,45 +144,210 @@ public:
     // 初始化
     bool Init(const std::string& api_key, const std::string& base_url = "");
 
-    // 发送对话请求
+    // 流式响应（SSE）：每个增量片段回调一次，结束时（成功或失败）以 is_done=true 回调一次
+    using StreamCallback = std::function<void(const std::string& chunk, bool is_done)>;
+
+    // 异步请求
+    struct Request {
+        LLMTask task = LLMTask::CHAT;
+        std::vector<Message> messages;
+        StreamCallback on_chunk;                 // 非空时走流式（在网络任务上回调）
+        RequestPriority priority = RequestPriority::INTERACTIVE;
+        uint32_t deadline_ms = 0;                // 从提交起算，含排队；0 只受重试策略时限约束
+        TokenPurpose purpose = TokenPurpose::CHAT;   // 记账用途（压缩任务总记为 COMPRESSION）
+        const JsonSchema* schema = nullptr;      // 非空时要求结构化输出，content 为校验过的 JSON
+        ImageInput image;                        // 非空时附在最后一条用户消息上（不走流式，
+                                                 // on_chunk 在结束时收到整段回复）
+    };
+    using CompletionCallback = std::function<void(const LLMResponse& response)>;
+
+    // 提交请求，结束（成功、失败、过期）时回调 on_complete。回调在网络任务
+    // 上执行，队列满被拒绝时在调用方任务上立即执行
+    void Submit(Request request, CompletionCallback on_complete);
+
+    // 提交请求，结果经 future 交付
+    std::future<LLMResponse> Submit(Request request);
+
+    // 发送对话请求（同步）
     LLMResponse Chat(const std::vector<Message>& messages);
 
-    // 发送多模态请求（带图像）
+    // 发送多模态请求（带 JPEG 图像，附在最后一条用户消息上）
     LLMResponse ChatWithImage(const std::vector<Message>& messages,
                               const std::vector<uint8_t>& image_data);
 
-    // 流式响应
-    using StreamCallback = std::function<void(const std::string& chunk, bool is_done)>;
+    // 同上，直接引用调用方的图像内存（如 CameraFrame），不复制
+    LLMResponse ChatWithImage(const std::vector<Message>& messages,
+                              const uint8_t* jpeg, size_t size);
+
+    // 流式响应（同步）
     LLMResponse ChatStream(const std::vector<Message>& messages,
                            StreamCallback callback);
 
-    // 压缩记忆
-    LLMResponse CompressMemory(const std::string& prompt);
+    // 压缩记忆；schema 非空时按结构化输出校验
+    LLMResponse CompressMemory(const std::string& prompt, const JsonSchema* schema = nullptr);
 
     // 是否已初始化
     bool IsInitialized() const { return initialized_; }
 
-    // 设置模型
-    void SetModel(const std::string& model) { model_ = model; }
+    // 前缀缓存统计
+    PromptCacheStats GetCacheStats() const;
+
+    // 流式响应统计（首 token 延迟）
+    StreamStats GetStreamStats() const;
+
+    // 传输层统计与各模型熔断状态
+    TransportStats GetTransportStats() const;
+    std::vector<EndpointHealth> GetEndpointHealth() const;
+
+    // 结构化输出统计（失败率、修复次数、浪费的 token）
+    StructuredOutputStats GetStructuredOutputStats() const;
+
+    // 图像请求统计（上传耗时与内存）
+    VisionStats GetVisionStats() const;
+
+    // 怎样向服务端要求结构化输出（默认 json_object）
+    void SetStructuredOutputMode(StructuredOutputMode mode) { structured_mode_ = mode; }
+
+    // 设置主对话模型
+    void SetModel(const std::string& model);
+
+    // 设置模型路由规则
+    void SetRoutingRules(const ModelRouter::Rules& rules);
+
+    // 固定对冲等待时间，0 关闭对冲（默认按 LinkQuality 估计的首字节延迟调整）
+    void SetHedgeDelay(uint32_t ms) {
+        hedge_after_ms_ = ms;
+        adaptive_hedge_ = false;
+    }
+
+    static constexpr uint32_t HEDGE_AFTER_MS = 2000;   // 约为正常链路首字节延迟的 p95
+    static constexpr int HTTP_TIMEOUT_MS = 30000;      // 单次尝试上限，再按剩余时限收紧
+                                                       // （交互流式请求按链路估计再收紧）
+    static constexpr int MAX_TOKENS = 2000;
+    static constexpr int ECONOMY_MAX_TOKENS = 400;     // 接近 token 预算时的对话回复上限
+    static constexpr int MAX_REPAIRS = 1;              // 结构化输出不合格时的修复请求次数
+    static constexpr size_t REPAIR_ECHO_BYTES = 2048;  // 修复请求里附带的上次输出上限
+    static constexpr size_t UPLOAD_CHUNK_BYTES = 1024; // 图像请求体的写缓冲区（网络任务栈上）
 
 private:
     LLMClient() = default;
     ~LLMClient() = default;
 
-    // HTTP POST 请求
-    bool PostRequest(const std::string& url, const std::string& body,
-                     std::string& response);
+    struct StreamRace;
+    struct LaneArg;
+    struct StructuredPass;
+    struct Endpoint {
+        std::string model;
+        CircuitBreaker breaker;
+        bool response_format_ok = true;   // 未因 response_format 返回过 400
+    };
+
+    // 在网络任务上执行一个请求
+    LLMResponse Run(const Request& request, int64_t deadline_us);
+
+    // 结构化输出请求：流式校验，必要时发修复请求
+    LLMResponse RunStructured(const Request& request, int64_t deadline_us);
+
+    // 提交并等待（已在网络任务上时直接执行，避免等待自己）
+    LLMResponse Await(Request request);
+
+    // 路由 + 重试 + 熔断；callback 非空时走流式。deadline_us 为 0 时只受策略时限约束。
+    // schema 非空时请求体带 response_format；cancel 置位时断开流并返回 SCHEMA_VIOLATION。
+    // image 非空时分段上传（不走流式，callback 须为空）
+    LLMResponse Execute(LLMTask task, const std::vector<Message>& messages,
+                        const StreamCallback* callback, int64_t deadline_us,
+                        const JsonSchema* schema = nullptr,
+                        const std::atomic<bool>* cancel = nullptr,
+                        const ImageInput* image = nullptr);
+
+    // 单次非流式请求
+    LLMResponse RequestOnce(const std::string& url, const std::string& body, int timeout_ms);
+
+    // 单次图像请求：请求体边编码边写出
+    LLMResponse UploadOnce(const std::string& url, const std::vector<Message>& messages,
+                           const std::string& model, int max_tokens, const ImageInput& image,
+                           int timeout_ms);
+
+    // 单次流式请求（交互请求可带对冲，hedge_after_ms 为 0 不对冲）；
+    // delivered 返回是否已有增量交给调用方。对冲时输掉的一路按 purpose 记账，
+    // 没收到 usage 时请求按 prompt_estimate 计
+    LLMResponse StreamAttempt(const std::string& url, const std::string& body,
+                              const StreamCallback& callback, uint32_t hedge_after_ms,
+                              int timeout_ms,
+                              int64_t turn_start_us, bool& delivered,
+                              const std::atomic<bool>* cancel, TokenPurpose purpose,
+                              int prompt_estimate);
+
+    // 竞速中的一路流式请求（lane 0 主请求，1 对冲请求）
+    LLMResponse StreamOnce(const std::shared_ptr<StreamRace>& race, int lane);
+    static void RecordLoser(StreamRace& race, int lane, const LLMResponse& response);
+    bool StartLane(const std::shared_ptr<StreamRace>& race, int lane);
+    static void LaneTask(void* arg);
+
+    // 从 preferred 开始找第一个未熔断的候选模型
+    bool AcquireModel(const std::vector<std::string>& candidates, size_t preferred,
+                      std::string& model, size_t& index);
+
+    // 把一次尝试的结果报告给对应模型的熔断器
+    void ReportOutcome(const std::string& model, LLMError error);
+    Endpoint& EndpointLocked(const std::string& model);
+
+    // HTTP POST 请求，返回状态码（网络错误为 -1）
+    int PostRequest(const std::string& url, const std::string& body,
+                    ResponseBuffer& response, int timeout_ms);
+
+    // HTTP POST 请求，响应体边收边交给 on_data
+    int PostStream(const std::string& url, const std::string& body,
+                   const HttpConnectionPool::DataHandler& on_data, int timeout_ms,
+                   const std::atomic<bool>* cancel = nullptr);
+
+    // 请求头（鉴权 + 内容类型）
+    HttpConnectionPool::Headers BuildHeaders(bool stream) const;
 
     // 构建请求 JSON
-    std::string BuildRequestJson(const std::vector<Message>& messages);
+    std::string BuildRequestJson(const std::vector<Message>& messages, const std::string& model,
+                                 bool stream, int max_tokens,
+                                 const JsonSchema* schema = nullptr,
+                                 StructuredOutputMode mode = StructuredOutputMode::NONE);
 
     // 解析响应 JSON
-    bool ParseResponseJson(const std::string& json, LLMResponse& response);
+    bool ParseResponseJson(const char* json, size_t length, LLMResponse& response);
+
+    // 解析一个 SSE 事件：取出 choices[0].delta.content，末尾事件带 usage
+    bool ParseStreamChunk(JsonReader& reader, const std::string& json,
+                          std::string& delta, LLMResponse& response);
+
+    // 记录 usage 与前缀缓存命中
+    void RecordUsage(const LLMResponse& response);
+
+    // gzip：请求体压缩按端点协商，服务端不支持时自动退回明文；
+    // 压缩率和耗时见连接池的端点统计，Wi-Fi 不是瓶颈时可关掉省 CPU
+    static constexpr bool GZIP_REQUESTS = true;
+    static constexpr bool GZIP_RESPONSES = true;
 
     std::string api_key_;
     std::string base_url_ = "https://open.bigmodel.cn/api/paas/v4";
-    std::string model_ = "glm-4-flash";
     bool initialized_ = false;
+
+    ModelRouter router_;
+    std::vector<Endpoint> endpoints_;
+    mutable std::mutex route_mutex_;         // 保护 router_ 和 endpoints_
+
+    RetryPolicy chat_policy_;                                   // 交互：少试几次，等待短
+    RetryPolicy compression_policy_ = {5, 1000, 30000, 5000, 180000};  // 后台：等得起
+    uint32_t hedge_after_ms_ = HEDGE_AFTER_MS;
+    bool adaptive_hedge_ = true;
+    StructuredOutputMode structured_mode_ = StructuredOutputMode::JSON_OBJECT;
+
+    ResponseBuffer response_buffer_;     // 非流式响应复用的缓冲区
+    std::mutex buffer_mutex_;
+
+    PromptCacheStats cache_stats_;
+    StreamStats stream_stats_;
+    TransportStats transport_stats_;
+    StructuredOutputStats structured_stats_;
+    VisionStats vision_stats_;
+    mutable std::mutex stats_mutex_;
 };
 
 } // namespace EvoSpark
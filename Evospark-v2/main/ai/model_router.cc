@@ -0,0 +1,74 @@
+#include "model_router.h"
+
+namespace EvoSpark {
+
+namespace {
+
+// UTF-8 字符数（只数首字节，非续字节）
+size_t CountChars(const std::string& text) {
+    size_t count = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void AddUnique(std::vector<std::string>& models, const std::string& model) {
+    if (model.empty()) {
+        return;
+    }
+    for (const std::string& m : models) {
+        if (m == model) {
+            return;
+        }
+    }
+    models.push_back(model);
+}
+
+} // namespace
+
+bool ModelRouter::IsChitChat(const std::vector<Message>& messages) const {
+    if (messages.empty() || messages.back().role != Role::USER) {
+        return false;
+    }
+    const std::string& input = messages.back().content;
+    if (input.empty() || CountChars(input) > rules_.chitchat_max_chars) {
+        return false;
+    }
+    // 提问往往需要更强的模型，哪怕很短
+    return input.find('?') == std::string::npos && input.find("？") == std::string::npos;
+}
+
+std::vector<std::string> ModelRouter::Route(LLMTask task,
+                                            const std::vector<Message>& messages,
+                                            bool economy) const {
+    std::vector<std::string> models;
+    switch (task) {
+        case LLMTask::COMPRESSION:
+            AddUnique(models, rules_.compression_model);
+            AddUnique(models, rules_.chat_model);
+            AddUnique(models, rules_.fast_model);
+            break;
+        case LLMTask::CHAT:
+            if (economy) {
+                AddUnique(models, rules_.compression_model);
+            }
+            if (IsChitChat(messages)) {
+                AddUnique(models, rules_.fast_model);
+                AddUnique(models, rules_.chat_model);
+            } else {
+                AddUnique(models, rules_.chat_model);
+                AddUnique(models, rules_.fast_model);
+            }
+            break;
+        case LLMTask::VISION:
+            // 纯文本模型看不到图像，换过去只会答非所问
+            AddUnique(models, rules_.vision_model);
+            break;
+    }
+    return models;
+}
+
+} // namespace EvoSpark
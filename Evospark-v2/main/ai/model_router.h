@@ -0,0 +1,56 @@
+#ifndef MODEL_ROUTER_H
+#define MODEL_ROUTER_H
+
+#include <string>
+#include <vector>
+#include "memory_types.h"
+
+namespace EvoSpark {
+
+// 请求类别
+enum class LLMTask {
+    CHAT,           // 交互对话（按输入内容再细分）
+    COMPRESSION,    // 后台记忆压缩
+    VISION,         // 带图像的对话
+};
+
+// 模型路由：按请求类别和输入选模型，返回按优先级排列的候选列表
+//
+// - 简短闲聊（最后一条用户消息不超过 chitchat_max_chars 个字且不是提问）
+//   走最快的模型，首 token 最早
+// - 其他对话走主对话模型
+// - 记忆压缩在后台运行，不在乎延迟，走最便宜的模型（默认对话模型已是
+//   免费档，两者相同；对话换成付费模型时压缩仍留在免费档）
+// - 接近 token 预算（economy）时对话也先走压缩用的最便宜模型
+// - 带图像的请求只能走视觉模型，没有备用
+//
+// 每个列表后面跟着备用模型：首选模型熔断或被限流时，LLMClient 依次换用。
+class ModelRouter {
+public:
+    struct Rules {
+        std::string chat_model = "glm-4-flash";
+        std::string fast_model = "glm-4-flashx";
+        std::string compression_model = "glm-4-flash";
+        std::string vision_model = "glm-4v-flash";
+        size_t chitchat_max_chars = 20;   // 按 UTF-8 字符计
+    };
+
+    void SetRules(const Rules& rules) { rules_ = rules; }
+    const Rules& GetRules() const { return rules_; }
+
+    // 主对话模型（兼容原来的 SetModel）
+    void SetChatModel(const std::string& model) { rules_.chat_model = model; }
+
+    std::vector<std::string> Route(LLMTask task, const std::vector<Message>& messages,
+                                   bool economy = false) const;
+
+    // 是否为简短闲聊
+    bool IsChitChat(const std::vector<Message>& messages) const;
+
+private:
+    Rules rules_;
+};
+
+} // namespace EvoSpark
+
+#endif // MODEL_ROUTER_H
@@ -0,0 +1,69 @@
+#include "retry_policy.h"
+#include "esp_random.h"
+#include <algorithm>
+
+namespace EvoSpark {
+
+const char* LLMErrorToString(LLMError error) {
+    switch (error) {
+        case LLMError::NONE: return "none";
+        case LLMError::NOT_INITIALIZED: return "not_initialized";
+        case LLMError::NETWORK: return "network";
+        case LLMError::RATE_LIMITED: return "rate_limited";
+        case LLMError::SERVER: return "server";
+        case LLMError::AUTH: return "auth";
+        case LLMError::BAD_REQUEST: return "bad_request";
+        case LLMError::INVALID_RESPONSE: return "invalid_response";
+        case LLMError::CIRCUIT_OPEN: return "circuit_open";
+        case LLMError::DEADLINE: return "deadline";
+        case LLMError::OVERLOADED: return "overloaded";
+        case LLMError::SCHEMA_VIOLATION: return "schema_violation";
+        default: return "unknown";
+    }
+}
+
+LLMError ClassifyStatus(int status) {
+    if (status == 200) {
+        return LLMError::NONE;
+    }
+    if (status < 0) {
+        return LLMError::NETWORK;
+    }
+    if (status == 429) {
+        return LLMError::RATE_LIMITED;
+    }
+    if (status == 401 || status == 403) {
+        return LLMError::AUTH;
+    }
+    if (status == 408) {
+        return LLMError::NETWORK;  // 服务端等请求体超时，同样是链路问题
+    }
+    if (status >= 500) {
+        return LLMError::SERVER;
+    }
+    return LLMError::BAD_REQUEST;
+}
+
+bool IsRetryable(LLMError error) {
+    switch (error) {
+        case LLMError::NETWORK:
+        case LLMError::RATE_LIMITED:
+        case LLMError::SERVER:
+        case LLMError::INVALID_RESPONSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t RetryPolicy::DelayMs(int retry, LLMError error) const {
+    int shift = std::min(std::max(retry - 1, 0), 16);
+    uint64_t cap = std::min<uint64_t>(static_cast<uint64_t>(base_delay_ms) << shift, max_delay_ms);
+    uint32_t delay = cap ? static_cast<uint32_t>(esp_random() % (cap + 1)) : 0;
+    if (error == LLMError::RATE_LIMITED) {
+        delay = std::max(delay, rate_limit_delay_ms);
+    }
+    return delay;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,50 @@
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <cstdint>
+
+namespace EvoSpark {
+
+// LLM 请求错误分类
+enum class LLMError {
+    NONE,
+    NOT_INITIALIZED,
+    NETWORK,            // 连接失败、超时、连接中途断开
+    RATE_LIMITED,       // 429
+    SERVER,             // 5xx
+    AUTH,               // 401 / 403
+    BAD_REQUEST,        // 其他 4xx：请求本身有问题，重试无用
+    INVALID_RESPONSE,   // 响应不完整或无法解析
+    CIRCUIT_OPEN,       // 所有候选模型都处于熔断
+    DEADLINE,           // 超过调用方给的截止时间（排队或重试中）
+    OVERLOADED,         // 请求队列已满
+    SCHEMA_VIOLATION,   // 结构化输出不符合约定（流式校验中止或结束后校验失败）
+};
+
+const char* LLMErrorToString(LLMError error);
+
+// HTTP 状态码（网络错误为 -1）归类
+LLMError ClassifyStatus(int status);
+
+// 是否值得重试：网络、限流、服务端错误和残缺响应是暂时性的
+bool IsRetryable(LLMError error);
+
+// 重试策略
+struct RetryPolicy {
+    int max_attempts = 3;
+    uint32_t base_delay_ms = 300;       // 第一次重试前的退避上限
+    uint32_t max_delay_ms = 4000;
+    uint32_t rate_limit_delay_ms = 1500; // 429 的最小等待
+    uint32_t deadline_ms = 45000;       // 整个请求（含重试和等待）的时限
+
+    // 第 retry 次重试（从 1 开始）前的等待时间
+    //
+    // full jitter：在 [0, min(max, base * 2^(retry-1))] 内均匀取值。多个请求
+    // 同时失败时（Wi-Fi 抖动、服务端过载）各自错开，不会同时再次打过去。
+    // 限流时至少等 rate_limit_delay_ms。
+    uint32_t DelayMs(int retry, LLMError error) const;
+};
+
+} // namespace EvoSpark
+
+#endif // RETRY_POLICY_H
@@ -0,0 +1,519 @@
+#include "voice_channel.h"
+#include "json_codec.h"
+#include "esp_crt_bundle.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace EvoSpark {
+
+static const char* TAG = "VoiceChannel";
+
+namespace {
+
+constexpr EventBits_t CONNECTED_BIT = 1 << 0;
+constexpr EventBits_t HELLO_BIT = 1 << 1;
+constexpr EventBits_t CLOSED_BIT = 1 << 2;
+
+constexpr uint8_t OPCODE_CONTINUATION = 0x0;
+constexpr uint8_t OPCODE_TEXT = 0x1;
+constexpr uint8_t OPCODE_BINARY = 0x2;
+
+uint32_t ElapsedMs(int64_t since_us) {
+    return static_cast<uint32_t>((esp_timer_get_time() - since_us) / 1000);
+}
+
+const char* ListenModeToString(ListenMode mode) {
+    switch (mode) {
+        case ListenMode::AUTO: return "auto";
+        case ListenMode::MANUAL: return "manual";
+        case ListenMode::REALTIME: return "realtime";
+    }
+    return "auto";
+}
+
+// 服务端消息里用到的字段：第一层的 type / session_id / state / text /
+// emotion，以及 hello 里 audio_params 对象的三个数字
+class ServerMessage : public JsonHandler {
+public:
+    std::string type;
+    std::string session_id;
+    std::string state;
+    std::string text;
+    std::string emotion;
+    VoiceAudioParams audio_params;
+    bool has_audio_params = false;
+
+    bool OnKey(const char* key, size_t length) override {
+        key_.assign(key, length);
+        return true;
+    }
+
+    bool OnString(const char* value, size_t length) override {
+        if (depth_ == 1) {
+            if (key_ == "type") {
+                type.assign(value, length);
+            } else if (key_ == "session_id") {
+                session_id.assign(value, length);
+            } else if (key_ == "state") {
+                state.assign(value, length);
+            } else if (key_ == "text") {
+                text.assign(value, length);
+            } else if (key_ == "emotion") {
+                emotion.assign(value, length);
+            }
+        }
+        return true;
+    }
+
+    bool OnNumber(double value, const char* raw, size_t raw_length) override {
+        if (depth_ == 2 && in_audio_params_) {
+            int number = static_cast<int>(value);
+            if (key_ == "sample_rate") {
+                audio_params.sample_rate = number;
+            } else if (key_ == "channels") {
+                audio_params.channels = number;
+            } else if (key_ == "frame_duration") {
+                audio_params.frame_duration_ms = number;
+            }
+        }
+        return true;
+    }
+
+    bool OnBeginObject() override {
+        depth_++;
+        if (depth_ == 2 && key_ == "audio_params") {
+            in_audio_params_ = true;
+            has_audio_params = true;
+        }
+        return true;
+    }
+
+    bool OnEndObject() override {
+        if (depth_ == 2) {
+            in_audio_params_ = false;
+        }
+        depth_--;
+        return true;
+    }
+
+    bool OnBeginArray() override { depth_++; return true; }
+    bool OnEndArray() override { depth_--; return true; }
+
+private:
+    std::string key_;
+    int depth_ = 0;
+    bool in_audio_params_ = false;
+};
+
+} // namespace
+
+VoiceChannel::~VoiceChannel() {
+    Close();
+    if (events_) {
+        vEventGroupDelete(events_);
+    }
+}
+
+void VoiceChannel::Configure(const VoiceChannelConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+void VoiceChannel::SetServer(const std::string& url, const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_.url = url;
+    config_.token = token;
+}
+
+bool VoiceChannel::IsConfigured() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !config_.url.empty();
+}
+
+bool VoiceChannel::Open(const VoiceAudioParams& uplink, const Callbacks& callbacks) {
+    Close();
+
+    VoiceChannelConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+        session_id_.clear();
+        downlink_ = VoiceAudioParams();
+    }
+    if (config.url.empty()) {
+        return false;
+    }
+    if (!events_) {
+        events_ = xEventGroupCreate();
+        if (!events_) {
+            return false;
+        }
+    }
+    xEventGroupClearBits(events_, CONNECTED_BIT | HELLO_BIT | CLOSED_BIT);
+
+    callbacks_ = callbacks;
+    closing_ = false;
+    message_.clear();
+    awaiting_reply_ = false;
+    last_voiced_us_ = 0;
+
+    std::string headers;
+    if (!config.token.empty()) {
+        headers += "Authorization: Bearer " + config.token + "\r\n";
+    }
+    headers += "Protocol-Version: " + std::to_string(PROTOCOL_VERSION) + "\r\n";
+    headers += "Device-Id: " + config.device_id + "\r\n";
+    headers += "Client-Id: " + config.client_id + "\r\n";
+
+    esp_websocket_client_config_t ws_config = {};
+    ws_config.uri = config.url.c_str();
+    ws_config.headers = headers.c_str();
+    ws_config.buffer_size = 2048;                 // 60 ms 的 Opus 帧一般不到 300 字节
+    ws_config.task_stack = 6144;
+    ws_config.network_timeout_ms = CONNECT_TIMEOUT_MS;
+    ws_config.disable_auto_reconnect = true;      // 重连后要重新 hello，由会话决定
+    if (config.url.compare(0, 6, "wss://") == 0) {
+        ws_config.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+
+    int64_t start = esp_timer_get_time();
+    client_ = esp_websocket_client_init(&ws_config);
+    if (!client_) {
+        ESP_LOGE(TAG, "Failed to create WebSocket client");
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connect_failures++;
+        return false;
+    }
+    esp_websocket_register_events(client_, WEBSOCKET_EVENT_ANY, &EventHandler, this);
+
+    if (esp_websocket_client_start(client_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start WebSocket client");
+        Destroy();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connect_failures++;
+        return false;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(events_, CONNECTED_BIT | CLOSED_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(CONNECT_TIMEOUT_MS));
+    if (!(bits & CONNECTED_BIT) || (bits & CLOSED_BIT)) {
+        ESP_LOGE(TAG, "Failed to connect to %s", config.url.c_str());
+        Destroy();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connect_failures++;
+        return false;
+    }
+
+    // 设备 hello：声明上行音频参数
+    std::string hello;
+    JsonWriteTo(hello, [&uplink](auto& w) {
+        w.BeginObject();
+        w.Field("type", "hello");
+        w.Field("version", PROTOCOL_VERSION);
+        w.Field("transport", "websocket");
+        w.Key("audio_params");
+        w.BeginObject();
+        w.Field("format", "opus");
+        w.Field("sample_rate", uplink.sample_rate);
+        w.Field("channels", uplink.channels);
+        w.Field("frame_duration", uplink.frame_duration_ms);
+        w.EndObject();
+        w.EndObject();
+    });
+    if (!SendJson(hello)) {
+        Destroy();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connect_failures++;
+        return false;
+    }
+
+    bits = xEventGroupWaitBits(events_, HELLO_BIT | CLOSED_BIT, pdFALSE, pdFALSE,
+                               pdMS_TO_TICKS(HELLO_TIMEOUT_MS));
+    if (!(bits & HELLO_BIT)) {
+        ESP_LOGE(TAG, "Server hello %s", (bits & CLOSED_BIT) ? "failed, connection closed" : "timed out");
+        Destroy();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connect_failures++;
+        return false;
+    }
+
+    open_ = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.sessions++;
+    stats_.last_handshake_ms = ElapsedMs(start);
+    ESP_LOGI(TAG, "Voice session %s open in %u ms (downlink %d Hz, %d ms frames)",
+             session_id_.c_str(), static_cast<unsigned>(stats_.last_handshake_ms),
+             downlink_.sample_rate, downlink_.frame_duration_ms);
+    return true;
+}
+
+void VoiceChannel::Close() {
+    if (!client_) {
+        return;
+    }
+    closing_ = true;
+    open_ = false;
+    if (esp_websocket_client_is_connected(client_)) {
+        esp_websocket_client_close(client_, pdMS_TO_TICKS(1000));
+    }
+    Destroy();
+    ESP_LOGI(TAG, "Voice session closed");
+}
+
+void VoiceChannel::Destroy() {
+    if (client_) {
+        esp_websocket_client_destroy(client_);
+        client_ = nullptr;
+    }
+}
+
+VoiceAudioParams VoiceChannel::GetDownlinkParams() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return downlink_;
+}
+
+bool VoiceChannel::SendJson(const std::string& json) {
+    if (!client_ || !esp_websocket_client_is_connected(client_)) {
+        return false;
+    }
+    int sent = esp_websocket_client_send_text(client_, json.data(), static_cast<int>(json.size()),
+                                              pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+    if (sent < 0) {
+        ESP_LOGW(TAG, "Failed to send control message");
+        return false;
+    }
+    return true;
+}
+
+template<typename Fill>
+bool VoiceChannel::SendMessage(const char* type, Fill&& fill) {
+    std::string session_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session_id = session_id_;
+    }
+    std::string json;
+    JsonWriteTo(json, [&](auto& w) {
+        w.BeginObject();
+        w.Field("session_id", session_id);
+        w.Field("type", type);
+        fill(w);
+        w.EndObject();
+    });
+    return SendJson(json);
+}
+
+bool VoiceChannel::StartListening(ListenMode mode) {
+    return SendMessage("listen", [mode](auto& w) {
+        w.Field("state", "start");
+        w.Field("mode", ListenModeToString(mode));
+    });
+}
+
+bool VoiceChannel::StopListening() {
+    return SendMessage("listen", [](auto& w) {
+        w.Field("state", "stop");
+    });
+}
+
+bool VoiceChannel::Abort() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        awaiting_reply_ = false;
+    }
+    return SendMessage("abort", [](auto& w) {});
+}
+
+bool VoiceChannel::SendAudio(const uint8_t* data, size_t length, bool voiced) {
+    if (!open_ || !client_) {
+        return false;
+    }
+    int sent = esp_websocket_client_send_bin(client_, reinterpret_cast<const char*>(data),
+                                             static_cast<int>(length), pdMS_TO_TICKS(SEND_TIMEOUT_MS));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sent < 0) {
+        stats_.frames_dropped++;
+        return false;
+    }
+    stats_.frames_sent++;
+    stats_.bytes_sent += length;
+    if (voiced) {
+        last_voiced_us_ = esp_timer_get_time();
+        awaiting_reply_ = true;
+    }
+    return true;
+}
+
+VoiceStats VoiceChannel::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void VoiceChannel::EventHandler(void* arg, esp_event_base_t base, int32_t event_id, void* event_data) {
+    VoiceChannel* self = static_cast<VoiceChannel*>(arg);
+    auto* data = static_cast<esp_websocket_event_data_t*>(event_data);
+
+    switch (event_id) {
+        case WEBSOCKET_EVENT_CONNECTED:
+            xEventGroupSetBits(self->events_, CONNECTED_BIT);
+            break;
+
+        case WEBSOCKET_EVENT_DATA:
+            self->OnData(data);
+            break;
+
+        case WEBSOCKET_EVENT_DISCONNECTED:
+        case WEBSOCKET_EVENT_CLOSED:
+        case WEBSOCKET_EVENT_ERROR: {
+            xEventGroupSetBits(self->events_, CLOSED_BIT);
+            bool was_open = self->open_.exchange(false);
+            if (was_open && !self->closing_) {
+                ESP_LOGW(TAG, "Voice session dropped");
+                {
+                    std::lock_guard<std::mutex> lock(self->mutex_);
+                    self->stats_.disconnects++;
+                }
+                if (self->callbacks_.on_closed) {
+                    self->callbacks_.on_closed();
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void VoiceChannel::OnData(const esp_websocket_event_data_t* data) {
+    uint8_t opcode = data->op_code;
+    if (opcode != OPCODE_TEXT && opcode != OPCODE_BINARY && opcode != OPCODE_CONTINUATION) {
+        return;     // close / ping / pong 由客户端组件处理
+    }
+
+    size_t length = static_cast<size_t>(std::max(data->data_len, 0));
+    size_t offset = static_cast<size_t>(std::max(data->payload_offset, 0));
+    size_t total = static_cast<size_t>(std::max(data->payload_len, 0));
+    bool frame_done = offset + length >= total;
+
+    // 常见情况：整条消息在一个事件里，不复制
+    if (opcode != OPCODE_CONTINUATION && offset == 0 && frame_done && data->fin) {
+        if (opcode == OPCODE_TEXT) {
+            OnText(data->data_ptr, length);
+        } else {
+            OnBinary(reinterpret_cast<const uint8_t*>(data->data_ptr), length);
+        }
+        return;
+    }
+
+    // 超过接收缓冲区的帧分多个事件到达（payload_offset 递增）；分片消息
+    // 的后续帧操作码为 0
+    if (opcode != OPCODE_CONTINUATION && offset == 0) {
+        message_.clear();
+        message_opcode_ = opcode;
+    }
+    if (message_.size() + length > MAX_MESSAGE_BYTES) {
+        ESP_LOGW(TAG, "Message over %u bytes, dropped", static_cast<unsigned>(MAX_MESSAGE_BYTES));
+        message_.clear();
+        message_opcode_ = 0;
+        return;
+    }
+    if (message_opcode_ == 0) {
+        return;     // 丢弃中的消息剩余部分
+    }
+    message_.append(data->data_ptr, length);
+    if (!frame_done || !data->fin) {
+        return;
+    }
+
+    if (message_opcode_ == OPCODE_TEXT) {
+        OnText(message_.data(), message_.size());
+    } else {
+        OnBinary(reinterpret_cast<const uint8_t*>(message_.data()), message_.size());
+    }
+    message_.clear();
+    message_opcode_ = 0;
+}
+
+void VoiceChannel::OnText(const char* text, size_t length) {
+    ServerMessage message;
+    JsonReader reader;
+    if (reader.Parse(text, length, message) != JsonParseError::NONE) {
+        ESP_LOGW(TAG, "Malformed control message: %.*s", static_cast<int>(std::min<size_t>(length, 64)), text);
+        return;
+    }
+
+    if (message.type == "hello") {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            session_id_ = message.session_id;
+            if (message.has_audio_params) {
+                downlink_ = message.audio_params;
+            }
+        }
+        xEventGroupSetBits(events_, HELLO_BIT);
+        return;
+    }
+
+    if (message.type == "stt") {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (last_voiced_us_ > 0) {
+                stats_.stt_total_ms += ElapsedMs(last_voiced_us_);
+                stats_.stt_samples++;
+            }
+        }
+        if (callbacks_.on_stt) {
+            callbacks_.on_stt(message.text);
+        }
+    } else if (message.type == "llm") {
+        if (!message.emotion.empty() && callbacks_.on_emotion) {
+            callbacks_.on_emotion(message.emotion);
+        }
+    } else if (message.type == "tts") {
+        if (message.state == "start") {
+            if (callbacks_.on_tts_start) {
+                callbacks_.on_tts_start();
+            }
+        } else if (message.state == "sentence_start") {
+            if (callbacks_.on_sentence) {
+                callbacks_.on_sentence(message.text);
+            }
+        } else if (message.state == "stop") {
+            if (callbacks_.on_tts_stop) {
+                callbacks_.on_tts_stop();
+            }
+        }
+    } else {
+        ESP_LOGD(TAG, "Ignoring message type %s", message.type.c_str());
+    }
+}
+
+void VoiceChannel::OnBinary(const uint8_t* data, size_t length) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.frames_received++;
+        stats_.bytes_received += length;
+
+        // 说完后的第一帧回复音频：一次语音到语音延迟
+        if (awaiting_reply_ && last_voiced_us_ > 0) {
+            uint32_t ms = ElapsedMs(last_voiced_us_);
+            awaiting_reply_ = false;
+            stats_.turns++;
+            stats_.voice_total_ms += ms;
+            stats_.last_voice_ms = ms;
+            stats_.voice_max_ms = std::max(stats_.voice_max_ms, ms);
+            if (stats_.voice_min_ms == 0 || ms < stats_.voice_min_ms) {
+                stats_.voice_min_ms = ms;
+            }
+            ESP_LOGI(TAG, "Voice-to-voice latency %u ms", static_cast<unsigned>(ms));
+        }
+    }
+    if (callbacks_.on_audio) {
+        callbacks_.on_audio(data, length);
+    }
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,165 @@
+#ifndef VOICE_CHANNEL_H
+#define VOICE_CHANNEL_H
+
+#include <string>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "esp_websocket_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+namespace EvoSpark {
+
+// 实时语音服务端配置
+struct VoiceChannelConfig {
+    std::string url;                // ws:// 或 wss://
+    std::string token;              // Authorization: Bearer <token>，可为空
+    std::string device_id;          // Device-Id（一般为 WiFi MAC）
+    std::string client_id;          // Client-Id（设备上持久保存的 UUID）
+};
+
+// 一个方向的音频参数
+struct VoiceAudioParams {
+    int sample_rate = 16000;
+    int channels = 1;
+    int frame_duration_ms = 60;
+};
+
+// 拾音模式（listen 消息的 mode）
+enum class ListenMode {
+    AUTO,           // 服务端 VAD 判断说完，说完后设备继续听
+    MANUAL,         // 设备发 listen stop 表示说完
+    REALTIME,       // 全双工（需要回声消除，本板不用）
+};
+
+// 实时语音统计
+//
+// 语音到语音延迟：用户最后一帧有声音的上行帧发出，到回复的第一帧音频
+// 到达。它包含服务端 VAD 的尾部静音判断、ASR、LLM 首 token、TTS 首帧
+// 和一次单程网络，不含本地解码和 I2S 缓冲（约一帧）
+struct VoiceStats {
+    uint32_t sessions = 0;            // 握手成功的连接
+    uint32_t connect_failures = 0;    // 连接或握手失败
+    uint32_t disconnects = 0;         // 会话中途断开
+    uint32_t turns = 0;               // 收到回复音频的轮次
+    uint32_t frames_sent = 0;
+    uint32_t frames_received = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    uint32_t frames_dropped = 0;      // 发送失败或接收队列满丢掉的帧
+    uint32_t last_handshake_ms = 0;   // 连接 + hello 往返
+    uint64_t stt_total_ms = 0;        // 说完到收到识别文本
+    uint32_t stt_samples = 0;
+    uint64_t voice_total_ms = 0;      // 语音到语音延迟累计
+    uint32_t voice_min_ms = 0;
+    uint32_t voice_max_ms = 0;
+    uint32_t last_voice_ms = 0;
+};
+
+// xiaozhi 实时语音协议客户端（WebSocket 传输）
+//
+// 一条长连接上双向传 Opus 帧（二进制消息，协议版本 1：一帧就是一个 Opus
+// 包，不加头），控制消息是 JSON 文本：
+//   设备 → 服务端：hello、listen（start / stop / detect）、abort
+//   服务端 → 设备：hello、stt（识别文本）、llm（表情）、tts（start /
+//   sentence_start / stop）
+// 连接时带 Authorization、Protocol-Version、Device-Id、Client-Id 请求头；
+// 设备先发 hello 声明上行音频参数，服务端 hello 回复 session_id 和下行
+// 音频参数，HELLO_TIMEOUT_MS 内没有回复视为连接失败。之后的 JSON 消息都
+// 带 session_id。
+//
+// 说话的同时上行音频已经在路上，服务端边收边识别：比起说完再上传录音、
+// 识别、请求 LLM、再请求 TTS（每步一次往返），说完后只剩服务端处理和
+// 一次单程。回调都在 WebSocket 任务上执行，不要在里面阻塞。
+class VoiceChannel {
+public:
+    static VoiceChannel& GetInstance() {
+        static VoiceChannel instance;
+        return instance;
+    }
+
+    struct Callbacks {
+        std::function<void(const std::string& text)> on_stt;
+        std::function<void(const std::string& emotion)> on_emotion;
+        std::function<void()> on_tts_start;
+        std::function<void(const std::string& text)> on_sentence;
+        std::function<void()> on_tts_stop;
+        std::function<void(const uint8_t* data, size_t length)> on_audio;
+        std::function<void()> on_closed;          // 会话中途断开（Close 主动关闭时不调用；回调里不要调 Close）
+    };
+
+    void Configure(const VoiceChannelConfig& config);
+
+    // 只换服务端（网页修改配置后），下次 Open 生效
+    void SetServer(const std::string& url, const std::string& token);
+    bool IsConfigured() const;
+
+    // 连接并完成 hello 握手（阻塞，最长 CONNECT_TIMEOUT_MS + HELLO_TIMEOUT_MS）
+    bool Open(const VoiceAudioParams& uplink, const Callbacks& callbacks);
+    void Close();
+    bool IsOpen() const { return open_; }
+
+    // 服务端 hello 声明的下行音频参数
+    VoiceAudioParams GetDownlinkParams() const;
+
+    bool StartListening(ListenMode mode);
+    bool StopListening();
+    bool Abort();
+
+    // 发一帧 Opus；voiced 标记这一帧有人声（本地能量判断），用于计算语音到语音延迟
+    bool SendAudio(const uint8_t* data, size_t length, bool voiced);
+
+    VoiceStats GetStats() const;
+
+    static constexpr int PROTOCOL_VERSION = 1;
+    static constexpr uint32_t CONNECT_TIMEOUT_MS = 10000;
+    static constexpr uint32_t HELLO_TIMEOUT_MS = 10000;
+    static constexpr uint32_t SEND_TIMEOUT_MS = 1000;
+    static constexpr size_t MAX_MESSAGE_BYTES = 4096;   // 单条消息上限（分片重组）
+
+private:
+    VoiceChannel() = default;
+    ~VoiceChannel();
+
+    VoiceChannel(const VoiceChannel&) = delete;
+    VoiceChannel& operator=(const VoiceChannel&) = delete;
+
+    static void EventHandler(void* arg, esp_event_base_t base, int32_t event_id, void* event_data);
+    void OnData(const esp_websocket_event_data_t* data);
+    void OnText(const char* text, size_t length);
+    void OnBinary(const uint8_t* data, size_t length);
+
+    bool SendJson(const std::string& json);
+
+    // 发出 type 消息（带 session_id），fill 写入其余字段
+    template<typename Fill>
+    bool SendMessage(const char* type, Fill&& fill);
+
+    void Destroy();
+
+    VoiceChannelConfig config_;
+    Callbacks callbacks_;
+    esp_websocket_client_handle_t client_ = nullptr;
+    EventGroupHandle_t events_ = nullptr;   // 连接、hello、断开
+    std::string session_id_;
+    VoiceAudioParams downlink_;
+    std::atomic<bool> open_{false};
+    bool closing_ = false;
+
+    // 分片消息重组
+    std::string message_;
+    uint8_t message_opcode_ = 0;
+
+    // 语音到语音延迟
+    int64_t last_voiced_us_ = 0;      // 最后一帧有声上行帧的发出时间
+    bool awaiting_reply_ = false;     // 说过话，还没收到回复音频
+
+    VoiceStats stats_;
+    mutable std::mutex mutex_;        // 保护 config_、session_id_、downlink_ 和统计
+};
+
+} // namespace EvoSpark
+
+#endif // VOICE_CHANNEL_H
@@ -2,6 +2,8 @@
 #include <nvs_flash.h>
 #include <nvs.h>
 #include <esp_log.h>
+#include <esp_random.h>
+#include <cstdio>
 
 namespace EvoSpark {
 
@@ -11,6 +13,38 @@ static const char* KEY_WIFI_SSID = "wifi_ssid";
 static const char* KEY_WIFI_PASS = "wifi_pass";
 static const char* KEY_API_KEY = "api_key";
 static const char* KEY_CONFIGURED = "configured";
+static const char* KEY_SESSION_BUDGET = "tok_session";
+static const char* KEY_DAILY_BUDGET = "tok_daily";
+static const char* KEY_VOICE_URL = "voice_url";
+static const char* KEY_VOICE_TOKEN = "voice_token";
+static const char* KEY_CLIENT_ID = "client_id";
+
+// 读取字符串项，不存在时不修改 out
+static void ReadString(nvs_handle_t nvs_handle, const char* key, std::string& out) {
+    size_t required_size = 0;
+    if (nvs_get_str(nvs_handle, key, NULL, &required_size) != ESP_OK || required_size == 0) {
+        return;
+    }
+    std::string buffer(required_size, '\0');
+    if (nvs_get_str(nvs_handle, key, &buffer[0], &required_size) == ESP_OK) {
+        buffer.resize(required_size - 1);
+        out = buffer;
+    }
+}
+
+// 随机 UUID（版本 4）
+static std::string GenerateUuid() {
+    uint8_t b[16];
+    esp_fill_random(b, sizeof(b));
+    b[6] = (b[6] & 0x0F) | 0x40;
+    b[8] = (b[8] & 0x3F) | 0x80;
+    char text[37];
+    snprintf(text, sizeof(text),
+             "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+             b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7],
+             b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+    return text;
+}
 
 ConfigManager::ConfigManager() : is_configured_(false) {
 }
@@ -71,12 +105,33 @@ esp_err_t ConfigManager::Init() {
             ESP_LOGI(TAG, "No configuration found");
         }
 
+        // token 预算（未设置时不限）
+        nvs_get_u32(nvs_handle, KEY_SESSION_BUDGET, &session_token_budget_);
+        nvs_get_u32(nvs_handle, KEY_DAILY_BUDGET, &daily_token_budget_);
+
+        // 实时语音服务端
+        ReadString(nvs_handle, KEY_VOICE_URL, voice_url_);
+        ReadString(nvs_handle, KEY_VOICE_TOKEN, voice_token_);
+        ReadString(nvs_handle, KEY_CLIENT_ID, client_id_);
+
         nvs_close(nvs_handle);
     } else {
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
         return err;
     }
 
+    // 首次启动生成 Client-Id，之后一直沿用（服务端按它区分设备上的会话）
+    if (client_id_.empty()) {
+        client_id_ = GenerateUuid();
+        if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+            if (nvs_set_str(nvs_handle, KEY_CLIENT_ID, client_id_.c_str()) == ESP_OK) {
+                nvs_commit(nvs_handle);
+            }
+            nvs_close(nvs_handle);
+        }
+        ESP_LOGI(TAG, "Generated client id %s", client_id_.c_str());
+    }
+
     return ESP_OK;
 }
 
@@ -146,6 +201,65 @@ esp_err_t ConfigManager::SetConfig(const std::string& ssid,
     return ESP_OK;
 }
 
+esp_err_t ConfigManager::SetTokenBudget(uint32_t session_tokens, uint32_t daily_tokens) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_u32(nvs_handle, KEY_SESSION_BUDGET, session_tokens);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs_handle, KEY_DAILY_BUDGET, daily_tokens);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save token budget: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    session_token_budget_ = session_tokens;
+    daily_token_budget_ = daily_tokens;
+    ESP_LOGI(TAG, "Token budget saved: session %u, daily %u",
+             static_cast<unsigned>(session_tokens), static_cast<unsigned>(daily_tokens));
+    return ESP_OK;
+}
+
+esp_err_t ConfigManager::SetVoiceServer(const std::string& url, const std::string& token) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_str(nvs_handle, KEY_VOICE_URL, url.c_str());
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs_handle, KEY_VOICE_TOKEN, token.c_str());
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save voice server: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    voice_url_ = url;
+    voice_token_ = token;
+    ESP_LOGI(TAG, "Voice server saved: %s", url.empty() ? "(disabled)" : url.c_str());
+    return ESP_OK;
+}
+
 esp_err_t ConfigManager::ClearConfig() {
     ESP_LOGI(TAG, "Clearing configuration...");
 
@@ -162,6 +276,10 @@ esp_err_t ConfigManager::ClearConfig() {
     nvs_erase_key(nvs_handle, KEY_WIFI_PASS);
     nvs_erase_key(nvs_handle, KEY_API_KEY);
     nvs_erase_key(nvs_handle, KEY_CONFIGURED);
+    nvs_erase_key(nvs_handle, KEY_SESSION_BUDGET);
+    nvs_erase_key(nvs_handle, KEY_DAILY_BUDGET);
+    nvs_erase_key(nvs_handle, KEY_VOICE_URL);
+    nvs_erase_key(nvs_handle, KEY_VOICE_TOKEN);
 
     // 提交
     err = nvs_commit(nvs_handle);
@@ -177,6 +295,10 @@ esp_err_t ConfigManager::ClearConfig() {
     wifi_ssid_.clear();
     wifi_password_.clear();
     api_key_.clear();
+    session_token_budget_ = 0;
+    daily_token_budget_ = 0;
+    voice_url_.clear();
+    voice_token_.clear();
     is_configured_ = false;
 
     ESP_LOGI(TAG, "Configuration cleared!");
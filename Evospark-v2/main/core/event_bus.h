@@ -33,7 +33,7 @@ enum class EventType {
 
     // 记忆事件
     MEMORY_UPDATE,
-    MEMORY_COMPRESS,
+    MEMORY_COMPRESS,        // 会话结束后的压缩和归档已完成（int_data：记忆是否更新）
 
     // 感知事件
     OBJECT_DETECTED,
@@ -1,8 +1,15 @@
 #include "session_manager.h"
+#include "../ai/llm_client.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "link_quality.h"
+#include "../memory/context_packer.h"
+#include "voice_session.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <algorithm>
 #include <chrono>
 
 namespace EvoSpark {
@@ -11,6 +18,8 @@ static const char* TAG = "SessionManager";
 
 SessionManager::SessionManager()
     : event_bus_(EventBus::GetInstance()) {
+    context_budget_.prompt_tokens = Config::CONTEXT_PROMPT_TOKENS;
+    context_budget_.recent_turns = Config::CONTEXT_RECENT_TURNS;
 }
 
 SessionManager::~SessionManager() {
@@ -78,22 +87,31 @@ void SessionManager::StartSession() {
     SetState(SessionState::WAKING);
 
     // 初始化会话缓冲区
-    if (session_buffer_) {
-        delete session_buffer_;
-    }
-    session_buffer_ = new ConversationBuffer();
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (session_buffer_) {
+            delete session_buffer_;
+        }
+        session_buffer_ = new ConversationBuffer(Config::SESSION_BUFFER_BYTES);
+        session_id_++;
 
-    // 初始化统计
-    stats_ = SessionStats();
-    stats_.start_time = std::time(nullptr);
+        // 初始化统计
+        stats_ = SessionStats();
+        stats_.start_time = std::time(nullptr);
+    }
+    pack_report_ = PackReport();
+    TokenLedger::GetInstance().BeginSession();
 
-    // 加载长期记忆
+    // 取得记忆快照（系统 Prompt 每轮按输入检索后构建，不存入缓冲区）
     MemoryManager& memory_mgr = MemoryManager::GetInstance();
-    CompressedMemory memory = memory_mgr.LoadMemory();
+    memory_ = memory_mgr.GetSnapshot();
+    cache_context_ = ResponseCache::ContextVersion(PromptBuilder::BuildBasePersona(),
+                                                   memory_->memory.raw_json);
 
-    // 添加系统消息（包含长期记忆）
-    std::string system_prompt = PromptBuilder::BuildSystemPrompt(memory);
-    session_buffer_->AddMessage(Role::SYSTEM, system_prompt);
+    // 有语音服务端时开语音通道；连不上仍可用文字输入
+    if (StartVoice()) {
+        ESP_LOGI(TAG, "Realtime voice enabled");
+    }
 
     // 启动静默定时器
     StartSilenceTimer();
@@ -118,17 +136,33 @@ void SessionManager::EndSession() {
     // 停止静默定时器
     StopSilenceTimer();
 
+    // 先关语音通道，正在进行的一轮不再写入缓冲区之后的压缩
+    VoiceSession::GetInstance().Stop();
+
     // 更新统计
-    stats_.end_time = std::time(nullptr);
-    stats_.duration_seconds = stats_.end_time - stats_.start_time;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        stats_.end_time = std::time(nullptr);
+        stats_.duration_seconds = stats_.end_time - stats_.start_time;
+    }
 
-    // 压缩并保存记忆
+    // 压缩并保存记忆，归档本次会话（在网络任务上完成）
     CompressAndSaveMemory();
 
-    // 清理会话缓冲区
-    if (session_buffer_) {
-        delete session_buffer_;
-        session_buffer_ = nullptr;
+    // 本次会话新缓存的回复和 token 用量写入 Flash
+    ResponseCache::GetInstance().Flush();
+    TokenLedger::GetInstance().Flush();
+
+    // 清理会话缓冲区；仍在路上的回复会被丢弃
+    SessionStats stats;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (session_buffer_) {
+            delete session_buffer_;
+            session_buffer_ = nullptr;
+        }
+        session_id_++;
+        stats = stats_;
     }
 
     // 返回待机状态
@@ -141,7 +175,7 @@ void SessionManager::EndSession() {
     event_bus_.Publish(event);
 
     ESP_LOGI(TAG, "Session ended. Duration: %d seconds, Messages: %d",
-             stats_.duration_seconds, stats_.message_count);
+             stats.duration_seconds, stats.message_count);
 }
 
 void SessionManager::OnUserInput(const std::string& text) {
@@ -157,11 +191,17 @@ void SessionManager::OnUserInput(const std::string& text) {
     ESP_LOGI(TAG, "User input: %s", text.c_str());
 
     // 添加用户消息到缓冲区
-    session_buffer_->AddMessage(Role::USER, text);
-    stats_.message_count++;
-    stats_.user_messages++;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (!session_buffer_) {
+            return;
+        }
+        session_buffer_->AddMessage(Role::USER, text);
+        stats_.message_count++;
+        stats_.user_messages++;
+    }
 
-    // 处理输入
+    // 处理输入（提交后立即返回，回复经 OnResponse 到达）
     ProcessInput();
 
     // 重置静默定时器
@@ -178,7 +218,7 @@ void SessionManager::OnUserInput(const MultimodalInput& input) {
     std::string content = input.text;
 
     if (input.type == InputType::IMAGE && !input.image_description.empty()) {
-        content = "[图像: " + input.image_description + "] " + input.text;
+        content = ContextPacker::FormatImageInput(input.image_description, input.text);
     }
 
     if (!content.empty()) {
@@ -191,51 +231,278 @@ void SessionManager::ProcessInput() {
 
     ESP_LOGI(TAG, "Processing input...");
 
-    // TODO: 调用 LLM API
-    // 1. 构建完整请求（系统 Prompt + 对话历史 + 当前输入）
-    // 2. 调用 LLM API
-    // 3. 处理响应
-    // 4. 调用 TTS（可选）
-    // 5. 显示回复
+    // 当前输入是缓冲区最后一条用户消息，其余为历史
+    std::vector<Message> history;
+    uint32_t session_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (!session_buffer_) {
+            return;
+        }
+        history = session_buffer_->GetMessages();
+        session_id = session_id_;
+    }
+    std::string user_input;
+    if (!history.empty() && history.back().role == Role::USER) {
+        user_input = history.back().content;
+        history.pop_back();
+    }
+
+    // 重复的简单输入直接用缓存的回复，不发请求
+    std::string cached;
+    if (ResponseCache::GetInstance().Lookup(user_input, cache_context_, cached)) {
+        event_bus_.Publish(EventType::AI_RESPONSE_START, "SessionManager");
+        Event chunk_event(EventType::AI_RESPONSE_CHUNK, "SessionManager");
+        chunk_event.str_data = cached;
+        event_bus_.Publish(chunk_event);
+        LLMResponse resp;
+        resp.success = true;
+        resp.content = std::move(cached);
+        OnResponse(session_id, resp);
+        return;
+    }
 
-    // 模拟响应
-    std::string response = "我收到了你的消息。";
+    // 接近 token 预算时缩短上下文；超出后不再检索记忆，只留最近一轮
+    BudgetLevel level = TokenLedger::GetInstance().GetLevel();
+    ContextBudget budget = context_budget_;
+    if (level == BudgetLevel::ECONOMY) {
+        budget.prompt_tokens /= 2;
+        budget.summary_tokens /= 2;
+        budget.recent_turns = std::max<size_t>(budget.recent_turns / 2, 1);
+    } else if (level == BudgetLevel::EXHAUSTED) {
+        budget.prompt_tokens /= 4;
+        budget.summary_tokens /= 4;
+        budget.recent_turns = 1;
+    }
+    // 弱信号时再减短：请求体小，上传快，服务端处理 prompt 也快
+    LinkProfile link = LinkQuality::GetInstance().GetProfile();
+    if (link.context_percent < 100) {
+        budget.prompt_tokens = budget.prompt_tokens * link.context_percent / 100;
+        budget.summary_tokens = budget.summary_tokens * link.context_percent / 100;
+        budget.recent_turns = std::max<size_t>(budget.recent_turns * link.context_percent / 100, 1);
+    }
+
+    // 只注入与本轮输入相关的记忆，整体按预算打包（会话再长请求也不超限）
+    std::vector<MemoryHit> relevant;
+    if (level != BudgetLevel::EXHAUSTED) {
+        relevant = MemoryManager::GetInstance().RetrieveRelevant(user_input);
+    }
+
+    std::string image_description;
+    std::string image_text;
+    LLMClient::Request request;
+    request.messages = PromptBuilder::BuildRequest(
+        memory_->memory, relevant, history, user_input, budget, &pack_report_);
+    request.priority = RequestPriority::INTERACTIVE;
+    request.deadline_ms = Config::RESPONSE_DEADLINE_MS;
+    request.purpose = ContextPacker::SplitImageInput(user_input, image_description, image_text)
+        ? TokenPurpose::VISION : TokenPurpose::CHAT;
+
+    LLMClient& llm = LLMClient::GetInstance();
+    if (!llm.IsInitialized()) {
+        LLMResponse resp;
+        resp.error_message = "LLM client not initialized";
+        OnResponse(session_id, resp);
+        return;
+    }
+
+    // 流式请求，每个增量片段立即发布，显示和播报不必等完整回复
+    event_bus_.Publish(EventType::AI_RESPONSE_START, "SessionManager");
+    request.on_chunk = [this, session_id](const std::string& chunk, bool is_done) {
+        if (is_done || session_id != session_id_) {
+            return;
+        }
+        Event chunk_event(EventType::AI_RESPONSE_CHUNK, "SessionManager");
+        chunk_event.str_data = chunk;
+        event_bus_.Publish(chunk_event);
+    };
+    uint64_t cache_context = cache_context_;
+    llm.Submit(std::move(request), [this, session_id, user_input, cache_context](const LLMResponse& resp) {
+        OnResponse(session_id, resp);
+        // 回复送出后再存缓存（写 Flash 可能要几百毫秒）
+        if (resp.success) {
+            ResponseCache::GetInstance().Store(user_input, cache_context, resp.content,
+                                               resp.tokens_used, resp.latency_ms);
+        }
+    });
+}
+
+void SessionManager::OnResponse(uint32_t session_id, const LLMResponse& resp) {
+    std::string response;
+    if (resp.success) {
+        response = resp.content;
+    } else {
+        response = "抱歉，我现在有点走神了，能再说一遍吗？";
+    }
 
     // 添加助手消息到缓冲区
-    session_buffer_->AddMessage(Role::ASSISTANT, response);
-    stats_.assistant_messages++;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (session_id != session_id_ || !session_buffer_) {
+            ESP_LOGW(TAG, "Session ended before the reply arrived, dropping it");
+            return;
+        }
+        session_buffer_->AddMessage(Role::ASSISTANT, response);
+        stats_.assistant_messages++;
+    }
+
+    if (!resp.success) {
+        ESP_LOGE(TAG, "LLM request failed: %s", resp.error_message.c_str());
+        Event error_event(EventType::AI_ERROR, "SessionManager");
+        error_event.str_data = resp.error_message;
+        event_bus_.Publish(error_event);
+    }
+
+    Event response_event(EventType::AI_RESPONSE_END, "SessionManager");
+    response_event.message = Message(Role::ASSISTANT, response);
+    event_bus_.Publish(response_event);
 
     // 返回监听状态
-    SetState(SessionState::LISTENING);
+    if (state_ == SessionState::PROCESSING) {
+        SetState(SessionState::LISTENING);
+    }
 }
 
-void SessionManager::CompressAndSaveMemory() {
-    ESP_LOGI(TAG, "Compressing and saving memory...");
+bool SessionManager::StartVoice() {
+    uint32_t session_id = session_id_;
+    VoiceSession::Listener listener;
+    listener.on_transcript = [this, session_id](const std::string& text) {
+        OnVoiceTranscript(session_id, text);
+    };
+    listener.on_reply_start = [this, session_id]() { OnVoiceReplyStart(session_id); };
+    listener.on_reply_sentence = [this, session_id](const std::string& text) {
+        OnVoiceReplySentence(session_id, text);
+    };
+    listener.on_reply_end = [this, session_id]() { OnVoiceReplyEnd(session_id); };
+    listener.on_closed = [this, session_id]() { OnVoiceClosed(session_id); };
+    return VoiceSession::GetInstance().Start(listener);
+}
+
+void SessionManager::OnVoiceTranscript(uint32_t session_id, const std::string& text) {
+    ESP_LOGI(TAG, "Voice input: %s", text.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (session_id != session_id_ || !session_buffer_) {
+            return;
+        }
+        session_buffer_->AddMessage(Role::USER, text);
+        stats_.message_count++;
+        stats_.user_messages++;
+    }
+    ResetSilenceTimer();
 
-    if (!session_buffer_ || session_buffer_->IsEmpty()) {
-        ESP_LOGI(TAG, "Session buffer is empty, skip compression");
+    if (state_ == SessionState::LISTENING) {
+        SetState(SessionState::PROCESSING);
+    }
+}
+
+void SessionManager::OnVoiceReplyStart(uint32_t session_id) {
+    if (session_id != session_id_) {
         return;
     }
+    voice_reply_.clear();
+    event_bus_.Publish(EventType::AI_RESPONSE_START, "SessionManager");
+    SetState(SessionState::SPEAKING);
+}
 
-    MemoryManager& memory_mgr = MemoryManager::GetInstance();
+void SessionManager::OnVoiceReplySentence(uint32_t session_id, const std::string& text) {
+    if (session_id != session_id_ || text.empty()) {
+        return;
+    }
+    voice_reply_ += text;
+    Event chunk_event(EventType::AI_RESPONSE_CHUNK, "SessionManager");
+    chunk_event.str_data = text;
+    event_bus_.Publish(chunk_event);
+}
 
-    // 获取本次会话的消息
-    std::vector<Message> session_messages = session_buffer_->GetMessages();
+void SessionManager::OnVoiceReplyEnd(uint32_t session_id) {
+    std::string response = std::move(voice_reply_);
+    voice_reply_.clear();
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (session_id != session_id_ || !session_buffer_) {
+            return;
+        }
+        if (!response.empty()) {
+            session_buffer_->AddMessage(Role::ASSISTANT, response);
+            stats_.assistant_messages++;
+        }
+    }
 
-    // 压缩记忆
-    CompressedMemory new_memory = memory_mgr.CompressMemory(
-        memory_mgr.LoadMemory(),
-        session_messages
-    );
+    Event response_event(EventType::AI_RESPONSE_END, "SessionManager");
+    response_event.message = Message(Role::ASSISTANT, response);
+    event_bus_.Publish(response_event);
 
-    // 保存记忆
-    if (!memory_mgr.SaveMemory(new_memory)) {
-        ESP_LOGE(TAG, "Failed to save memory");
-    } else {
-        ESP_LOGI(TAG, "Memory saved successfully");
+    ResetSilenceTimer();
+    if (state_ == SessionState::SPEAKING || state_ == SessionState::PROCESSING) {
+        SetState(SessionState::LISTENING);
+    }
+}
+
+void SessionManager::OnVoiceClosed(uint32_t session_id) {
+    if (session_id != session_id_) {
+        return;
+    }
+    ESP_LOGW(TAG, "Voice channel closed, text input only for the rest of this session");
+    Event error_event(EventType::AI_ERROR, "SessionManager");
+    error_event.str_data = "voice channel closed";
+    event_bus_.Publish(error_event);
+
+    if (state_ == SessionState::SPEAKING || state_ == SessionState::PROCESSING) {
+        SetState(SessionState::LISTENING);
     }
 }
 
+void SessionManager::CompressAndSaveMemory() {
+    ESP_LOGI(TAG, "Compressing and saving memory...");
+
+    // 获取本次会话的消息
+    std::vector<Message> session_messages;
+    SessionStats stats;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        if (!session_buffer_ || session_buffer_->IsEmpty()) {
+            ESP_LOGI(TAG, "Session buffer is empty, skip compression");
+            return;
+        }
+        session_messages = session_buffer_->GetMessages();
+        stats = stats_;
+    }
+
+    // 压缩记忆（基于最新快照，会话期间的回滚不会被覆盖）。压缩在网络任务上
+    // 以后台优先级进行，会话立即结束；紧接着开始的会话仍用旧记忆
+    MemoryManager& memory_mgr = MemoryManager::GetInstance();
+    MemorySnapshotPtr base = memory_mgr.GetSnapshot();
+    memory_mgr.CompressMemoryAsync(base->memory, session_messages,
+        [base, session_messages, stats](bool success, const CompressedMemory& new_memory) {
+            MemoryManager& mgr = MemoryManager::GetInstance();
+
+            // 保存记忆（压缩期间发生回滚时放弃本次结果，不覆盖回滚后的记忆）
+            bool saved = success && mgr.SaveMemory(new_memory, base);
+            if (!saved) {
+                ESP_LOGE(TAG, "Failed to save memory");
+            } else {
+                ESP_LOGI(TAG, "Memory saved successfully");
+            }
+
+            // 归档原始对话（压缩失败时不写摘要）
+            std::string summary;
+            if (saved && new_memory.last_session_summary != base->memory.last_session_summary) {
+                summary = new_memory.last_session_summary;
+            }
+            uint32_t session_id = mgr.ArchiveSession(session_messages, stats, summary);
+            if (session_id > 0) {
+                ESP_LOGI(TAG, "Session archived as #%u", static_cast<unsigned>(session_id));
+            }
+
+            // 压缩、保存和归档都已结束（int_data 为 1 表示记忆已更新）
+            Event done_event(EventType::MEMORY_COMPRESS, "SessionManager");
+            done_event.int_data = saved ? 1 : 0;
+            EventBus::GetInstance().Publish(done_event);
+        });
+}
+
 void SessionManager::OnSilenceTimeout() {
     ESP_LOGI(TAG, "Silence timeout detected");
 
@@ -2,6 +2,8 @@
 #define SESSION_MANAGER_H
 
 #include <functional>
+#include <mutex>
+#include <atomic>
 #include "memory_types.h"
 #include "event_bus.h"
 #include "../memory/conversation_buffer.h"
@@ -18,9 +20,19 @@ namespace Config {
     constexpr int SILENCE_TIMEOUT_MS = 5 * 60 * 1000;  // 5 分钟
     constexpr int MAX_SESSION_MESSAGES = 100;
     constexpr int MAX_MEMORY_EVENTS = 20;
+    constexpr size_t SESSION_BUFFER_BYTES = 32 * 1024;   // 会话缓冲区（完整保留供摘要和压缩）
+    constexpr int CONTEXT_PROMPT_TOKENS = 4096;          // 每轮请求的 prompt 预算
+    constexpr size_t CONTEXT_RECENT_TURNS = 4;           // 原文保留的最近轮数
+    constexpr uint32_t RESPONSE_DEADLINE_MS = 45000;     // 一轮回复的截止时间（含排队）
 }
 
+struct LLMResponse;
+
 // 会话管理器 - 核心控制器
+//
+// LLM 请求提交给 LLMClient 的网络任务后立即返回，回复在网络任务上经
+// OnResponse 回来；会话结束时的记忆压缩同样异步完成，结束会话不再等待。
+// 回复到达前会话已结束（按键或静默超时）时，回复按会话编号丢弃。
 class SessionManager {
 public:
     static SessionManager& GetInstance() {
@@ -48,8 +60,19 @@ public:
     using StateCallback = std::function<void(SessionState, SessionState)>;
     void SetStateCallback(StateCallback cb) { state_callback_ = cb; }
 
-    // 获取当前会话统计
-    const SessionStats& GetStats() const { return stats_; }
+    // 获取当前会话统计（拷贝；计数在网络任务和语音任务上更新）
+    SessionStats GetStats() const {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        return stats_;
+    }
+
+    // 最近一轮请求的上下文打包报告
+    const PackReport& GetLastPackReport() const { return pack_report_; }
+
+    // 本会话因缓冲区满被移除的消息数（既未进入摘要也未参与压缩）
+    size_t GetEvictedMessages() const {
+        return session_buffer_ ? session_buffer_->GetDroppedCount() : 0;
+    }
 
     // 是否在会话中
     bool InSession() const {
@@ -72,6 +95,18 @@ private:
     void EndSession();
     void ProcessInput();
 
+    // LLM 回复到达（网络任务上调用）
+    void OnResponse(uint32_t session_id, const LLMResponse& resp);
+
+    // 实时语音通道（配置了语音服务端时）：识别、回复都在服务端完成，
+    // 这里只记入会话缓冲区、发布事件和切换状态
+    bool StartVoice();
+    void OnVoiceTranscript(uint32_t session_id, const std::string& text);
+    void OnVoiceReplyStart(uint32_t session_id);
+    void OnVoiceReplySentence(uint32_t session_id, const std::string& text);
+    void OnVoiceReplyEnd(uint32_t session_id);
+    void OnVoiceClosed(uint32_t session_id);
+
     // 记忆压缩和保存
     void CompressAndSaveMemory();
 
@@ -89,7 +124,14 @@ private:
 
     // 会话数据
     ConversationBuffer* session_buffer_ = nullptr;
+    std::atomic<uint32_t> session_id_{0};   // 每次开始、结束会话时递增（持 buffer_mutex_ 修改）
+    mutable std::mutex buffer_mutex_;       // 保护 session_buffer_ 和 stats_（发布事件时不持有）
     SessionStats stats_;
+    MemorySnapshotPtr memory_;  // 会话开始时的记忆快照（本会话 Prompt 保持一致）
+    uint64_t cache_context_ = 0; // 回复缓存的上下文版本（人设 + 记忆快照）
+    ContextBudget context_budget_;
+    PackReport pack_report_;
+    std::string voice_reply_;   // 语音回复已到达的句子（语音任务上访问）
 
     // 回调
     StateCallback state_callback_;
@@ -0,0 +1,298 @@
+#include "voice_session.h"
+#include "link_quality.h"
+#include "../perception/audio/microphone.h"
+#include "../perception/audio/speaker.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace EvoSpark {
+
+static const char* TAG = "VoiceSession";
+
+VoiceSession::~VoiceSession() {
+    Stop();
+}
+
+bool VoiceSession::Start(const Listener& listener) {
+    if (active_) {
+        return true;
+    }
+    VoiceChannel& channel = VoiceChannel::GetInstance();
+    if (!channel.IsConfigured()) {
+        return false;
+    }
+
+    uint32_t bitrate = LinkQuality::GetInstance().GetProfile().audio_bitrate;
+    if (!encoder_.Init(SAMPLE_RATE, FRAME_DURATION_MS, bitrate) || !decoder_.Init(SAMPLE_RATE)) {
+        return false;
+    }
+
+    if (!uplink_queue_) {
+        uplink_queue_ = xQueueCreate(UPLINK_QUEUE_FRAMES, sizeof(std::vector<int16_t>*));
+        downlink_queue_ = xQueueCreate(DOWNLINK_QUEUE_FRAMES, sizeof(DownlinkItem));
+        if (!uplink_queue_ || !downlink_queue_) {
+            ESP_LOGE(TAG, "Failed to create audio queues");
+            return false;
+        }
+    }
+
+    listener_ = listener;
+    replying_ = false;
+    dropped_frames_ = 0;
+    pending_.clear();
+    pending_.reserve(encoder_.FrameSamples());
+
+    VoiceChannel::Callbacks callbacks;
+    callbacks.on_stt = [this](const std::string& text) {
+        if (!text.empty() && listener_.on_transcript) {
+            listener_.on_transcript(text);
+        }
+    };
+    callbacks.on_tts_start = [this]() { OnReplyStart(); };
+    callbacks.on_sentence = [this](const std::string& text) {
+        if (listener_.on_reply_sentence) {
+            listener_.on_reply_sentence(text);
+        }
+    };
+    callbacks.on_tts_stop = [this]() { OnReplyStop(); };
+    callbacks.on_audio = [this](const uint8_t* data, size_t length) { OnDownlinkAudio(data, length); };
+    callbacks.on_closed = [this]() {
+        // WebSocket 任务上：这里只通知，连接和任务在 Stop 时清理
+        if (listener_.on_closed) {
+            listener_.on_closed();
+        }
+    };
+
+    VoiceAudioParams uplink;
+    uplink.sample_rate = SAMPLE_RATE;
+    uplink.frame_duration_ms = FRAME_DURATION_MS;
+    if (!channel.Open(uplink, callbacks)) {
+        return false;
+    }
+
+    active_ = true;
+    uplink_running_ = true;
+    if (xTaskCreate(UplinkTask, "voice_up", OpusVoiceEncoder::ENCODER_STACK_BYTES + 4096,
+                    this, 5, &uplink_task_) != pdPASS) {
+        uplink_running_ = false;
+        uplink_task_ = nullptr;
+    }
+    downlink_running_ = true;
+    if (xTaskCreate(DownlinkTask, "voice_down", OpusVoiceDecoder::DECODER_STACK_BYTES + 4096,
+                    this, 5, &downlink_task_) != pdPASS) {
+        downlink_running_ = false;
+        downlink_task_ = nullptr;
+    }
+    if (!uplink_task_ || !downlink_task_) {
+        ESP_LOGE(TAG, "Failed to create audio tasks");
+        Stop();
+        return false;
+    }
+
+    Microphone& mic = Microphone::GetInstance();
+    mic.SetAudioCallback([this](const std::vector<int16_t>& audio) { OnMicAudio(audio); });
+    if (!mic.StartRecording()) {
+        ESP_LOGE(TAG, "Microphone not available");
+        Stop();
+        return false;
+    }
+
+    channel.StartListening(ListenMode::AUTO);
+    ESP_LOGI(TAG, "Voice session started (%u bps uplink)", static_cast<unsigned>(bitrate));
+    return true;
+}
+
+void VoiceSession::Stop() {
+    if (!active_) {
+        return;
+    }
+    active_ = false;
+
+    Microphone& mic = Microphone::GetInstance();
+    mic.StopRecording();
+    mic.SetAudioCallback(nullptr);
+
+    VoiceChannel::GetInstance().Close();
+    StopTasks();
+    DrainQueues();
+    Speaker::GetInstance().EndStream();
+    replying_ = false;
+
+    if (dropped_frames_ > 0) {
+        ESP_LOGW(TAG, "%u audio frames dropped on full queues", static_cast<unsigned>(dropped_frames_));
+    }
+    ESP_LOGI(TAG, "Voice session stopped");
+}
+
+void VoiceSession::StopTasks() {
+    std::vector<int16_t>* exit_frame = nullptr;
+    DownlinkItem exit_item = {DownlinkItem::EXIT, nullptr};
+    if (uplink_task_) {
+        xQueueSendToFront(uplink_queue_, &exit_frame, pdMS_TO_TICKS(100));
+    }
+    if (downlink_task_) {
+        xQueueSendToFront(downlink_queue_, &exit_item, pdMS_TO_TICKS(100));
+    }
+
+    // 任务自己退出（编码、解码或写 I2S 中途删除会泄漏 libopus 的状态）
+    for (int i = 0; i < 50 && (uplink_running_ || downlink_running_); i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (uplink_running_ && uplink_task_) {
+        vTaskDelete(uplink_task_);
+    }
+    if (downlink_running_ && downlink_task_) {
+        vTaskDelete(downlink_task_);
+    }
+    uplink_running_ = false;
+    downlink_running_ = false;
+    uplink_task_ = nullptr;
+    downlink_task_ = nullptr;
+}
+
+void VoiceSession::DrainQueues() {
+    std::vector<int16_t>* frame = nullptr;
+    while (uplink_queue_ && xQueueReceive(uplink_queue_, &frame, 0) == pdTRUE) {
+        delete frame;
+    }
+    DownlinkItem item;
+    while (downlink_queue_ && xQueueReceive(downlink_queue_, &item, 0) == pdTRUE) {
+        delete item.packet;
+    }
+}
+
+// ==================== 上行 ====================
+
+void VoiceSession::OnMicAudio(const std::vector<int16_t>& audio) {
+    // 麦克风任务上调用；回复播放期间不发（没有回声消除，会把自己的声音识别进去）
+    if (!active_ || replying_) {
+        pending_.clear();
+        return;
+    }
+
+    size_t frame_samples = encoder_.FrameSamples();
+    size_t offset = 0;
+    while (offset < audio.size()) {
+        size_t take = std::min(frame_samples - pending_.size(), audio.size() - offset);
+        pending_.insert(pending_.end(), audio.begin() + offset, audio.begin() + offset + take);
+        offset += take;
+        if (pending_.size() < frame_samples) {
+            break;
+        }
+
+        auto* frame = new std::vector<int16_t>(std::move(pending_));
+        pending_.clear();
+        pending_.reserve(frame_samples);
+        if (xQueueSend(uplink_queue_, &frame, 0) != pdTRUE) {
+            delete frame;
+            dropped_frames_++;
+        }
+    }
+}
+
+void VoiceSession::UplinkTask(void* arg) {
+    VoiceSession* self = static_cast<VoiceSession*>(arg);
+    self->ProcessUplink();
+    self->uplink_running_ = false;
+    vTaskDelete(nullptr);
+}
+
+void VoiceSession::ProcessUplink() {
+    VoiceChannel& channel = VoiceChannel::GetInstance();
+    LinkQuality& link = LinkQuality::GetInstance();
+    std::vector<uint8_t> packet;
+
+    while (true) {
+        std::vector<int16_t>* frame = nullptr;
+        if (xQueueReceive(uplink_queue_, &frame, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (!frame) {
+            break;
+        }
+
+        // 帧平均幅度：只标记这帧是否有人声，用来记说完的时刻
+        int64_t sum = 0;
+        for (int16_t sample : *frame) {
+            sum += std::abs(static_cast<int>(sample));
+        }
+        bool voiced = !frame->empty() && sum / static_cast<int64_t>(frame->size()) > VAD_LEVEL;
+
+        encoder_.SetBitrate(link.GetProfile().audio_bitrate);
+        if (encoder_.Encode(frame->data(), packet)) {
+            channel.SendAudio(packet.data(), packet.size(), voiced);
+        }
+        delete frame;
+    }
+}
+
+// ==================== 下行 ====================
+
+void VoiceSession::OnReplyStart() {
+    // 下行音频紧跟 tts start 到达，先停上行
+    replying_ = true;
+    if (listener_.on_reply_start) {
+        listener_.on_reply_start();
+    }
+}
+
+void VoiceSession::OnReplyStop() {
+    // 排在已收到的音频后面：播完再结束这一轮
+    DownlinkItem item = {DownlinkItem::REPLY_END, nullptr};
+    if (xQueueSend(downlink_queue_, &item, pdMS_TO_TICKS(VoiceChannel::SEND_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Downlink queue full, reply end lost");
+    }
+}
+
+void VoiceSession::OnDownlinkAudio(const uint8_t* data, size_t length) {
+    DownlinkItem item = {DownlinkItem::AUDIO, new std::vector<uint8_t>(data, data + length)};
+    if (xQueueSend(downlink_queue_, &item, 0) != pdTRUE) {
+        delete item.packet;
+        dropped_frames_++;
+    }
+}
+
+void VoiceSession::DownlinkTask(void* arg) {
+    VoiceSession* self = static_cast<VoiceSession*>(arg);
+    self->ProcessDownlink();
+    self->downlink_running_ = false;
+    vTaskDelete(nullptr);
+}
+
+void VoiceSession::ProcessDownlink() {
+    Speaker& speaker = Speaker::GetInstance();
+    std::vector<int16_t> pcm;
+
+    while (true) {
+        DownlinkItem item;
+        if (xQueueReceive(downlink_queue_, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (item.kind == DownlinkItem::EXIT) {
+            break;
+        }
+
+        if (item.kind == DownlinkItem::REPLY_END) {
+            speaker.EndStream();
+            decoder_.Reset();
+            replying_ = false;
+            if (listener_.on_reply_end) {
+                listener_.on_reply_end();
+            }
+            // auto 模式每轮结束后要重新开始拾音
+            VoiceChannel::GetInstance().StartListening(ListenMode::AUTO);
+            continue;
+        }
+
+        if (decoder_.Decode(item.packet->data(), item.packet->size(), pcm) && !pcm.empty()) {
+            if (!speaker.IsStreaming()) {
+                speaker.StartStream();
+            }
+            speaker.WriteStream(pcm.data(), pcm.size());
+        }
+        delete item.packet;
+    }
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,98 @@
+#ifndef VOICE_SESSION_H
+#define VOICE_SESSION_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include "../ai/voice_channel.h"
+#include "../perception/audio/opus_codec.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+namespace EvoSpark {
+
+// 实时语音会话：麦克风 → Opus → VoiceChannel → Opus → 扬声器
+//
+//   上行：麦克风任务把 PCM 攒成 60 ms 一帧放进队列，voice_up 任务编码
+//         （码率取链路估计）后发出；本地按帧能量判断有没有人声，只用于
+//         计算延迟，说完与否由服务端 VAD 判断（auto 模式）
+//   下行：收到的 Opus 包放进队列，voice_down 任务解码后写扬声器
+//
+// 没有回声消除，播放回复期间不发上行音频（半双工）；回复播完后重新
+// listen start。识别文本、回复句子和开始 / 结束经 Listener 交给
+// SessionManager，写入会话缓冲区，会话结束照常压缩记忆。
+class VoiceSession {
+public:
+    static VoiceSession& GetInstance() {
+        static VoiceSession instance;
+        return instance;
+    }
+
+    struct Listener {
+        std::function<void(const std::string& text)> on_transcript;   // 用户这句话的识别结果
+        std::function<void()> on_reply_start;
+        std::function<void(const std::string& text)> on_reply_sentence;
+        std::function<void()> on_reply_end;                           // 回复音频已全部播完
+        std::function<void()> on_closed;                              // 连接中途断开
+    };
+
+    // 连接语音服务端并开始拾音；没有配置或连接失败返回 false（阻塞到握手完成）
+    bool Start(const Listener& listener);
+    void Stop();
+    bool IsActive() const { return active_; }
+
+    static constexpr int SAMPLE_RATE = 16000;           // 麦克风和扬声器的采样率
+    static constexpr int FRAME_DURATION_MS = 60;
+    static constexpr int VAD_LEVEL = 500;               // 帧平均幅度超过它算有人声（约 -36 dBFS）
+    static constexpr size_t UPLINK_QUEUE_FRAMES = 8;    // 约 0.5 秒
+    static constexpr size_t DOWNLINK_QUEUE_FRAMES = 64; // 服务端 TTS 比实时快，先收下来
+
+private:
+    VoiceSession() = default;
+    ~VoiceSession();
+
+    VoiceSession(const VoiceSession&) = delete;
+    VoiceSession& operator=(const VoiceSession&) = delete;
+
+    // 下行队列的元素
+    struct DownlinkItem {
+        enum Kind : uint8_t { AUDIO, REPLY_END, EXIT } kind;
+        std::vector<uint8_t>* packet;
+    };
+
+    void OnMicAudio(const std::vector<int16_t>& audio);
+    void OnDownlinkAudio(const uint8_t* data, size_t length);
+    void OnReplyStart();
+    void OnReplyStop();
+
+    static void UplinkTask(void* arg);
+    static void DownlinkTask(void* arg);
+    void ProcessUplink();
+    void ProcessDownlink();
+
+    void StopTasks();
+    void DrainQueues();
+
+    Listener listener_;
+    OpusVoiceEncoder encoder_;
+    OpusVoiceDecoder decoder_;
+
+    QueueHandle_t uplink_queue_ = nullptr;      // std::vector<int16_t>*，nullptr 为退出
+    QueueHandle_t downlink_queue_ = nullptr;    // DownlinkItem
+    TaskHandle_t uplink_task_ = nullptr;
+    TaskHandle_t downlink_task_ = nullptr;
+    std::atomic<bool> uplink_running_{false};
+    std::atomic<bool> downlink_running_{false};
+
+    std::vector<int16_t> pending_;              // 麦克风任务上未满一帧的采样
+    std::atomic<bool> active_{false};
+    std::atomic<bool> replying_{false};         // 回复播放中（不发上行）
+    std::atomic<uint32_t> dropped_frames_{0};
+};
+
+} // namespace EvoSpark
+
+#endif // VOICE_SESSION_H
@@ -10,6 +10,10 @@
 #include "core/session_manager.h"
 #include "core/event_bus.h"
 #include "memory/memory_manager.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "link_quality.h"
+#include "ai/voice_channel.h"
 #include "config/config_manager.h"
 #include "web/web_server.h"
 #include "input/button.h"
@@ -171,6 +175,22 @@ void app_main(void) {
             esp_wifi_stop();
             is_ap_mode = true;
             init_wifi_ap();
+        } else {
+            // 链路估计：周期读 RSSI，请求结果由连接池报告
+            LinkQuality::GetInstance().Start();
+
+            // 实时语音服务端（未配置时会话只用文字输入）；Device-Id 用 STA 的 MAC
+            uint8_t mac[6] = {0};
+            esp_wifi_get_mac(WIFI_IF_STA, mac);
+            char device_id[18];
+            snprintf(device_id, sizeof(device_id), "%02x:%02x:%02x:%02x:%02x:%02x",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            VoiceChannelConfig voice;
+            voice.url = config.GetVoiceUrl();
+            voice.token = config.GetVoiceToken();
+            voice.device_id = device_id;
+            voice.client_id = config.GetClientId();
+            VoiceChannel::GetInstance().Configure(voice);
         }
     } else {
         ESP_LOGI(TAG, "No configuration, starting AP mode");
@@ -180,7 +200,8 @@ void app_main(void) {
 
     // 4. 初始化 Flash 存储
     FlashStorage& flash = FlashStorage::GetInstance();
-    if (!flash.Init()) {
+    bool flash_ok = flash.Init();
+    if (!flash_ok) {
         ESP_LOGE(TAG, "Failed to initialize flash storage");
     }
 
@@ -194,6 +215,17 @@ void app_main(void) {
         }
     }
 
+    // 回复缓存（Flash 不可用时只用 PSRAM）
+    ResponseCache::GetInstance().Init(flash_ok ? "/spiffs/resp_cache.bin" : nullptr);
+
+    // token 记账与预算
+    TokenLedger& ledger = TokenLedger::GetInstance();
+    ledger.Init(flash_ok ? "/spiffs/token_ledger.bin" : nullptr);
+    TokenBudget budget;
+    budget.session_tokens = config.GetSessionTokenBudget();
+    budget.daily_tokens = config.GetDailyTokenBudget();
+    ledger.SetBudget(budget);
+
     // 6. 初始化 LED
     LEDController& led = LEDController::GetInstance();
     if (!led.Init(LED_GPIO)) {
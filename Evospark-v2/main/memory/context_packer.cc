@@ -0,0 +1,371 @@
+#include "context_packer.h"
+#include "prompt_builder.h"
+#include "prompt_template.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <ctime>
+
+namespace EvoSpark {
+
+static const char* TAG = "ContextPacker";
+
+static const char IMAGE_TAG_OPEN[] = "[图像: ";
+static const char IMAGE_TAG_CLOSE[] = "] ";
+
+// {{0}} 较早轮次摘要（每轮一行）
+PROMPT_TEMPLATE(kEarlierTurns, "【更早的对话（摘要）】\n{{0}}");
+
+// {{0}} 较早轮次中的图像描述
+PROMPT_TEMPLATE(kEarlierImages, "【当时看到的画面】\n{{0}}");
+
+namespace {
+
+// 一轮对话：一条用户消息及其后的助手回复
+struct Turn {
+    size_t begin;
+    size_t end;
+};
+
+int Cost(const std::string& text) {
+    return MemoryIndex::EstimateTokens(text) + ContextPacker::MESSAGE_OVERHEAD_TOKENS;
+}
+
+// UTF-8 首字节对应的码点长度（非法字节按 1 处理）
+size_t Utf8Length(uint8_t c) {
+    if (c < 0x80) return 1;
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+// 按字符数截断，截断时追加省略号
+std::string TruncateChars(const std::string& text, int max_chars) {
+    size_t i = 0;
+    int chars = 0;
+    while (i < text.size() && chars < max_chars) {
+        i += Utf8Length(static_cast<uint8_t>(text[i]));
+        chars++;
+    }
+    if (i >= text.size()) {
+        return text;
+    }
+    return text.substr(0, i) + "…";
+}
+
+// 按 token 估算截断（与 MemoryIndex::EstimateTokens 的计法一致）
+std::string TruncateToTokens(const std::string& text, int max_tokens) {
+    int cjk = 0;
+    int other_bytes = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t len = Utf8Length(static_cast<uint8_t>(text[i]));
+        int next_cjk = cjk + (len > 1 ? 1 : 0);
+        int next_other = other_bytes + (len > 1 ? 0 : 1);
+        if (next_cjk + (next_other + 3) / 4 > max_tokens) {
+            break;
+        }
+        cjk = next_cjk;
+        other_bytes = next_other;
+        i += len;
+    }
+    return text.substr(0, i);
+}
+
+// 折叠后的一轮：一行摘要 + 该轮出现的图像描述
+struct FoldedTurn {
+    std::string line;
+    std::vector<std::string> images;
+};
+
+FoldedTurn FoldTurn(const std::vector<Message>& messages, const Turn& turn, int summary_chars) {
+    FoldedTurn folded;
+    folded.line = "- ";
+    for (size_t i = turn.begin; i < turn.end; i++) {
+        const Message& msg = messages[i];
+        std::string description;
+        std::string text;
+        if (!ContextPacker::SplitImageInput(msg.content, description, text)) {
+            text = msg.content;
+        } else {
+            folded.images.push_back(std::move(description));
+        }
+
+        if (i > turn.begin) {
+            folded.line += " / ";
+        }
+        folded.line += msg.role == Role::USER ? "用户: " : "EvoSpark: ";
+        folded.line += TruncateChars(text, summary_chars);
+    }
+    folded.line += "\n";
+    return folded;
+}
+
+Message SystemMessage(std::string content) {
+    Message msg;
+    msg.role = Role::SYSTEM;
+    msg.content = std::move(content);
+    msg.timestamp = std::time(nullptr);
+    return msg;
+}
+
+} // namespace
+
+std::string ContextPacker::FormatImageInput(const std::string& description,
+                                            const std::string& text) {
+    std::string out;
+    out.reserve(sizeof(IMAGE_TAG_OPEN) + description.size() + sizeof(IMAGE_TAG_CLOSE) + text.size());
+    out += IMAGE_TAG_OPEN;
+    out += description;
+    out += IMAGE_TAG_CLOSE;
+    out += text;
+    return out;
+}
+
+bool ContextPacker::SplitImageInput(const std::string& content,
+                                    std::string& description, std::string& text) {
+    const size_t open_len = sizeof(IMAGE_TAG_OPEN) - 1;
+    if (content.compare(0, open_len, IMAGE_TAG_OPEN) != 0) {
+        return false;
+    }
+    size_t close = content.find(IMAGE_TAG_CLOSE, open_len);
+    if (close == std::string::npos) {
+        return false;
+    }
+    description = content.substr(open_len, close - open_len);
+    text = content.substr(close + sizeof(IMAGE_TAG_CLOSE) - 1);
+    return true;
+}
+
+std::vector<Message> ContextPacker::Pack(
+    const CompressedMemory& memory,
+    const std::vector<MemoryHit>& relevant,
+    const std::vector<Message>& history,
+    const std::string& user_input,
+    const ContextBudget& budget,
+    PackReport* report
+) {
+    PackReport rep;
+    rep.budget_tokens = budget.prompt_tokens;
+    int remaining = budget.prompt_tokens;
+
+    // 1. 固定人设：始终保留
+    const std::string& prefix = PromptBuilder::StablePrefix();
+    rep.pinned_tokens = Cost(prefix);
+    remaining -= rep.pinned_tokens;
+
+    // 2. 当前输入：必须发送，放不下时截断
+    std::string input = user_input;
+    if (!input.empty()) {
+        rep.input_tokens = Cost(input);
+        if (rep.input_tokens > remaining) {
+            input = TruncateToTokens(input, remaining - MESSAGE_OVERHEAD_TOKENS);
+            rep.input_tokens = Cost(input);
+            rep.input_truncated = true;
+        }
+        remaining -= rep.input_tokens;
+    }
+
+    // 3. 会话记忆
+    std::string session_memory;
+    PromptBuilder::RenderSessionMemory(memory, session_memory);
+    int session_cost = Cost(session_memory);
+    if (session_cost <= remaining) {
+        rep.pinned_tokens += session_cost;
+        remaining -= session_cost;
+    } else {
+        session_memory.clear();
+        rep.session_memory_dropped = true;
+    }
+
+    // 4. 相关记忆：已按得分排序，从低分一端裁剪
+    std::vector<MemoryHit> hits(relevant);
+    std::string hits_text;
+    while (!hits.empty()) {
+        hits_text.clear();
+        PromptBuilder::RenderRelevantMemory(hits, hits_text);
+        if (Cost(hits_text) <= remaining) {
+            break;
+        }
+        hits.pop_back();
+        hits_text.clear();
+    }
+    rep.hits_kept = hits.size();
+    rep.hits_dropped = relevant.size() - hits.size();
+    if (!hits_text.empty()) {
+        rep.hit_tokens = Cost(hits_text);
+        remaining -= rep.hit_tokens;
+    }
+
+    // 5. 对话历史按轮分组（跳过系统消息）
+    std::vector<Message> messages;
+    messages.reserve(history.size());
+    for (const auto& msg : history) {
+        if (msg.role != Role::SYSTEM) {
+            messages.push_back(msg);
+        }
+    }
+    std::vector<Turn> turns;
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (turns.empty() || messages[i].role == Role::USER) {
+            turns.push_back({i, i + 1});
+        } else {
+            turns.back().end = i + 1;
+        }
+    }
+
+    // 成块折叠：原文窗口保持在 N 到 2N-1 轮
+    const size_t recent = budget.recent_turns > 0 ? budget.recent_turns : 1;
+    size_t folded = turns.size() > recent ? (turns.size() - recent) / recent * recent : 0;
+
+    // 原文从最新一轮往前装，装不下的部分并入折叠区
+    size_t verbatim_begin = turns.size();
+    while (verbatim_begin > folded) {
+        const Turn& turn = turns[verbatim_begin - 1];
+        int cost = 0;
+        for (size_t i = turn.begin; i < turn.end; i++) {
+            cost += Cost(messages[i].content);
+        }
+        if (cost > remaining) {
+            break;
+        }
+        remaining -= cost;
+        rep.recent_tokens += cost;
+        verbatim_begin--;
+    }
+    folded = verbatim_begin;
+    rep.turns_verbatim = turns.size() - folded;
+
+    // 6. 较早轮次摘要：占用不超过 summary_tokens，从新到旧装入；放不下时
+    //    按 N 轮成块丢弃最旧的轮次，摘要内容不会每轮滑动
+    std::vector<FoldedTurn> folded_turns;
+    folded_turns.reserve(folded);
+    for (size_t t = 0; t < folded; t++) {
+        folded_turns.push_back(FoldTurn(messages, turns[t], budget.summary_chars));
+    }
+
+    const int earlier_budget = std::min(remaining, budget.summary_tokens);
+    const int header_cost = MESSAGE_OVERHEAD_TOKENS +
+        MemoryIndex::EstimateTokens(std::string(kEarlierTurns_text, kEarlierTurns.static_bytes));
+    size_t summary_begin = folded;
+    if (folded > 0 && header_cost < earlier_budget) {
+        int available = earlier_budget - header_cost;
+        while (summary_begin > 0) {
+            int cost = MemoryIndex::EstimateTokens(folded_turns[summary_begin - 1].line);
+            if (cost > available) {
+                break;
+            }
+            available -= cost;
+            summary_begin--;
+        }
+        summary_begin = std::min(folded, (summary_begin + recent - 1) / recent * recent);
+        if (summary_begin < folded) {
+            rep.summary_tokens = header_cost;
+            for (size_t t = summary_begin; t < folded; t++) {
+                rep.summary_tokens += MemoryIndex::EstimateTokens(folded_turns[t].line);
+            }
+        }
+    }
+    rep.turns_summarized = folded - summary_begin;
+    rep.turns_dropped = summary_begin;
+
+    // 7. 图像描述：优先级最低，只取已摘要轮次中的，从新到旧装入摘要预算的剩余部分
+    std::vector<const std::string*> images;
+    size_t total_images = 0;
+    for (const auto& turn : folded_turns) {
+        total_images += turn.images.size();
+    }
+    const int image_header =
+        MemoryIndex::EstimateTokens(std::string(kEarlierImages_text, kEarlierImages.static_bytes)) +
+        (rep.turns_summarized > 0 ? 1 : MESSAGE_OVERHEAD_TOKENS);
+    int available = earlier_budget - rep.summary_tokens - image_header;
+    for (size_t t = folded; t-- > summary_begin && available > 0;) {
+        const auto& turn_images = folded_turns[t].images;
+        for (size_t k = turn_images.size(); k-- > 0;) {
+            int cost = MemoryIndex::EstimateTokens(turn_images[k]) + 1;
+            if (cost > available) {
+                available = 0;
+                break;
+            }
+            available -= cost;
+            images.push_back(&turn_images[k]);
+        }
+    }
+    if (!images.empty()) {
+        rep.image_tokens = earlier_budget - rep.summary_tokens - available;
+    }
+    rep.images_kept = images.size();
+    rep.images_dropped = total_images - images.size();
+    remaining -= rep.summary_tokens + rep.image_tokens;
+
+    // ==================== 按缓存友好的顺序输出 ====================
+
+    std::vector<Message> request;
+    request.reserve(rep.turns_verbatim * 2 + 6);
+
+    request.push_back(Message(Role::SYSTEM, prefix));
+    if (!session_memory.empty()) {
+        request.push_back(SystemMessage(std::move(session_memory)));
+    }
+
+    // 较早轮次摘要（每 N 轮才变化一次）
+    if (rep.turns_summarized > 0 || !images.empty()) {
+        std::string earlier;
+        if (rep.turns_summarized > 0) {
+            RenderTemplate(kEarlierTurns, earlier, [&](int, auto& sink) {
+                for (size_t t = summary_begin; t < folded; t++) {
+                    sink.Append(folded_turns[t].line);
+                }
+            });
+        }
+        if (!images.empty()) {
+            if (!earlier.empty()) {
+                earlier += "\n";
+            }
+            // images 为从新到旧，按时间顺序输出
+            RenderTemplate(kEarlierImages, earlier, [&](int, auto& sink) {
+                for (size_t k = images.size(); k-- > 0;) {
+                    sink.Append("- ", 2);
+                    sink.Append(*images[k]);
+                    sink.Append("\n", 1);
+                }
+            });
+        }
+        request.push_back(SystemMessage(std::move(earlier)));
+    }
+
+    // 最近轮次原文
+    for (size_t t = folded; t < turns.size(); t++) {
+        for (size_t i = turns[t].begin; i < turns[t].end; i++) {
+            request.push_back(std::move(messages[i]));
+        }
+    }
+
+    if (!hits_text.empty()) {
+        request.push_back(SystemMessage(std::move(hits_text)));
+    }
+
+    if (!input.empty()) {
+        request.push_back(Message(Role::USER, input));
+    }
+
+    rep.used_tokens = budget.prompt_tokens - remaining;
+
+    if (rep.hits_dropped > 0 || rep.turns_dropped > 0 || rep.images_dropped > 0 ||
+        rep.session_memory_dropped || rep.input_truncated) {
+        ESP_LOGW(TAG, "Context over budget (%d tokens): dropped %zu hits, %zu turns, %zu images%s%s",
+                 rep.budget_tokens, rep.hits_dropped, rep.turns_dropped, rep.images_dropped,
+                 rep.session_memory_dropped ? ", session memory" : "",
+                 rep.input_truncated ? ", input truncated" : "");
+    }
+    ESP_LOGI(TAG, "Packed %d/%d tokens: %zu turns verbatim, %zu summarized, %zu hits, %zu images",
+             rep.used_tokens, rep.budget_tokens, rep.turns_verbatim, rep.turns_summarized,
+             rep.hits_kept, rep.images_kept);
+
+    if (report) {
+        *report = rep;
+    }
+    return request;
+}
+
+} // namespace EvoSpark
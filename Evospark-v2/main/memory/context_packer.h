@@ -0,0 +1,78 @@
+#ifndef CONTEXT_PACKER_H
+#define CONTEXT_PACKER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "memory_types.h"
+#include "memory_index.h"
+
+namespace EvoSpark {
+
+// 上下文预算
+struct ContextBudget {
+    int prompt_tokens = 4096;     // 请求 prompt 上限（不含回复）
+    size_t recent_turns = 4;      // 至少原文保留的最近轮数
+    int summary_tokens = 1024;    // 较早轮次摘要 + 图像描述的上限
+    int summary_chars = 48;       // 较早轮次摘要中每句保留的字符数
+};
+
+// 打包报告：各部分占用与被裁掉的内容
+struct PackReport {
+    int budget_tokens = 0;
+    int used_tokens = 0;
+
+    int pinned_tokens = 0;        // 固定前缀 + 会话记忆
+    int input_tokens = 0;
+    int hit_tokens = 0;
+    int recent_tokens = 0;
+    int summary_tokens = 0;
+    int image_tokens = 0;
+
+    size_t hits_kept = 0;
+    size_t hits_dropped = 0;
+    size_t turns_verbatim = 0;    // 原文保留的轮数
+    size_t turns_summarized = 0;  // 折叠为摘要的轮数
+    size_t turns_dropped = 0;     // 摘要也放不下而丢弃的轮数
+    size_t images_kept = 0;
+    size_t images_dropped = 0;
+
+    bool session_memory_dropped = false;
+    bool input_truncated = false;
+};
+
+// 上下文打包器 - 按优先级把内容装入固定的 token 预算
+//
+// 优先级从高到低：固定人设 → 当前输入 → 会话记忆 → 检索到的相关记忆 →
+// 最近 N 轮原文 → 较早轮次的摘要 → 较早轮次里的图像描述。
+// 预算固定，请求长度不随会话变长而增长，首 token 延迟保持稳定。
+//
+// 输出顺序仍按变化频率排列（见 PromptBuilder::BuildRequest）。较早轮次
+// 以 recent_turns 为步长成块折叠：原文窗口在 N 到 2N-1 轮之间伸缩，
+// 摘要消息每 N 轮才变化一次，其余轮次的请求前缀保持不变。
+class ContextPacker {
+public:
+    static std::vector<Message> Pack(
+        const CompressedMemory& memory,
+        const std::vector<MemoryHit>& relevant,
+        const std::vector<Message>& history,
+        const std::string& user_input,
+        const ContextBudget& budget,
+        PackReport* report = nullptr
+    );
+
+    // 图像输入在对话历史中的格式："[图像: 描述] 文本"
+    static std::string FormatImageInput(const std::string& description,
+                                        const std::string& text);
+
+    // 拆出图像描述，不含图像标记时返回 false
+    static bool SplitImageInput(const std::string& content,
+                                std::string& description, std::string& text);
+
+    // 每条消息的固定开销（role 等字段）
+    static constexpr int MESSAGE_OVERHEAD_TOKENS = 4;
+};
+
+} // namespace EvoSpark
+
+#endif // CONTEXT_PACKER_H
@@ -1,5 +1,6 @@
 #include "conversation_buffer.h"
 #include "esp_log.h"
+#include "json_codec.h"
 #include <algorithm>
 #include <cstring>
 
@@ -7,6 +8,67 @@ namespace EvoSpark {
 
 static const char* TAG = "ConvBuffer";
 
+namespace {
+
+// [{"role":"user","content":"...","ts":123}, ...] 的 SAX 处理
+class MessageListHandler : public JsonHandler {
+public:
+    explicit MessageListHandler(std::vector<Message>& out) : out_(out) {}
+
+    bool OnBeginArray() override {
+        // 只接受顶层数组
+        return depth_++ == 0;
+    }
+    bool OnEndArray() override { depth_--; return true; }
+
+    bool OnBeginObject() override {
+        if (depth_++ != 1) {
+            return depth_ > 2;   // 消息内嵌套的对象忽略
+        }
+        out_.emplace_back();
+        out_.back().role = Role::USER;
+        return true;
+    }
+    bool OnEndObject() override { depth_--; return true; }
+
+    bool OnKey(const char* key, size_t length) override {
+        if (depth_ == 2) {
+            key_.assign(key, length);
+        }
+        return true;
+    }
+
+    bool OnString(const char* value, size_t length) override {
+        if (depth_ != 2) {
+            return depth_ > 2;
+        }
+        Message& msg = out_.back();
+        if (key_ == "content") {
+            msg.content.assign(value, length);
+        } else if (key_ == "role") {
+            std::string role(value, length);
+            if (role == "system") msg.role = Role::SYSTEM;
+            else if (role == "assistant") msg.role = Role::ASSISTANT;
+            else msg.role = Role::USER;
+        }
+        return true;
+    }
+
+    bool OnNumber(double value, const char*, size_t) override {
+        if (depth_ == 2 && key_ == "ts") {
+            out_.back().timestamp = static_cast<std::time_t>(value);
+        }
+        return depth_ >= 2;
+    }
+
+private:
+    std::vector<Message>& out_;
+    std::string key_;
+    int depth_ = 0;
+};
+
+} // namespace
+
 ConversationBuffer::ConversationBuffer(size_t max_size)
     : max_size_(max_size), current_size_(0) {
 }
@@ -22,6 +84,7 @@ void ConversationBuffer::AddMessage(Role role, const std::string& content) {
         size_t removed_size = CalculateSize(messages_.front());
         messages_.erase(messages_.begin());
         current_size_ -= removed_size;
+        dropped_++;
         ESP_LOGW(TAG, "Removed oldest message to make space");
     }
 
@@ -54,6 +117,7 @@ void ConversationBuffer::Clear() {
     std::lock_guard<std::mutex> lock(mutex_);
     messages_.clear();
     current_size_ = 0;
+    dropped_ = 0;
 }
 
 bool ConversationBuffer::IsEmpty() const {
@@ -71,36 +135,58 @@ size_t ConversationBuffer::GetSize() const {
     return current_size_;
 }
 
-std::string ConversationBuffer::ToJson() const {
+size_t ConversationBuffer::GetDroppedCount() const {
     std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
 
-    std::string json = "[";
+std::string ConversationBuffer::ToJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
 
-    for (size_t i = 0; i < messages_.size(); i++) {
-        const Message& msg = messages_[i];
+    std::string json;
+    JsonWriteTo(json, [this](auto& w) {
+        w.BeginArray();
+        for (const Message& msg : messages_) {
+            w.BeginObject();
+            w.Field("role", RoleToString(msg.role));
+            w.Field("content", msg.content);
+            w.Field("ts", static_cast<long long>(msg.timestamp));
+            w.EndObject();
+        }
+        w.EndArray();
+    });
+    return json;
+}
 
-        if (i > 0) json += ",";
+bool ConversationBuffer::FromJson(const std::string& json) {
+    std::vector<Message> messages;
+    MessageListHandler handler(messages);
+    JsonReader reader;
+    if (reader.Parse(json, handler) != JsonParseError::NONE) {
+        ESP_LOGE(TAG, "Invalid conversation JSON at byte %zu", reader.ErrorOffset());
+        return false;
+    }
 
-        json += "{\"role\":\"" + std::string(RoleToString(msg.role)) + "\"";
-        json += ",\"content\":\"";
+    std::lock_guard<std::mutex> lock(mutex_);
 
-        // 简单转义（生产环境应使用 JSON 库）
-        for (char c : msg.content) {
-            switch (c) {
-                case '"': json += "\\\""; break;
-                case '\\': json += "\\\\"; break;
-                case '\n': json += "\\n"; break;
-                case '\r': json += "\\r"; break;
-                case '\t': json += "\\t"; break;
-                default: json += c; break;
-            }
+    // 超出容量时只保留最新的消息
+    size_t total = 0;
+    size_t first = messages.size();
+    while (first > 0) {
+        size_t size = CalculateSize(messages[first - 1]);
+        if (total + size > max_size_) {
+            break;
         }
-
-        json += "\"}";
+        total += size;
+        first--;
     }
 
-    json += "]";
-    return json;
+    messages_.assign(std::make_move_iterator(messages.begin() + first),
+                     std::make_move_iterator(messages.end()));
+    current_size_ = total;
+    dropped_ = first;
+    ESP_LOGI(TAG, "Loaded %zu messages (%zu dropped)", messages_.size(), first);
+    return true;
 }
 
 size_t ConversationBuffer::CalculateSize(const Message& msg) const {
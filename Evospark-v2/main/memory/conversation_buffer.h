@@ -35,6 +35,9 @@ public:
     // 获取缓冲区大小（字节）
     size_t GetSize() const;
 
+    // 因超出容量被移除的消息数
+    size_t GetDroppedCount() const;
+
     // 转换为 JSON 字符串
     std::string ToJson() const;
 
@@ -45,6 +48,7 @@ private:
     std::vector<Message> messages_;
     size_t max_size_;
     size_t current_size_;
+    size_t dropped_ = 0;
     mutable std::mutex mutex_;
 
     // 计算消息大小
@@ -1,7 +1,9 @@
 #include "memory_manager.h"
 #include "prompt_builder.h"
+#include "psram_allocator.h"
 #include "../ai/llm_client.h"
 #include "esp_log.h"
+#include "json_codec.h"
 #include <sstream>
 #include <algorithm>
 
@@ -10,11 +12,114 @@ namespace EvoSpark {
 static const char* TAG = "MemoryManager";
 
 constexpr const char* MEMORY_FILE = "/spiffs/memory.json";
-constexpr const char* BACKUP_FILE_PREFIX = "/spiffs/memory_backup_";
-constexpr int BACKUP_COUNT = 3;
+constexpr const char* VERSION_PREFIX = "/spiffs/mv";
+constexpr const char* ARCHIVE_PARTITION = "model";
+constexpr const char* ARCHIVE_MOUNT = "/model";
+constexpr const char* ARCHIVE_DIR = "/model/archive";
+constexpr const char* LEGACY_BACKUP_PREFIX = "/spiffs/memory_backup_";
+constexpr int LEGACY_BACKUP_COUNT = 3;
 constexpr int MAX_MEMORY_EVENTS = 20;
+constexpr const char* SUMMARY_ARCHIVE_FILE = "/spiffs/summaries.txt";
+constexpr size_t MAX_ARCHIVED_SUMMARIES = 64;
+constexpr size_t RETRIEVAL_TOP_K = 6;
+constexpr int RETRIEVAL_TOKEN_BUDGET = 300;
+constexpr size_t MAX_COMPRESSED_BYTES = 6 * 1024;
+
+// 压缩结果的结构（与 prompt_builder 里要求的输出格式一致），压缩请求按它
+// 要求 JSON 输出并边收边校验
+constexpr JsonSchemaField kMemoryFields[] = {
+    {"user_profile", JsonType::STRING, true, JsonType::ANY},
+    {"key_events", JsonType::ARRAY, true, JsonType::STRING},
+    {"preferences", JsonType::ARRAY, true, JsonType::STRING},
+    {"last_session_summary", JsonType::STRING, true, JsonType::ANY},
+};
+constexpr JsonSchema kMemorySchema = {
+    "compressed_memory", kMemoryFields, sizeof(kMemoryFields) / sizeof(kMemoryFields[0]),
+    MAX_COMPRESSED_BYTES,
+};
+
+namespace {
+
+// 记忆文件 / 压缩结果的 SAX 处理：只取顶层对象的已知字段，
+// 其余字段及更深层的值跳过
+class MemoryHandler : public JsonHandler {
+public:
+    explicit MemoryHandler(CompressedMemory& out) : out_(out) {}
+
+    // 顶层只能是对象：顶层的数组和标量都中止解析
+    bool OnBeginObject() override { depth_++; return true; }
+    bool OnEndObject() override { depth_--; return true; }
+
+    bool OnBeginArray() override {
+        if (depth_ == 0) {
+            return false;
+        }
+        if (depth_++ == 1) {
+            list_ = key_ == "key_events" ? &out_.key_events
+                  : key_ == "preferences" ? &out_.preferences : nullptr;
+            if (list_) {
+                list_->clear();
+            }
+        }
+        return true;
+    }
+    bool OnEndArray() override {
+        if (--depth_ == 1) {
+            list_ = nullptr;
+        }
+        return true;
+    }
+
+    bool OnKey(const char* key, size_t length) override {
+        if (depth_ == 1) {
+            key_.assign(key, length);
+        }
+        return true;
+    }
+
+    bool OnString(const char* value, size_t length) override {
+        if (depth_ == 1) {
+            if (key_ == "user_profile") {
+                out_.user_profile.assign(value, length);
+            } else if (key_ == "last_session_summary") {
+                out_.last_session_summary.assign(value, length);
+            }
+        } else if (depth_ == 2 && list_ && length > 0) {
+            list_->emplace_back(value, length);
+        }
+        return depth_ > 0;
+    }
+
+    bool OnNumber(double value, const char*, size_t) override {
+        if (depth_ == 1) {
+            if (key_ == "version") {
+                out_.version = static_cast<int>(value);
+            } else if (key_ == "total_sessions") {
+                out_.total_sessions = static_cast<int>(value);
+            } else if (key_ == "last_updated") {
+                out_.last_updated = static_cast<std::time_t>(value);
+            }
+        }
+        return depth_ > 0;
+    }
 
-MemoryManager::MemoryManager() {
+    bool OnBool(bool) override { return depth_ > 0; }
+    bool OnNull() override { return depth_ > 0; }
+
+private:
+    CompressedMemory& out_;
+    std::vector<std::string>* list_ = nullptr;
+    std::string key_;
+    int depth_ = 0;
+};
+
+} // namespace
+
+MemoryManager::MemoryManager()
+    : flash_storage_(FlashStorage::GetInstance()),
+      version_store_(VERSION_PREFIX),
+      session_archive_(ARCHIVE_DIR),
+      snapshot_(std::make_shared<const MemorySnapshot>()) {
 }
 
 bool MemoryManager::Init(const std::string& api_key) {
@@ -32,15 +137,47 @@ bool MemoryManager::Init(const std::string& api_key) {
         return false;
     }
 
-    // 加载缓存
-    cached_memory_ = LoadMemory();
+    // 加载版本历史
+    version_store_.Init();
+    MigrateLegacyBackups();
+
+    // 会话归档放在 FAT model 分区，失败不影响记忆功能
+    archive_ready_ = flash_storage_.MountFat(ARCHIVE_PARTITION, ARCHIVE_MOUNT) &&
+                     session_archive_.Init();
+    if (!archive_ready_) {
+        ESP_LOGW(TAG, "Session archive unavailable");
+    }
+
+    // 启动时读取一次 Flash（记忆和摘要归档），之后所有读者只访问内存
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex_);
+        PublishSnapshot(LoadFromFlash());
+        summaries_ = LoadSummaryArchive();
+        RebuildIndex();
+    }
 
     initialized_ = true;
     ESP_LOGI(TAG, "MemoryManager initialized");
     return true;
 }
 
-CompressedMemory MemoryManager::LoadMemory() {
+MemorySnapshotPtr MemoryManager::GetSnapshot() const {
+    return snapshot_.Load();
+}
+
+void MemoryManager::PublishSnapshot(const CompressedMemory& memory) {
+    uint32_t generation = initialized_ ? GetSnapshot()->generation + 1 : 0;
+
+    auto snapshot = std::allocate_shared<MemorySnapshot>(PsramAllocator<MemorySnapshot>());
+    snapshot->memory = memory;
+    snapshot->generation = generation;
+    snapshot_.Store(std::move(snapshot));
+
+    ESP_LOGI(TAG, "Memory snapshot published: generation %u",
+             static_cast<unsigned>(generation));
+}
+
+CompressedMemory MemoryManager::LoadFromFlash() {
     CompressedMemory memory;
 
     std::string json;
@@ -60,9 +197,13 @@ CompressedMemory MemoryManager::LoadMemory() {
     return memory;
 }
 
-bool MemoryManager::SaveMemory(const CompressedMemory& memory) {
-    // 滚动备份
-    RotateBackups();
+bool MemoryManager::SaveMemory(const CompressedMemory& memory, const MemorySnapshotPtr& base) {
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+    if (base && GetSnapshot()->generation != base->generation) {
+        ESP_LOGW(TAG, "Memory changed since generation %u, discarding result",
+                 static_cast<unsigned>(base->generation));
+        return false;
+    }
 
     // 序列化
     std::string json = SerializeMemory(memory);
@@ -73,9 +214,22 @@ bool MemoryManager::SaveMemory(const CompressedMemory& memory) {
         return false;
     }
 
-    // 更新缓存
-    cached_memory_ = memory;
-    cached_memory_.raw_json = json;
+    // 记录版本（增量存储）
+    if (!version_store_.Commit(json)) {
+        ESP_LOGW(TAG, "Failed to record memory version");
+    }
+
+    // 新的会话摘要进入归档
+    if (!memory.last_session_summary.empty() &&
+        memory.last_session_summary != GetSnapshot()->memory.last_session_summary) {
+        ArchiveSessionSummary(memory.last_session_summary);
+    }
+
+    // 发布新快照
+    CompressedMemory committed = memory;
+    committed.raw_json = json;
+    PublishSnapshot(committed);
+    RebuildIndex();
 
     ESP_LOGI(TAG, "Memory saved: %zu bytes", json.size());
     return true;
@@ -100,63 +254,241 @@ CompressedMemory MemoryManager::CompressMemory(
         return old_memory;  // 返回旧记忆
     }
 
-    // 解析响应
     CompressedMemory new_memory;
-    if (ParseMemory(response, new_memory)) {
-        new_memory.last_updated = std::time(nullptr);
-        new_memory.version = old_memory.version + 1;
-        new_memory.total_sessions = old_memory.total_sessions + 1;
-        new_memory.raw_json = response;
+    if (!ApplyCompression(old_memory, response, new_memory)) {
+        return old_memory;
+    }
+    return new_memory;
+}
 
-        ESP_LOGI(TAG, "Memory compressed: v%d, %zu events, %zu preferences",
-                 new_memory.version, new_memory.key_events.size(),
-                 new_memory.preferences.size());
+void MemoryManager::CompressMemoryAsync(const CompressedMemory& old_memory,
+                                        const std::vector<Message>& session_messages,
+                                        CompressCallback done) {
+    ESP_LOGI(TAG, "Submitting memory compression...");
+
+    LLMClient::Request request;
+    request.task = LLMTask::COMPRESSION;
+    request.priority = RequestPriority::BACKGROUND;
+    request.schema = &kMemorySchema;
+    request.messages.push_back(Message(Role::USER,
+        PromptBuilder::BuildCompressionPrompt(old_memory, session_messages)));
+
+    LLMClient::GetInstance().Submit(std::move(request),
+        [this, old_memory, done](const LLMResponse& resp) {
+            CompressedMemory new_memory;
+            if (!resp.success) {
+                ESP_LOGE(TAG, "LLM compression failed: %s", resp.error_message.c_str());
+                done(false, old_memory);
+            } else if (!ApplyCompression(old_memory, resp.content, new_memory)) {
+                done(false, old_memory);
+            } else {
+                done(true, new_memory);
+            }
+        });
+}
 
-        return new_memory;
-    } else {
+bool MemoryManager::ApplyCompression(const CompressedMemory& old_memory,
+                                     const std::string& response,
+                                     CompressedMemory& new_memory) {
+    if (!ParseMemory(response, new_memory)) {
         ESP_LOGE(TAG, "Failed to parse LLM response, keeping old memory");
-        return old_memory;
+        return false;
     }
+    new_memory.last_updated = std::time(nullptr);
+    new_memory.version = old_memory.version + 1;
+    new_memory.total_sessions = old_memory.total_sessions + 1;
+    // 保存校验、截断后的结果，不保存 LLM 的原始回复
+    new_memory.raw_json = SerializeMemory(new_memory);
+
+    ESP_LOGI(TAG, "Memory compressed: v%d, %zu events, %zu preferences",
+             new_memory.version, new_memory.key_events.size(),
+             new_memory.preferences.size());
+    return true;
 }
 
 bool MemoryManager::RollbackToBackup(int version) {
-    if (version < 1 || version > BACKUP_COUNT) {
-        ESP_LOGE(TAG, "Invalid backup version: %d", version);
+    // 历史中第 0 项为当前版本
+    if (version < 1 || version >= static_cast<int>(version_store_.Count())) {
+        ESP_LOGE(TAG, "Invalid backup version: %d (have %zu)",
+                 version, version_store_.Count());
         return false;
     }
 
-    std::string backup_file = BACKUP_FILE_PREFIX + std::to_string(version) + ".json";
     std::string json;
+    if (!version_store_.CheckoutNth(version, json)) {
+        ESP_LOGE(TAG, "Failed to reconstruct version %d", version);
+        return false;
+    }
 
-    if (!flash_storage_.ReadFile(backup_file, json)) {
-        ESP_LOGE(TAG, "Failed to read backup file: %s", backup_file.c_str());
+    if (!RestoreMemory(json)) {
         return false;
     }
 
-    // 恢复备份
-    if (!flash_storage_.WriteFile(MEMORY_FILE, json)) {
-        ESP_LOGE(TAG, "Failed to restore backup");
+    ESP_LOGI(TAG, "Rolled back to backup %d", version);
+    return true;
+}
+
+bool MemoryManager::RollbackToHash(const std::string& hash) {
+    std::string json;
+    if (!version_store_.CheckoutByHash(hash, json)) {
         return false;
     }
 
-    // 重新加载缓存
-    cached_memory_ = LoadMemory();
+    if (!RestoreMemory(json)) {
+        return false;
+    }
 
-    ESP_LOGI(TAG, "Rolled back to backup %d", version);
+    ESP_LOGI(TAG, "Rolled back to version %s", hash.c_str());
     return true;
 }
 
-std::vector<std::string> MemoryManager::GetBackupList() {
-    std::vector<std::string> backups;
+std::vector<MemoryHit> MemoryManager::RetrieveRelevant(const std::string& query) {
+    return RetrieveRelevant(query, RETRIEVAL_TOP_K, RETRIEVAL_TOKEN_BUDGET);
+}
+
+std::vector<MemoryHit> MemoryManager::RetrieveRelevant(const std::string& query,
+                                                       size_t top_k,
+                                                       int token_budget) {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    std::vector<MemoryHit> hits = memory_index_.Query(query, top_k, token_budget);
+
+    int tokens = 0;
+    for (const auto& hit : hits) {
+        tokens += hit.tokens;
+    }
+    ESP_LOGI(TAG, "Retrieved %zu/%zu memories, %d/%d tokens",
+             hits.size(), memory_index_.Size(), tokens, memory_index_.GetTotalTokens());
+    return hits;
+}
+
+RetrievalStats MemoryManager::GetRetrievalStats() const {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    return memory_index_.GetStats();
+}
+
+void MemoryManager::RebuildIndex() {
+    MemorySnapshotPtr snapshot = GetSnapshot();
+    const CompressedMemory& memory = snapshot->memory;
+
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    memory_index_.Clear();
+
+    for (const auto& event : memory.key_events) {
+        memory_index_.Add(MemorySource::EVENT, event);
+    }
+    for (const auto& pref : memory.preferences) {
+        memory_index_.Add(MemorySource::PREFERENCE, pref);
+    }
+    // 最新摘要总是直接放入 Prompt，不重复索引
+    for (const auto& summary : summaries_) {
+        if (summary != memory.last_session_summary) {
+            memory_index_.Add(MemorySource::SUMMARY, summary);
+        }
+    }
+
+    ESP_LOGI(TAG, "Memory index rebuilt: %zu items, %d tokens",
+             memory_index_.Size(), memory_index_.GetTotalTokens());
+}
+
+void MemoryManager::ArchiveSessionSummary(const std::string& summary) {
+    // 每行一条摘要
+    std::string line = summary;
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    summaries_.push_back(line);
+
+    if (summaries_.size() > MAX_ARCHIVED_SUMMARIES) {
+        summaries_.erase(summaries_.begin(),
+                         summaries_.end() - MAX_ARCHIVED_SUMMARIES);
+    }
+
+    std::string content;
+    for (const auto& s : summaries_) {
+        content += s;
+        content += '\n';
+    }
+
+    if (!flash_storage_.WriteFile(SUMMARY_ARCHIVE_FILE, content)) {
+        ESP_LOGW(TAG, "Failed to archive session summary");
+    }
+}
+
+std::vector<std::string> MemoryManager::LoadSummaryArchive() {
+    std::vector<std::string> summaries;
+
+    std::string content;
+    if (!flash_storage_.ReadFile(SUMMARY_ARCHIVE_FILE, content)) {
+        return summaries;
+    }
 
-    for (int i = 1; i <= BACKUP_COUNT; i++) {
-        std::string file = BACKUP_FILE_PREFIX + std::to_string(i) + ".json";
-        if (flash_storage_.FileExists(file)) {
-            backups.push_back("Backup " + std::to_string(i));
+    std::istringstream iss(content);
+    std::string line;
+    while (std::getline(iss, line)) {
+        if (!line.empty()) {
+            summaries.push_back(line);
         }
     }
+    return summaries;
+}
+
+std::vector<VersionInfo> MemoryManager::GetVersionHistory() const {
+    return version_store_.List();
+}
+
+bool MemoryManager::RestoreMemory(const std::string& json) {
+    CompressedMemory memory;
+    if (!ParseMemory(json, memory)) {
+        ESP_LOGE(TAG, "Failed to parse backup");
+        return false;
+    }
+    memory.raw_json = json;
+
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+
+    if (!flash_storage_.WriteFile(MEMORY_FILE, json)) {
+        ESP_LOGE(TAG, "Failed to restore backup");
+        return false;
+    }
+
+    // 回滚本身也作为新版本记录，便于撤销
+    version_store_.Commit(json);
+
+    // 直接发布解析结果，不再回读 Flash
+    PublishSnapshot(memory);
+    RebuildIndex();
+    return true;
+}
+
+uint32_t MemoryManager::ArchiveSession(const std::vector<Message>& messages,
+                                       const SessionStats& stats,
+                                       const std::string& summary) {
+    if (!archive_ready_ || messages.empty()) {
+        return 0;
+    }
 
-    return backups;
+    std::string record;
+    JsonWriteTo(record, [&](auto& w) {
+        w.BeginObject();
+        w.Key("messages");
+        w.BeginArray();
+        for (const auto& msg : messages) {
+            if (msg.role == Role::SYSTEM) {
+                continue;
+            }
+            w.BeginObject();
+            w.Field("role", RoleToString(msg.role));
+            w.Field("content", msg.content);
+            w.Field("ts", static_cast<long long>(msg.timestamp));
+            w.EndObject();
+        }
+        w.EndArray();
+        w.Field("summary", summary);
+        w.Field("user_messages", stats.user_messages);
+        w.Field("assistant_messages", stats.assistant_messages);
+        w.Field("duration", stats.duration_seconds);
+        w.EndObject();
+    });
+
+    return session_archive_.Append(stats.start_time, stats.end_time, record);
 }
 
 size_t MemoryManager::GetFreeSpace() {
@@ -170,116 +502,103 @@ size_t MemoryManager::GetUsedSpace() {
 bool MemoryManager::ClearMemory() {
     ESP_LOGW(TAG, "Clearing all memory...");
 
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+
     // 删除主文件
     flash_storage_.DeleteFile(MEMORY_FILE);
 
-    // 删除备份
-    for (int i = 1; i <= BACKUP_COUNT; i++) {
-        std::string file = BACKUP_FILE_PREFIX + std::to_string(i) + ".json";
-        flash_storage_.DeleteFile(file);
-    }
+    // 删除版本历史和摘要归档
+    version_store_.Clear();
+    flash_storage_.DeleteFile(SUMMARY_ARCHIVE_FILE);
+    summaries_.clear();
 
-    // 清空缓存
-    cached_memory_ = CompressedMemory();
+    // 发布空快照
+    PublishSnapshot(CompressedMemory());
+    RebuildIndex();
 
     ESP_LOGI(TAG, "Memory cleared");
     return true;
 }
 
-void MemoryManager::RotateBackups() {
-    // 备份 3 -> 删除
-    std::string file3 = BACKUP_FILE_PREFIX + "3.json";
-    flash_storage_.DeleteFile(file3);
+void MemoryManager::MigrateLegacyBackups() {
+    // 历史为空时导入旧版备份（1 = 最新，从旧到新导入），再接上当前记忆
+    bool import = (version_store_.Count() == 0);
 
-    // 备份 2 -> 备份 3
-    std::string file2 = BACKUP_FILE_PREFIX + "2.json";
-    if (flash_storage_.FileExists(file2)) {
+    for (int i = LEGACY_BACKUP_COUNT; i >= 1; i--) {
+        std::string file = LEGACY_BACKUP_PREFIX + std::to_string(i) + ".json";
+        // 迁移后旧备份已删除，之后每次启动只 stat 一下，不打 "Failed to open"
         std::string content;
-        flash_storage_.ReadFile(file2, content);
-        flash_storage_.WriteFile(file3, content);
-    }
-
-    // 备份 1 -> 备份 2
-    std::string file1 = BACKUP_FILE_PREFIX + "1.json";
-    if (flash_storage_.FileExists(file1)) {
-        std::string content;
-        flash_storage_.ReadFile(file1, content);
-        flash_storage_.WriteFile(file2, content);
+        if (!flash_storage_.FileExists(file) || !flash_storage_.ReadFile(file, content)) {
+            continue;
+        }
+        if (import) {
+            version_store_.Commit(content);
+        }
+        flash_storage_.DeleteFile(file);
     }
 
-    // 当前 -> 备份 1
-    if (flash_storage_.FileExists(MEMORY_FILE)) {
-        std::string content;
-        flash_storage_.ReadFile(MEMORY_FILE, content);
-        flash_storage_.WriteFile(file1, content);
+    std::string current;
+    if (import && flash_storage_.FileExists(MEMORY_FILE) &&
+        flash_storage_.ReadFile(MEMORY_FILE, current)) {
+        version_store_.Commit(current);
+        ESP_LOGI(TAG, "Version history seeded: %zu versions", version_store_.Count());
     }
-
-    ESP_LOGI(TAG, "Backups rotated");
 }
 
 bool MemoryManager::ParseMemory(const std::string& json, CompressedMemory& memory) {
-    // 简单 JSON 解析（生产环境应使用 cJSON 或 ArduinoJson）
-    // 这里仅作演示
-
     if (json.empty()) {
         return false;
     }
 
-    // TODO: 使用 JSON 库正确解析
-    // 临时方案：假设是格式化的 JSON
-
-    memory.raw_json = json;
-
-    // 查找 user_profile
-    size_t pos = json.find("\"user_profile\":");
-    if (pos != std::string::npos) {
-        size_t start = json.find("\"", pos + 16);
-        size_t end = json.find("\"", start + 1);
-        if (start != std::string::npos && end != std::string::npos) {
-            memory.user_profile = json.substr(start + 1, end - start - 1);
-        }
+    // 压缩结果已由 LLMClient 按 kMemorySchema 校验并取出 JSON 对象，
+    // Flash 上的文件由 SerializeMemory 写出：两者都必须是完整的对象，不再裁剪前后文字
+    CompressedMemory parsed;
+    MemoryHandler handler(parsed);
+    JsonReader reader;
+    JsonParseError error = reader.Parse(json, handler);
+    if (error != JsonParseError::NONE) {
+        ESP_LOGE(TAG, "Memory JSON invalid at byte %zu", reader.ErrorOffset());
+        return false;
     }
 
-    // TODO: 解析其他字段
+    if (parsed.key_events.size() > static_cast<size_t>(MAX_MEMORY_EVENTS)) {
+        parsed.key_events.erase(parsed.key_events.begin(),
+                                parsed.key_events.end() - MAX_MEMORY_EVENTS);
+    }
 
+    memory = std::move(parsed);
     return true;
 }
 
 std::string MemoryManager::SerializeMemory(const CompressedMemory& memory) {
-    std::ostringstream oss;
-
-    oss << "{\n";
-    oss << "  \"version\": " << memory.version << ",\n";
-    oss << "  \"total_sessions\": " << memory.total_sessions << ",\n";
-    oss << "  \"last_updated\": " << memory.last_updated << ",\n";
-
-    // user_profile
-    oss << "  \"user_profile\": \"" << memory.user_profile << "\",\n";
-
-    // key_events
-    oss << "  \"key_events\": [\n";
-    for (size_t i = 0; i < memory.key_events.size(); i++) {
-        oss << "    \"" << memory.key_events[i] << "\"";
-        if (i < memory.key_events.size() - 1) oss << ",";
-        oss << "\n";
-    }
-    oss << "  ],\n";
-
-    // preferences
-    oss << "  \"preferences\": [\n";
-    for (size_t i = 0; i < memory.preferences.size(); i++) {
-        oss << "    \"" << memory.preferences[i] << "\"";
-        if (i < memory.preferences.size() - 1) oss << ",";
-        oss << "\n";
-    }
-    oss << "  ],\n";
-
-    // last_session_summary
-    oss << "  \"last_session_summary\": \"" << memory.last_session_summary << "\"\n";
+    // 带缩进输出：Flash 上的文件便于人工查看，也让版本间差异集中在改动的行
+    std::string json;
+    JsonWriteTo(json, [&memory](auto& w) {
+        w.BeginObject();
+        w.Field("version", memory.version);
+        w.Field("total_sessions", memory.total_sessions);
+        w.Field("last_updated", static_cast<long long>(memory.last_updated));
+        w.Field("user_profile", memory.user_profile);
+
+        w.Key("key_events");
+        w.BeginArray();
+        for (const auto& event : memory.key_events) {
+            w.String(event);
+        }
+        w.EndArray();
 
-    oss << "}\n";
+        w.Key("preferences");
+        w.BeginArray();
+        for (const auto& pref : memory.preferences) {
+            w.String(pref);
+        }
+        w.EndArray();
 
-    return oss.str();
+        w.Field("last_session_summary", memory.last_session_summary);
+        w.EndObject();
+    }, 2);
+    json += '\n';
+    return json;
 }
 
 bool MemoryManager::CallLLMForCompression(
@@ -294,7 +613,7 @@ bool MemoryManager::CallLLMForCompression(
         return false;
     }
 
-    LLMResponse resp = llm.CompressMemory(prompt);
+    LLMResponse resp = llm.CompressMemory(prompt, &kMemorySchema);
     if (!resp.success) {
         ESP_LOGE(TAG, "LLM compression failed: %s", resp.error_message.c_str());
         return false;
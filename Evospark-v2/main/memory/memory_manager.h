@@ -3,9 +3,15 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
+#include <functional>
 #include "memory_types.h"
 #include "conversation_buffer.h"
+#include "memory_index.h"
+#include "snapshot_cell.h"
 #include "../storage/flash_storage.h"
+#include "version_store.h"
+#include "session_archive.h"
 
 namespace EvoSpark {
 
@@ -20,11 +26,12 @@ public:
     // 初始化
     bool Init(const std::string& api_key = "");
 
-    // 加载长期记忆
-    CompressedMemory LoadMemory();
+    // 获取当前记忆快照（不等提交锁、不读 Flash；持有期间内容不变，提交会替换为新快照）
+    MemorySnapshotPtr GetSnapshot() const;
 
-    // 保存长期记忆
-    bool SaveMemory(const CompressedMemory& memory);
+    // 保存长期记忆（写 Flash 后发布新快照）。base 非空时，当前快照的世代
+    // 已不是 base 的（压缩期间有回滚、清空或另一次保存）则放弃并返回 false
+    bool SaveMemory(const CompressedMemory& memory, const MemorySnapshotPtr& base = nullptr);
 
     // 压缩记忆（LLM 调用）
     CompressedMemory CompressMemory(
@@ -32,11 +39,37 @@ public:
         const std::vector<Message>& session_messages
     );
 
-    // 回滚到历史版本
+    // 异步压缩：以后台优先级交给 LLM 网络任务，调用方不等待。完成后在网络
+    // 任务上回调 done，失败时 memory 为 old_memory
+    using CompressCallback = std::function<void(bool success, const CompressedMemory& memory)>;
+    void CompressMemoryAsync(const CompressedMemory& old_memory,
+                             const std::vector<Message>& session_messages,
+                             CompressCallback done);
+
+    // 检索与输入相关的记忆（默认 top-k 与 token 预算见 memory_manager.cc）
+    std::vector<MemoryHit> RetrieveRelevant(const std::string& query);
+    std::vector<MemoryHit> RetrieveRelevant(const std::string& query,
+                                            size_t top_k, int token_budget);
+
+    // 检索统计
+    RetrievalStats GetRetrievalStats() const;
+
+    // 回滚到历史版本（1 = 当前版本之前的一个版本）
     bool RollbackToBackup(int version);
 
-    // 获取备份列表
-    std::vector<std::string> GetBackupList();
+    // 按内容哈希回滚（支持前缀）
+    bool RollbackToHash(const std::string& hash);
+
+    // 获取版本历史（最新在前，只读索引）
+    std::vector<VersionInfo> GetVersionHistory() const;
+
+    // 归档已结束的会话（原始对话 + 摘要），返回会话 ID，失败返回 0
+    uint32_t ArchiveSession(const std::vector<Message>& messages,
+                            const SessionStats& stats,
+                            const std::string& summary);
+
+    // 会话归档（分页读取历史）
+    SessionArchive& GetSessionArchive() { return session_archive_; }
 
     // 获取存储信息
     size_t GetFreeSpace();
@@ -53,14 +86,30 @@ private:
     MemoryManager(const MemoryManager&) = delete;
     MemoryManager& operator=(const MemoryManager&) = delete;
 
+    // 从 Flash 读取记忆（仅启动时）
+    CompressedMemory LoadFromFlash();
+
+    // 发布新快照（调用方持有 commit_mutex_）
+    void PublishSnapshot(const CompressedMemory& memory);
+
     // 解析 JSON 到 CompressedMemory
     bool ParseMemory(const std::string& json, CompressedMemory& memory);
 
     // 序列化 CompressedMemory 到 JSON
     std::string SerializeMemory(const CompressedMemory& memory);
 
-    // 滚动备份
-    void RotateBackups();
+    // 恢复指定内容为当前记忆
+    bool RestoreMemory(const std::string& json);
+
+    // 导入旧版 memory_backup_N.json 备份
+    void MigrateLegacyBackups();
+
+    // 归档会话摘要（供检索使用；调用方持有 commit_mutex_）
+    void ArchiveSessionSummary(const std::string& summary);
+    std::vector<std::string> LoadSummaryArchive();   // 仅启动时
+
+    // 按当前快照和摘要归档重建检索索引（调用方持有 commit_mutex_）
+    void RebuildIndex();
 
     // 调用 LLM API 压缩记忆
     bool CallLLMForCompression(
@@ -68,12 +117,28 @@ private:
         std::string& response
     );
 
-    FlashStorage flash_storage_;
+    // 解析压缩结果并接续版本号
+    bool ApplyCompression(const CompressedMemory& old_memory, const std::string& response,
+                          CompressedMemory& new_memory);
+
+    FlashStorage& flash_storage_;
+    VersionStore version_store_;
+    SessionArchive session_archive_;
+    bool archive_ready_ = false;
     std::string api_key_;
     bool initialized_ = false;
 
-    // 缓存的当前记忆
-    CompressedMemory cached_memory_;
+    // 当前记忆快照，位于 PSRAM。读者无锁（见 SnapshotCell），写者由
+    // commit_mutex_ 串行化
+    SnapshotCell<MemorySnapshot> snapshot_;
+    // 串行化提交（保存、回滚、清空）
+    std::mutex commit_mutex_;
+    // 会话摘要归档，启动时读一次，之后只追加写回（commit_mutex_ 保护）
+    std::vector<std::string> summaries_;
+
+    // 检索索引
+    MemoryIndex memory_index_;
+    mutable std::mutex index_mutex_;
 };
 
 } // namespace EvoSpark
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <ctime>
+#include <cstdint>
+#include <memory>
 
 namespace EvoSpark {
 
@@ -60,6 +62,14 @@ struct CompressedMemory {
     }
 };
 
+// 记忆快照 - 提交后只读，整体替换
+struct MemorySnapshot {
+    CompressedMemory memory;
+    uint32_t generation = 0;  // 每次提交递增，0 表示启动时从 Flash 载入
+};
+
+using MemorySnapshotPtr = std::shared_ptr<const MemorySnapshot>;
+
 // 会话状态
 enum class SessionState {
     IDLE,           // 待机状态
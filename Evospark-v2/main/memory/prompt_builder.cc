@@ -1,156 +1,246 @@
 #include "prompt_builder.h"
+#include "prompt_template.h"
 #include "esp_log.h"
 #include "core/session_manager.h"
-#include <sstream>
 
 namespace EvoSpark {
 
 static const char* TAG = "PromptBuilder";
 
-std::string PromptBuilder::BuildBasePersona() {
-    return R"(你是 EvoSpark，一个友好的 AI 陪伴机器人。
+// ==================== 编译期模板 ====================
+
+PROMPT_TEMPLATE(kBasePersona, R"(你是 EvoSpark，一个友好的 AI 陪伴机器人。
 你的特点：
 - 温暖、耐心、善于倾听
 - 回答简洁明了，避免冗长
 - 偶尔会表达自己的情感和想法
 - 记得和用户之前的对话内容
 
-你由 ESP32-S3 驱动，具备视觉、听觉和表达能力。)";
+你由 ESP32-S3 驱动，具备视觉、听觉和表达能力。)");
+
+PROMPT_TEMPLATE(kGuidelines, R"(
+【互动指南】
+- 根据记忆中的信息调整你的回答
+- 如果记忆中有相关事件，可以适当提及
+- 尊重用户的偏好
+- 保持自然、亲切的对话风格
+)");
+
+// 固定前缀：{{0}} 人设  {{1}} 互动指南（不含任何随会话变化的内容）
+PROMPT_TEMPLATE(kStablePrefix, "{{0}}\n{{1}}");
+
+// 会话记忆：{{0}} 画像与上次对话
+PROMPT_TEMPLATE(kSessionMemory, "【关于用户的记忆】{{0}}");
+
+// {{0}} 人设  {{1}} 记忆  {{2}} 互动指南
+PROMPT_TEMPLATE(kSystemPrompt, "{{0}}\n\n【关于用户的记忆】{{1}}{{2}}");
+
+PROMPT_TEMPLATE(kFirstMeeting, "\n[这是我们的第一次对话，还没有关于你的记忆。]");
+PROMPT_TEMPLATE(kProfileSection, "\n【用户画像】\n{{0}}\n");
+PROMPT_TEMPLATE(kEventsSection, "\n【重要事件】\n{{0}}");
+PROMPT_TEMPLATE(kPreferencesSection, "\n【用户偏好】\n{{0}}");
+PROMPT_TEMPLATE(kTurnMemory, "【与当前话题相关的记忆】\n{{0}}");
+PROMPT_TEMPLATE(kSummarySection, "\n【上次对话】\n{{0}}\n");
+
+// {{0}} 旧记忆  {{1}} 本次对话
+PROMPT_TEMPLATE(kCompressionPrompt,
+R"(你是一个记忆压缩助手。请将用户的旧记忆和本次对话整合，生成新的压缩记忆。
+
+【要求】
+1. 保留用户画像的关键信息
+2. 更新重要事件列表（保留最近 20 条）
+3. 更新用户偏好（发现新偏好时添加，最多 10 条）
+4. 移除过时或重复的信息
+5. 生成简短的上次会话摘要（1-2 句话）
+
+【输出格式】
+请严格按照以下 JSON 格式输出，不要包含其他内容：
+{
+  "user_profile": "用户画像描述",
+  "key_events": ["事件1", "事件2", ...],
+  "preferences": ["偏好1", "偏好2", ...],
+  "last_session_summary": "上次会话摘要"
 }
 
-std::string PromptBuilder::FormatMemory(const CompressedMemory& memory) {
-    if (memory.IsEmpty()) {
-        return "\n[这是我们的第一次对话，还没有关于你的记忆。]";
-    }
+【旧记忆】
+{{0}}
+【本次对话】
+{{1}})");
 
-    std::ostringstream oss;
+// ==================== 插槽内容 ====================
 
-    // 用户画像
-    if (!memory.user_profile.empty()) {
-        oss << "\n【用户画像】\n" << memory.user_profile << "\n";
-    }
+namespace {
 
-    // 关键事件
-    if (!memory.key_events.empty()) {
-        oss << "\n【重要事件】\n";
-        for (const auto& event : memory.key_events) {
-            oss << "- " << event << "\n";
-        }
+// 写入带标题的段落，内容为空时整段省略
+template <typename Tpl, typename Sink>
+void WriteSection(const Tpl& tpl, Sink& sink, const std::string& text) {
+    if (text.empty()) {
+        return;
     }
+    RenderTemplate(tpl, sink, [&text](int, Sink& s) { s.Append(text); });
+}
 
-    // 偏好
-    if (!memory.preferences.empty()) {
-        oss << "\n【用户偏好】\n";
-        for (const auto& pref : memory.preferences) {
-            oss << "- " << pref << "\n";
-        }
+// 写入列表段落（每项一行 "- 内容"）
+template <typename Tpl, typename Sink>
+void WriteListSection(const Tpl& tpl, Sink& sink, const std::vector<std::string>& items) {
+    if (items.empty()) {
+        return;
     }
+    RenderTemplate(tpl, sink, [&items](int, Sink& s) {
+        for (const auto& item : items) {
+            s.Append("- ", 2);
+            s.Append(item);
+            s.Append("\n", 1);
+        }
+    });
+}
 
-    // 上次会话摘要
-    if (!memory.last_session_summary.empty()) {
-        oss << "\n【上次对话】\n" << memory.last_session_summary << "\n";
+// 全部长期记忆
+template <typename Sink>
+void WriteMemory(Sink& sink, const CompressedMemory& memory) {
+    if (memory.IsEmpty()) {
+        RenderTemplate(kFirstMeeting, sink);
+        return;
     }
 
-    return oss.str();
+    WriteSection(kProfileSection, sink, memory.user_profile);
+    WriteListSection(kEventsSection, sink, memory.key_events);
+    WriteListSection(kPreferencesSection, sink, memory.preferences);
+    WriteSection(kSummarySection, sink, memory.last_session_summary);
 }
 
-std::string PromptBuilder::FormatHistory(const std::vector<Message>& messages) {
-    if (messages.empty()) {
-        return "";
+// 会话级记忆（画像和上次对话，整个会话保持不变）
+template <typename Sink>
+void WriteSessionMemory(Sink& sink, const CompressedMemory& memory) {
+    if (memory.IsEmpty() && memory.last_session_summary.empty()) {
+        RenderTemplate(kFirstMeeting, sink);
+        return;
     }
 
-    std::ostringstream oss;
+    WriteSection(kProfileSection, sink, memory.user_profile);
+    WriteSection(kSummarySection, sink, memory.last_session_summary);
+}
+
+// 检索到的相关记忆（已按相关度排序）
+template <typename Sink>
+void WriteHits(Sink& sink, const std::vector<MemoryHit>& relevant) {
+    for (const auto& hit : relevant) {
+        switch (hit.source) {
+            case MemorySource::PREFERENCE: sink.Append("- [偏好] "); break;
+            case MemorySource::SUMMARY:    sink.Append("- [往事] "); break;
+            default:                       sink.Append("- ", 2); break;
+        }
+        sink.Append(hit.text);
+        sink.Append("\n", 1);
+    }
+}
 
+// 对话历史（跳过系统消息）
+template <typename Sink>
+void WriteHistory(Sink& sink, const std::vector<Message>& messages) {
     for (const auto& msg : messages) {
-        // 跳过系统消息
         if (msg.role == Role::SYSTEM) {
             continue;
         }
-
-        const char* role_name = (msg.role == Role::USER) ? "用户" : "EvoSpark";
-        oss << role_name << ": " << msg.content << "\n";
+        sink.Append(msg.role == Role::USER ? "用户: " : "EvoSpark: ");
+        sink.Append(msg.content);
+        sink.Append("\n", 1);
     }
+}
 
-    return oss.str();
+template <typename Sink>
+void WriteSystemPrompt(Sink& sink, const CompressedMemory& memory) {
+    RenderTemplate(kSystemPrompt, sink, [&](int slot, Sink& s) {
+        switch (slot) {
+            case 0: RenderTemplate(kBasePersona, s); break;
+            case 1: WriteMemory(s, memory); break;
+            case 2: RenderTemplate(kGuidelines, s); break;
+        }
+    });
 }
 
-std::string PromptBuilder::BuildSystemPrompt(const CompressedMemory& memory) {
-    std::ostringstream oss;
+// 先量长度再一次性写入
+template <typename Writer>
+void RenderTwoPass(std::string& out, Writer&& write) {
+    CountingSink counter;
+    write(counter);
+    out.reserve(out.size() + counter.bytes);
 
-    // 基础人设
-    oss << BuildBasePersona();
+    StringSink sink{out};
+    write(sink);
+}
 
-    // 长期记忆
-    oss << "\n\n【关于用户的记忆】";
-    oss << FormatMemory(memory);
+} // namespace
 
-    // 指导
-    oss << "\n【互动指南】\n";
-    oss << "- 根据记忆中的信息调整你的回答\n";
-    oss << "- 如果记忆中有相关事件，可以适当提及\n";
-    oss << "- 尊重用户的偏好\n";
-    oss << "- 保持自然、亲切的对话风格\n";
+// ==================== 公共接口 ====================
 
-    return oss.str();
+std::string PromptBuilder::BuildBasePersona() {
+    return std::string(kBasePersona_text, kBasePersona.static_bytes);
 }
 
-std::vector<Message> PromptBuilder::BuildRequest(
-    const CompressedMemory& memory,
-    const std::vector<Message>& history,
-    const std::string& user_input
-) {
-    std::vector<Message> request;
+const std::string& PromptBuilder::StablePrefix() {
+    static const std::string prefix = [] {
+        std::string out;
+        RenderTemplate(kStablePrefix, out, [](int slot, auto& sink) {
+            if (slot == 0) {
+                RenderTemplate(kBasePersona, sink);
+            } else {
+                RenderTemplate(kGuidelines, sink);
+            }
+        });
+        return out;
+    }();
+    return prefix;
+}
 
-    // 系统消息
-    request.push_back(Message(Role::SYSTEM, BuildSystemPrompt(memory)));
+void PromptBuilder::RenderSessionMemory(const CompressedMemory& memory, std::string& out) {
+    RenderTemplate(kSessionMemory, out, [&memory](int, auto& sink) {
+        WriteSessionMemory(sink, memory);
+    });
+}
 
-    // 对话历史（排除第一条系统消息）
-    for (size_t i = 1; i < history.size(); i++) {
-        if (history[i].role != Role::SYSTEM) {
-            request.push_back(history[i]);
-        }
+void PromptBuilder::RenderRelevantMemory(const std::vector<MemoryHit>& relevant,
+                                         std::string& out) {
+    if (relevant.empty()) {
+        return;
     }
+    RenderTemplate(kTurnMemory, out, [&relevant](int, auto& sink) {
+        WriteHits(sink, relevant);
+    });
+}
 
-    // 当前用户输入
-    if (!user_input.empty()) {
-        request.push_back(Message(Role::USER, user_input));
-    }
+std::string PromptBuilder::BuildSystemPrompt(const CompressedMemory& memory) {
+    std::string out;
+    RenderTwoPass(out, [&](auto& sink) { WriteSystemPrompt(sink, memory); });
+    return out;
+}
 
-    return request;
+std::vector<Message> PromptBuilder::BuildRequest(
+    const CompressedMemory& memory,
+    const std::vector<MemoryHit>& relevant,
+    const std::vector<Message>& history,
+    const std::string& user_input,
+    const ContextBudget& budget,
+    PackReport* report
+) {
+    return ContextPacker::Pack(memory, relevant, history, user_input, budget, report);
 }
 
 std::string PromptBuilder::BuildCompressionPrompt(
     const CompressedMemory& old_memory,
     const std::vector<Message>& session_messages
 ) {
-    std::ostringstream oss;
-
-    oss << "你是一个记忆压缩助手。请将用户的旧记忆和本次对话整合，生成新的压缩记忆。\n\n";
-
-    oss << "【要求】\n";
-    oss << "1. 保留用户画像的关键信息\n";
-    oss << "2. 更新重要事件列表（保留最近 20 条）\n";
-    oss << "3. 更新用户偏好（发现新偏好时添加，最多 10 条）\n";
-    oss << "4. 移除过时或重复的信息\n";
-    oss << "5. 生成简短的上次会话摘要（1-2 句话）\n\n";
-
-    oss << "【输出格式】\n";
-    oss << "请严格按照以下 JSON 格式输出，不要包含其他内容：\n";
-    oss << "{\n";
-    oss << "  \"user_profile\": \"用户画像描述\",\n";
-    oss << "  \"key_events\": [\"事件1\", \"事件2\", ...],\n";
-    oss << "  \"preferences\": [\"偏好1\", \"偏好2\", ...],\n";
-    oss << "  \"last_session_summary\": \"上次会话摘要\"\n";
-    oss << "}\n\n";
-
-    oss << "【旧记忆】\n";
-    oss << FormatMemory(old_memory);
-    oss << "\n";
-
-    oss << "【本次对话】\n";
-    oss << FormatHistory(session_messages);
-
-    return oss.str();
+    std::string out;
+    RenderTemplate(kCompressionPrompt, out, [&](int slot, auto& sink) {
+        if (slot == 0) {
+            WriteMemory(sink, old_memory);
+        } else {
+            WriteHistory(sink, session_messages);
+        }
+    });
+
+    ESP_LOGD(TAG, "Compression prompt: %zu bytes", out.size());
+    return out;
 }
 
 } // namespace EvoSpark
@@ -4,20 +4,37 @@
 #include <string>
 #include <vector>
 #include "memory_types.h"
+#include "memory_index.h"
+#include "context_packer.h"
 
 namespace EvoSpark {
 
-// Prompt 构建器 - 构建发送给 LLM 的完整 Prompt
+// Prompt 构建器 - 构建发送给 LLM 的完整 Prompt（编译期模板见 prompt_template.h）
 class PromptBuilder {
 public:
-    // 构建系统 Prompt（包含长期记忆）
+    // 构建系统 Prompt（包含全部长期记忆）
     static std::string BuildSystemPrompt(const CompressedMemory& memory);
 
-    // 构建完整请求（系统 Prompt + 对话历史 + 当前输入）
+    // 固定前缀（人设 + 互动指南），进程内只渲染一次，字节始终不变
+    static const std::string& StablePrefix();
+
+    // 渲染会话级记忆（画像 + 上次对话，会话内不变）到 out 末尾
+    static void RenderSessionMemory(const CompressedMemory& memory, std::string& out);
+
+    // 渲染本轮检索到的相关记忆到 out 末尾（无命中时不写入）
+    static void RenderRelevantMemory(const std::vector<MemoryHit>& relevant,
+                                     std::string& out);
+
+    // 构建完整请求，按变化频率排序以命中服务端前缀缓存：
+    // 固定前缀 → 会话记忆 → 较早轮次摘要 → 最近对话 → 本轮相关记忆 → 当前输入
+    // 总长度不超过 budget，取舍由 ContextPacker 按优先级决定
     static std::vector<Message> BuildRequest(
         const CompressedMemory& memory,
+        const std::vector<MemoryHit>& relevant,
         const std::vector<Message>& history,
-        const std::string& user_input
+        const std::string& user_input,
+        const ContextBudget& budget = ContextBudget(),
+        PackReport* report = nullptr
     );
 
     // 构建记忆压缩 Prompt
@@ -28,13 +45,6 @@ public:
 
     // 构建基础人设
     static std::string BuildBasePersona();
-
-private:
-    // 格式化记忆为可读文本
-    static std::string FormatMemory(const CompressedMemory& memory);
-
-    // 格式化对话历史为可读文本
-    static std::string FormatHistory(const std::vector<Message>& messages);
 };
 
 } // namespace EvoSpark
@@ -0,0 +1,121 @@
+#include "opus_codec.h"
+#include "esp_log.h"
+
+namespace EvoSpark {
+
+static const char* TAG = "OpusCodec";
+
+// ==================== 编码 ====================
+
+OpusVoiceEncoder::~OpusVoiceEncoder() {
+    if (encoder_) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+bool OpusVoiceEncoder::Init(int sample_rate, int frame_duration_ms, uint32_t bitrate) {
+    if (encoder_) {
+        opus_encoder_destroy(encoder_);
+        encoder_ = nullptr;
+    }
+
+    int error = OPUS_OK;
+    encoder_ = opus_encoder_create(sample_rate, 1, OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !encoder_) {
+        ESP_LOGE(TAG, "Failed to create encoder: %s", opus_strerror(error));
+        encoder_ = nullptr;
+        return false;
+    }
+
+    opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(3));
+    frame_samples_ = static_cast<size_t>(sample_rate / 1000 * frame_duration_ms);
+    bitrate_ = 0;
+    SetBitrate(bitrate);
+    return true;
+}
+
+void OpusVoiceEncoder::SetBitrate(uint32_t bitrate) {
+    if (!encoder_ || bitrate == bitrate_) {
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+    if (bitrate_ != 0) {
+        ESP_LOGI(TAG, "Bitrate %u -> %u bps", static_cast<unsigned>(bitrate_), static_cast<unsigned>(bitrate));
+    }
+    bitrate_ = bitrate;
+}
+
+bool OpusVoiceEncoder::Encode(const int16_t* pcm, std::vector<uint8_t>& out) {
+    if (!encoder_) {
+        return false;
+    }
+    out.resize(MAX_PACKET_BYTES);
+    int bytes = opus_encode(encoder_, pcm, static_cast<int>(frame_samples_),
+                            out.data(), static_cast<opus_int32>(out.size()));
+    if (bytes < 0) {
+        ESP_LOGW(TAG, "Encode failed: %s", opus_strerror(bytes));
+        out.clear();
+        return false;
+    }
+    out.resize(static_cast<size_t>(bytes));
+    return true;
+}
+
+void OpusVoiceEncoder::Reset() {
+    if (encoder_) {
+        opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+    }
+}
+
+// ==================== 解码 ====================
+
+OpusVoiceDecoder::~OpusVoiceDecoder() {
+    if (decoder_) {
+        opus_decoder_destroy(decoder_);
+    }
+}
+
+bool OpusVoiceDecoder::Init(int sample_rate) {
+    if (decoder_ && sample_rate == sample_rate_) {
+        return true;
+    }
+    if (decoder_) {
+        opus_decoder_destroy(decoder_);
+        decoder_ = nullptr;
+    }
+
+    int error = OPUS_OK;
+    decoder_ = opus_decoder_create(sample_rate, 1, &error);
+    if (error != OPUS_OK || !decoder_) {
+        ESP_LOGE(TAG, "Failed to create decoder: %s", opus_strerror(error));
+        decoder_ = nullptr;
+        return false;
+    }
+    sample_rate_ = sample_rate;
+    return true;
+}
+
+bool OpusVoiceDecoder::Decode(const uint8_t* packet, size_t length, std::vector<int16_t>& out) {
+    if (!decoder_) {
+        return false;
+    }
+    out.resize(static_cast<size_t>(sample_rate_ / 1000 * 120));
+    int samples = opus_decode(decoder_, packet, static_cast<opus_int32>(length),
+                              out.data(), static_cast<int>(out.size()), 0);
+    if (samples < 0) {
+        ESP_LOGW(TAG, "Decode failed: %s", opus_strerror(samples));
+        out.clear();
+        return false;
+    }
+    out.resize(static_cast<size_t>(samples));
+    return true;
+}
+
+void OpusVoiceDecoder::Reset() {
+    if (decoder_) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
+
+} // namespace EvoSpark
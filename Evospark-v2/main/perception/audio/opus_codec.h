@@ -0,0 +1,76 @@
+#ifndef OPUS_CODEC_H
+#define OPUS_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "opus.h"
+
+namespace EvoSpark {
+
+// Opus 编码器（单声道语音）
+//
+// 每次编码一帧（frame_duration_ms 的 PCM），输出一个 Opus 包。用语音
+// 模式、低复杂度（S3 上 60 ms 一帧约 8 ms 编码时间），码率可随链路调整。
+// libopus 的编码栈开销较大，调用任务的栈至少 ENCODER_STACK_BYTES
+class OpusVoiceEncoder {
+public:
+    OpusVoiceEncoder() = default;
+    ~OpusVoiceEncoder();
+
+    OpusVoiceEncoder(const OpusVoiceEncoder&) = delete;
+    OpusVoiceEncoder& operator=(const OpusVoiceEncoder&) = delete;
+
+    bool Init(int sample_rate, int frame_duration_ms, uint32_t bitrate);
+
+    // 码率变化时才调用 ctl
+    void SetBitrate(uint32_t bitrate);
+    uint32_t GetBitrate() const { return bitrate_; }
+
+    // 每帧采样数
+    size_t FrameSamples() const { return frame_samples_; }
+
+    // 编码一帧（pcm 必须正好 FrameSamples 个采样），结果写入 out
+    bool Encode(const int16_t* pcm, std::vector<uint8_t>& out);
+
+    // 两段话之间清掉预测状态
+    void Reset();
+
+    static constexpr size_t MAX_PACKET_BYTES = 1276;     // 单帧 Opus 包上限
+    static constexpr size_t ENCODER_STACK_BYTES = 20 * 1024;
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    size_t frame_samples_ = 0;
+    uint32_t bitrate_ = 0;
+};
+
+// Opus 解码器（单声道）
+//
+// 解码器按输出采样率创建：服务端用 16k / 24k 编码都能直接解到扬声器的
+// 采样率，不需要另外重采样
+class OpusVoiceDecoder {
+public:
+    OpusVoiceDecoder() = default;
+    ~OpusVoiceDecoder();
+
+    OpusVoiceDecoder(const OpusVoiceDecoder&) = delete;
+    OpusVoiceDecoder& operator=(const OpusVoiceDecoder&) = delete;
+
+    bool Init(int sample_rate);
+
+    // 解码一个包，PCM 写入 out（覆盖）；最长 120 ms
+    bool Decode(const uint8_t* packet, size_t length, std::vector<int16_t>& out);
+
+    void Reset();
+
+    static constexpr size_t DECODER_STACK_BYTES = 8 * 1024;
+
+private:
+    OpusDecoder* decoder_ = nullptr;
+    int sample_rate_ = 0;
+};
+
+} // namespace EvoSpark
+
+#endif // OPUS_CODEC_H
@@ -80,6 +80,53 @@ void Speaker::Stop() {
     ESP_LOGI(TAG, "Playback stopped");
 }
 
+bool Speaker::StartStream() {
+    if (is_playing_) {
+        Stop();
+    }
+    if (is_streaming_) {
+        return true;
+    }
+    if (!i2s_.StartPlayback()) {
+        ESP_LOGE(TAG, "Failed to start I2S playback");
+        return false;
+    }
+    is_streaming_ = true;
+    return true;
+}
+
+bool Speaker::WriteStream(const int16_t* samples, size_t count) {
+    if (!is_streaming_ || count == 0) {
+        return false;
+    }
+
+    stream_buffer_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        stream_buffer_[i] = static_cast<int16_t>(samples[i] * volume_ / 100);
+    }
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(stream_buffer_.data());
+    size_t len = count * sizeof(int16_t);
+    size_t offset = 0;
+    while (is_streaming_ && offset < len) {
+        size_t written = i2s_.Write(data + offset, len - offset, 200);
+        if (written == 0) {
+            ESP_LOGW(TAG, "Failed to write audio data");
+            return false;
+        }
+        offset += written;
+    }
+    return offset == len;
+}
+
+void Speaker::EndStream() {
+    if (!is_streaming_) {
+        return;
+    }
+    is_streaming_ = false;
+    i2s_.StopPlayback();
+}
+
 void Speaker::SetVolume(int volume) {
     volume_ = std::max(0, std::min(100, volume));
     ESP_LOGI(TAG, "Volume set to %d", volume_);
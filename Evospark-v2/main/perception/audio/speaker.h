@@ -30,6 +30,13 @@ public:
     // 停止播放
     void Stop();
 
+    // 流式播放：边收边放（实时语音的下行），WriteStream 写满 I2S DMA 缓冲区时阻塞，
+    // 调用方按解码速度写入即可。与 Play 互斥
+    bool StartStream();
+    bool WriteStream(const int16_t* samples, size_t count);
+    void EndStream();
+    bool IsStreaming() const { return is_streaming_; }
+
     // 设置音量 (0-100)
     void SetVolume(int volume);
 
@@ -53,12 +60,16 @@ private:
 
     TaskHandle_t playback_task_ = nullptr;
     bool is_playing_ = false;
+    bool is_streaming_ = false;
     int volume_ = 80;
     PlaybackCallback playback_callback_;
 
     // 播放缓冲区
     std::vector<uint8_t> audio_buffer_;
     size_t playback_position_ = 0;
+
+    // 流式播放的音量缩放缓冲
+    std::vector<int16_t> stream_buffer_;
 };
 
 } // namespace EvoSpark
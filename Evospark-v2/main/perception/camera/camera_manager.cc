@@ -1,4 +1,5 @@
 #include "camera_manager.h"
+#include "link_quality.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 
@@ -44,7 +45,7 @@ bool CameraManager::Init() {
 
         .pixel_format = PIXFORMAT_JPEG,
         .frame_size = FRAMESIZE_QVGA,  // 320x240
-        .jpeg_quality = 12,
+        .jpeg_quality = DEFAULT_JPEG_QUALITY,
         .fb_count = 2,
         .fb_location = CAMERA_FB_IN_PSRAM,
         .grab_mode = CAMERA_GRAB_LATEST
@@ -88,6 +89,40 @@ ImageFrame CameraManager::Capture() {
     return frame;
 }
 
+CameraFrame CameraManager::Grab() {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) {
+        ESP_LOGE(TAG, "Failed to capture frame");
+    }
+    return CameraFrame(fb);
+}
+
+CameraFrame CameraManager::Acquire() {
+    if (!initialized_) {
+        ESP_LOGE(TAG, "Camera not initialized");
+        return CameraFrame();
+    }
+
+    SetJpegQuality(LinkQuality::GetInstance().GetProfile().jpeg_quality);
+    return Grab();
+}
+
+void CameraManager::SetJpegQuality(int quality) {
+    if (!initialized_ || quality == jpeg_quality_) {
+        return;
+    }
+
+    sensor_t* s = esp_camera_sensor_get();
+    if (!s || s->set_quality(s, quality) != 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "JPEG quality %d -> %d", jpeg_quality_, quality);
+    jpeg_quality_ = quality;
+
+    // CAMERA_GRAB_LATEST 下缓冲里的帧是按旧质量编码的，丢掉一帧
+    CameraFrame stale = Grab();
+}
+
 std::vector<uint8_t> CameraManager::CaptureJPEG(int quality) {
     std::vector<uint8_t> jpeg;
 
@@ -95,18 +130,12 @@ std::vector<uint8_t> CameraManager::CaptureJPEG(int quality) {
         return jpeg;
     }
 
-    // 如果需要调整质量
-    if (quality != 12) {
-        sensor_t* s = esp_camera_sensor_get();
-        if (s) {
-            s->set_quality(s, quality);
-        }
-    }
+    SetJpegQuality(quality > 0 ? quality : LinkQuality::GetInstance().GetProfile().jpeg_quality);
 
-    ImageFrame frame = Capture();
+    // 直接从帧缓冲复制到 vector，不经 Capture 的中间拷贝
+    CameraFrame frame = Grab();
     if (frame.IsValid()) {
-        jpeg.assign(frame.data, frame.data + frame.size);
-        frame.Free();
+        jpeg.assign(frame.Data(), frame.Data() + frame.Size());
     }
 
     return jpeg;
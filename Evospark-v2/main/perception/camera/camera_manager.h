@@ -27,6 +27,46 @@ struct ImageFrame {
     }
 };
 
+// 驱动帧缓冲的借用：直接指向 esp_camera 的帧缓冲（PSRAM），不复制，
+// 析构时归还驱动。驱动只有 fb_count 块缓冲，借用期间采集少一块，用完尽快释放
+class CameraFrame {
+public:
+    CameraFrame() = default;
+    explicit CameraFrame(camera_fb_t* fb) : fb_(fb) {}
+    ~CameraFrame() { Release(); }
+
+    CameraFrame(CameraFrame&& other) noexcept : fb_(other.fb_) { other.fb_ = nullptr; }
+    CameraFrame& operator=(CameraFrame&& other) noexcept {
+        if (this != &other) {
+            Release();
+            fb_ = other.fb_;
+            other.fb_ = nullptr;
+        }
+        return *this;
+    }
+
+    CameraFrame(const CameraFrame&) = delete;
+    CameraFrame& operator=(const CameraFrame&) = delete;
+
+    bool IsValid() const { return fb_ != nullptr && fb_->len > 0; }
+    const uint8_t* Data() const { return fb_ ? fb_->buf : nullptr; }
+    size_t Size() const { return fb_ ? fb_->len : 0; }
+    int Width() const { return fb_ ? static_cast<int>(fb_->width) : 0; }
+    int Height() const { return fb_ ? static_cast<int>(fb_->height) : 0; }
+    pixformat_t Format() const { return fb_ ? fb_->format : PIXFORMAT_JPEG; }
+
+    // 提前归还驱动
+    void Release() {
+        if (fb_) {
+            esp_camera_fb_return(fb_);
+            fb_ = nullptr;
+        }
+    }
+
+private:
+    camera_fb_t* fb_ = nullptr;
+};
+
 // 摄像头管理器
 class CameraManager {
 public:
@@ -41,8 +81,15 @@ public:
     // 捕获一帧图像
     ImageFrame Capture();
 
-    // 捕获 JPEG 图像
-    std::vector<uint8_t> CaptureJPEG(int quality = 12);
+    // 捕获 JPEG 图像；quality 为 0 时按链路选择质量
+    std::vector<uint8_t> CaptureJPEG(int quality = 0);
+
+    // 借用一帧（不复制）：上传图像时直接从帧缓冲读取，省去一次整帧的拷贝。
+    // JPEG 质量按 LinkQuality 的建议：弱信号下帧更小，上传更快
+    CameraFrame Acquire();
+
+    // 设置 JPEG 质量（10-63，越大越小）
+    void SetJpegQuality(int quality);
 
     // 开始连续捕获
     bool StartStreaming();
@@ -62,8 +109,14 @@ private:
     CameraManager() = default;
     ~CameraManager();
 
+    // 从帧缓冲取一帧
+    CameraFrame Grab();
+
+    static constexpr int DEFAULT_JPEG_QUALITY = 12;
+
     bool initialized_ = false;
     bool streaming_ = false;
+    int jpeg_quality_ = DEFAULT_JPEG_QUALITY;
 };
 
 } // namespace EvoSpark
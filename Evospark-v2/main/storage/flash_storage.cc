@@ -1,6 +1,7 @@
 #include "flash_storage.h"
 #include "esp_log.h"
 #include "esp_spiffs.h"
+#include "esp_vfs_fat.h"
 #include <sys/stat.h>
 #include <fstream>
 #include <sstream>
@@ -47,6 +48,37 @@ bool FlashStorage::Init() {
     return true;
 }
 
+bool FlashStorage::MountFat(const char* partition_label, const char* base_path) {
+    if (!fat_base_path_.empty()) {
+        return fat_base_path_ == base_path;
+    }
+
+    ESP_LOGI(TAG, "Mounting FAT partition '%s' at %s...", partition_label, base_path);
+
+    esp_vfs_fat_mount_config_t conf = {};
+    conf.format_if_mount_failed = true;
+    conf.max_files = 4;
+    conf.allocation_unit_size = 4096;
+
+    wl_handle_t handle = WL_INVALID_HANDLE;
+    esp_err_t ret = esp_vfs_fat_spiflash_mount_rw_wl(base_path, partition_label, &conf, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount FAT partition '%s' (%s)",
+                 partition_label, esp_err_to_name(ret));
+        return false;
+    }
+
+    uint64_t total = 0, free_bytes = 0;
+    if (esp_vfs_fat_info(base_path, &total, &free_bytes) == ESP_OK) {
+        ESP_LOGI(TAG, "FAT: total=%d KB, free=%d KB",
+                 static_cast<int>(total / 1024), static_cast<int>(free_bytes / 1024));
+    }
+
+    fat_base_path_ = base_path;
+    fat_wl_handle_ = handle;
+    return true;
+}
+
 bool FlashStorage::ReadFile(const std::string& path, std::string& content) {
     std::ifstream file(path, std::ios::binary);
     if (!file.is_open()) {
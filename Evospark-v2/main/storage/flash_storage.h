@@ -17,6 +17,9 @@ public:
     // 初始化 SPIFFS
     bool Init();
 
+    // 挂载 FAT 数据分区（带磨损均衡），例如 ("model", "/model")
+    bool MountFat(const char* partition_label, const char* base_path);
+
     // 读取文件
     bool ReadFile(const std::string& path, std::string& content);
 
@@ -43,6 +46,8 @@ private:
     ~FlashStorage() = default;
 
     bool initialized_ = false;
+    std::string fat_base_path_;
+    int fat_wl_handle_ = -1;
 };
 
 } // namespace EvoSpark
@@ -0,0 +1,65 @@
+#include "base64.h"
+#include <cstring>
+
+namespace EvoSpark {
+
+namespace {
+
+const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+inline uint32_t LoadBigEndian32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// 一组 24 位 → 4 个字符，拼成一个整字写出（ESP32-S3 与主机都是小端）
+inline void StoreQuad(char* out, uint32_t group) {
+    uint32_t word = static_cast<uint32_t>(static_cast<uint8_t>(ALPHABET[(group >> 18) & 63])) |
+                    static_cast<uint32_t>(static_cast<uint8_t>(ALPHABET[(group >> 12) & 63])) << 8 |
+                    static_cast<uint32_t>(static_cast<uint8_t>(ALPHABET[(group >> 6) & 63])) << 16 |
+                    static_cast<uint32_t>(static_cast<uint8_t>(ALPHABET[group & 63])) << 24;
+    memcpy(out, &word, 4);
+}
+
+} // namespace
+
+size_t Base64Encode(const uint8_t* data, size_t length, char* out) {
+    char* start = out;
+
+    // 主循环：12 字节 → 16 字符。读取经 LoadBigEndian32 按字节拼接，
+    // 帧缓冲和调用方数据不要求对齐
+    while (length >= 12) {
+        uint32_t a = LoadBigEndian32(data);
+        uint32_t b = LoadBigEndian32(data + 4);
+        uint32_t c = LoadBigEndian32(data + 8);
+        StoreQuad(out, a >> 8);
+        StoreQuad(out + 4, (a << 16 | b >> 16) & 0xFFFFFF);
+        StoreQuad(out + 8, (b << 8 | c >> 24) & 0xFFFFFF);
+        StoreQuad(out + 12, c & 0xFFFFFF);
+        data += 12;
+        out += 16;
+        length -= 12;
+    }
+
+    while (length >= 3) {
+        StoreQuad(out, static_cast<uint32_t>(data[0]) << 16 | data[1] << 8 | data[2]);
+        data += 3;
+        out += 4;
+        length -= 3;
+    }
+
+    if (length > 0) {
+        uint32_t group = static_cast<uint32_t>(data[0]) << 16;
+        if (length == 2) {
+            group |= data[1] << 8;
+        }
+        out[0] = ALPHABET[(group >> 18) & 63];
+        out[1] = ALPHABET[(group >> 12) & 63];
+        out[2] = length == 2 ? ALPHABET[(group >> 6) & 63] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return static_cast<size_t>(out - start);
+}
+
+} // namespace EvoSpark
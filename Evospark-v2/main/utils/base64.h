@@ -0,0 +1,38 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace EvoSpark {
+
+// base64 编码后的长度（带 '=' 补齐）
+constexpr size_t Base64EncodedLength(size_t length) {
+    return (length + 2) / 3 * 4;
+}
+
+// 编码到 out（至少 Base64EncodedLength(length) 字节，不写结尾 '\0'），返回写入长度。
+// 每轮读 12 字节、写 16 字节：三次 32 位读取拼出四组 24 位，查表后按 32 位整字写出，
+// 没有逐字节的移位和分支，只有尾部不足 12 字节时逐组处理
+size_t Base64Encode(const uint8_t* data, size_t length, char* out);
+
+// 分段编码后交给 sink（JsonWriter 的 sink 接口：Append(const char*, size_t)），
+// 只占一块 BASE64_CHUNK_BYTES 的栈上缓冲区，不论输入多大。
+// 每段输入都是 3 的倍数，中间不会出现补齐
+constexpr size_t BASE64_CHUNK_BYTES = 512;
+
+template <typename Sink>
+void Base64EncodeTo(Sink& sink, const uint8_t* data, size_t length) {
+    constexpr size_t STEP = BASE64_CHUNK_BYTES / 4 * 3;
+    char chunk[BASE64_CHUNK_BYTES];
+    while (length > 0) {
+        size_t n = length < STEP ? length : STEP;
+        sink.Append(chunk, Base64Encode(data, n, chunk));
+        data += n;
+        length -= n;
+    }
+}
+
+} // namespace EvoSpark
+
+#endif // BASE64_H
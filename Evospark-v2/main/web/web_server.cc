@@ -1,14 +1,47 @@
 #include "web_server.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "core/session_manager.h"
 #include "memory/memory_manager.h"
 #include "config/config_manager.h"
-#include <sstream>
+#include "ai/llm_client.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "dns_cache.h"
+#include "link_quality.h"
+#include "ai/voice_channel.h"
+#include "json_codec.h"
+#include <cstring>
+#include <cstdlib>
 
 namespace EvoSpark {
 
 static const char* TAG = "WebServer";
 
+namespace {
+
+constexpr size_t JSON_CHUNK_SIZE = 1024;
+
+// 分块发送 JSON：边写边发，任意大小的响应只占一块栈上缓冲区
+template <typename WriteFn>
+esp_err_t SendJsonChunked(httpd_req_t* req, WriteFn&& write) {
+    char buffer[JSON_CHUNK_SIZE];
+    JsonChunkSink sink(buffer, sizeof(buffer), [req](const char* data, size_t length) {
+        return httpd_resp_send_chunk(req, data, length) == ESP_OK;
+    });
+
+    httpd_resp_set_type(req, "application/json");
+    JsonWriter<JsonChunkSink> json(sink);
+    write(json);
+    if (!sink.Finish()) {
+        ESP_LOGW(TAG, "Client went away after %zu bytes", sink.Total());
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+} // namespace
+
 WebServer::~WebServer() {
     Stop();
 }
@@ -21,7 +54,7 @@ bool WebServer::Start() {
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
-    config.max_uri_handlers = 10;
+    config.max_uri_handlers = 12;
     config.stack_size = 8192;
 
     esp_err_t ret = httpd_start(&server_, &config);
@@ -71,6 +104,54 @@ bool WebServer::Start() {
     };
     httpd_register_uri_handler(server_, &api_memory_uri);
 
+    httpd_uri_t api_history_uri = {
+        .uri = "/api/memory/history",
+        .method = HTTP_GET,
+        .handler = HandleApiMemoryHistory,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_history_uri);
+
+    httpd_uri_t api_rollback_uri = {
+        .uri = "/api/memory/rollback",
+        .method = HTTP_POST,
+        .handler = HandleApiMemoryRollback,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_rollback_uri);
+
+    httpd_uri_t api_sessions_uri = {
+        .uri = "/api/sessions",
+        .method = HTTP_GET,
+        .handler = HandleApiSessions,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_sessions_uri);
+
+    httpd_uri_t api_usage_uri = {
+        .uri = "/api/usage",
+        .method = HTTP_GET,
+        .handler = HandleApiUsage,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_usage_uri);
+
+    httpd_uri_t api_budget_uri = {
+        .uri = "/api/usage/budget",
+        .method = HTTP_POST,
+        .handler = HandleApiBudget,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_budget_uri);
+
+    httpd_uri_t api_voice_uri = {
+        .uri = "/api/voice",
+        .method = HTTP_POST,
+        .handler = HandleApiVoice,
+        .user_ctx = nullptr
+    };
+    httpd_register_uri_handler(server_, &api_voice_uri);
+
     ESP_LOGI(TAG, "Web server started on port %d", config.server_port);
     return true;
 }
@@ -84,7 +165,7 @@ void WebServer::Stop() {
 }
 
 esp_err_t WebServer::HandleRoot(httpd_req_t *req) {
-    const char* html = R"(
+    const char* html = R"html(
 <!DOCTYPE html>
 <html>
 <head>
@@ -97,6 +178,21 @@ esp_err_t WebServer::HandleRoot(httpd_req_t *req) {
         .status { padding: 10px; margin: 10px 0; background: #e8f5e9; border-radius: 4px; }
         .config-link { margin: 20px 0; }
         a { color: #2196F3; }
+        .versions { list-style: none; padding: 0; }
+        .versions li { display: flex; justify-content: space-between; padding: 6px 0; border-bottom: 1px solid #eee; font-size: 14px; }
+        .versions code { color: #666; }
+        .versions button { background: #2196F3; color: white; border: none; border-radius: 4px; padding: 4px 10px; cursor: pointer; }
+        .sessions { list-style: none; padding: 0; }
+        .sessions li { padding: 6px 0; border-bottom: 1px solid #eee; font-size: 14px; cursor: pointer; }
+        .sessions .msgs { display: none; margin: 6px 0 0 12px; color: #555; white-space: pre-wrap; }
+        .sessions li.open .msgs { display: block; }
+        .pager button { background: #2196F3; color: white; border: none; border-radius: 4px; padding: 4px 10px; cursor: pointer; }
+        .usage { width: 100%; border-collapse: collapse; font-size: 14px; }
+        .usage td, .usage th { padding: 4px 6px; border-bottom: 1px solid #eee; text-align: right; }
+        .usage td:first-child, .usage th:first-child { text-align: left; }
+        .budget input { width: 90px; }
+        .level-economy { color: #f57c00; }
+        .level-exhausted { color: #d32f2f; }
     </style>
 </head>
 <body>
@@ -114,8 +210,145 @@ esp_err_t WebServer::HandleRoot(httpd_req_t *req) {
             <p>2. 开始对话</p>
             <p>3. 再次按键或等待超时结束会话</p>
         </div>
+        <div>
+            <h3>Token 用量 <small id="usageLevel"></small></h3>
+            <table class="usage">
+                <tr><th></th><th>对话</th><th>压缩</th><th>图像</th><th>合计</th></tr>
+                <tr><td>本次会话</td><td id="sessionChat"></td><td id="sessionCompression"></td><td id="sessionVision"></td><td id="sessionTotal"></td></tr>
+                <tr><td>今天</td><td id="todayChat"></td><td id="todayCompression"></td><td id="todayVision"></td><td id="todayTotal"></td></tr>
+            </table>
+            <p><small id="usageHistory"></small></p>
+            <div class="budget">
+                会话预算 <input type="number" id="sessionBudget" min="0">
+                每日预算 <input type="number" id="dailyBudget" min="0">
+                <button onclick="saveBudget()">保存</button> <small>（0 表示不限）</small>
+            </div>
+        </div>
+        <div>
+            <h3>记忆版本 <small id="historySummary"></small></h3>
+            <ul class="versions" id="versions"></ul>
+        </div>
+        <div>
+            <h3>会话历史 <small id="sessionSummary"></small></h3>
+            <ul class="sessions" id="sessions"></ul>
+            <div class="pager">
+                <button onclick="loadSessions(sessionPage - 1)">上一页</button>
+                <span id="sessionPage"></span>
+                <button onclick="loadSessions(sessionPage + 1)">下一页</button>
+            </div>
+        </div>
     </div>
     <script>
+        function loadHistory() {
+            fetch('/api/memory/history')
+                .then(r => r.json())
+                .then(data => {
+                    document.getElementById('historySummary').textContent =
+                        data.count + ' 个版本，占用 ' + (data.stored_bytes / 1024).toFixed(1) + ' KB';
+                    const list = document.getElementById('versions');
+                    list.innerHTML = '';
+                    data.versions.forEach((v, i) => {
+                        const li = document.createElement('li');
+                        const time = new Date(v.timestamp * 1000).toLocaleString();
+                        li.innerHTML = '<span>v' + v.seq + ' <code>' + v.hash + '</code> ' + time +
+                            ' (' + v.size + ' B' + (v.base ? '' : ', 增量 ' + v.stored + ' B') + ')</span>';
+                        if (i > 0) {
+                            const btn = document.createElement('button');
+                            btn.textContent = '回滚';
+                            btn.onclick = () => rollback(v.hash);
+                            li.appendChild(btn);
+                        } else {
+                            li.appendChild(document.createTextNode('当前'));
+                        }
+                        list.appendChild(li);
+                    });
+                });
+        }
+        function rollback(hash) {
+            if (!confirm('回滚到版本 ' + hash + '？')) return;
+            fetch('/api/memory/rollback', {
+                method: 'POST',
+                headers: {'Content-Type': 'application/json'},
+                body: JSON.stringify({hash: hash})
+            }).then(r => r.json()).then(data => {
+                alert(data.success ? '已回滚' : '回滚失败');
+                loadHistory();
+            });
+        }
+        const PAGE_SIZE = 10;
+        let sessionPage = 0;
+        function loadSessions(page) {
+            if (page < 0) return;
+            fetch('/api/sessions?page=' + page + '&size=' + PAGE_SIZE)
+                .then(r => r.json())
+                .then(data => {
+                    const pages = Math.max(1, Math.ceil(data.total / PAGE_SIZE));
+                    if (page >= pages) return;
+                    sessionPage = page;
+                    document.getElementById('sessionSummary').textContent =
+                        data.total + ' 次会话，占用 ' + (data.stored_bytes / 1024).toFixed(1) + ' KB';
+                    document.getElementById('sessionPage').textContent = (page + 1) + ' / ' + pages;
+                    const list = document.getElementById('sessions');
+                    list.innerHTML = '';
+                    data.sessions.forEach(s => {
+                        const li = document.createElement('li');
+                        const title = document.createElement('div');
+                        title.textContent = '#' + s.id + ' ' + new Date(s.end * 1000).toLocaleString() +
+                            ' (' + s.session.messages.length + ' 条) ' + (s.session.summary || '');
+                        const msgs = document.createElement('div');
+                        msgs.className = 'msgs';
+                        msgs.textContent = s.session.messages.map(m =>
+                            (m.role === 'user' ? '用户' : 'EvoSpark') + ': ' + m.content).join('\n');
+                        li.appendChild(title);
+                        li.appendChild(msgs);
+                        li.onclick = () => li.classList.toggle('open');
+                        list.appendChild(li);
+                    });
+                });
+        }
+        const LEVEL_NAMES = {normal: '正常', economy: '节省模式', exhausted: '已超预算'};
+        function cell(id, u) {
+            document.getElementById(id).textContent = u.total_tokens +
+                (u.cached_tokens ? '（缓存 ' + u.cached_tokens + '）' : '');
+        }
+        function loadUsage(fillBudget) {
+            fetch('/api/usage')
+                .then(r => r.json())
+                .then(data => {
+                    const level = document.getElementById('usageLevel');
+                    level.textContent = LEVEL_NAMES[data.level] || data.level;
+                    level.className = 'level-' + data.level;
+                    ['session', 'today'].forEach(p => {
+                        cell(p + 'Chat', data[p].chat);
+                        cell(p + 'Compression', data[p].compression);
+                        cell(p + 'Vision', data[p].vision);
+                        document.getElementById(p + 'Total').textContent = data[p].total_tokens;
+                    });
+                    document.getElementById('usageHistory').textContent =
+                        '之前 7 天: ' + data.history.join(' / ');
+                    if (fillBudget) {
+                        document.getElementById('sessionBudget').value = data.budget.session_tokens;
+                        document.getElementById('dailyBudget').value = data.budget.daily_tokens;
+                    }
+                });
+        }
+        function saveBudget() {
+            fetch('/api/usage/budget', {
+                method: 'POST',
+                headers: {'Content-Type': 'application/json'},
+                body: JSON.stringify({
+                    session_tokens: Number(document.getElementById('sessionBudget').value),
+                    daily_tokens: Number(document.getElementById('dailyBudget').value)
+                })
+            }).then(r => r.json()).then(data => {
+                alert(data.success ? '已保存' : '保存失败');
+                loadUsage(true);
+            });
+        }
+        loadHistory();
+        loadSessions(0);
+        loadUsage(true);
+        setInterval(() => loadUsage(false), 5000);
         setInterval(() => {
             fetch('/api/status')
                 .then(r => r.json())
@@ -126,7 +359,7 @@ esp_err_t WebServer::HandleRoot(httpd_req_t *req) {
     </script>
 </body>
 </html>
-)";
+)html";
 
     httpd_resp_set_type(req, "text/html");
     httpd_resp_send(req, html, strlen(html));
@@ -203,17 +436,284 @@ esp_err_t WebServer::HandleConfig(httpd_req_t *req) {
 esp_err_t WebServer::HandleApiStatus(httpd_req_t *req) {
     SessionManager& session = SessionManager::GetInstance();
 
-    std::ostringstream json;
-    json << "{";
-    json << "\"state\":\"" << StateToString(session.GetState()) << "\",";
-    json << "\"in_session\":" << (session.InSession() ? "true" : "false") << ",";
-    json << "\"message_count\":" << session.GetStats().message_count;
-    json << "}";
-
-    std::string response = json.str();
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response.c_str(), response.length());
-    return ESP_OK;
+    // 统计快照先取好，发送期间不持有任何锁
+    RetrievalStats retrieval = MemoryManager::GetInstance().GetRetrievalStats();
+    PromptCacheStats cache = LLMClient::GetInstance().GetCacheStats();
+    HttpPoolStats pool = HttpConnectionPool::GetInstance().GetStats();
+    DnsCacheStats dns = DnsCache::GetInstance().GetStats();
+    LinkStats link = LinkQuality::GetInstance().GetStats();
+    LinkProfile profile = LinkQuality::GetInstance().GetProfile();
+    VoiceStats voice = VoiceChannel::GetInstance().GetStats();
+    std::vector<HttpEndpointStats> endpoints = HttpConnectionPool::GetInstance().GetEndpointStats();
+    StreamStats stream = LLMClient::GetInstance().GetStreamStats();
+    TransportStats transport = LLMClient::GetInstance().GetTransportStats();
+    StructuredOutputStats structured = LLMClient::GetInstance().GetStructuredOutputStats();
+    VisionStats vision = LLMClient::GetInstance().GetVisionStats();
+    std::vector<EndpointHealth> health = LLMClient::GetInstance().GetEndpointHealth();
+    RequestQueueStats queue = RequestQueue::GetInstance().GetStats();
+    ResponseCacheStats responses = ResponseCache::GetInstance().GetStats();
+    TokenLedgerSnapshot usage = TokenLedger::GetInstance().GetSnapshot();
+    const PackReport& pack = session.GetLastPackReport();
+
+    return SendJsonChunked(req, [&](auto& json) {
+        json.BeginObject();
+        json.Field("state", StateToString(session.GetState()));
+        json.Field("in_session", session.InSession());
+        json.Field("message_count", session.GetStats().message_count);
+        json.Field("memory_generation", MemoryManager::GetInstance().GetSnapshot()->generation);
+
+        // 记忆检索：注入 token 与全量注入 token 的对比
+        json.Key("retrieval");
+        json.BeginObject();
+        json.Field("queries", retrieval.queries);
+        json.Field("empty_queries", retrieval.empty_queries);
+        json.Field("injected_tokens", retrieval.injected_tokens);
+        json.Field("full_tokens", retrieval.full_tokens);
+        json.EndObject();
+
+        // 服务端前缀缓存：命中率与命中 / 未命中的平均耗时
+        uint32_t misses = cache.requests - cache.cache_hits;
+        json.Key("prompt_cache");
+        json.BeginObject();
+        json.Field("requests", cache.requests);
+        json.Field("hits", cache.cache_hits);
+        json.Field("prompt_tokens", cache.prompt_tokens);
+        json.Field("cached_tokens", cache.cached_tokens);
+        json.Field("avg_hit_ms", cache.cache_hits ? cache.hit_latency_ms / cache.cache_hits : 0);
+        json.Field("avg_miss_ms", misses ? cache.miss_latency_ms / misses : 0);
+        json.EndObject();
+
+        // 回复缓存：重复输入直接应答，省下的 token 和请求耗时
+        json.Key("response_cache");
+        json.BeginObject();
+        json.Field("lookups", responses.lookups);
+        json.Field("hits", responses.hits);
+        json.Field("misses", responses.misses);
+        json.Field("excluded", responses.excluded);
+        json.Field("hit_rate", responses.lookups
+            ? static_cast<double>(responses.hits) / responses.lookups : 0.0);
+        json.Field("tokens_saved", responses.tokens_saved);
+        json.Field("latency_saved_ms", responses.latency_saved_ms);
+        json.Field("entries", responses.entries);
+        json.Field("bytes", responses.bytes);
+        json.Field("evictions", responses.evictions);
+        json.Field("expired", responses.expired);
+        json.Field("flash_loaded", responses.flash_loaded);
+        json.EndObject();
+
+        // token 用量与预算状态（明细见 /api/usage）
+        json.Key("tokens");
+        json.BeginObject();
+        json.Field("level", BudgetLevelToString(usage.level));
+        json.Field("session", usage.SessionTotal());
+        json.Field("today", usage.TodayTotal());
+        json.Field("economy_requests", usage.economy_requests);
+        json.EndObject();
+
+        // 长连接池：握手次数与复用省下的时间
+        json.Key("http_pool");
+        json.BeginObject();
+        json.Field("requests", pool.requests);
+        json.Field("handshakes", pool.handshakes);
+        json.Field("reused", pool.reused);
+        json.Field("recycled", pool.recycled);
+        json.Field("errors", pool.errors);
+        json.Field("cancelled", pool.cancelled);
+        json.Field("open", pool.open_connections);
+        json.Field("avg_handshake_ms", pool.handshakes ? pool.handshake_total_ms / pool.handshakes : 0);
+        json.Field("reconnects", pool.reconnects);
+        json.Field("avg_reconnect_ms", pool.reconnects ? pool.reconnect_total_ms / pool.reconnects : 0);
+        json.Field("connect_internal_bytes", pool.connect_internal_bytes);
+        json.Field("connect_psram_bytes", pool.connect_psram_bytes);
+        json.Field("saved_ms", pool.SavedMs());
+        json.EndObject();
+
+        // DNS 缓存：命中省下的查询，查询失败时用旧地址的次数
+        json.Key("dns");
+        json.BeginObject();
+        json.Field("lookups", dns.lookups);
+        json.Field("hits", dns.hits);
+        json.Field("misses", dns.misses);
+        json.Field("stale", dns.stale);
+        json.Field("failures", dns.failures);
+        json.Field("avg_lookup_ms", dns.misses ? dns.lookup_total_ms / dns.misses : 0);
+        json.Field("max_lookup_ms", dns.lookup_max_ms);
+        json.Field("entries", dns.entries);
+        json.EndObject();
+
+        // 链路估计与据此选用的参数
+        json.Key("link");
+        json.BeginObject();
+        json.Field("class", LinkClassToString(link.link));
+        json.Field("rssi", link.rssi);
+        json.Field("srtt_ms", link.srtt_ms);
+        json.Field("rttvar_ms", link.rttvar_ms);
+        json.Field("first_byte_ms", link.first_byte_ms);
+        json.Field("first_byte_var_ms", link.first_byte_var_ms);
+        json.Field("uplink_kbps", link.uplink_kbps);
+        json.Field("loss_permille", link.loss_permille);
+        json.Field("requests", link.requests);
+        json.Field("network_errors", link.network_errors);
+        json.Field("changes", link.changes);
+        json.Field("jpeg_quality", profile.jpeg_quality);
+        json.Field("audio_bitrate", profile.audio_bitrate);
+        json.Field("context_percent", profile.context_percent);
+        json.Field("response_timeout_ms", profile.response_timeout_ms);
+        json.Field("hedge_after_ms", profile.hedge_after_ms);
+        json.EndObject();
+
+        // 实时语音：握手、帧数和语音到语音延迟（说完到回复第一帧音频）
+        json.Key("voice");
+        json.BeginObject();
+        json.Field("configured", VoiceChannel::GetInstance().IsConfigured());
+        json.Field("open", VoiceChannel::GetInstance().IsOpen());
+        json.Field("sessions", voice.sessions);
+        json.Field("connect_failures", voice.connect_failures);
+        json.Field("disconnects", voice.disconnects);
+        json.Field("handshake_ms", voice.last_handshake_ms);
+        json.Field("frames_sent", voice.frames_sent);
+        json.Field("frames_received", voice.frames_received);
+        json.Field("bytes_sent", voice.bytes_sent);
+        json.Field("bytes_received", voice.bytes_received);
+        json.Field("frames_dropped", voice.frames_dropped);
+        json.Field("stt_avg_ms", voice.stt_samples ? voice.stt_total_ms / voice.stt_samples : 0);
+        json.Field("turns", voice.turns);
+        json.Field("voice_avg_ms", voice.turns ? voice.voice_total_ms / voice.turns : 0);
+        json.Field("voice_min_ms", voice.voice_min_ms);
+        json.Field("voice_max_ms", voice.voice_max_ms);
+        json.Field("voice_last_ms", voice.last_voice_ms);
+        json.EndObject();
+
+        // gzip：上下行原始 / 实际字节数与编解码耗时，按端点列出协商结果
+        json.Key("gzip");
+        json.BeginObject();
+        json.Field("body_bytes", pool.body_bytes);
+        json.Field("sent_bytes", pool.sent_bytes);
+        json.Field("wire_bytes", pool.wire_bytes);
+        json.Field("decoded_bytes", pool.decoded_bytes);
+        json.Field("deflate_us", pool.deflate_us);
+        json.Field("inflate_us", pool.inflate_us);
+        json.Key("endpoints");
+        json.BeginArray();
+        for (const HttpEndpointStats& ep : endpoints) {
+            json.BeginObject();
+            json.Field("endpoint", ep.endpoint);
+            json.Field("accepts_gzip", ep.gzip_accepted);
+            json.Field("requests", ep.requests);
+            json.Field("gzip_requests", ep.gzip_requests);
+            json.Field("gzip_responses", ep.gzip_responses);
+            json.Field("saved_bytes", ep.SavedBytes());
+            json.EndObject();
+        }
+        json.EndArray();
+        json.EndObject();
+
+        // 流式响应：首 token 延迟
+        json.Key("stream");
+        json.BeginObject();
+        json.Field("streams", stream.streams);
+        json.Field("failures", stream.failures);
+        json.Field("chunks", stream.chunks);
+        json.Field("last_ttft_ms", stream.last_ttft_ms);
+        json.Field("avg_ttft_ms", stream.streams ? stream.ttft_total_ms / stream.streams : 0);
+        json.Field("min_ttft_ms", stream.ttft_min_ms);
+        json.Field("max_ttft_ms", stream.ttft_max_ms);
+        json.EndObject();
+
+        // 传输层：重试、熔断、对冲，以及各模型的熔断状态
+        json.Key("transport");
+        json.BeginObject();
+        json.Field("requests", transport.requests);
+        json.Field("failures", transport.failures);
+        json.Field("retries", transport.retries);
+        json.Field("fallbacks", transport.fallbacks);
+        json.Field("short_circuits", transport.short_circuits);
+        json.Field("hedges", transport.hedges);
+        json.Field("hedge_wins", transport.hedge_wins);
+        json.Field("chitchat", transport.chitchat);
+        json.Field("network_errors", transport.network_errors);
+        json.Field("rate_limited", transport.rate_limited);
+        json.Field("server_errors", transport.server_errors);
+        json.Field("invalid_responses", transport.invalid_responses);
+        json.Key("models");
+        json.BeginArray();
+        for (const EndpointHealth& h : health) {
+            json.BeginObject();
+            json.Field("model", h.model);
+            json.Field("circuit", CircuitStateToString(h.state));
+            json.Field("failures", h.consecutive_failures);
+            json.Field("trips", h.trips);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.EndObject();
+
+        // 结构化输出（记忆压缩）：失败率、修复与浪费的 token
+        json.Key("structured_output");
+        json.BeginObject();
+        json.Field("requests", structured.requests);
+        json.Field("valid", structured.valid);
+        json.Field("first_pass", structured.first_pass);
+        json.Field("recovered", structured.recovered);
+        json.Field("violations", structured.violations);
+        json.Field("aborted", structured.aborted);
+        json.Field("repairs", structured.repairs);
+        json.Field("failures", structured.failures);
+        json.Field("failure_rate",
+                   structured.requests ? static_cast<double>(structured.failures) / structured.requests : 0.0);
+        json.Field("wasted_tokens", structured.wasted_tokens);
+        json.EndObject();
+
+        // 图像请求：分段上传的耗时与内存（峰值与图像大小无关）
+        json.Key("vision");
+        json.BeginObject();
+        json.Field("requests", vision.requests);
+        json.Field("failures", vision.failures);
+        json.Field("uploads", vision.uploads);
+        json.Field("image_bytes", vision.image_bytes);
+        json.Field("body_bytes", vision.body_bytes);
+        json.Field("avg_upload_ms", vision.uploads ? vision.upload_total_ms / vision.uploads : 0);
+        json.Field("last_upload_ms", vision.last_upload_ms);
+        json.Field("max_upload_ms", vision.max_upload_ms);
+        json.Field("heap_peak_bytes", vision.heap_peak_bytes);
+        json.Field("scratch_bytes", vision.scratch_bytes);
+        json.EndObject();
+
+        // 网络任务请求队列：排队深度与等待时间
+        json.Key("queue");
+        json.BeginObject();
+        json.Field("submitted", queue.submitted);
+        json.Field("completed", queue.completed);
+        json.Field("expired", queue.expired);
+        json.Field("rejected", queue.rejected);
+        json.Field("queued", queue.queued);
+        json.Field("in_flight", queue.in_flight);
+        json.Field("max_queued", queue.max_queued);
+        json.Field("avg_wait_ms", queue.completed + queue.in_flight
+            ? queue.wait_total_ms / (queue.completed + queue.in_flight) : 0);
+        json.Field("max_wait_ms", queue.wait_max_ms);
+        json.Field("interactive_max_wait_ms", queue.interactive_wait_max_ms);
+        json.EndObject();
+
+        // 上下文打包：最近一轮的预算占用与裁剪情况
+        json.Key("context");
+        json.BeginObject();
+        json.Field("budget_tokens", pack.budget_tokens);
+        json.Field("used_tokens", pack.used_tokens);
+        json.Field("turns_verbatim", pack.turns_verbatim);
+        json.Field("turns_summarized", pack.turns_summarized);
+        json.Field("turns_dropped", pack.turns_dropped);
+        json.Field("hits_kept", pack.hits_kept);
+        json.Field("hits_dropped", pack.hits_dropped);
+        json.Field("images_kept", pack.images_kept);
+        json.Field("images_dropped", pack.images_dropped);
+        json.Field("session_memory_dropped", pack.session_memory_dropped);
+        json.Field("input_truncated", pack.input_truncated);
+        json.Field("buffer_evicted", session.GetEvictedMessages());
+        json.EndObject();
+
+        json.EndObject();
+    });
 }
 
 esp_err_t WebServer::HandleApiConfig(httpd_req_t *req) {
@@ -225,22 +725,18 @@ esp_err_t WebServer::HandleApiConfig(httpd_req_t *req) {
     }
     buf[ret] = '\0';
 
-    // TODO: 使用 JSON 库解析
-    // 临时简单解析
-    std::string body(buf);
-
-    auto extract = [&body](const std::string& key) -> std::string {
-        std::string search = "\"" + key + "\":\"";
-        size_t start = body.find(search);
-        if (start == std::string::npos) return "";
-        start += search.length();
-        size_t end = body.find("\"", start);
-        return body.substr(start, end - start);
-    };
+    JsonFieldReader fields;
+    if (!fields.Parse(buf, ret)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
 
-    std::string ssid = extract("ssid");
-    std::string password = extract("password");
-    std::string api_key = extract("api_key");
+    std::string ssid;
+    std::string password;
+    std::string api_key;
+    fields.GetString("ssid", ssid);
+    fields.GetString("password", password);
+    fields.GetString("api_key", api_key);
 
     ConfigManager& config = ConfigManager::GetInstance();
     esp_err_t err = config.SetConfig(ssid, password, api_key);
@@ -258,14 +754,235 @@ esp_err_t WebServer::HandleApiConfig(httpd_req_t *req) {
     return ESP_OK;
 }
 
+esp_err_t WebServer::HandleApiUsage(httpd_req_t *req) {
+    std::string json = TokenLedger::GetInstance().ToJson();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_send(req, json.c_str(), json.length());
+    return ESP_OK;
+}
+
+esp_err_t WebServer::HandleApiBudget(httpd_req_t *req) {
+    char buf[128];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    // {"session_tokens": N, "daily_tokens": N}，0 表示不限，缺省的保持不变
+    JsonFieldReader fields;
+    if (!fields.Parse(buf, ret)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    TokenLedger& ledger = TokenLedger::GetInstance();
+    TokenBudget budget = ledger.GetBudget();
+    double value;
+    if (fields.GetNumber("session_tokens", value) && value >= 0) {
+        budget.session_tokens = static_cast<uint32_t>(value);
+    }
+    if (fields.GetNumber("daily_tokens", value) && value >= 0) {
+        budget.daily_tokens = static_cast<uint32_t>(value);
+    }
+
+    if (ConfigManager::GetInstance().SetTokenBudget(budget.session_tokens,
+                                                    budget.daily_tokens) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save");
+        return ESP_FAIL;
+    }
+    ledger.SetBudget(budget);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"success\":true}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+esp_err_t WebServer::HandleApiVoice(httpd_req_t *req) {
+    char buf[384];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    // {"url": "ws://...", "token": "..."}，url 为空表示不用实时语音；下次会话生效
+    JsonFieldReader fields;
+    std::string url;
+    std::string token;
+    if (!fields.Parse(buf, ret) || !fields.GetString("url", url)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    fields.GetString("token", token);
+    if (!url.empty() && url.compare(0, 5, "ws://") != 0 && url.compare(0, 6, "wss://") != 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "URL must start with ws:// or wss://");
+        return ESP_FAIL;
+    }
+
+    if (ConfigManager::GetInstance().SetVoiceServer(url, token) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save");
+        return ESP_FAIL;
+    }
+    VoiceChannel::GetInstance().SetServer(url, token);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"success\":true}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
 esp_err_t WebServer::HandleApiMemory(httpd_req_t *req) {
-    MemoryManager& memory = MemoryManager::GetInstance();
-    CompressedMemory mem = memory.LoadMemory();
+    // 直接读快照；代数作为 ETag，未变化时返回 304
+    MemorySnapshotPtr snapshot = MemoryManager::GetInstance().GetSnapshot();
+
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%u\"", static_cast<unsigned>(snapshot->generation));
+
+    char if_none_match[16];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                                    sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_send(req, nullptr, 0);
+        return ESP_OK;
+    }
 
-    std::string json = mem.raw_json.empty() ? "{}" : mem.raw_json;
+    const std::string& raw = snapshot->memory.raw_json;
+    const char* json = raw.empty() ? "{}" : raw.c_str();
+    size_t len = raw.empty() ? 2 : raw.length();
 
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json.c_str(), json.length());
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_send(req, json, len);
+    return ESP_OK;
+}
+
+esp_err_t WebServer::HandleApiMemoryHistory(httpd_req_t *req) {
+    // 只读取内存中的版本索引，不访问 Flash
+    std::vector<VersionInfo> versions = MemoryManager::GetInstance().GetVersionHistory();
+
+    size_t stored_bytes = 0;
+    return SendJsonChunked(req, [&](auto& json) {
+        json.BeginObject();
+        json.Key("versions");
+        json.BeginArray();
+        for (const VersionInfo& v : versions) {
+            stored_bytes += v.stored_size;
+            json.BeginObject();
+            json.Field("seq", v.seq);
+            json.Field("hash", v.hash);
+            json.Field("timestamp", static_cast<long long>(v.timestamp));
+            json.Field("size", v.size);
+            json.Field("stored", v.stored_size);
+            json.Field("base", v.is_base);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Field("count", versions.size());
+        json.Field("stored_bytes", stored_bytes);
+        json.EndObject();
+    });
+}
+
+esp_err_t WebServer::HandleApiSessions(httpd_req_t *req) {
+    // 参数：page / size（按页），before（按时间），id（单个会话）
+    size_t page = 0;
+    size_t size = 10;
+    long long before = -1;
+    long long id = -1;
+
+    char query[128];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[24];
+        if (httpd_query_key_value(query, "page", value, sizeof(value)) == ESP_OK) {
+            page = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "size", value, sizeof(value)) == ESP_OK) {
+            size = strtoul(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "before", value, sizeof(value)) == ESP_OK) {
+            before = strtoll(value, nullptr, 10);
+        }
+        if (httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+            id = strtoll(value, nullptr, 10);
+        }
+    }
+
+    SessionArchive& archive = MemoryManager::GetInstance().GetSessionArchive();
+
+    std::vector<std::string> records;
+    bool ok;
+    if (id > 0) {
+        std::string record;
+        ok = archive.GetSession(static_cast<uint32_t>(id), record);
+        if (ok) {
+            records.push_back(std::move(record));
+        }
+    } else if (before >= 0) {
+        ok = archive.GetPageBefore(static_cast<std::time_t>(before), size, records);
+    } else {
+        ok = archive.GetPage(page, size, records);
+    }
+
+    if (!ok) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Session not found");
+        return ESP_FAIL;
+    }
+
+    // 记录本身就是 JSON，原样写入
+    return SendJsonChunked(req, [&](auto& json) {
+        json.BeginObject();
+        json.Field("total", archive.Count());
+        json.Field("page", page);
+        json.Field("size", size);
+        json.Field("blocks", archive.GetBlockCount());
+        json.Field("raw_bytes", archive.GetRawBytes());
+        json.Field("stored_bytes", archive.GetStoredBytes());
+        json.Key("sessions");
+        json.BeginArray();
+        for (const std::string& record : records) {
+            json.Raw(record);
+        }
+        json.EndArray();
+        json.EndObject();
+    });
+}
+
+esp_err_t WebServer::HandleApiMemoryRollback(httpd_req_t *req) {
+    char buf[128];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    // 支持 {"hash":"..."} 或 {"version":N}
+    JsonFieldReader fields;
+    if (!fields.Parse(buf, ret)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    MemoryManager& memory = MemoryManager::GetInstance();
+    bool success = false;
+    std::string hash;
+    double version = 0;
+
+    if (fields.GetString("hash", hash)) {
+        success = memory.RollbackToHash(hash);
+    } else if (fields.GetNumber("version", version)) {
+        success = memory.RollbackToBackup(static_cast<int>(version));
+    } else {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing hash or version");
+        return ESP_FAIL;
+    }
+
+    const char* response = success ? "{\"success\":true}" : "{\"success\":false}";
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, strlen(response));
     return ESP_OK;
 }
 
@@ -33,6 +33,12 @@ private:
     static esp_err_t HandleApiStatus(httpd_req_t *req);
     static esp_err_t HandleApiConfig(httpd_req_t *req);
     static esp_err_t HandleApiMemory(httpd_req_t *req);
+    static esp_err_t HandleApiMemoryHistory(httpd_req_t *req);
+    static esp_err_t HandleApiMemoryRollback(httpd_req_t *req);
+    static esp_err_t HandleApiSessions(httpd_req_t *req);
+    static esp_err_t HandleApiUsage(httpd_req_t *req);
+    static esp_err_t HandleApiBudget(httpd_req_t *req);
+    static esp_err_t HandleApiVoice(httpd_req_t *req);
 
     httpd_handle_t server_ = nullptr;
 };
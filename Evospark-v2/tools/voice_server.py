@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""实时语音协议的本地替身服务端（只用标准库）
+
+实现设备端 ai/voice_channel.cc 用到的 xiaozhi WebSocket 协议子集，用来在
+没有真实 ASR / LLM / TTS 的情况下联调设备、测量语音到语音延迟：
+
+  - 握手：检查 Protocol-Version（和 --token 时的 Authorization），回复 hello
+  - listen start（auto 模式）后按 Opus 包大小判断有没有人声：包长超过
+    --vad-bytes 为有声，有声后连续 --silence-ms 无声视为说完
+  - 说完后依次等待 --asr-ms 发 stt、--llm-ms 发 llm（表情）和 tts start、
+    --tts-ms 发 sentence_start，再把这段话的 Opus 包按帧长原样回放，最后
+    tts stop；期间收到 abort 立即停止
+  - --jitter-ms 给每段等待加均匀抖动
+
+用法：
+  python3 tools/voice_server.py --port 8765 --asr-ms 150 --llm-ms 300 --tts-ms 120
+  设备上 POST /api/voice {"url": "ws://<电脑 IP>:8765/"}
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import random
+import struct
+import time
+import uuid
+
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+OP_CONTINUATION = 0x0
+OP_TEXT = 0x1
+OP_BINARY = 0x2
+OP_CLOSE = 0x8
+OP_PING = 0x9
+OP_PONG = 0xA
+
+
+class ConnectionClosed(Exception):
+    pass
+
+
+class WebSocket:
+    """服务端一侧的最小 WebSocket（RFC 6455）：收帧去掩码、重组分片，发帧不加掩码"""
+
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+        self.send_lock = asyncio.Lock()
+
+    async def _read_frame(self):
+        try:
+            head = await self.reader.readexactly(2)
+            fin = head[0] & 0x80
+            opcode = head[0] & 0x0F
+            length = head[1] & 0x7F
+            if length == 126:
+                length = struct.unpack("!H", await self.reader.readexactly(2))[0]
+            elif length == 127:
+                length = struct.unpack("!Q", await self.reader.readexactly(8))[0]
+            mask = await self.reader.readexactly(4) if head[1] & 0x80 else None
+            payload = await self.reader.readexactly(length)
+        except (asyncio.IncompleteReadError, ConnectionError):
+            raise ConnectionClosed()
+        if mask:
+            payload = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        return fin, opcode, payload
+
+    async def recv(self):
+        """返回 (opcode, payload)，只返回文本和二进制消息"""
+        message = b""
+        message_opcode = None
+        while True:
+            fin, opcode, payload = await self._read_frame()
+            if opcode == OP_PING:
+                await self.send(OP_PONG, payload)
+                continue
+            if opcode == OP_PONG:
+                continue
+            if opcode == OP_CLOSE:
+                await self.send(OP_CLOSE, payload[:2])
+                raise ConnectionClosed()
+            if opcode != OP_CONTINUATION:
+                message_opcode = opcode
+                message = b""
+            message += payload
+            if fin:
+                return message_opcode, message
+
+    async def send(self, opcode, payload):
+        header = bytes([0x80 | opcode])
+        length = len(payload)
+        if length < 126:
+            header += bytes([length])
+        elif length < 65536:
+            header += bytes([126]) + struct.pack("!H", length)
+        else:
+            header += bytes([127]) + struct.pack("!Q", length)
+        async with self.send_lock:
+            try:
+                self.writer.write(header + payload)
+                await self.writer.drain()
+            except ConnectionError:
+                raise ConnectionClosed()
+
+    async def send_json(self, message):
+        await self.send(OP_TEXT, json.dumps(message, ensure_ascii=False).encode())
+
+
+async def handshake(reader, writer, token):
+    """读取升级请求并回复 101；失败时回复错误状态并返回 None"""
+    request = await reader.readuntil(b"\r\n\r\n")
+    lines = request.decode("latin-1").split("\r\n")
+    headers = {}
+    for line in lines[1:]:
+        if ":" in line:
+            key, value = line.split(":", 1)
+            headers[key.strip().lower()] = value.strip()
+
+    def reject(status):
+        writer.write(f"HTTP/1.1 {status}\r\nContent-Length: 0\r\nConnection: close\r\n\r\n".encode())
+        return None
+
+    key = headers.get("sec-websocket-key")
+    if not key or headers.get("upgrade", "").lower() != "websocket":
+        return reject("400 Bad Request")
+    if token and headers.get("authorization") != f"Bearer {token}":
+        return reject("401 Unauthorized")
+    if headers.get("protocol-version", "1") != "1":
+        return reject("400 Bad Request")
+
+    accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+    writer.write(("HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                  f"Sec-WebSocket-Accept: {accept}\r\n\r\n").encode())
+    await writer.drain()
+    return headers
+
+
+class Session:
+    def __init__(self, ws, args, device_id):
+        self.ws = ws
+        self.args = args
+        self.device_id = device_id
+        self.session_id = str(uuid.uuid4())
+        self.frame_ms = 60
+        self.listening = False
+        self.speech = []            # 这段话的 Opus 包
+        self.voiced = False
+        self.silent_ms = 0
+        self.reply = None           # 正在回复的任务
+
+    def delay(self, ms):
+        jitter = random.uniform(-self.args.jitter_ms, self.args.jitter_ms) if self.args.jitter_ms else 0
+        return max(ms + jitter, 0) / 1000
+
+    async def on_text(self, message):
+        kind = message.get("type")
+        if kind == "hello":
+            params = message.get("audio_params", {})
+            self.frame_ms = params.get("frame_duration", 60)
+            await self.ws.send_json({
+                "type": "hello",
+                "transport": "websocket",
+                "session_id": self.session_id,
+                "audio_params": {"format": "opus", "sample_rate": self.args.sample_rate,
+                                 "channels": 1, "frame_duration": self.frame_ms},
+            })
+        elif kind == "listen":
+            if message.get("state") == "start":
+                self.listening = True
+                self.speech, self.voiced, self.silent_ms = [], False, 0
+            elif message.get("state") == "stop":
+                self.listening = False
+                if self.speech:
+                    self.start_reply()
+        elif kind == "abort":
+            if self.reply and not self.reply.done():
+                self.reply.cancel()
+                await self.ws.send_json({"session_id": self.session_id, "type": "tts", "state": "stop"})
+
+    async def on_audio(self, packet):
+        if not self.listening or (self.reply and not self.reply.done()):
+            return
+        if len(packet) > self.args.vad_bytes:
+            self.voiced = True
+            self.silent_ms = 0
+            self.speech.append(packet)
+        elif self.voiced:
+            self.silent_ms += self.frame_ms
+            if self.silent_ms >= self.args.silence_ms:
+                self.listening = False
+                self.start_reply()
+
+    def start_reply(self):
+        frames, self.speech, self.voiced, self.silent_ms = self.speech, [], False, 0
+        self.reply = asyncio.ensure_future(self.run_reply(frames))
+
+    async def run_reply(self, frames):
+        send = self.ws.send_json
+        sid = self.session_id
+        seconds = len(frames) * self.frame_ms / 1000
+        await asyncio.sleep(self.delay(self.args.asr_ms))
+        await send({"session_id": sid, "type": "stt", "text": f"说了 {seconds:.1f} 秒"})
+        await asyncio.sleep(self.delay(self.args.llm_ms))
+        await send({"session_id": sid, "type": "llm", "text": "🙂", "emotion": "happy"})
+        await send({"session_id": sid, "type": "tts", "state": "start"})
+        await asyncio.sleep(self.delay(self.args.tts_ms))
+        await send({"session_id": sid, "type": "tts", "state": "sentence_start",
+                    "text": f"我听到你说了 {seconds:.1f} 秒。"})
+        # 按帧长回放；先发两帧作为客户端的缓冲
+        start = time.monotonic()
+        for i, packet in enumerate(frames):
+            await self.ws.send(OP_BINARY, packet)
+            ahead = start + max(i - 1, 0) * self.frame_ms / 1000 - time.monotonic()
+            if ahead > 0:
+                await asyncio.sleep(ahead)
+        await send({"session_id": sid, "type": "tts", "state": "stop"})
+
+
+async def serve_client(reader, writer, args):
+    peer = writer.get_extra_info("peername")
+    try:
+        headers = await handshake(reader, writer, args.token)
+        if headers is None:
+            await writer.drain()
+            return
+        device_id = headers.get("device-id", "?")
+        print(f"{peer[0]} connected (device {device_id})", flush=True)
+        ws = WebSocket(reader, writer)
+        session = Session(ws, args, device_id)
+        while True:
+            opcode, payload = await ws.recv()
+            if opcode == OP_TEXT:
+                await session.on_text(json.loads(payload))
+            elif opcode == OP_BINARY:
+                await session.on_audio(payload)
+    except (ConnectionClosed, asyncio.IncompleteReadError, ConnectionError):
+        pass
+    finally:
+        print(f"{peer[0]} disconnected", flush=True)
+        writer.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="EvoSpark realtime voice stand-in server")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--token", default="", help="要求的 Bearer token，空为不检查")
+    parser.add_argument("--sample-rate", type=int, default=16000, help="下行 hello 声明的采样率")
+    parser.add_argument("--vad-bytes", type=int, default=40, help="Opus 包超过这个长度算有声")
+    parser.add_argument("--silence-ms", type=int, default=600, help="有声后多久无声算说完")
+    parser.add_argument("--asr-ms", type=int, default=150)
+    parser.add_argument("--llm-ms", type=int, default=300, help="LLM 首句延迟")
+    parser.add_argument("--tts-ms", type=int, default=120, help="TTS 首帧延迟")
+    parser.add_argument("--jitter-ms", type=int, default=0)
+    args = parser.parse_args()
+
+    async def run():
+        server = await asyncio.start_server(lambda r, w: serve_client(r, w, args), args.host, args.port)
+        print(f"Voice server on ws://{args.host}:{args.port}/", flush=True)
+        async with server:
+            await server.serve_forever()
+
+    try:
+        asyncio.run(run())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
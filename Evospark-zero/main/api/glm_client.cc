@@ -1,14 +1,20 @@
 #include "glm_client.h"
+#include "http_pool.h"
+#include "completion_parser.h"
+#include "sse_parser.h"
 #include "../memory/memory_types.h"
+#include "memory_index.h"
 #include <cstring>
+#include <algorithm>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 namespace EvoSpark {
 
 static const char* TAG = "GLMClient";
 
 GLMClient::GLMClient()
-    : api_url_("http://open.bigmodel.cn/api/paas/v4/chat/completions"),  // 使用 HTTP 绕过 TLS 问题（测试用）
+    : api_url_("https://open.bigmodel.cn/api/paas/v4/chat/completions"),
       is_initialized_(false) {
 }
 
@@ -22,182 +28,413 @@ bool GLMClient::Init(const std::string& api_key) {
     }
 
     api_key_ = api_key;
+
+    // 对话和记忆压缩共用连接池，同一主机只握手一次
+    // 服务端证书用内置证书包验证（全局 CA 存储从未装入证书，握手必然失败）；
+    // 会话票据和 PSRAM 中的 TLS 缓冲区见 sdkconfig.defaults
+    HttpPoolOptions options;
+    options.gzip_requests = GZIP_REQUESTS;
+    options.gzip_responses = GZIP_RESPONSES;
+    HttpConnectionPool::GetInstance().Configure(options);
+
+    // 网络任务：此后所有请求都在这里执行
+    if (!RequestQueue::GetInstance().Start()) {
+        ESP_LOGE(TAG, "Failed to start network tasks");
+        return false;
+    }
+
     is_initialized_ = true;
     ESP_LOGI(TAG, "GLM client initialized");
     return true;
 }
 
-struct ResponseData {
-    std::string body;
-    size_t received = 0;
-};
-
-static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
-    ResponseData* data = static_cast<ResponseData*>(evt->user_data);
-
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            data->body.append((char*)evt->data, evt->data_len);
-            data->received += evt->data_len;
-            break;
+bool GLMClient::Chat(const std::string& message, std::string& response) {
+    return Chat("", message, response);
+}
 
-        default:
-            break;
-    }
+PromptCacheStats GLMClient::GetCacheStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return cache_stats_;
+}
 
-    return ESP_OK;
+StructuredOutputStats GLMClient::GetStructuredOutputStats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return structured_stats_;
 }
 
-bool GLMClient::Chat(const std::string& message, std::string& response) {
+bool GLMClient::Chat(const std::string& system, const std::string& message,
+                     std::string& response) {
     if (!is_initialized_) {
         ESP_LOGE(TAG, "GLM client not initialized");
         return false;
     }
 
-    ESP_LOGI(TAG, "Sending message to GLM: %d bytes", message.length());
+    Request request;
+    request.system = system;
+    request.message = message;
 
-    // 构造 JSON 请求体
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to create JSON object");
-        return false;
+    // 已在网络任务上时直接执行，不能等待排在自己后面的请求
+    if (RequestQueue::GetInstance().OnNetworkTask()) {
+        ChatResult result;
+        bool ok = Run(request, result, HTTP_TIMEOUT_MS);
+        response = std::move(result.content);
+        return ok;
     }
 
-    if (!cJSON_AddStringToObject(root, "model", "glm-4.7-flash")) {
-        ESP_LOGE(TAG, "Failed to add model to JSON");
-        cJSON_Delete(root);
-        return false;
-    }
-
-    cJSON *messages = cJSON_CreateArray();
-    if (!messages) {
-        ESP_LOGE(TAG, "Failed to create messages array");
-        cJSON_Delete(root);
-        return false;
-    }
-
-    cJSON *msg = cJSON_CreateObject();
-    if (!msg) {
-        ESP_LOGE(TAG, "Failed to create message object");
-        cJSON_Delete(messages);
-        cJSON_Delete(root);
-        return false;
-    }
-
-    if (!cJSON_AddStringToObject(msg, "role", "user") ||
-        !cJSON_AddStringToObject(msg, "content", message.c_str())) {
-        ESP_LOGE(TAG, "Failed to add message fields");
-        cJSON_Delete(msg);
-        cJSON_Delete(messages);
-        cJSON_Delete(root);
-        return false;
-    }
-
-    cJSON_AddItemToArray(messages, msg);
-    cJSON_AddItemToObject(root, "messages", messages);
-
-    // 直接添加参数到根级别（根据 GLM API 文档）
-    cJSON_AddNumberToObject(root, "max_tokens", max_tokens_);
-    cJSON_AddNumberToObject(root, "temperature", temperature_);
-
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to print JSON");
-        cJSON_Delete(root);
-        return false;
-    }
+    ChatResult result = Submit(std::move(request)).get();
+    response = std::move(result.content);
+    return result.success;
+}
 
-    std::string request_body(json_str);
-    cJSON_Delete(root);
-    free(json_str);
-
-    // 配置 HTTP 客户端
-    ResponseData response_data{};
-
-    esp_http_client_config_t config = {};
-    config.url = api_url_.c_str();
-    config.method = HTTP_METHOD_POST;
-    config.event_handler = http_event_handler;
-    config.user_data = &response_data;
-    config.timeout_ms = 60000;  // 60秒超时（处理慢速网络）
-    config.buffer_size = 32768;  // 增大缓冲区以处理大响应
-    config.use_global_ca_store = true;  // 使用全局 CA 证书存储
-    config.skip_cert_common_name_check = true;  // 跳过证书 CN 检查
-    config.disable_auto_redirect = true;  // 禁用自动重定向
-    config.keep_alive_enable = false;  // 禁用 keep-alive，确保连接正确关闭
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to create HTTP client");
-        return false;
+void GLMClient::Submit(Request request, ChatCallback done) {
+    if (!is_initialized_) {
+        ESP_LOGE(TAG, "GLM client not initialized");
+        done(ChatResult());
+        return;
     }
 
-    // 设置请求头
-    std::string auth_header = "Bearer " + api_key_;
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-
-    // 发送请求
-    esp_http_client_set_post_field(client, request_body.c_str(), request_body.length());
-
-    esp_err_t err = esp_http_client_perform(client);
-    int status_code = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-        return false;
-    }
+    // 请求和回调由两个闭包共享，谁被调用谁交付结果
+    auto shared = std::make_shared<std::pair<Request, ChatCallback>>(
+        std::move(request), std::move(done));
+    RequestPriority priority = shared->first.priority;
+    uint32_t deadline_ms = shared->first.deadline_ms;
+    RequestQueue::GetInstance().Submit(
+        priority, deadline_ms,
+        [this, shared](int64_t deadline_us) {
+            ChatResult result;
+            int timeout_ms = HTTP_TIMEOUT_MS;
+            if (deadline_us > 0) {
+                int64_t remaining_ms = (deadline_us - esp_timer_get_time()) / 1000;
+                timeout_ms = static_cast<int>(std::max<int64_t>(
+                    std::min<int64_t>(remaining_ms, HTTP_TIMEOUT_MS), 1000));
+            }
+            result.success = Run(shared->first, result, timeout_ms);
+            shared->second(result);
+        },
+        [shared](bool rejected) {
+            ESP_LOGW(TAG, "Request dropped: %s", rejected ? "queue full" : "deadline exceeded");
+            ChatResult result;
+            result.expired = true;
+            shared->second(result);
+        });
+}
 
-    ESP_LOGI(TAG, "HTTP status: %d, response size: %d bytes",
-             status_code, response_data.body.length());
+std::future<ChatResult> GLMClient::Submit(Request request) {
+    auto promise = std::make_shared<std::promise<ChatResult>>();
+    std::future<ChatResult> future = promise->get_future();
+    Submit(std::move(request), [promise](const ChatResult& result) {
+        promise->set_value(result);
+    });
+    return future;
+}
 
-    if (status_code != 200) {
-        ESP_LOGE(TAG, "API returned non-200 status: %d", status_code);
-        ESP_LOGE(TAG, "Response: %s", response_data.body.c_str());
-        return false;
+bool GLMClient::Run(const Request& request, ChatResult& result, int timeout_ms) {
+    if (!request.schema) {
+        return Execute(request, nullptr, nullptr, StructuredOutputMode::NONE, result, timeout_ms);
     }
 
-    // 解析响应
-    cJSON *response_json = cJSON_Parse(response_data.body.c_str());
-    if (!response_json) {
-        ESP_LOGE(TAG, "Failed to parse response JSON");
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        structured_stats_.requests++;
     }
 
-    cJSON *choices = cJSON_GetObjectItem(response_json, "choices");
-    if (!choices || !cJSON_IsArray(choices)) {
-        ESP_LOGE(TAG, "Invalid response format: no choices");
-        cJSON_Delete(response_json);
-        return false;
+    int64_t deadline_us = esp_timer_get_time() + static_cast<int64_t>(timeout_ms) * 1000;
+    RepairTurn repair;
+    StructuredOutputMode mode = structured_mode_.load();
+    bool format_fallback = false;
+    for (int pass = 0;;) {
+        StructuredOutputValidator validator(*request.schema);
+        result = ChatResult();
+        int remaining_ms = static_cast<int>((deadline_us - esp_timer_get_time()) / 1000);
+        bool ok = Execute(request, pass > 0 ? &repair : nullptr, &validator, mode, result,
+                          std::max(remaining_ms, 1000));
+
+        if (!ok && !validator.Failed()) {
+            // 带 response_format 被 400：本次请求只靠提示词要求 JSON，立即重发一次。
+            // 错误信息点名 response_format 时确定是不支持，之后都不再带
+            if (result.http_status == 400 && mode != StructuredOutputMode::NONE) {
+                bool named = result.error_body.find("response_format") != std::string::npos;
+                ESP_LOGW(TAG, "Request with response_format %s got 400%s, retrying without it",
+                         StructuredOutputModeToString(mode), named ? " (unsupported)" : "");
+                if (named) {
+                    structured_mode_.store(StructuredOutputMode::NONE);
+                }
+                mode = StructuredOutputMode::NONE;
+                format_fallback = true;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            structured_stats_.failures++;
+            return false;
+        }
+
+        // 去掉 response_format 后请求被接受：多半是服务端不认它，连续几次才全局降级；
+        // 带着它成功则清零
+        if (format_fallback) {
+            format_fallback = false;
+            if (format_rejections_.fetch_add(1) + 1 >= FORMAT_REJECTIONS_TO_DOWNGRADE &&
+                structured_mode_.load() != StructuredOutputMode::NONE) {
+                ESP_LOGW(TAG, "response_format rejected %d times in a row, relying on the prompt",
+                         FORMAT_REJECTIONS_TO_DOWNGRADE);
+                structured_mode_.store(StructuredOutputMode::NONE);
+            }
+        } else if (mode != StructuredOutputMode::NONE) {
+            format_rejections_.store(0);
+        }
+
+        if (ok && validator.Finish()) {
+            result.content = validator.Extract(result.content);
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            structured_stats_.valid++;
+            if (pass == 0) {
+                structured_stats_.first_pass++;
+            }
+            if (validator.Recovered()) {
+                structured_stats_.recovered++;
+            }
+            return true;
+        }
+
+        // 不合格：ok 为 false 说明校验失败后已提前断开
+        bool aborted = !ok;
+        ESP_LOGW(TAG, "Structured output rejected%s (%s): %s, %d tokens wasted",
+                 aborted ? " mid-stream" : "", SchemaViolationToString(validator.Violation()),
+                 validator.Error().c_str(), result.tokens_used);
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        bool give_up = pass >= MAX_REPAIRS || left_ms < MIN_REPAIR_TIMEOUT_MS;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            structured_stats_.violations++;
+            structured_stats_.wasted_tokens += result.tokens_used;
+            if (aborted) {
+                structured_stats_.aborted++;
+            }
+            if (give_up) {
+                structured_stats_.failures++;
+            } else {
+                structured_stats_.repairs++;
+            }
+        }
+        if (give_up) {
+            return false;
+        }
+
+        // 修复请求：原消息原样保留（前缀缓存仍然命中），追加上次的输出和问题说明
+        repair.output = result.content.substr(0, REPAIR_ECHO_BYTES);
+        repair.instruction = validator.RepairInstruction();
+        pass++;
     }
+}
 
-    cJSON *first_choice = cJSON_GetArrayItem(choices, 0);
-    if (!first_choice) {
-        ESP_LOGE(TAG, "Invalid response: choices array is empty");
-        cJSON_Delete(response_json);
-        return false;
+bool GLMClient::Execute(const Request& request, const RepairTurn* repair,
+                        StructuredOutputValidator* validator, StructuredOutputMode mode,
+                        ChatResult& result, int timeout_ms) {
+    const std::string& system = request.system;
+    const std::string& message = request.message;
+    TokenPurpose purpose = request.purpose;
+    bool stream = validator != nullptr;
+
+    ESP_LOGI(TAG, "Sending message to GLM: %d bytes%s", message.length(),
+             repair ? " (repair)" : "");
+
+    // 接近 token 预算时限制对话回复长度（压缩结果必须完整，不限）
+    int max_tokens = max_tokens_;
+    if (purpose == TokenPurpose::CHAT &&
+        TokenLedger::GetInstance().GetLevel() != BudgetLevel::NORMAL) {
+        max_tokens = std::min(max_tokens, ECONOMY_MAX_TOKENS);
     }
-
-    cJSON *message_obj = cJSON_GetObjectItem(first_choice, "message");
-    if (!message_obj) {
-        ESP_LOGE(TAG, "Invalid response: no message in choice");
-        cJSON_Delete(response_json);
-        return false;
+    // 构造 JSON 请求体（先量长度，一次分配）
+    std::string request_body;
+    JsonWriteTo(request_body, [&](auto& json) {
+        json.BeginObject();
+        json.Field("model", "glm-4.7-flash");
+        json.Key("messages");
+        json.BeginArray();
+        if (!system.empty()) {
+            json.BeginObject();
+            json.Field("role", "system");
+            json.Field("content", system);
+            json.EndObject();
+        }
+        json.BeginObject();
+        json.Field("role", "user");
+        json.Field("content", message);
+        json.EndObject();
+        if (repair) {
+            json.BeginObject();
+            json.Field("role", "assistant");
+            json.Field("content", repair->output);
+            json.EndObject();
+            json.BeginObject();
+            json.Field("role", "user");
+            json.Field("content", repair->instruction);
+            json.EndObject();
+        }
+        json.EndArray();
+
+        // 直接添加参数到根级别（根据 GLM API 文档）
+        json.Field("max_tokens", max_tokens);
+        // 结构化输出降低随机性，格式更稳定
+        json.Field("temperature", request.schema ? 0.3f : temperature_);
+        if (stream) {
+            json.Field("stream", true);
+        }
+        if (request.schema) {
+            WriteResponseFormat(json, *request.schema, mode);
+        }
+        json.EndObject();
+    });
+
+    // 经连接池发送（长连接复用，出错的连接自动重建）
+    HttpConnectionPool::Headers headers = {
+        {"Authorization", "Bearer " + api_key_},
+        {"Content-Type", "application/json"},
+    };
+
+    CompletionUsage usage;
+    int64_t start_us = esp_timer_get_time();
+    if (stream) {
+        // 每个 SSE 事件是一个 chat.completion.chunk，usage 在最后一个事件里；
+        // 增量交给校验器，判定违反后置位 cancel，连接池随即断开连接
+        std::atomic<bool> cancel{false};
+        JsonReader reader;
+        SseParser parser([&](const std::string& data) {
+            std::string delta;
+            CompletionUsage event_usage;
+            CompletionHandler handler("delta", delta, event_usage);
+            if (reader.Parse(data, handler) != JsonParseError::NONE) {
+                ESP_LOGW(TAG, "Skipping malformed stream event (%zu bytes)", data.size());
+                return;
+            }
+            if (event_usage.present) {
+                usage = event_usage;
+            }
+            if (delta.empty() || cancel.load()) {
+                return;
+            }
+            result.content += delta;
+            if (!validator->Feed(delta)) {
+                cancel.store(true);
+            }
+        });
+        // 错误响应不是 SSE，留下开头一段用来判断 400 的原因
+        result.http_status = HttpConnectionPool::GetInstance().Post(
+            api_url_, request_body, headers,
+            [&parser, &result](const char* data, size_t length) {
+                if (result.error_body.size() < ERROR_BODY_BYTES) {
+                    result.error_body.append(data, std::min(length,
+                                             ERROR_BODY_BYTES - result.error_body.size()));
+                }
+                parser.Feed(data, length);
+            },
+            timeout_ms, &cancel);
+        parser.Finish();
+        result.latency_ms = static_cast<uint32_t>((esp_timer_get_time() - start_us) / 1000);
+
+        if (cancel.load()) {
+            // 断开后收不到 usage：按发出的消息和已收到的内容估算
+            int prompt_tokens = usage.prompt_tokens;
+            int completion_tokens = usage.completion_tokens;
+            if (!usage.present) {
+                prompt_tokens = MemoryIndex::EstimateTokens(system) +
+                                MemoryIndex::EstimateTokens(message);
+                if (repair) {
+                    prompt_tokens += MemoryIndex::EstimateTokens(repair->output) +
+                                     MemoryIndex::EstimateTokens(repair->instruction);
+                }
+                completion_tokens = MemoryIndex::EstimateTokens(result.content);
+            }
+            result.tokens_used = prompt_tokens + completion_tokens;
+            TokenLedger::GetInstance().Record(purpose, prompt_tokens, completion_tokens, 0);
+            ESP_LOGW(TAG, "Stream cancelled after %u bytes, %u ms",
+                     static_cast<unsigned>(result.content.size()),
+                     static_cast<unsigned>(result.latency_ms));
+            return false;
+        }
+        if (result.http_status < 0) {
+            ESP_LOGE(TAG, "HTTP request failed");
+            return false;
+        }
+        if (result.http_status != 200) {
+            ESP_LOGE(TAG, "API returned non-200 status: %d", result.http_status);
+            return false;
+        }
+        result.error_body.clear();
+        if (result.content.empty()) {
+            ESP_LOGE(TAG, "Invalid response: empty stream");
+            return false;
+        }
+        if (!parser.IsDone()) {
+            // 连接提前关闭：已收到的内容交给校验器判断是否完整
+            ESP_LOGW(TAG, "Stream ended without [DONE]");
+        }
+    } else {
+        // 响应体写入复用的 PSRAM 缓冲区；另一任务（记忆压缩）正在用时临时建一个
+        std::unique_lock<std::mutex> lease(buffer_mutex_, std::try_to_lock);
+        ResponseBuffer local_buffer;
+        ResponseBuffer& buffer = lease.owns_lock() ? response_buffer_ : local_buffer;
+        buffer.Clear();
+
+        int status_code = HttpConnectionPool::GetInstance().Post(
+            api_url_, request_body, headers,
+            [&buffer](const char* data, size_t length) { buffer.Append(data, length); },
+            timeout_ms);
+        result.latency_ms = static_cast<uint32_t>((esp_timer_get_time() - start_us) / 1000);
+        result.http_status = status_code;
+
+        if (status_code < 0) {
+            ESP_LOGE(TAG, "HTTP request failed");
+            return false;
+        }
+
+        ESP_LOGI(TAG, "HTTP status: %d, response size: %d bytes",
+                 status_code, buffer.Size());
+
+        if (status_code != 200 || buffer.Overflowed()) {
+            ESP_LOGE(TAG, "API returned non-200 status: %d", status_code);
+            result.error_body.assign(buffer.Data(), std::min(buffer.Size(), ERROR_BODY_BYTES));
+            buffer.Clear();
+            return false;
+        }
+
+        // 直接在缓冲区上流式解析：只取 choices[0].message.content 和 usage
+        CompletionHandler handler("message", result.content, usage);
+        JsonReader reader;
+        JsonParseError err = reader.Parse(buffer.Data(), buffer.Size(), handler);
+        buffer.Clear();
+        if (err != JsonParseError::NONE) {
+            ESP_LOGE(TAG, "Failed to parse response JSON at byte %zu", reader.ErrorOffset());
+            return false;
+        }
+        if (!handler.FoundContent()) {
+            ESP_LOGE(TAG, "Invalid response: no choices[0].message.content");
+            return false;
+        }
     }
-
-    cJSON *content = cJSON_GetObjectItem(message_obj, "content");
-
-    if (!content || !cJSON_IsString(content)) {
-        ESP_LOGE(TAG, "Invalid message content");
-        cJSON_Delete(response_json);
-        return false;
+    uint32_t latency_ms = result.latency_ms;
+
+    // usage：记录命中服务端前缀缓存的 token
+    int prompt_tokens = usage.prompt_tokens;
+    int cached_tokens = usage.cached_tokens;
+    result.tokens_used = usage.total_tokens;
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        cache_stats_.requests++;
+        cache_stats_.prompt_tokens += prompt_tokens;
+        cache_stats_.cached_tokens += cached_tokens;
+        if (cached_tokens > 0) {
+            cache_stats_.cache_hits++;
+            cache_stats_.hit_latency_ms += latency_ms;
+        } else {
+            cache_stats_.miss_latency_ms += latency_ms;
+        }
     }
 
-    response = content->valuestring;
-    cJSON_Delete(response_json);
+    TokenLedger::GetInstance().Record(purpose, prompt_tokens, usage.completion_tokens, cached_tokens);
 
-    ESP_LOGI(TAG, "GLM response received: %d bytes", response.length());
+    ESP_LOGI(TAG, "GLM response received: %d bytes, %u ms, prompt %d tokens (%d cached)",
+             result.content.length(), static_cast<unsigned>(latency_ms), prompt_tokens, cached_tokens);
     return true;
 }
 
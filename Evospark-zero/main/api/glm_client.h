@@ -2,11 +2,52 @@
 #define GLM_CLIENT_H
 
 #include <string>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <cstdint>
 #include <esp_http_client.h>
 #include <cJSON.h>
+#include "response_buffer.h"
+#include "request_queue.h"
+#include "token_ledger.h"
+#include "structured_output.h"
 
 namespace EvoSpark {
 
+// 前缀缓存统计（来自响应中的 usage.prompt_tokens_details.cached_tokens）
+struct PromptCacheStats {
+    uint32_t requests = 0;
+    uint32_t cache_hits = 0;          // cached_tokens > 0 的请求数
+    uint64_t prompt_tokens = 0;
+    uint64_t cached_tokens = 0;
+    uint64_t hit_latency_ms = 0;      // 命中请求的累计耗时
+    uint64_t miss_latency_ms = 0;     // 未命中请求的累计耗时
+};
+
+// 异步请求结果
+struct ChatResult {
+    bool success = false;
+    std::string content;
+    bool expired = false;        // 超过截止时间或队列满，请求没有发出
+    int tokens_used = 0;         // usage.total_tokens（提前断开的请求为估算值）
+    uint32_t latency_ms = 0;     // HTTP 请求耗时
+    int http_status = 0;         // 最后一次请求的状态码，网络错误为 -1
+    std::string error_body;      // 非 200 时响应体的开头（最多 ERROR_BODY_BYTES）
+};
+
+// GLM 客户端
+//
+// 请求都在 RequestQueue 的网络任务上执行：Submit 立即返回，结果经回调或
+// future 交付；同步的 Chat 只是提交后等待，仍按优先级排队。
+//
+// 带 schema 的请求要求结构化输出：请求体带 response_format 并改走流式，
+// 增量边到边交给 StructuredOutputValidator，违反约定立即断开连接。JSON
+// 前后的代码块标记和说明文字在本地剥离；本地无法挽回时才带着错误说明发一次
+// 修复请求。服务端对带 response_format 的请求返回 400 时，本次请求改为只靠
+// 提示词重发；错误信息点名 response_format，或连续几次去掉它才成功时，之后
+// 的请求都不再带（400 也可能是提示词过长、内容审核，不能一次就全局降级）。
 class GLMClient {
 public:
     static GLMClient& GetInstance() {
@@ -17,6 +58,36 @@ public:
     bool Init(const std::string& api_key);
     bool Chat(const std::string& message, std::string& response);
 
+    // system 放在最前且保持字节不变，便于服务端复用前缀缓存
+    bool Chat(const std::string& system, const std::string& message, std::string& response);
+
+    // 异步请求
+    struct Request {
+        std::string system;
+        std::string message;
+        RequestPriority priority = RequestPriority::INTERACTIVE;
+        uint32_t deadline_ms = 0;    // 从提交起算，含排队；0 表示只受 HTTP 超时约束
+        TokenPurpose purpose = TokenPurpose::CHAT;   // 记账用途
+        const JsonSchema* schema = nullptr;  // 非空时要求结构化输出，content 为校验过的 JSON
+    };
+    using ChatCallback = std::function<void(const ChatResult& result)>;
+
+    // 提交请求，结束时回调 done：在网络任务上执行，队列满被拒绝时在调用方
+    // 任务上立即执行
+    void Submit(Request request, ChatCallback done);
+
+    // 提交请求，结果经 future 交付
+    std::future<ChatResult> Submit(Request request);
+
+    // 前缀缓存统计
+    PromptCacheStats GetCacheStats() const;
+
+    // 结构化输出统计（失败率、修复次数、浪费的 token）
+    StructuredOutputStats GetStructuredOutputStats() const;
+
+    // 怎样向服务端要求结构化输出（默认 json_object）
+    void SetStructuredOutputMode(StructuredOutputMode mode) { structured_mode_.store(mode); }
+
     // 设置模型参数
     void SetMaxTokens(int max_tokens) { max_tokens_ = max_tokens; }
     void SetTemperature(float temperature) { temperature_ = temperature; }
@@ -25,11 +96,49 @@ private:
     GLMClient();
     ~GLMClient();
 
+    // 修复请求在原消息之后追加的两轮：上次的输出 + 问题说明
+    struct RepairTurn {
+        std::string output;
+        std::string instruction;
+    };
+
+    // 在网络任务上执行请求：结构化输出请求在这里校验，必要时发修复请求
+    bool Run(const Request& request, ChatResult& result, int timeout_ms);
+
+    // 执行一次请求，timeout_ms 已按截止时间收紧；回复、用量和耗时写入 result
+    // （success 由返回值给出），用量按 request.purpose 记账。validator 非空时
+    // 走流式并边收边校验，违反约定即断开连接
+    bool Execute(const Request& request, const RepairTurn* repair,
+                 StructuredOutputValidator* validator, StructuredOutputMode mode,
+                 ChatResult& result, int timeout_ms);
+
+    static constexpr int HTTP_TIMEOUT_MS = 60000;   // 60 秒（处理慢速网络）
+    static constexpr int ECONOMY_MAX_TOKENS = 400;  // 接近 token 预算时的对话回复上限
+    static constexpr int MAX_REPAIRS = 1;           // 结构化输出不合格时的修复请求次数
+    static constexpr size_t REPAIR_ECHO_BYTES = 2048;   // 修复请求里附带的上次输出上限
+    static constexpr int MIN_REPAIR_TIMEOUT_MS = 5000;  // 剩余时间不足时不再修复
+    static constexpr int FORMAT_REJECTIONS_TO_DOWNGRADE = 3;  // 连续几次才全局关掉 response_format
+    static constexpr size_t ERROR_BODY_BYTES = 512;     // 错误响应体保留的长度
+
+    // gzip：请求体压缩按端点协商，服务端不支持时自动退回明文；
+    // 压缩率和耗时见连接池的端点统计，Wi-Fi 不是瓶颈时可关掉省 CPU
+    static constexpr bool GZIP_REQUESTS = true;
+    static constexpr bool GZIP_RESPONSES = true;
+
     std::string api_key_;
     std::string api_url_;
     int max_tokens_ = 4096;
     float temperature_ = 0.7f;
+    std::atomic<StructuredOutputMode> structured_mode_{StructuredOutputMode::JSON_OBJECT};
+    std::atomic<int> format_rejections_{0};   // 连续被 400、去掉 response_format 后成功的次数
     bool is_initialized_ = false;
+
+    ResponseBuffer response_buffer_;     // 复用的响应缓冲区
+    std::mutex buffer_mutex_;
+
+    PromptCacheStats cache_stats_;
+    StructuredOutputStats structured_stats_;
+    mutable std::mutex stats_mutex_;
 };
 
 } // namespace EvoSpark
@@ -11,6 +11,8 @@ static const char* KEY_WIFI_SSID = "wifi_ssid";
 static const char* KEY_WIFI_PASS = "wifi_pass";
 static const char* KEY_API_KEY = "api_key";
 static const char* KEY_CONFIGURED = "configured";
+static const char* KEY_SESSION_BUDGET = "tok_session";
+static const char* KEY_DAILY_BUDGET = "tok_daily";
 
 ConfigManager::ConfigManager() : is_configured_(false) {
 }
@@ -71,6 +73,10 @@ esp_err_t ConfigManager::Init() {
             ESP_LOGI(TAG, "No configuration found");
         }
 
+        // token 预算（未设置时不限）
+        nvs_get_u32(nvs_handle, KEY_SESSION_BUDGET, &session_token_budget_);
+        nvs_get_u32(nvs_handle, KEY_DAILY_BUDGET, &daily_token_budget_);
+
         nvs_close(nvs_handle);
     } else {
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
@@ -149,6 +155,36 @@ esp_err_t ConfigManager::SetConfig(const std::string& ssid,
     return ESP_OK;
 }
 
+esp_err_t ConfigManager::SetTokenBudget(uint32_t session_tokens, uint32_t daily_tokens) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_u32(nvs_handle, KEY_SESSION_BUDGET, session_tokens);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs_handle, KEY_DAILY_BUDGET, daily_tokens);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save token budget: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    session_token_budget_ = session_tokens;
+    daily_token_budget_ = daily_tokens;
+    ESP_LOGI(TAG, "Token budget saved: session %u, daily %u",
+             static_cast<unsigned>(session_tokens), static_cast<unsigned>(daily_tokens));
+    return ESP_OK;
+}
+
 esp_err_t ConfigManager::ClearConfig() {
     ESP_LOGI(TAG, "Clearing configuration...");
 
@@ -165,6 +201,8 @@ esp_err_t ConfigManager::ClearConfig() {
     nvs_erase_key(nvs_handle, KEY_WIFI_PASS);
     nvs_erase_key(nvs_handle, KEY_API_KEY);
     nvs_erase_key(nvs_handle, KEY_CONFIGURED);
+    nvs_erase_key(nvs_handle, KEY_SESSION_BUDGET);
+    nvs_erase_key(nvs_handle, KEY_DAILY_BUDGET);
 
     // 提交
     err = nvs_commit(nvs_handle);
@@ -180,6 +218,8 @@ esp_err_t ConfigManager::ClearConfig() {
     wifi_ssid_.clear();
     wifi_password_.clear();
     api_key_.clear();
+    session_token_budget_ = 0;
+    daily_token_budget_ = 0;
     is_configured_ = false;
 
     ESP_LOGI(TAG, "Configuration cleared!");
@@ -24,10 +24,17 @@ public:
     std::string GetWifiPassword() const { return wifi_password_; }
     std::string GetApiKey() const { return api_key_; }
 
+    // token 预算（0 表示不限）
+    uint32_t GetSessionTokenBudget() const { return session_token_budget_; }
+    uint32_t GetDailyTokenBudget() const { return daily_token_budget_; }
+
     // 保存配置
     esp_err_t SetConfig(const std::string& ssid, const std::string& password,
                        const std::string& api_key);
 
+    // 保存 token 预算
+    esp_err_t SetTokenBudget(uint32_t session_tokens, uint32_t daily_tokens);
+
     // 清除配置（恢复出厂设置）
     esp_err_t ClearConfig();
 
@@ -38,6 +45,8 @@ private:
     std::string wifi_ssid_;
     std::string wifi_password_;
     std::string api_key_;
+    uint32_t session_token_budget_ = 0;
+    uint32_t daily_token_budget_ = 0;
     bool is_configured_;
 };
 
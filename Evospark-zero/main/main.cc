@@ -10,6 +10,9 @@
 #include <freertos/event_groups.h>
 #include <string.h>
 #include "memory/memory_manager.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "link_quality.h"
 #include "web/web_server.h"
 #include "config/config_manager.h"
 
@@ -261,6 +264,9 @@ void app_main(void) {
             esp_netif_destroy(sta_netif);
             is_ap_mode = true;
             init_wifi_ap();
+        } else {
+            // 链路估计：周期读 RSSI，请求结果由连接池报告
+            LinkQuality::GetInstance().Start();
         }
     } else {
         ESP_LOGI(TAG, "No configuration found, starting AP mode...");
@@ -295,6 +301,17 @@ void app_main(void) {
             } else {
                 ESP_LOGI(TAG, "Memory manager initialized successfully");
                 ESP_LOGI(TAG, "Free space: %d KB", memory_mgr.GetFreeSpace() / 1024);
+
+                // 回复缓存（Flash 已随记忆管理器挂载）
+                ResponseCache::GetInstance().Init("/spiffs/resp_cache.bin");
+
+                // token 记账与预算
+                TokenLedger& ledger = TokenLedger::GetInstance();
+                ledger.Init("/spiffs/token_ledger.bin");
+                TokenBudget budget;
+                budget.session_tokens = config.GetSessionTokenBudget();
+                budget.daily_tokens = config.GetDailyTokenBudget();
+                ledger.SetBudget(budget);
             }
         } else {
             ESP_LOGW(TAG, "API Key not configured, memory features disabled");
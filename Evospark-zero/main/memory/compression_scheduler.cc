@@ -0,0 +1,178 @@
+#include "compression_scheduler.h"
+#include <algorithm>
+#include "esp_log.h"
+
+namespace EvoSpark {
+
+static const char* TAG = "CompressionSched";
+
+// 增长速率平滑系数
+static const float GROWTH_ALPHA = 0.3f;
+
+const char* CompressionTriggerToString(CompressionTrigger trigger) {
+    switch (trigger) {
+        case CompressionTrigger::IDLE: return "idle";
+        case CompressionTrigger::TOKENS: return "tokens";
+        case CompressionTrigger::BUFFER: return "buffer";
+        default: return "none";
+    }
+}
+
+void CompressionScheduler::OnTurnStart(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_turns_ == 0) {
+        turn_start_ms_ = now_ms;
+        turn_overlapped_ = compressing_;
+    }
+    active_turns_++;
+    last_activity_ms_ = now_ms;
+}
+
+void CompressionScheduler::OnTurnEnd(int64_t now_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_turns_ == 0) {
+        return;
+    }
+    active_turns_--;
+    last_activity_ms_ = now_ms;
+    if (active_turns_ > 0) {
+        return;
+    }
+
+    uint32_t latency = static_cast<uint32_t>(std::max<int64_t>(0, now_ms - turn_start_ms_));
+    stats_.turns++;
+    total_latency_ms_ += latency;
+    stats_.avg_turn_latency_ms = static_cast<uint32_t>(total_latency_ms_ / stats_.turns);
+    stats_.max_turn_latency_ms = std::max(stats_.max_turn_latency_ms, latency);
+    if (turn_overlapped_ || compressing_) {
+        stats_.turns_overlapped++;
+    }
+}
+
+void CompressionScheduler::OnMessages(int64_t now_ms, size_t count, int tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_activity_ms_ = std::max(last_activity_ms_, now_ms);
+
+    // 旧策略：缓冲区每满 10 条压缩一次
+    legacy_pending_ += count;
+    while (legacy_pending_ >= LEGACY_BATCH) {
+        stats_.legacy_compressions++;
+        legacy_pending_ -= LEGACY_BATCH;
+    }
+
+    UpdateGrowth(now_ms);
+    growth_window_tokens_ += tokens;
+}
+
+void CompressionScheduler::UpdateGrowth(int64_t now_ms) {
+    // 按整分钟窗口累计新增 token，窗口结束时并入平滑速率（空窗口使速率衰减）
+    if (growth_window_start_ms_ == 0) {
+        growth_window_start_ms_ = now_ms;
+        return;
+    }
+    while (now_ms - growth_window_start_ms_ >= GROWTH_WINDOW_MS) {
+        growth_rate_ = GROWTH_ALPHA * growth_window_tokens_ + (1.0f - GROWTH_ALPHA) * growth_rate_;
+        growth_window_tokens_ = 0;
+        growth_window_start_ms_ += GROWTH_WINDOW_MS;
+    }
+    stats_.growth_tokens_per_min = static_cast<uint32_t>(growth_rate_);
+}
+
+int64_t CompressionScheduler::IdleThreshold() const {
+    // 增长越快，越早在间隙中合并，避免积压到缓冲区上限
+    if (growth_rate_ <= GROWTH_REFERENCE) {
+        return IDLE_MS;
+    }
+    int64_t threshold = static_cast<int64_t>(IDLE_MS * GROWTH_REFERENCE / growth_rate_);
+    return std::max(threshold, MIN_IDLE_MS);
+}
+
+CompressionTrigger CompressionScheduler::Evaluate(int64_t now_ms, size_t pending_messages,
+                                                  size_t pending_bytes, int pending_tokens,
+                                                  bool network_ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    UpdateGrowth(now_ms);
+    if (compressing_ || pending_messages < MIN_MESSAGES) {
+        return CompressionTrigger::NONE;
+    }
+
+    int64_t idle = now_ms - last_activity_ms_;
+    CompressionTrigger trigger = CompressionTrigger::NONE;
+    // 中文长回复按字节先到上限，两种都算
+    if (pending_messages >= BUFFER_HIGH_WATER || pending_bytes >= BUFFER_HIGH_WATER_BYTES) {
+        trigger = CompressionTrigger::BUFFER;
+    } else if (pending_tokens >= TOKEN_HIGH_WATER && idle >= SHORT_IDLE_MS) {
+        trigger = CompressionTrigger::TOKENS;
+    } else if (idle >= IdleThreshold()) {
+        trigger = CompressionTrigger::IDLE;
+    }
+
+    if (trigger == CompressionTrigger::NONE) {
+        return trigger;
+    }
+
+    // 对话进行中绝不压缩，等本轮结束
+    if (active_turns_ > 0) {
+        if (!deferred_logged_) {
+            stats_.deferred_turn++;
+            deferred_logged_ = true;
+        }
+        return CompressionTrigger::NONE;
+    }
+    // 积压到上限时不再等满指数退避，否则离线恢复后要隔很久才开始追赶
+    int64_t retry_after_ms = retry_after_ms_;
+    if (trigger == CompressionTrigger::BUFFER && retry_backoff_ms_ > RETRY_BASE_MS) {
+        retry_after_ms -= retry_backoff_ms_ - RETRY_BASE_MS;
+    }
+    if (now_ms < retry_after_ms) {
+        return CompressionTrigger::NONE;
+    }
+    if (!network_ok) {
+        if (!deferred_logged_) {
+            stats_.deferred_network++;
+            deferred_logged_ = true;
+        }
+        return CompressionTrigger::NONE;
+    }
+
+    deferred_logged_ = false;
+    ESP_LOGI(TAG, "Compression triggered by %s: %zu messages, %zu bytes, %d tokens, idle %lld ms",
+             CompressionTriggerToString(trigger), pending_messages, pending_bytes, pending_tokens,
+             static_cast<long long>(idle));
+    return trigger;
+}
+
+void CompressionScheduler::OnCompressionStart() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    compressing_ = true;
+    if (active_turns_ > 0) {
+        turn_overlapped_ = true;
+    }
+}
+
+void CompressionScheduler::OnCompressionEnd(int64_t now_ms, bool success) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    compressing_ = false;
+
+    if (success) {
+        stats_.compressions++;
+        retry_backoff_ms_ = 0;
+        retry_after_ms_ = 0;
+        return;
+    }
+
+    stats_.failures++;
+    retry_backoff_ms_ = (retry_backoff_ms_ == 0)
+        ? RETRY_BASE_MS
+        : std::min(retry_backoff_ms_ * 2, RETRY_MAX_MS);
+    retry_after_ms_ = now_ms + retry_backoff_ms_;
+    ESP_LOGW(TAG, "Compression failed, retry in %lld ms",
+             static_cast<long long>(retry_backoff_ms_));
+}
+
+SchedulerStats CompressionScheduler::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} // namespace EvoSpark
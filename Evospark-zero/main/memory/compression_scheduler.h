@@ -0,0 +1,100 @@
+#ifndef COMPRESSION_SCHEDULER_H
+#define COMPRESSION_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace EvoSpark {
+
+// 触发原因
+enum class CompressionTrigger {
+    NONE,
+    IDLE,       // 对话空闲，且有待合并内容
+    TOKENS,     // 待合并 token 过多，短暂空闲即压缩
+    BUFFER,     // 缓冲区接近一次压缩的上限（条数或字节）
+};
+
+const char* CompressionTriggerToString(CompressionTrigger trigger);
+
+// 调度统计
+struct SchedulerStats {
+    uint32_t compressions;          // 实际执行的压缩次数
+    uint32_t failures;              // 失败次数
+    uint32_t legacy_compressions;   // 按旧策略（每 10 条一次）应执行的次数
+    uint32_t deferred_turn;         // 因对话进行中推迟的次数
+    uint32_t deferred_network;      // 因网络不可用推迟的次数
+    uint32_t turns;                 // 对话轮数
+    uint32_t turns_overlapped;      // 与压缩重叠的轮数
+    uint32_t avg_turn_latency_ms;   // 平均对话延迟
+    uint32_t max_turn_latency_ms;   // 最大对话延迟
+    uint32_t growth_tokens_per_min; // 待合并 token 增长速率（平滑）
+};
+
+// 自适应压缩调度器
+//
+// 不再按固定条数触发，而是在对话间隙合并：
+// - 对话进行中（用户消息到回复发出之间）从不触发；
+// - 空闲超过阈值且有待合并消息时触发，增长越快阈值越短；
+// - 待合并 token 过多时只需短暂空闲；缓冲区接近上限时立即触发；
+// - 网络不可用或上次失败时按指数退避推迟（缓冲区接近上限时退避不超过
+//   RETRY_BASE_MS）。
+// 期间到达的新消息都并入同一次压缩。时间由调用方传入（毫秒）。
+class CompressionScheduler {
+public:
+    CompressionScheduler() = default;
+
+    // 对话轮次开始 / 结束（结束时记录用户感知的延迟）
+    void OnTurnStart(int64_t now_ms);
+    void OnTurnEnd(int64_t now_ms);
+
+    // 新消息进入缓冲区
+    void OnMessages(int64_t now_ms, size_t count, int tokens);
+
+    // 判断此刻是否应当压缩
+    CompressionTrigger Evaluate(int64_t now_ms, size_t pending_messages,
+                                size_t pending_bytes, int pending_tokens, bool network_ok);
+
+    // 压缩开始 / 结束
+    void OnCompressionStart();
+    void OnCompressionEnd(int64_t now_ms, bool success);
+
+    SchedulerStats GetStats() const;
+
+    static constexpr int64_t IDLE_MS = 60000;           // 默认空闲阈值
+    static constexpr int64_t MIN_IDLE_MS = 20000;       // 高增长时的最短空闲阈值
+    static constexpr int64_t SHORT_IDLE_MS = 3000;      // token 过多时的空闲阈值
+    static constexpr int TOKEN_HIGH_WATER = 2000;       // 待合并 token 上限
+    static constexpr size_t BUFFER_HIGH_WATER = 32;     // 缓冲区条数上限（一批最多 40 条）
+    static constexpr size_t BUFFER_HIGH_WATER_BYTES = 12288;  // 缓冲区字节上限（一批最多 16 KB）
+    static constexpr size_t MIN_MESSAGES = 2;           // 至少一问一答
+    static constexpr int GROWTH_REFERENCE = 300;        // 参考增长速率（token/分钟）
+    static constexpr int64_t GROWTH_WINDOW_MS = 60000;  // 增长速率统计窗口
+    static constexpr int64_t RETRY_BASE_MS = 30000;     // 失败后的首次退避
+    static constexpr int64_t RETRY_MAX_MS = 600000;     // 退避上限
+    static constexpr size_t LEGACY_BATCH = 10;          // 旧策略的触发条数
+
+private:
+    int64_t IdleThreshold() const;
+    void UpdateGrowth(int64_t now_ms);
+
+    mutable std::mutex mutex_;
+    int active_turns_ = 0;
+    bool compressing_ = false;
+    bool turn_overlapped_ = false;
+    int64_t turn_start_ms_ = 0;
+    int64_t last_activity_ms_ = 0;
+    int64_t retry_after_ms_ = 0;
+    int64_t retry_backoff_ms_ = 0;
+    int64_t growth_window_start_ms_ = 0;
+    int growth_window_tokens_ = 0;    // 当前窗口内新增 token
+    float growth_rate_ = 0.0f;        // token/分钟，按窗口指数平滑
+    uint64_t total_latency_ms_ = 0;
+    size_t legacy_pending_ = 0;       // 旧策略下距上次触发累计的条数
+    bool deferred_logged_ = false;    // 同一段推迟只计一次
+    SchedulerStats stats_ = {};
+};
+
+} // namespace EvoSpark
+
+#endif // COMPRESSION_SCHEDULER_H
@@ -1,12 +1,25 @@
 #include "conversation_buffer.h"
+#include "json_codec.h"
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <algorithm>
 
 namespace EvoSpark {
 
 static const char* TAG = "ConvBuffer";
 
+std::string Message::to_json() const {
+    std::string json;
+    JsonWriteTo(json, [this](auto& w) {
+        w.BeginObject();
+        w.Field("role", role);
+        w.Field("content", content);
+        w.EndObject();
+    });
+    return json;
+}
+
 ConversationBuffer::ConversationBuffer() : current_size_(0) {
 }
 
@@ -32,26 +45,28 @@ void ConversationBuffer::Add(const std::string& role, const std::string& content
     msg.content = content;
     msg.timestamp = ss.str();
 
-    // 添加到缓冲区
-    messages_.push_back(msg);
-    current_size_ += role.length() + content.length() + 20;  // 估算大小
+    // 添加到缓冲区（不裁剪，未压缩的消息一直保留）
+    current_size_ += SizeOf(msg);
+    messages_.push_back(std::move(msg));
 
     ESP_LOGD(TAG, "Added message: role=%s, size=%d, total=%d/%d",
              role.c_str(), content.length(), current_size_, MAX_SIZE_BYTES);
+}
 
-    // 检查是否需要裁剪
-    TrimIfNeeded();
+size_t ConversationBuffer::SizeOf(const Message& msg) {
+    return msg.role.length() + msg.content.length() + 20;  // 估算大小
 }
 
-std::string ConversationBuffer::GetAsString() const {
-    if (messages_.empty()) {
+std::string ConversationBuffer::GetAsString(uint32_t end_seq) const {
+    size_t count = std::min<size_t>(messages_.size(), end_seq - first_seq_);
+    if (count == 0) {
         return "";
     }
 
     std::stringstream ss;
     ss << "对话记录：\n\n";
 
-    for (size_t i = 0; i < messages_.size(); i++) {
+    for (size_t i = 0; i < count; i++) {
         const Message& msg = messages_[i];
         std::string role_name = (msg.role == "user") ? "用户" : "助手";
         ss << role_name << ": " << msg.content << "\n";
@@ -76,6 +91,7 @@ std::string ConversationBuffer::GetLastN(size_t n) const {
 }
 
 void ConversationBuffer::Clear() {
+    first_seq_ += messages_.size();
     messages_.clear();
     current_size_ = 0;
     ESP_LOGI(TAG, "Conversation buffer cleared");
@@ -93,29 +109,34 @@ size_t ConversationBuffer::GetSize() const {
     return current_size_;
 }
 
-void ConversationBuffer::TrimIfNeeded() {
-    bool trimmed = false;
-
-    // 1. 检查消息数量
-    while (messages_.size() > MAX_MESSAGES) {
-        current_size_ -= messages_.front().role.length() +
-                       messages_.front().content.length() + 20;
-        messages_.pop_front();
-        trimmed = true;
+void ConversationBuffer::DropBefore(uint32_t seq) {
+    while (!messages_.empty() && static_cast<int32_t>(first_seq_ - seq) < 0) {
+        PopFront();
     }
+}
 
-    // 2. 检查字节大小
-    while (current_size_ > MAX_SIZE_BYTES && !messages_.empty()) {
-        current_size_ -= messages_.front().role.length() +
-                       messages_.front().content.length() + 20;
-        messages_.pop_front();
-        trimmed = true;
+uint32_t ConversationBuffer::BatchEnd() const {
+    size_t count = 0;
+    size_t bytes = 0;
+    while (count < messages_.size() && count < MAX_MESSAGES) {
+        bytes += SizeOf(messages_[count]);
+        if (count > 0 && bytes > MAX_SIZE_BYTES) {
+            break;
+        }
+        count++;
     }
+    return first_seq_ + count;
+}
 
-    if (trimmed) {
-        ESP_LOGW(TAG, "Buffer trimmed: %d messages, %d bytes",
-                  messages_.size(), current_size_);
-    }
+std::vector<Message> ConversationBuffer::GetMessagesBefore(uint32_t end_seq) const {
+    size_t count = std::min<size_t>(messages_.size(), end_seq - first_seq_);
+    return std::vector<Message>(messages_.begin(), messages_.begin() + count);
+}
+
+void ConversationBuffer::PopFront() {
+    current_size_ -= SizeOf(messages_.front());
+    messages_.pop_front();
+    first_seq_++;
 }
 
 } // namespace EvoSpark
@@ -14,16 +14,20 @@ struct Message {
     std::string content;
     std::string timestamp;
 
-    std::string to_json() const {
-        return "{\"role\":\"" + role + "\",\"content\":\"" + content + "\"}";
-    }
+    std::string to_json() const;
 };
 
 // 对话缓冲区
+//
+// 消息只在压缩成功（DropBefore）或转存到归档（同样经 DropBefore）后离开，
+// 缓冲区自己不裁剪。一次压缩最多取 MAX_MESSAGES 条 / MAX_SIZE_BYTES 字节，
+// 其余留给下一次；积压超过 SPILL_SIZE_BYTES（长时间离线）时由调用方把最早的
+// 一批转存到 Flash
 class ConversationBuffer {
 public:
-    static const size_t MAX_MESSAGES = 20;      // 最多保留 20 条消息
-    static const size_t MAX_SIZE_BYTES = 10240;   // 最大 10 KB
+    static const size_t MAX_MESSAGES = 40;        // 一次压缩最多 40 条消息
+    static const size_t MAX_SIZE_BYTES = 16384;   // 一次压缩最多 16 KB
+    static const size_t SPILL_SIZE_BYTES = 65536; // 超过 64 KB 开始转存
 
     ConversationBuffer();
     ~ConversationBuffer();
@@ -33,12 +37,17 @@ public:
     // 添加消息
     void Add(const std::string& role, const std::string& content);
 
-    // 获取所有消息的 JSON 格式
-    std::string GetAsString() const;
+    // 获取序号小于 end_seq 的消息的文本形式
+    std::string GetAsString(uint32_t end_seq) const;
 
     // 获取最近 N 条消息
     std::string GetLastN(size_t n) const;
 
+    // 获取所有消息（按时间顺序）
+    std::vector<Message> GetMessages() const {
+        return std::vector<Message>(messages_.begin(), messages_.end());
+    }
+
     // 清空缓冲区
     void Clear();
 
@@ -51,11 +60,29 @@ public:
     // 获取当前大小（字节）
     size_t GetSize() const;
 
+    // 消息序号：每条消息加入时编号，EndSequence 为下一条消息的序号
+    uint32_t EndSequence() const { return first_seq_ + messages_.size(); }
+
+    // 最早的一批（不超过 MAX_MESSAGES 条、MAX_SIZE_BYTES 字节，至少一条）之后
+    // 第一条消息的序号
+    uint32_t BatchEnd() const;
+
+    // 序号小于 end_seq 的消息（按时间顺序）
+    std::vector<Message> GetMessagesBefore(uint32_t end_seq) const;
+
+    // 积压过多，需要转存
+    bool NeedsSpill() const { return current_size_ > SPILL_SIZE_BYTES; }
+
+    // 移除序号小于 seq 的消息（已压缩的一批；期间新到的消息保留）
+    void DropBefore(uint32_t seq);
+
 private:
     std::deque<Message> messages_;
     size_t current_size_;
+    uint32_t first_seq_ = 0;     // messages_.front() 的序号
 
-    void TrimIfNeeded();  // 超出限制时自动裁剪
+    static size_t SizeOf(const Message& msg);
+    void PopFront();
 };
 
 } // namespace EvoSpark
@@ -1,28 +1,79 @@
 #include "memory_manager.h"
+#include "psram_allocator.h"
+#include "prompt_template.h"
 #include <cstring>
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_wifi.h"
+#include "cJSON.h"
+#include "json_codec.h"
 
 namespace EvoSpark {
 
 static const char* TAG = "MemoryManager";
 static const size_t MAX_MEMORY_SIZE = 10240;  // 10 KB 上限
-static const int COMPRESSION_QUEUE_SIZE = 5;  // 队列大小
+static const size_t MESSAGE_POOL_SLOTS = 32;   // 预分配消息槽
+static const int SCHEDULER_TICK_MS = 1000;     // 无消息时评估调度的间隔
+static const int MIN_NETWORK_RSSI = -85;       // 低于该信号强度时推迟压缩
+static const size_t RETRIEVAL_TOP_K = 6;       // 每轮最多注入的记忆条数
+static const int RETRIEVAL_TOKEN_BUDGET = 300; // 每轮注入记忆的 token 上限
+
+// 压缩结果的结构（与压缩提示词要求的字段一致），压缩请求按它要求 JSON 输出
+// 并边收边校验；version 有的模型写成数字，不限类型
+static const JsonSchemaField kMemoryFields[] = {
+    {"version", JsonType::ANY, false, JsonType::ANY},
+    {"metadata", JsonType::OBJECT, true, JsonType::ANY},
+    {"user_profile", JsonType::OBJECT, true, JsonType::ANY},
+    {"memories", JsonType::ARRAY, true, JsonType::OBJECT},
+    {"recent_context", JsonType::OBJECT, true, JsonType::ANY},
+};
+static const JsonSchema kMemorySchema = {
+    "memory_package", kMemoryFields, sizeof(kMemoryFields) / sizeof(kMemoryFields[0]),
+    MAX_MEMORY_SIZE,
+};
+static const char* ARCHIVE_PARTITION = "archive";
+static const char* ARCHIVE_MOUNT = "/archive";
+static const char* ARCHIVE_DIR = "/archive/sessions";
+
+// 记忆压缩系统提示：固定不变，作为请求前缀（可命中服务端前缀缓存）
+static const char kCompressionSystemPrompt[] = R"(你是 Evo-spark 智能陪伴机器人的记忆管理系统。
+
+你的任务：将旧记忆和新对话合并，生成压缩后的新记忆包。
+
+请生成新的记忆包，要求：
+1. 保留所有重要用户信息和偏好
+2. 合并相似记忆，删除冗余
+3. 新记忆包格式必须是 JSON
+4. 总大小不超过 5KB
+5. 使用简洁的语言和短描述
+6. 包含完整的 version, metadata, user_profile, memories, recent_context 字段
+7. metadata.total_memories 表示记忆项总数
+8. 记忆重要性评分（0.0-1.0）
+9. 只返回 JSON，不要其他说明文字。)";
+
+// 记忆压缩用户消息：{{0}} 旧记忆 JSON  {{1}} 新对话
+PROMPT_TEMPLATE(kCompressionPrompt, R"(旧记忆（JSON格式）：{{0}}
+
+新对话：{{1}})");
 
 MemoryManager::MemoryManager() : glm_client_(nullptr),
-                              compression_queue_(nullptr),
-                              compression_task_(nullptr) {
+                              session_archive_(ARCHIVE_DIR),
+                              compression_task_(nullptr),
+                              snapshot_(std::make_shared<const MemorySnapshot>()) {
 }
 
 MemoryManager::~MemoryManager() {
     if (compression_task_ != nullptr) {
         vTaskDelete(compression_task_);
     }
-    if (compression_queue_ != nullptr) {
-        vQueueDelete(compression_queue_);
+    while (pending_head_ != nullptr) {
+        PooledMessage* msg = pending_head_;
+        pending_head_ = msg->next;
+        message_pool_.Release(msg);
     }
 }
 
@@ -36,6 +87,20 @@ bool MemoryManager::Init(const std::string& api_key) {
     // 初始化对话缓冲区
     conversation_buffer_.Init();
 
+    // 对话归档（独立 FAT 分区，失败不影响记忆功能）
+    archive_ready_ = flash_storage_.MountFat(ARCHIVE_PARTITION, ARCHIVE_MOUNT) &&
+                     session_archive_.Init();
+    if (!archive_ready_) {
+        ESP_LOGW(TAG, "Conversation archive unavailable");
+    }
+
+    // 启动时读取一次 Flash，之后所有读者只访问快照
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex_);
+        PublishSnapshot(flash_storage_.ReadMemory());
+    }
+    RebuildIndex();
+
     // 初始化 GLM 客户端
     glm_client_ = &GLMClient::GetInstance();
     if (!glm_client_->Init(api_key)) {
@@ -43,10 +108,8 @@ bool MemoryManager::Init(const std::string& api_key) {
         return false;
     }
 
-    // 创建压缩队列
-    compression_queue_ = xQueueCreate(COMPRESSION_QUEUE_SIZE, sizeof(CompressionTask));
-    if (compression_queue_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to create compression queue");
+    // 消息池（待处理链表只传递 PooledMessage 指针）
+    if (!message_pool_.Init(MESSAGE_POOL_SLOTS)) {
         return false;
     }
 
@@ -61,8 +124,7 @@ bool MemoryManager::Init(const std::string& api_key) {
     );
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create compression task");
-        vQueueDelete(compression_queue_);
-        compression_queue_ = nullptr;
+        compression_task_ = nullptr;
         return false;
     }
 
@@ -73,21 +135,29 @@ bool MemoryManager::Init(const std::string& api_key) {
 
 void MemoryManager::AddConversation(const std::string& role,
                                   const std::string& content) {
-    if (!is_initialized_ || compression_queue_ == nullptr) {
+    if (!is_initialized_ || compression_task_ == nullptr) {
         return;
     }
 
-    // 将字符串复制到固定长度数组
-    CompressionTask task;
-    memset(&task, 0, sizeof(task));
-
-    snprintf(task.role, MAX_ROLE_LEN, "%s", role.c_str());
-    snprintf(task.content, MAX_CONTENT_LEN, "%s", content.c_str());
+    // 槽用尽时池子已经退回堆分配，这里拿不到说明内存耗尽（池子记入 dropped）
+    PooledMessage* msg = message_pool_.Acquire(role, content);
+    if (msg == nullptr) {
+        ESP_LOGE(TAG, "Out of memory, %s message not added to memory", role.c_str());
+        return;
+    }
 
-    // 将任务放入队列
-    if (xQueueSend(compression_queue_, &task, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW(TAG, "Compression queue full, task dropped");
+    // 挂到待处理链表尾部，所有权交给压缩任务。调用方可能是网络任务（回复
+    // 完成时记录对话），这里既不等待也不丢弃
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if (pending_tail_ != nullptr) {
+            pending_tail_->next = msg;
+        } else {
+            pending_head_ = msg;
+        }
+        pending_tail_ = msg;
     }
+    xTaskNotifyGive(compression_task_);
 }
 
 // 静态任务函数
@@ -96,51 +166,193 @@ void MemoryManager::CompressionTaskWrapper(void* arg) {
     manager->ProcessCompressionTask();
 }
 
+void MemoryManager::DrainPendingMessages() {
+    // 整条链表一次取下，处理时不持锁
+    PooledMessage* msg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        msg = pending_head_;
+        pending_head_ = nullptr;
+        pending_tail_ = nullptr;
+    }
+
+    size_t batch = 0;
+    int tokens = 0;
+    while (msg != nullptr) {
+        PooledMessage* next = msg->next;
+        if (conversation_buffer_.IsEmpty()) {
+            batch_start_time_ = std::time(nullptr);
+        }
+        std::string content(msg->content, msg->length);
+        tokens += MemoryIndex::EstimateTokens(content);
+        conversation_buffer_.Add(msg->role, content);
+        message_pool_.Release(msg);
+        batch++;
+        msg = next;
+    }
+
+    if (batch > 0) {
+        pending_tokens_ += tokens;
+        scheduler_.OnMessages(esp_timer_get_time() / 1000, batch, tokens);
+        ESP_LOGD(TAG, "Drained %zu messages, %d tokens", batch, tokens);
+    }
+}
+
 void MemoryManager::ProcessCompressionTask() {
     ESP_LOGI(TAG, "Compression task started");
 
-    CompressionTask task;
     while (true) {
-        // 从队列获取任务
-        if (xQueueReceive(compression_queue_, &task, portMAX_DELAY) == pdTRUE) {
-            // 添加到buffer
-            std::string role_str(task.role);
-            std::string content_str(task.content);
-            conversation_buffer_.Add(role_str, content_str);
-
-            // 只在缓冲区达到 10 条对话时才压缩记忆
-            // 这样可以避免每次消息都触发 GLM API 调用
-            if (conversation_buffer_.GetCount() >= 10) {
-                UpdateMemory();
-            }
-
-            // 给其他任务让出 CPU
-            vTaskDelay(pdMS_TO_TICKS(10));
+        // 新消息和压缩结果都会通知；超时也要评估一次（空闲触发）
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SCHEDULER_TICK_MS));
+        DrainPendingMessages();
+
+        bool result_ready = false;
+        {
+            std::lock_guard<std::mutex> lock(result_mutex_);
+            result_ready = result_ready_;
+            result_ready_ = false;
+        }
+        if (result_ready) {
+            FinishCompression();
+        }
+        if (compression_in_flight_) {
+            continue;
+        }
+        SpillIfNeeded();
+
+        // 由调度器决定是否在此刻压缩（期间的新消息留给下一次）
+        CompressionTrigger trigger = scheduler_.Evaluate(
+            esp_timer_get_time() / 1000, conversation_buffer_.GetCount(),
+            conversation_buffer_.GetSize(), pending_tokens_, IsNetworkAvailable());
+        if (trigger == CompressionTrigger::NONE) {
+            continue;
+        }
+
+        scheduler_.OnCompressionStart();
+        if (!StartCompression()) {
+            scheduler_.OnCompressionEnd(esp_timer_get_time() / 1000, false);
         }
     }
 }
 
+int MemoryManager::EstimateTokens(const std::vector<Message>& messages) {
+    int tokens = 0;
+    for (const auto& msg : messages) {
+        tokens += MemoryIndex::EstimateTokens(msg.content);
+    }
+    return tokens;
+}
+
+void MemoryManager::SpillIfNeeded() {
+    // 长时间压缩不了（离线、持续失败）时缓冲区会一直涨；超过转存上限后把
+    // 最早的一批原样写进对话归档再移出缓冲区，内容留在 Flash 上，不丢弃。
+    // 归档不可用时只能继续留在内存里
+    while (conversation_buffer_.NeedsSpill() && archive_ready_) {
+        uint32_t end_seq = conversation_buffer_.BatchEnd();
+        std::vector<Message> batch = conversation_buffer_.GetMessagesBefore(end_seq);
+        if (session_archive_.Append(batch_start_time_, std::time(nullptr),
+                                    ArchivePayload(batch, "")) == 0) {
+            ESP_LOGE(TAG, "Failed to spill %zu messages, keeping them in memory", batch.size());
+            return;
+        }
+        conversation_buffer_.DropBefore(end_seq);
+        pending_tokens_ = std::max(pending_tokens_ - EstimateTokens(batch), 0);
+        batch_start_time_ = std::time(nullptr);
+        ESP_LOGW(TAG, "Spilled %zu uncompressed messages to archive, %zu bytes left",
+                 batch.size(), conversation_buffer_.GetSize());
+    }
+}
+
+void MemoryManager::BeginTurn() {
+    scheduler_.OnTurnStart(esp_timer_get_time() / 1000);
+}
+
+void MemoryManager::EndTurn() {
+    scheduler_.OnTurnEnd(esp_timer_get_time() / 1000);
+}
+
+bool MemoryManager::IsNetworkAvailable() {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return false;
+    }
+    return ap_info.rssi >= MIN_NETWORK_RSSI;
+}
+
 void MemoryManager::OnTimerCallback() {
     // 静默定时器已移除
 }
 
-bool MemoryManager::UpdateMemory() {
-    // 1. 读取旧记忆
-    MemoryPackage old_memory = flash_storage_.ReadMemory();
-
-    // 2. 获取新对话
-    std::string new_conversations = conversation_buffer_.GetAsString();
+bool MemoryManager::StartCompression() {
+    // 1. 旧记忆（当前快照，LLM 调用期间不持锁）和本批对话（最早的一批，
+    //    积压更多时其余留给下一次）
+    compression_base_ = GetSnapshot();
+    compression_end_seq_ = conversation_buffer_.BatchEnd();
+    compression_batch_ = conversation_buffer_.GetMessagesBefore(compression_end_seq_);
+    compression_batch_start_ = batch_start_time_;
+    compression_started_ = std::time(nullptr);
+    compression_tokens_ = EstimateTokens(compression_batch_);
+    std::string new_conversations = conversation_buffer_.GetAsString(compression_end_seq_);
 
     ESP_LOGI(TAG, "Compressing memory: old_size=%d, new_size=%d",
-             old_memory.raw_json.length(), new_conversations.length());
+             compression_base_->memory.raw_json.length(), new_conversations.length());
+
+    // 2. 构造 prompt（编译期模板，一次分配）
+    GLMClient::Request request;
+    request.system = kCompressionSystemPrompt;
+    RenderTemplate(kCompressionPrompt, request.message, [&](int slot, auto& sink) {
+        sink.Append(slot == 0 ? compression_base_->memory.raw_json : new_conversations);
+    });
+    request.priority = RequestPriority::BACKGROUND;
+    request.purpose = TokenPurpose::COMPRESSION;
+    request.schema = &kMemorySchema;
+
+    ESP_LOGD(TAG, "Sending to GLM: %d bytes", request.message.length());
+
+    // 3. 交给网络任务；结果写入 compression_result_ 后通知压缩任务
+    compression_in_flight_ = true;
+    glm_client_->Submit(std::move(request), [this](const ChatResult& result) {
+        {
+            std::lock_guard<std::mutex> lock(result_mutex_);
+            compression_result_ = result;
+            result_ready_ = true;
+        }
+        xTaskNotifyGive(compression_task_);
+    });
+    return true;
+}
+
+void MemoryManager::FinishCompression() {
+    ChatResult result;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        result = std::move(compression_result_);
+        compression_result_ = ChatResult();
+    }
+    compression_in_flight_ = false;
+
+    bool success = false;
+    if (!result.success) {
+        ESP_LOGE(TAG, "GLM API call failed%s", result.expired ? " (not sent)" : "");
+    } else {
+        success = CommitCompression(result.content);
+    }
+
+    compression_base_.reset();
+    compression_batch_.clear();
+    scheduler_.OnCompressionEnd(esp_timer_get_time() / 1000, success);
+}
 
-    // 3. 调用 GLM API 压缩记忆
+bool MemoryManager::CommitCompression(const std::string& response) {
     MemoryPackage new_memory;
-    if (!CompressMemory(old_memory, new_conversations, new_memory)) {
+    if (!ParseCompressionResponse(response, new_memory)) {
         ESP_LOGE(TAG, "Failed to compress memory");
         return false;
     }
 
+    // 解析结构化字段（归档摘要使用 recent_context）
+    new_memory.from_json(new_memory.raw_json);
+
     // 4. 验证大小
     if (!ValidateMemorySize(new_memory.raw_json)) {
         ESP_LOGE(TAG, "Compressed memory too large: %d bytes (max: %d)",
@@ -148,7 +360,12 @@ bool MemoryManager::UpdateMemory() {
         return false;
     }
 
-    // 5. 写入 Flash
+    // 5. 写入 Flash（压缩期间发生回滚时放弃本次结果，对话留待下次合并）
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+    if (GetSnapshot()->generation != compression_base_->generation) {
+        ESP_LOGW(TAG, "Memory changed during compression, discarding result");
+        return false;
+    }
     if (!flash_storage_.WriteMemory(new_memory)) {
         ESP_LOGE(TAG, "Failed to write memory to flash");
         return false;
@@ -157,113 +374,208 @@ bool MemoryManager::UpdateMemory() {
     ESP_LOGI(TAG, "Memory updated successfully, new_size=%d bytes",
              new_memory.raw_json.length());
 
-    // 6. 清空缓冲区
-    conversation_buffer_.Clear();
+    PublishSnapshot(new_memory);
+    RebuildIndex();
+
+    // 6. 归档本批对话，只移除本批；压缩期间新到的消息留给下一次
+    ArchiveConversations(compression_batch_, compression_batch_start_,
+                         new_memory.recent_context.last_topic);
+    conversation_buffer_.DropBefore(compression_end_seq_);
+    pending_tokens_ = std::max(pending_tokens_ - compression_tokens_, 0);
+    if (!conversation_buffer_.IsEmpty()) {
+        batch_start_time_ = compression_started_;
+    }
 
     return true;
 }
 
-bool MemoryManager::CompressMemory(const MemoryPackage& old_memory,
-                                  const std::string& new_conversations,
-                                  MemoryPackage& new_memory) {
-    // 构造 prompt
-    std::string prompt = R"(你是 Evo-spark 智能陪伴机器人的记忆管理系统。
+bool MemoryManager::ParseCompressionResponse(const std::string& reply,
+                                            MemoryPackage& new_memory) {
+    // GLMClient 已取出 choices[0].message.content，并按 kMemorySchema 校验、
+    // 剥离了代码块标记；这里只确认是完整的 JSON 对象
+    ESP_LOGD(TAG, "GLM response: %s", reply.c_str());
 
-你的任务：将旧记忆和新对话合并，生成压缩后的新记忆包。
+    if (reply.empty()) {
+        ESP_LOGE(TAG, "GLM API returned empty response");
+        return false;
+    }
 
-旧记忆（JSON格式）：)" + old_memory.raw_json + R"(
+    cJSON *json = cJSON_ParseWithLength(reply.c_str(), reply.length());
+    if (!json || !cJSON_IsObject(json)) {
+        ESP_LOGE(TAG, "Compressed memory is not a JSON object: %.*s",
+                 static_cast<int>(std::min<size_t>(reply.length(), 200)), reply.c_str());
+        cJSON_Delete(json);
+        return false;
+    }
+    cJSON_Delete(json);
 
-新对话：)" + new_conversations + R"(
+    new_memory.raw_json = reply;
+    ESP_LOGI(TAG, "Received compressed memory: %d bytes", new_memory.raw_json.length());
+    return true;
+}
 
-请生成新的记忆包，要求：
-1. 保留所有重要用户信息和偏好
-2. 合并相似记忆，删除冗余
-3. 新记忆包格式必须是 JSON
-4. 总大小不超过 5KB
-5. 使用简洁的语言和短描述
-6. 包含完整的 version, metadata, user_profile, memories, recent_context 字段
-7. metadata.total_memories 表示记忆项总数
-8. 记忆重要性评分（0.0-1.0）
-9. 只返回 JSON，不要其他说明文字。)";
+bool MemoryManager::ValidateMemorySize(const std::string& json) {
+    return json.length() <= MAX_MEMORY_SIZE;
+}
 
-    ESP_LOGD(TAG, "Sending to GLM: %d bytes", prompt.length());
+MemorySnapshotPtr MemoryManager::GetSnapshot() const {
+    return snapshot_.Load();
+}
 
-    // 调用 GLM API
-    std::string response;
-    if (!glm_client_->Chat(prompt, response)) {
-        ESP_LOGE(TAG, "GLM API call failed");
-        return false;
-    }
+void MemoryManager::PublishSnapshot(const MemoryPackage& memory) {
+    uint32_t generation = is_initialized_ ? GetSnapshot()->generation + 1 : 0;
 
-    // 记录响应内容（用于调试）
-    ESP_LOGD(TAG, "GLM response: %s", response.c_str());
+    auto snapshot = std::allocate_shared<MemorySnapshot>(PsramAllocator<MemorySnapshot>());
+    snapshot->memory = memory;
+    snapshot->generation = generation;
+    snapshot_.Store(std::move(snapshot));
 
-    // 验证响应非空
-    if (response.empty()) {
-        ESP_LOGE(TAG, "GLM API returned empty response");
-        return false;
+    ESP_LOGI(TAG, "Memory snapshot published: generation %u",
+             static_cast<unsigned>(generation));
+}
+
+void MemoryManager::PublishRestored(const std::string& json) {
+    MemoryPackage memory;
+    memory.raw_json = json;
+    if (!memory.from_json(json)) {
+        ESP_LOGW(TAG, "Restored memory is not valid JSON");
     }
+    PublishSnapshot(memory);
+}
 
-    // 清理响应中的 Markdown 代码块标记
-    if (response.find("```json") == 0) {
-        size_t end = response.rfind("```");
-        if (end != std::string::npos) {
-            response = response.substr(7, end - 7);
+void MemoryManager::RebuildIndex() {
+    MemorySnapshotPtr snapshot = GetSnapshot();
+    const MemoryPackage& memory = snapshot->memory;
+
+    // 用户画像和最近话题很短，每轮都带上
+    std::stringstream pinned;
+    const UserProfile& profile = memory.user_profile;
+    if (!profile.name.empty()) pinned << "姓名：" << profile.name << "\n";
+    if (!profile.age.empty()) pinned << "年龄：" << profile.age << "\n";
+    if (!profile.gender.empty()) pinned << "性别：" << profile.gender << "\n";
+    if (!profile.traits.empty()) {
+        pinned << "特点：";
+        for (size_t i = 0; i < profile.traits.size(); i++) {
+            if (i > 0) pinned << "、";
+            pinned << profile.traits[i];
         }
+        pinned << "\n";
     }
-
-    // 验证 JSON 格式
-    cJSON *json = cJSON_Parse(response.c_str());
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse GLM response as JSON: %s", response.c_str());
-        return false;
+    if (!memory.recent_context.last_topic.empty()) {
+        pinned << "最近话题：" << memory.recent_context.last_topic << "\n";
     }
 
-    cJSON *choices = cJSON_GetObjectItem(json, "choices");
-    if (!choices || !cJSON_IsArray(choices)) {
-        ESP_LOGE(TAG, "GLM response has no choices array");
-        cJSON_Delete(json);
-        return false;
-    }
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    pinned_context_ = pinned.str();
+    memory_index_.Clear();
 
-    cJSON *first_choice = cJSON_GetArrayItem(choices, 0);
-    if (!first_choice) {
-        ESP_LOGE(TAG, "GLM response choices array is empty");
-        cJSON_Delete(json);
-        return false;
+    for (const auto& pref : profile.preferences) {
+        std::string text = pref.type.empty() ? pref.value : pref.type + "：" + pref.value;
+        memory_index_.Add(MemorySource::PREFERENCE, text);
+    }
+    for (const auto& item : memory.memories) {
+        MemorySource source = MemorySource::EVENT;
+        if (item.type == MemoryType::PREFERENCE) {
+            source = MemorySource::PREFERENCE;
+        } else if (item.type == MemoryType::CONVERSATION) {
+            source = MemorySource::SUMMARY;
+        }
+        memory_index_.Add(source, item.summary);
     }
 
-    cJSON *message_obj = cJSON_GetObjectItem(first_choice, "message");
-    if (!message_obj) {
-        ESP_LOGE(TAG, "GLM response has no message object");
-        cJSON_Delete(json);
-        return false;
+    ESP_LOGI(TAG, "Memory index rebuilt: %zu items, %d tokens",
+             memory_index_.Size(), memory_index_.GetTotalTokens());
+}
+
+std::string MemoryManager::BuildMemoryContext(const std::string& query, BudgetLevel level) {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+
+    // 接近 token 预算时少注入，超出后只留用户画像
+    std::vector<MemoryHit> hits;
+    if (level == BudgetLevel::NORMAL) {
+        hits = memory_index_.Query(query, RETRIEVAL_TOP_K, RETRIEVAL_TOKEN_BUDGET);
+    } else if (level == BudgetLevel::ECONOMY) {
+        hits = memory_index_.Query(query, RETRIEVAL_TOP_K / 2, RETRIEVAL_TOKEN_BUDGET / 2);
     }
 
-    cJSON *content = cJSON_GetObjectItem(message_obj, "content");
-    if (!content || !cJSON_IsString(content)) {
-        ESP_LOGE(TAG, "GLM response content is not valid string");
-        cJSON_Delete(json);
-        return false;
+    std::stringstream ss;
+    ss << pinned_context_;
+    if (!hits.empty()) {
+        ss << "相关记忆：\n";
+        for (const auto& hit : hits) {
+            ss << "- " << hit.text << "\n";
+        }
     }
 
-    new_memory.raw_json = content->valuestring;
-    cJSON_Delete(json);
+    std::string context = ss.str();
+    ESP_LOGI(TAG, "Memory context: %zu/%zu items, %d bytes",
+             hits.size(), memory_index_.Size(), context.length());
+    return context.empty() ? "（暂无记忆）" : context;
+}
 
-    ESP_LOGI(TAG, "Received compressed memory: %d bytes", new_memory.raw_json.length());
-    return true;
+std::string MemoryManager::ArchivePayload(const std::vector<Message>& messages,
+                                          const std::string& summary) {
+    std::string payload;
+    JsonWriteTo(payload, [&](auto& w) {
+        w.BeginObject();
+        w.Key("messages");
+        w.BeginArray();
+        for (const auto& msg : messages) {
+            w.BeginObject();
+            w.Field("role", msg.role);
+            w.Field("content", msg.content);
+            w.Field("timestamp", msg.timestamp);
+            w.EndObject();
+        }
+        w.EndArray();
+        w.Field("summary", summary);
+        w.EndObject();
+    });
+    return payload;
 }
 
-bool MemoryManager::ValidateMemorySize(const std::string& json) {
-    return json.length() <= MAX_MEMORY_SIZE;
+void MemoryManager::ArchiveConversations(const std::vector<Message>& messages,
+                                         std::time_t start_time,
+                                         const std::string& summary) {
+    if (!archive_ready_ || messages.empty()) {
+        return;
+    }
+
+    uint32_t id = session_archive_.Append(start_time, std::time(nullptr),
+                                          ArchivePayload(messages, summary));
+
+    if (id == 0) {
+        ESP_LOGW(TAG, "Failed to archive conversations");
+    }
 }
 
-MemoryPackage MemoryManager::GetMemoryPackage() {
-    return flash_storage_.ReadMemory();
+RetrievalStats MemoryManager::GetRetrievalStats() const {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    return memory_index_.GetStats();
 }
 
 bool MemoryManager::RollbackToBackup(int version) {
-    return flash_storage_.RollbackToBackup(version);
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+
+    std::string restored;
+    if (!flash_storage_.RollbackToBackup(version, restored)) {
+        return false;
+    }
+    PublishRestored(restored);
+    RebuildIndex();
+    return true;
+}
+
+bool MemoryManager::RollbackToHash(const std::string& hash) {
+    std::lock_guard<std::mutex> lock(commit_mutex_);
+
+    std::string restored;
+    if (!flash_storage_.RollbackToHash(hash, restored)) {
+        return false;
+    }
+    PublishRestored(restored);
+    RebuildIndex();
+    return true;
 }
 
 } // namespace EvoSpark
@@ -3,25 +3,21 @@
 
 #include <string>
 #include <functional>
+#include <mutex>
 #include "memory_types.h"
+#include "memory_index.h"
+#include "snapshot_cell.h"
+#include "message_pool.h"
+#include "compression_scheduler.h"
 #include "conversation_buffer.h"
 #include "../storage/flash_storage.h"
+#include "session_archive.h"
 #include "../api/glm_client.h"
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
 #include <freertos/task.h>
 
 namespace EvoSpark {
 
-// 压缩任务数据结构（使用固定长度字符数组）
-#define MAX_ROLE_LEN 32
-#define MAX_CONTENT_LEN 2048
-
-struct CompressionTask {
-    char role[MAX_ROLE_LEN];
-    char content[MAX_CONTENT_LEN];
-};
-
 class MemoryManager {
 public:
     static MemoryManager& GetInstance() {
@@ -32,22 +28,43 @@ public:
     // 初始化
     bool Init(const std::string& api_key);
 
-    // 添加对话到缓冲区（异步）
+    // 添加对话到缓冲区（异步，消息完整保留，不丢弃）
     void AddConversation(const std::string& role, const std::string& content);
 
-    // 手动触发记忆更新
-    bool UpdateMemory();
+    // 消息池统计
+    MessagePoolStats GetMessagePoolStats() const { return message_pool_.GetStats(); }
+
+    // 对话轮次开始 / 结束（轮次进行中不会触发压缩）
+    void BeginTurn();
+    void EndTurn();
+
+    // 压缩调度统计
+    SchedulerStats GetSchedulerStats() const { return scheduler_.GetStats(); }
 
-    // 获取当前记忆包
-    MemoryPackage GetMemoryPackage();
+    // 获取当前记忆快照（不等提交锁、不读 Flash；持有期间内容不变，提交会替换为新快照）
+    MemorySnapshotPtr GetSnapshot() const;
+
+    // 构建对话用的记忆上下文（用户画像 + 与 query 相关的记忆），按 token 预算状态缩减
+    std::string BuildMemoryContext(const std::string& query,
+                                   BudgetLevel level = BudgetLevel::NORMAL);
+
+    // 检索统计
+    RetrievalStats GetRetrievalStats() const;
 
     // 获取对话缓冲区状态
     size_t GetConversationCount() const { return conversation_buffer_.GetCount(); }
     bool IsBufferEmpty() const { return conversation_buffer_.IsEmpty(); }
     size_t GetBufferSize() const { return conversation_buffer_.GetSize(); }
 
-    // 回滚到历史版本
+    // 回滚到历史版本（1 = 当前版本之前的一个版本）
     bool RollbackToBackup(int version);
+    bool RollbackToHash(const std::string& hash);
+
+    // 版本历史（最新在前，只读索引）
+    std::vector<VersionInfo> GetVersionHistory() const { return flash_storage_.ListVersions(); }
+
+    // 对话历史归档（每次记忆压缩时归档一批对话）
+    SessionArchive& GetSessionArchive() { return session_archive_; }
 
     // 获取存储信息
     size_t GetFreeSpace() { return flash_storage_.GetFreeSpace(); }
@@ -62,22 +79,89 @@ private:
     static void CompressionTaskWrapper(void* arg);
     void ProcessCompressionTask();
 
-    // 调用 GLM API 压缩记忆
-    bool CompressMemory(const MemoryPackage& old_memory,
-                      const std::string& new_conversations,
-                      MemoryPackage& new_memory);
+    // 是否可以访问云端（STA 已连接且信号可用）
+    static bool IsNetworkAvailable();
+
+    // 取下待处理链表上的全部消息，并入对话缓冲区
+    void DrainPendingMessages();
+
+    // 缓冲区积压过多时把最早的一批转存到对话归档
+    void SpillIfNeeded();
+
+    static int EstimateTokens(const std::vector<Message>& messages);
+
+    // 压缩分两步，都在压缩任务上执行：StartCompression 把请求交给 GLM 网络
+    // 任务后立即返回，压缩任务继续接收新消息；结果到达时网络任务置
+    // result_ready_ 并通知压缩任务，压缩任务醒来后调用 FinishCompression 提交
+    bool StartCompression();
+    void FinishCompression();
+
+    // 校验并提交压缩结果（写 Flash、发布快照、归档本批对话）
+    bool CommitCompression(const std::string& response);
+
+    // 从 GLM 响应中取出新记忆包
+    bool ParseCompressionResponse(const std::string& reply, MemoryPackage& new_memory);
 
     // 验证记忆包大小
     bool ValidateMemorySize(const std::string& json);
 
+    // 发布新快照（调用方持有 commit_mutex_）
+    void PublishSnapshot(const MemoryPackage& memory);
+
+    // 回滚后发布恢复的内容
+    void PublishRestored(const std::string& json);
+
+    // 按当前快照重建检索索引
+    void RebuildIndex();
+
+    // 归档一批对话
+    static std::string ArchivePayload(const std::vector<Message>& messages,
+                                      const std::string& summary);
+    void ArchiveConversations(const std::vector<Message>& messages, std::time_t start_time,
+                              const std::string& summary);
+
     ConversationBuffer conversation_buffer_;
     FlashStorage flash_storage_;
     GLMClient* glm_client_;
 
-    // FreeRTOS 队列和任务
-    QueueHandle_t compression_queue_;
+    // 对话归档
+    SessionArchive session_archive_;
+    bool archive_ready_ = false;
+    std::time_t batch_start_time_ = 0;  // 当前缓冲区第一条消息的时间
+
+    // 消息池（PSRAM）及待处理消息链表（经 PooledMessage::next 串起，不限长度，
+    // 入链只持锁改两个指针，生产者不会被压缩任务挡住，也不会丢消息）
+    MessagePool message_pool_;
+    PooledMessage* pending_head_ = nullptr;
+    PooledMessage* pending_tail_ = nullptr;
+    std::mutex pending_mutex_;
+    CompressionScheduler scheduler_;
+    int pending_tokens_ = 0;  // 缓冲区中待合并的 token（估算）
     TaskHandle_t compression_task_;
 
+    // 进行中的压缩（只在压缩任务上访问；结果由网络任务写入，加锁）
+    bool compression_in_flight_ = false;
+    MemorySnapshotPtr compression_base_;         // 压缩所基于的快照
+    std::vector<Message> compression_batch_;     // 本批对话
+    uint32_t compression_end_seq_ = 0;           // 本批之后第一条消息的序号
+    std::time_t compression_batch_start_ = 0;
+    std::time_t compression_started_ = 0;
+    int compression_tokens_ = 0;
+    ChatResult compression_result_;
+    bool result_ready_ = false;                  // compression_result_ 待处理
+    std::mutex result_mutex_;
+
+    // 当前记忆快照，位于 PSRAM。读者无锁（见 SnapshotCell），写者由
+    // commit_mutex_ 串行化
+    SnapshotCell<MemorySnapshot> snapshot_;
+    // 串行化提交（压缩写入、回滚）
+    std::mutex commit_mutex_;
+
+    // 检索索引及常驻上下文（用户画像、最近话题）
+    MemoryIndex memory_index_;
+    std::string pinned_context_;
+    mutable std::mutex index_mutex_;
+
     bool is_initialized_ = false;
 };
 
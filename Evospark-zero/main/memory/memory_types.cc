@@ -1,4 +1,6 @@
 #include "memory_types.h"
+#include "cJSON.h"
+#include "json_codec.h"
 #include <sstream>
 #include <iomanip>
 #include <random>
@@ -25,132 +27,232 @@ static std::string current_timestamp() {
     return ss.str();
 }
 
-// 辅助函数：转义 JSON 字符串
-static std::string escape_json(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        switch (c) {
-            case '"':  result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b";  break;
-            case '\f': result += "\\f";  break;
-            case '\n': result += "\\n";  break;
-            case '\r': result += "\\r";  break;
-            case '\t': result += "\\t";  break;
-            default:   result += c;         break;
-        }
+static const char* memory_type_name(MemoryType type) {
+    switch (type) {
+        case MemoryType::FACT: return "fact";
+        case MemoryType::PREFERENCE: return "preference";
+        case MemoryType::EVENT: return "event";
+        case MemoryType::CONVERSATION: break;
     }
-    return result;
+    return "conversation";
 }
 
-// Preference 实现
-std::string Preference::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"type\":\"" << escape_json(type) << "\","
-       << "\"value\":\"" << escape_json(value) << "\","
-       << "\"weight\":" << weight
-       << "}";
-    return ss.str();
+// 各结构写入同一个 writer，嵌套对象不再先转成字符串再拼接
+template <typename Writer>
+static void write_json(Writer& w, const Preference& pref) {
+    w.BeginObject();
+    w.Field("type", pref.type);
+    w.Field("value", pref.value);
+    w.Field("weight", pref.weight);
+    w.EndObject();
 }
 
-// MemoryItem 实现
-std::string MemoryItem::to_json() const {
-    std::string type_str;
-    switch (type) {
-        case MemoryType::CONVERSATION:
-            type_str = "conversation";
-            break;
-        case MemoryType::FACT:
-            type_str = "fact";
-            break;
-        case MemoryType::PREFERENCE:
-            type_str = "preference";
-            break;
-        case MemoryType::EVENT:
-            type_str = "event";
-            break;
-    }
+template <typename Writer>
+static void write_json(Writer& w, const MemoryItem& item) {
+    w.BeginObject();
+    w.Field("id", item.id);
+    w.Field("type", memory_type_name(item.type));
+    w.Field("summary", item.summary);
+    w.Field("importance", item.importance);
+    w.Field("timestamp", item.timestamp);
+    w.Field("context", item.context);
+    w.EndObject();
+}
 
-    std::stringstream ss;
-    ss << "{"
-       << "\"id\":\"" << escape_json(id) << "\","
-       << "\"type\":\"" << type_str << "\","
-       << "\"summary\":\"" << escape_json(summary) << "\","
-       << "\"importance\":" << importance << ","
-       << "\"timestamp\":\"" << escape_json(timestamp) << "\","
-       << "\"context\":\"" << escape_json(context) << "\""
-       << "}";
-    return ss.str();
+template <typename Writer>
+static void write_json(Writer& w, const RecentContext& ctx) {
+    w.BeginObject();
+    w.Field("last_topic", ctx.last_topic);
+    w.Field("emotional_state", ctx.emotional_state);
+    w.Field("interaction_style", ctx.interaction_style);
+    w.EndObject();
 }
 
-// RecentContext 实现
-std::string RecentContext::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"last_topic\":\"" << escape_json(last_topic) << "\","
-       << "\"emotional_state\":\"" << escape_json(emotional_state) << "\","
-       << "\"interaction_style\":\"" << escape_json(interaction_style) << "\""
-       << "}";
-    return ss.str();
+// 空字符串写作 null
+template <typename Writer>
+static void write_optional(Writer& w, const char* key, const std::string& value) {
+    w.Key(key);
+    if (value.empty()) {
+        w.Null();
+    } else {
+        w.String(value);
+    }
 }
 
-// UserProfile 实现
-std::string UserProfile::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"name\":\"" << escape_json(name) << "\","
-       << "\"age\":" << (age.empty() ? "null" : "\"" + escape_json(age) + "\"") << ","
-       << "\"gender\":" << (gender.empty() ? "null" : "\"" + escape_json(gender) + "\"") << ","
-       << "\"preferences\":[";
-
-    for (size_t i = 0; i < preferences.size(); i++) {
-        if (i > 0) ss << ",";
-        ss << preferences[i].to_json();
+template <typename Writer>
+static void write_json(Writer& w, const UserProfile& profile) {
+    w.BeginObject();
+    w.Field("name", profile.name);
+    write_optional(w, "age", profile.age);
+    write_optional(w, "gender", profile.gender);
+    w.Key("preferences");
+    w.BeginArray();
+    for (const auto& pref : profile.preferences) {
+        write_json(w, pref);
     }
+    w.EndArray();
+    w.Key("traits");
+    w.BeginArray();
+    for (const auto& trait : profile.traits) {
+        w.String(trait);
+    }
+    w.EndArray();
+    w.EndObject();
+}
 
-    ss << "],"
-       << "\"traits\":[";
+template <typename Writer>
+static void write_json(Writer& w, const Metadata& meta) {
+    w.BeginObject();
+    w.Field("created_at", meta.created_at);
+    w.Field("last_updated", meta.last_updated);
+    w.Field("compression_level", meta.compression_level);
+    w.Field("total_memories", meta.total_memories);
+    w.EndObject();
+}
 
-    for (size_t i = 0; i < traits.size(); i++) {
-        if (i > 0) ss << ",";
-        ss << "\"" << escape_json(traits[i]) << "\"";
+template <typename Writer>
+static void write_json(Writer& w, const MemoryPackage& package) {
+    w.BeginObject();
+    w.Field("version", package.version);
+    w.Key("metadata");
+    write_json(w, package.metadata);
+    w.Key("user_profile");
+    write_json(w, package.user_profile);
+    w.Key("memories");
+    w.BeginArray();
+    for (const auto& item : package.memories) {
+        write_json(w, item);
     }
+    w.EndArray();
+    w.Key("recent_context");
+    write_json(w, package.recent_context);
+    w.EndObject();
+}
 
-    ss << "]}";
-    return ss.str();
+// 两遍写入：先量长度再一次分配
+template <typename T>
+static std::string to_json_string(const T& value) {
+    std::string json;
+    JsonWriteTo(json, [&value](auto& w) { write_json(w, value); });
+    return json;
+}
+
+std::string Preference::to_json() const {
+    return to_json_string(*this);
+}
+
+std::string MemoryItem::to_json() const {
+    return to_json_string(*this);
+}
+
+std::string RecentContext::to_json() const {
+    return to_json_string(*this);
+}
+
+std::string UserProfile::to_json() const {
+    return to_json_string(*this);
 }
 
-// Metadata 实现
 std::string Metadata::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"created_at\":\"" << escape_json(created_at) << "\","
-       << "\"last_updated\":\"" << escape_json(last_updated) << "\","
-       << "\"compression_level\":" << compression_level << ","
-       << "\"total_memories\":" << total_memories
-       << "}";
-    return ss.str();
+    return to_json_string(*this);
 }
 
-// MemoryPackage 实现
 std::string MemoryPackage::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"version\":\"" << escape_json(version) << "\","
-       << "\"metadata\":" << metadata.to_json() << ","
-       << "\"user_profile\":" << user_profile.to_json() << ","
-       << "\"memories\":[";
-
-    for (size_t i = 0; i < memories.size(); i++) {
-        if (i > 0) ss << ",";
-        ss << memories[i].to_json();
+    return to_json_string(*this);
+}
+
+// 辅助函数：读取字符串字段（缺失或非字符串返回空）
+static std::string json_string(cJSON* obj, const char* key) {
+    cJSON* item = cJSON_GetObjectItem(obj, key);
+    return (cJSON_IsString(item) && item->valuestring) ? item->valuestring : "";
+}
+
+static MemoryType parse_memory_type(const std::string& type) {
+    if (type == "fact") return MemoryType::FACT;
+    if (type == "preference") return MemoryType::PREFERENCE;
+    if (type == "event") return MemoryType::EVENT;
+    return MemoryType::CONVERSATION;
+}
+
+bool MemoryPackage::from_json(const std::string& json) {
+    cJSON* root = cJSON_Parse(json.c_str());
+    if (!root) {
+        return false;
     }
 
-    ss << "],"
-       << "\"recent_context\":" << recent_context.to_json()
-       << "}";
-    return ss.str();
+    raw_json = json;
+    version = json_string(root, "version");
+
+    cJSON* meta = cJSON_GetObjectItem(root, "metadata");
+    if (cJSON_IsObject(meta)) {
+        metadata.created_at = json_string(meta, "created_at");
+        metadata.last_updated = json_string(meta, "last_updated");
+        cJSON* item = cJSON_GetObjectItem(meta, "compression_level");
+        metadata.compression_level = cJSON_IsNumber(item) ? item->valueint : 0;
+        item = cJSON_GetObjectItem(meta, "total_memories");
+        metadata.total_memories = cJSON_IsNumber(item) ? item->valueint : 0;
+    }
+
+    cJSON* profile = cJSON_GetObjectItem(root, "user_profile");
+    if (cJSON_IsObject(profile)) {
+        user_profile.name = json_string(profile, "name");
+        user_profile.age = json_string(profile, "age");
+        user_profile.gender = json_string(profile, "gender");
+
+        user_profile.preferences.clear();
+        cJSON* item = nullptr;
+        cJSON_ArrayForEach(item, cJSON_GetObjectItem(profile, "preferences")) {
+            Preference pref;
+            if (cJSON_IsString(item) && item->valuestring) {
+                pref.value = item->valuestring;
+                pref.weight = 1.0;
+            } else if (cJSON_IsObject(item)) {
+                pref.type = json_string(item, "type");
+                pref.value = json_string(item, "value");
+                cJSON* weight = cJSON_GetObjectItem(item, "weight");
+                pref.weight = cJSON_IsNumber(weight) ? weight->valuedouble : 1.0;
+            } else {
+                continue;
+            }
+            user_profile.preferences.push_back(pref);
+        }
+
+        user_profile.traits.clear();
+        cJSON_ArrayForEach(item, cJSON_GetObjectItem(profile, "traits")) {
+            if (cJSON_IsString(item) && item->valuestring) {
+                user_profile.traits.push_back(item->valuestring);
+            }
+        }
+    }
+
+    memories.clear();
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "memories")) {
+        if (!cJSON_IsObject(item)) {
+            continue;
+        }
+        MemoryItem mem;
+        mem.id = json_string(item, "id");
+        mem.type = parse_memory_type(json_string(item, "type"));
+        mem.summary = json_string(item, "summary");
+        cJSON* importance = cJSON_GetObjectItem(item, "importance");
+        mem.importance = cJSON_IsNumber(importance) ? importance->valuedouble : 0.5;
+        mem.timestamp = json_string(item, "timestamp");
+        mem.context = json_string(item, "context");
+        if (!mem.summary.empty()) {
+            memories.push_back(mem);
+        }
+    }
+
+    cJSON* recent = cJSON_GetObjectItem(root, "recent_context");
+    if (cJSON_IsObject(recent)) {
+        recent_context.last_topic = json_string(recent, "last_topic");
+        recent_context.emotional_state = json_string(recent, "emotional_state");
+        recent_context.interaction_style = json_string(recent, "interaction_style");
+    }
+
+    cJSON_Delete(root);
+    return true;
 }
 
 } // namespace EvoSpark
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 
 namespace EvoSpark {
 
@@ -79,6 +81,14 @@ struct MemoryPackage {
     bool from_json(const std::string& json);
 };
 
+// 记忆快照 - 提交后只读，整体替换
+struct MemorySnapshot {
+    MemoryPackage memory;
+    uint32_t generation = 0;  // 每次提交递增，0 表示启动时从 Flash 载入
+};
+
+using MemorySnapshotPtr = std::shared_ptr<const MemorySnapshot>;
+
 } // namespace EvoSpark
 
 #endif // MEMORY_TYPES_H
@@ -0,0 +1,130 @@
+#include "message_pool.h"
+#include <cstring>
+#include <cstdio>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+namespace EvoSpark {
+
+static const char* TAG = "MessagePool";
+
+MessagePool::~MessagePool() {
+    if (slab_ != nullptr) {
+        heap_caps_free(slab_);
+    }
+}
+
+void* MessagePool::AllocPsram(size_t size) {
+    void* p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p == nullptr) {
+        p = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    return p;
+}
+
+bool MessagePool::Init(size_t slots) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slab_ != nullptr) {
+        return true;
+    }
+
+    slab_ = static_cast<PooledMessage*>(AllocPsram(slots * sizeof(PooledMessage)));
+    if (slab_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %zu message slots", slots);
+        return false;
+    }
+
+    // 串成空闲链表
+    for (size_t i = 0; i < slots; i++) {
+        slab_[i].next = (i + 1 < slots) ? &slab_[i + 1] : nullptr;
+        slab_[i].from_slab = true;
+    }
+    free_list_ = slab_;
+    stats_.slots = slots;
+
+    ESP_LOGI(TAG, "Message pool ready: %zu slots x %zu bytes",
+             slots, sizeof(PooledMessage));
+    return true;
+}
+
+PooledMessage* MessagePool::Acquire(const std::string& role, const std::string& content) {
+    PooledMessage* msg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_list_ != nullptr) {
+            msg = free_list_;
+            free_list_ = msg->next;
+        } else {
+            stats_.overflow++;
+        }
+        stats_.acquired++;
+        stats_.in_use++;
+        if (stats_.in_use > stats_.peak_in_use) {
+            stats_.peak_in_use = stats_.in_use;
+        }
+    }
+
+    // 槽用尽时不丢消息，改为单独分配
+    if (msg == nullptr) {
+        msg = static_cast<PooledMessage*>(AllocPsram(sizeof(PooledMessage)));
+        if (msg == nullptr) {
+            ESP_LOGE(TAG, "Out of memory for message");
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.in_use--;
+            stats_.dropped++;
+            return nullptr;
+        }
+        msg->from_slab = false;
+        ESP_LOGW(TAG, "Message slots exhausted, using heap");
+    }
+    msg->next = nullptr;
+
+    snprintf(msg->role, sizeof(msg->role), "%s", role.c_str());
+
+    msg->length = content.length();
+    if (content.length() < sizeof(msg->inline_data)) {
+        msg->content = msg->inline_data;
+    } else {
+        msg->content = static_cast<char*>(AllocPsram(content.length() + 1));
+        if (msg->content == nullptr) {
+            ESP_LOGE(TAG, "Out of memory for %zu byte message", content.length());
+            Release(msg);
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.dropped++;
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.large++;
+    }
+    memcpy(msg->content, content.data(), content.length());
+    msg->content[content.length()] = '\0';
+
+    return msg;
+}
+
+void MessagePool::Release(PooledMessage* msg) {
+    if (msg == nullptr) {
+        return;
+    }
+
+    if (msg->content != nullptr && msg->content != msg->inline_data) {
+        heap_caps_free(msg->content);
+    }
+    msg->content = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.in_use--;
+    if (msg->from_slab) {
+        msg->next = free_list_;
+        free_list_ = msg;
+    } else {
+        heap_caps_free(msg);
+    }
+}
+
+MessagePoolStats MessagePool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,70 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace EvoSpark {
+
+// 池化的对话消息
+//
+// 传递的只是指针，所有权随指针转移：生产者 Acquire 后挂到待处理链表，
+// 消费者取下处理完再 Release。短消息直接放在槽内，长消息额外从
+// PSRAM 按实际长度分配，不做截断。
+struct PooledMessage {
+    static constexpr size_t ROLE_CAPACITY = 16;
+    static constexpr size_t INLINE_CAPACITY = 480;
+
+    PooledMessage* next;           // 空闲链表 / 待处理链表
+    char* content;                 // 指向 inline_data 或 PSRAM 堆
+    uint32_t length;               // content 长度（不含结尾 0）
+    bool from_slab;                // 是否来自预分配槽
+    char role[ROLE_CAPACITY];
+    char inline_data[INLINE_CAPACITY];
+};
+
+// 消息池统计
+struct MessagePoolStats {
+    size_t slots;            // 预分配槽数量
+    size_t in_use;           // 当前在用（含溢出分配）
+    size_t peak_in_use;      // 峰值
+    uint32_t acquired;       // 累计分配
+    uint32_t overflow;       // 槽用尽后走堆分配的次数
+    uint32_t large;          // 超出槽内容量、单独分配内容的次数
+    uint32_t dropped;        // 内存耗尽、没能记入的消息
+};
+
+// 消息槽池 - 一次性从 PSRAM 分配固定数量的槽，空闲链表管理
+class MessagePool {
+public:
+    MessagePool() = default;
+    ~MessagePool();
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    // 分配 slots 个槽
+    bool Init(size_t slots);
+
+    // 取一个槽并复制消息；槽用尽时退回堆分配，内存耗尽才返回 nullptr
+    PooledMessage* Acquire(const std::string& role, const std::string& content);
+
+    // 归还消息（释放单独分配的内容）
+    void Release(PooledMessage* msg);
+
+    MessagePoolStats GetStats() const;
+
+private:
+    static void* AllocPsram(size_t size);
+
+    PooledMessage* slab_ = nullptr;
+    PooledMessage* free_list_ = nullptr;
+    MessagePoolStats stats_ = {};
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // MESSAGE_POOL_H
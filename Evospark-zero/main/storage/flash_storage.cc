@@ -1,13 +1,25 @@
 #include "flash_storage.h"
+#include "esp_vfs_fat.h"
 #include <cstring>
+#include <sys/stat.h>
 
 namespace EvoSpark {
 
 static const char* TAG = "FlashStorage";
 const char* FlashStorage::MEMORY_FILE = "/spiffs/memory.json";
-const char* FlashStorage::BACKUP_FILE_PREFIX = "/spiffs/memory_backup";
+const char* FlashStorage::VERSION_PREFIX = "/spiffs/mv";
 
-FlashStorage::FlashStorage() : mounted_(false) {
+// 旧版滚动备份（memory_backup_1~3.json），启动时导入版本历史
+static const char* LEGACY_BACKUP_PREFIX = "/spiffs/memory_backup";
+static const int LEGACY_BACKUP_COUNT = 3;
+
+static bool FileExists(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+FlashStorage::FlashStorage() : mounted_(false), version_store_(VERSION_PREFIX),
+                               fat_wl_handle_(WL_INVALID_HANDLE) {
 }
 
 FlashStorage::~FlashStorage() {
@@ -15,13 +27,16 @@ FlashStorage::~FlashStorage() {
         esp_vfs_spiffs_unregister(NULL);
         mounted_ = false;
     }
+    if (!fat_base_path_.empty()) {
+        esp_vfs_fat_spiflash_unmount_rw_wl(fat_base_path_.c_str(), fat_wl_handle_);
+    }
 }
 
 bool FlashStorage::Init() {
     esp_vfs_spiffs_conf_t conf = {
         .base_path = "/spiffs",
         .partition_label = NULL,
-        .max_files = 10,  // 支持主文件 + 3个备份
+        .max_files = 10,  // 主文件 + 版本索引 + 版本记录
         .format_if_mount_failed = true
     };
 
@@ -42,6 +57,40 @@ bool FlashStorage::Init() {
              total / 1024, used / 1024, (total - used) / 1024);
 
     mounted_ = true;
+
+    // 加载版本历史
+    version_store_.Init();
+    MigrateLegacyBackups();
+
+    return true;
+}
+
+bool FlashStorage::MountFat(const char* partition_label, const char* base_path) {
+    if (!fat_base_path_.empty()) {
+        return fat_base_path_ == base_path;
+    }
+
+    esp_vfs_fat_mount_config_t conf = {};
+    conf.format_if_mount_failed = true;
+    conf.max_files = 4;
+    conf.allocation_unit_size = 4096;
+
+    wl_handle_t handle = WL_INVALID_HANDLE;
+    esp_err_t ret = esp_vfs_fat_spiflash_mount_rw_wl(base_path, partition_label, &conf, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount FAT partition '%s': %s",
+                 partition_label, esp_err_to_name(ret));
+        return false;
+    }
+
+    uint64_t total = 0, free_bytes = 0;
+    if (esp_vfs_fat_info(base_path, &total, &free_bytes) == ESP_OK) {
+        ESP_LOGI(TAG, "FAT mounted at %s: total=%llu KB, free=%llu KB", base_path,
+                 (unsigned long long)(total / 1024), (unsigned long long)(free_bytes / 1024));
+    }
+
+    fat_base_path_ = base_path;
+    fat_wl_handle_ = handle;
     return true;
 }
 
@@ -71,188 +120,138 @@ MemoryPackage FlashStorage::ReadMemory() {
     memory.raw_json = std::string(buffer);
     delete[] buffer;
 
-    // 解析 JSON（简化版，实际需要完整的 JSON 解析）
-    ESP_LOGI(TAG, "Memory loaded: %zu bytes", memory.raw_json.length());
+    // 解析 JSON（失败时保留原始内容）
+    if (!memory.from_json(memory.raw_json)) {
+        ESP_LOGW(TAG, "Memory file is not valid JSON");
+    }
+    ESP_LOGI(TAG, "Memory loaded: %zu bytes, %zu items",
+             memory.raw_json.length(), memory.memories.size());
 
     return memory;
 }
 
 bool FlashStorage::WriteMemory(const MemoryPackage& memory) {
-    // 先创建备份（滚动备份）
-    BackupMemory(memory);
-
     // 写入主文件
+    if (!WriteMainFile(memory.raw_json)) {
+        return false;
+    }
+
+    // 记录版本（相对基准的增量）
+    if (!version_store_.Commit(memory.raw_json)) {
+        ESP_LOGW(TAG, "Failed to record memory version");
+    }
+
+    return true;
+}
+
+bool FlashStorage::WriteMainFile(const std::string& json) {
     FILE* f = fopen(MEMORY_FILE, "w");
     if (f == NULL) {
         ESP_LOGE(TAG, "Failed to open memory file for writing");
         return false;
     }
 
-    size_t written = fwrite(memory.raw_json.c_str(), 1,
-                        memory.raw_json.length(), f);
+    size_t written = fwrite(json.c_str(), 1, json.length(), f);
     fclose(f);
 
-    if (written != memory.raw_json.length()) {
-        ESP_LOGE(TAG, "Write incomplete: %zu/%zu bytes",
-                 written, memory.raw_json.length());
+    if (written != json.length()) {
+        ESP_LOGE(TAG, "Write incomplete: %zu/%zu bytes", written, json.length());
         return false;
     }
 
     ESP_LOGI(TAG, "Memory written: %zu bytes", written);
-
-    // 清理旧备份
-    CleanOldBackups();
-
     return true;
 }
 
-std::string FlashStorage::GetBackupFileName(int version) {
-    std::stringstream ss;
-    ss << BACKUP_FILE_PREFIX << "_" << version << ".json";
-    return ss.str();
-}
-
-bool FlashStorage::BackupMemory(const MemoryPackage& memory) {
-    ESP_LOGI(TAG, "Creating backup...");
-
-    // 滚动备份：3->2, 2->1, 新版本为1
-    for (int v = MAX_BACKUP_VERSIONS; v > 1; v--) {
-        std::string old_backup = GetBackupFileName(v);
-        std::string new_backup = GetBackupFileName(v - 1);
-
-        // SPIFFS 不支持 rename，使用复制-删除策略
-        //1. 读取旧备份
-        FILE* src = fopen(old_backup.c_str(), "r");
-        if (src != NULL) {
-            fseek(src, 0, SEEK_END);
-            long size = ftell(src);
-            fseek(src, 0, SEEK_SET);
-
-            char* buffer = new char[size + 1];
-            fread(buffer, 1, size, src);
-            buffer[size] = '\0';
-            fclose(src);
-
-            // 2. 写入新备份
-            FILE* dst = fopen(new_backup.c_str(), "w");
-            if (dst == NULL) {
-                ESP_LOGE(TAG, "Failed to create backup file: %s", new_backup.c_str());
-                delete[] buffer;
-                return false;
-            }
-            fwrite(buffer, 1, size, dst);
-            fclose(dst);
-
-            // 3. 删除旧备份
-            if (remove(old_backup.c_str()) == 0) {
-                ESP_LOGI(TAG, "Deleted old backup: %s", old_backup.c_str());
-            } else {
-                ESP_LOGW(TAG, "Failed to delete old backup: %s", old_backup.c_str());
-            }
-
-            delete[] buffer;
-        } else {
-            ESP_LOGW(TAG, "Backup file not found: %s", old_backup.c_str());
-        }
+bool FlashStorage::RollbackToBackup(int version, std::string& restored) {
+    // 历史中第 0 项为当前版本
+    if (version < 1 || version >= static_cast<int>(version_store_.Count())) {
+        ESP_LOGE(TAG, "Invalid backup version: %d (have %zu)",
+                 version, version_store_.Count());
+        return false;
     }
 
-    // 写入新备份（版本 1）
-    std::string backup_file = GetBackupFileName(1);
-    FILE* f = fopen(backup_file.c_str(), "w");
-    if (f == NULL) {
-        ESP_LOGE(TAG, "Failed to create backup file: %s", backup_file.c_str());
+    std::string content;
+    if (!version_store_.CheckoutNth(version, content)) {
+        ESP_LOGE(TAG, "Failed to reconstruct version %d", version);
         return false;
     }
 
-    fwrite(memory.raw_json.c_str(), 1, memory.raw_json.length(), f);
-    fclose(f);
+    if (!RestoreVersion(content)) {
+        return false;
+    }
 
-    ESP_LOGI(TAG, "Backup created: %s (%zu bytes)", backup_file.c_str(),
-             memory.raw_json.length());
+    ESP_LOGI(TAG, "Rolled back to backup version %d: %zu bytes",
+             version, content.length());
+    restored = std::move(content);
     return true;
 }
 
-bool FlashStorage::RollbackToBackup(int version) {
-    if (version < 1 || version > MAX_BACKUP_VERSIONS) {
-        ESP_LOGE(TAG, "Invalid backup version: %d (valid: 1-%d)",
-                  version, MAX_BACKUP_VERSIONS);
+bool FlashStorage::RollbackToHash(const std::string& hash, std::string& restored) {
+    std::string content;
+    if (!version_store_.CheckoutByHash(hash, content)) {
         return false;
     }
 
-    std::string backup_file = GetBackupFileName(version);
-    FILE* f = fopen(backup_file.c_str(), "r");
-    if (f == NULL) {
-        ESP_LOGE(TAG, "Backup file not found: %s", backup_file.c_str());
+    if (!RestoreVersion(content)) {
         return false;
     }
 
-    // 读取备份
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    char* buffer = new char[size + 1];
-    fread(buffer, 1, size, f);
-    buffer[size] = '\0';
-    fclose(f);
-
-    std::string backup_content(buffer);
-    delete[] buffer;
+    ESP_LOGI(TAG, "Rolled back to version %s: %zu bytes", hash.c_str(), content.length());
+    restored = std::move(content);
+    return true;
+}
 
-    // 写入主文件
-    FILE* main_f = fopen(MEMORY_FILE, "w");
-    if (main_f == NULL) {
+bool FlashStorage::RestoreVersion(const std::string& json) {
+    if (!WriteMainFile(json)) {
         ESP_LOGE(TAG, "Failed to open main file for rollback");
         return false;
     }
 
-    fwrite(backup_content.c_str(), 1, backup_content.length(), main_f);
-    fclose(main_f);
-
-    ESP_LOGI(TAG, "Rolled back to backup version %d: %zu bytes",
-             version, backup_content.length());
+    // 回滚也记录为新版本，便于撤销
+    version_store_.Commit(json);
     return true;
 }
 
-bool FlashStorage::DeleteBackup(int version) {
-    std::string backup_file = GetBackupFileName(version);
-    if (remove(backup_file.c_str()) == 0) {
-        ESP_LOGI(TAG, "Deleted backup: %s", backup_file.c_str());
-        return true;
-    }
-    return false;
-}
+void FlashStorage::MigrateLegacyBackups() {
+    // 历史为空时导入旧备份（_1 为最新，从旧到新导入），再接上当前记忆
+    bool import = (version_store_.Count() == 0);
 
-bool FlashStorage::CleanOldBackups() {
-    // 检查备份数量，删除超过 MAX_BACKUP_VERSIONS 的
-    int count = 0;
-    std::vector<int> versions_to_delete;
-
-    for (int v = 1; v <= MAX_BACKUP_VERSIONS + 2; v++) {
-        std::string backup_file = GetBackupFileName(v);
-        FILE* f = fopen(backup_file.c_str(), "r");
-        if (f != NULL) {
-            fclose(f);
-            count++;
-            if (count > MAX_BACKUP_VERSIONS) {
-                // 超过最大数量，标记为待删除
-                versions_to_delete.push_back(v);
-                count--;
-            }
+    for (int v = LEGACY_BACKUP_COUNT; v >= 1; v--) {
+        std::string path = std::string(LEGACY_BACKUP_PREFIX) + "_" + std::to_string(v) + ".json";
+        // 迁移后旧备份已删除，之后每次启动只 stat 一下
+        if (!FileExists(path.c_str())) {
+            continue;
         }
-    }
+        FILE* f = fopen(path.c_str(), "r");
+        if (f == NULL) {
+            continue;
+        }
+
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        std::string content(size > 0 ? size : 0, '\0');
+        if (size > 0) {
+            fread(&content[0], 1, size, f);
+        }
+        fclose(f);
 
-    // 删除标记的文件（从旧到新，避免覆盖）
-    std::sort(versions_to_delete.begin(), versions_to_delete.end(), std::greater<int>());
-    for (int v : versions_to_delete) {
-        if (v >= 1 && v <= MAX_BACKUP_VERSIONS) {
-            DeleteBackup(v);
-        } else {
-            ESP_LOGW(TAG, "Invalid version to delete: %d", v);
+        if (import) {
+            version_store_.Commit(content);
         }
+        remove(path.c_str());
     }
 
-    return true;
+    // 新设备还没有记忆文件时历史保持为空，不必每次启动都读一遍
+    if (import && FileExists(MEMORY_FILE)) {
+        MemoryPackage current = ReadMemory();
+        if (current.raw_json != "{}") {
+            version_store_.Commit(current.raw_json);
+        }
+        ESP_LOGI(TAG, "Version history seeded: %zu versions", version_store_.Count());
+    }
 }
 
 size_t FlashStorage::GetFreeSpace() {
@@ -2,31 +2,35 @@
 #define FLASH_STORAGE_H
 
 #include <string>
+#include <vector>
 #include "esp_spiffs.h"
 #include "esp_log.h"
 #include "../memory/memory_types.h"
+#include "version_store.h"
 
 namespace EvoSpark {
 
-// 历史版本管理
-static const int MAX_BACKUP_VERSIONS = 3;  // 保留 3 个历史版本
-
 class FlashStorage {
 public:
     static const char* MEMORY_FILE;
-    static const char* BACKUP_FILE_PREFIX;
+    static const char* VERSION_PREFIX;
 
     FlashStorage();
     ~FlashStorage();
 
     bool Init();
+
+    // 挂载 FAT 数据分区（带磨损均衡），用于会话归档
+    bool MountFat(const char* partition_label, const char* base_path);
+
     MemoryPackage ReadMemory();
     bool WriteMemory(const MemoryPackage& memory);
 
-    // 备份管理
-    bool BackupMemory(const MemoryPackage& memory);
-    bool RollbackToBackup(int version);  // version: 1=最新备份, 2=次新, 3=最旧
-    bool CleanOldBackups();
+    // 版本管理（增量存储，按内容哈希寻址）
+    // restored 返回回滚后的记忆内容
+    bool RollbackToBackup(int version, std::string& restored);  // version: 1=当前之前的一个版本, 2=再前一个, ...
+    bool RollbackToHash(const std::string& hash, std::string& restored);
+    std::vector<VersionInfo> ListVersions() const { return version_store_.List(); }
 
     // 存储信息
     size_t GetFreeSpace();
@@ -34,8 +38,13 @@ public:
 
 private:
     bool mounted_;
-    std::string GetBackupFileName(int version);
-    bool DeleteBackup(int version);
+    VersionStore version_store_;
+    std::string fat_base_path_;
+    int fat_wl_handle_;
+
+    bool WriteMainFile(const std::string& json);
+    bool RestoreVersion(const std::string& json);
+    void MigrateLegacyBackups();
 };
 
 } // namespace EvoSpark
@@ -1,12 +1,22 @@
 #include "web_server.h"
 #include "../memory/memory_manager.h"
 #include "../config/config_manager.h"
+#include "prompt_template.h"
+#include "../api/glm_client.h"
+#include "http_pool.h"
+#include "dns_cache.h"
+#include "link_quality.h"
+#include "request_queue.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "json_codec.h"
 #include <cstring>
 #include <sys/socket.h>
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_system.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
@@ -14,18 +24,141 @@ namespace EvoSpark {
 
 static const char* TAG = "WebServer";
 
+// 对话系统提示：固定不变，作为每个请求的相同前缀（可命中服务端前缀缓存）
+static const char kChatSystemPrompt[] =
+    "你是 Evo-spark 智能陪伴机器人，根据用户消息中附带的记忆，自然地回应用户。"
+    "请用友好、自然的语气回应。只返回回应内容，不要其他说明。";
+
+// 对话用户消息：{{0}} 记忆上下文  {{1}} 用户消息（随每轮变化，放在固定前缀之后）
+PROMPT_TEMPLATE(kChatPrompt, R"(关于用户的记忆：
+{{0}}
+
+用户消息：{{1}})");
+
+static const uint32_t CHAT_DEADLINE_MS = 60000;   // 对话回复截止时间（含排队）
+
+// 发出对话回复并结束本轮（在网络任务或 httpd 任务上调用）
+static void send_chat_reply(httpd_req_t *req, const ChatResult& result) {
+    MemoryManager& mgr = MemoryManager::GetInstance();
+    if (result.success) {
+        ESP_LOGI(TAG, "AI response generated: %d bytes", result.content.length());
+
+        // 添加 AI 响应到记忆
+        mgr.AddConversation("assistant", result.content);
+
+        // GLMClient 已经解析了响应，content 就是内容文本，这里只需转义
+        std::string json;
+        JsonWriteTo(json, [&result](auto& w) {
+            w.BeginObject();
+            w.Field("response", result.content);
+            w.EndObject();
+        });
+        httpd_resp_set_hdr(req, "Content-Type", "application/json");
+        httpd_resp_send(req, json.c_str(), json.length());
+        mgr.EndTurn();
+        return;
+    }
+
+    // 生成失败
+    ESP_LOGE(TAG, "Failed to generate AI response");
+    httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    httpd_resp_send(req, "{\"response\":\"抱歉，我暂时无法回应。\"}", HTTPD_RESP_USE_STRLEN);
+    mgr.EndTurn();
+}
+
 // MonitorData 实现
+template <typename Writer>
+static void write_monitor(Writer& json, const MonitorData& d) {
+    json.BeginObject();
+    json.Field("conversation_count", d.conversation_count);
+    json.Field("buffer_size", d.buffer_size);
+    json.Field("free_space_kb", d.free_space_kb);
+    json.Field("used_space_kb", d.used_space_kb);
+    json.Field("is_idle", d.is_idle);
+    json.Field("last_update", d.last_update);
+    json.Field("retrieval_injected_tokens", d.retrieval_injected_tokens);
+    json.Field("retrieval_full_tokens", d.retrieval_full_tokens);
+    json.Field("memory_generation", d.memory_generation);
+    json.Field("pending_messages", d.pending_messages);
+    json.Field("pool_overflow", d.pool_overflow);
+    json.Field("pool_dropped", d.pool_dropped);
+    json.Field("compressions", d.compressions);
+    json.Field("compressions_saved", d.compressions_saved);
+    json.Field("compress_outputs", d.compress_outputs);
+    json.Field("compress_failures", d.compress_failures);
+    json.Field("compress_repairs", d.compress_repairs);
+    json.Field("compress_wasted_tokens", d.compress_wasted_tokens);
+    json.Field("avg_turn_latency_ms", d.avg_turn_latency_ms);
+    json.Field("max_turn_latency_ms", d.max_turn_latency_ms);
+    json.Field("turns_overlapped", d.turns_overlapped);
+    json.Field("cache_requests", d.cache_requests);
+    json.Field("cache_hits", d.cache_hits);
+    json.Field("cached_tokens", d.cached_tokens);
+    json.Field("prompt_tokens", d.prompt_tokens);
+    json.Field("avg_hit_ms", d.avg_hit_ms);
+    json.Field("avg_miss_ms", d.avg_miss_ms);
+    json.Field("http_requests", d.http_requests);
+    json.Field("http_handshakes", d.http_handshakes);
+    json.Field("http_reused", d.http_reused);
+    json.Field("handshake_saved_ms", d.handshake_saved_ms);
+    json.Field("http_reconnects", d.http_reconnects);
+    json.Field("avg_handshake_ms", d.avg_handshake_ms);
+    json.Field("avg_reconnect_ms", d.avg_reconnect_ms);
+    json.Field("connect_internal_bytes", d.connect_internal_bytes);
+    json.Field("dns_hits", d.dns_hits);
+    json.Field("dns_misses", d.dns_misses);
+    json.Field("dns_stale", d.dns_stale);
+    json.Field("link_class", d.link_class);
+    json.Field("link_rssi", d.link_rssi);
+    json.Field("link_srtt_ms", d.link_srtt_ms);
+    json.Field("link_uplink_kbps", d.link_uplink_kbps);
+    json.Field("link_loss_permille", d.link_loss_permille);
+    json.Field("gzip_body_bytes", d.gzip_body_bytes);
+    json.Field("gzip_sent_bytes", d.gzip_sent_bytes);
+    json.Field("gzip_wire_bytes", d.gzip_wire_bytes);
+    json.Field("gzip_decoded_bytes", d.gzip_decoded_bytes);
+    json.Field("gzip_deflate_us", d.gzip_deflate_us);
+    json.Field("gzip_inflate_us", d.gzip_inflate_us);
+    json.Field("llm_queued", d.llm_queued);
+    json.Field("llm_in_flight", d.llm_in_flight);
+    json.Field("llm_expired", d.llm_expired);
+    json.Field("llm_rejected", d.llm_rejected);
+    json.Field("llm_max_wait_ms", d.llm_max_wait_ms);
+    json.Field("resp_cache_lookups", d.resp_cache_lookups);
+    json.Field("resp_cache_hits", d.resp_cache_hits);
+    json.Field("resp_cache_entries", d.resp_cache_entries);
+    json.Field("resp_cache_tokens_saved", d.resp_cache_tokens_saved);
+    json.Field("resp_cache_saved_ms", d.resp_cache_saved_ms);
+    json.Field("tokens_session", d.tokens_session);
+    json.Field("tokens_today", d.tokens_today);
+    json.Field("token_level", d.token_level);
+    json.EndObject();
+}
+
 std::string MonitorData::to_json() const {
-    std::stringstream ss;
-    ss << "{"
-       << "\"conversation_count\":" << conversation_count << ","
-       << "\"buffer_size\":" << buffer_size << ","
-       << "\"free_space_kb\":" << free_space_kb << ","
-       << "\"used_space_kb\":" << used_space_kb << ","
-       << "\"is_idle\":" << (is_idle ? "true" : "false") << ","
-       << "\"last_update\":\"" << last_update << "\""
-       << "}";
-    return ss.str();
+    std::string json;
+    JsonWriteTo(json, [this](auto& w) { write_monitor(w, *this); });
+    return json;
+}
+
+static const size_t JSON_CHUNK_SIZE = 1024;
+
+// 分块发送 JSON：边写边发，任意大小的响应只占一块栈上缓冲区
+template <typename WriteFn>
+static esp_err_t send_json_chunked(httpd_req_t* req, WriteFn&& write) {
+    char buffer[JSON_CHUNK_SIZE];
+    JsonChunkSink sink(buffer, sizeof(buffer), [req](const char* data, size_t length) {
+        return httpd_resp_send_chunk(req, data, length) == ESP_OK;
+    });
+
+    httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    JsonWriter<JsonChunkSink> json(sink);
+    write(json);
+    if (!sink.Finish()) {
+        ESP_LOGW(TAG, "Client went away after %zu bytes", sink.Total());
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
 // 内联 HTML（避免文件系统）
@@ -87,6 +220,16 @@ static const char index_html[] = R"rawliteral(
                         align-items: center; }
         .backup-item button { padding: 6px 12px; background: #4cc9f0; color: #000;
                             border: none; border-radius: 4px; cursor: pointer; }
+        .history-list { list-style: none; max-height: 300px; overflow-y: auto; }
+        .history-item { background: #0f0f23; padding: 10px; border-radius: 8px;
+                        margin-bottom: 8px; font-size: 13px; cursor: pointer; }
+        .history-item .history-messages { display: none; margin-top: 8px; opacity: 0.8;
+                                          white-space: pre-wrap; }
+        .history-item.open .history-messages { display: block; }
+        .history-pager { display: flex; justify-content: space-between; align-items: center;
+                         font-size: 13px; }
+        .history-pager button { padding: 4px 10px; background: #4cc9f0; color: #000;
+                                border: none; border-radius: 4px; cursor: pointer; }
         .progress-bar { height: 8px; background: #0f0f23; border-radius: 4px;
                          overflow: hidden; margin-top: 5px; }
         .progress-fill { height: 100%; background: #4cc9f0; border-radius: 4px;
@@ -136,6 +279,26 @@ static const char index_html[] = R"rawliteral(
                     <span class="status-label">缓冲区大小</span>
                     <span class="status-value" id="bufferSize">0 KB</span>
                 </div>
+                <div class="status-item">
+                    <span class="status-label">记忆压缩（节省）</span>
+                    <span class="status-value" id="compressions">-</span>
+                </div>
+                <div class="status-item">
+                    <span class="status-label">压缩输出失败 / 修复（浪费 token）</span>
+                    <span class="status-value" id="compressQuality">-</span>
+                </div>
+                <div class="status-item">
+                    <span class="status-label">对话延迟（平均 / 最大）</span>
+                    <span class="status-value" id="turnLatency">-</span>
+                </div>
+                <div class="status-item">
+                    <span class="status-label">Token（会话 / 今天）</span>
+                    <span class="status-value" id="tokenUsage">-</span>
+                </div>
+                <div class="status-item">
+                    <span class="status-label">Token 预算</span>
+                    <span class="status-value" id="tokenLevel">-</span>
+                </div>
                 <div class="status-item">
                     <span class="status-label">最后更新</span>
                     <span class="status-value" id="lastUpdate">-</span>
@@ -151,6 +314,17 @@ static const char index_html[] = R"rawliteral(
                     <span>当前版本</span>
                 </li>
             </ul>
+            <div class="status-item">
+                <span class="status-label">版本占用</span>
+                <span class="status-value" id="versionStorage">-</span>
+            </div>
+            <h2>📜 对话历史</h2>
+            <ul class="history-list" id="historyList"></ul>
+            <div class="history-pager">
+                <button onclick="loadHistory(historyPage - 1)">上一页</button>
+                <span id="historyPage">-</span>
+                <button onclick="loadHistory(historyPage + 1)">下一页</button>
+            </div>
         </div>
     </div>
 
@@ -223,6 +397,17 @@ static const char index_html[] = R"rawliteral(
             document.getElementById('storageUsage').textContent =
                 data.used_space_kb + ' KB / ' + data.free_space_kb + ' KB';
             document.getElementById('lastUpdate').textContent = data.last_update;
+            document.getElementById('compressions').textContent =
+                data.compressions + '（' + data.compressions_saved + '）';
+            document.getElementById('compressQuality').textContent =
+                data.compress_failures + '/' + data.compress_outputs + ' / ' +
+                data.compress_repairs + '（' + data.compress_wasted_tokens + '）';
+            document.getElementById('turnLatency').textContent =
+                data.avg_turn_latency_ms + ' / ' + data.max_turn_latency_ms + ' ms';
+            document.getElementById('tokenUsage').textContent =
+                data.tokens_session + ' / ' + data.tokens_today;
+            document.getElementById('tokenLevel').textContent =
+                {normal: '正常', economy: '节省模式', exhausted: '已超预算'}[data.token_level] || data.token_level;
 
             const progress = (data.used_space_kb /
                 (data.used_space_kb + data.free_space_kb) * 100).toFixed(1);
@@ -249,7 +434,127 @@ static const char index_html[] = R"rawliteral(
             }).catch(err => {
                 console.error('Failed to refresh memory:', err);
             });
+            refreshVersions();
+
+        // 对话历史（分页，服务端直接定位到对应的压缩块）
+        const HISTORY_PAGE_SIZE = 10;
+        let historyPage = 0;
+        function loadHistory(page) {
+            if (page < 0) return;
+            fetch('/api/history?page=' + page + '&size=' + HISTORY_PAGE_SIZE)
+                .then(r => r.json())
+                .then(data => {
+                    const pages = Math.max(1, Math.ceil(data.total / HISTORY_PAGE_SIZE));
+                    if (page >= pages) return;
+                    historyPage = page;
+                    document.getElementById('historyPage').textContent =
+                        (page + 1) + ' / ' + pages + '（共 ' + data.total + ' 批）';
+                    const list = document.getElementById('historyList');
+                    list.innerHTML = '';
+                    data.sessions.forEach(s => {
+                        const li = document.createElement('li');
+                        li.className = 'history-item';
+                        const title = document.createElement('div');
+                        title.textContent = '#' + s.id + ' ' + new Date(s.end * 1000).toLocaleString() +
+                            ' · ' + s.session.messages.length + ' 条 ' + (s.session.summary || '');
+                        const msgs = document.createElement('div');
+                        msgs.className = 'history-messages';
+                        msgs.textContent = s.session.messages.map(m =>
+                            (m.role === 'user' ? '用户' : '助手') + ': ' + m.content).join('\n');
+                        li.appendChild(title);
+                        li.appendChild(msgs);
+                        li.onclick = () => li.classList.toggle('open');
+                        list.appendChild(li);
+                    });
+                })
+                .catch(err => {
+                    console.error('Failed to load history:', err);
+                });
+        }
+        loadHistory(0);
+        }
+
+        // 版本历史（只读设备端索引，开销很小）
+        function refreshVersions() {
+            fetch('/api/versions').then(r => r.json()).then(data => {
+                const list = document.getElementById('backupList');
+                list.innerHTML = '';
+                data.versions.forEach((v, i) => {
+                    const li = document.createElement('li');
+                    li.className = 'backup-item';
+                    const time = new Date(v.timestamp * 1000).toLocaleString();
+                    const label = document.createElement('span');
+                    label.textContent = 'v' + v.seq + ' ' + v.hash.substring(0, 8) + ' ' + time;
+                    li.appendChild(label);
+                    if (i === 0) {
+                        const cur = document.createElement('span');
+                        cur.textContent = '当前';
+                        li.appendChild(cur);
+                    } else {
+                        const btn = document.createElement('button');
+                        btn.textContent = '回滚';
+                        btn.onclick = () => rollbackTo(v.hash);
+                        li.appendChild(btn);
+                    }
+                    list.appendChild(li);
+                });
+                document.getElementById('versionStorage').textContent =
+                    data.count + ' 个 / ' + (data.stored_bytes / 1024).toFixed(1) + ' KB';
+            }).catch(err => {
+                console.error('Failed to load versions:', err);
+            });
+        }
+
+        function rollbackTo(hash) {
+            if (!confirm('确定回滚到版本 ' + hash.substring(0, 8) + '？')) return;
+            fetch('/api/rollback', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify({ hash: hash })
+            }).then(r => r.json()).then(data => {
+                if (data.status !== 'ok') alert('回滚失败');
+                refreshMemory();
+            });
+        }
+
+        refreshVersions();
+
+        // 对话历史（分页，服务端直接定位到对应的压缩块）
+        const HISTORY_PAGE_SIZE = 10;
+        let historyPage = 0;
+        function loadHistory(page) {
+            if (page < 0) return;
+            fetch('/api/history?page=' + page + '&size=' + HISTORY_PAGE_SIZE)
+                .then(r => r.json())
+                .then(data => {
+                    const pages = Math.max(1, Math.ceil(data.total / HISTORY_PAGE_SIZE));
+                    if (page >= pages) return;
+                    historyPage = page;
+                    document.getElementById('historyPage').textContent =
+                        (page + 1) + ' / ' + pages + '（共 ' + data.total + ' 批）';
+                    const list = document.getElementById('historyList');
+                    list.innerHTML = '';
+                    data.sessions.forEach(s => {
+                        const li = document.createElement('li');
+                        li.className = 'history-item';
+                        const title = document.createElement('div');
+                        title.textContent = '#' + s.id + ' ' + new Date(s.end * 1000).toLocaleString() +
+                            ' · ' + s.session.messages.length + ' 条 ' + (s.session.summary || '');
+                        const msgs = document.createElement('div');
+                        msgs.className = 'history-messages';
+                        msgs.textContent = s.session.messages.map(m =>
+                            (m.role === 'user' ? '用户' : '助手') + ': ' + m.content).join('\n');
+                        li.appendChild(title);
+                        li.appendChild(msgs);
+                        li.onclick = () => li.classList.toggle('open');
+                        list.appendChild(li);
+                    });
+                })
+                .catch(err => {
+                    console.error('Failed to load history:', err);
+                });
         }
+        loadHistory(0);
     </script>
 </body>
 </html>
@@ -284,7 +589,7 @@ bool WebServer::Start() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.max_open_sockets = 7;
-    config.max_uri_handlers = 10;
+    config.max_uri_handlers = 16;
     config.stack_size = 8192;  // 增加任务栈大小到 8KB
     config.task_priority = 5;   // 降低优先级，与压缩任务相同
 
@@ -383,6 +688,38 @@ void WebServer::setup_http_handlers() {
         .user_ctx  = this
     };
     httpd_register_uri_handler(server_, &uri_rollback);
+
+    httpd_uri_t uri_versions = {
+        .uri       = "/api/versions",
+        .method    = HTTP_GET,
+        .handler   = api_versions_handler,
+        .user_ctx  = this
+    };
+    httpd_register_uri_handler(server_, &uri_versions);
+
+    httpd_uri_t uri_history = {
+        .uri       = "/api/history",
+        .method    = HTTP_GET,
+        .handler   = api_history_handler,
+        .user_ctx  = this
+    };
+    httpd_register_uri_handler(server_, &uri_history);
+
+    httpd_uri_t uri_usage = {
+        .uri       = "/api/usage",
+        .method    = HTTP_GET,
+        .handler   = api_usage_handler,
+        .user_ctx  = this
+    };
+    httpd_register_uri_handler(server_, &uri_usage);
+
+    httpd_uri_t uri_budget = {
+        .uri       = "/api/usage/budget",
+        .method    = HTTP_POST,
+        .handler   = api_budget_handler,
+        .user_ctx  = this
+    };
+    httpd_register_uri_handler(server_, &uri_budget);
 }
 
 // HTTP 处理器实现
@@ -426,90 +763,147 @@ esp_err_t WebServer::api_conversation_handler(httpd_req_t *req) {
 
     buf[received] = '\0';
 
-    // 解析 JSON
-    cJSON *json = cJSON_Parse(buf);
-    if (!json) {
+    // 解析 JSON（只取第一层的 role / content）
+    JsonFieldReader json;
+    if (!json.Parse(buf, received)) {
         ESP_LOGE(TAG, "Failed to parse JSON");
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
         return ESP_FAIL;
     }
 
-    cJSON *role_item = cJSON_GetObjectItem(json, "role");
-    cJSON *content_item = cJSON_GetObjectItem(json, "content");
-
-    if (!role_item || !cJSON_IsString(role_item) || !content_item || !cJSON_IsString(content_item)) {
+    std::string role;
+    std::string content;
+    if (!json.GetString("role", role) || !json.GetString("content", content)) {
         ESP_LOGE(TAG, "Invalid JSON format");
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON format");
-        cJSON_Delete(json);
         return ESP_FAIL;
     }
 
-    // 使用 std::string 拷贝内容，避免指针失效
-    std::string role = role_item->valuestring ? role_item->valuestring : "";
-    std::string content = content_item->valuestring ? content_item->valuestring : "";
-    cJSON_Delete(json);
-
     ESP_LOGI(TAG, "Conversation: role=%s, content_len=%d", role.c_str(), content.length());
 
-    // 添加到记忆管理器
+    // 回复在网络任务上经异步请求副本发出，httpd 工作任务立即释放去处理别的
+    // 请求。拿不到副本时不能在这里等回复（最长 CHAT_DEADLINE_MS），在记入
+    // 记忆之前就让前端稍后重试
+    httpd_req_t *async_req = nullptr;
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        ESP_LOGW(TAG, "Async handler unavailable, rejecting chat request");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_set_hdr(req, "Content-Type", "application/json");
+        httpd_resp_send(req, "{\"response\":\"设备忙，请稍后再试。\"}", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    // 添加到记忆管理器（本轮回复发出前不会触发记忆压缩）
     MemoryManager& mgr = MemoryManager::GetInstance();
+    TokenLedger& ledger = TokenLedger::GetInstance();
+    if (mgr.IsBufferEmpty()) {
+        ledger.BeginSession();      // 缓冲区已压缩清空：新的一段对话
+    }
+    mgr.BeginTurn();
     mgr.AddConversation(role, content);
 
-    // 生成 AI 响应
-    std::string ai_response;
-    MemoryPackage memory = mgr.GetMemoryPackage();
-
-    // 构造包含记忆的 prompt
-    std::string prompt = R"(你是 Evo-spark 智能陪伴机器人，根据以下记忆和对话历史，自然地回应用户。
-
-记忆包（JSON）：
-)" + memory.raw_json + R"(
-
-用户消息：)" + content + R"(
+    // 重复的简单输入直接用缓存的回复；人设或记忆变化后旧回复自然失效
+    uint64_t cache_context = ResponseCache::ContextVersion(
+        kChatSystemPrompt, mgr.GetSnapshot()->memory.raw_json);
+    ChatResult cached;
+    if (ResponseCache::GetInstance().Lookup(content, cache_context, cached.content)) {
+        cached.success = true;
+        send_chat_reply(async_req, cached);
+        httpd_req_async_handler_complete(async_req);
+        return ESP_OK;
+    }
 
-请用友好、自然的语气回应。只返回回应内容，不要其他说明。)";
+    // 只注入与本条消息相关的记忆，而不是整个记忆包；接近 token 预算时再缩减
+    std::string memory_context = mgr.BuildMemoryContext(content, ledger.GetLevel());
+
+    // 构造包含记忆的 prompt（编译期模板，一次分配）
+    GLMClient::Request request;
+    request.system = kChatSystemPrompt;
+    RenderTemplate(kChatPrompt, request.message, [&](int slot, auto& sink) {
+        sink.Append(slot == 0 ? memory_context : content);
+    });
+    request.priority = RequestPriority::INTERACTIVE;
+    request.deadline_ms = CHAT_DEADLINE_MS;
+
+    // 回复发出后再存缓存（写 Flash 可能要几百毫秒）
+    GLMClient::GetInstance().Submit(std::move(request),
+        [async_req, content, cache_context](const ChatResult& result) {
+            send_chat_reply(async_req, result);
+            httpd_req_async_handler_complete(async_req);
+            if (result.success) {
+                ResponseCache::GetInstance().Store(content, cache_context, result.content,
+                                                   result.tokens_used, result.latency_ms);
+            }
+        });
+    return ESP_OK;
+}
 
-    GLMClient& glm = GLMClient::GetInstance();
-    if (glm.Chat(prompt, ai_response)) {
-        ESP_LOGI(TAG, "AI response generated: %d bytes", ai_response.length());
+esp_err_t WebServer::api_usage_handler(httpd_req_t *req) {
+    std::string json = TokenLedger::GetInstance().ToJson();
+    httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_send(req, json.c_str(), json.length());
+    return ESP_OK;
+}
 
-        // 添加 AI 响应到记忆
-        mgr.AddConversation("assistant", ai_response);
-
-        // GLMClient 已经解析了响应，ai_response 就是内容文本
-        // 使用 cJSON 生成正确的 JSON 响应（自动转义特殊字符）
-        cJSON *json_root = cJSON_CreateObject();
-        if (json_root) {
-            cJSON_AddStringToObject(json_root, "response", ai_response.c_str());
-            char *json_str = cJSON_PrintUnformatted(json_root);
-
-            if (json_str) {
-                httpd_resp_set_hdr(req, "Content-Type", "application/json");
-                httpd_resp_send(req, json_str, strlen(json_str));
-                free(json_str);
-            } else {
-                httpd_resp_set_hdr(req, "Content-Type", "application/json");
-                httpd_resp_send(req, "{\"response\":\"[解析错误]\"}", HTTPD_RESP_USE_STRLEN);
-            }
+esp_err_t WebServer::api_budget_handler(httpd_req_t *req) {
+    char buf[128];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad Request");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
 
-            cJSON_Delete(json_root);
-            return ESP_OK;
-        }
+    // {"session_tokens": N, "daily_tokens": N}，0 表示不限，缺省的保持不变
+    JsonFieldReader json;
+    if (!json.Parse(buf, ret)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    TokenLedger& ledger = TokenLedger::GetInstance();
+    TokenBudget budget = ledger.GetBudget();
+    double value;
+    if (json.GetNumber("session_tokens", value) && value >= 0) {
+        budget.session_tokens = static_cast<uint32_t>(value);
+    }
+    if (json.GetNumber("daily_tokens", value) && value >= 0) {
+        budget.daily_tokens = static_cast<uint32_t>(value);
     }
 
-    // 生成失败
-    ESP_LOGE(TAG, "Failed to generate AI response");
+    if (ConfigManager::GetInstance().SetTokenBudget(budget.session_tokens,
+                                                    budget.daily_tokens) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save");
+        return ESP_FAIL;
+    }
+    ledger.SetBudget(budget);
     httpd_resp_set_hdr(req, "Content-Type", "application/json");
-    httpd_resp_send(req, "{\"response\":\"抱歉，我暂时无法回应。\"}", HTTPD_RESP_USE_STRLEN);
+    httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
 esp_err_t WebServer::api_memory_handler(httpd_req_t *req) {
-    (void)req;  // Unused parameter
-    MemoryPackage memory = MemoryManager::GetInstance().GetMemoryPackage();
+    // 直接读快照；代数作为 ETag，未变化时返回 304
+    MemorySnapshotPtr snapshot = MemoryManager::GetInstance().GetSnapshot();
+
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%u\"", static_cast<unsigned>(snapshot->generation));
+
+    char if_none_match[16];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                                    sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
 
-    std::string response = "{\"memory\":" + memory.raw_json + "}";
+    std::string response = "{\"memory\":" + snapshot->memory.raw_json + "}";
     httpd_resp_set_hdr(req, "Content-Type", "application/json");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
     httpd_resp_send(req, response.c_str(), response.length());
     return ESP_OK;
 }
@@ -526,9 +920,102 @@ esp_err_t WebServer::api_status_handler(httpd_req_t *req) {
     data.is_idle = mgr.IsBufferEmpty();
     data.last_update = "刚刚";
 
-    std::string response = "{\"monitor\":" + data.to_json() + "}";
+    RetrievalStats retrieval = mgr.GetRetrievalStats();
+    data.retrieval_injected_tokens = retrieval.injected_tokens;
+    data.retrieval_full_tokens = retrieval.full_tokens;
+    data.memory_generation = mgr.GetSnapshot()->generation;
+
+    MessagePoolStats pool = mgr.GetMessagePoolStats();
+    data.pending_messages = pool.in_use;
+    data.pool_overflow = pool.overflow;
+    data.pool_dropped = pool.dropped;
+
+    SchedulerStats sched = mgr.GetSchedulerStats();
+    data.compressions = sched.compressions;
+    data.compressions_saved = sched.legacy_compressions > sched.compressions
+        ? sched.legacy_compressions - sched.compressions : 0;
+    data.avg_turn_latency_ms = sched.avg_turn_latency_ms;
+
+    StructuredOutputStats structured = GLMClient::GetInstance().GetStructuredOutputStats();
+    data.compress_outputs = structured.requests;
+    data.compress_failures = structured.failures;
+    data.compress_repairs = structured.repairs;
+    data.compress_wasted_tokens = structured.wasted_tokens;
+    data.max_turn_latency_ms = sched.max_turn_latency_ms;
+    data.turns_overlapped = sched.turns_overlapped;
+
+    PromptCacheStats cache = GLMClient::GetInstance().GetCacheStats();
+    uint32_t misses = cache.requests - cache.cache_hits;
+    data.cache_requests = cache.requests;
+    data.cache_hits = cache.cache_hits;
+    data.cached_tokens = cache.cached_tokens;
+    data.prompt_tokens = cache.prompt_tokens;
+    data.avg_hit_ms = cache.cache_hits ? cache.hit_latency_ms / cache.cache_hits : 0;
+    data.avg_miss_ms = misses ? cache.miss_latency_ms / misses : 0;
+
+    HttpPoolStats http = HttpConnectionPool::GetInstance().GetStats();
+    data.http_requests = http.requests;
+    data.http_handshakes = http.handshakes;
+    data.http_reused = http.reused;
+    data.handshake_saved_ms = http.SavedMs();
+    data.http_reconnects = http.reconnects;
+    data.avg_handshake_ms = http.handshakes ? http.handshake_total_ms / http.handshakes : 0;
+    data.avg_reconnect_ms = http.reconnects ? http.reconnect_total_ms / http.reconnects : 0;
+    data.connect_internal_bytes = http.connect_internal_bytes;
+
+    DnsCacheStats dns = DnsCache::GetInstance().GetStats();
+    data.dns_hits = dns.hits;
+    data.dns_misses = dns.misses;
+    data.dns_stale = dns.stale;
+
+    LinkStats link = LinkQuality::GetInstance().GetStats();
+    data.link_class = LinkClassToString(link.link);
+    data.link_rssi = link.rssi;
+    data.link_srtt_ms = link.srtt_ms;
+    data.link_uplink_kbps = link.uplink_kbps;
+    data.link_loss_permille = link.loss_permille;
+
+    data.gzip_body_bytes = http.body_bytes;
+    data.gzip_sent_bytes = http.sent_bytes;
+    data.gzip_wire_bytes = http.wire_bytes;
+    data.gzip_decoded_bytes = http.decoded_bytes;
+    data.gzip_deflate_us = http.deflate_us;
+    data.gzip_inflate_us = http.inflate_us;
+
+    RequestQueueStats queue = RequestQueue::GetInstance().GetStats();
+    data.llm_queued = queue.queued;
+    data.llm_in_flight = queue.in_flight;
+    data.llm_expired = queue.expired;
+    data.llm_rejected = queue.rejected;
+    data.llm_max_wait_ms = queue.interactive_wait_max_ms;
+
+    ResponseCacheStats responses = ResponseCache::GetInstance().GetStats();
+    data.resp_cache_lookups = responses.lookups;
+    data.resp_cache_hits = responses.hits;
+    data.resp_cache_entries = responses.entries;
+    data.resp_cache_tokens_saved = responses.tokens_saved;
+    data.resp_cache_saved_ms = responses.latency_saved_ms;
+
+    TokenLedgerSnapshot usage = TokenLedger::GetInstance().GetSnapshot();
+    data.tokens_session = usage.SessionTotal();
+    data.tokens_today = usage.TodayTotal();
+    data.token_level = BudgetLevelToString(usage.level);
+
+    // 写入栈上缓冲区，不经过堆
+    char buf[2048];
+    JsonBufferSink sink(buf, sizeof(buf));
+    JsonWriter<JsonBufferSink> json(sink);
+    json.BeginObject();
+    json.Key("monitor");
+    write_monitor(json, data);
+    json.EndObject();
+    if (sink.Overflowed()) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Status too large");
+        return ESP_FAIL;
+    }
+
     httpd_resp_set_hdr(req, "Content-Type", "application/json");
-    httpd_resp_send(req, response.c_str(), response.length());
+    httpd_resp_send(req, sink.Data(), sink.Size());
     return ESP_OK;
 }
 
@@ -558,19 +1045,21 @@ esp_err_t WebServer::api_rollback_handler(httpd_req_t *req) {
 
     buf[received] = '\0';
 
-    cJSON *json = cJSON_Parse(buf);
-    cJSON *version_item = cJSON_GetObjectItem(json, "version");
-    if (!version_item || !cJSON_IsNumber(version_item)) {
+    // 支持 {"version": N} 或 {"hash": "..."}
+    JsonFieldReader json;
+    std::string hash;
+    double version = 0;
+    bool valid = json.Parse(buf, received);
+    bool has_hash = valid && json.GetString("hash", hash);
+    bool has_version = valid && json.GetNumber("version", version);
+    if (!has_version && !has_hash) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON format");
-        cJSON_Delete(json);
         return ESP_FAIL;
     }
 
-    int version = version_item->valueint;
-    cJSON_Delete(json);
-
     MemoryManager& mgr = MemoryManager::GetInstance();
-    bool success = mgr.RollbackToBackup(version);
+    bool success = has_hash ? mgr.RollbackToHash(hash)
+                            : mgr.RollbackToBackup(static_cast<int>(version));
 
     std::string response = success ? "{\"status\":\"ok\"}" : "{\"status\":\"error\"}";
     httpd_resp_set_hdr(req, "Content-Type", "application/json");
@@ -578,6 +1067,96 @@ esp_err_t WebServer::api_rollback_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+esp_err_t WebServer::api_versions_handler(httpd_req_t *req) {
+    // 只读内存中的版本索引，不访问 Flash
+    std::vector<VersionInfo> versions = MemoryManager::GetInstance().GetVersionHistory();
+
+    size_t stored_bytes = 0;
+    return send_json_chunked(req, [&](auto& json) {
+        json.BeginObject();
+        json.Key("versions");
+        json.BeginArray();
+        for (const VersionInfo& v : versions) {
+            stored_bytes += v.stored_size;
+            json.BeginObject();
+            json.Field("seq", v.seq);
+            json.Field("hash", v.hash);
+            json.Field("timestamp", static_cast<long long>(v.timestamp));
+            json.Field("size", v.size);
+            json.Field("stored", v.stored_size);
+            json.Field("base", v.is_base);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Field("count", versions.size());
+        json.Field("stored_bytes", stored_bytes);
+        json.EndObject();
+    });
+}
+
+esp_err_t WebServer::api_history_handler(httpd_req_t *req) {
+    // 参数：page / size（按页），before（按时间），id（单批对话）
+    size_t page = 0;
+    size_t size = 10;
+    long long before = -1;
+    long long id = -1;
+
+    char query[128];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char value[24];
+        if (httpd_query_key_value(query, "page", value, sizeof(value)) == ESP_OK) {
+            page = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "size", value, sizeof(value)) == ESP_OK) {
+            size = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "before", value, sizeof(value)) == ESP_OK) {
+            before = strtoll(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+            id = strtoll(value, NULL, 10);
+        }
+    }
+
+    SessionArchive& archive = MemoryManager::GetInstance().GetSessionArchive();
+
+    std::vector<std::string> records;
+    bool ok;
+    if (id > 0) {
+        std::string record;
+        ok = archive.GetSession(static_cast<uint32_t>(id), record);
+        if (ok) {
+            records.push_back(record);
+        }
+    } else if (before >= 0) {
+        ok = archive.GetPageBefore(static_cast<std::time_t>(before), size, records);
+    } else {
+        ok = archive.GetPage(page, size, records);
+    }
+
+    if (!ok) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_FAIL;
+    }
+
+    // 归档记录本身就是 JSON，原样写入
+    return send_json_chunked(req, [&](auto& json) {
+        json.BeginObject();
+        json.Field("total", archive.Count());
+        json.Field("page", page);
+        json.Field("size", size);
+        json.Field("raw_bytes", archive.GetRawBytes());
+        json.Field("stored_bytes", archive.GetStoredBytes());
+        json.Key("sessions");
+        json.BeginArray();
+        for (const std::string& record : records) {
+            json.Raw(record);
+        }
+        json.EndArray();
+        json.EndObject();
+    });
+}
+
 // 监控定时器 - 已移除，前端使用 HTTP 轮询
 /*
 void WebServer::start_monitor_timer() {
@@ -616,6 +1195,10 @@ void WebServer::on_monitor_timer() {
     data.used_space_kb = mgr.GetUsedSpace() / 1024;
     data.is_idle = mgr.IsBufferEmpty();
     data.last_update = "刚刚";
+
+    RetrievalStats retrieval = mgr.GetRetrievalStats();
+    data.retrieval_injected_tokens = retrieval.injected_tokens;
+    data.retrieval_full_tokens = retrieval.full_tokens;
 }
 */
 
@@ -888,35 +1471,17 @@ esp_err_t WebServer::api_config_handler(httpd_req_t *req) {
 
     ESP_LOGI(TAG, "Received config request: %s", buf);
 
-    // 简单的 JSON 解析（提取 ssid, password, api_key）
-    std::string ssid = "", password = "", api_key = "";
-
-    char* p = strstr(buf, "\"ssid\":\"");
-    if (p) {
-        p += 8;
-        char* end = strstr(p, "\"");
-        if (end) {
-            ssid = std::string(p, end - p);
-        }
-    }
-
-    p = strstr(buf, "\"password\":\"");
-    if (p) {
-        p += 12;
-        char* end = strstr(p, "\"");
-        if (end) {
-            password = std::string(p, end - p);
-        }
+    // 解析 JSON（提取 ssid, password, api_key）
+    JsonFieldReader json;
+    if (!json.Parse(buf, received)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
     }
 
-    p = strstr(buf, "\"api_key\":\"");
-    if (p) {
-        p += 11;
-        char* end = strstr(p, "\"");
-        if (end) {
-            api_key = std::string(p, end - p);
-        }
-    }
+    std::string ssid, password, api_key;
+    json.GetString("ssid", ssid);
+    json.GetString("password", password);
+    json.GetString("api_key", api_key);
 
     ESP_LOGI(TAG, "Parsed config - SSID: %s, API Key: %s***",
              ssid.c_str(),
@@ -2,6 +2,7 @@
 #define WEB_SERVER_H
 
 #include <string>
+#include <cstdint>
 #include <esp_http_server.h>
 #include <esp_timer.h>
 #include "esp_log.h"
@@ -17,6 +18,62 @@ struct MonitorData {
     size_t used_space_kb;
     bool is_idle;
     std::string last_update;
+    uint64_t retrieval_injected_tokens;  // 检索注入的记忆 token 累计
+    uint64_t retrieval_full_tokens;      // 全量注入时的 token 累计（对照）
+    uint32_t memory_generation;          // 当前记忆快照代数
+    size_t pending_messages;             // 消息池中待处理的消息
+    uint32_t pool_overflow;              // 消息槽用尽后堆分配的次数
+    uint32_t pool_dropped;               // 内存耗尽、没能记入记忆的消息
+    uint32_t compressions;               // 实际执行的记忆压缩次数
+    uint32_t compressions_saved;         // 相比每 10 条压缩一次节省的次数
+    uint32_t compress_outputs;           // 要求结构化输出的压缩请求
+    uint32_t compress_failures;          // 修复后仍不合格或请求失败
+    uint32_t compress_repairs;           // 发出的修复请求
+    uint64_t compress_wasted_tokens;     // 不合格输出花掉的 token
+    uint32_t avg_turn_latency_ms;        // 对话平均延迟
+    uint32_t max_turn_latency_ms;        // 对话最大延迟
+    uint32_t turns_overlapped;           // 与记忆压缩重叠的对话轮数
+    uint32_t cache_requests;             // 统计前缀缓存的请求数
+    uint32_t cache_hits;                 // 命中前缀缓存的请求数
+    uint64_t cached_tokens;              // 命中缓存的 prompt token 累计
+    uint64_t prompt_tokens;              // prompt token 累计
+    uint64_t avg_hit_ms;                 // 命中请求平均耗时
+    uint64_t avg_miss_ms;                // 未命中请求平均耗时
+    uint32_t http_requests;              // 经连接池发出的请求数
+    uint32_t http_handshakes;            // 新建连接（完整握手）次数
+    uint32_t http_reused;                // 复用长连接的请求数
+    uint64_t handshake_saved_ms;         // 复用省下的握手时间
+    uint32_t http_reconnects;            // 带会话票据的重连次数
+    uint64_t avg_handshake_ms;           // 完整握手平均耗时
+    uint64_t avg_reconnect_ms;           // 重连（会话恢复）平均耗时
+    uint32_t connect_internal_bytes;     // 最近一次建连占用的内部 RAM
+    uint32_t dns_hits;                   // DNS 缓存命中
+    uint32_t dns_misses;                 // 实际发出的 DNS 查询
+    uint32_t dns_stale;                  // 查询失败时用旧地址的次数
+    std::string link_class;              // 链路等级（good / fair / poor）
+    int link_rssi;                       // 平滑后的 RSSI（dBm）
+    uint32_t link_srtt_ms;               // 平滑往返时间
+    uint32_t link_uplink_kbps;           // 上行吞吐估计
+    uint32_t link_loss_permille;         // 请求失败率（‰）
+    uint64_t gzip_body_bytes;            // 请求体原始字节数
+    uint64_t gzip_sent_bytes;            // 请求体实际发送字节数（压缩后）
+    uint64_t gzip_wire_bytes;            // 响应体实际接收字节数
+    uint64_t gzip_decoded_bytes;         // 响应体解压后字节数
+    uint64_t gzip_deflate_us;            // 压缩累计耗时
+    uint64_t gzip_inflate_us;            // 解压累计耗时
+    uint32_t llm_queued;                 // 网络任务队列中等待的请求
+    uint32_t llm_in_flight;              // 正在执行的请求
+    uint32_t llm_expired;                // 排队超过截止时间的请求
+    uint32_t llm_rejected;               // 队列满被拒绝的请求
+    uint32_t llm_max_wait_ms;            // 交互请求最长排队时间
+    uint32_t resp_cache_lookups;         // 回复缓存查找次数
+    uint32_t resp_cache_hits;            // 回复缓存命中次数
+    uint32_t resp_cache_entries;         // 当前缓存的回复数
+    uint64_t resp_cache_tokens_saved;    // 命中省下的 token
+    uint64_t resp_cache_saved_ms;        // 命中省下的请求耗时
+    uint64_t tokens_session;             // 本次会话 token 用量
+    uint64_t tokens_today;               // 今天 token 用量
+    std::string token_level;             // 预算状态 normal / economy / exhausted
 
     std::string to_json() const;
 };
@@ -47,6 +104,10 @@ private:
     static esp_err_t api_memory_handler(httpd_req_t *req);
     static esp_err_t api_status_handler(httpd_req_t *req);
     static esp_err_t api_rollback_handler(httpd_req_t *req);
+    static esp_err_t api_versions_handler(httpd_req_t *req);
+    static esp_err_t api_history_handler(httpd_req_t *req);
+    static esp_err_t api_usage_handler(httpd_req_t *req);
+    static esp_err_t api_budget_handler(httpd_req_t *req);
 
     // 辅助方法
     void setup_http_handlers();
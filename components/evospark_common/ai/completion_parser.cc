@@ -0,0 +1,66 @@
+#include "completion_parser.h"
+#include <algorithm>
+
+namespace EvoSpark {
+
+bool CompletionHandler::OnKey(const char* key, size_t length) {
+    if (depth_ <= MAX_TRACKED) {
+        frames_[depth_ - 1].key.assign(key, std::min(length, MAX_KEY));
+    }
+    return true;
+}
+
+bool CompletionHandler::OnString(const char* value, size_t length) {
+    BeginElement();
+    // choices[0].<container>.content
+    if (depth_ == 4 && KeyIs(0, "choices") && frames_[1].index == 0 &&
+        KeyIs(2, container_) && KeyIs(3, "content")) {
+        content_.assign(value, length);
+        found_content_ = true;
+    }
+    return true;
+}
+
+bool CompletionHandler::OnNumber(double value, const char*, size_t) {
+    BeginElement();
+    if (!KeyIs(0, "usage")) {
+        return true;
+    }
+    int n = static_cast<int>(value);
+    usage_.present = true;
+    if (depth_ == 2) {
+        if (KeyIs(1, "total_tokens")) usage_.total_tokens = n;
+        else if (KeyIs(1, "prompt_tokens")) usage_.prompt_tokens = n;
+        else if (KeyIs(1, "completion_tokens")) usage_.completion_tokens = n;
+    } else if (depth_ == 3 && KeyIs(1, "prompt_tokens_details") &&
+               KeyIs(2, "cached_tokens")) {
+        usage_.cached_tokens = n;
+    }
+    return true;
+}
+
+void CompletionHandler::BeginElement() {
+    // 数组中每出现一个元素，序号加一
+    if (depth_ > 0 && depth_ <= MAX_TRACKED && !frames_[depth_ - 1].object) {
+        frames_[depth_ - 1].index++;
+    }
+}
+
+bool CompletionHandler::Push(bool object) {
+    BeginElement();
+    depth_++;
+    if (depth_ <= MAX_TRACKED) {
+        Frame& f = frames_[depth_ - 1];
+        f.object = object;
+        f.index = -1;
+        f.key.clear();
+    }
+    return true;
+}
+
+bool CompletionHandler::KeyIs(int level, const char* key) const {
+    return level < depth_ && level < MAX_TRACKED &&
+           frames_[level].object && frames_[level].key == key;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,63 @@
+#ifndef COMPLETION_PARSER_H
+#define COMPLETION_PARSER_H
+
+#include <string>
+#include "json_codec.h"
+
+namespace EvoSpark {
+
+// 补全响应中的 usage
+struct CompletionUsage {
+    bool present = false;        // 响应中带有 usage（流式响应只有最后一个事件带）
+    int prompt_tokens = 0;
+    int completion_tokens = 0;
+    int total_tokens = 0;
+    int cached_tokens = 0;       // 命中服务端前缀缓存的 prompt token
+};
+
+// OpenAI 兼容补全响应的 SAX 处理
+//
+// 只取 choices[0].<container>.content 和 usage，其余字段边解析边丢弃，
+// 不建 cJSON 树。container 为 "message"（完整响应）或 "delta"（流式事件）
+class CompletionHandler : public JsonHandler {
+public:
+    CompletionHandler(const char* container, std::string& content, CompletionUsage& usage)
+        : container_(container), content_(content), usage_(usage) {}
+
+    bool FoundContent() const { return found_content_; }
+
+    bool OnKey(const char* key, size_t length) override;
+    bool OnString(const char* value, size_t length) override;
+    bool OnNumber(double value, const char* raw, size_t raw_length) override;
+    bool OnNull() override { BeginElement(); return true; }
+    bool OnBool(bool) override { BeginElement(); return true; }
+    bool OnBeginObject() override { return Push(true); }
+    bool OnBeginArray() override { return Push(false); }
+    bool OnEndObject() override { depth_--; return true; }
+    bool OnEndArray() override { depth_--; return true; }
+
+private:
+    static constexpr int MAX_TRACKED = 4;
+    static constexpr size_t MAX_KEY = 24;
+
+    struct Frame {
+        bool object = false;
+        int index = -1;       // 数组层：当前元素序号
+        std::string key;      // 对象层：当前键
+    };
+
+    void BeginElement();
+    bool Push(bool object);
+    bool KeyIs(int level, const char* key) const;
+
+    const char* container_;
+    std::string& content_;
+    CompletionUsage& usage_;
+    Frame frames_[MAX_TRACKED];
+    int depth_ = 0;
+    bool found_content_ = false;
+};
+
+} // namespace EvoSpark
+
+#endif // COMPLETION_PARSER_H
@@ -0,0 +1,160 @@
+#include "dns_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace EvoSpark {
+
+static const char* TAG = "DnsCache";
+
+bool DnsCache::Lookup(const std::string& host, std::string& address, bool allow_stale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    int64_t limit_us = static_cast<int64_t>(allow_stale ? STALE_S : TTL_S) * 1000000;
+    if (!allow_stale) {
+        stats_.lookups++;
+    }
+    for (const Entry& entry : entries_) {
+        if (entry.host == host && now - entry.resolved_us < limit_us) {
+            address = entry.address;
+            if (!allow_stale) {
+                stats_.hits++;
+            }
+            return true;
+        }
+    }
+    if (!allow_stale) {
+        stats_.misses++;
+    }
+    return false;
+}
+
+void DnsCache::Store(const std::string& host, const std::string& address, uint32_t lookup_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookup_total_ms += lookup_ms;
+    stats_.lookup_max_ms = std::max(stats_.lookup_max_ms, lookup_ms);
+
+    Entry* slot = nullptr;
+    for (Entry& entry : entries_) {
+        if (entry.host == host) {
+            slot = &entry;
+            break;
+        }
+    }
+    if (!slot) {
+        if (entries_.size() >= MAX_ENTRIES) {
+            // 满了换掉最早解析的
+            auto oldest = std::min_element(entries_.begin(), entries_.end(),
+                [](const Entry& a, const Entry& b) { return a.resolved_us < b.resolved_us; });
+            entries_.erase(oldest);
+        }
+        entries_.push_back(Entry());
+        slot = &entries_.back();
+        slot->host = host;
+    }
+    if (slot->address != address && !slot->address.empty()) {
+        ESP_LOGI(TAG, "%s moved from %s to %s", host.c_str(), slot->address.c_str(), address.c_str());
+    }
+    slot->address = address;
+    slot->resolved_us = esp_timer_get_time();
+}
+
+void DnsCache::RecordFailure(bool served_stale, uint32_t lookup_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookup_total_ms += lookup_ms;
+    stats_.lookup_max_ms = std::max(stats_.lookup_max_ms, lookup_ms);
+    if (served_stale) {
+        stats_.stale++;
+    } else {
+        stats_.failures++;
+    }
+}
+
+void DnsCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+DnsCacheStats DnsCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DnsCacheStats stats = stats_;
+    stats.entries = static_cast<uint32_t>(entries_.size());
+    return stats;
+}
+
+} // namespace EvoSpark
+
+// ==================== lwip_getaddrinfo 包装 ====================
+//
+// CMakeLists.txt 里以 -Wl,--wrap=lwip_getaddrinfo 链接，esp-tls 等组件
+// 对 lwip_getaddrinfo 的调用都会先到这里。只缓存 IPv4：结果仍由原函数
+// 生成（传入数字地址时它不发查询），释放照常用 lwip_freeaddrinfo
+
+extern "C" int __real_lwip_getaddrinfo(const char* nodename, const char* servname,
+                                       const struct addrinfo* hints, struct addrinfo** res);
+
+namespace {
+
+bool IsNumericHost(const char* host) {
+    for (const char* p = host; *p; p++) {
+        if ((*p < '0' || *p > '9') && *p != '.' && *p != ':') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FirstIpv4(const struct addrinfo* info, std::string& address) {
+    for (const struct addrinfo* ai = info; ai; ai = ai->ai_next) {
+        if (ai->ai_family != AF_INET || !ai->ai_addr) {
+            continue;
+        }
+        const struct sockaddr_in* sin = reinterpret_cast<const struct sockaddr_in*>(ai->ai_addr);
+        const uint8_t* b = reinterpret_cast<const uint8_t*>(&sin->sin_addr.s_addr);
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+        address = text;
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+extern "C" int __wrap_lwip_getaddrinfo(const char* nodename, const char* servname,
+                                       const struct addrinfo* hints, struct addrinfo** res) {
+    using EvoSpark::DnsCache;
+
+    bool ipv4 = !hints || hints->ai_family == AF_UNSPEC || hints->ai_family == AF_INET;
+    if (!nodename || !ipv4 || IsNumericHost(nodename)) {
+        return __real_lwip_getaddrinfo(nodename, servname, hints, res);
+    }
+
+    DnsCache& cache = DnsCache::GetInstance();
+    std::string address;
+    if (cache.Lookup(nodename, address)) {
+        return __real_lwip_getaddrinfo(address.c_str(), servname, hints, res);
+    }
+
+    int64_t start = esp_timer_get_time();
+    int ret = __real_lwip_getaddrinfo(nodename, servname, hints, res);
+    uint32_t elapsed_ms = static_cast<uint32_t>((esp_timer_get_time() - start) / 1000);
+    if (ret == 0) {
+        if (FirstIpv4(*res, address)) {
+            cache.Store(nodename, address, elapsed_ms);
+        }
+        return ret;
+    }
+
+    // 查询失败：旧地址多半仍然可用，总比连接直接失败好
+    bool stale = cache.Lookup(nodename, address, true);
+    cache.RecordFailure(stale, elapsed_ms);
+    if (stale) {
+        ESP_LOGW(EvoSpark::TAG, "DNS lookup for %s failed, using cached %s", nodename, address.c_str());
+        return __real_lwip_getaddrinfo(address.c_str(), servname, hints, res);
+    }
+    return ret;
+}
@@ -0,0 +1,78 @@
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EvoSpark {
+
+// DNS 缓存统计
+struct DnsCacheStats {
+    uint32_t lookups = 0;
+    uint32_t hits = 0;              // 直接用缓存的地址，没有发出查询
+    uint32_t misses = 0;            // 发出了查询
+    uint32_t stale = 0;             // 查询失败，用了过期的旧地址
+    uint32_t failures = 0;          // 查询失败且没有旧地址可用
+    uint64_t lookup_total_ms = 0;   // 实际查询的累计耗时（含失败的）
+    uint32_t lookup_max_ms = 0;
+    uint32_t entries = 0;
+};
+
+// 主机名 → IPv4 地址缓存，有效期 TTL_S
+//
+// esp-tls 建立连接时经 lwip_getaddrinfo 解析主机名。链接时用 --wrap 把它
+// 换成 dns_cache.cc 里的包装：缓存有效时直接把地址字符串交给原函数（数字
+// 地址不发查询），否则照常查询并记下结果。
+//
+// lwIP 自己的 DNS 表只有 4 项，按服务端 TTL（常见 60 秒）过期，过期后的
+// 第一次请求要多等一次 DNS 往返；查询失败（Wi-Fi 刚重连、DNS 服务器不通）
+// 时连接直接失败。这里再缓存 TTL_S 秒，服务端换地址时最多晚 TTL_S 发现；
+// 过期后查询失败的，STALE_S 内继续用旧地址。
+class DnsCache {
+public:
+    static DnsCache& GetInstance() {
+        static DnsCache instance;
+        return instance;
+    }
+
+    // 有效的缓存地址；allow_stale 时过期未超过 STALE_S 的也算
+    bool Lookup(const std::string& host, std::string& address, bool allow_stale = false);
+
+    // 记下一次查询结果和耗时
+    void Store(const std::string& host, const std::string& address, uint32_t lookup_ms);
+
+    // 记一次查询失败（是否用上了旧地址）和耗时
+    void RecordFailure(bool served_stale, uint32_t lookup_ms);
+
+    void Clear();
+
+    DnsCacheStats GetStats() const;
+
+    static constexpr uint32_t TTL_S = 300;
+    static constexpr uint32_t STALE_S = 3600;
+    static constexpr size_t MAX_ENTRIES = 8;
+
+private:
+    DnsCache() = default;
+    ~DnsCache() = default;
+
+    DnsCache(const DnsCache&) = delete;
+    DnsCache& operator=(const DnsCache&) = delete;
+
+    struct Entry {
+        std::string host;
+        std::string address;
+        int64_t resolved_us;        // esp_timer 时间
+    };
+
+    std::vector<Entry> entries_;
+    DnsCacheStats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // DNS_CACHE_H
@@ -0,0 +1,319 @@
+#include "gzip_codec.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "rom/miniz.h"
+#include <algorithm>
+#include <cstring>
+
+namespace EvoSpark {
+
+static const char* TAG = "Gzip";
+
+namespace {
+
+// gzip 头部标志位（RFC 1952）
+constexpr uint8_t FLAG_HCRC = 0x02;
+constexpr uint8_t FLAG_EXTRA = 0x04;
+constexpr uint8_t FLAG_NAME = 0x08;
+constexpr uint8_t FLAG_COMMENT = 0x10;
+constexpr uint8_t FLAG_RESERVED = 0xE0;
+
+void* AllocPsram(size_t size) {
+    void* p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!p) {
+        p = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    return p;
+}
+
+void AppendLe32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+mz_bool PutBuf(const void* data, int length, void* user) {
+    static_cast<std::string*>(user)->append(static_cast<const char*>(data), length);
+    return MZ_TRUE;
+}
+
+} // namespace
+
+// ==================== GzipEncoder ====================
+
+GzipEncoder::~GzipEncoder() {
+    Release();
+}
+
+void GzipEncoder::Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (compressor_) {
+        heap_caps_free(compressor_);
+        compressor_ = nullptr;
+    }
+}
+
+bool GzipEncoder::Compress(const char* data, size_t length, std::string& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!compressor_) {
+        // 压缩器状态太大，内部 RAM 放不下，只用 PSRAM
+        compressor_ = heap_caps_malloc(sizeof(tdefl_compressor), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!compressor_) {
+            ESP_LOGE(TAG, "No PSRAM for the compressor (%zu bytes)", sizeof(tdefl_compressor));
+            return false;
+        }
+    }
+    tdefl_compressor* comp = static_cast<tdefl_compressor*>(compressor_);
+
+    // 固定 10 字节头部：无文件名、无时间戳，OS = unknown
+    static const char header[10] = {
+        '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'
+    };
+    out.clear();
+    out.reserve(length / 3 + 64);
+    out.append(header, sizeof(header));
+
+    // 原始 deflate 流（不带 zlib 头），直接追加到 out
+    if (tdefl_init(comp, PutBuf, &out, PROBES | TDEFL_GREEDY_PARSING_FLAG) != TDEFL_STATUS_OKAY ||
+        tdefl_compress_buffer(comp, data, length, TDEFL_FINISH) != TDEFL_STATUS_DONE) {
+        ESP_LOGE(TAG, "Deflate failed");
+        out.clear();
+        return false;
+    }
+
+    AppendLe32(out, esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(data), length));
+    AppendLe32(out, static_cast<uint32_t>(length));
+    return true;
+}
+
+// ==================== GzipDecoder ====================
+
+GzipDecoder::GzipDecoder() = default;
+
+GzipDecoder::~GzipDecoder() {
+    if (inflator_) {
+        heap_caps_free(inflator_);
+    }
+    if (window_) {
+        heap_caps_free(window_);
+    }
+}
+
+bool GzipDecoder::Allocate() {
+    if (!inflator_) {
+        inflator_ = static_cast<tinfl_decompressor*>(AllocPsram(sizeof(tinfl_decompressor)));
+    }
+    if (!window_) {
+        window_ = static_cast<uint8_t*>(AllocPsram(WINDOW_SIZE));
+    }
+    return inflator_ && window_;
+}
+
+void GzipDecoder::Reset(const DataHandler* on_data) {
+    on_data_ = on_data;
+    state_ = State::HEADER;
+    header_pos_ = 0;
+    flags_ = 0;
+    extra_left_ = 0;
+    hcrc_left_ = 2;
+    trailer_pos_ = 0;
+    window_pos_ = 0;
+    crc_ = 0;
+    input_bytes_ = 0;
+    output_bytes_ = 0;
+}
+
+bool GzipDecoder::Fail(const char* reason) {
+    ESP_LOGE(TAG, "Invalid gzip stream: %s", reason);
+    state_ = State::FAILED;
+    return false;
+}
+
+void GzipDecoder::Emit(const uint8_t* data, size_t length) {
+    crc_ = esp_rom_crc32_le(crc_, data, length);
+    output_bytes_ += length;
+    if (on_data_ && *on_data_) {
+        (*on_data_)(reinterpret_cast<const char*>(data), length);
+    }
+}
+
+bool GzipDecoder::FeedHeader(const uint8_t*& data, size_t& length) {
+    while (length > 0) {
+        if (header_pos_ < 10) {
+            size_t n = std::min(length, 10 - header_pos_);
+            memcpy(header_ + header_pos_, data, n);
+            header_pos_ += n;
+            data += n;
+            length -= n;
+            if (header_pos_ < 10) {
+                return true;
+            }
+            if (header_[0] != 0x1f || header_[1] != 0x8b || header_[2] != 8) {
+                return Fail("bad magic");
+            }
+            flags_ = header_[3];
+            if (flags_ & FLAG_RESERVED) {
+                return Fail("reserved flags set");
+            }
+            continue;
+        }
+
+        if (flags_ & FLAG_EXTRA) {
+            if (header_pos_ < 12) {
+                header_[header_pos_++] = *data++;
+                length--;
+                if (header_pos_ == 12) {
+                    extra_left_ = header_[10] | (header_[11] << 8);
+                }
+                continue;
+            }
+            size_t n = std::min(length, extra_left_);
+            data += n;
+            length -= n;
+            extra_left_ -= n;
+            if (extra_left_ == 0) {
+                flags_ &= ~FLAG_EXTRA;
+            }
+            continue;
+        }
+
+        // 文件名和注释都以 '\0' 结尾
+        if (flags_ & (FLAG_NAME | FLAG_COMMENT)) {
+            const void* end = memchr(data, 0, length);
+            if (!end) {
+                data += length;
+                length = 0;
+                return true;
+            }
+            size_t n = static_cast<const uint8_t*>(end) - data + 1;
+            data += n;
+            length -= n;
+            flags_ &= (flags_ & FLAG_NAME) ? ~FLAG_NAME : ~FLAG_COMMENT;
+            continue;
+        }
+
+        if (flags_ & FLAG_HCRC) {
+            size_t n = std::min(length, hcrc_left_);
+            data += n;
+            length -= n;
+            hcrc_left_ -= n;
+            if (hcrc_left_ == 0) {
+                flags_ &= ~FLAG_HCRC;
+            }
+            continue;
+        }
+
+        tinfl_init(inflator_);
+        state_ = State::BODY;
+        return true;
+    }
+    return true;
+}
+
+bool GzipDecoder::Inflate(const uint8_t*& data, size_t& length) {
+    for (;;) {
+        size_t in_size = length;
+        size_t out_size = WINDOW_SIZE - window_pos_;
+        tinfl_status status = tinfl_decompress(inflator_, data, &in_size,
+                                               window_, window_ + window_pos_, &out_size,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_size;
+        length -= in_size;
+
+        if (out_size > 0) {
+            Emit(window_ + window_pos_, out_size);
+            window_pos_ = (window_pos_ + out_size) & (WINDOW_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            // tinfl 可能多读了几个字节进位缓冲区，把它们还给结尾校验
+            while (inflator_->m_num_bits >= 8 && trailer_pos_ < sizeof(trailer_)) {
+                trailer_[trailer_pos_++] = static_cast<uint8_t>(inflator_->m_bit_buf & 0xFF);
+                inflator_->m_bit_buf >>= 8;
+                inflator_->m_num_bits -= 8;
+            }
+            state_ = trailer_pos_ == sizeof(trailer_) ? State::DONE : State::TRAILER;
+            return true;
+        }
+        if (status < 0) {
+            return Fail("corrupt deflate data");
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return true;
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT：窗口写满，交出后继续
+    }
+}
+
+bool GzipDecoder::Feed(const char* data, size_t length) {
+    if (state_ == State::FAILED) {
+        return false;
+    }
+    if (!Allocate()) {
+        ESP_LOGE(TAG, "Out of memory for the inflate window");
+        state_ = State::FAILED;
+        return false;
+    }
+
+    input_bytes_ += length;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    while (length > 0) {
+        switch (state_) {
+            case State::HEADER:
+                if (!FeedHeader(p, length)) {
+                    return false;
+                }
+                break;
+            case State::BODY:
+                if (!Inflate(p, length)) {
+                    return false;
+                }
+                break;
+            case State::TRAILER: {
+                size_t n = std::min(length, sizeof(trailer_) - trailer_pos_);
+                memcpy(trailer_ + trailer_pos_, p, n);
+                trailer_pos_ += n;
+                p += n;
+                length -= n;
+                if (trailer_pos_ == sizeof(trailer_)) {
+                    state_ = State::DONE;
+                }
+                break;
+            }
+            case State::DONE:
+                // 多个 gzip 成员拼接的情况 LLM 接口不会出现，多余数据忽略
+                ESP_LOGW(TAG, "Ignoring %zu bytes after the gzip stream", length);
+                return true;
+            case State::FAILED:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool GzipDecoder::Finish() {
+    if (state_ == State::FAILED) {
+        return false;
+    }
+    if (state_ == State::TRAILER && trailer_pos_ == sizeof(trailer_)) {
+        state_ = State::DONE;
+    }
+    if (state_ != State::DONE) {
+        return Fail("truncated");
+    }
+    if (ReadLe32(trailer_) != crc_) {
+        return Fail("CRC mismatch");
+    }
+    if (ReadLe32(trailer_ + 4) != static_cast<uint32_t>(output_bytes_)) {
+        return Fail("length mismatch");
+    }
+    return true;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,106 @@
+#ifndef GZIP_CODEC_H
+#define GZIP_CODEC_H
+
+#include <string>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+struct tinfl_decompressor_tag;
+
+namespace EvoSpark {
+
+// gzip 压缩（请求体）
+//
+// 使用 ROM 内置的 miniz（tdefl），不占 Flash。压缩器状态约 300KB，
+// 首次使用时在 PSRAM 中分配并一直复用；同一时刻只有一个请求在压缩，
+// 用互斥锁串行化。为节省 CPU 使用贪心匹配和较少的探测次数：JSON 重复度
+// 很高，压缩率与默认级别相差不大，耗时少一半以上。
+class GzipEncoder {
+public:
+    static GzipEncoder& GetInstance() {
+        static GzipEncoder instance;
+        return instance;
+    }
+
+    // 把 data 压缩成完整的 gzip 流写入 out；内存不足或压缩失败返回 false
+    bool Compress(const char* data, size_t length, std::string& out);
+
+    // 释放压缩器状态（长时间不用时归还 PSRAM）
+    void Release();
+
+    static constexpr int PROBES = 16;
+
+private:
+    GzipEncoder() = default;
+    ~GzipEncoder();
+
+    GzipEncoder(const GzipEncoder&) = delete;
+    GzipEncoder& operator=(const GzipEncoder&) = delete;
+
+    void* compressor_ = nullptr;    // tdefl_compressor（miniz 中是匿名结构体，无法前向声明）
+    std::mutex mutex_;
+};
+
+// gzip 流式解压（响应体）
+//
+// 响应体按到达顺序 Feed，解出的数据立即交给 on_data，不缓存整个压缩流。
+// 解压窗口（32KB，deflate 回溯距离上限）和 tinfl 状态分配在 PSRAM，
+// 对象可跨请求复用（Reset），每次请求不再重新分配。gzip 头部可被任意
+// 切分在多次 Feed 之间；结尾的 CRC32 和原始长度在 Finish 时校验。
+class GzipDecoder {
+public:
+    using DataHandler = std::function<void(const char* data, size_t length)>;
+
+    GzipDecoder();
+    ~GzipDecoder();
+
+    GzipDecoder(const GzipDecoder&) = delete;
+    GzipDecoder& operator=(const GzipDecoder&) = delete;
+
+    // 开始新的流；解出的数据交给 on_data
+    void Reset(const DataHandler* on_data);
+
+    // 输入一段压缩数据；格式错误或内存不足时返回 false，之后的数据全部丢弃
+    bool Feed(const char* data, size_t length);
+
+    // 输入结束：流必须完整且校验通过
+    bool Finish();
+
+    bool Failed() const { return state_ == State::FAILED; }
+    size_t InputBytes() const { return input_bytes_; }
+    size_t OutputBytes() const { return output_bytes_; }
+
+    static constexpr size_t WINDOW_SIZE = 32 * 1024;
+
+private:
+    enum class State { HEADER, BODY, TRAILER, DONE, FAILED };
+
+    bool Allocate();
+    bool FeedHeader(const uint8_t*& data, size_t& length);
+    bool Inflate(const uint8_t*& data, size_t& length);
+    void Emit(const uint8_t* data, size_t length);
+    bool Fail(const char* reason);
+
+    tinfl_decompressor_tag* inflator_ = nullptr;
+    uint8_t* window_ = nullptr;
+    size_t window_pos_ = 0;
+    const DataHandler* on_data_ = nullptr;
+
+    State state_ = State::HEADER;
+    uint8_t header_[12] = {};       // 固定头部 10 字节 + FEXTRA 长度 2 字节
+    size_t header_pos_ = 0;
+    uint8_t flags_ = 0;             // 尚未跳过的可选字段
+    size_t extra_left_ = 0;
+    size_t hcrc_left_ = 2;
+    uint8_t trailer_[8] = {};
+    size_t trailer_pos_ = 0;
+    uint32_t crc_ = 0;
+    size_t input_bytes_ = 0;
+    size_t output_bytes_ = 0;
+};
+
+} // namespace EvoSpark
+
+#endif // GZIP_CODEC_H
@@ -0,0 +1,542 @@
+#include "http_pool.h"
+#include "link_quality.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+namespace EvoSpark {
+
+static const char* TAG = "HttpPool";
+
+namespace {
+
+int64_t NowMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+} // namespace
+
+HttpConnectionPool::~HttpConnectionPool() {
+    for (Connection* conn : connections_) {
+        Close(conn);
+        delete conn;
+    }
+}
+
+void HttpConnectionPool::Configure(const HttpPoolOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+std::string HttpConnectionPool::EndpointOf(const std::string& url) {
+    return url.substr(0, url.find('?'));
+}
+
+std::string HttpConnectionPool::HostOf(const std::string& url) {
+    size_t scheme = url.find("://");
+    size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+    size_t end = url.find('/', start);
+    return url.substr(0, end);
+}
+
+esp_err_t HttpConnectionPool::EventHandler(esp_http_client_event_t* evt) {
+    Connection* conn = static_cast<Connection*>(evt->user_data);
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED: {
+            // 只有新建连接才会触发，复用时没有这一步
+            conn->connected = true;
+            conn->resumed = conn->has_session;
+            conn->has_session = true;
+            conn->handshake_ms =
+                static_cast<uint32_t>((esp_timer_get_time() - conn->request_start_us) / 1000);
+            // 握手刚结束，TLS 上下文和收发缓冲区都已分配：空闲堆的差值就是这条连接的占用
+            size_t internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+            size_t psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+            conn->internal_bytes = static_cast<uint32_t>(
+                conn->internal_free > internal ? conn->internal_free - internal : 0);
+            conn->psram_bytes = static_cast<uint32_t>(
+                conn->psram_free > psram ? conn->psram_free - psram : 0);
+            break;
+        }
+
+        case HTTP_EVENT_ON_HEADER:
+            if (strcasecmp(evt->header_key, "Content-Encoding") == 0 &&
+                strstr(evt->header_value, "gzip") != nullptr) {
+                if (!conn->decoder) {
+                    conn->decoder.reset(new GzipDecoder());
+                }
+                conn->decoder->Reset(conn->on_data);
+                conn->gzip_body = true;
+            }
+            break;
+
+        case HTTP_EVENT_ON_DATA:
+            if (evt->data_len <= 0) {
+                break;
+            }
+            conn->bytes_received += evt->data_len;
+            if (esp_http_client_get_status_code(evt->client) == 200) {
+                if (conn->gzip_body) {
+                    int64_t start = esp_timer_get_time();
+                    conn->decoder->Feed(static_cast<const char*>(evt->data), evt->data_len);
+                    conn->inflate_us += esp_timer_get_time() - start;
+                } else if (conn->on_data) {
+                    (*conn->on_data)(static_cast<const char*>(evt->data), evt->data_len);
+                }
+                // 调用方已不需要后续数据：关闭连接，perform 随即以错误返回
+                if (conn->cancel && conn->cancel->load() && !conn->cancelled) {
+                    conn->cancelled = true;
+                    esp_http_client_cancel_request(evt->client);
+                }
+            } else if (conn->error_body.size() < 256) {
+                conn->error_body.append(static_cast<const char*>(evt->data),
+                                        std::min<size_t>(evt->data_len, 256));
+            }
+            break;
+
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+bool HttpConnectionPool::Open(Connection* conn, const std::string& url, int timeout_ms) {
+    esp_http_client_config_t config = {};
+    config.url = url.c_str();
+    config.method = HTTP_METHOD_POST;
+    config.timeout_ms = timeout_ms;
+    config.event_handler = EventHandler;
+    config.user_data = conn;
+    config.buffer_size = options_.buffer_size;
+    config.keep_alive_enable = true;  // TCP keep-alive，尽早发现已断开的连接
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    config.save_client_session = true;  // 保存会话票据，重连时恢复会话
+#endif
+    config.use_global_ca_store = options_.use_global_ca_store;
+    config.skip_cert_common_name_check = options_.skip_cert_common_name_check;
+    if (options_.use_crt_bundle) {
+        config.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+
+    conn->handle = esp_http_client_init(&config);
+    conn->has_session = false;
+    if (!conn->handle) {
+        ESP_LOGE(TAG, "Failed to create HTTP client for %s", conn->host.c_str());
+        return false;
+    }
+    return true;
+}
+
+void HttpConnectionPool::Close(Connection* conn) {
+    if (conn->handle) {
+        esp_http_client_cleanup(conn->handle);
+        conn->handle = nullptr;
+    }
+}
+
+void HttpConnectionPool::Disconnect(Connection* conn) {
+    if (conn->handle) {
+        esp_http_client_close(conn->handle);
+    }
+}
+
+HttpConnectionPool::Connection* HttpConnectionPool::Acquire(const std::string& url, int timeout_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string host = HostOf(url);
+    int64_t now = NowMs();
+
+    size_t host_count = 0;
+    Connection* conn = nullptr;
+    for (Connection* c : connections_) {
+        if (c->host != host) {
+            continue;
+        }
+        host_count++;
+        if (!c->in_use && (conn == nullptr || c->last_used_ms > conn->last_used_ms)) {
+            conn = c;  // 优先最近用过的，它最可能仍然连着
+        }
+    }
+
+    if (conn) {
+        // 空闲过久，服务端多半已关闭连接：重连，不在坏连接上浪费一次超时。
+        // 句柄保留，重连时带上会话票据
+        if (conn->handle && now - conn->last_used_ms > IDLE_TIMEOUT_MS) {
+            Disconnect(conn);
+            stats_.recycled++;
+        }
+        if (conn->handle) {
+            esp_http_client_set_url(conn->handle, url.c_str());
+            esp_http_client_set_timeout_ms(conn->handle, timeout_ms);
+        } else if (!Open(conn, url, timeout_ms)) {
+            return nullptr;
+        }
+        conn->in_use = true;
+        return conn;
+    }
+
+    // 没有空闲连接：未达上限则加入池，否则临时使用
+    conn = new Connection();
+    conn->host = host;
+    conn->pooled = host_count < MAX_PER_HOST;
+    if (!Open(conn, url, timeout_ms)) {
+        delete conn;
+        return nullptr;
+    }
+    conn->in_use = true;
+    if (conn->pooled) {
+        connections_.push_back(conn);
+    } else {
+        stats_.overflow++;
+        ESP_LOGW(TAG, "Pool for %s is full, using a temporary connection", host.c_str());
+    }
+    return conn;
+}
+
+void HttpConnectionPool::Release(Connection* conn, bool healthy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    conn->on_data = nullptr;
+    conn->cancel = nullptr;
+    conn->last_used_ms = NowMs();
+
+    if (!healthy && conn->handle) {
+        Close(conn);
+        stats_.recycled++;
+    }
+    if (!conn->pooled) {
+        Close(conn);
+        delete conn;
+        return;
+    }
+    conn->in_use = false;
+}
+
+esp_err_t HttpConnectionPool::Transfer(Connection* conn, size_t content_length,
+                                       const BodyWriter& body_writer) {
+    esp_err_t err = esp_http_client_open(conn->handle, static_cast<int>(content_length));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    esp_http_client_handle_t handle = conn->handle;
+    size_t written = 0;
+    int64_t write_start = esp_timer_get_time();
+    bool ok = body_writer([handle, &written](const char* data, size_t length) {
+        while (length > 0) {
+            int n = esp_http_client_write(handle, data, static_cast<int>(length));
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            length -= n;
+            written += n;
+        }
+        return true;
+    });
+    if (!ok || written != content_length) {
+        if (ok) {
+            ESP_LOGE(TAG, "Request body is %u bytes, declared %u",
+                     static_cast<unsigned>(written), static_cast<unsigned>(content_length));
+        }
+        return ESP_FAIL;
+    }
+    // 写出速率就是上行吞吐（最后一段还在发送缓冲区里，偏高一点；小请求体不计）
+    LinkQuality::GetInstance().RecordThroughput(
+        written, static_cast<uint32_t>((esp_timer_get_time() - write_start) / 1000));
+
+    if (esp_http_client_fetch_headers(handle) < 0) {
+        return ESP_FAIL;
+    }
+    // 响应体在解析时经 HTTP_EVENT_ON_DATA 交给 on_data，这里只负责把它读完
+    char scratch[256];
+    int n;
+    while ((n = esp_http_client_read(handle, scratch, sizeof(scratch))) > 0) {
+    }
+    if (n < 0 || conn->cancelled || !esp_http_client_is_complete_data_received(handle)) {
+        return ESP_FAIL;
+    }
+    // 手动读写后句柄停在响应阶段，下一次 perform 不会从头发请求：关掉传输层，
+    // 句柄留在池里，下次使用时重新连接
+    esp_http_client_close(handle);
+    return ESP_OK;
+}
+
+HttpConnectionPool::Result HttpConnectionPool::Send(const std::string& url, const std::string& body,
+                                                   const Headers& headers, const DataHandler& on_data,
+                                                   int timeout_ms, bool gzip_body, bool accept_gzip,
+                                                   const std::atomic<bool>* cancel,
+                                                   const BodyWriter* body_writer,
+                                                   size_t content_length) {
+    Result result;
+    // 复用的连接可能已被对端关闭：没收到任何数据就失败时换新连接重试一次
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Connection* conn = Acquire(url, timeout_ms);
+        if (!conn) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.errors++;
+            return result;
+        }
+
+        for (const auto& header : headers) {
+            esp_http_client_set_header(conn->handle, header.first, header.second.c_str());
+        }
+        // 句柄上的请求头会保留到下一次请求，不用的要显式删掉
+        if (gzip_body) {
+            esp_http_client_set_header(conn->handle, "Content-Encoding", "gzip");
+        } else {
+            esp_http_client_delete_header(conn->handle, "Content-Encoding");
+        }
+        if (accept_gzip) {
+            esp_http_client_set_header(conn->handle, "Accept-Encoding", "gzip");
+        } else {
+            esp_http_client_delete_header(conn->handle, "Accept-Encoding");
+        }
+        if (!body_writer) {
+            esp_http_client_set_post_field(conn->handle, body.c_str(), body.length());
+        }
+
+        conn->on_data = &on_data;
+        conn->cancel = cancel;
+        conn->cancelled = false;
+        conn->connected = false;
+        conn->handshake_ms = 0;
+        conn->bytes_received = 0;
+        conn->error_body.clear();
+        conn->gzip_body = false;
+        conn->inflate_us = 0;
+        conn->resumed = false;
+        conn->internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        conn->psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        conn->request_start_us = esp_timer_get_time();
+
+        esp_err_t err = body_writer ? Transfer(conn, content_length, *body_writer)
+                                    : esp_http_client_perform(conn->handle);
+        int status = esp_http_client_get_status_code(conn->handle);
+        bool reused = !conn->connected;
+        bool cancelled = conn->cancelled;
+        bool stale = err != ESP_OK && reused && conn->bytes_received == 0 && !cancelled;
+
+        // gzip 响应必须完整且校验通过，否则按网络错误处理
+        bool corrupt = false;
+        if (err == ESP_OK && status == 200 && conn->gzip_body) {
+            corrupt = !conn->decoder->Finish();
+            result.gzip_response = true;
+            result.decoded_bytes = conn->decoder->OutputBytes();
+        } else {
+            result.decoded_bytes = conn->bytes_received;
+        }
+        result.wire_bytes = conn->bytes_received;
+        result.inflate_us = conn->inflate_us;
+
+        uint32_t rtt_ms = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.requests++;
+            if (conn->connected) {
+                // 往返时间样本：明文连接是一个往返（TCP），会话恢复的 TLS 重连是两个。
+                // 服务端不接受票据时实际做的是完整握手，比平均完整握手的一半还慢的不算
+                if (conn->host.compare(0, 8, "https://") != 0) {
+                    rtt_ms = conn->handshake_ms;
+                } else if (conn->resumed && stats_.handshakes > 0 &&
+                           conn->handshake_ms < stats_.handshake_total_ms / stats_.handshakes / 2) {
+                    rtt_ms = conn->handshake_ms / 2;
+                }
+                if (conn->resumed) {
+                    stats_.reconnects++;
+                    stats_.reconnect_total_ms += conn->handshake_ms;
+                } else {
+                    stats_.handshakes++;
+                    stats_.handshake_total_ms += conn->handshake_ms;
+                }
+                stats_.connect_internal_bytes = conn->internal_bytes;
+                stats_.connect_psram_bytes = conn->psram_bytes;
+            } else if (err == ESP_OK) {
+                stats_.reused++;
+            }
+            if (cancelled) {
+                stats_.cancelled++;
+            } else if ((err != ESP_OK && !stale) || corrupt) {
+                stats_.errors++;
+            }
+        }
+
+        // 链路估计：超时、断开算丢包；复用的连接被对端关掉与链路无关，不算
+        LinkQuality& link = LinkQuality::GetInstance();
+        if (rtt_ms > 0) {
+            link.RecordRtt(rtt_ms);
+        }
+        if (!cancelled && !stale) {
+            link.RecordRequest(err != ESP_OK || corrupt);
+        }
+
+        if (conn->connected) {
+            ESP_LOGI(TAG, "%s to %s (%u ms, %u bytes internal RAM, %u bytes PSRAM)",
+                     conn->resumed ? "Reconnected" : "New connection", conn->host.c_str(),
+                     static_cast<unsigned>(conn->handshake_ms),
+                     static_cast<unsigned>(conn->internal_bytes),
+                     static_cast<unsigned>(conn->psram_bytes));
+        }
+        if (err == ESP_OK && status != 200) {
+            ESP_LOGE(TAG, "HTTP status %d: %s", status, conn->error_body.c_str());
+        }
+
+        // 出错、被放弃或服务端返回 5xx 的连接不再复用
+        Release(conn, err == ESP_OK && status < 500 && !corrupt && !cancelled);
+
+        if (cancelled) {
+            ESP_LOGI(TAG, "Request to %s cancelled after %u bytes",
+                     HostOf(url).c_str(), static_cast<unsigned>(result.wire_bytes));
+            return result;
+        }
+
+        if (corrupt) {
+            ESP_LOGE(TAG, "Corrupt gzip response from %s", HostOf(url).c_str());
+            return result;
+        }
+        if (err == ESP_OK) {
+            result.status = status;
+            return result;
+        }
+        if (!stale) {
+            ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+            return result;
+        }
+        ESP_LOGW(TAG, "Reused connection to %s was closed, reconnecting", HostOf(url).c_str());
+    }
+    return result;
+}
+
+int HttpConnectionPool::Post(const std::string& url, const std::string& body,
+                             const Headers& headers, const DataHandler& on_data,
+                             int timeout_ms, const std::atomic<bool>* cancel) {
+    HttpPoolOptions options;
+    std::string endpoint = EndpointOf(url);
+    bool gzip_body = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options = options_;
+        gzip_body = options.gzip_requests && body.size() >= options.gzip_min_bytes &&
+                    EndpointLocked(endpoint).gzip_accepted;
+    }
+
+    std::string compressed;
+    int64_t deflate_us = 0;
+    if (gzip_body) {
+        int64_t start = esp_timer_get_time();
+        gzip_body = GzipEncoder::GetInstance().Compress(body.data(), body.size(), compressed) &&
+                    compressed.size() < body.size();
+        deflate_us = esp_timer_get_time() - start;
+    }
+
+    Result result = Send(url, gzip_body ? compressed : body, headers, on_data, timeout_ms,
+                         gzip_body, options.gzip_responses, cancel);
+
+    // 服务端可能不认 Content-Encoding：明文重发一次，结果不同说明是压缩导致的
+    bool rejected = false;
+    if (gzip_body && (result.status == 400 || result.status == 415)) {
+        Result plain = Send(url, body, headers, on_data, timeout_ms, false,
+                            options.gzip_responses, cancel);
+        rejected = plain.status != result.status;
+        result = plain;
+        gzip_body = false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    HttpEndpointStats& ep = EndpointLocked(endpoint);
+    ep.requests++;
+    ep.body_bytes += body.size();
+    ep.sent_bytes += gzip_body ? compressed.size() : body.size();
+    ep.deflate_us += deflate_us;
+    if (gzip_body) {
+        ep.gzip_requests++;
+    }
+    if (result.gzip_response) {
+        ep.gzip_responses++;
+    }
+    ep.wire_bytes += result.wire_bytes;
+    ep.decoded_bytes += result.decoded_bytes;
+    ep.inflate_us += result.inflate_us;
+    if (rejected) {
+        ep.gzip_accepted = false;
+        ESP_LOGW(TAG, "%s rejects gzip request bodies, sending plain from now on", endpoint.c_str());
+    }
+    return result.status;
+}
+
+int HttpConnectionPool::Upload(const std::string& url, size_t content_length,
+                               const BodyWriter& body, const Headers& headers,
+                               const DataHandler& on_data, int timeout_ms,
+                               const std::atomic<bool>* cancel) {
+    bool accept_gzip = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        accept_gzip = options_.gzip_responses;
+    }
+
+    Result result = Send(url, std::string(), headers, on_data, timeout_ms, false, accept_gzip,
+                         cancel, &body, content_length);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    HttpEndpointStats& ep = EndpointLocked(EndpointOf(url));
+    ep.requests++;
+    ep.body_bytes += content_length;
+    ep.sent_bytes += content_length;
+    if (result.gzip_response) {
+        ep.gzip_responses++;
+    }
+    ep.wire_bytes += result.wire_bytes;
+    ep.decoded_bytes += result.decoded_bytes;
+    ep.inflate_us += result.inflate_us;
+    return result.status;
+}
+
+HttpEndpointStats& HttpConnectionPool::EndpointLocked(const std::string& endpoint) {
+    for (HttpEndpointStats& ep : endpoints_) {
+        if (ep.endpoint == endpoint) {
+            return ep;
+        }
+    }
+    endpoints_.emplace_back();
+    endpoints_.back().endpoint = endpoint;
+    return endpoints_.back();
+}
+
+void HttpConnectionPool::CloseIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Connection* conn : connections_) {
+        if (!conn->in_use && conn->handle) {
+            Disconnect(conn);
+            stats_.recycled++;
+        }
+    }
+}
+
+HttpPoolStats HttpConnectionPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    HttpPoolStats stats = stats_;
+    stats.open_connections = 0;
+    for (const Connection* conn : connections_) {
+        if (conn->handle) {
+            stats.open_connections++;
+        }
+    }
+    for (const HttpEndpointStats& ep : endpoints_) {
+        stats.body_bytes += ep.body_bytes;
+        stats.sent_bytes += ep.sent_bytes;
+        stats.wire_bytes += ep.wire_bytes;
+        stats.decoded_bytes += ep.decoded_bytes;
+        stats.deflate_us += ep.deflate_us;
+        stats.inflate_us += ep.inflate_us;
+    }
+    return stats;
+}
+
+std::vector<HttpEndpointStats> HttpConnectionPool::GetEndpointStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return endpoints_;
+}
+
+} // namespace EvoSpark
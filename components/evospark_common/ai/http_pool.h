@@ -0,0 +1,213 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "esp_http_client.h"
+#include "gzip_codec.h"
+
+namespace EvoSpark {
+
+// 连接池选项
+struct HttpPoolOptions {
+    bool use_crt_bundle = true;                 // https 使用内置证书包
+    bool use_global_ca_store = false;           // 或使用全局 CA 存储
+    bool skip_cert_common_name_check = false;
+    int buffer_size = 2048;                     // 每个连接的接收缓冲区
+
+    // gzip：请求体压缩在每个端点上协商（服务端拒绝则该端点退回明文），
+    // 响应只是声明 Accept-Encoding，是否压缩由服务端决定
+    bool gzip_requests = false;
+    bool gzip_responses = false;
+    size_t gzip_min_bytes = 1024;               // 小于此长度的请求体不压缩
+};
+
+// 单个端点（scheme://host/path）的压缩统计
+struct HttpEndpointStats {
+    std::string endpoint;
+    bool gzip_accepted = true;        // 请求体压缩未被拒绝
+    uint32_t requests = 0;
+    uint32_t gzip_requests = 0;       // 以 gzip 发送的请求数
+    uint32_t gzip_responses = 0;      // 以 gzip 返回的响应数
+    uint64_t body_bytes = 0;          // 请求体原始长度
+    uint64_t sent_bytes = 0;          // 实际发送的请求体长度
+    uint64_t wire_bytes = 0;          // 实际收到的响应体长度
+    uint64_t decoded_bytes = 0;       // 解压后的响应体长度
+    uint64_t deflate_us = 0;          // 压缩累计耗时
+    uint64_t inflate_us = 0;          // 解压累计耗时（含回调处理）
+
+    // 上下行节省的字节数
+    uint64_t SavedBytes() const {
+        return (body_bytes - sent_bytes) + (decoded_bytes - wire_bytes);
+    }
+};
+
+// 连接池统计
+struct HttpPoolStats {
+    uint32_t requests = 0;
+    uint32_t handshakes = 0;          // 新句柄上的连接次数（DNS + TCP + 完整 TLS 握手）
+    uint32_t reconnects = 0;          // 已有句柄上的重连（带上次的会话票据，服务端接受时免去完整握手）
+    uint32_t reused = 0;              // 复用已有连接的请求数
+    uint32_t recycled = 0;            // 因出错或空闲过久而关闭的连接数
+    uint32_t overflow = 0;            // 池满时使用的临时连接数
+    uint32_t errors = 0;
+    uint32_t cancelled = 0;           // 调用方中途放弃的请求（如结构化输出校验失败）
+    uint64_t handshake_total_ms = 0;  // 握手累计耗时
+    uint64_t reconnect_total_ms = 0;  // 重连累计耗时
+    uint32_t connect_internal_bytes = 0;  // 最近一次建连占用的内部 RAM（空闲堆差值，近似）
+    uint32_t connect_psram_bytes = 0;     // 同上，PSRAM
+    uint32_t open_connections = 0;
+
+    // 压缩统计（各端点合计）
+    uint64_t body_bytes = 0;
+    uint64_t sent_bytes = 0;
+    uint64_t wire_bytes = 0;
+    uint64_t decoded_bytes = 0;
+    uint64_t deflate_us = 0;
+    uint64_t inflate_us = 0;
+
+    // 复用省下的握手时间（按平均握手耗时估算）
+    uint64_t SavedMs() const {
+        return handshakes ? handshake_total_ms * reused / handshakes : 0;
+    }
+};
+
+// HTTP(S) 长连接池
+//
+// esp_http_client 句柄在请求结束后不关闭，同一主机的下一次请求直接复用
+// 已建立的 TLS 会话，省去一次完整握手（240MHz 下约 1-2 秒）。每个主机
+// 最多保留 MAX_PER_HOST 个连接；空闲超过 IDLE_TIMEOUT_MS 的连接在取用
+// 前重建（服务端多半已断开）；请求出错的连接直接销毁，下次重新建立。
+// 池满时临时新建连接，用完即关，不会阻塞调用方。
+//
+// 空闲过久的连接只断开传输层，句柄连同 TLS 会话票据保留（浅睡眠时内存
+// 保持，醒来后同样可用），重连时服务端接受票据就只做简短握手，省掉证书
+// 验证和密钥交换。出错的连接才连句柄一起销毁。
+//
+// 开启 gzip 后，请求体超过 gzip_min_bytes 时压缩发送；某个端点对压缩请求
+// 返回 400/415 而明文重发成功，就记为不支持，此后该端点只发明文。gzip
+// 响应在事件回调里边收边解压，on_data 拿到的始终是解压后的数据。
+//
+// 图像这类大请求体用 Upload：调用方边生成边写，esp_http_client_open 之后
+// 逐段 esp_http_client_write，峰值内存只是调用方的一块写缓冲区。
+//
+// 每次请求顺带给 LinkQuality 报样本：重连握手耗时（往返）、分段上传的
+// 写出速率（上行吞吐）、是否以网络错误结束（丢包）。
+class HttpConnectionPool {
+public:
+    static HttpConnectionPool& GetInstance() {
+        static HttpConnectionPool instance;
+        return instance;
+    }
+
+    using Headers = std::vector<std::pair<const char*, std::string>>;
+    using DataHandler = std::function<void(const char* data, size_t length)>;
+
+    // 分段写出请求体：BodyWriter 把整个请求体依次交给 write，写失败返回 false。
+    // 复用的连接已断开时会换新连接再调用一次，所以必须能从头重写
+    using ChunkWriter = std::function<bool(const char* data, size_t length)>;
+    using BodyWriter = std::function<bool(const ChunkWriter& write)>;
+
+    // 设置连接选项（只影响之后新建的连接）
+    void Configure(const HttpPoolOptions& options);
+
+    // POST 请求，响应体边收边交给 on_data；返回 HTTP 状态码，网络错误返回 -1。
+    // cancel 非空时每段数据交付后检查一次，置位即关闭连接（服务端随之停止
+    // 生成），返回 -1
+    int Post(const std::string& url, const std::string& body,
+             const Headers& headers, const DataHandler& on_data,
+             int timeout_ms = 30000, const std::atomic<bool>* cancel = nullptr);
+
+    // POST 请求，请求体由 body 边生成边写入连接，不在内存中拼出完整的请求体
+    // （如图像的 base64）。content_length 必须与写出的字节数一致；不做 gzip。
+    // 其余同 Post
+    int Upload(const std::string& url, size_t content_length, const BodyWriter& body,
+               const Headers& headers, const DataHandler& on_data,
+               int timeout_ms = 30000, const std::atomic<bool>* cancel = nullptr);
+
+    // 断开所有空闲连接（如 WiFi 断开时），句柄和会话票据保留
+    void CloseIdle();
+
+    HttpPoolStats GetStats() const;
+    std::vector<HttpEndpointStats> GetEndpointStats() const;
+
+    static constexpr size_t MAX_PER_HOST = 2;
+    static constexpr int64_t IDLE_TIMEOUT_MS = 30000;
+
+private:
+    HttpConnectionPool() = default;
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool&) = delete;
+    HttpConnectionPool& operator=(const HttpConnectionPool&) = delete;
+
+    struct Connection {
+        std::string host;                        // scheme://host:port
+        esp_http_client_handle_t handle = nullptr;
+        bool in_use = false;
+        bool pooled = true;
+        int64_t last_used_ms = 0;
+        int64_t request_start_us = 0;
+        bool connected = false;                  // 本次请求新建了连接
+        bool has_session = false;                // 句柄连接过，保存着会话票据
+        bool resumed = false;                    // 本次连接带着会话票据
+        size_t internal_free = 0;                // 请求开始时的空闲内部 RAM / PSRAM
+        size_t psram_free = 0;
+        uint32_t internal_bytes = 0;             // 建连占用的内部 RAM / PSRAM
+        uint32_t psram_bytes = 0;
+        uint32_t handshake_ms = 0;
+        size_t bytes_received = 0;
+        std::string error_body;                  // 非 200 响应体（截断，用于日志）
+        const DataHandler* on_data = nullptr;
+        const std::atomic<bool>* cancel = nullptr;
+        bool cancelled = false;                  // 本次请求已被调用方放弃
+        bool gzip_body = false;                  // 本次响应是 gzip 编码
+        std::unique_ptr<GzipDecoder> decoder;    // 首次收到 gzip 响应时创建，之后复用
+        int64_t inflate_us = 0;
+    };
+
+    // 一次请求的结果（Send 内部使用）
+    struct Result {
+        int status = -1;
+        bool gzip_response = false;
+        size_t wire_bytes = 0;
+        size_t decoded_bytes = 0;
+        int64_t inflate_us = 0;
+    };
+
+    static esp_err_t EventHandler(esp_http_client_event_t* evt);
+    static std::string HostOf(const std::string& url);
+
+    Connection* Acquire(const std::string& url, int timeout_ms);
+    void Release(Connection* conn, bool healthy);
+    bool Open(Connection* conn, const std::string& url, int timeout_ms);
+    static void Close(Connection* conn);
+    static void Disconnect(Connection* conn);     // 只断开传输层，保留句柄和会话票据
+    static std::string EndpointOf(const std::string& url);
+
+    // body_writer 非空时分段写出 content_length 字节的请求体，否则发送 body
+    Result Send(const std::string& url, const std::string& body, const Headers& headers,
+                const DataHandler& on_data, int timeout_ms, bool gzip_body, bool accept_gzip,
+                const std::atomic<bool>* cancel, const BodyWriter* body_writer = nullptr,
+                size_t content_length = 0);
+
+    // 打开连接、写出请求体并读完响应（响应体仍经事件回调交给 on_data）
+    static esp_err_t Transfer(Connection* conn, size_t content_length, const BodyWriter& body_writer);
+    HttpEndpointStats& EndpointLocked(const std::string& endpoint);
+
+    std::vector<Connection*> connections_;
+    HttpPoolOptions options_;
+    HttpPoolStats stats_;
+    std::vector<HttpEndpointStats> endpoints_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // HTTP_POOL_H
@@ -0,0 +1,247 @@
+#include "link_quality.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include <algorithm>
+#include <cmath>
+
+namespace EvoSpark {
+
+static const char* TAG = "LinkQuality";
+
+namespace {
+
+constexpr float RSSI_GAIN = 0.25f;        // 5 秒一个样本，换房间后约 20 秒跟上
+constexpr float THROUGHPUT_GAIN = 0.25f;  // 上传样本稀少，新样本权重大一些
+constexpr float LOSS_GAIN = 1.0f / 16;    // 一次失败 → 6%，连续三次 → 18%
+
+LinkClass Grade(bool good, bool poor) {
+    return good ? LinkClass::GOOD : poor ? LinkClass::POOR : LinkClass::FAIR;
+}
+
+uint32_t Clamp(float value, uint32_t low, uint32_t high) {
+    if (value <= low) {
+        return low;
+    }
+    if (value >= high) {
+        return high;
+    }
+    return static_cast<uint32_t>(value);
+}
+
+} // namespace
+
+const char* LinkClassToString(LinkClass link) {
+    switch (link) {
+        case LinkClass::GOOD: return "good";
+        case LinkClass::FAIR: return "fair";
+        case LinkClass::POOR: return "poor";
+    }
+    return "unknown";
+}
+
+void LinkQuality::Estimate::Add(float x, int64_t now_us, float gain) {
+    if (samples == 0) {
+        mean = x;
+        var = x / 2;
+    } else {
+        var += (std::fabs(x - mean) - var) / 4;
+        mean += (x - mean) * gain;
+    }
+    samples++;
+    last_us = now_us;
+}
+
+bool LinkQuality::Estimate::Fresh(int64_t now_us) const {
+    return samples > 0 && now_us - last_us < SAMPLE_TTL_MS * 1000;
+}
+
+LinkQuality::~LinkQuality() {
+    Stop();
+}
+
+bool LinkQuality::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timer_) {
+        return true;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = &SampleRssi,
+        .arg = this,
+        .name = "link_rssi"
+    };
+    if (esp_timer_create(&timer_args, &timer_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RSSI timer");
+        timer_ = nullptr;
+        return false;
+    }
+    esp_timer_start_periodic(timer_, static_cast<uint64_t>(RSSI_PERIOD_MS) * 1000);
+    return true;
+}
+
+void LinkQuality::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timer_) {
+        esp_timer_stop(timer_);
+        esp_timer_delete(timer_);
+        timer_ = nullptr;
+    }
+}
+
+void LinkQuality::SampleRssi(void* arg) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        static_cast<LinkQuality*>(arg)->RecordRssi(ap.rssi);
+    }
+}
+
+void LinkQuality::RecordRssi(int rssi) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    rssi_.Add(static_cast<float>(rssi), now, RSSI_GAIN);
+    stats_.rssi_samples++;
+    ClassifyLocked(now);
+}
+
+void LinkQuality::RecordRtt(uint32_t rtt_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    rtt_.Add(static_cast<float>(rtt_ms), now);
+    stats_.rtt_samples++;
+    ClassifyLocked(now);
+}
+
+void LinkQuality::RecordThroughput(size_t bytes, uint32_t elapsed_ms) {
+    if (bytes < THROUGHPUT_MIN_BYTES) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    float kbps = static_cast<float>(bytes) * 8 / std::max<uint32_t>(elapsed_ms, 1);
+    uplink_kbps_.Add(kbps, now, THROUGHPUT_GAIN);
+    stats_.throughput_samples++;
+    ClassifyLocked(now);
+}
+
+void LinkQuality::RecordFirstByte(uint32_t ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    first_byte_.Add(static_cast<float>(ms), esp_timer_get_time());
+    stats_.first_byte_samples++;
+}
+
+void LinkQuality::RecordRequest(bool network_error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loss_ += ((network_error ? 1.0f : 0.0f) - loss_) * LOSS_GAIN;
+    stats_.requests++;
+    if (network_error) {
+        stats_.network_errors++;
+    }
+    ClassifyLocked(esp_timer_get_time());
+}
+
+LinkClass LinkQuality::TargetLocked(int64_t now_us) const {
+    LinkClass target = LinkClass::GOOD;
+    auto worse = [&target](LinkClass link) {
+        if (link > target) {
+            target = link;
+        }
+    };
+    if (rssi_.Fresh(now_us)) {
+        worse(Grade(rssi_.mean >= RSSI_GOOD_DBM, rssi_.mean < RSSI_POOR_DBM));
+    }
+    if (rtt_.Fresh(now_us)) {
+        worse(Grade(rtt_.mean <= RTT_GOOD_MS, rtt_.mean > RTT_POOR_MS));
+    }
+    if (uplink_kbps_.Fresh(now_us)) {
+        worse(Grade(uplink_kbps_.mean >= UPLINK_GOOD_KBPS, uplink_kbps_.mean < UPLINK_POOR_KBPS));
+    }
+    float loss_permille = loss_ * 1000;
+    worse(Grade(loss_permille < LOSS_FAIR_PERMILLE, loss_permille >= LOSS_POOR_PERMILLE));
+    return target;
+}
+
+void LinkQuality::ClassifyLocked(int64_t now_us) {
+    LinkClass target = TargetLocked(now_us);
+    if (target == link_) {
+        upgrade_since_us_ = 0;
+        return;
+    }
+    if (target < link_) {
+        // 变好：持续 UPGRADE_HOLD_MS 才切换
+        if (upgrade_since_us_ == 0) {
+            upgrade_since_us_ = now_us;
+            return;
+        }
+        if (now_us - upgrade_since_us_ < UPGRADE_HOLD_MS * 1000) {
+            return;
+        }
+    }
+    ESP_LOGI(TAG, "Link %s -> %s (RSSI %d dBm, RTT %u ms, uplink %u kbps, loss %u%%)",
+             LinkClassToString(link_), LinkClassToString(target),
+             static_cast<int>(rssi_.mean), static_cast<unsigned>(rtt_.mean),
+             static_cast<unsigned>(uplink_kbps_.mean), static_cast<unsigned>(loss_ * 100));
+    link_ = target;
+    upgrade_since_us_ = 0;
+    stats_.changes++;
+}
+
+LinkClass LinkQuality::GetClass() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return link_;
+}
+
+LinkProfile LinkQuality::GetProfile() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LinkProfile profile;
+    profile.link = link_;
+
+    // 弱链路上缩小每次要送出的数据：图像压得更狠，语音降码率，上下文减短
+    switch (link_) {
+        case LinkClass::GOOD:
+            profile.jpeg_quality = 12;
+            profile.audio_bitrate = 24000;
+            profile.context_percent = 100;
+            break;
+        case LinkClass::FAIR:
+            profile.jpeg_quality = 20;
+            profile.audio_bitrate = 16000;
+            profile.context_percent = 75;
+            break;
+        case LinkClass::POOR:
+            profile.jpeg_quality = 30;
+            profile.audio_bitrate = 8000;
+            profile.context_percent = 50;
+            break;
+    }
+
+    // 超时按 RFC 6298 的 RTO（均值 + 4 倍偏差）：卡住的连接尽早放弃重试，
+    // 而不是固定等满 30 秒。对冲等待在好链路上取均值 + 2 倍偏差（约 p95，
+    // 很少多发）；链路越差，首字节慢多半是重传而不是服务端，越早对冲
+    if (first_byte_.samples > 0) {
+        float deviations = link_ == LinkClass::GOOD ? 2.0f : link_ == LinkClass::FAIR ? 1.0f : 0.0f;
+        profile.response_timeout_ms = Clamp(first_byte_.mean + 4 * first_byte_.var,
+                                            RESPONSE_TIMEOUT_MIN_MS, RESPONSE_TIMEOUT_MAX_MS);
+        profile.hedge_after_ms = Clamp(first_byte_.mean + deviations * first_byte_.var,
+                                       HEDGE_MIN_MS, HEDGE_MAX_MS);
+    } else {
+        profile.response_timeout_ms = RESPONSE_TIMEOUT_MAX_MS;
+        profile.hedge_after_ms = HEDGE_DEFAULT_MS;
+    }
+    return profile;
+}
+
+LinkStats LinkQuality::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LinkStats stats = stats_;
+    stats.link = link_;
+    stats.rssi = rssi_.samples ? static_cast<int>(std::lround(rssi_.mean)) : 0;
+    stats.srtt_ms = static_cast<uint32_t>(rtt_.mean);
+    stats.rttvar_ms = static_cast<uint32_t>(rtt_.var);
+    stats.first_byte_ms = static_cast<uint32_t>(first_byte_.mean);
+    stats.first_byte_var_ms = static_cast<uint32_t>(first_byte_.var);
+    stats.uplink_kbps = static_cast<uint32_t>(uplink_kbps_.mean);
+    stats.loss_permille = static_cast<uint32_t>(loss_ * 1000);
+    return stats;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,154 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "esp_timer.h"
+
+namespace EvoSpark {
+
+// 链路等级
+enum class LinkClass {
+    GOOD,
+    FAIR,
+    POOR,
+};
+
+const char* LinkClassToString(LinkClass link);
+
+// 按当前链路给出的网络参数
+struct LinkProfile {
+    LinkClass link = LinkClass::GOOD;
+    int jpeg_quality = 12;              // esp32-camera JPEG 质量（10-63，越大压得越狠）
+    uint32_t audio_bitrate = 24000;     // 语音上行码率（bps）
+    int context_percent = 100;          // 对话上下文预算（prompt token、最近轮数）的比例
+    uint32_t response_timeout_ms = 0;   // 交互流式请求的套接字超时（等首字节和两段数据之间）
+    uint32_t hedge_after_ms = 0;        // 交互请求多久没有首字节就发对冲请求
+};
+
+// 链路估计统计
+struct LinkStats {
+    LinkClass link = LinkClass::GOOD;
+    int rssi = 0;                       // 平滑后的 RSSI（dBm），0 为未知
+    uint32_t srtt_ms = 0;               // 平滑往返时间
+    uint32_t rttvar_ms = 0;
+    uint32_t first_byte_ms = 0;         // 平滑首字节等待（含服务端处理）
+    uint32_t first_byte_var_ms = 0;
+    uint32_t uplink_kbps = 0;           // 上行吞吐估计
+    uint32_t loss_permille = 0;         // 平滑后的请求失败率（‰）
+    uint32_t rssi_samples = 0;
+    uint32_t rtt_samples = 0;
+    uint32_t throughput_samples = 0;
+    uint32_t first_byte_samples = 0;
+    uint32_t requests = 0;
+    uint32_t network_errors = 0;
+    uint32_t changes = 0;               // 等级变化次数
+};
+
+// 链路质量估计
+//
+// 不发探测包，只用真实请求的副产品：
+//   - RSSI：Start 后每 RSSI_PERIOD_MS 读一次当前 AP 的信号强度
+//   - 往返时间：带会话票据的重连握手（TCP 一个往返 + TLS 会话恢复一个往返）
+//   - 上行吞吐：分段上传（图像）写出请求体的速率
+//   - 丢包：请求以网络错误（超时、断开）结束的比例
+//   - 首字节等待：交互流式请求的首 token 延迟
+// 各量按 RFC 6298 的方式平滑（往返和首字节另记偏差），每项取自己的
+// 等级，整体取最差的一项。变差立即生效；变好要保持 UPGRADE_HOLD_MS，
+// 避免在边缘信号下来回切换。超过 SAMPLE_TTL_MS 没有新样本的量不参与
+// 判断（换了房间，旧的往返时间不再代表现在的链路）。
+//
+// GetProfile 给出按等级和估计值算出的参数，调用方在每次发请求（拍照、
+// 打包上下文、设超时）前取用。
+class LinkQuality {
+public:
+    static LinkQuality& GetInstance() {
+        static LinkQuality instance;
+        return instance;
+    }
+
+    // 开始周期读取 RSSI（WiFi STA 连上后调用）；AP 模式下读不到，不影响其余估计
+    bool Start();
+    void Stop();
+
+    void RecordRssi(int rssi);
+
+    // 一次往返时间样本
+    void RecordRtt(uint32_t rtt_ms);
+
+    // 一次上传：bytes 字节用了 elapsed_ms
+    void RecordThroughput(size_t bytes, uint32_t elapsed_ms);
+
+    // 一次交互请求的首字节等待
+    void RecordFirstByte(uint32_t ms);
+
+    // 一次请求结束；network_error 表示超时或连接断开（HTTP 错误码不算）
+    void RecordRequest(bool network_error);
+
+    LinkClass GetClass() const;
+    LinkProfile GetProfile() const;
+    LinkStats GetStats() const;
+
+    static constexpr uint32_t RSSI_PERIOD_MS = 5000;
+    static constexpr int64_t UPGRADE_HOLD_MS = 15000;
+    static constexpr int64_t SAMPLE_TTL_MS = 300000;
+    static constexpr size_t THROUGHPUT_MIN_BYTES = 8192;    // 更小的上传大多落在发送缓冲区里
+
+    // 各项的等级门限（好于第一个为 GOOD，差于第二个为 POOR）
+    static constexpr int RSSI_GOOD_DBM = -67;
+    static constexpr int RSSI_POOR_DBM = -75;
+    static constexpr uint32_t RTT_GOOD_MS = 150;
+    static constexpr uint32_t RTT_POOR_MS = 400;
+    static constexpr uint32_t UPLINK_GOOD_KBPS = 1000;
+    static constexpr uint32_t UPLINK_POOR_KBPS = 250;
+    static constexpr uint32_t LOSS_FAIR_PERMILLE = 50;
+    static constexpr uint32_t LOSS_POOR_PERMILLE = 150;
+
+    // 交互流式请求的超时范围和默认对冲等待
+    static constexpr uint32_t RESPONSE_TIMEOUT_MIN_MS = 8000;
+    static constexpr uint32_t RESPONSE_TIMEOUT_MAX_MS = 30000;
+    static constexpr uint32_t HEDGE_MIN_MS = 800;
+    static constexpr uint32_t HEDGE_MAX_MS = 4000;
+    static constexpr uint32_t HEDGE_DEFAULT_MS = 2000;
+
+private:
+    LinkQuality() = default;
+    ~LinkQuality();
+
+    LinkQuality(const LinkQuality&) = delete;
+    LinkQuality& operator=(const LinkQuality&) = delete;
+
+    // 平滑估计（RFC 6298：srtt += (x - srtt) * gain，rttvar += (|x - srtt| - rttvar) / 4），
+    // 首个样本直接作为均值、一半作为偏差
+    struct Estimate {
+        float mean = 0;
+        float var = 0;
+        uint32_t samples = 0;
+        int64_t last_us = 0;
+
+        void Add(float x, int64_t now_us, float gain = 0.125f);
+        bool Fresh(int64_t now_us) const;
+    };
+
+    static void SampleRssi(void* arg);
+
+    // 重新评估等级（持锁调用）
+    void ClassifyLocked(int64_t now_us);
+    LinkClass TargetLocked(int64_t now_us) const;
+
+    Estimate rssi_;
+    Estimate rtt_;
+    Estimate uplink_kbps_;
+    Estimate first_byte_;
+    float loss_ = 0;
+    LinkClass link_ = LinkClass::GOOD;
+    int64_t upgrade_since_us_ = 0;    // 估计好于当前等级的起始时间，0 为没有
+    LinkStats stats_;
+    esp_timer_handle_t timer_ = nullptr;
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // LINK_QUALITY_H
@@ -0,0 +1,202 @@
+#include "request_queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <chrono>
+
+namespace EvoSpark {
+
+static const char* TAG = "RequestQueue";
+
+namespace {
+
+// 截止时间 0 表示不限，比较时排在最后
+int64_t SortDeadline(int64_t deadline_us) {
+    return deadline_us > 0 ? deadline_us : INT64_MAX;
+}
+
+} // namespace
+
+const char* RequestPriorityToString(RequestPriority priority) {
+    switch (priority) {
+        case RequestPriority::INTERACTIVE: return "interactive";
+        case RequestPriority::NORMAL: return "normal";
+        case RequestPriority::BACKGROUND: return "background";
+        default: return "unknown";
+    }
+}
+
+bool RequestQueue::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (workers_.size() < WORKERS) {
+        TaskHandle_t handle = nullptr;
+        if (xTaskCreate(WorkerTask, "llm_net", WORKER_STACK, this, 5, &handle) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create network task %zu", workers_.size());
+            return !workers_.empty();
+        }
+        workers_.push_back(handle);
+    }
+    return true;
+}
+
+bool RequestQueue::Submit(RequestPriority priority, uint32_t deadline_ms, Job run, Expire expire) {
+    if (!Start()) {
+        if (expire) {
+            expire(true);
+        }
+        return false;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.submitted++;
+        if (queue_.size() < MAX_QUEUED) {
+            Entry entry;
+            entry.priority = priority;
+            entry.deadline_us = deadline_ms ? now_us + static_cast<int64_t>(deadline_ms) * 1000 : 0;
+            entry.seq = next_seq_++;
+            entry.submitted_us = now_us;
+            entry.run = std::move(run);
+            entry.expire = std::move(expire);
+            queue_.push_back(std::move(entry));
+            stats_.max_queued = std::max<uint32_t>(stats_.max_queued, queue_.size());
+            cv_.notify_one();
+            return true;
+        }
+        stats_.rejected++;
+    }
+
+    ESP_LOGW(TAG, "Queue full, rejecting %s request", RequestPriorityToString(priority));
+    if (expire) {
+        expire(true);
+    }
+    return false;
+}
+
+bool RequestQueue::OnNetworkTask() const {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::find(workers_.begin(), workers_.end(), self) != workers_.end();
+}
+
+RequestQueueStats RequestQueue::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RequestQueueStats stats = stats_;
+    stats.queued = queue_.size();
+    return stats;
+}
+
+void RequestQueue::WorkerTask(void* arg) {
+    static_cast<RequestQueue*>(arg)->WorkerLoop();
+}
+
+void RequestQueue::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // 先清理过期请求，expire 回调不在锁内执行
+        std::vector<Expire> expired;
+        TakeExpiredLocked(esp_timer_get_time(), expired);
+        if (!expired.empty()) {
+            lock.unlock();
+            for (Expire& expire : expired) {
+                if (expire) {
+                    expire(false);
+                }
+            }
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+
+        Entry entry;
+        int64_t next_deadline_us = 0;
+        if (!PopLocked(entry, next_deadline_us)) {
+            if (next_deadline_us > 0) {
+                int64_t wait_us = std::max<int64_t>(next_deadline_us - esp_timer_get_time(), 1000);
+                cv_.wait_for(lock, std::chrono::microseconds(wait_us));
+            } else {
+                cv_.wait(lock);
+            }
+            continue;
+        }
+
+        bool background = entry.priority == RequestPriority::BACKGROUND;
+        uint32_t wait_ms = static_cast<uint32_t>((esp_timer_get_time() - entry.submitted_us) / 1000);
+        if (background) {
+            background_running_++;
+        }
+        stats_.in_flight++;
+        stats_.wait_total_ms += wait_ms;
+        stats_.wait_max_ms = std::max(stats_.wait_max_ms, wait_ms);
+        if (entry.priority == RequestPriority::INTERACTIVE) {
+            stats_.interactive_wait_max_ms = std::max(stats_.interactive_wait_max_ms, wait_ms);
+        }
+        lock.unlock();
+
+        entry.run(entry.deadline_us);
+        entry = Entry();   // 回调捕获的对象在锁外释放
+
+        lock.lock();
+        stats_.in_flight--;
+        stats_.completed++;
+        if (background) {
+            background_running_--;
+            cv_.notify_all();   // 排队的后台请求可能可以开始了
+        }
+    }
+}
+
+bool RequestQueue::PopLocked(Entry& entry, int64_t& next_deadline_us) {
+    bool background_allowed = background_running_ + 1 < WORKERS;
+    size_t best = queue_.size();
+    next_deadline_us = 0;
+    for (size_t i = 0; i < queue_.size(); i++) {
+        const Entry& e = queue_[i];
+        if (e.deadline_us > 0 && (next_deadline_us == 0 || e.deadline_us < next_deadline_us)) {
+            next_deadline_us = e.deadline_us;
+        }
+        if (e.priority == RequestPriority::BACKGROUND && !background_allowed) {
+            continue;
+        }
+        if (best == queue_.size()) {
+            best = i;
+            continue;
+        }
+        const Entry& b = queue_[best];
+        if (e.priority != b.priority) {
+            if (e.priority < b.priority) {
+                best = i;
+            }
+        } else if (SortDeadline(e.deadline_us) != SortDeadline(b.deadline_us)) {
+            if (SortDeadline(e.deadline_us) < SortDeadline(b.deadline_us)) {
+                best = i;
+            }
+        } else if (static_cast<int32_t>(e.seq - b.seq) < 0) {
+            best = i;
+        }
+    }
+    if (best == queue_.size()) {
+        return false;
+    }
+    entry = std::move(queue_[best]);
+    queue_.erase(queue_.begin() + best);
+    return true;
+}
+
+void RequestQueue::TakeExpiredLocked(int64_t now_us, std::vector<Expire>& expired) {
+    for (size_t i = 0; i < queue_.size();) {
+        if (queue_[i].deadline_us > 0 && queue_[i].deadline_us <= now_us) {
+            ESP_LOGW(TAG, "%s request expired after %u ms in queue",
+                     RequestPriorityToString(queue_[i].priority),
+                     static_cast<unsigned>((now_us - queue_[i].submitted_us) / 1000));
+            expired.push_back(std::move(queue_[i].expire));
+            queue_.erase(queue_.begin() + i);
+            stats_.expired++;
+        } else {
+            i++;
+        }
+    }
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,112 @@
+#ifndef REQUEST_QUEUE_H
+#define REQUEST_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace EvoSpark {
+
+// 请求优先级（数值越小越先执行）
+enum class RequestPriority : uint8_t {
+    INTERACTIVE = 0,    // 用户正在等回复
+    NORMAL = 1,
+    BACKGROUND = 2,     // 记忆压缩等后台任务
+};
+
+const char* RequestPriorityToString(RequestPriority priority);
+
+// 请求队列统计
+struct RequestQueueStats {
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+    uint32_t expired = 0;           // 还没开始执行就已超过截止时间
+    uint32_t rejected = 0;          // 队列满被拒绝
+    uint32_t queued = 0;            // 当前排队数
+    uint32_t in_flight = 0;         // 当前执行数
+    uint32_t max_queued = 0;
+    uint64_t wait_total_ms = 0;     // 排队等待累计（已开始执行的请求）
+    uint32_t wait_max_ms = 0;
+    uint32_t interactive_wait_max_ms = 0;
+};
+
+// 网络请求队列：所有 LLM 请求都在这里的网络任务上执行
+//
+// 调用方提交后立即返回，不再为 30-60 秒的请求阻塞自己的任务。WORKERS 个
+// 网络任务按 (优先级, 截止时间, 提交顺序) 取请求执行，并发数与连接池每个
+// 主机的长连接数一致，多个请求在池里的连接上并行。后台请求最多占用
+// WORKERS - 1 个网络任务，总留一个给交互请求，压缩再慢也不会挡住对话。
+//
+// 截止时间从提交时起算：开始执行前已过期的请求不再发出，直接以 expire
+// 回调结束；空闲的网络任务会按最近的截止时间醒来清理，全部忙碌时在有
+// 任务空出来时清理。执行中的请求由 run 自己遵守截止时间。
+class RequestQueue {
+public:
+    static RequestQueue& GetInstance() {
+        static RequestQueue instance;
+        return instance;
+    }
+
+    // run 在网络任务上执行，参数为绝对截止时间（esp_timer 微秒，0 表示不限）；
+    // expire 在请求过期（rejected=false）或队列满被拒绝（rejected=true）时
+    // 代替 run 调用，被拒绝时在提交者的任务上
+    using Job = std::function<void(int64_t deadline_us)>;
+    using Expire = std::function<void(bool rejected)>;
+
+    // 启动网络任务（可重复调用）
+    bool Start();
+
+    // 提交请求；deadline_ms 为 0 表示不限。队列满时调用 expire 并返回 false
+    bool Submit(RequestPriority priority, uint32_t deadline_ms, Job run, Expire expire);
+
+    // 当前任务是否为网络任务（网络任务上不能同步等待另一个请求）
+    bool OnNetworkTask() const;
+
+    RequestQueueStats GetStats() const;
+
+    static constexpr size_t WORKERS = 2;              // 与连接池每主机连接数一致
+    static constexpr size_t MAX_QUEUED = 16;
+    static constexpr uint32_t WORKER_STACK = 12288;   // TLS 握手 + JSON 解析
+
+private:
+    RequestQueue() = default;
+    ~RequestQueue() = default;
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
+
+    struct Entry {
+        RequestPriority priority;
+        int64_t deadline_us;
+        uint32_t seq;
+        int64_t submitted_us;
+        Job run;
+        Expire expire;
+    };
+
+    static void WorkerTask(void* arg);
+    void WorkerLoop();
+
+    // 取出下一个可执行的请求；没有时返回 false，next_deadline_us 为最近的截止时间
+    bool PopLocked(Entry& entry, int64_t& next_deadline_us);
+
+    // 移出已过期的请求（由调用方在锁外执行 expire）
+    void TakeExpiredLocked(int64_t now_us, std::vector<Expire>& expired);
+
+    std::vector<Entry> queue_;
+    std::vector<TaskHandle_t> workers_;
+    size_t background_running_ = 0;
+    uint32_t next_seq_ = 0;
+    RequestQueueStats stats_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+} // namespace EvoSpark
+
+#endif // REQUEST_QUEUE_H
@@ -0,0 +1,80 @@
+#include "response_buffer.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <cstring>
+
+namespace EvoSpark {
+
+static const char* TAG = "ResponseBuffer";
+
+ResponseBuffer::~ResponseBuffer() {
+    if (data_) {
+        heap_caps_free(data_);
+    }
+}
+
+bool ResponseBuffer::Reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return true;
+    }
+    if (capacity > max_size_) {
+        return false;
+    }
+
+    // realloc 保留已有内容；PSRAM 不可用时退回内部 RAM
+    char* p = static_cast<char*>(
+        heap_caps_realloc(data_, capacity + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!p) {
+        p = static_cast<char*>(heap_caps_realloc(data_, capacity + 1, MALLOC_CAP_DEFAULT));
+    }
+    if (!p) {
+        ESP_LOGE(TAG, "Out of memory growing to %zu bytes", capacity);
+        return false;
+    }
+    data_ = p;
+    data_[size_] = '\0';
+    capacity_ = capacity;
+    return true;
+}
+
+bool ResponseBuffer::Append(const char* data, size_t length) {
+    if (overflowed_) {
+        return false;
+    }
+
+    size_t needed = size_ + length;
+    if (needed > capacity_) {
+        // 按倍数增长，摊还后每字节只复制常数次
+        size_t capacity = capacity_ ? capacity_ : INITIAL_CAPACITY;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        if (capacity > max_size_) {
+            capacity = max_size_;
+        }
+        if (needed > capacity || !Reserve(capacity)) {
+            ESP_LOGE(TAG, "Response exceeds %zu bytes, discarding the rest", max_size_);
+            overflowed_ = true;
+            return false;
+        }
+    }
+
+    memcpy(data_ + size_, data, length);
+    size_ = needed;
+    data_[size_] = '\0';
+    return true;
+}
+
+void ResponseBuffer::Clear() {
+    size_ = 0;
+    overflowed_ = false;
+    if (capacity_ > SHRINK_THRESHOLD) {
+        heap_caps_free(data_);
+        data_ = nullptr;
+        capacity_ = 0;
+    } else if (data_) {
+        data_[0] = '\0';
+    }
+}
+
+} // namespace EvoSpark
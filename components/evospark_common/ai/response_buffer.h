@@ -0,0 +1,50 @@
+#ifndef RESPONSE_BUFFER_H
+#define RESPONSE_BUFFER_H
+
+#include <cstddef>
+
+namespace EvoSpark {
+
+// HTTP 响应体缓冲区（PSRAM，可增长、可复用）
+//
+// 响应体按到达顺序追加（chunked 和未知长度的响应都一样处理），内容始终
+// 以 '\0' 结尾，cJSON 可直接在缓冲区上解析，不再另存一份 std::string。
+// Clear 只清空内容、保留容量，下次请求直接复用；容量超过 SHRINK_THRESHOLD
+// 时释放，偶发的大响应不会长期占着 PSRAM。超过 max_size 的响应标记溢出。
+class ResponseBuffer {
+public:
+    explicit ResponseBuffer(size_t max_size = MAX_SIZE) : max_size_(max_size) {}
+    ~ResponseBuffer();
+
+    ResponseBuffer(const ResponseBuffer&) = delete;
+    ResponseBuffer& operator=(const ResponseBuffer&) = delete;
+
+    // 追加数据；超出上限或内存不足时返回 false，之后的数据全部丢弃
+    bool Append(const char* data, size_t length);
+
+    // 清空内容并按需收缩
+    void Clear();
+
+    const char* Data() const { return data_ ? data_ : ""; }
+    size_t Size() const { return size_; }
+    size_t Capacity() const { return capacity_; }
+    bool Empty() const { return size_ == 0; }
+    bool Overflowed() const { return overflowed_; }
+
+    static constexpr size_t INITIAL_CAPACITY = 4 * 1024;
+    static constexpr size_t SHRINK_THRESHOLD = 32 * 1024;
+    static constexpr size_t MAX_SIZE = 256 * 1024;
+
+private:
+    bool Reserve(size_t capacity);
+
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;     // 不含结尾 '\0'
+    size_t max_size_;
+    bool overflowed_ = false;
+};
+
+} // namespace EvoSpark
+
+#endif // RESPONSE_BUFFER_H
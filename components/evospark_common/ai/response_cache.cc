@@ -0,0 +1,558 @@
+#include "response_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace EvoSpark {
+
+static const char* TAG = "ResponseCache";
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+constexpr char FILE_MAGIC[4] = {'R', 'C', 'C', '1'};
+constexpr std::time_t VALID_TIME = 1704067200;   // 2024-01-01，早于此说明时间未同步
+
+constexpr uint32_t TTL_GREETING_S = 12 * 3600;
+constexpr uint32_t TTL_DEFAULT_S = 3600;
+constexpr uint32_t TTL_VARIETY_S = 600;
+
+// Flash 文件中的条目头，后跟 length 字节回复；文件末尾为前面全部内容的 CRC32
+struct FileRecord {
+    uint64_t key;
+    int64_t expires_at;     // 墙钟秒，写入时时间未同步为 0
+    uint32_t remaining_s;   // 写入时的剩余有效期
+    uint32_t tokens;
+    uint32_t latency_ms;
+    uint32_t length;
+};
+
+enum class Match : uint8_t { EXACT, CONTAINS };
+
+// 缓存规则：按顺序匹配归一化后的输入，第一条命中的决定 TTL（0 = 不缓存）。
+// 规则表是白名单，没有规则命中的输入不缓存："好的"、"是的"、"不要" 这类
+// 短回答的意思取决于上一轮，键里没有上文，复用回复会答非所问
+struct CacheRule {
+    Match match;
+    uint32_t ttl_s;
+    const char* const* patterns;
+};
+
+// 实时信息：答案随时间变化
+const char* const kRealtime[] = {
+    "几点", "时间", "今天", "明天", "昨天", "现在", "日期", "星期", "礼拜",
+    "天气", "温度", "下雨", "新闻", "最新",
+    "time", "date", "today", "tomorrow", "weather", "news", nullptr
+};
+
+// 要求记住/提醒：需要模型真正处理
+const char* const kInstruction[] = {
+    "记住", "别忘", "忘记", "提醒", "remember", "remind", "forget", nullptr
+};
+
+// 依赖上文的追问和指代
+const char* const kFollowUp[] = {
+    "为什么", "然后", "继续", "还有", "再来", "再说", "换一个", "刚才", "上次",
+    "这个", "那个", "他", "她", "它",
+    "why", "continue", "again", "another", nullptr
+};
+
+// 问候和道谢：回复稳定，可以长时间复用
+const char* const kGreeting[] = {
+    "你好", "您好", "早", "早上好", "早安", "中午好", "下午好", "晚上好", "晚安",
+    "谢谢", "谢谢你", "多谢", "再见", "拜拜",
+    "hi", "hello", "hey", "thanks", "thank you", "bye", "good morning", "good night", nullptr
+};
+
+// 问助手本身：答案只取决于人设（已计入上下文版本）
+const char* const kIdentity[] = {
+    "你是谁", "你叫什么", "你叫什么名字", "你几岁", "你多大", "你会什么", "你会做什么",
+    "你能做什么", "自我介绍", "介绍一下你自己", "介绍下你自己",
+    "who are you", "what is your name", "what can you do", nullptr
+};
+
+// 笑话/故事/唱歌：用户期待每次不同，只短时间复用（防止连问两次）
+const char* const kVariety[] = {
+    "笑话", "故事", "唱", "joke", "story", "sing", nullptr
+};
+
+const CacheRule kRules[] = {
+    {Match::CONTAINS, 0, kRealtime},
+    {Match::CONTAINS, 0, kInstruction},
+    {Match::CONTAINS, 0, kFollowUp},
+    {Match::EXACT, TTL_GREETING_S, kGreeting},
+    {Match::EXACT, TTL_DEFAULT_S, kIdentity},
+    {Match::CONTAINS, TTL_VARIETY_S, kVariety},
+};
+
+// 句末语气词，去掉后 "你好呀" 与 "你好" 相同
+bool IsTrailingParticle(uint32_t cp) {
+    switch (cp) {
+        case 0x5440:    // 呀
+        case 0x554A:    // 啊
+        case 0x5427:    // 吧
+        case 0x5462:    // 呢
+        case 0x54E6:    // 哦
+        case 0x561B:    // 嘛
+        case 0x5566:    // 啦
+        case 0x5662:    // 噢
+        case 0x5594:    // 喔
+        case 0x54C8:    // 哈
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint64_t HashBytes(uint64_t h, const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+// 解码一个 UTF-8 字符；非法字节返回 0 并前进 1
+uint32_t DecodeUtf8(const std::string& s, size_t& i) {
+    unsigned char c = s[i];
+    int extra;
+    uint32_t cp;
+    if (c < 0x80) {
+        i++;
+        return c;
+    } else if ((c & 0xE0) == 0xC0) {
+        extra = 1;
+        cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        extra = 2;
+        cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        extra = 3;
+        cp = c & 0x07;
+    } else {
+        i++;
+        return 0;
+    }
+    if (i + extra >= s.size()) {
+        i++;
+        return 0;
+    }
+    for (int k = 1; k <= extra; k++) {
+        unsigned char cc = s[i + k];
+        if ((cc & 0xC0) != 0x80) {
+            i++;
+            return 0;
+        }
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    i += extra + 1;
+    return cp;
+}
+
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// 标点、符号、表情和空白：只作分隔
+bool IsSeparator(uint32_t cp) {
+    if (cp < 0x80) {
+        return !((cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9'));
+    }
+    return (cp >= 0x2000 && cp <= 0x2BFF) ||    // 通用标点、箭头、符号
+           (cp >= 0x3000 && cp <= 0x303F) ||    // CJK 标点
+           (cp >= 0xFE10 && cp <= 0xFE6F) ||    // 竖排/小写变体标点
+           (cp >= 0xFF00 && cp <= 0xFFEF) ||    // 全角标点（字母数字已转半角）
+           cp >= 0x1F000 ||                      // 表情
+           cp == 0xA0 || cp == 0;
+}
+
+bool IsAsciiWord(uint32_t cp) {
+    return (cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9');
+}
+
+size_t CountChars(const std::string& text) {
+    size_t count = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool MatchRule(const CacheRule& rule, const std::string& normalized) {
+    for (const char* const* p = rule.patterns; *p; p++) {
+        if (rule.match == Match::EXACT ? normalized == *p
+                                       : normalized.find(*p) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::string ResponseCache::Normalize(const std::string& input) {
+    std::vector<uint32_t> chars;
+    chars.reserve(input.size());
+    bool pending_space = false;
+    size_t i = 0;
+    while (i < input.size()) {
+        uint32_t cp = DecodeUtf8(input, i);
+        if (cp >= 0xFF01 && cp <= 0xFF5E) {
+            cp -= 0xFEE0;                   // 全角 ASCII 转半角
+        }
+        if (cp >= 'A' && cp <= 'Z') {
+            cp += 'a' - 'A';
+        }
+        if (IsSeparator(cp)) {
+            pending_space = !chars.empty();
+            continue;
+        }
+        // 英文单词之间保留一个空格，中文之间的空白直接去掉
+        if (pending_space && IsAsciiWord(cp) && IsAsciiWord(chars.back())) {
+            chars.push_back(' ');
+        }
+        pending_space = false;
+        chars.push_back(cp);
+    }
+
+    while (chars.size() > 2 && IsTrailingParticle(chars.back())) {
+        chars.pop_back();
+    }
+
+    std::string out;
+    out.reserve(input.size());
+    for (uint32_t cp : chars) {
+        AppendUtf8(out, cp);
+    }
+    return out;
+}
+
+uint32_t ResponseCache::TtlFor(const std::string& normalized) {
+    if (normalized.empty() || CountChars(normalized) > MAX_INPUT_CHARS) {
+        return 0;
+    }
+    for (const CacheRule& rule : kRules) {
+        if (MatchRule(rule, normalized)) {
+            return rule.ttl_s;
+        }
+    }
+    return 0;
+}
+
+uint64_t ResponseCache::ContextVersion(const std::string& persona, const std::string& memory_json) {
+    uint64_t h = HashBytes(FNV_OFFSET, persona.data(), persona.size());
+    h = HashBytes(h, "\0", 1);
+    return HashBytes(h, memory_json.data(), memory_json.size());
+}
+
+uint64_t ResponseCache::MakeKey(const std::string& normalized, uint64_t context_version) {
+    uint64_t h = HashBytes(FNV_OFFSET, &context_version, sizeof(context_version));
+    return HashBytes(h, normalized.data(), normalized.size());
+}
+
+void ResponseCache::Init(const char* flash_path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flash_path_ = flash_path ? flash_path : "";
+        last_flush_us_ = esp_timer_get_time();
+    }
+    if (flash_path) {
+        LoadFromFlash();
+    }
+}
+
+bool ResponseCache::Lookup(const std::string& input, uint64_t context_version,
+                           std::string& response) {
+    std::string normalized = Normalize(input);
+    bool cacheable = TtlFor(normalized) > 0;
+    uint64_t key = cacheable ? MakeKey(normalized, context_version) : 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookups++;
+    if (!cacheable) {
+        stats_.excluded++;
+        return false;
+    }
+
+    Entry* entry = FindLocked(key);
+    if (entry && entry->expires_us <= esp_timer_get_time()) {
+        RemoveLocked(entry - entries_.data());
+        stats_.expired++;
+        entry = nullptr;
+    }
+    if (!entry) {
+        stats_.misses++;
+        return false;
+    }
+
+    entry->last_used = ++use_counter_;
+    response.assign(entry->response.data(), entry->response.size());
+    stats_.hits++;
+    stats_.tokens_saved += entry->tokens;
+    stats_.latency_saved_ms += entry->latency_ms;
+    ESP_LOGI(TAG, "Hit \"%s\" (%u tokens saved)", normalized.c_str(),
+             static_cast<unsigned>(entry->tokens));
+    return true;
+}
+
+void ResponseCache::Store(const std::string& input, uint64_t context_version,
+                          const std::string& response, int tokens, uint32_t latency_ms) {
+    if (response.empty() || response.size() > MAX_RESPONSE_BYTES) {
+        return;
+    }
+    std::string normalized = Normalize(input);
+    uint32_t ttl_s = TtlFor(normalized);
+    if (ttl_s == 0) {
+        return;
+    }
+    uint64_t key = MakeKey(normalized, context_version);
+
+    bool flush = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* existing = FindLocked(key);
+        if (existing) {
+            RemoveLocked(existing - entries_.data());
+        }
+        EvictLocked(response.size());
+
+        Entry entry;
+        entry.key = key;
+        entry.expires_us = esp_timer_get_time() + static_cast<int64_t>(ttl_s) * 1000000;
+        entry.last_used = ++use_counter_;
+        entry.tokens = tokens > 0 ? static_cast<uint32_t>(tokens) : 0;
+        entry.latency_ms = latency_ms;
+        entry.response.assign(response.data(), response.size());
+        bytes_ += response.size();
+        entries_.push_back(std::move(entry));
+        stats_.inserts++;
+        dirty_ = true;
+        flush = FlushDue();
+    }
+
+    if (flush) {
+        Flush();
+    }
+}
+
+void ResponseCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    bytes_ = 0;
+    dirty_ = !flash_path_.empty();
+}
+
+ResponseCacheStats ResponseCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResponseCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+ResponseCache::Entry* ResponseCache::FindLocked(uint64_t key) {
+    for (Entry& entry : entries_) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void ResponseCache::RemoveLocked(size_t index) {
+    bytes_ -= entries_[index].response.size();
+    if (index + 1 != entries_.size()) {
+        entries_[index] = std::move(entries_.back());
+    }
+    entries_.pop_back();
+}
+
+void ResponseCache::EvictLocked(size_t incoming_bytes) {
+    // 先清掉过期的，再按 LRU 淘汰到放得下
+    int64_t now_us = esp_timer_get_time();
+    for (size_t i = 0; i < entries_.size();) {
+        if (entries_[i].expires_us <= now_us) {
+            RemoveLocked(i);
+        } else {
+            i++;
+        }
+    }
+    while (!entries_.empty() &&
+           (entries_.size() >= MAX_ENTRIES || bytes_ + incoming_bytes > MAX_BYTES)) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries_.size(); i++) {
+            if (static_cast<int32_t>(entries_[i].last_used - entries_[oldest].last_used) < 0) {
+                oldest = i;
+            }
+        }
+        RemoveLocked(oldest);
+        stats_.evictions++;
+    }
+}
+
+bool ResponseCache::FlushDue() const {
+    return dirty_ && !flash_path_.empty() &&
+           esp_timer_get_time() - last_flush_us_ >= static_cast<int64_t>(FLUSH_INTERVAL_S) * 1000000;
+}
+
+void ResponseCache::Flush() {
+    std::time_t now = std::time(nullptr);
+    std::string data;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_ || flash_path_.empty()) {
+            return;
+        }
+        path = flash_path_;
+        dirty_ = false;
+        last_flush_us_ = esp_timer_get_time();
+
+        // 在锁内序列化，写文件在锁外（SPIFFS 写入可能要几百毫秒）
+        int64_t now_us = esp_timer_get_time();
+        uint32_t count = 0;
+        data.reserve(sizeof(FILE_MAGIC) + sizeof(count) + bytes_ +
+                     entries_.size() * sizeof(FileRecord) + sizeof(uint32_t));
+        data.append(FILE_MAGIC, sizeof(FILE_MAGIC));
+        data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const Entry& entry : entries_) {
+            int64_t remaining_s = (entry.expires_us - now_us) / 1000000;
+            if (remaining_s < MIN_PERSIST_TTL_S) {
+                continue;
+            }
+            FileRecord record;
+            record.key = entry.key;
+            record.expires_at = now >= VALID_TIME ? static_cast<int64_t>(now) + remaining_s : 0;
+            record.remaining_s = static_cast<uint32_t>(remaining_s);
+            record.tokens = entry.tokens;
+            record.latency_ms = entry.latency_ms;
+            record.length = entry.response.size();
+            data.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            data.append(entry.response.data(), entry.response.size());
+            count++;
+        }
+        memcpy(&data[sizeof(FILE_MAGIC)], &count, sizeof(count));
+        stats_.flash_writes++;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    data.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+
+    std::lock_guard<std::mutex> file_lock(flash_mutex_);
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        ESP_LOGW(TAG, "Failed to open %s", tmp.c_str());
+        return;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    if (!ok) {
+        ESP_LOGW(TAG, "Failed to write %s", tmp.c_str());
+        remove(tmp.c_str());
+        return;
+    }
+    remove(path.c_str());
+    rename(tmp.c_str(), path.c_str());
+    ESP_LOGD(TAG, "Flushed %u bytes to %s", static_cast<unsigned>(data.size()), path.c_str());
+}
+
+void ResponseCache::LoadFromFlash() {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path = flash_path_;
+    }
+
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return;
+    }
+    std::string data;
+    char buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(f);
+
+    const size_t header = sizeof(FILE_MAGIC) + sizeof(uint32_t);
+    if (data.size() < header + sizeof(uint32_t) || memcmp(data.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        ESP_LOGW(TAG, "Ignoring malformed cache file %s", path.c_str());
+        return;
+    }
+    uint32_t stored_crc;
+    memcpy(&stored_crc, data.data() + data.size() - sizeof(stored_crc), sizeof(stored_crc));
+    data.resize(data.size() - sizeof(stored_crc));
+    if (esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(data.data()), data.size()) != stored_crc) {
+        ESP_LOGW(TAG, "Cache file CRC mismatch, discarding");
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    bool clock_valid = now >= VALID_TIME;
+
+    uint32_t count;
+    memcpy(&count, data.data() + sizeof(FILE_MAGIC), sizeof(count));
+    size_t pos = header;
+    int64_t now_us = esp_timer_get_time();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count && pos + sizeof(FileRecord) <= data.size(); i++) {
+        FileRecord record;
+        memcpy(&record, data.data() + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.length > MAX_RESPONSE_BYTES || pos + record.length > data.size()) {
+            break;
+        }
+        // 墙钟可用时按墙钟算剩余有效期；否则不知道关机了多久，
+        // 按写入时的剩余时间算，但最多保留 TTL_DEFAULT_S
+        int64_t remaining_s;
+        if (clock_valid && record.expires_at > 0) {
+            remaining_s = record.expires_at - static_cast<int64_t>(now);
+        } else {
+            remaining_s = std::min<int64_t>(record.remaining_s, TTL_DEFAULT_S);
+        }
+        // 过期的，或写入后时钟被回拨过的（剩余时间超过任何 TTL）都丢弃
+        if (remaining_s > 0 && remaining_s <= TTL_GREETING_S && !FindLocked(record.key) &&
+            entries_.size() < MAX_ENTRIES && bytes_ + record.length <= MAX_BYTES) {
+            Entry entry;
+            entry.key = record.key;
+            entry.expires_us = now_us + remaining_s * 1000000;
+            entry.last_used = ++use_counter_;
+            entry.tokens = record.tokens;
+            entry.latency_ms = record.latency_ms;
+            entry.response.assign(data.data() + pos, record.length);
+            bytes_ += record.length;
+            entries_.push_back(std::move(entry));
+            stats_.flash_loaded++;
+        }
+        pos += record.length;
+    }
+    ESP_LOGI(TAG, "Restored %u cached responses from flash", static_cast<unsigned>(stats_.flash_loaded));
+}
+
+} // namespace EvoSpark
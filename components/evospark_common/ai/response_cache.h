@@ -0,0 +1,130 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "psram_allocator.h"
+
+namespace EvoSpark {
+
+// 回复缓存统计
+struct ResponseCacheStats {
+    uint32_t lookups = 0;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t excluded = 0;          // 不在白名单里的输入（实时信息、追问、短回答等）
+    uint32_t inserts = 0;
+    uint32_t evictions = 0;         // 超出容量被淘汰
+    uint32_t expired = 0;           // 查到时已过期
+    uint32_t flash_loaded = 0;      // 启动时从 Flash 恢复的条目
+    uint32_t flash_writes = 0;
+    uint64_t tokens_saved = 0;      // 命中省下的 token（按原请求的用量计）
+    uint64_t latency_saved_ms = 0;  // 命中省下的请求耗时
+    uint32_t entries = 0;
+    uint32_t bytes = 0;
+};
+
+// 回复缓存：重复的简单输入（问候、道谢、常见问题）直接用上次的回复
+//
+// 键是 归一化输入 + 上下文版本 的哈希：
+// - 归一化：全角转半角、英文转小写、去掉标点/表情/多余空白和句末语气词，
+//   "早上好呀！" 和 "早上好" 命中同一条
+// - 上下文版本：人设提示词和记忆内容的指纹（ContextVersion），记忆压缩
+//   提交或人设修改后旧条目自然失效，不会答出过时的内容
+//
+// 键里没有上文，只有不依赖上文的输入能复用回复。规则表是白名单：
+// - 时间/天气/新闻等实时信息、"记住…"、依赖上文的追问（"为什么"、"继续"、
+//   含指代词）不缓存
+// - 问候和道谢缓存 12 小时，问助手本身（"你是谁"）1 小时，讲笑话/故事只
+//   缓存 10 分钟
+// - 其余输入不缓存（"好的"、"是的"、"不要" 的意思取决于上一轮）
+// - 归一化后超过 MAX_INPUT_CHARS 个字的输入不缓存，长句很少原样重复
+//
+// 条目在 PSRAM 里按 LRU 淘汰。Init 给出路径时剩余有效期较长的条目会定期
+// 写入 Flash，重启后恢复：系统时间已同步时按墙钟换算有效期，否则按写入时
+// 的剩余有效期、最多一小时。
+class ResponseCache {
+public:
+    static ResponseCache& GetInstance() {
+        static ResponseCache instance;
+        return instance;
+    }
+
+    // flash_path 为 nullptr 时只用 PSRAM
+    void Init(const char* flash_path);
+
+    // 查找缓存；命中时写入 response 并计入省下的 token 和耗时
+    bool Lookup(const std::string& input, uint64_t context_version, std::string& response);
+
+    // 存入一次成功请求的回复；tokens / latency_ms 为这次请求的用量和耗时
+    void Store(const std::string& input, uint64_t context_version,
+               const std::string& response, int tokens, uint32_t latency_ms);
+
+    // 把有效条目写入 Flash（Store 里按 FLUSH_INTERVAL_S 自动调用）
+    void Flush();
+
+    void Clear();
+
+    ResponseCacheStats GetStats() const;
+
+    // 上下文版本：人设提示词 + 记忆 JSON 的指纹
+    static uint64_t ContextVersion(const std::string& persona, const std::string& memory_json);
+
+    // 归一化输入（结果只用于计算键）
+    static std::string Normalize(const std::string& input);
+
+    // 归一化输入对应的 TTL（秒），0 表示不缓存
+    static uint32_t TtlFor(const std::string& normalized);
+
+    static constexpr size_t MAX_ENTRIES = 96;
+    static constexpr size_t MAX_BYTES = 48 * 1024;          // 回复文本总量
+    static constexpr size_t MAX_RESPONSE_BYTES = 1024;      // 更长的回复不缓存
+    static constexpr size_t MAX_INPUT_CHARS = 40;           // 归一化后的 UTF-8 字符数
+    static constexpr uint32_t FLUSH_INTERVAL_S = 300;
+    static constexpr uint32_t MIN_PERSIST_TTL_S = 600;      // 剩余有效期更短的不写 Flash
+
+private:
+    ResponseCache() = default;
+    ~ResponseCache() = default;
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    using PsramString = std::basic_string<char, std::char_traits<char>, PsramAllocator<char>>;
+
+    struct Entry {
+        uint64_t key;
+        int64_t expires_us;     // esp_timer 时间
+        uint32_t last_used;     // LRU 计数
+        uint32_t tokens;
+        uint32_t latency_ms;
+        PsramString response;
+    };
+
+    static uint64_t MakeKey(const std::string& normalized, uint64_t context_version);
+
+    // 调用方持锁
+    Entry* FindLocked(uint64_t key);
+    void RemoveLocked(size_t index);
+    void EvictLocked(size_t incoming_bytes);
+
+    void LoadFromFlash();
+    bool FlushDue() const;
+
+    std::vector<Entry, PsramAllocator<Entry>> entries_;
+    size_t bytes_ = 0;
+    uint32_t use_counter_ = 0;
+    std::string flash_path_;
+    bool dirty_ = false;
+    int64_t last_flush_us_ = 0;
+    ResponseCacheStats stats_;
+    mutable std::mutex mutex_;
+    std::mutex flash_mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // RESPONSE_CACHE_H
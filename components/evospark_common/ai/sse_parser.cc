@@ -0,0 +1,94 @@
+#include "sse_parser.h"
+#include <cstring>
+
+namespace EvoSpark {
+
+static const char DONE_MARKER[] = "[DONE]";
+
+void SseParser::Feed(const char* data, size_t length) {
+    size_t start = 0;
+    for (size_t i = 0; i < length && !done_; i++) {
+        char c = data[i];
+        if (skip_lf_) {
+            skip_lf_ = false;
+            if (c == '\n') {
+                start = i + 1;
+                continue;
+            }
+        }
+        if (c != '\n' && c != '\r') {
+            continue;
+        }
+
+        line_.append(data + start, i - start);
+        ProcessLine();
+        line_.clear();
+        skip_lf_ = (c == '\r');
+        start = i + 1;
+    }
+    if (!done_ && start < length) {
+        line_.append(data + start, length - start);
+    }
+}
+
+void SseParser::Finish() {
+    if (done_) {
+        return;
+    }
+    if (!line_.empty()) {
+        ProcessLine();
+        line_.clear();
+    }
+    Dispatch();
+}
+
+void SseParser::ProcessLine() {
+    // 空行：事件结束
+    if (line_.empty()) {
+        Dispatch();
+        return;
+    }
+    // 注释
+    if (line_[0] == ':') {
+        return;
+    }
+
+    size_t colon = line_.find(':');
+    size_t name_len = colon == std::string::npos ? line_.size() : colon;
+    if (name_len != 4 || line_.compare(0, 4, "data") != 0) {
+        return;
+    }
+
+    // 冒号后的第一个空格不属于值
+    size_t value = colon == std::string::npos ? line_.size() : colon + 1;
+    if (value < line_.size() && line_[value] == ' ') {
+        value++;
+    }
+
+    if (has_data_) {
+        data_ += '\n';
+    }
+    data_.append(line_, value, std::string::npos);
+    has_data_ = true;
+}
+
+void SseParser::Dispatch() {
+    if (!has_data_) {
+        return;
+    }
+    has_data_ = false;
+
+    if (data_ == DONE_MARKER) {
+        done_ = true;
+        data_.clear();
+        return;
+    }
+
+    events_++;
+    if (handler_) {
+        handler_(data_);
+    }
+    data_.clear();
+}
+
+} // namespace EvoSpark
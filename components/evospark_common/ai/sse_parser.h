@@ -0,0 +1,49 @@
+#ifndef SSE_PARSER_H
+#define SSE_PARSER_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+
+namespace EvoSpark {
+
+// Server-Sent Events 增量解析器
+//
+// 网络数据可以在任意位置断开（包括 \r\n 中间和 UTF-8 多字节字符中间），
+// Feed 只缓存未结束的一行，遇到空行时把本事件的 data 字段（多行以 \n
+// 连接）交给回调。注释行（以 ':' 开头）和 data 以外的字段忽略。
+// 收到 "data: [DONE]" 后标记结束，之后的数据不再派发。
+class SseParser {
+public:
+    using EventHandler = std::function<void(const std::string& data)>;
+
+    explicit SseParser(EventHandler handler) : handler_(std::move(handler)) {}
+
+    // 喂入一段原始字节
+    void Feed(const char* data, size_t length);
+
+    // 连接关闭：派发最后一个未以空行结束的事件
+    void Finish();
+
+    // 是否已收到 [DONE]
+    bool IsDone() const { return done_; }
+
+    // 已派发的事件数
+    size_t GetEventCount() const { return events_; }
+
+private:
+    void ProcessLine();
+    void Dispatch();
+
+    EventHandler handler_;
+    std::string line_;         // 当前未结束的行
+    std::string data_;         // 当前事件累计的 data
+    bool has_data_ = false;
+    bool skip_lf_ = false;     // 上一块以 \r 结尾，下一块开头的 \n 属于同一换行
+    bool done_ = false;
+    size_t events_ = 0;
+};
+
+} // namespace EvoSpark
+
+#endif // SSE_PARSER_H
@@ -0,0 +1,374 @@
+#include "structured_output.h"
+#include <cstring>
+
+namespace EvoSpark {
+
+namespace {
+
+bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsLiteralChar(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '.' || c == '+' || c == '-';
+}
+
+// 数字：可选负号、整数部分、可选小数和指数；只看字符位置，不求值
+bool IsNumber(const std::string& text) {
+    size_t i = 0;
+    size_t n = text.size();
+    if (i < n && text[i] == '-') i++;
+    size_t digits = i;
+    while (i < n && text[i] >= '0' && text[i] <= '9') i++;
+    if (i == digits) return false;
+    if (i < n && text[i] == '.') {
+        size_t frac = ++i;
+        while (i < n && text[i] >= '0' && text[i] <= '9') i++;
+        if (i == frac) return false;
+    }
+    if (i < n && (text[i] == 'e' || text[i] == 'E')) {
+        i++;
+        if (i < n && (text[i] == '+' || text[i] == '-')) i++;
+        size_t exp = i;
+        while (i < n && text[i] >= '0' && text[i] <= '9') i++;
+        if (i == exp) return false;
+    }
+    return i == n;
+}
+
+} // namespace
+
+const char* JsonTypeToString(JsonType type) {
+    switch (type) {
+        case JsonType::STRING: return "string";
+        case JsonType::NUMBER: return "number";
+        case JsonType::BOOL: return "boolean";
+        case JsonType::OBJECT: return "object";
+        case JsonType::ARRAY: return "array";
+        default: return "any";
+    }
+}
+
+const char* StructuredOutputModeToString(StructuredOutputMode mode) {
+    switch (mode) {
+        case StructuredOutputMode::NONE: return "none";
+        case StructuredOutputMode::JSON_OBJECT: return "json_object";
+        case StructuredOutputMode::JSON_SCHEMA: return "json_schema";
+        default: return "unknown";
+    }
+}
+
+const char* SchemaViolationToString(SchemaViolation violation) {
+    switch (violation) {
+        case SchemaViolation::NONE: return "none";
+        case SchemaViolation::NOT_OBJECT: return "not_object";
+        case SchemaViolation::SYNTAX: return "syntax";
+        case SchemaViolation::TYPE: return "type";
+        case SchemaViolation::TOO_LARGE: return "too_large";
+        case SchemaViolation::TRUNCATED: return "truncated";
+        case SchemaViolation::MISSING_FIELD: return "missing_field";
+        case SchemaViolation::DEPTH: return "depth";
+        default: return "unknown";
+    }
+}
+
+StructuredOutputValidator::StructuredOutputValidator(const JsonSchema& schema)
+    : schema_(schema) {
+}
+
+bool StructuredOutputValidator::Feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length && !Failed(); i++) {
+        if (phase_ == Phase::AFTER) {
+            trailing_bytes_ += length - i;
+            offset_ += length - i;
+            break;
+        }
+        Step(data[i]);
+        offset_++;
+        if (phase_ == Phase::INSIDE && schema_.max_bytes > 0 &&
+            offset_ - begin_ > schema_.max_bytes) {
+            Fail(SchemaViolation::TOO_LARGE,
+                 "超过 " + std::to_string(schema_.max_bytes) + " 字节，内容需要进一步精简");
+        }
+    }
+    return !Failed();
+}
+
+bool StructuredOutputValidator::Finish() {
+    if (Failed()) {
+        return false;
+    }
+    if (phase_ == Phase::BEFORE) {
+        return Fail(SchemaViolation::NOT_OBJECT, "输出中没有 JSON 对象");
+    }
+    if (phase_ == Phase::INSIDE) {
+        return Fail(SchemaViolation::TRUNCATED, "JSON 对象没有结束（输出被截断）");
+    }
+    return true;
+}
+
+std::string StructuredOutputValidator::Extract(const std::string& output) const {
+    if (phase_ != Phase::AFTER || end_ > output.size()) {
+        return std::string();
+    }
+    return output.substr(begin_, end_ - begin_);
+}
+
+std::string StructuredOutputValidator::RepairInstruction() const {
+    std::string text = "上面的输出不符合要求：";
+    text += error_;
+    text += "。请重新输出完整的 JSON 对象，只输出 JSON 本身，不要代码块标记或其他文字。必需字段：";
+    bool first = true;
+    for (size_t i = 0; i < schema_.field_count; i++) {
+        const JsonSchemaField& field = schema_.fields[i];
+        if (!field.required) {
+            continue;
+        }
+        if (!first) {
+            text += "，";
+        }
+        first = false;
+        text += field.key;
+        text += "（";
+        text += JsonTypeToString(field.type);
+        text += "）";
+    }
+    if (schema_.max_bytes > 0) {
+        text += "。总长度不超过 " + std::to_string(schema_.max_bytes) + " 字节";
+    }
+    text += "。";
+    return text;
+}
+
+bool StructuredOutputValidator::Fail(SchemaViolation violation, const std::string& detail) {
+    if (!Failed()) {
+        violation_ = violation;
+        error_ = detail;
+    }
+    return false;
+}
+
+bool StructuredOutputValidator::Step(char c) {
+    if (phase_ == Phase::BEFORE) {
+        if (c == '{') {
+            phase_ = Phase::INSIDE;
+            begin_ = offset_;
+            depth_ = 1;
+            object_bits_ = 1;
+            expect_ = Expect::KEY_OR_END;
+            return true;
+        }
+        if (IsWhitespace(c)) {
+            return true;
+        }
+        // 根是数组，或者说明文字太长：不是要的对象
+        if (c == '[' && prefix_bytes_ == 0) {
+            return Fail(SchemaViolation::NOT_OBJECT, "根节点必须是 JSON 对象，不能是数组");
+        }
+        if (++prefix_bytes_ > MAX_PREFIX) {
+            return Fail(SchemaViolation::NOT_OBJECT, "输出开头不是 JSON 对象");
+        }
+        return true;
+    }
+
+    if (in_string_) {
+        if (escape_) {
+            escape_ = false;
+        } else if (c == '\\') {
+            escape_ = true;
+        } else if (c == '"') {
+            in_string_ = false;
+            return EndString();
+        }
+        // 第一层的键原样保留（转义不还原，字段名里不会有）
+        if (string_is_key_ && depth_ == 1 && in_string_) {
+            if (key_.size() < MAX_KEY) {
+                key_ += c;
+            } else {
+                key_overflow_ = true;
+            }
+        }
+        return true;
+    }
+
+    if (in_literal_) {
+        if (IsLiteralChar(c)) {
+            if (literal_.size() >= MAX_LITERAL) {
+                return Fail(SchemaViolation::SYNTAX, "数值过长");
+            }
+            literal_ += c;
+            return true;
+        }
+        in_literal_ = false;
+        if (!EndLiteral()) {
+            return false;
+        }
+        // 结束字面量的字符按结构字符继续处理
+    }
+
+    if (IsWhitespace(c)) {
+        return true;
+    }
+
+    switch (expect_) {
+        case Expect::KEY_OR_END:
+            if (c == '}') {
+                return CloseContainer();
+            }
+            [[fallthrough]];
+        case Expect::KEY:
+            if (c != '"') {
+                return Fail(SchemaViolation::SYNTAX, "对象的键必须是带引号的字符串");
+            }
+            in_string_ = true;
+            string_is_key_ = true;
+            key_.clear();
+            key_overflow_ = false;
+            return true;
+
+        case Expect::COLON:
+            if (c != ':') {
+                return Fail(SchemaViolation::SYNTAX, "键后面缺少冒号");
+            }
+            expect_ = Expect::VALUE;
+            return true;
+
+        case Expect::VALUE_OR_END:
+            if (c == ']') {
+                return CloseContainer();
+            }
+            return BeginValue(c);
+
+        case Expect::VALUE:
+            return BeginValue(c);
+
+        case Expect::COMMA_OR_END:
+            if (c == ',') {
+                expect_ = InObject() ? Expect::KEY : Expect::VALUE;
+                return true;
+            }
+            if (c == '}' && InObject()) {
+                return CloseContainer();
+            }
+            if (c == ']' && !InObject()) {
+                return CloseContainer();
+            }
+            return Fail(SchemaViolation::SYNTAX, "缺少逗号或括号不匹配");
+    }
+    return true;
+}
+
+bool StructuredOutputValidator::BeginValue(char c) {
+    JsonType type;
+    if (c == '{') {
+        type = JsonType::OBJECT;
+    } else if (c == '[') {
+        type = JsonType::ARRAY;
+    } else if (c == '"') {
+        type = JsonType::STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        type = JsonType::NUMBER;
+    } else if (c == 't' || c == 'f') {
+        type = JsonType::BOOL;
+    } else if (c == 'n') {
+        type = JsonType::ANY;   // null：字段缺省，解析时按空值处理，不算类型错误
+    } else {
+        return Fail(SchemaViolation::SYNTAX, std::string("意外的字符 '") + c + "'");
+    }
+
+    if (!CheckType(type)) {
+        return false;
+    }
+
+    if (type == JsonType::OBJECT || type == JsonType::ARRAY) {
+        if (depth_ >= MAX_DEPTH) {
+            return Fail(SchemaViolation::DEPTH, "嵌套过深");
+        }
+        bool object = type == JsonType::OBJECT;
+        object_bits_ = (object_bits_ & ((1u << depth_) - 1)) | (object ? 1u << depth_ : 0);
+        depth_++;
+        expect_ = object ? Expect::KEY_OR_END : Expect::VALUE_OR_END;
+        return true;
+    }
+    if (type == JsonType::STRING) {
+        in_string_ = true;
+        string_is_key_ = false;
+        return true;
+    }
+    in_literal_ = true;
+    literal_.assign(1, c);
+    return true;
+}
+
+bool StructuredOutputValidator::CheckType(JsonType actual) {
+    if (actual == JsonType::ANY) {
+        return true;
+    }
+    // 第一层：字段本身；第二层数组：字段的元素
+    const JsonSchemaField* field = field_ >= 0 ? &schema_.fields[field_] : nullptr;
+    if (depth_ == 1 && field && field->type != JsonType::ANY && field->type != actual) {
+        return Fail(SchemaViolation::TYPE, std::string("字段 ") + field->key + " 应为 " +
+                    JsonTypeToString(field->type) + "，实际为 " + JsonTypeToString(actual));
+    }
+    if (depth_ == 2 && !InObject() && field && field->type == JsonType::ARRAY &&
+        field->items != JsonType::ANY && field->items != actual) {
+        return Fail(SchemaViolation::TYPE, std::string("字段 ") + field->key + " 的元素应为 " +
+                    JsonTypeToString(field->items) + "，实际为 " + JsonTypeToString(actual));
+    }
+    return true;
+}
+
+bool StructuredOutputValidator::EndString() {
+    if (!string_is_key_) {
+        expect_ = Expect::COMMA_OR_END;
+        return true;
+    }
+    expect_ = Expect::COLON;
+    if (depth_ == 1) {
+        field_ = -1;
+        if (!key_overflow_) {
+            for (size_t i = 0; i < schema_.field_count; i++) {
+                if (key_ == schema_.fields[i].key) {
+                    field_ = static_cast<int>(i);
+                    if (i < 32) {
+                        seen_ |= 1u << i;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool StructuredOutputValidator::EndLiteral() {
+    bool ok = literal_ == "true" || literal_ == "false" || literal_ == "null" ||
+              IsNumber(literal_);
+    if (!ok) {
+        return Fail(SchemaViolation::SYNTAX, "非法的值 " + literal_);
+    }
+    expect_ = Expect::COMMA_OR_END;
+    return true;
+}
+
+bool StructuredOutputValidator::CloseContainer() {
+    depth_--;
+    if (depth_ > 0) {
+        expect_ = Expect::COMMA_OR_END;
+        return true;
+    }
+
+    // 根对象结束：检查必需字段
+    phase_ = Phase::AFTER;
+    end_ = offset_ + 1;
+    for (size_t i = 0; i < schema_.field_count && i < 32; i++) {
+        if (schema_.fields[i].required && !(seen_ & (1u << i))) {
+            return Fail(SchemaViolation::MISSING_FIELD,
+                        std::string("缺少必需字段 ") + schema_.fields[i].key);
+        }
+    }
+    return true;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,212 @@
+#ifndef STRUCTURED_OUTPUT_H
+#define STRUCTURED_OUTPUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "json_codec.h"
+
+namespace EvoSpark {
+
+// 字段的 JSON 类型（ANY 不检查）
+enum class JsonType : uint8_t {
+    ANY,
+    STRING,
+    NUMBER,
+    BOOL,
+    OBJECT,
+    ARRAY,
+};
+
+const char* JsonTypeToString(JsonType type);
+
+// 根对象的一个字段
+struct JsonSchemaField {
+    const char* key;
+    JsonType type;
+    bool required;
+    JsonType items;         // ARRAY 的元素类型
+};
+
+// 结构化输出的约定：根对象的字段表 + 长度上限
+//
+// 只约束第一层字段和数组元素的类型，更深的结构由调用方解析时处理
+struct JsonSchema {
+    const char* name;
+    const JsonSchemaField* fields;
+    size_t field_count;
+    size_t max_bytes;       // JSON 文本上限，0 不限
+};
+
+// 请求里怎样要求结构化输出
+enum class StructuredOutputMode : uint8_t {
+    NONE,           // 只靠提示词和本地校验
+    JSON_OBJECT,    // response_format: json_object（GLM、DeepSeek、OpenAI 通用）
+    JSON_SCHEMA,    // response_format: json_schema，服务端按字段表约束
+};
+
+const char* StructuredOutputModeToString(StructuredOutputMode mode);
+
+// 违反约定的类型
+enum class SchemaViolation : uint8_t {
+    NONE,
+    NOT_OBJECT,     // 没有 JSON 对象（只有说明文字，或根是数组）
+    SYNTAX,         // JSON 语法错误
+    TYPE,           // 字段或数组元素类型不符
+    TOO_LARGE,      // 超过 max_bytes
+    TRUNCATED,      // 输出结束时对象没有闭合
+    MISSING_FIELD,  // 缺少必需字段
+    DEPTH,          // 嵌套过深
+};
+
+const char* SchemaViolationToString(SchemaViolation violation);
+
+// 结构化输出统计
+struct StructuredOutputStats {
+    uint32_t requests = 0;          // 要求结构化输出的请求
+    uint32_t valid = 0;             // 最终得到合格输出
+    uint32_t first_pass = 0;        // 第一次就合格
+    uint32_t recovered = 0;         // JSON 前后带有代码块标记或说明文字，已在本地剥离
+    uint32_t violations = 0;        // 不合格的输出（含流式中止的）
+    uint32_t aborted = 0;           // 其中校验失败后提前断开的
+    uint32_t repairs = 0;           // 发出的修复请求
+    uint32_t failures = 0;          // 修复后仍不合格，或请求本身失败
+    uint64_t wasted_tokens = 0;     // 不合格输出花掉的 token（提前断开的按已收到的内容估算）
+};
+
+// 流式结构化输出校验
+//
+// 输出边到边喂入 Feed，每个字节只看一次，不缓存内容：
+// - JSON 之前的代码块标记和说明文字跳过（最多 MAX_PREFIX 字节），之后的忽略
+// - 括号、引号、逗号冒号的结构按 JSON 语法检查，数字和字面量只检查字符集
+// - 第一层字段开始时就检查类型，数组元素同样；未知字段放行
+// - 超过 max_bytes 立即判定
+// 一旦判定违反，Feed 返回 false，调用方可以马上断开连接，不再为注定作废的
+// 输出付 token。输出结束后调用 Finish 检查对象是否闭合、必需字段是否齐全。
+class StructuredOutputValidator {
+public:
+    explicit StructuredOutputValidator(const JsonSchema& schema);
+
+    // 喂入一段输出；已判定违反时返回 false（之后的数据忽略）
+    bool Feed(const char* data, size_t length);
+    bool Feed(const std::string& data) { return Feed(data.data(), data.size()); }
+
+    // 输出结束：根对象完整且必需字段齐全时返回 true
+    bool Finish();
+
+    bool Failed() const { return violation_ != SchemaViolation::NONE; }
+    SchemaViolation Violation() const { return violation_; }
+
+    // 违反原因（写进修复提示，也用于日志）
+    const std::string& Error() const { return error_; }
+
+    // JSON 前后有被跳过的内容
+    bool Recovered() const { return prefix_bytes_ > 0 || trailing_bytes_ > 0; }
+
+    // 从完整输出中取出 JSON 对象（Finish 返回 true 之后调用）
+    std::string Extract(const std::string& output) const;
+
+    // 修复请求的用户消息：说明上次的问题和必需字段
+    std::string RepairInstruction() const;
+
+    static constexpr size_t MAX_PREFIX = 256;
+    static constexpr int MAX_DEPTH = 16;
+    static constexpr size_t MAX_KEY = 32;
+    static constexpr size_t MAX_LITERAL = 32;
+
+private:
+    enum class Phase : uint8_t { BEFORE, INSIDE, AFTER };
+    enum class Expect : uint8_t { KEY_OR_END, KEY, COLON, VALUE_OR_END, VALUE, COMMA_OR_END };
+
+    bool Step(char c);
+    bool BeginValue(char c);
+    bool EndString();
+    bool EndLiteral();
+    bool CloseContainer();
+    bool CheckType(JsonType actual);
+    bool Fail(SchemaViolation violation, const std::string& detail);
+
+    bool InObject() const { return (object_bits_ >> (depth_ - 1)) & 1u; }
+
+    const JsonSchema& schema_;
+    Phase phase_ = Phase::BEFORE;
+    Expect expect_ = Expect::VALUE;
+    int depth_ = 0;
+    uint32_t object_bits_ = 0;      // 每层一位：1 为对象，0 为数组
+
+    bool in_string_ = false;
+    bool escape_ = false;
+    bool string_is_key_ = false;
+    bool in_literal_ = false;
+    std::string key_;               // 第一层当前键
+    bool key_overflow_ = false;
+    std::string literal_;           // 当前数字或字面量
+
+    int field_ = -1;                // 第一层当前值对应的字段，-1 为未知字段
+    uint32_t seen_ = 0;             // 已出现的字段（按字段表下标）
+
+    size_t offset_ = 0;             // 已喂入的字节数
+    size_t begin_ = 0;              // 根对象 '{' 的位置
+    size_t end_ = 0;                // 根对象 '}' 之后的位置
+    size_t prefix_bytes_ = 0;
+    size_t trailing_bytes_ = 0;
+
+    SchemaViolation violation_ = SchemaViolation::NONE;
+    std::string error_;
+};
+
+// 写入请求体的 response_format 字段（mode 为 NONE 时什么都不写）
+template <typename Writer>
+void WriteResponseFormat(Writer& json, const JsonSchema& schema, StructuredOutputMode mode) {
+    if (mode == StructuredOutputMode::NONE) {
+        return;
+    }
+    json.Key("response_format");
+    json.BeginObject();
+    if (mode == StructuredOutputMode::JSON_OBJECT) {
+        json.Field("type", "json_object");
+        json.EndObject();
+        return;
+    }
+
+    json.Field("type", "json_schema");
+    json.Key("json_schema");
+    json.BeginObject();
+    json.Field("name", schema.name);
+    json.Key("schema");
+    json.BeginObject();
+    json.Field("type", "object");
+    json.Key("properties");
+    json.BeginObject();
+    for (size_t i = 0; i < schema.field_count; i++) {
+        const JsonSchemaField& field = schema.fields[i];
+        json.Key(field.key);
+        json.BeginObject();
+        if (field.type != JsonType::ANY) {
+            json.Field("type", JsonTypeToString(field.type));
+        }
+        if (field.type == JsonType::ARRAY && field.items != JsonType::ANY) {
+            json.Key("items");
+            json.BeginObject();
+            json.Field("type", JsonTypeToString(field.items));
+            json.EndObject();
+        }
+        json.EndObject();
+    }
+    json.EndObject();
+    json.Key("required");
+    json.BeginArray();
+    for (size_t i = 0; i < schema.field_count; i++) {
+        if (schema.fields[i].required) {
+            json.String(schema.fields[i].key);
+        }
+    }
+    json.EndArray();
+    json.EndObject();
+    json.EndObject();
+    json.EndObject();
+}
+
+} // namespace EvoSpark
+
+#endif // STRUCTURED_OUTPUT_H
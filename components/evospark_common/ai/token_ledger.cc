@@ -0,0 +1,380 @@
+#include "token_ledger.h"
+#include "json_codec.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace EvoSpark {
+
+static const char* TAG = "TokenLedger";
+
+namespace {
+
+constexpr char FILE_MAGIC[4] = {'T', 'K', 'L', '1'};
+constexpr std::time_t VALID_TIME = 1704067200;   // 2024-01-01，早于此说明时间未同步
+constexpr uint32_t DAY_SECONDS = 24 * 3600;
+
+// Flash 文件：当天用量、之前几天的总量和切换状态，末尾为 CRC32
+struct LedgerFile {
+    char magic[4];
+    uint32_t day_key;
+    uint32_t day_elapsed_s;
+    TokenUsage today[TOKEN_PURPOSES];
+    uint64_t history[TokenLedgerSnapshot::HISTORY_DAYS];
+    uint32_t crc;
+};
+
+// 本地日期 -> 自 1970-01-01 起的天数（公历）
+uint32_t DaysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return static_cast<uint32_t>(era * 146097 + static_cast<int>(doe) - 719468);
+}
+
+// 当前本地日期的天数；时间未同步返回 0
+uint32_t LocalDayKey() {
+    std::time_t now = std::time(nullptr);
+    if (now < VALID_TIME) {
+        return 0;
+    }
+    struct tm local;
+    localtime_r(&now, &local);
+    return DaysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+uint64_t SumTotal(const TokenUsage (&usage)[TOKEN_PURPOSES]) {
+    uint64_t total = 0;
+    for (const TokenUsage& u : usage) {
+        total += u.Total();
+    }
+    return total;
+}
+
+template <typename Writer>
+void WriteUsage(Writer& json, const TokenUsage& u) {
+    json.BeginObject();
+    json.Field("requests", u.requests);
+    json.Field("prompt_tokens", u.prompt_tokens);
+    json.Field("completion_tokens", u.completion_tokens);
+    json.Field("cached_tokens", u.cached_tokens);
+    json.Field("total_tokens", u.Total());
+    json.EndObject();
+}
+
+template <typename Writer>
+void WriteByPurpose(Writer& json, const TokenUsage (&usage)[TOKEN_PURPOSES]) {
+    json.BeginObject();
+    for (size_t i = 0; i < TOKEN_PURPOSES; i++) {
+        json.Key(TokenPurposeToString(static_cast<TokenPurpose>(i)));
+        WriteUsage(json, usage[i]);
+    }
+    json.Field("total_tokens", SumTotal(usage));
+    json.EndObject();
+}
+
+} // namespace
+
+const char* TokenPurposeToString(TokenPurpose purpose) {
+    switch (purpose) {
+        case TokenPurpose::CHAT: return "chat";
+        case TokenPurpose::COMPRESSION: return "compression";
+        case TokenPurpose::VISION: return "vision";
+        default: return "unknown";
+    }
+}
+
+const char* BudgetLevelToString(BudgetLevel level) {
+    switch (level) {
+        case BudgetLevel::NORMAL: return "normal";
+        case BudgetLevel::ECONOMY: return "economy";
+        case BudgetLevel::EXHAUSTED: return "exhausted";
+        default: return "unknown";
+    }
+}
+
+void TokenUsage::Add(const TokenUsage& other) {
+    requests += other.requests;
+    prompt_tokens += other.prompt_tokens;
+    completion_tokens += other.completion_tokens;
+    cached_tokens += other.cached_tokens;
+}
+
+uint64_t TokenLedgerSnapshot::SessionTotal() const {
+    return SumTotal(session);
+}
+
+uint64_t TokenLedgerSnapshot::TodayTotal() const {
+    return SumTotal(today);
+}
+
+void TokenLedger::Init(const char* path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = path ? path : "";
+        last_roll_us_ = esp_timer_get_time();
+        last_flush_us_ = last_roll_us_;
+    }
+    if (path) {
+        Load();
+    }
+}
+
+void TokenLedger::Record(TokenPurpose purpose, int prompt_tokens, int completion_tokens,
+                         int cached_tokens) {
+    size_t index = static_cast<size_t>(purpose);
+    if (index >= TOKEN_PURPOSES) {
+        return;
+    }
+
+    TokenUsage usage;
+    usage.requests = 1;
+    usage.prompt_tokens = prompt_tokens > 0 ? prompt_tokens : 0;
+    usage.completion_tokens = completion_tokens > 0 ? completion_tokens : 0;
+    usage.cached_tokens = cached_tokens > 0 ? cached_tokens : 0;
+
+    bool flush = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        RollDayLocked();
+        if (LevelLocked() != BudgetLevel::NORMAL) {
+            economy_requests_++;
+        }
+        last_request_ = usage;
+        last_purpose_ = purpose;
+        session_[index].Add(usage);
+        today_[index].Add(usage);
+        dirty_ = true;
+
+        BudgetLevel level = LevelLocked();
+        if (level != last_level_) {
+            ESP_LOGW(TAG, "Budget level %s -> %s (session %llu, today %llu tokens)",
+                     BudgetLevelToString(last_level_), BudgetLevelToString(level),
+                     static_cast<unsigned long long>(SumTotal(session_)),
+                     static_cast<unsigned long long>(SumTotal(today_)));
+            last_level_ = level;
+        }
+        ESP_LOGI(TAG, "%s: prompt %llu (cached %llu) + completion %llu, session %llu, today %llu",
+                 TokenPurposeToString(purpose),
+                 static_cast<unsigned long long>(usage.prompt_tokens),
+                 static_cast<unsigned long long>(usage.cached_tokens),
+                 static_cast<unsigned long long>(usage.completion_tokens),
+                 static_cast<unsigned long long>(SumTotal(session_)),
+                 static_cast<unsigned long long>(SumTotal(today_)));
+
+        flush = !path_.empty() &&
+                esp_timer_get_time() - last_flush_us_ >= static_cast<int64_t>(FLUSH_INTERVAL_S) * 1000000;
+    }
+
+    if (flush) {
+        Flush();
+    }
+}
+
+void TokenLedger::BeginSession() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (TokenUsage& u : session_) {
+        u = TokenUsage();
+    }
+    last_level_ = LevelLocked();
+}
+
+void TokenLedger::SetBudget(const TokenBudget& budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    if (budget_.economy_percent == 0 || budget_.economy_percent > 100) {
+        budget_.economy_percent = 100;
+    }
+    last_level_ = LevelLocked();
+    ESP_LOGI(TAG, "Budget: session %u, daily %u tokens (economy at %u%%)",
+             static_cast<unsigned>(budget_.session_tokens),
+             static_cast<unsigned>(budget_.daily_tokens),
+             static_cast<unsigned>(budget_.economy_percent));
+}
+
+TokenBudget TokenLedger::GetBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+BudgetLevel TokenLedger::GetLevel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RollDayLocked();
+    return LevelLocked();
+}
+
+BudgetLevel TokenLedger::LevelLocked() const {
+    // 会话和当天各自按预算算占用比例（千分比），取较高的一个
+    uint64_t permille = 0;
+    if (budget_.session_tokens > 0) {
+        permille = SumTotal(session_) * 1000 / budget_.session_tokens;
+    }
+    if (budget_.daily_tokens > 0) {
+        permille = std::max<uint64_t>(permille, SumTotal(today_) * 1000 / budget_.daily_tokens);
+    }
+    if (permille >= 1000) {
+        return BudgetLevel::EXHAUSTED;
+    }
+    if (permille >= static_cast<uint64_t>(budget_.economy_percent) * 10) {
+        return BudgetLevel::ECONOMY;
+    }
+    return BudgetLevel::NORMAL;
+}
+
+void TokenLedger::RollDayLocked() {
+    int64_t now_us = esp_timer_get_time();
+    day_elapsed_s_ += static_cast<uint32_t>((now_us - last_roll_us_) / 1000000);
+    last_roll_us_ = now_us - (now_us - last_roll_us_) % 1000000;
+
+    uint32_t days = 0;
+    uint32_t today = LocalDayKey();
+    if (today != 0) {
+        if (day_key_ == 0) {
+            day_key_ = today;       // 时间刚同步：当前累计的就是今天的
+        } else if (today > day_key_) {
+            days = today - day_key_;
+            day_key_ = today;
+        }
+    } else if (day_elapsed_s_ >= DAY_SECONDS) {
+        days = day_elapsed_s_ / DAY_SECONDS;
+        if (day_key_ != 0) {
+            day_key_ += days;
+        }
+    }
+    if (days == 0) {
+        return;
+    }
+
+    // 今天的总量移入历史，之前的顺延
+    const size_t n = TokenLedgerSnapshot::HISTORY_DAYS;
+    uint64_t total = SumTotal(today_);
+    for (size_t i = n; i-- > 0;) {
+        history_[i] = i >= days ? history_[i - days] : 0;
+    }
+    if (days <= n) {
+        history_[days - 1] = total;
+    }
+    for (TokenUsage& u : today_) {
+        u = TokenUsage();
+    }
+    day_elapsed_s_ = today != 0 ? 0 : day_elapsed_s_ % DAY_SECONDS;
+    dirty_ = true;
+    ESP_LOGI(TAG, "New day: %llu tokens used yesterday",
+             static_cast<unsigned long long>(days == 1 ? total : 0));
+}
+
+void TokenLedger::Flush() {
+    LedgerFile file;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_ || path_.empty()) {
+            return;
+        }
+        RollDayLocked();
+        memcpy(file.magic, FILE_MAGIC, sizeof(file.magic));
+        file.day_key = day_key_;
+        file.day_elapsed_s = day_elapsed_s_;
+        memcpy(file.today, today_, sizeof(file.today));
+        memcpy(file.history, history_, sizeof(file.history));
+        path = path_;
+        dirty_ = false;
+        last_flush_us_ = esp_timer_get_time();
+    }
+    file.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&file), offsetof(LedgerFile, crc));
+
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        ESP_LOGW(TAG, "Failed to open %s", tmp.c_str());
+        return;
+    }
+    bool ok = fwrite(&file, sizeof(file), 1, f) == 1;
+    fclose(f);
+    if (!ok) {
+        remove(tmp.c_str());
+        return;
+    }
+    remove(path.c_str());
+    rename(tmp.c_str(), path.c_str());
+}
+
+void TokenLedger::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FILE* f = fopen(path_.c_str(), "rb");
+    if (f == nullptr) {
+        return;
+    }
+    LedgerFile file;
+    bool ok = fread(&file, sizeof(file), 1, f) == 1;
+    fclose(f);
+    if (!ok || memcmp(file.magic, FILE_MAGIC, sizeof(file.magic)) != 0 ||
+        esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&file), offsetof(LedgerFile, crc)) != file.crc) {
+        ESP_LOGW(TAG, "Ignoring malformed ledger %s", path_.c_str());
+        return;
+    }
+
+    day_key_ = file.day_key;
+    day_elapsed_s_ = file.day_elapsed_s;
+    memcpy(today_, file.today, sizeof(today_));
+    memcpy(history_, file.history, sizeof(history_));
+    RollDayLocked();
+    last_level_ = LevelLocked();
+    ESP_LOGI(TAG, "Restored ledger: %llu tokens today",
+             static_cast<unsigned long long>(SumTotal(today_)));
+}
+
+TokenLedgerSnapshot TokenLedger::GetSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RollDayLocked();
+    TokenLedgerSnapshot snapshot;
+    snapshot.last_request = last_request_;
+    snapshot.last_purpose = last_purpose_;
+    memcpy(snapshot.session, session_, sizeof(snapshot.session));
+    memcpy(snapshot.today, today_, sizeof(snapshot.today));
+    memcpy(snapshot.history, history_, sizeof(snapshot.history));
+    snapshot.economy_requests = economy_requests_;
+    snapshot.budget = budget_;
+    snapshot.level = LevelLocked();
+    return snapshot;
+}
+
+std::string TokenLedger::ToJson() {
+    TokenLedgerSnapshot s = GetSnapshot();
+    std::string json;
+    JsonWriteTo(json, [&s](auto& w) {
+        w.BeginObject();
+        w.Field("level", BudgetLevelToString(s.level));
+        w.Key("budget");
+        w.BeginObject();
+        w.Field("session_tokens", s.budget.session_tokens);
+        w.Field("daily_tokens", s.budget.daily_tokens);
+        w.Field("economy_percent", static_cast<unsigned>(s.budget.economy_percent));
+        w.EndObject();
+        w.Key("last_request");
+        WriteUsage(w, s.last_request);
+        w.Field("last_purpose", TokenPurposeToString(s.last_purpose));
+        w.Key("session");
+        WriteByPurpose(w, s.session);
+        w.Key("today");
+        WriteByPurpose(w, s.today);
+        w.Key("history");
+        w.BeginArray();
+        for (uint64_t day : s.history) {
+            w.Uint(day);
+        }
+        w.EndArray();
+        w.Field("economy_requests", s.economy_requests);
+        w.EndObject();
+    });
+    return json;
+}
+
+} // namespace EvoSpark
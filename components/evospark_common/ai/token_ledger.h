@@ -0,0 +1,142 @@
+#ifndef TOKEN_LEDGER_H
+#define TOKEN_LEDGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace EvoSpark {
+
+// token 用途
+enum class TokenPurpose : uint8_t {
+    CHAT = 0,           // 交互对话
+    COMPRESSION = 1,    // 记忆压缩
+    VISION = 2,         // 带图像的对话
+};
+
+constexpr size_t TOKEN_PURPOSES = 3;
+
+const char* TokenPurposeToString(TokenPurpose purpose);
+
+// 一组请求的用量
+struct TokenUsage {
+    uint32_t requests = 0;
+    uint64_t prompt_tokens = 0;
+    uint64_t completion_tokens = 0;
+    uint64_t cached_tokens = 0;     // prompt 中命中服务端前缀缓存的部分
+
+    uint64_t Total() const { return prompt_tokens + completion_tokens; }
+    void Add(const TokenUsage& other);
+};
+
+// 预算（token 数，0 表示不限）
+struct TokenBudget {
+    uint32_t session_tokens = 0;
+    uint32_t daily_tokens = 0;
+    uint8_t economy_percent = 80;   // 用到这个比例进入节省模式
+};
+
+// 预算状态：调用方据此选择更省的请求方式
+enum class BudgetLevel : uint8_t {
+    NORMAL,
+    ECONOMY,        // 接近预算：缩短上下文、换便宜模型、限制回复长度
+    EXHAUSTED,      // 已超预算：只保留最少的上下文，仍然应答
+};
+
+const char* BudgetLevelToString(BudgetLevel level);
+
+// 用量快照（供状态页展示）
+struct TokenLedgerSnapshot {
+    static constexpr size_t HISTORY_DAYS = 7;
+
+    TokenUsage last_request;
+    TokenPurpose last_purpose = TokenPurpose::CHAT;
+    TokenUsage session[TOKEN_PURPOSES];
+    TokenUsage today[TOKEN_PURPOSES];
+    uint64_t history[HISTORY_DAYS] = {};    // 之前各天的总用量，[0] 为昨天
+    uint32_t economy_requests = 0;          // 预算不为 NORMAL 时记账的请求（本次启动）
+    TokenBudget budget;
+    BudgetLevel level = BudgetLevel::NORMAL;
+
+    uint64_t SessionTotal() const;
+    uint64_t TodayTotal() const;
+};
+
+// token 记账：按请求、会话、天统计，按用途（对话/压缩/图像）分开
+//
+// 每个成功的请求由客户端调用 Record 记一笔。当天和之前几天的用量写入
+// Flash，重启后继续累计；会话用量从 BeginSession 起算，不持久化。
+//
+// 按天切换：系统时间已同步时按本地日期；未同步（本项目没有 SNTP）时按
+// 运行时间每满 24 小时切换一次，已运行的时长也随文件保存。
+//
+// 预算由配置给出。会话或当天用量达到 economy_percent 后进入 ECONOMY，
+// 达到 100% 进入 EXHAUSTED，调用方在请求 API 配额耗尽之前先降级。
+class TokenLedger {
+public:
+    static TokenLedger& GetInstance() {
+        static TokenLedger instance;
+        return instance;
+    }
+
+    // path 为 nullptr 时不持久化
+    void Init(const char* path);
+
+    // 记一笔请求用量
+    void Record(TokenPurpose purpose, int prompt_tokens, int completion_tokens, int cached_tokens);
+
+    // 开始新会话（会话用量清零）
+    void BeginSession();
+
+    void SetBudget(const TokenBudget& budget);
+    TokenBudget GetBudget() const;
+
+    // 当前预算状态（跨天时先切换到新的一天）
+    BudgetLevel GetLevel();
+
+    // 写入 Flash（Record 里按 FLUSH_INTERVAL_S 自动调用）
+    void Flush();
+
+    TokenLedgerSnapshot GetSnapshot();
+
+    // 用量快照的 JSON（/api/usage）
+    std::string ToJson();
+
+    static constexpr uint32_t FLUSH_INTERVAL_S = 120;
+
+private:
+    TokenLedger() = default;
+    ~TokenLedger() = default;
+
+    TokenLedger(const TokenLedger&) = delete;
+    TokenLedger& operator=(const TokenLedger&) = delete;
+
+    // 调用方持锁
+    void RollDayLocked();
+    BudgetLevel LevelLocked() const;
+
+    void Load();
+
+    TokenUsage last_request_;
+    TokenPurpose last_purpose_ = TokenPurpose::CHAT;
+    TokenUsage session_[TOKEN_PURPOSES];
+    TokenUsage today_[TOKEN_PURPOSES];
+    uint64_t history_[TokenLedgerSnapshot::HISTORY_DAYS] = {};
+    uint32_t economy_requests_ = 0;
+    TokenBudget budget_;
+    BudgetLevel last_level_ = BudgetLevel::NORMAL;
+
+    uint32_t day_key_ = 0;          // 本地日期的天数（自 1970-01-01），0 表示时间未同步过
+    uint32_t day_elapsed_s_ = 0;    // 当天已运行的秒数（时间未同步时用来切换）
+    int64_t last_roll_us_ = 0;
+
+    std::string path_;
+    bool dirty_ = false;
+    int64_t last_flush_us_ = 0;
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // TOKEN_LEDGER_H
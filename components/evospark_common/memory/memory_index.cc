@@ -0,0 +1,255 @@
+#include "memory_index.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace EvoSpark {
+
+static const char* TAG = "MemoryIndex";
+
+namespace {
+
+// 解码一个 UTF-8 码点，返回字节数（非法序列按 1 字节处理）
+size_t DecodeUtf8(const std::string& s, size_t i, uint32_t& cp) {
+    uint8_t c = static_cast<uint8_t>(s[i]);
+    size_t len = 1;
+    if (c < 0x80) {
+        cp = c;
+        return 1;
+    } else if ((c & 0xE0) == 0xC0) {
+        cp = c & 0x1F;
+        len = 2;
+    } else if ((c & 0xF0) == 0xE0) {
+        cp = c & 0x0F;
+        len = 3;
+    } else if ((c & 0xF8) == 0xF0) {
+        cp = c & 0x07;
+        len = 4;
+    } else {
+        cp = 0xFFFD;
+        return 1;
+    }
+    if (i + len > s.size()) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    for (size_t k = 1; k < len; k++) {
+        uint8_t cc = static_cast<uint8_t>(s[i + k]);
+        if ((cc & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    return len;
+}
+
+bool IsCjk(uint32_t cp) {
+    return (cp >= 0x4E00 && cp <= 0x9FFF) ||   // CJK 统一汉字
+           (cp >= 0x3400 && cp <= 0x4DBF) ||   // 扩展 A
+           (cp >= 0xF900 && cp <= 0xFAFF) ||   // 兼容汉字
+           (cp >= 0x3040 && cp <= 0x30FF) ||   // 平假名 / 片假名
+           (cp >= 0xAC00 && cp <= 0xD7AF);     // 韩文音节
+}
+
+bool IsWordChar(uint32_t cp) {
+    return (cp >= '0' && cp <= '9') ||
+           (cp >= 'a' && cp <= 'z') ||
+           (cp >= 'A' && cp <= 'Z');
+}
+
+// FNV-1a
+uint32_t HashUpdate(uint32_t h, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        h ^= (v >> (i * 8)) & 0xFF;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr uint32_t HASH_SEED = 2166136261u;
+
+} // namespace
+
+void MemoryIndex::Tokenize(const std::string& text, std::vector<uint32_t>& terms) {
+    terms.clear();
+
+    uint32_t prev_cjk = 0;      // 上一个 CJK 字符（0 = 无）
+    uint32_t word_hash = HASH_SEED;
+    size_t word_len = 0;
+
+    auto flush_word = [&]() {
+        if (word_len > 0) {
+            terms.push_back(word_hash);
+        }
+        word_hash = HASH_SEED;
+        word_len = 0;
+    };
+
+    size_t i = 0;
+    while (i < text.size()) {
+        uint32_t cp;
+        i += DecodeUtf8(text, i, cp);
+
+        if (IsCjk(cp)) {
+            flush_word();
+            // 一元组保证单字词（"猫"）可召回，二元组提供词级区分度；
+            // 高频单字（"的" "用"）的 IDF 很低，不会主导得分
+            terms.push_back(HashUpdate(HASH_SEED, cp));
+            if (prev_cjk != 0) {
+                terms.push_back(HashUpdate(HashUpdate(HASH_SEED, prev_cjk), cp));
+            }
+            prev_cjk = cp;
+        } else if (IsWordChar(cp)) {
+            prev_cjk = 0;
+            if (cp >= 'A' && cp <= 'Z') {
+                cp += 'a' - 'A';
+            }
+            word_hash = HashUpdate(word_hash, cp);
+            word_len++;
+        } else {
+            prev_cjk = 0;
+            flush_word();
+        }
+    }
+    flush_word();
+}
+
+int MemoryIndex::EstimateTokens(const std::string& text) {
+    int cjk = 0;
+    int other_bytes = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        uint32_t cp;
+        size_t len = DecodeUtf8(text, i, cp);
+        if (len > 1) {
+            cjk++;
+        } else {
+            other_bytes++;
+        }
+        i += len;
+    }
+    return cjk + (other_bytes + 3) / 4;
+}
+
+void MemoryIndex::Clear() {
+    docs_.clear();
+    postings_.clear();
+    total_length_ = 0;
+    total_tokens_ = 0;
+}
+
+void MemoryIndex::Add(MemorySource source, const std::string& text) {
+    if (text.empty() || docs_.size() >= UINT16_MAX) {
+        return;
+    }
+
+    std::vector<uint32_t> terms;
+    Tokenize(text, terms);
+    if (terms.empty()) {
+        return;
+    }
+
+    uint16_t doc_id = static_cast<uint16_t>(docs_.size());
+    Doc doc;
+    doc.source = source;
+    doc.text = text;
+    doc.length = static_cast<uint16_t>(std::min<size_t>(terms.size(), UINT16_MAX));
+    doc.tokens = EstimateTokens(text);
+    docs_.push_back(std::move(doc));
+
+    total_length_ += docs_.back().length;
+    total_tokens_ += docs_.back().tokens;
+
+    // 同一文档内的重复词项合并为词频
+    std::sort(terms.begin(), terms.end());
+    for (size_t i = 0; i < terms.size();) {
+        size_t j = i;
+        while (j < terms.size() && terms[j] == terms[i]) {
+            j++;
+        }
+        postings_[terms[i]].push_back(
+            {doc_id, static_cast<uint16_t>(std::min<size_t>(j - i, UINT16_MAX))});
+        i = j;
+    }
+}
+
+std::vector<MemoryHit> MemoryIndex::Query(const std::string& query,
+                                          size_t top_k,
+                                          int token_budget) const {
+    std::vector<MemoryHit> hits;
+
+    stats_.queries++;
+    stats_.full_tokens += total_tokens_;
+
+    if (docs_.empty() || top_k == 0 || token_budget <= 0) {
+        stats_.empty_queries++;
+        return hits;
+    }
+
+    std::vector<uint32_t> terms;
+    Tokenize(query, terms);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    const float n = static_cast<float>(docs_.size());
+    const float avgdl = static_cast<float>(total_length_) / n;
+    std::vector<float> scores(docs_.size(), 0.0f);
+
+    for (uint32_t term : terms) {
+        auto it = postings_.find(term);
+        if (it == postings_.end()) {
+            continue;
+        }
+        const std::vector<Posting>& list = it->second;
+        float df = static_cast<float>(list.size());
+        float idf = std::log(1.0f + (n - df + 0.5f) / (df + 0.5f));
+        for (const Posting& p : list) {
+            float tf = static_cast<float>(p.tf);
+            float dl = static_cast<float>(docs_[p.doc].length);
+            scores[p.doc] += idf * tf * (K1 + 1.0f) /
+                             (tf + K1 * (1.0f - B + B * dl / avgdl));
+        }
+    }
+
+    std::vector<uint16_t> ranked;
+    for (size_t i = 0; i < scores.size(); i++) {
+        if (scores[i] > 0.0f) {
+            ranked.push_back(static_cast<uint16_t>(i));
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [&scores](uint16_t a, uint16_t b) {
+        return scores[a] > scores[b];
+    });
+
+    // 按得分依次放入，放不下的跳过，继续尝试更短的条目
+    int used = 0;
+    float min_score = ranked.empty() ? 0.0f : scores[ranked[0]] * MIN_RELATIVE_SCORE;
+    for (uint16_t id : ranked) {
+        if (hits.size() >= top_k || scores[id] < min_score) {
+            break;
+        }
+        const Doc& doc = docs_[id];
+        if (used + doc.tokens > token_budget) {
+            continue;
+        }
+        MemoryHit hit;
+        hit.source = doc.source;
+        hit.text = doc.text;
+        hit.score = scores[id];
+        hit.tokens = doc.tokens;
+        hits.push_back(std::move(hit));
+        used += doc.tokens;
+    }
+
+    if (hits.empty()) {
+        stats_.empty_queries++;
+    }
+    stats_.injected_tokens += used;
+
+    ESP_LOGD(TAG, "Query: %zu terms, %zu/%zu docs, %d/%d tokens",
+             terms.size(), hits.size(), docs_.size(), used, total_tokens_);
+    return hits;
+}
+
+} // namespace EvoSpark
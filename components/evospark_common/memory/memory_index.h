@@ -0,0 +1,102 @@
+#ifndef MEMORY_INDEX_H
+#define MEMORY_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace EvoSpark {
+
+// 记忆条目来源
+enum class MemorySource : uint8_t {
+    PROFILE,      // 用户画像
+    EVENT,        // 关键事件 / 记忆项
+    PREFERENCE,   // 偏好
+    SUMMARY       // 归档的会话摘要
+};
+
+// 检索命中
+struct MemoryHit {
+    MemorySource source;
+    std::string text;
+    float score = 0.0f;
+    int tokens = 0;
+};
+
+// 检索统计
+struct RetrievalStats {
+    uint32_t queries = 0;           // 查询次数
+    uint32_t empty_queries = 0;     // 无命中次数
+    uint64_t injected_tokens = 0;   // 实际注入的 token 累计
+    uint64_t full_tokens = 0;       // 全量注入时的 token 累计（对照）
+};
+
+// 记忆检索索引 - 基于 CJK 二元组 + 英文单词的 BM25 倒排索引
+//
+// 中文没有空格分词，这里把连续的 CJK 字符切成相邻二元组（"喜欢猫" ->
+// "喜欢" "欢猫"），同时保留单字一元组；ASCII 字母数字按单词切分并转小写。
+// 词项以 32 位哈希存储，索引只在记忆更新时重建，查询只做一次倒排表扫描，
+// 条目数在百级时耗时可忽略。
+class MemoryIndex {
+public:
+    MemoryIndex() = default;
+    ~MemoryIndex() = default;
+
+    // 清空索引
+    void Clear();
+
+    // 添加条目（空文本忽略）
+    void Add(MemorySource source, const std::string& text);
+
+    // 条目数量
+    size_t Size() const { return docs_.size(); }
+
+    // 所有条目的 token 总数（全量注入的成本）
+    int GetTotalTokens() const { return total_tokens_; }
+
+    // 查询：按 BM25 得分取前 top_k 条，累计 token 不超过 token_budget
+    std::vector<MemoryHit> Query(const std::string& query,
+                                 size_t top_k,
+                                 int token_budget) const;
+
+    // 检索统计
+    const RetrievalStats& GetStats() const { return stats_; }
+
+    // 估算文本 token 数（CJK 按 1 字 1 token，其余按 4 字节 1 token）
+    static int EstimateTokens(const std::string& text);
+
+    // BM25 参数
+    static constexpr float K1 = 1.2f;
+    static constexpr float B = 0.75f;
+
+    // 得分低于最高分该比例的条目视为弱相关，不注入
+    static constexpr float MIN_RELATIVE_SCORE = 0.3f;
+
+private:
+    struct Doc {
+        MemorySource source;
+        std::string text;
+        uint16_t length;   // 词项数量
+        int tokens;
+    };
+
+    struct Posting {
+        uint16_t doc;
+        uint16_t tf;
+    };
+
+    // 切分文本为词项哈希
+    static void Tokenize(const std::string& text, std::vector<uint32_t>& terms);
+
+    std::vector<Doc> docs_;
+    std::unordered_map<uint32_t, std::vector<Posting>> postings_;
+    uint32_t total_length_ = 0;
+    int total_tokens_ = 0;
+
+    mutable RetrievalStats stats_;
+};
+
+} // namespace EvoSpark
+
+#endif // MEMORY_INDEX_H
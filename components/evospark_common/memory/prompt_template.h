@@ -0,0 +1,160 @@
+#ifndef PROMPT_TEMPLATE_H
+#define PROMPT_TEMPLATE_H
+
+#include <string>
+#include <cstddef>
+#include <cstring>
+
+namespace EvoSpark {
+
+// 编译期 Prompt 模板
+//
+// 模板文本中的 {{0}}、{{1}} ... 为插槽。PROMPT_TEMPLATE 在编译期把文本拆成
+// 静态片段 + 插槽序号，渲染时静态片段直接追加，插槽由调用方回调写入同一个
+// sink。RenderTemplate(std::string&) 先用计数 sink 量出总长度，再一次性
+// reserve 后写入：整个渲染最多一次分配，每个字节只复制一次。
+
+// 模板片段
+struct TemplateSegment {
+    const char* text;   // 静态片段（插槽为 nullptr）
+    size_t length;
+    int slot;           // 插槽序号，-1 表示静态片段
+};
+
+template <size_t N>
+struct CompiledTemplate {
+    TemplateSegment segments[N] = {};
+    size_t count = 0;
+    size_t static_bytes = 0;  // 静态片段总长度
+};
+
+namespace prompt_detail {
+
+// text[i] 处是否为 {{数字}}，是则返回插槽序号并给出结束位置
+constexpr int MatchSlot(const char* text, size_t i, size_t& end) {
+    if (text[i] != '{' || text[i + 1] != '{') {
+        return -1;
+    }
+    size_t j = i + 2;
+    int slot = 0;
+    bool digits = false;
+    while (text[j] >= '0' && text[j] <= '9') {
+        slot = slot * 10 + (text[j] - '0');
+        digits = true;
+        j++;
+    }
+    if (!digits || text[j] != '}' || text[j + 1] != '}') {
+        return -1;
+    }
+    end = j + 2;
+    return slot;
+}
+
+} // namespace prompt_detail
+
+// 统计片段数量（用于确定 CompiledTemplate 的大小）
+constexpr size_t CountTemplateSegments(const char* text) {
+    size_t count = 0;
+    bool in_static = false;
+    for (size_t i = 0; text[i] != '\0';) {
+        size_t end = 0;
+        if (prompt_detail::MatchSlot(text, i, end) >= 0) {
+            count++;
+            in_static = false;
+            i = end;
+        } else {
+            if (!in_static) {
+                count++;
+                in_static = true;
+            }
+            i++;
+        }
+    }
+    return count > 0 ? count : 1;
+}
+
+// 编译模板
+template <size_t N>
+constexpr CompiledTemplate<N> CompileTemplate(const char* text) {
+    CompiledTemplate<N> tpl;
+    size_t static_start = 0;
+    size_t i = 0;
+    while (text[i] != '\0') {
+        size_t end = 0;
+        int slot = prompt_detail::MatchSlot(text, i, end);
+        if (slot < 0) {
+            i++;
+            continue;
+        }
+        if (i > static_start) {
+            tpl.segments[tpl.count++] = {text + static_start, i - static_start, -1};
+            tpl.static_bytes += i - static_start;
+        }
+        tpl.segments[tpl.count++] = {nullptr, 0, slot};
+        i = end;
+        static_start = end;
+    }
+    if (i > static_start) {
+        tpl.segments[tpl.count++] = {text + static_start, i - static_start, -1};
+        tpl.static_bytes += i - static_start;
+    }
+    return tpl;
+}
+
+// 定义编译期模板：PROMPT_TEMPLATE(kName, "文本 {{0}} 文本");
+#define PROMPT_TEMPLATE(name, text)                                             \
+    static constexpr const char name##_text[] = text;                          \
+    static constexpr auto name =                                               \
+        ::EvoSpark::CompileTemplate<::EvoSpark::CountTemplateSegments(name##_text)>(name##_text)
+
+// 只统计长度的 sink
+struct CountingSink {
+    size_t bytes = 0;
+
+    void Append(const char* data, size_t length) { bytes += length; }
+    void Append(const char* str) { bytes += strlen(str); }
+    void Append(const std::string& str) { bytes += str.size(); }
+};
+
+// 追加到字符串的 sink（字符串由调用方复用，不清除已有内容）
+struct StringSink {
+    std::string& out;
+
+    void Append(const char* data, size_t length) { out.append(data, length); }
+    void Append(const char* str) { out.append(str); }
+    void Append(const std::string& str) { out.append(str); }
+};
+
+// 渲染到任意 sink；write_slot(slot, sink) 负责写入插槽内容
+template <size_t N, typename Sink, typename SlotWriter>
+void RenderTemplate(const CompiledTemplate<N>& tpl, Sink& sink, SlotWriter&& write_slot) {
+    for (size_t i = 0; i < tpl.count; i++) {
+        const TemplateSegment& seg = tpl.segments[i];
+        if (seg.slot < 0) {
+            sink.Append(seg.text, seg.length);
+        } else {
+            write_slot(seg.slot, sink);
+        }
+    }
+}
+
+// 没有插槽的模板
+template <size_t N, typename Sink>
+void RenderTemplate(const CompiledTemplate<N>& tpl, Sink& sink) {
+    RenderTemplate(tpl, sink, [](int, Sink&) {});
+}
+
+// 两遍渲染到字符串末尾：先量长度，再一次 reserve 后写入
+template <size_t N, typename SlotWriter>
+void RenderTemplate(const CompiledTemplate<N>& tpl, std::string& out, SlotWriter&& write_slot) {
+    CountingSink counter;
+    RenderTemplate(tpl, counter, write_slot);
+    out.reserve(out.size() + counter.bytes);
+
+    StringSink sink{out};
+    RenderTemplate(tpl, sink, write_slot);
+}
+
+} // namespace EvoSpark
+
+#endif // PROMPT_TEMPLATE_H
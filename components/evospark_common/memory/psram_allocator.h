@@ -0,0 +1,45 @@
+#ifndef PSRAM_ALLOCATOR_H
+#define PSRAM_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include "esp_heap_caps.h"
+
+namespace EvoSpark {
+
+// 优先从 PSRAM 分配的 STL 分配器（PSRAM 不可用时退回内部 RAM）
+//
+// 用于体积较大、生命周期较长的只读数据（例如记忆快照），
+// 把有限的内部 RAM 留给网络栈和任务栈。
+template <typename T>
+struct PsramAllocator {
+    using value_type = T;
+
+    PsramAllocator() noexcept = default;
+    template <typename U>
+    PsramAllocator(const PsramAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        void* p = heap_caps_malloc(n * sizeof(T), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!p) {
+            p = heap_caps_malloc(n * sizeof(T), MALLOC_CAP_DEFAULT);
+        }
+        if (!p) {
+            abort();  // 与默认 operator new 在 -fno-exceptions 下的行为一致
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        heap_caps_free(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PsramAllocator<T>&, const PsramAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const PsramAllocator<T>&, const PsramAllocator<U>&) { return false; }
+
+} // namespace EvoSpark
+
+#endif // PSRAM_ALLOCATOR_H
@@ -0,0 +1,72 @@
+#ifndef SNAPSHOT_CELL_H
+#define SNAPSHOT_CELL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace EvoSpark {
+
+// 单写多读的只读快照指针，读者不取任何锁
+//
+// 快照放在两个槽位里轮流写入，序号 seq_ 指向当前槽位。读者读序号、在该
+// 槽位登记、确认序号没变后拷贝槽位里的 shared_ptr 再退出登记；发布恰好
+// 同时发生时重试。写者只写非当前的槽位，并等登记在上面的读者退出（它们
+// 持有的是上一个快照，拷贝只需一次引用计数加一）。旧快照的回收交给
+// shared_ptr：槽位被覆盖时放掉槽位的引用，读者手里的拷贝还在时不会释放。
+//
+// std::atomic_load(shared_ptr) 在 libstdc++ 里按地址取全局互斥锁池里的
+// 一把，不是无锁的，所以这里不用它。
+template <typename T>
+class SnapshotCell {
+public:
+    using Ptr = std::shared_ptr<const T>;
+
+    explicit SnapshotCell(Ptr initial) { slots_[0].ptr = std::move(initial); }
+
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    // 取当前快照（任意任务）
+    Ptr Load() const {
+        for (;;) {
+            uint32_t seq = seq_.load();
+            Slot& slot = slots_[seq % SLOTS];
+            slot.readers.fetch_add(1);
+            if (seq_.load() == seq) {
+                Ptr ptr = slot.ptr;
+                slot.readers.fetch_sub(1);
+                return ptr;
+            }
+            slot.readers.fetch_sub(1);
+        }
+    }
+
+    // 发布新快照（调用方保证同一时刻只有一个写者）
+    void Store(Ptr ptr) {
+        uint32_t next = seq_.load() + 1;
+        Slot& slot = slots_[next % SLOTS];
+        while (slot.readers.load() != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        slot.ptr = std::move(ptr);
+        seq_.store(next);
+    }
+
+private:
+    static constexpr uint32_t SLOTS = 2;
+
+    struct Slot {
+        std::atomic<uint32_t> readers{0};
+        Ptr ptr;
+    };
+
+    mutable Slot slots_[SLOTS];
+    std::atomic<uint32_t> seq_{0};
+};
+
+} // namespace EvoSpark
+
+#endif // SNAPSHOT_CELL_H
@@ -0,0 +1,171 @@
+#include "lz_block.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace EvoSpark {
+
+namespace {
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Hash(uint32_t v, size_t bits) {
+    return (v * 2654435761u) >> (32 - bits);
+}
+
+// 写入扩展长度（255 续位）
+inline void WriteLength(std::string& out, size_t len) {
+    while (len >= 255) {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+    }
+    out.push_back(static_cast<char>(len));
+}
+
+void WriteSequence(std::string& out, const uint8_t* literals, size_t lit_len,
+                   size_t offset, size_t match_len) {
+    uint8_t token = static_cast<uint8_t>((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (match_len > 0) {
+        size_t m = match_len - 4;
+        token |= static_cast<uint8_t>(m >= 15 ? 15 : m);
+    }
+    out.push_back(static_cast<char>(token));
+    if (lit_len >= 15) {
+        WriteLength(out, lit_len - 15);
+    }
+    out.append(reinterpret_cast<const char*>(literals), lit_len);
+    if (match_len > 0) {
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (match_len - 4 >= 15) {
+            WriteLength(out, match_len - 4 - 15);
+        }
+    }
+}
+
+} // namespace
+
+void LzBlock::Compress(const std::string& input, std::string& output) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(input.data());
+    const size_t n = input.size();
+
+    output.reserve(output.size() + n / 2 + 16);
+
+    size_t anchor = 0;
+    if (n >= MF_LIMIT + 1) {
+        std::vector<uint32_t> table(1u << HASH_BITS, UINT32_MAX);
+        const size_t match_limit = n - MF_LIMIT;
+        const size_t end_limit = n - LAST_LITERALS;
+
+        size_t pos = 0;
+        while (pos < match_limit) {
+            uint32_t seq = Read32(src + pos);
+            uint32_t h = Hash(seq, HASH_BITS);
+            uint32_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(pos);
+
+            if (candidate == UINT32_MAX || pos - candidate > MAX_OFFSET ||
+                Read32(src + candidate) != seq) {
+                pos++;
+                continue;
+            }
+
+            // 向后延伸匹配
+            size_t len = MIN_MATCH;
+            while (pos + len < end_limit && src[candidate + len] == src[pos + len]) {
+                len++;
+            }
+            // 向前延伸到上一个锚点
+            while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+                pos--;
+                candidate--;
+                len++;
+            }
+
+            WriteSequence(output, src + anchor, pos - anchor, pos - candidate, len);
+            pos += len;
+            anchor = pos;
+
+            // 为匹配末尾补充哈希，提高后续命中率
+            if (pos - 2 < match_limit) {
+                table[Hash(Read32(src + pos - 2), HASH_BITS)] = static_cast<uint32_t>(pos - 2);
+            }
+        }
+    }
+
+    WriteSequence(output, src + anchor, n - anchor, 0, 0);
+}
+
+bool LzBlock::Decompress(const char* input, size_t input_size,
+                         size_t raw_size, std::string& output) {
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(input);
+    const uint8_t* const iend = ip + input_size;
+
+    size_t base = output.size();
+    output.resize(base + raw_size);
+    uint8_t* const out = reinterpret_cast<uint8_t*>(&output[base]);
+    size_t op = 0;
+
+    auto read_length = [&](size_t& len) -> bool {
+        uint8_t b;
+        do {
+            if (ip >= iend) return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_length(lit_len)) {
+            break;
+        }
+        if (lit_len > static_cast<size_t>(iend - ip) || lit_len > raw_size - op) {
+            break;
+        }
+        memcpy(out + op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // 最后一个序列没有匹配部分
+        if (ip == iend) {
+            if (op == raw_size) {
+                return true;
+            }
+            break;
+        }
+
+        if (iend - ip < 2) {
+            break;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 0x0F;
+        if (match_len == 15 && !read_length(match_len)) {
+            break;
+        }
+        match_len += MIN_MATCH;
+
+        if (offset == 0 || offset > op || match_len > raw_size - op) {
+            break;
+        }
+        // 可能重叠，逐字节复制
+        const uint8_t* match = out + op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            out[op + i] = match[i];
+        }
+        op += match_len;
+    }
+
+    output.resize(base);
+    return false;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,35 @@
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <string>
+#include <cstddef>
+
+namespace EvoSpark {
+
+// 块压缩编解码（LZ4 块格式）
+//
+// 序列 = token(高 4 位字面量长度, 低 4 位匹配长度 - 4) + 扩展长度(255 续位)
+//        + 字面量 + 2 字节小端偏移。最后一个序列只有字面量。
+// 压缩只用一张 4096 项哈希表（16KB，用完释放），解压无额外内存，
+// 适合对几十 KB 以内的块做一次性压缩。
+class LzBlock {
+public:
+    // 压缩 input，结果追加到 output
+    static void Compress(const std::string& input, std::string& output);
+
+    // 解压 input（必须给出原始大小），失败返回 false
+    static bool Decompress(const char* input, size_t input_size,
+                           size_t raw_size, std::string& output);
+
+private:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t HASH_BITS = 12;
+    static constexpr size_t MAX_OFFSET = 65535;
+    // LZ4 约定：最后 5 字节必须是字面量，最后一个匹配至少距结尾 12 字节
+    static constexpr size_t LAST_LITERALS = 5;
+    static constexpr size_t MF_LIMIT = 12;
+};
+
+} // namespace EvoSpark
+
+#endif // LZ_BLOCK_H
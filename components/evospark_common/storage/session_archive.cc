@@ -0,0 +1,556 @@
+#include "session_archive.h"
+#include "lz_block.h"
+#include "json_codec.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace EvoSpark {
+
+static const char* TAG = "SessionArchive";
+
+static const char INDEX_MAGIC[4] = {'S', 'A', 'I', '1'};
+
+SessionArchive::SessionArchive(const std::string& dir) : dir_(dir) {
+}
+
+bool SessionArchive::Init() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (initialized_) {
+        return true;
+    }
+
+    struct stat st;
+    if (stat(dir_.c_str(), &st) != 0 && mkdir(dir_.c_str(), 0775) != 0) {
+        ESP_LOGE(TAG, "Failed to create archive directory %s", dir_.c_str());
+        return false;
+    }
+
+    if (!LoadIndex()) {
+        return false;
+    }
+    LoadTail();
+
+    initialized_ = true;
+    ESP_LOGI(TAG, "Archive loaded: %zu sessions, %zu blocks, %zu tail records, %u bytes",
+             Count(), blocks_.size(), tail_.size(),
+             static_cast<unsigned>(data_end_ + tail_bytes_));
+    return true;
+}
+
+bool SessionArchive::LoadIndex() {
+    blocks_.clear();
+    data_end_ = 0;
+    next_id_ = 1;
+    last_end_time_ = 0;
+    time_ordered_ = true;
+
+    FILE* f = fopen(IndexPath().c_str(), "rb");
+    if (f == nullptr) {
+        return true;  // 空归档
+    }
+
+    char magic[4];
+    bool valid = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                 memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0;
+    if (!valid) {
+        fclose(f);
+        ESP_LOGE(TAG, "Invalid archive index");
+        return false;
+    }
+
+    BlockEntry entry;
+    bool truncated = false;
+    size_t n;
+    while ((n = fread(&entry, 1, sizeof(entry), f)) == sizeof(entry)) {
+        // 索引项必须首尾相接、ID 连续
+        if (entry.offset != data_end_ || entry.first_id != next_id_ || entry.count == 0) {
+            truncated = true;
+            break;
+        }
+        blocks_.push_back(entry);
+        data_end_ = entry.offset + entry.stored_size;
+        next_id_ = entry.first_id + entry.count;
+        // 块内顺序只能看标志（旧版本的块不知道，按不单调处理）
+        if (!(entry.flags & BLOCK_TIME_ORDERED)) {
+            time_ordered_ = false;
+        }
+        TrackEndTime(entry.first_time);
+        TrackEndTime(entry.last_time);
+    }
+    if (n != 0 && n != sizeof(entry)) {
+        truncated = true;  // 写入索引项时掉电
+    }
+    fclose(f);
+
+    // 丢弃不完整的索引项，重写索引文件，保证后续追加对齐
+    if (truncated) {
+        ESP_LOGW(TAG, "Archive index truncated to %zu blocks", blocks_.size());
+        std::string tmp = IndexPath() + ".tmp";
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (out == nullptr) {
+            return false;
+        }
+        fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), out);
+        if (!blocks_.empty()) {
+            fwrite(blocks_.data(), sizeof(BlockEntry), blocks_.size(), out);
+        }
+        fclose(out);
+        remove(IndexPath().c_str());
+        rename(tmp.c_str(), IndexPath().c_str());
+    }
+
+    return true;
+}
+
+bool SessionArchive::LoadTail() {
+    tail_.clear();
+    tail_bytes_ = 0;
+
+    FILE* f = fopen(TailPath().c_str(), "rb");
+    if (f == nullptr) {
+        return true;
+    }
+
+    std::string content;
+    char buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        content.append(buf, n);
+    }
+    fclose(f);
+
+    size_t start = 0;
+    while (start < content.size()) {
+        size_t end = content.find('\n', start);
+        if (end == std::string::npos) {
+            break;  // 最后一行不完整（写入时掉电），丢弃
+        }
+        std::string record = content.substr(start, end - start);
+        start = end + 1;
+
+        uint32_t id = ParseId(record);
+        // 已经封存进块的记录（封存后删除尾部文件前掉电）
+        if (id < next_id_) {
+            continue;
+        }
+        if (id != next_id_) {
+            ESP_LOGW(TAG, "Unexpected tail record id %u (want %u)",
+                     static_cast<unsigned>(id), static_cast<unsigned>(next_id_));
+            break;
+        }
+
+        const char* p = strstr(record.c_str(), "\"end\":");
+        TailEntry entry;
+        entry.id = id;
+        entry.end_time = p ? strtoul(p + 6, nullptr, 10) : 0;
+        TrackEndTime(entry.end_time);
+        entry.record = std::move(record);
+        tail_bytes_ += entry.record.size() + 1;
+        tail_.push_back(std::move(entry));
+        next_id_++;
+    }
+
+    // 有记录被丢弃时重写尾部文件，避免后续追加接在残缺行后面
+    if (tail_bytes_ != content.size()) {
+        std::string tmp = TailPath() + ".tmp";
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (out == nullptr) {
+            return false;
+        }
+        for (const auto& entry : tail_) {
+            fwrite(entry.record.data(), 1, entry.record.size(), out);
+            fputc('\n', out);
+        }
+        fclose(out);
+        remove(TailPath().c_str());
+        rename(tmp.c_str(), TailPath().c_str());
+        ESP_LOGW(TAG, "Archive tail repaired: %zu records kept", tail_.size());
+    }
+
+    return true;
+}
+
+uint32_t SessionArchive::Append(std::time_t start_time, std::time_t end_time,
+                                const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!initialized_) {
+        return 0;
+    }
+
+    uint32_t id = next_id_;
+
+    // 一行一条记录：去掉格式化换行（JSON 字符串内不会有裸换行）
+    std::string body = payload.empty() ? "{}" : payload;
+    std::replace(body.begin(), body.end(), '\n', ' ');
+    std::replace(body.begin(), body.end(), '\r', ' ');
+
+    // id 必须是第一个字段（见 ParseId）
+    std::string record;
+    JsonWriteTo(record, [&](auto& w) {
+        w.BeginObject();
+        w.Field("id", id);
+        w.Field("start", static_cast<long long>(start_time));
+        w.Field("end", static_cast<long long>(end_time));
+        w.Key("session");
+        w.Raw(body);
+        w.EndObject();
+    });
+
+    FILE* f = fopen(TailPath().c_str(), "ab");
+    if (f == nullptr) {
+        ESP_LOGE(TAG, "Failed to open archive tail");
+        return 0;
+    }
+    bool ok = fwrite(record.data(), 1, record.size(), f) == record.size() &&
+              fputc('\n', f) != EOF;
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to append session %u", static_cast<unsigned>(id));
+        return 0;
+    }
+
+    TailEntry entry;
+    entry.id = id;
+    entry.end_time = static_cast<uint32_t>(end_time);
+    TrackEndTime(entry.end_time);
+    entry.record = std::move(record);
+    tail_bytes_ += entry.record.size() + 1;
+    tail_.push_back(std::move(entry));
+    next_id_++;
+
+    ESP_LOGI(TAG, "Session %u archived (%zu tail bytes)",
+             static_cast<unsigned>(id), tail_bytes_);
+
+    if (tail_bytes_ >= BLOCK_SIZE) {
+        SealTail();
+    }
+    return id;
+}
+
+bool SessionArchive::SealTail() {
+    if (tail_.empty()) {
+        return true;
+    }
+
+    std::string raw;
+    raw.reserve(tail_bytes_);
+    uint32_t first_time = UINT32_MAX;
+    uint32_t last_time = 0;
+    bool ordered = true;
+    for (const auto& entry : tail_) {
+        raw += entry.record;
+        raw += '\n';
+        ordered = ordered && entry.end_time >= last_time;
+        first_time = std::min(first_time, entry.end_time);
+        last_time = std::max(last_time, entry.end_time);
+    }
+
+    std::string compressed;
+    LzBlock::Compress(raw, compressed);
+
+    BlockEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = data_end_;
+    entry.stored_size = compressed.size();
+    entry.raw_size = raw.size();
+    entry.first_id = tail_.front().id;
+    entry.first_time = first_time;
+    entry.last_time = last_time;
+    entry.count = tail_.size();
+    entry.flags = ordered ? BLOCK_TIME_ORDERED : 0;
+    entry.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(compressed.data()),
+                                 compressed.size());
+
+    // 1. 写数据块（覆盖上次掉电留下的残余数据）
+    FILE* f = fopen(DataPath().c_str(), "r+b");
+    if (f == nullptr) {
+        f = fopen(DataPath().c_str(), "w+b");
+    }
+    if (f == nullptr) {
+        ESP_LOGE(TAG, "Failed to open archive data");
+        return false;
+    }
+    bool ok = fseek(f, data_end_, SEEK_SET) == 0 &&
+              fwrite(compressed.data(), 1, compressed.size(), f) == compressed.size();
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write archive block");
+        return false;
+    }
+
+    // 2. 追加索引项（写入后块才可见）
+    bool new_index = access(IndexPath().c_str(), F_OK) != 0;
+    f = fopen(IndexPath().c_str(), "ab");
+    if (f == nullptr) {
+        ESP_LOGE(TAG, "Failed to open archive index");
+        return false;
+    }
+    ok = (!new_index || fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), f) == sizeof(INDEX_MAGIC)) &&
+         fwrite(&entry, 1, sizeof(entry), f) == sizeof(entry);
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write archive index");
+        return false;
+    }
+
+    // 3. 删除尾部文件（掉电时重启会跳过已封存的记录）
+    remove(TailPath().c_str());
+
+    blocks_.push_back(entry);
+    data_end_ += entry.stored_size;
+
+    ESP_LOGI(TAG, "Block %zu sealed: %u sessions, %u -> %u bytes",
+             blocks_.size() - 1, static_cast<unsigned>(entry.count),
+             static_cast<unsigned>(entry.raw_size),
+             static_cast<unsigned>(entry.stored_size));
+
+    tail_.clear();
+    tail_bytes_ = 0;
+    return true;
+}
+
+bool SessionArchive::GetPage(size_t page, size_t page_size,
+                             std::vector<std::string>& records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    records.clear();
+    page_size = std::max<size_t>(1, std::min(page_size, MAX_PAGE_SIZE));
+
+    size_t total = Count();
+    size_t skip = page * page_size;
+    if (skip >= total) {
+        return true;  // 超出末页
+    }
+
+    uint32_t last_id = total - skip;
+    uint32_t first_id = last_id >= page_size ? last_id - page_size + 1 : 1;
+    return ReadRange(first_id, last_id, records);
+}
+
+bool SessionArchive::GetPageBefore(std::time_t before, size_t page_size,
+                                   std::vector<std::string>& records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    records.clear();
+    page_size = std::max<size_t>(1, std::min(page_size, MAX_PAGE_SIZE));
+
+    uint32_t limit = static_cast<uint32_t>(before);
+    if (!time_ordered_) {
+        return ScanBefore(limit, page_size, records);
+    }
+    uint32_t last_id = 0;
+
+    // 先查尾部
+    for (auto it = tail_.rbegin(); it != tail_.rend(); ++it) {
+        if (it->end_time < limit) {
+            last_id = it->id;
+            break;
+        }
+    }
+
+    // 再按时间二分定位块：最后一个 first_time < before 的块
+    if (last_id == 0 && !blocks_.empty()) {
+        auto it = std::lower_bound(blocks_.begin(), blocks_.end(), limit,
+            [](const BlockEntry& e, uint32_t t) { return e.first_time < t; });
+        if (it != blocks_.begin()) {
+            size_t index = (it - blocks_.begin()) - 1;
+            std::vector<std::string> lines;
+            if (ReadBlock(index, lines)) {
+                for (size_t i = lines.size(); i > 0; i--) {
+                    const char* p = strstr(lines[i - 1].c_str(), "\"end\":");
+                    if (p && strtoul(p + 6, nullptr, 10) < limit) {
+                        last_id = blocks_[index].first_id + (i - 1);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (last_id == 0) {
+        return true;
+    }
+
+    uint32_t first_id = last_id >= page_size ? last_id - page_size + 1 : 1;
+    return ReadRange(first_id, last_id, records);
+}
+
+bool SessionArchive::ScanBefore(uint32_t limit, size_t page_size,
+                                std::vector<std::string>& records) {
+    for (auto it = tail_.rbegin(); it != tail_.rend() && records.size() < page_size; ++it) {
+        if (it->end_time < limit) {
+            records.push_back(it->record);
+        }
+    }
+
+    std::vector<std::string> lines;
+    for (size_t i = blocks_.size(); i > 0 && records.size() < page_size; i--) {
+        if (blocks_[i - 1].first_time >= limit) {
+            continue;   // 块内没有早于 before 的记录，不必解压
+        }
+        lines.clear();
+        if (!ReadBlock(i - 1, lines)) {
+            return false;
+        }
+        for (size_t j = lines.size(); j > 0 && records.size() < page_size; j--) {
+            const char* p = strstr(lines[j - 1].c_str(), "\"end\":");
+            if (p && strtoul(p + 6, nullptr, 10) < limit) {
+                records.push_back(std::move(lines[j - 1]));
+            }
+        }
+    }
+    return true;
+}
+
+void SessionArchive::TrackEndTime(uint32_t end_time) {
+    if (end_time < last_end_time_) {
+        if (time_ordered_) {
+            ESP_LOGW(TAG, "Archive end times go backwards (%u < %u), paging by time scans",
+                     static_cast<unsigned>(end_time), static_cast<unsigned>(last_end_time_));
+        }
+        time_ordered_ = false;
+    }
+    last_end_time_ = std::max(last_end_time_, end_time);
+}
+
+bool SessionArchive::GetSession(uint32_t id, std::string& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (id == 0 || id >= next_id_) {
+        return false;
+    }
+
+    std::vector<std::string> records;
+    if (!ReadRange(id, id, records) || records.empty()) {
+        return false;
+    }
+    record = std::move(records[0]);
+    return true;
+}
+
+bool SessionArchive::ReadRange(uint32_t first_id, uint32_t last_id,
+                               std::vector<std::string>& records) {
+    uint32_t tail_first = tail_.empty() ? next_id_ : tail_.front().id;
+
+    int loaded_block = -1;
+    std::vector<std::string> lines;
+
+    for (uint32_t id = last_id; id >= first_id && id > 0; id--) {
+        if (id >= tail_first) {
+            records.push_back(tail_[id - tail_first].record);
+            continue;
+        }
+
+        int block = FindBlock(id);
+        if (block < 0) {
+            continue;
+        }
+        if (block != loaded_block) {
+            lines.clear();
+            if (!ReadBlock(block, lines)) {
+                ESP_LOGW(TAG, "Skipping unreadable block %d", block);
+            }
+            loaded_block = block;
+        }
+
+        size_t line = id - blocks_[block].first_id;
+        if (line < lines.size()) {
+            records.push_back(lines[line]);
+        }
+    }
+
+    return true;
+}
+
+bool SessionArchive::ReadBlock(size_t index, std::vector<std::string>& lines) {
+    const BlockEntry& entry = blocks_[index];
+
+    FILE* f = fopen(DataPath().c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    std::string compressed(entry.stored_size, '\0');
+    bool ok = fseek(f, entry.offset, SEEK_SET) == 0 &&
+              fread(&compressed[0], 1, entry.stored_size, f) == entry.stored_size;
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(compressed.data()),
+                                    compressed.size());
+    if (crc != entry.crc) {
+        ESP_LOGE(TAG, "Block %zu CRC mismatch", index);
+        return false;
+    }
+
+    std::string raw;
+    if (!LzBlock::Decompress(compressed.data(), compressed.size(), entry.raw_size, raw)) {
+        ESP_LOGE(TAG, "Block %zu decompression failed", index);
+        return false;
+    }
+
+    size_t start = 0;
+    while (start < raw.size()) {
+        size_t end = raw.find('\n', start);
+        if (end == std::string::npos) {
+            end = raw.size();
+        }
+        lines.push_back(raw.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines.size() == entry.count;
+}
+
+int SessionArchive::FindBlock(uint32_t id) const {
+    // 最后一个 first_id <= id 的块
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), id,
+        [](uint32_t v, const BlockEntry& e) { return v < e.first_id; });
+    if (it == blocks_.begin()) {
+        return -1;
+    }
+    --it;
+    if (id >= it->first_id + it->count) {
+        return -1;
+    }
+    return static_cast<int>(it - blocks_.begin());
+}
+
+uint32_t SessionArchive::ParseId(const std::string& record) {
+    // 记录总是以 {"id":N 开头
+    static const char PREFIX[] = "{\"id\":";
+    if (record.compare(0, sizeof(PREFIX) - 1, PREFIX) != 0) {
+        return 0;
+    }
+    return strtoul(record.c_str() + sizeof(PREFIX) - 1, nullptr, 10);
+}
+
+size_t SessionArchive::GetRawBytes() const {
+    size_t total = tail_bytes_;
+    for (const auto& entry : blocks_) {
+        total += entry.raw_size;
+    }
+    return total;
+}
+
+size_t SessionArchive::GetStoredBytes() const {
+    return data_end_ + tail_bytes_;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,122 @@
+#ifndef SESSION_ARCHIVE_H
+#define SESSION_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <mutex>
+
+namespace EvoSpark {
+
+// 会话归档 - 只追加、分块压缩、带稀疏索引
+//
+// 每个会话是一行 JSON 记录：{"id":N,"start":T,"end":T,"session":{...}}。
+// 新记录先追加到未压缩的尾部文件，累计超过 BLOCK_SIZE 后整体压缩成一个块
+// 追加到数据文件，并在索引文件中记一条 32 字节的索引项（偏移、大小、首个
+// 会话 ID、起止时间）。会话 ID 连续递增，因此第 N 页对应的 ID 范围可以直接
+// 算出，再用二分查找定位到 1~2 个块，只读取和解压这些块。
+//
+// 按时间翻页依赖结束时间随 ID 递增。设备没有 SNTP 时每次启动时钟从 1970
+// 附近重新开始，时间会倒退：一旦发现不单调（块内或块间），按时间翻页改为
+// 从新到旧线性扫描索引，跳过最早结束时间不满足条件的块。
+class SessionArchive {
+public:
+    // dir: 归档目录，例如 "/model/archive"
+    explicit SessionArchive(const std::string& dir);
+    ~SessionArchive() = default;
+
+    // 加载索引和尾部记录
+    bool Init();
+
+    // 追加一个会话（payload 为 JSON 对象），返回分配的会话 ID，失败返回 0
+    uint32_t Append(std::time_t start_time, std::time_t end_time,
+                    const std::string& payload);
+
+    // 分页读取（page 从 0 开始，最新的在前），records 为 JSON 记录
+    bool GetPage(size_t page, size_t page_size, std::vector<std::string>& records);
+
+    // 读取 end_time 早于 before 的最新 page_size 个会话（按时间翻页）。
+    // 时间单调时是连续的一段 ID；不单调时是满足条件的最新几个，ID 可能不连续
+    bool GetPageBefore(std::time_t before, size_t page_size,
+                       std::vector<std::string>& records);
+
+    // 按 ID 读取单个会话
+    bool GetSession(uint32_t id, std::string& record);
+
+    // 会话总数
+    size_t Count() const { return next_id_ - 1; }
+
+    // 已压缩块数量
+    size_t GetBlockCount() const { return blocks_.size(); }
+
+    // 原始字节数 / 实际存储字节数（含尾部）
+    size_t GetRawBytes() const;
+    size_t GetStoredBytes() const;
+
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;  // 单块原始大小目标
+    static constexpr size_t MAX_PAGE_SIZE = 50;
+
+private:
+    // 索引项（固定 32 字节）
+    struct BlockEntry {
+        uint32_t offset;       // 数据文件中的偏移
+        uint32_t stored_size;  // 压缩后大小
+        uint32_t raw_size;     // 原始大小
+        uint32_t first_id;     // 块内第一个会话 ID
+        uint32_t first_time;   // 块内最早结束时间
+        uint32_t last_time;    // 块内最晚结束时间
+        uint16_t count;        // 块内会话数
+        uint16_t flags;        // BLOCK_TIME_ORDERED 等（旧版本写 0）
+        uint32_t crc;          // 压缩数据 CRC32
+    };
+    static_assert(sizeof(BlockEntry) == 32, "BlockEntry must be 32 bytes");
+    static constexpr uint16_t BLOCK_TIME_ORDERED = 1;   // 块内结束时间不递减
+
+    // 尾部（未压缩）记录的位置信息
+    struct TailEntry {
+        uint32_t id;
+        uint32_t end_time;
+        std::string record;
+    };
+
+    bool LoadIndex();
+    bool LoadTail();
+    bool SealTail();
+
+    // 读取 [first_id, last_id] 范围内的记录，按 ID 从新到旧输出
+    bool ReadRange(uint32_t first_id, uint32_t last_id, std::vector<std::string>& records);
+
+    // 读取并解压第 i 个块，按行拆分
+    bool ReadBlock(size_t index, std::vector<std::string>& lines);
+
+    // 时间不单调时的按时间翻页：从新到旧逐块扫描
+    bool ScanBefore(uint32_t limit, size_t page_size, std::vector<std::string>& records);
+
+    // 记录结束时间，发现倒退时关掉按时间的二分
+    void TrackEndTime(uint32_t end_time);
+
+    // 返回包含 id 的块序号，不在块中返回 -1
+    int FindBlock(uint32_t id) const;
+
+    static uint32_t ParseId(const std::string& record);
+
+    std::string DataPath() const { return dir_ + "/data.bin"; }
+    std::string IndexPath() const { return dir_ + "/index.bin"; }
+    std::string TailPath() const { return dir_ + "/tail.bin"; }
+
+    std::string dir_;
+    std::vector<BlockEntry> blocks_;
+    std::vector<TailEntry> tail_;
+    size_t tail_bytes_ = 0;
+    uint32_t data_end_ = 0;
+    uint32_t next_id_ = 1;
+    uint32_t last_end_time_ = 0;
+    bool time_ordered_ = true;     // 所有记录的结束时间随 ID 不递减
+    bool initialized_ = false;
+    std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // SESSION_ARCHIVE_H
@@ -0,0 +1,486 @@
+#include "version_store.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace EvoSpark {
+
+static const char* TAG = "VersionStore";
+
+constexpr uint32_t INDEX_MAGIC = 0x3149564D;  // "MVI1"
+
+// 增量编码参数
+constexpr size_t DELTA_BLOCK = 8;        // 最小匹配长度
+constexpr int DELTA_HASH_BITS = 12;      // 4096 个哈希桶
+constexpr uint8_t OP_ADD = 0x00;         // ADD len bytes
+constexpr uint8_t OP_COPY = 0x01;        // COPY offset len
+
+// ==================== 增量编解码 ====================
+
+static void PutVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+static bool GetVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint32_t BlockHash(const uint8_t* p) {
+    uint32_t a, b;
+    memcpy(&a, p, 4);
+    memcpy(&b, p + 4, 4);
+    return ((a * 2654435761u) ^ (b * 2246822519u)) >> (32 - DELTA_HASH_BITS);
+}
+
+static void EmitAdd(std::string& out, const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    out += static_cast<char>(OP_ADD);
+    PutVarint(out, len);
+    out.append(reinterpret_cast<const char*>(data), len);
+}
+
+// 生成 target 相对于 base 的增量（贪心块匹配，O(n)）
+static std::string EncodeDelta(const std::string& base, const std::string& target) {
+    std::string out;
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(base.data());
+    const uint8_t* t = reinterpret_cast<const uint8_t*>(target.data());
+    const size_t bn = base.size();
+    const size_t tn = target.size();
+
+    std::vector<int32_t> table(1u << DELTA_HASH_BITS, -1);
+    for (size_t i = 0; i + DELTA_BLOCK <= bn; i++) {
+        table[BlockHash(b + i)] = static_cast<int32_t>(i);
+    }
+
+    size_t lit_start = 0;
+    size_t i = 0;
+    while (i + DELTA_BLOCK <= tn) {
+        int32_t cand = table[BlockHash(t + i)];
+        if (cand < 0 || memcmp(b + cand, t + i, DELTA_BLOCK) != 0) {
+            i++;
+            continue;
+        }
+
+        size_t src = static_cast<size_t>(cand);
+        size_t len = DELTA_BLOCK;
+        while (i + len < tn && src + len < bn && b[src + len] == t[i + len]) {
+            len++;
+        }
+
+        // 向前扩展，吞并待输出字面量的尾部
+        while (i > lit_start && src > 0 && b[src - 1] == t[i - 1]) {
+            i--;
+            src--;
+            len++;
+        }
+
+        EmitAdd(out, t + lit_start, i - lit_start);
+        out += static_cast<char>(OP_COPY);
+        PutVarint(out, src);
+        PutVarint(out, len);
+
+        i += len;
+        lit_start = i;
+    }
+
+    EmitAdd(out, t + lit_start, tn - lit_start);
+    return out;
+}
+
+static bool ApplyDelta(const std::string& base, const std::string& delta,
+                       size_t expected_size, std::string& out) {
+    out.clear();
+    out.reserve(expected_size);
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(delta.data());
+    const uint8_t* end = p + delta.size();
+
+    while (p < end) {
+        uint8_t op = *p++;
+        if (op == OP_ADD) {
+            uint32_t len;
+            if (!GetVarint(p, end, len) || len > static_cast<size_t>(end - p)) {
+                return false;
+            }
+            out.append(reinterpret_cast<const char*>(p), len);
+            p += len;
+        } else if (op == OP_COPY) {
+            uint32_t offset, len;
+            if (!GetVarint(p, end, offset) || !GetVarint(p, end, len) ||
+                offset > base.size() || len > base.size() - offset) {
+                return false;
+            }
+            out.append(base, offset, len);
+        } else {
+            return false;
+        }
+
+        if (out.size() > expected_size) {
+            return false;
+        }
+    }
+
+    return out.size() == expected_size;
+}
+
+// ==================== VersionStore ====================
+
+VersionStore::VersionStore(const std::string& prefix) : prefix_(prefix) {
+}
+
+bool VersionStore::Init() {
+    if (loaded_) {
+        return true;
+    }
+
+    if (!LoadIndex()) {
+        ESP_LOGW(TAG, "No version index, starting empty history");
+        entries_.clear();
+        next_seq_ = 1;
+    }
+
+    loaded_ = true;
+    ESP_LOGI(TAG, "Version store ready: %zu versions, %zu bytes",
+             entries_.size(), GetStoredBytes());
+    return true;
+}
+
+bool VersionStore::Commit(const std::string& content, VersionInfo* info) {
+    if (!loaded_) {
+        ESP_LOGE(TAG, "Version store not initialized");
+        return false;
+    }
+
+    IndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    ComputeHash(content, entry.hash);
+
+    // 内容未变化，不产生新版本
+    if (!entries_.empty() && memcmp(entries_.back().hash, entry.hash, sizeof(entry.hash)) == 0) {
+        ESP_LOGI(TAG, "Content unchanged (%s), skip commit",
+                 HashToHex(entry.hash).c_str());
+        if (info) {
+            *info = List().front();
+        }
+        return true;
+    }
+
+    entry.seq = next_seq_;
+    entry.timestamp = static_cast<uint32_t>(std::time(nullptr));
+    entry.raw_size = content.size();
+
+    // 优先编码为相对于当前基准的增量
+    std::string record;
+    bool as_base = true;
+    if (!entries_.empty()) {
+        const IndexEntry* base = Find(entries_.back().base_seq);
+        std::string base_content;
+        if (base && entry.seq - base->seq < BASE_INTERVAL &&
+            ReadAll(RecordPath(base->seq), base_content) &&
+            base_content.size() == base->raw_size) {
+            record = EncodeDelta(base_content, content);
+            if (record.size() < content.size() / 2) {
+                as_base = false;
+                entry.kind = KIND_DELTA;
+                entry.base_seq = base->seq;
+            }
+        }
+    }
+
+    if (as_base) {
+        record = content;
+        entry.kind = KIND_BASE;
+        entry.base_seq = entry.seq;
+    }
+    entry.stored_size = record.size();
+
+    if (!WriteAll(RecordPath(entry.seq), record)) {
+        ESP_LOGE(TAG, "Failed to write version record %u", (unsigned)entry.seq);
+        return false;
+    }
+
+    entries_.push_back(entry);
+    next_seq_++;
+    std::vector<uint32_t> pruned = Prune();
+
+    if (!SaveIndex()) {
+        ESP_LOGE(TAG, "Failed to save version index");
+        return false;
+    }
+
+    // 索引已不再引用这些记录才删除：中途掉电只会留下孤儿文件，不会让索引
+    // 指向不存在的记录
+    for (uint32_t seq : pruned) {
+        remove(RecordPath(seq).c_str());
+    }
+
+    ESP_LOGI(TAG, "Committed v%u (%s): %u bytes -> %u bytes %s",
+             (unsigned)entry.seq, HashToHex(entry.hash).c_str(),
+             (unsigned)entry.raw_size, (unsigned)entry.stored_size,
+             as_base ? "base" : "delta");
+
+    if (info) {
+        *info = List().front();
+    }
+    return true;
+}
+
+bool VersionStore::Checkout(uint32_t seq, std::string& content) {
+    const IndexEntry* entry = Find(seq);
+    if (!entry) {
+        ESP_LOGE(TAG, "Version %u not found", (unsigned)seq);
+        return false;
+    }
+    return Reconstruct(*entry, content);
+}
+
+bool VersionStore::CheckoutByHash(const std::string& hash, std::string& content) {
+    if (hash.size() < 4) {
+        ESP_LOGE(TAG, "Hash prefix too short: %s", hash.c_str());
+        return false;
+    }
+
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        if (HashToHex(it->hash).compare(0, hash.size(), hash) == 0) {
+            return Reconstruct(*it, content);
+        }
+    }
+
+    ESP_LOGE(TAG, "Version with hash %s not found", hash.c_str());
+    return false;
+}
+
+bool VersionStore::CheckoutNth(size_t n, std::string& content) {
+    if (n >= entries_.size()) {
+        ESP_LOGE(TAG, "Invalid version index: %zu (have %zu)", n, entries_.size());
+        return false;
+    }
+    return Reconstruct(entries_[entries_.size() - 1 - n], content);
+}
+
+std::vector<VersionInfo> VersionStore::List() const {
+    std::vector<VersionInfo> list;
+    list.reserve(entries_.size());
+
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        VersionInfo info;
+        info.seq = it->seq;
+        info.hash = HashToHex(it->hash);
+        info.timestamp = it->timestamp;
+        info.size = it->raw_size;
+        info.stored_size = it->stored_size;
+        info.is_base = (it->kind == KIND_BASE);
+        list.push_back(info);
+    }
+
+    return list;
+}
+
+size_t VersionStore::GetStoredBytes() const {
+    size_t total = 0;
+    for (const auto& entry : entries_) {
+        total += entry.stored_size;
+    }
+    return total + sizeof(uint32_t) * 2 + entries_.size() * sizeof(IndexEntry);
+}
+
+bool VersionStore::Clear() {
+    for (const auto& entry : entries_) {
+        remove(RecordPath(entry.seq).c_str());
+    }
+    entries_.clear();
+    remove(IndexPath().c_str());
+
+    ESP_LOGI(TAG, "Version history cleared");
+    return true;
+}
+
+bool VersionStore::LoadIndex() {
+    std::string data;
+    if (!ReadAll(IndexPath(), data)) {
+        // 上次写索引时掉电：临时文件仍然完整
+        if (!ReadAll(IndexPath() + ".tmp", data)) {
+            return false;
+        }
+    }
+
+    if (data.size() < 8 || (data.size() - 8) % sizeof(IndexEntry) != 0) {
+        ESP_LOGE(TAG, "Corrupted version index (%zu bytes)", data.size());
+        return false;
+    }
+
+    uint32_t magic;
+    memcpy(&magic, data.data(), 4);
+    if (magic != INDEX_MAGIC) {
+        ESP_LOGE(TAG, "Bad version index magic");
+        return false;
+    }
+    memcpy(&next_seq_, data.data() + 4, 4);
+
+    size_t count = (data.size() - 8) / sizeof(IndexEntry);
+    entries_.resize(count);
+    if (count > 0) {
+        memcpy(entries_.data(), data.data() + 8, count * sizeof(IndexEntry));
+    }
+    return true;
+}
+
+bool VersionStore::SaveIndex() {
+    std::string data(8 + entries_.size() * sizeof(IndexEntry), '\0');
+    memcpy(&data[0], &INDEX_MAGIC, 4);
+    memcpy(&data[4], &next_seq_, 4);
+    if (!entries_.empty()) {
+        memcpy(&data[8], entries_.data(), entries_.size() * sizeof(IndexEntry));
+    }
+
+    // 先写临时文件再替换，避免掉电损坏索引
+    std::string tmp = IndexPath() + ".tmp";
+    if (!WriteAll(tmp, data)) {
+        return false;
+    }
+    remove(IndexPath().c_str());
+    return rename(tmp.c_str(), IndexPath().c_str()) == 0;
+}
+
+std::vector<uint32_t> VersionStore::Prune() {
+    // 以“基准 + 其增量”为单位删除最旧的一组，当前组永远保留
+    std::vector<uint32_t> pruned;
+    while (entries_.size() > MAX_VERSIONS) {
+        uint32_t oldest_base = entries_.front().base_seq;
+        if (oldest_base == entries_.back().base_seq) {
+            break;
+        }
+
+        size_t n = 0;
+        while (n < entries_.size() && entries_[n].base_seq == oldest_base) {
+            pruned.push_back(entries_[n].seq);
+            n++;
+        }
+        entries_.erase(entries_.begin(), entries_.begin() + n);
+
+        ESP_LOGI(TAG, "Pruned %zu old versions (base v%u)", n, (unsigned)oldest_base);
+    }
+    return pruned;
+}
+
+const VersionStore::IndexEntry* VersionStore::Find(uint32_t seq) const {
+    // 序号单调递增，二分查找
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), seq,
+        [](const IndexEntry& e, uint32_t s) { return e.seq < s; });
+    if (it == entries_.end() || it->seq != seq) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+bool VersionStore::Reconstruct(const IndexEntry& entry, std::string& content) {
+    std::string record;
+    if (!ReadAll(RecordPath(entry.seq), record)) {
+        ESP_LOGE(TAG, "Missing record for v%u", (unsigned)entry.seq);
+        return false;
+    }
+
+    if (entry.kind == KIND_BASE) {
+        content.swap(record);
+    } else {
+        const IndexEntry* base = Find(entry.base_seq);
+        std::string base_content;
+        if (!base || !ReadAll(RecordPath(base->seq), base_content)) {
+            ESP_LOGE(TAG, "Missing base v%u for v%u",
+                     (unsigned)entry.base_seq, (unsigned)entry.seq);
+            return false;
+        }
+        if (!ApplyDelta(base_content, record, entry.raw_size, content)) {
+            ESP_LOGE(TAG, "Corrupted delta for v%u", (unsigned)entry.seq);
+            return false;
+        }
+    }
+
+    // 内容寻址：重建结果必须与索引中的哈希一致
+    uint8_t hash[8];
+    ComputeHash(content, hash);
+    if (content.size() != entry.raw_size || memcmp(hash, entry.hash, sizeof(hash)) != 0) {
+        ESP_LOGE(TAG, "Hash mismatch for v%u", (unsigned)entry.seq);
+        content.clear();
+        return false;
+    }
+
+    return true;
+}
+
+std::string VersionStore::RecordPath(uint32_t seq) const {
+    return prefix_ + "_" + std::to_string(seq) + ".bin";
+}
+
+std::string VersionStore::IndexPath() const {
+    return prefix_ + "_index.bin";
+}
+
+void VersionStore::ComputeHash(const std::string& content, uint8_t out[8]) {
+    unsigned char digest[32];
+    mbedtls_sha256(reinterpret_cast<const unsigned char*>(content.data()),
+                   content.size(), digest, 0);
+    memcpy(out, digest, 8);
+}
+
+std::string VersionStore::HashToHex(const uint8_t hash[8]) {
+    static const char* hex = "0123456789abcdef";
+    std::string out(16, '0');
+    for (int i = 0; i < 8; i++) {
+        out[i * 2] = hex[hash[i] >> 4];
+        out[i * 2 + 1] = hex[hash[i] & 0x0F];
+    }
+    return out;
+}
+
+bool VersionStore::ReadAll(const std::string& path, std::string& content) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (size < 0) {
+        fclose(f);
+        return false;
+    }
+
+    content.resize(size);
+    size_t read = size > 0 ? fread(&content[0], 1, size, f) : 0;
+    fclose(f);
+
+    return read == static_cast<size_t>(size);
+}
+
+bool VersionStore::WriteAll(const std::string& path, const std::string& content) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == NULL) {
+        return false;
+    }
+
+    size_t written = fwrite(content.data(), 1, content.size(), f);
+    fclose(f);
+
+    return written == content.size();
+}
+
+} // namespace EvoSpark
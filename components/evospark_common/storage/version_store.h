@@ -0,0 +1,104 @@
+#ifndef VERSION_STORE_H
+#define VERSION_STORE_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+
+namespace EvoSpark {
+
+// 单个版本的描述信息（来自索引，无需读取内容）
+struct VersionInfo {
+    uint32_t seq = 0;          // 单调递增序号
+    std::string hash;          // 内容哈希（SHA-256 前 8 字节，16 位十六进制）
+    std::time_t timestamp = 0; // 提交时间
+    uint32_t size = 0;         // 原始内容大小
+    uint32_t stored_size = 0;  // 实际占用的存储大小
+    bool is_base = false;      // 是否为完整基准版本
+};
+
+// 版本存储 - 内容寻址、增量编码的记忆历史
+//
+// 每 BASE_INTERVAL 个版本保存一份完整基准，其余版本只保存相对于所属
+// 基准的增量（COPY/ADD 指令）。任意版本最多读取 基准 + 1 个增量 即可重建，
+// 重建时间与历史长度无关。索引常驻内存，列出历史不需要访问 Flash。
+class VersionStore {
+public:
+    // prefix: 文件前缀，例如 "/spiffs/mv"
+    explicit VersionStore(const std::string& prefix);
+    ~VersionStore() = default;
+
+    // 加载索引
+    bool Init();
+
+    // 提交新版本（与最新版本内容相同时跳过）
+    bool Commit(const std::string& content, VersionInfo* info = nullptr);
+
+    // 重建指定序号的版本
+    bool Checkout(uint32_t seq, std::string& content);
+
+    // 按哈希重建（支持前缀匹配）
+    bool CheckoutByHash(const std::string& hash, std::string& content);
+
+    // 按新旧顺序重建（0 = 最新）
+    bool CheckoutNth(size_t n, std::string& content);
+
+    // 列出全部版本（最新在前）
+    std::vector<VersionInfo> List() const;
+
+    // 版本数量
+    size_t Count() const { return entries_.size(); }
+
+    // 所有版本占用的存储大小
+    size_t GetStoredBytes() const;
+
+    // 删除全部版本
+    bool Clear();
+
+    static constexpr uint32_t BASE_INTERVAL = 8;   // 每 8 个版本一个基准
+    static constexpr size_t MAX_VERSIONS = 48;     // 最多保留的版本数
+
+private:
+    // 索引项（固定 32 字节，直接写入索引文件）
+    struct IndexEntry {
+        uint32_t seq;
+        uint32_t base_seq;     // 基准版本序号（基准版本指向自身）
+        uint32_t timestamp;
+        uint32_t raw_size;
+        uint32_t stored_size;
+        uint8_t hash[8];
+        uint8_t kind;          // 0 = 基准, 1 = 增量
+        uint8_t reserved[3];
+    };
+    static_assert(sizeof(IndexEntry) == 32, "IndexEntry must be 32 bytes");
+
+    enum : uint8_t { KIND_BASE = 0, KIND_DELTA = 1 };
+
+    bool LoadIndex();
+    bool SaveIndex();
+    // 从索引中去掉超出 MAX_VERSIONS 的最旧组，返回它们的序号；记录文件由调用方
+    // 在 SaveIndex 成功后删除
+    std::vector<uint32_t> Prune();
+
+    const IndexEntry* Find(uint32_t seq) const;
+    bool Reconstruct(const IndexEntry& entry, std::string& content);
+
+    std::string RecordPath(uint32_t seq) const;
+    std::string IndexPath() const;
+
+    static void ComputeHash(const std::string& content, uint8_t out[8]);
+    static std::string HashToHex(const uint8_t hash[8]);
+
+    static bool ReadAll(const std::string& path, std::string& content);
+    static bool WriteAll(const std::string& path, const std::string& content);
+
+    std::string prefix_;
+    std::vector<IndexEntry> entries_;  // 旧 -> 新
+    uint32_t next_seq_ = 1;
+    bool loaded_ = false;
+};
+
+} // namespace EvoSpark
+
+#endif // VERSION_STORE_H
@@ -0,0 +1,682 @@
+#include "json_codec.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+namespace EvoSpark {
+
+// ==================== JsonChunkSink ====================
+
+void JsonChunkSink::Append(const char* data, size_t length) {
+    while (length > 0 && !failed_) {
+        if (size_ == capacity_ && !FlushBuffer()) {
+            return;
+        }
+        size_t n = capacity_ - size_;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(buffer_ + size_, data, n);
+        size_ += n;
+        total_ += n;
+        data += n;
+        length -= n;
+    }
+}
+
+bool JsonChunkSink::FlushBuffer() {
+    if (size_ > 0 && !failed_) {
+        failed_ = !flush_(buffer_, size_);
+    }
+    size_ = 0;
+    return !failed_;
+}
+
+bool JsonChunkSink::Finish() {
+    return FlushBuffer();
+}
+
+// ==================== 字符串转义 ====================
+
+namespace {
+
+using Word = uintptr_t;
+
+constexpr Word ONES = ~static_cast<Word>(0) / 0xFF;   // 0x0101...
+constexpr Word HIGHS = ONES * 0x80;                    // 0x8080...
+
+// 任一字节为 0 时非零（只用于判断"有没有"，不定位）
+inline Word HasZeroByte(Word w) {
+    return (w - ONES) & ~w & HIGHS;
+}
+
+// 是否含有需要逐字节处理的字节：< 0x20、'"'、'\\' 或 >= 0x80
+inline bool NeedsAttention(Word w) {
+    Word high = w & HIGHS;
+    // 高位为 0 的字节减 0x20 借位即小于 0x20；高位字节已在 high 中
+    Word control = (w - ONES * 0x20) & ~w & HIGHS;
+    Word quote = HasZeroByte(w ^ (ONES * '"'));
+    Word backslash = HasZeroByte(w ^ (ONES * '\\'));
+    return (high | control | quote | backslash) != 0;
+}
+
+inline bool IsPlainAscii(unsigned char c) {
+    return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+inline bool IsContinuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+} // namespace
+
+size_t Utf8SequenceLength(const char* data, size_t length) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    unsigned char c = p[0];
+    if (c < 0x80) {
+        return 1;
+    }
+
+    size_t n;
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        n = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3;
+        if (c == 0xE0) lo = 0xA0;        // 过长编码
+        if (c == 0xED) hi = 0x9F;        // UTF-16 代理区
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4;
+        if (c == 0xF0) lo = 0x90;        // 过长编码
+        if (c == 0xF4) hi = 0x8F;        // 超过 U+10FFFF
+    } else {
+        return 0;
+    }
+
+    if (length < n || p[1] < lo || p[1] > hi) {
+        return 0;
+    }
+    for (size_t i = 2; i < n; i++) {
+        if (!IsContinuation(p[i])) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+size_t JsonSafePrefix(const char* data, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        // 快速路径：整字无特殊字节时一次跳过
+        while (i + sizeof(Word) <= length) {
+            Word w;
+            memcpy(&w, data + i, sizeof(w));
+            if (NeedsAttention(w)) {
+                break;
+            }
+            i += sizeof(Word);
+        }
+        if (i >= length) {
+            break;
+        }
+
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (IsPlainAscii(c)) {
+            i++;
+        } else if (c >= 0x80) {
+            size_t n = Utf8SequenceLength(data + i, length - i);
+            if (n == 0) {
+                break;
+            }
+            i += n;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+size_t JsonEscapeChar(unsigned char c, char* out) {
+    static const char HEX[] = "0123456789abcdef";
+    out[0] = '\\';
+    switch (c) {
+        case '"':  out[1] = '"';  return 2;
+        case '\\': out[1] = '\\'; return 2;
+        case '\n': out[1] = 'n';  return 2;
+        case '\r': out[1] = 'r';  return 2;
+        case '\t': out[1] = 't';  return 2;
+        case '\b': out[1] = 'b';  return 2;
+        case '\f': out[1] = 'f';  return 2;
+        default:
+            break;
+    }
+    out[1] = 'u';
+    out[2] = '0';
+    out[3] = '0';
+    out[4] = HEX[c >> 4];
+    out[5] = HEX[c & 0xF];
+    return 6;
+}
+
+// ==================== 数字格式化 ====================
+
+size_t JsonFormatUint(uint64_t value, char* out) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+size_t JsonFormatInt(int64_t value, char* out) {
+    if (value >= 0) {
+        return JsonFormatUint(static_cast<uint64_t>(value), out);
+    }
+    out[0] = '-';
+    return 1 + JsonFormatUint(0 - static_cast<uint64_t>(value), out + 1);
+}
+
+size_t JsonFormatDouble(double value, char* out) {
+    if (!std::isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    // 整数值走整数路径，免去 snprintf
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        return JsonFormatInt(static_cast<int64_t>(value), out);
+    }
+    int n = snprintf(out, 32, "%.15g", value);
+    if (strtod(out, nullptr) != value) {
+        n = snprintf(out, 32, "%.17g", value);
+    }
+    return static_cast<size_t>(n);
+}
+
+size_t JsonFormatFloat(float value, char* out) {
+    if (!std::isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    // 单精度最多 9 位有效数字即可精确还原
+    int n = 0;
+    for (int digits = 6; digits <= 9; digits++) {
+        n = snprintf(out, 32, "%.*g", digits, static_cast<double>(value));
+        if (strtof(out, nullptr) == value) {
+            break;
+        }
+    }
+    return static_cast<size_t>(n);
+}
+
+// ==================== JsonReader ====================
+
+namespace {
+
+inline int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// 解析栈：每层一位，1 = 对象，0 = 数组
+enum class Expect : uint8_t {
+    VALUE,            // 任意值
+    FIRST_KEY,        // '{' 之后：键或 '}'
+    KEY,              // ',' 之后：键
+    COLON,
+    FIRST_ELEMENT,    // '[' 之后：值或 ']'
+    COMMA_OR_END,
+};
+
+} // namespace
+
+void JsonReader::SkipWhitespace() {
+    while (pos_ < length_) {
+        char c = json_[pos_];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return;
+        }
+        pos_++;
+    }
+}
+
+bool JsonReader::ParseLiteral(const char* literal, size_t length) {
+    if (length_ - pos_ < length || memcmp(json_ + pos_, literal, length) != 0) {
+        return false;
+    }
+    pos_ += length;
+    return true;
+}
+
+bool JsonReader::ParseString(const char*& value, size_t& length) {
+    // 调用时 json_[pos_] == '"'
+    size_t start = ++pos_;
+
+    // 快速路径：按字扫描到第一个特殊字节，没有转义时直接返回输入中的片段
+    pos_ += JsonSafePrefix(json_ + pos_, length_ - pos_);
+    if (pos_ >= length_) {
+        return false;
+    }
+    if (json_[pos_] == '"') {
+        value = json_ + start;
+        length = pos_ - start;
+        pos_++;
+        return true;
+    }
+    if (json_[pos_] != '\\') {
+        return false;  // 控制字符或非法 UTF-8
+    }
+
+    // 有转义：反转义到复用缓冲区
+    scratch_.assign(json_ + start, pos_ - start);
+    while (pos_ < length_) {
+        size_t safe = JsonSafePrefix(json_ + pos_, length_ - pos_);
+        scratch_.append(json_ + pos_, safe);
+        pos_ += safe;
+        if (pos_ >= length_) {
+            break;
+        }
+        char c = json_[pos_];
+        if (c == '"') {
+            pos_++;
+            value = scratch_.data();
+            length = scratch_.size();
+            return true;
+        }
+        if (c != '\\') {
+            return false;
+        }
+
+        if (++pos_ >= length_) {
+            return false;
+        }
+        char e = json_[pos_++];
+        switch (e) {
+            case '"':  scratch_ += '"';  break;
+            case '\\': scratch_ += '\\'; break;
+            case '/':  scratch_ += '/';  break;
+            case 'b':  scratch_ += '\b'; break;
+            case 'f':  scratch_ += '\f'; break;
+            case 'n':  scratch_ += '\n'; break;
+            case 'r':  scratch_ += '\r'; break;
+            case 't':  scratch_ += '\t'; break;
+            case 'u': {
+                auto read_hex4 = [this](uint32_t& out) {
+                    if (length_ - pos_ < 4) {
+                        return false;
+                    }
+                    out = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int h = HexValue(json_[pos_ + i]);
+                        if (h < 0) {
+                            return false;
+                        }
+                        out = (out << 4) | static_cast<uint32_t>(h);
+                    }
+                    pos_ += 4;
+                    return true;
+                };
+                uint32_t cp;
+                if (!read_hex4(cp)) {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // 高代理必须紧跟 \uDC00-\uDFFF
+                    uint32_t low;
+                    if (length_ - pos_ < 2 || json_[pos_] != '\\' || json_[pos_ + 1] != 'u') {
+                        return false;
+                    }
+                    pos_ += 2;
+                    if (!read_hex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return false;
+                }
+                AppendUtf8(scratch_, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool JsonReader::ParseNumber(JsonHandler& handler, JsonParseError& error) {
+    size_t start = pos_;
+    auto digits = [this]() {
+        size_t begin = pos_;
+        while (pos_ < length_ && json_[pos_] >= '0' && json_[pos_] <= '9') {
+            pos_++;
+        }
+        return pos_ - begin;
+    };
+
+    if (json_[pos_] == '-') {
+        pos_++;
+    }
+    if (pos_ < length_ && json_[pos_] == '0') {
+        pos_++;                                   // 不允许前导零
+    } else if (digits() == 0) {
+        error = JsonParseError::SYNTAX;
+        return false;
+    }
+    if (pos_ < length_ && json_[pos_] == '.') {
+        pos_++;
+        if (digits() == 0) {
+            error = JsonParseError::SYNTAX;
+            return false;
+        }
+    }
+    if (pos_ < length_ && (json_[pos_] == 'e' || json_[pos_] == 'E')) {
+        pos_++;
+        if (pos_ < length_ && (json_[pos_] == '+' || json_[pos_] == '-')) {
+            pos_++;
+        }
+        if (digits() == 0) {
+            error = JsonParseError::SYNTAX;
+            return false;
+        }
+    }
+
+    // strtod 需要结尾，拷到栈上（数字不会很长）
+    char buf[64];
+    size_t n = pos_ - start;
+    if (n >= sizeof(buf)) {
+        error = JsonParseError::SYNTAX;
+        return false;
+    }
+    memcpy(buf, json_ + start, n);
+    buf[n] = '\0';
+    if (!handler.OnNumber(strtod(buf, nullptr), json_ + start, n)) {
+        error = JsonParseError::ABORTED;
+        return false;
+    }
+    return true;
+}
+
+JsonParseError JsonReader::Parse(const char* json, size_t length, JsonHandler& handler) {
+    json_ = json;
+    length_ = length;
+    pos_ = 0;
+
+    uint32_t stack = 0;          // 每层一位：1 = 对象
+    int depth = 0;
+    Expect expect = Expect::VALUE;
+    JsonParseError error = JsonParseError::NONE;
+
+    auto in_object = [&]() { return depth > 0 && (stack & (1u << (depth - 1))); };
+
+    for (;;) {
+        SkipWhitespace();
+        if (pos_ >= length_) {
+            return JsonParseError::SYNTAX;
+        }
+        char c = json_[pos_];
+
+        switch (expect) {
+            case Expect::FIRST_KEY:
+            case Expect::KEY: {
+                if (c == '}' && expect == Expect::FIRST_KEY) {
+                    break;  // 空对象，交给下面的结束处理
+                }
+                const char* key;
+                size_t key_length;
+                if (c != '"') {
+                    return JsonParseError::SYNTAX;
+                }
+                if (!ParseString(key, key_length)) {
+                    return JsonParseError::BAD_STRING;
+                }
+                if (!handler.OnKey(key, key_length)) {
+                    return JsonParseError::ABORTED;
+                }
+                expect = Expect::COLON;
+                continue;
+            }
+
+            case Expect::COLON:
+                if (c != ':') {
+                    return JsonParseError::SYNTAX;
+                }
+                pos_++;
+                expect = Expect::VALUE;
+                continue;
+
+            case Expect::COMMA_OR_END:
+                if (c == ',') {
+                    pos_++;
+                    expect = in_object() ? Expect::KEY : Expect::VALUE;
+                    continue;
+                }
+                break;
+
+            case Expect::FIRST_ELEMENT:
+                if (c == ']') {
+                    break;
+                }
+                expect = Expect::VALUE;
+                [[fallthrough]];
+
+            case Expect::VALUE: {
+                bool scalar = true;
+                bool ok = true;
+                switch (c) {
+                    case '{':
+                    case '[': {
+                        if (depth >= MAX_DEPTH) {
+                            return JsonParseError::DEPTH;
+                        }
+                        bool object = (c == '{');
+                        pos_++;
+                        if (object) {
+                            stack |= 1u << depth;
+                        } else {
+                            stack &= ~(1u << depth);
+                        }
+                        depth++;
+                        ok = object ? handler.OnBeginObject() : handler.OnBeginArray();
+                        expect = object ? Expect::FIRST_KEY : Expect::FIRST_ELEMENT;
+                        scalar = false;
+                        break;
+                    }
+                    case '"': {
+                        const char* value;
+                        size_t value_length;
+                        if (!ParseString(value, value_length)) {
+                            return JsonParseError::BAD_STRING;
+                        }
+                        ok = handler.OnString(value, value_length);
+                        break;
+                    }
+                    case 't':
+                        if (!ParseLiteral("true", 4)) return JsonParseError::SYNTAX;
+                        ok = handler.OnBool(true);
+                        break;
+                    case 'f':
+                        if (!ParseLiteral("false", 5)) return JsonParseError::SYNTAX;
+                        ok = handler.OnBool(false);
+                        break;
+                    case 'n':
+                        if (!ParseLiteral("null", 4)) return JsonParseError::SYNTAX;
+                        ok = handler.OnNull();
+                        break;
+                    default:
+                        if (c != '-' && (c < '0' || c > '9')) {
+                            return JsonParseError::SYNTAX;
+                        }
+                        if (!ParseNumber(handler, error)) {
+                            return error;
+                        }
+                        break;
+                }
+                if (!ok) {
+                    return JsonParseError::ABORTED;
+                }
+                if (!scalar) {
+                    continue;
+                }
+                if (depth == 0) {
+                    SkipWhitespace();
+                    return pos_ == length_ ? JsonParseError::NONE : JsonParseError::TRAILING;
+                }
+                expect = Expect::COMMA_OR_END;
+                continue;
+            }
+        }
+
+        // 到这里说明遇到了容器结束符
+        bool object = in_object();
+        if (c != (object ? '}' : ']')) {
+            return JsonParseError::SYNTAX;
+        }
+        pos_++;
+        depth--;
+        if (!(object ? handler.OnEndObject() : handler.OnEndArray())) {
+            return JsonParseError::ABORTED;
+        }
+        if (depth == 0) {
+            SkipWhitespace();
+            return pos_ == length_ ? JsonParseError::NONE : JsonParseError::TRAILING;
+        }
+        expect = Expect::COMMA_OR_END;
+    }
+}
+
+// ==================== JsonFieldReader ====================
+
+bool JsonFieldReader::Parse(const char* json, size_t length) {
+    count_ = 0;
+    depth_ = 0;
+    JsonReader reader;
+    return reader.Parse(json, length, *this) == JsonParseError::NONE;
+}
+
+const JsonFieldReader::Field* JsonFieldReader::Find(const char* key) const {
+    for (size_t i = 0; i < count_; i++) {
+        if (fields_[i].key == key) {
+            return &fields_[i];
+        }
+    }
+    return nullptr;
+}
+
+JsonFieldReader::Field* JsonFieldReader::Add(Type type) {
+    // 只记录第一层对象的字段；超出上限的字段忽略
+    if (depth_ != 1 || count_ >= MAX_FIELDS) {
+        return nullptr;
+    }
+    Field& field = fields_[count_++];
+    field.key.swap(key_);
+    field.type = type;
+    return &field;
+}
+
+bool JsonFieldReader::GetString(const char* key, std::string& out) const {
+    const Field* field = Find(key);
+    if (!field || field->type != Type::STRING) {
+        return false;
+    }
+    out = field->text;
+    return true;
+}
+
+bool JsonFieldReader::GetNumber(const char* key, double& out) const {
+    const Field* field = Find(key);
+    if (!field || field->type != Type::NUMBER) {
+        return false;
+    }
+    out = field->number;
+    return true;
+}
+
+bool JsonFieldReader::GetBool(const char* key, bool& out) const {
+    const Field* field = Find(key);
+    if (!field || field->type != Type::BOOL) {
+        return false;
+    }
+    out = field->number != 0;
+    return true;
+}
+
+bool JsonFieldReader::OnNull() {
+    Add(Type::NUL);
+    return true;
+}
+
+bool JsonFieldReader::OnBool(bool value) {
+    if (Field* field = Add(Type::BOOL)) {
+        field->number = value ? 1 : 0;
+    }
+    return true;
+}
+
+bool JsonFieldReader::OnNumber(double value, const char*, size_t) {
+    if (Field* field = Add(Type::NUMBER)) {
+        field->number = value;
+    }
+    return true;
+}
+
+bool JsonFieldReader::OnString(const char* value, size_t length) {
+    if (Field* field = Add(Type::STRING)) {
+        field->text.assign(value, length);
+    }
+    return true;
+}
+
+bool JsonFieldReader::OnKey(const char* key, size_t length) {
+    if (depth_ == 1) {
+        key_.assign(key, length);
+    }
+    return true;
+}
+
+bool JsonFieldReader::OnBeginObject() {
+    depth_++;
+    return true;
+}
+
+bool JsonFieldReader::OnEndObject() {
+    depth_--;
+    return true;
+}
+
+bool JsonFieldReader::OnBeginArray() {
+    // 顶层必须是对象
+    return depth_++ > 0;
+}
+
+bool JsonFieldReader::OnEndArray() {
+    depth_--;
+    return true;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,425 @@
+#ifndef JSON_CODEC_H
+#define JSON_CODEC_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace EvoSpark {
+
+// ==================== 输出 sink ====================
+//
+// JsonWriter 只要求 sink 提供 Append(const char*, size_t)，
+// 与 prompt_template.h 中的 CountingSink / StringSink 通用。
+
+// 调用方提供的定长缓冲区；写满后置溢出标记，之后的数据全部丢弃
+class JsonBufferSink {
+public:
+    JsonBufferSink(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {
+        if (capacity_) {
+            buffer_[0] = '\0';
+        }
+    }
+
+    void Append(const char* data, size_t length) {
+        if (overflowed_ || capacity_ == 0 || length > capacity_ - 1 - size_) {
+            overflowed_ = true;
+            return;
+        }
+        memcpy(buffer_ + size_, data, length);
+        size_ += length;
+        buffer_[size_] = '\0';
+    }
+
+    const char* Data() const { return buffer_; }
+    size_t Size() const { return size_; }
+    bool Overflowed() const { return overflowed_; }
+
+private:
+    char* buffer_;
+    size_t capacity_;
+    size_t size_ = 0;
+    bool overflowed_ = false;
+};
+
+// 追加到字符串末尾（不清除已有内容）
+struct JsonStringSink {
+    std::string& out;
+
+    void Append(const char* data, size_t length) { out.append(data, length); }
+};
+
+// 只计长度，用于两遍写入时预先 reserve
+struct JsonCountingSink {
+    size_t bytes = 0;
+
+    void Append(const char*, size_t length) { bytes += length; }
+};
+
+// 分块输出：攒满调用方缓冲区后交给 flush（如 httpd_resp_send_chunk），
+// 任意长度的文档只占一块缓冲区。flush 失败后不再输出，由 Failed() 报告
+class JsonChunkSink {
+public:
+    using FlushFn = std::function<bool(const char* data, size_t length)>;
+
+    JsonChunkSink(char* buffer, size_t capacity, FlushFn flush)
+        : buffer_(buffer), capacity_(capacity), flush_(std::move(flush)) {}
+
+    void Append(const char* data, size_t length);
+
+    // 输出剩余数据；返回整个过程是否成功
+    bool Finish();
+
+    bool Failed() const { return failed_; }
+    size_t Total() const { return total_; }
+
+private:
+    bool FlushBuffer();
+
+    char* buffer_;
+    size_t capacity_;
+    FlushFn flush_;
+    size_t size_ = 0;
+    size_t total_ = 0;
+    bool failed_ = false;
+};
+
+// ==================== 字符串转义 ====================
+
+// 从头开始可原样输出的字节数：可打印 ASCII（'"' 和 '\\' 除外）
+// 以及合法的 UTF-8 多字节序列。按机器字一次检查多个字节，
+// 纯 ASCII 和中文文本都只在遇到需要转义的字节时才逐字节处理
+size_t JsonSafePrefix(const char* data, size_t length);
+
+// 从 data 开始的合法 UTF-8 序列长度，非法返回 0（拒绝过长编码、代理区和超范围码点）
+size_t Utf8SequenceLength(const char* data, size_t length);
+
+// 单个需转义字节的转义形式，写入 out（至少 7 字节），返回长度
+size_t JsonEscapeChar(unsigned char c, char* out);
+
+// 写入转义后的字符串内容（不含两侧引号）；非法 UTF-8 字节替换为 U+FFFD
+template <typename Sink>
+void JsonEscape(Sink& sink, const char* data, size_t length) {
+    static const char REPLACEMENT[] = "\xEF\xBF\xBD";
+    while (length > 0) {
+        size_t safe = JsonSafePrefix(data, length);
+        if (safe > 0) {
+            sink.Append(data, safe);
+            data += safe;
+            length -= safe;
+            if (length == 0) {
+                break;
+            }
+        }
+
+        unsigned char c = static_cast<unsigned char>(*data);
+        if (c >= 0x80) {
+            // 安全前缀停在高位字节上，说明这里不是合法序列
+            sink.Append(REPLACEMENT, 3);
+        } else {
+            char escaped[8];
+            sink.Append(escaped, JsonEscapeChar(c, escaped));
+        }
+        data++;
+        length--;
+    }
+}
+
+// ==================== 数字格式化 ====================
+
+// 十进制整数，返回长度（out 至少 21 字节）
+size_t JsonFormatUint(uint64_t value, char* out);
+size_t JsonFormatInt(int64_t value, char* out);
+
+// 能精确还原的最短表示（%.15g 不够时用 %.17g）；NaN / Inf 写作 null。out 至少 32 字节
+size_t JsonFormatDouble(double value, char* out);
+
+// float 按单精度取最短表示（0.7f 写作 0.7 而不是 0.699999988079071）
+size_t JsonFormatFloat(float value, char* out);
+
+// ==================== 流式写入 ====================
+
+// 流式 JSON 写入器
+//
+// 直接写入 sink，不建立中间树；逗号由写入器按层级自动插入。
+// 嵌套深度上限 MAX_DEPTH，调用方负责 Begin/End 配对。
+// indent > 0 时输出带缩进的多行格式（用于 Flash 上需要人工查看的文件）
+template <typename Sink>
+class JsonWriter {
+public:
+    explicit JsonWriter(Sink& sink, int indent = 0) : sink_(sink), indent_(indent) {}
+
+    void BeginObject() { BeginValue(); Put('{'); Push(); }
+    void EndObject() { Pop(); Put('}'); }
+    void BeginArray() { BeginValue(); Put('['); Push(); }
+    void EndArray() { Pop(); Put(']'); }
+
+    void Key(const char* key) { Key(key, strlen(key)); }
+    void Key(const std::string& key) { Key(key.data(), key.size()); }
+    void Key(const char* key, size_t length) {
+        BeginValue();
+        WriteString(key, length);
+        Put(':');
+        if (indent_ > 0) {
+            Put(' ');
+        }
+        after_key_ = true;
+    }
+
+    void String(const char* value) { String(value, strlen(value)); }
+    void String(const std::string& value) { String(value.data(), value.size()); }
+    void String(const char* value, size_t length) {
+        BeginValue();
+        WriteString(value, length);
+    }
+
+    void Int(int64_t value) {
+        BeginValue();
+        char buf[24];
+        sink_.Append(buf, JsonFormatInt(value, buf));
+    }
+
+    void Uint(uint64_t value) {
+        BeginValue();
+        char buf[24];
+        sink_.Append(buf, JsonFormatUint(value, buf));
+    }
+
+    void Double(double value) {
+        BeginValue();
+        char buf[32];
+        sink_.Append(buf, JsonFormatDouble(value, buf));
+    }
+
+    void Float(float value) {
+        BeginValue();
+        char buf[32];
+        sink_.Append(buf, JsonFormatFloat(value, buf));
+    }
+
+    void Bool(bool value) {
+        BeginValue();
+        if (value) {
+            sink_.Append("true", 4);
+        } else {
+            sink_.Append("false", 5);
+        }
+    }
+
+    void Null() {
+        BeginValue();
+        sink_.Append("null", 4);
+    }
+
+    // 写入已序列化好的 JSON 值（如归档中的会话记录），不做检查
+    void Raw(const char* json, size_t length) {
+        BeginValue();
+        sink_.Append(json, length);
+    }
+    void Raw(const std::string& json) { Raw(json.data(), json.size()); }
+
+    // 字符串值，内容由 fill(sink) 直接写入 sink，不经转义（如 base64 数据，
+    // 大块内容不必先拼成 std::string）。调用方保证写入的字节不需要转义
+    template <typename Fill>
+    void RawString(Fill&& fill) {
+        BeginValue();
+        Put('"');
+        fill(sink_);
+        Put('"');
+    }
+
+    // 常用的 键 + 值
+    void Field(const char* key, const char* value) { Key(key); String(value); }
+    void Field(const char* key, const std::string& value) { Key(key); String(value); }
+    void Field(const char* key, bool value) { Key(key); Bool(value); }
+    void Field(const char* key, int value) { Key(key); Int(value); }
+    void Field(const char* key, long value) { Key(key); Int(value); }
+    void Field(const char* key, long long value) { Key(key); Int(value); }
+    void Field(const char* key, unsigned value) { Key(key); Uint(value); }
+    void Field(const char* key, unsigned long value) { Key(key); Uint(value); }
+    void Field(const char* key, unsigned long long value) { Key(key); Uint(value); }
+    void Field(const char* key, float value) { Key(key); Float(value); }
+    void Field(const char* key, double value) { Key(key); Double(value); }
+
+    // 所有容器都已关闭
+    bool Complete() const { return depth_ == 0 && !empty_; }
+
+    static constexpr int MAX_DEPTH = 32;
+
+private:
+    void Put(char c) { sink_.Append(&c, 1); }
+
+    void NewLine() {
+        static const char SPACES[] = "                                ";
+        Put('\n');
+        for (int n = depth_ * indent_; n > 0; n -= 32) {
+            sink_.Append(SPACES, n < 32 ? n : 32);
+        }
+    }
+
+    // 值之前：补逗号与缩进（紧跟在键后面的值不需要）
+    void BeginValue() {
+        empty_ = false;
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ == 0) {
+            return;
+        }
+        uint32_t bit = 1u << (depth_ - 1);
+        if (has_items_ & bit) {
+            Put(',');
+        }
+        has_items_ |= bit;
+        if (indent_ > 0) {
+            NewLine();
+        }
+    }
+
+    void Push() {
+        depth_++;
+        has_items_ &= ~(1u << (depth_ - 1));
+    }
+
+    void Pop() {
+        bool had_items = has_items_ & (1u << (depth_ - 1));
+        depth_--;
+        if (indent_ > 0 && had_items) {
+            NewLine();
+        }
+    }
+
+    void WriteString(const char* value, size_t length) {
+        Put('"');
+        JsonEscape(sink_, value, length);
+        Put('"');
+    }
+
+    Sink& sink_;
+    int indent_;
+    int depth_ = 0;
+    uint32_t has_items_ = 0;  // 每层一位：该层已写过元素
+    bool after_key_ = false;
+    bool empty_ = true;
+};
+
+// 两遍写入到字符串末尾：先量长度，一次 reserve 后再写，避免反复扩容
+template <typename WriteFn>
+void JsonWriteTo(std::string& out, WriteFn&& write, int indent = 0) {
+    JsonCountingSink counter;
+    JsonWriter<JsonCountingSink> measure(counter, indent);
+    write(measure);
+    out.reserve(out.size() + counter.bytes);
+
+    JsonStringSink sink{out};
+    JsonWriter<JsonStringSink> writer(sink, indent);
+    write(writer);
+}
+
+// ==================== SAX 读取 ====================
+
+// 解析事件回调；返回 false 中止解析。默认实现全部忽略。
+// 字符串（含键）已反转义，指针只在回调期间有效
+class JsonHandler {
+public:
+    virtual ~JsonHandler() = default;
+
+    virtual bool OnNull() { return true; }
+    virtual bool OnBool(bool) { return true; }
+    virtual bool OnNumber(double, const char*, size_t) { return true; }
+    virtual bool OnString(const char*, size_t) { return true; }
+    virtual bool OnKey(const char*, size_t) { return true; }
+    virtual bool OnBeginObject() { return true; }
+    virtual bool OnEndObject() { return true; }
+    virtual bool OnBeginArray() { return true; }
+    virtual bool OnEndArray() { return true; }
+};
+
+// 解析结果
+enum class JsonParseError {
+    NONE,
+    SYNTAX,           // 语法错误
+    DEPTH,            // 嵌套超过上限
+    BAD_STRING,       // 非法转义、控制字符或 UTF-8
+    ABORTED,          // 回调要求中止
+    TRAILING,         // 文档后还有多余内容
+};
+
+// 流式解析器
+//
+// 一遍扫描、无递归、不建树。没有转义的字符串直接指向输入，
+// 有转义时才反转义到内部的复用缓冲区，解析期间不为每个值分配内存
+class JsonReader {
+public:
+    JsonParseError Parse(const char* json, size_t length, JsonHandler& handler);
+    JsonParseError Parse(const std::string& json, JsonHandler& handler) {
+        return Parse(json.data(), json.size(), handler);
+    }
+
+    // 出错位置（字节偏移）
+    size_t ErrorOffset() const { return pos_; }
+
+    static constexpr int MAX_DEPTH = 32;
+
+private:
+    bool ParseString(const char*& value, size_t& length);
+    bool ParseNumber(JsonHandler& handler, JsonParseError& error);
+    bool ParseLiteral(const char* literal, size_t length);
+    void SkipWhitespace();
+
+    const char* json_ = nullptr;
+    size_t length_ = 0;
+    size_t pos_ = 0;
+    std::string scratch_;   // 反转义缓冲区，跨次解析复用
+};
+
+// 读取对象第一层的标量字段（请求体这类小对象）；更深层的值被跳过
+//
+//   JsonFieldReader fields;
+//   if (fields.Parse(body, len) && fields.GetString("ssid", ssid)) ...
+class JsonFieldReader : private JsonHandler {
+public:
+    bool Parse(const char* json, size_t length);
+
+    bool Has(const char* key) const { return Find(key) != nullptr; }
+    bool GetString(const char* key, std::string& out) const;
+    bool GetNumber(const char* key, double& out) const;
+    bool GetBool(const char* key, bool& out) const;
+
+    static constexpr size_t MAX_FIELDS = 16;
+
+private:
+    enum class Type : uint8_t { STRING, NUMBER, BOOL, NUL };
+
+    struct Field {
+        std::string key;
+        std::string text;     // 字符串值
+        double number = 0;
+        Type type = Type::NUL;
+    };
+
+    const Field* Find(const char* key) const;
+    Field* Add(Type type);
+
+    bool OnNull() override;
+    bool OnBool(bool value) override;
+    bool OnNumber(double value, const char* raw, size_t raw_length) override;
+    bool OnString(const char* value, size_t length) override;
+    bool OnKey(const char* key, size_t length) override;
+    bool OnBeginObject() override;
+    bool OnEndObject() override;
+    bool OnBeginArray() override;
+    bool OnEndArray() override;
+
+    Field fields_[MAX_FIELDS];
+    size_t count_ = 0;
+    std::string key_;
+    int depth_ = 0;
+};
+
+} // namespace EvoSpark
+
+#endif // JSON_CODEC_H
@@ -0,0 +1,297 @@
+// JSON 编解码对比：固件的 JsonWriter / JsonReader 和 cJSON（ESP-IDF json 组件）
+//
+// 三种负载都取自 LLMClient 的实际用法：
+//   request   拼一个聊天请求体（人设 + 记忆约 1 KB，8 轮历史，stream / temperature / max_tokens）
+//   response  解析一个完整的补全响应，取 choices[0].message.content 和 usage
+//   chunk     解析一个 SSE 流式事件，取 choices[0].delta.content
+//
+// cJSON 一侧按换成 json_codec 之前的写法：建树 → cJSON_PrintUnformatted，
+// cJSON_Parse → 逐层 GetObjectItem。堆分配分别用 operator new 计数和
+// cJSON_InitHooks 计数，两边都只算一次操作内的分配。
+//
+// 用法：json_bench [--iterations N]
+
+#include "completion_parser.h"
+#include "json_codec.h"
+#include "cJSON.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace EvoSpark;
+
+namespace {
+
+size_t g_allocations = 0;
+
+void* CountingMalloc(size_t size) {
+    g_allocations++;
+    return malloc(size);
+}
+
+struct Message {
+    const char* role;
+    std::string content;
+};
+
+struct Request {
+    std::string model = "glm-4-flash";
+    std::vector<Message> messages;
+    double temperature = 0.7;
+    int max_tokens = 512;
+};
+
+std::string Repeat(const char* text, int times) {
+    std::string out;
+    for (int i = 0; i < times; i++) {
+        out += text;
+    }
+    return out;
+}
+
+Request MakeRequest() {
+    Request request;
+    request.messages.push_back({"system",
+        "你是 EvoSpark，一个友好、简洁的桌面语音助手。回答控制在三句话以内，不使用 Markdown。\n"
+        "## 用户画像\n" + Repeat("喜欢爬山和摄影，周末常去郊外，作息规律。", 6) +
+        "\n## 相关记忆\n- 上周提到膝盖有点疼，准备换一双登山鞋\n- 喜欢听 \"后摇\" 风格的音乐\n"
+        "- 对咖啡因敏感，下午不喝咖啡\n- 正在学习用 Lightroom 调色\n"
+        "## 上次会话\n" + Repeat("聊了周末去香山的路线和天气，助手建议早上出发避开人流。", 3)});
+    const char* const TURNS[] = {
+        "今天天气怎么样？适合出去拍照吗",
+        "多云转晴，下午光线会比较柔和，适合拍人像和风景。记得带上偏振镜。",
+        "那我下午两点出发可以吗",
+        "可以，两点出发到山脚大约三点，正好赶上侧光。注意补水。",
+        "帮我想想带哪些镜头",
+        "建议带一支 24-70 mm 的标准变焦，再加一支 70-200 mm 拍远景和特写。",
+        "好的，谢谢！顺便提醒我带充电宝",
+        "没问题，出发前我会提醒你带充电宝和备用电池。",
+    };
+    for (size_t i = 0; i < sizeof(TURNS) / sizeof(TURNS[0]); i++) {
+        request.messages.push_back({i % 2 == 0 ? "user" : "assistant", TURNS[i]});
+    }
+    return request;
+}
+
+const char RESPONSE[] =
+    "{\"id\":\"chatcmpl-8f2c1a\",\"object\":\"chat.completion\",\"created\":1718000000,"
+    "\"model\":\"glm-4-flash\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\","
+    "\"content\":\"下午两点出发正合适：多云转晴，光线柔和。\\n记得带上偏振镜、24-70 mm 镜头和充电宝，"
+    "山上风大，带件外套。\\\"早去早回\\\"，五点前下山比较安全。\"},\"finish_reason\":\"stop\"}],"
+    "\"usage\":{\"prompt_tokens\":612,\"completion_tokens\":58,\"total_tokens\":670,"
+    "\"prompt_tokens_details\":{\"cached_tokens\":512}}}";
+
+const char CHUNK[] =
+    "{\"id\":\"chatcmpl-8f2c1a\",\"object\":\"chat.completion.chunk\",\"created\":1718000000,"
+    "\"model\":\"glm-4-flash\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\"光线柔和\"},"
+    "\"finish_reason\":null}]}";
+
+// ---------- 固件写法 ----------
+
+void WriteRequest(const Request& request, std::string& out) {
+    out.clear();
+    JsonWriteTo(out, [&](auto& json) {
+        json.BeginObject();
+        json.Field("model", request.model);
+        json.Key("messages");
+        json.BeginArray();
+        for (const Message& msg : request.messages) {
+            json.BeginObject();
+            json.Field("role", msg.role);
+            json.Field("content", msg.content);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Field("stream", true);
+        json.Field("temperature", request.temperature);
+        json.Field("max_tokens", request.max_tokens);
+        json.EndObject();
+    });
+}
+
+bool ParseCompletion(JsonReader& reader, const char* json, const char* container,
+                     std::string& content, CompletionUsage& usage) {
+    content.clear();
+    usage = CompletionUsage();
+    CompletionHandler handler(container, content, usage);
+    return reader.Parse(json, strlen(json), handler) == JsonParseError::NONE &&
+           handler.FoundContent();
+}
+
+// ---------- cJSON 写法 ----------
+
+void WriteRequestCjson(const Request& request, std::string& out) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "model", request.model.c_str());
+    cJSON* messages = cJSON_CreateArray();
+    for (const Message& msg : request.messages) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "role", msg.role);
+        cJSON_AddStringToObject(item, "content", msg.content.c_str());
+        cJSON_AddItemToArray(messages, item);
+    }
+    cJSON_AddItemToObject(root, "messages", messages);
+    cJSON_AddBoolToObject(root, "stream", 1);
+    cJSON_AddNumberToObject(root, "temperature", request.temperature);
+    cJSON_AddNumberToObject(root, "max_tokens", request.max_tokens);
+    char* text = cJSON_PrintUnformatted(root);
+    out.assign(text ? text : "");
+    cJSON_free(text);
+    cJSON_Delete(root);
+}
+
+int GetInt(const cJSON* object, const char* key) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    return cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+bool ParseCompletionCjson(const char* json, const char* container, std::string& content,
+                          CompletionUsage& usage) {
+    content.clear();
+    usage = CompletionUsage();
+    cJSON* root = cJSON_Parse(json);
+    if (!root) {
+        return false;
+    }
+    bool found = false;
+    const cJSON* choice = cJSON_GetArrayItem(cJSON_GetObjectItemCaseSensitive(root, "choices"), 0);
+    const cJSON* message = cJSON_GetObjectItemCaseSensitive(choice, container);
+    const cJSON* text = cJSON_GetObjectItemCaseSensitive(message, "content");
+    if (cJSON_IsString(text)) {
+        content.assign(text->valuestring);
+        found = true;
+    }
+    const cJSON* u = cJSON_GetObjectItemCaseSensitive(root, "usage");
+    if (cJSON_IsObject(u)) {
+        usage.present = true;
+        usage.prompt_tokens = GetInt(u, "prompt_tokens");
+        usage.completion_tokens = GetInt(u, "completion_tokens");
+        usage.total_tokens = GetInt(u, "total_tokens");
+        usage.cached_tokens = GetInt(cJSON_GetObjectItemCaseSensitive(u, "prompt_tokens_details"),
+                                     "cached_tokens");
+    }
+    cJSON_Delete(root);
+    return found;
+}
+
+// ---------- 计时 ----------
+
+struct Result {
+    double ns_per_op = 0;
+    double allocs_per_op = 0;
+};
+
+template <typename Fn>
+Result Measure(int iterations, Fn&& fn) {
+    fn();   // 预热：复用的缓冲区先长到稳定大小
+    size_t allocations = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Result result;
+    result.ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    result.allocs_per_op = static_cast<double>(g_allocations - allocations) / iterations;
+    return result;
+}
+
+void PrintRow(const char* name, size_t bytes, const Result& ours, const Result& cjson) {
+    printf("%-9s %6zu B   json_codec %8.0f ns %5.1f allocs   cJSON %8.0f ns %5.1f allocs   %4.1fx\n",
+           name, bytes, ours.ns_per_op, ours.allocs_per_op, cjson.ns_per_op, cjson.allocs_per_op,
+           cjson.ns_per_op / ours.ns_per_op);
+}
+
+bool Check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "mismatch: %s\n", what);
+    }
+    return ok;
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    g_allocations++;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// 不内联：内联进容器代码后 GCC 会把这里的 free 误报为和 operator new 不配对
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20000;
+    static const struct option LONG_OPTIONS[] = {
+        {"iterations", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:", LONG_OPTIONS, nullptr)) != -1) {
+        if (opt != 'n') {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+        iterations = std::max(1, atoi(optarg));
+    }
+
+    cJSON_Hooks hooks = {CountingMalloc, free};
+    cJSON_InitHooks(&hooks);
+
+    // 两种写法的结果先对一遍：请求体互相能解析出同样的内容，响应取到同样的字段
+    Request request = MakeRequest();
+    std::string ours_body, cjson_body;
+    WriteRequest(request, ours_body);
+    WriteRequestCjson(request, cjson_body);
+    std::string ours_content, cjson_content;
+    CompletionUsage ours_usage, cjson_usage;
+    JsonReader reader;
+    bool ok = Check(ParseCompletion(reader, RESPONSE, "message", ours_content, ours_usage) &&
+                    ParseCompletionCjson(RESPONSE, "message", cjson_content, cjson_usage) &&
+                    ours_content == cjson_content &&
+                    ours_usage.cached_tokens == cjson_usage.cached_tokens &&
+                    ours_usage.total_tokens == cjson_usage.total_tokens, "response");
+    ok &= Check(ParseCompletion(reader, CHUNK, "delta", ours_content, ours_usage) &&
+                ParseCompletionCjson(CHUNK, "delta", cjson_content, cjson_usage) &&
+                ours_content == cjson_content, "chunk");
+    JsonFieldReader fields;
+    double max_tokens = 0;
+    ok &= Check(fields.Parse(cjson_body.data(), cjson_body.size()) &&
+                fields.GetNumber("max_tokens", max_tokens) && max_tokens == request.max_tokens,
+                "cJSON request body");
+    if (!ok) {
+        return 1;
+    }
+
+    printf("%d iterations per case\n", iterations);
+    std::string body;
+    body.reserve(ours_body.size());
+    PrintRow("request", ours_body.size(),
+             Measure(iterations, [&]() { WriteRequest(request, body); }),
+             Measure(iterations, [&]() { WriteRequestCjson(request, body); }));
+
+    std::string content;
+    content.reserve(256);
+    CompletionUsage usage;
+    PrintRow("response", strlen(RESPONSE),
+             Measure(iterations, [&]() { ParseCompletion(reader, RESPONSE, "message", content, usage); }),
+             Measure(iterations, [&]() { ParseCompletionCjson(RESPONSE, "message", content, usage); }));
+    PrintRow("chunk", strlen(CHUNK),
+             Measure(iterations, [&]() { ParseCompletion(reader, CHUNK, "delta", content, usage); }),
+             Measure(iterations, [&]() { ParseCompletionCjson(CHUNK, "delta", content, usage); }));
+    return 0;
+}
@@ -0,0 +1,304 @@
+// 链路整形模拟：固定参数 vs LinkQuality 自适应
+//
+// 离散事件模拟，时间是虚拟的（esp_timer_get_time 由这里提供）。每轮对话按
+// 房间的 RTT、上行带宽和每包丢失率算首字节时间，卡住的请求等超时后重试，
+// 交互请求超过对冲延迟没有首字节就再发一份；每 4 轮一次看图（JPEG 上传，
+// 不对冲，超时固定 30 s）。自适应时 JPEG 质量、上下文比例、超时和对冲延迟
+// 取自 LinkQuality::GetProfile()，估计器只用真实流量的副产品喂样本，和固件
+// 一样。
+//
+// 同一房间先跑固定参数再跑自适应：固定参数那一遍不碰估计器（单例），自适应
+// 从干净的估计器开始。聊天和看图的平均耗时，自适应比固定参数少不到
+// --min-gain 百分比时退出码为 1（可以为负，表示允许变差多少）。
+//
+// 用法：link_shaping [--room weak|strong] [--turns N] [--seed S] [--min-gain PCT]
+
+#include "link_quality.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace EvoSpark;
+
+namespace {
+
+int64_t g_now_us = 0;
+
+struct Room {
+    const char* name;
+    const char* description;
+    int rssi;
+    double rtt_ms;
+    double up_Bps;          // 上行字节/秒
+    double stall_per_pkt;   // 每个包卡死的概率
+};
+
+const Room ROOMS[] = {
+    {"strong", "-55 dBm, 40 ms RTT, 500 KB/s up", -55, 40, 500000, 0.00005},
+    {"weak", "-80 dBm, 300 ms RTT, 20 KB/s up, lossy", -80, 300, 20000, 0.004},
+};
+
+struct Params {
+    int jpeg_quality;
+    int context_percent;
+    uint32_t timeout_ms;
+    uint32_t hedge_ms;
+};
+
+// 换自适应之前的固定值
+constexpr Params FIXED = {12, 100, 30000, 2000};
+
+std::mt19937_64 g_rng;
+
+double Uniform() {
+    return std::uniform_real_distribution<double>(0, 1)(g_rng);
+}
+
+// 按 (seed, 轮次, 子流) 重新播种。固定参数和自适应两遍的同一轮、同一次尝试
+// 抽到同样的随机数，差别只来自参数，不会因为某一遍多发了对冲请求而整段错开
+void Reseed(uint64_t seed, int turn, int stream) {
+    std::seed_seq seq{seed, static_cast<uint64_t>(turn), static_cast<uint64_t>(stream)};
+    g_rng.seed(seq);
+}
+
+// 320x240 JPEG 的大致字节数
+double JpegBytes(int quality) {
+    return quality <= 12 ? 14000 : quality <= 20 ? 9000 : 6500;
+}
+
+// 一次尝试：返回首字节时间（ms），卡住返回 -1
+double Attempt(const Room& room, double body_bytes, double server_ms, bool reconnect) {
+    double packets = body_bytes / 1400 + 12;
+    if (Uniform() < 1 - std::pow(1 - room.stall_per_pkt, packets)) {
+        return -1;
+    }
+    double t = reconnect ? 2 * room.rtt_ms : 0;
+    t += body_bytes / room.up_Bps * 1000 + room.rtt_ms;
+    // 丢包重传带来的额外等待
+    for (int i = 0; i < static_cast<int>(packets); i++) {
+        if (Uniform() < room.stall_per_pkt * 20) {
+            t += std::max(200.0, 2 * room.rtt_ms);
+        }
+    }
+    return t + server_ms;
+}
+
+struct Result {
+    std::vector<double> chat;
+    std::vector<double> vision;
+    int timeouts = 0;
+    int hedges = 0;
+};
+
+Result Run(const Room& room, bool adaptive, int turns, uint64_t seed) {
+    LinkQuality& lq = LinkQuality::GetInstance();
+    Result result;
+    for (int turn = 0; turn < turns; turn++) {
+        Reseed(seed, turn, 0);
+        // 两轮之间 20-60 秒，期间每 5 秒一个 RSSI
+        double gap_s = 20 + 40 * Uniform();
+        for (double s = 0; s < gap_s; s += 5) {
+            g_now_us += 5000000;
+            int rssi = room.rssi + static_cast<int>(std::lround(6 * Uniform() - 3));
+            if (adaptive) {
+                lq.RecordRssi(rssi);
+            }
+        }
+        Params params = FIXED;
+        if (adaptive) {
+            LinkProfile profile = lq.GetProfile();
+            params = {profile.jpeg_quality, profile.context_percent, profile.response_timeout_ms,
+                      profile.hedge_after_ms};
+        }
+
+        bool vision = turn % 4 == 3;
+        double prompt_tokens = 2500.0 * params.context_percent / 100;
+        double body = prompt_tokens * 3 * 0.45;   // UTF-8 JSON，gzip 后
+        double server_ms = 350 + prompt_tokens * 0.12 + 300 * (-std::log(Uniform()));
+        uint32_t timeout = vision ? 30000 : params.timeout_ms;
+        if (vision) {
+            body = JpegBytes(params.jpeg_quality) * 4 / 3 + 600;   // base64
+            server_ms += 2500;
+        }
+
+        double elapsed = 0;
+        bool done = false;
+        for (int attempt = 1; attempt <= 3 && !done; attempt++) {
+            bool reconnect = attempt == 1;   // 两轮间隔超过空闲上限，每轮重连
+            Reseed(seed, turn, 2 * attempt);
+            double first = Attempt(room, body, server_ms, reconnect);
+            double rtt_jitter = 0.8 + 0.4 * Uniform();
+            double win = first;
+            bool hedged = false;
+            if (!vision && (first < 0 || first > params.hedge_ms)) {
+                result.hedges++;
+                Reseed(seed, turn, 2 * attempt + 1);
+                double second = Attempt(room, body, server_ms, true);
+                if (second >= 0) {
+                    second += params.hedge_ms;
+                    if (first < 0 || second < first) {
+                        win = second;
+                        hedged = true;
+                    }
+                }
+            }
+            if (reconnect && adaptive) {
+                lq.RecordRtt(static_cast<uint32_t>(2 * room.rtt_ms * rtt_jitter) / 2);
+            }
+            if (win < 0 || win > timeout) {
+                result.timeouts++;
+                elapsed += timeout + 300;   // 超时后退避再试
+                if (adaptive) {
+                    lq.RecordRequest(true);
+                }
+                continue;
+            }
+            elapsed += win;
+            done = true;
+            if (adaptive) {
+                lq.RecordRequest(false);
+                if (vision) {
+                    lq.RecordThroughput(static_cast<size_t>(body),
+                                        static_cast<uint32_t>(body / room.up_Bps * 1000));
+                } else if (attempt == 1 && !hedged) {
+                    lq.RecordFirstByte(static_cast<uint32_t>(win));
+                }
+            }
+        }
+        g_now_us += static_cast<int64_t>(elapsed * 1000);
+        (vision ? result.vision : result.chat).push_back(elapsed);
+    }
+    return result;
+}
+
+double Mean(const std::vector<double>& v) {
+    double sum = 0;
+    for (double x : v) {
+        sum += x;
+    }
+    return v.empty() ? 0 : sum / v.size();
+}
+
+double Percentile(std::vector<double> v, int pct) {
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[std::min(v.size() - 1, v.size() * pct / 100)];
+}
+
+void PrintRow(const char* label, const std::vector<double>& fixed, const std::vector<double>& adaptive) {
+    printf("  %-12s %8.0f ms %8.0f ms\n", (std::string(label) + " mean").c_str(), Mean(fixed),
+           Mean(adaptive));
+    printf("  %-12s %8.0f ms %8.0f ms\n", (std::string(label) + " p95").c_str(),
+           Percentile(fixed, 95), Percentile(adaptive, 95));
+}
+
+double Gain(const std::vector<double>& fixed, const std::vector<double>& adaptive) {
+    double base = Mean(fixed);
+    return base > 0 ? 100 * (base - Mean(adaptive)) / base : 0;
+}
+
+} // namespace
+
+// ---------- 虚拟时钟和 WiFi ----------
+
+extern "C" int64_t esp_timer_get_time(void) {
+    return g_now_us;
+}
+
+extern "C" esp_err_t esp_timer_create(const esp_timer_create_args_t*, esp_timer_handle_t*) {
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t) {
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_stop(esp_timer_handle_t) {
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_delete(esp_timer_handle_t) {
+    return ESP_OK;
+}
+
+// RSSI 由模拟直接喂给 RecordRssi
+extern "C" esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t*) {
+    return ESP_FAIL;
+}
+
+extern "C" void esp_log_level_set(const char*, esp_log_level_t) {}
+
+extern "C" void esp_log_write(esp_log_level_t, const char*, const char*, ...) {}
+
+int main(int argc, char** argv) {
+    const Room* room = &ROOMS[1];
+    int turns = 4000;
+    uint64_t seed = 42;
+    double min_gain = -100;
+
+    static const struct option LONG_OPTIONS[] = {
+        {"room", required_argument, nullptr, 'r'},
+        {"turns", required_argument, nullptr, 'n'},
+        {"seed", required_argument, nullptr, 's'},
+        {"min-gain", required_argument, nullptr, 'g'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "r:n:s:g:", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'r':
+                room = nullptr;
+                for (const Room& r : ROOMS) {
+                    if (strcmp(r.name, optarg) == 0) {
+                        room = &r;
+                    }
+                }
+                if (!room) {
+                    fprintf(stderr, "unknown room: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'n': turns = std::max(4, atoi(optarg)); break;
+            case 's': seed = strtoull(optarg, nullptr, 10); break;
+            case 'g': min_gain = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [--room weak|strong] [--turns N] [--seed S] [--min-gain PCT]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    Result fixed = Run(*room, false, turns, seed);
+    Result adaptive = Run(*room, true, turns, seed);
+
+    LinkStats stats = LinkQuality::GetInstance().GetStats();
+    LinkProfile profile = LinkQuality::GetInstance().GetProfile();
+    printf("%s room (%s), %d turns, every 4th a vision turn\n", room->name, room->description, turns);
+    printf("  %-12s %11s %11s\n", "", "fixed", "adaptive");
+    PrintRow("chat", fixed.chat, adaptive.chat);
+    PrintRow("vision", fixed.vision, adaptive.vision);
+    printf("  %-12s %11d %11d\n", "timeouts", fixed.timeouts, adaptive.timeouts);
+    printf("  %-12s %11d %11d\n", "hedges", fixed.hedges, adaptive.hedges);
+    printf("  final link %s: srtt %u ms, first byte %u+-%u ms, up %u kbps, loss %u permille\n",
+           LinkClassToString(stats.link), stats.srtt_ms, stats.first_byte_ms, stats.first_byte_var_ms,
+           stats.uplink_kbps, stats.loss_permille);
+    printf("  profile: jpeg q%d, context %d%%, timeout %u ms, hedge %u ms\n", profile.jpeg_quality,
+           profile.context_percent, profile.response_timeout_ms, profile.hedge_after_ms);
+
+    double chat_gain = Gain(fixed.chat, adaptive.chat);
+    double vision_gain = Gain(fixed.vision, adaptive.vision);
+    printf("  gain: chat %.1f%%, vision %.1f%% (min %.1f%%)\n", chat_gain, vision_gain, min_gain);
+    if (chat_gain < min_gain || vision_gain < min_gain) {
+        fprintf(stderr, "FAIL: adaptive gain below %.1f%%\n", min_gain);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+// 提示词渲染的堆分配：PromptBuilder（编译期模板）和换模板之前的 ostringstream 写法
+//
+//   system       BuildSystemPrompt，全部长期记忆
+//   compression  BuildCompressionPrompt，旧记忆 + 一次会话
+//   turn memory  RenderSessionMemory + RenderRelevantMemory 写进复用的缓冲区
+//                （ContextPacker 每轮的用法，旧写法没有对应项）
+//
+// 旧写法原样抄自换模板之前的 prompt_builder.cc。operator new 计数，分配次数和
+// 字节数都只算一次渲染内的。先核对两种写法逐字节一致；模板写法的分配次数
+// 超过预期（一次 reserve，复用缓冲区时为零）时退出码为 1。
+//
+// 用法：prompt_bench [--iterations N]
+
+#include "prompt_builder.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace EvoSpark;
+
+namespace {
+
+size_t g_allocations = 0;
+size_t g_allocated_bytes = 0;
+
+// ---------- 旧写法 ----------
+
+namespace legacy {
+
+std::string BuildBasePersona() {
+    return R"(你是 EvoSpark，一个友好的 AI 陪伴机器人。
+你的特点：
+- 温暖、耐心、善于倾听
+- 回答简洁明了，避免冗长
+- 偶尔会表达自己的情感和想法
+- 记得和用户之前的对话内容
+
+你由 ESP32-S3 驱动，具备视觉、听觉和表达能力。)";
+}
+
+std::string FormatMemory(const CompressedMemory& memory) {
+    if (memory.IsEmpty()) {
+        return "\n[这是我们的第一次对话，还没有关于你的记忆。]";
+    }
+
+    std::ostringstream oss;
+    if (!memory.user_profile.empty()) {
+        oss << "\n【用户画像】\n" << memory.user_profile << "\n";
+    }
+    if (!memory.key_events.empty()) {
+        oss << "\n【重要事件】\n";
+        for (const auto& event : memory.key_events) {
+            oss << "- " << event << "\n";
+        }
+    }
+    if (!memory.preferences.empty()) {
+        oss << "\n【用户偏好】\n";
+        for (const auto& pref : memory.preferences) {
+            oss << "- " << pref << "\n";
+        }
+    }
+    if (!memory.last_session_summary.empty()) {
+        oss << "\n【上次对话】\n" << memory.last_session_summary << "\n";
+    }
+    return oss.str();
+}
+
+std::string FormatHistory(const std::vector<Message>& messages) {
+    if (messages.empty()) {
+        return "";
+    }
+
+    std::ostringstream oss;
+    for (const auto& msg : messages) {
+        if (msg.role == Role::SYSTEM) {
+            continue;
+        }
+        const char* role_name = (msg.role == Role::USER) ? "用户" : "EvoSpark";
+        oss << role_name << ": " << msg.content << "\n";
+    }
+    return oss.str();
+}
+
+std::string BuildGuidelines() {
+    std::ostringstream oss;
+    oss << "\n【互动指南】\n";
+    oss << "- 根据记忆中的信息调整你的回答\n";
+    oss << "- 如果记忆中有相关事件，可以适当提及\n";
+    oss << "- 尊重用户的偏好\n";
+    oss << "- 保持自然、亲切的对话风格\n";
+    return oss.str();
+}
+
+std::string BuildSystemPrompt(const CompressedMemory& memory) {
+    std::ostringstream oss;
+    oss << BuildBasePersona();
+    oss << "\n\n【关于用户的记忆】";
+    oss << FormatMemory(memory);
+    oss << BuildGuidelines();
+    return oss.str();
+}
+
+std::string BuildCompressionPrompt(const CompressedMemory& old_memory,
+                                   const std::vector<Message>& session_messages) {
+    std::ostringstream oss;
+
+    oss << "你是一个记忆压缩助手。请将用户的旧记忆和本次对话整合，生成新的压缩记忆。\n\n";
+
+    oss << "【要求】\n";
+    oss << "1. 保留用户画像的关键信息\n";
+    oss << "2. 更新重要事件列表（保留最近 20 条）\n";
+    oss << "3. 更新用户偏好（发现新偏好时添加，最多 10 条）\n";
+    oss << "4. 移除过时或重复的信息\n";
+    oss << "5. 生成简短的上次会话摘要（1-2 句话）\n\n";
+
+    oss << "【输出格式】\n";
+    oss << "请严格按照以下 JSON 格式输出，不要包含其他内容：\n";
+    oss << "{\n";
+    oss << "  \"user_profile\": \"用户画像描述\",\n";
+    oss << "  \"key_events\": [\"事件1\", \"事件2\", ...],\n";
+    oss << "  \"preferences\": [\"偏好1\", \"偏好2\", ...],\n";
+    oss << "  \"last_session_summary\": \"上次会话摘要\"\n";
+    oss << "}\n\n";
+
+    oss << "【旧记忆】\n";
+    oss << FormatMemory(old_memory);
+    oss << "\n";
+
+    oss << "【本次对话】\n";
+    oss << FormatHistory(session_messages);
+
+    return oss.str();
+}
+
+} // namespace legacy
+
+// ---------- 输入 ----------
+
+CompressedMemory MakeMemory() {
+    CompressedMemory memory;
+    memory.user_profile = "喜欢爬山和摄影的上班族，周末常去郊外，作息规律，对咖啡因敏感。";
+    memory.key_events = {
+        "上周去香山拍了红叶",
+        "膝盖有点疼，准备换一双登山鞋",
+        "正在学习用 Lightroom 调色",
+        "养了一只叫豆豆的橘猫",
+        "下个月要去云南出差",
+        "最近在读《人类简史》",
+    };
+    memory.preferences = {"回答简短", "语气轻松", "喜欢听后摇", "下午不喝咖啡"};
+    memory.last_session_summary = "用户聊了周末去香山的路线和天气，助手建议早上出发避开人流。";
+    return memory;
+}
+
+std::vector<Message> MakeSession() {
+    const char* const TURNS[] = {
+        "今天天气怎么样？适合出去拍照吗",
+        "多云转晴，下午光线会比较柔和，适合拍人像和风景。记得带上偏振镜。",
+        "那我下午两点出发可以吗",
+        "可以，两点出发到山脚大约三点，正好赶上侧光。注意补水。",
+        "帮我想想带哪些镜头",
+        "建议带一支 24-70 mm 的标准变焦，再加一支 70-200 mm 拍远景和特写。",
+        "好的，谢谢！顺便提醒我带充电宝",
+        "没问题，出发前我会提醒你带充电宝和备用电池。",
+    };
+    std::vector<Message> session;
+    for (size_t i = 0; i < sizeof(TURNS) / sizeof(TURNS[0]); i++) {
+        session.emplace_back(i % 2 == 0 ? Role::USER : Role::ASSISTANT, TURNS[i]);
+    }
+    return session;
+}
+
+std::vector<MemoryHit> MakeHits(const CompressedMemory& memory) {
+    std::vector<MemoryHit> hits;
+    for (size_t i = 0; i < 4; i++) {
+        hits.push_back({MemorySource::EVENT, memory.key_events[i], 1.0f, 0});
+    }
+    hits.push_back({MemorySource::PREFERENCE, memory.preferences[0], 0.8f, 0});
+    hits.push_back({MemorySource::SUMMARY, "两周前聊过换登山鞋的预算", 0.5f, 0});
+    return hits;
+}
+
+// ---------- 计数 ----------
+
+struct Result {
+    size_t bytes = 0;       // 输出长度
+    double allocs = 0;      // 每次渲染的分配次数
+    double alloc_bytes = 0; // 每次渲染申请的字节数
+    double ns = 0;
+};
+
+template <typename Fn>
+Result Measure(int iterations, Fn&& fn) {
+    Result result;
+    result.bytes = fn();   // 预热：复用的缓冲区先长到稳定大小
+    size_t allocations = g_allocations;
+    size_t allocated = g_allocated_bytes;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    result.allocs = static_cast<double>(g_allocations - allocations) / iterations;
+    result.alloc_bytes = static_cast<double>(g_allocated_bytes - allocated) / iterations;
+    return result;
+}
+
+void PrintRow(const char* name, const Result& ours, const Result* old) {
+    printf("%-12s %5zu B   template %4.1f allocs %6.0f B %7.0f ns", name, ours.bytes,
+           ours.allocs, ours.alloc_bytes, ours.ns);
+    if (old) {
+        printf("   ostringstream %4.1f allocs %6.0f B %7.0f ns", old->allocs, old->alloc_bytes,
+               old->ns);
+    }
+    printf("\n");
+}
+
+bool Check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+    }
+    return ok;
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    g_allocations++;
+    g_allocated_bytes += size;
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// 不内联：内联进容器代码后 GCC 会把这里的 free 误报为和 operator new 不配对
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20000;
+    static const struct option LONG_OPTIONS[] = {
+        {"iterations", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:", LONG_OPTIONS, nullptr)) != -1) {
+        if (opt != 'n') {
+            fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+        iterations = std::max(1, atoi(optarg));
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    const CompressedMemory memory = MakeMemory();
+    const std::vector<Message> session = MakeSession();
+    const std::vector<MemoryHit> hits = MakeHits(memory);
+
+    bool ok = Check(PromptBuilder::BuildSystemPrompt(memory) == legacy::BuildSystemPrompt(memory),
+                    "system prompt differs from the ostringstream version");
+    ok &= Check(PromptBuilder::BuildCompressionPrompt(memory, session) ==
+                    legacy::BuildCompressionPrompt(memory, session),
+                "compression prompt differs from the ostringstream version");
+    if (!ok) {
+        return 1;
+    }
+
+    printf("%d iterations per case\n", iterations);
+    Result system = Measure(iterations, [&]() {
+        return PromptBuilder::BuildSystemPrompt(memory).size();
+    });
+    Result system_old = Measure(iterations, [&]() {
+        return legacy::BuildSystemPrompt(memory).size();
+    });
+    PrintRow("system", system, &system_old);
+
+    Result compression = Measure(iterations, [&]() {
+        return PromptBuilder::BuildCompressionPrompt(memory, session).size();
+    });
+    Result compression_old = Measure(iterations, [&]() {
+        return legacy::BuildCompressionPrompt(memory, session).size();
+    });
+    PrintRow("compression", compression, &compression_old);
+
+    std::string buffer;
+    Result turn = Measure(iterations, [&]() {
+        buffer.clear();
+        PromptBuilder::RenderSessionMemory(memory, buffer);
+        PromptBuilder::RenderRelevantMemory(hits, buffer);
+        return buffer.size();
+    });
+    PrintRow("turn memory", turn, nullptr);
+
+    // 模板写法：量好长度后只 reserve 一次，复用缓冲区时不再分配
+    ok &= Check(system.allocs <= 1.0, "system prompt allocates more than once");
+    ok &= Check(compression.allocs <= 1.0, "compression prompt allocates more than once");
+    ok &= Check(turn.allocs == 0.0, "turn memory allocates with a reused buffer");
+    return ok ? 0 : 1;
+}
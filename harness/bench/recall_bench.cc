@@ -0,0 +1,183 @@
+// 记忆检索回放：把语料里的记忆条目建成 MemoryIndex，逐条回放查询，统计
+// 期望条目出现在命中里的比例（recall@k）、排第一的比例（top-1），以及实际
+// 注入的 token 占全量注入的比例。任何一项越过阈值时退出码为 1。
+//
+// 默认参数和固件一致（top_k 6，token 预算 300）。
+//
+// 用法：recall_bench [--corpus FILE] [--top-k N] [--budget TOKENS]
+//                    [--min-recall R] [--min-top1 R] [--max-token-ratio R] [-v]
+
+#include "memory_index.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+using namespace EvoSpark;
+
+namespace {
+
+struct Probe {
+    std::string query;
+    std::string expect;
+};
+
+bool ParseSource(const std::string& name, MemorySource& source) {
+    if (name == "event") {
+        source = MemorySource::EVENT;
+    } else if (name == "preference") {
+        source = MemorySource::PREFERENCE;
+    } else if (name == "summary") {
+        source = MemorySource::SUMMARY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 按制表符切分一行
+std::vector<std::string> SplitTabs(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) {
+            return fields;
+        }
+        start = tab + 1;
+    }
+}
+
+bool LoadCorpus(const char* path, MemoryIndex& index, std::vector<std::string>& texts,
+                std::vector<Probe>& probes) {
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::vector<std::string> fields = SplitTabs(line);
+        MemorySource source;
+        if (fields[0] == "?" && fields.size() == 3) {
+            probes.push_back({fields[1], fields[2]});
+        } else if (fields.size() == 2 && ParseSource(fields[0], source)) {
+            index.Add(source, fields[1]);
+            texts.push_back(fields[1]);
+        } else {
+            fprintf(stderr, "%s:%d: malformed line\n", path, line_no);
+            return false;
+        }
+    }
+    // 期望条目必须在语料里，否则打错字会被算成召回失败
+    for (const Probe& probe : probes) {
+        bool known = false;
+        for (const std::string& text : texts) {
+            known |= text == probe.expect;
+        }
+        if (!known) {
+            fprintf(stderr, "%s: expected memory not in corpus: %s\n", path, probe.expect.c_str());
+            return false;
+        }
+    }
+    return !probes.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* corpus = RECALL_CORPUS;
+    size_t top_k = 6;
+    int budget = 300;
+    double min_recall = 0;
+    double min_top1 = 0;
+    double max_token_ratio = 1;
+    bool verbose = false;
+
+    static const struct option LONG_OPTIONS[] = {
+        {"corpus", required_argument, nullptr, 'c'},
+        {"top-k", required_argument, nullptr, 'k'},
+        {"budget", required_argument, nullptr, 'b'},
+        {"min-recall", required_argument, nullptr, 'r'},
+        {"min-top1", required_argument, nullptr, 't'},
+        {"max-token-ratio", required_argument, nullptr, 'x'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:k:b:r:t:x:v", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'c': corpus = optarg; break;
+            case 'k': top_k = strtoul(optarg, nullptr, 10); break;
+            case 'b': budget = atoi(optarg); break;
+            case 'r': min_recall = atof(optarg); break;
+            case 't': min_top1 = atof(optarg); break;
+            case 'x': max_token_ratio = atof(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [--corpus FILE] [--top-k N] [--budget TOKENS] "
+                        "[--min-recall R] [--min-top1 R] [--max-token-ratio R] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    MemoryIndex index;
+    std::vector<std::string> texts;
+    std::vector<Probe> probes;
+    if (!LoadCorpus(corpus, index, texts, probes)) {
+        return 2;
+    }
+
+    int recalled = 0;
+    int first = 0;
+    for (const Probe& probe : probes) {
+        std::vector<MemoryHit> hits = index.Query(probe.query, top_k, budget);
+        int rank = -1;
+        for (size_t i = 0; i < hits.size() && rank < 0; i++) {
+            if (hits[i].text == probe.expect) {
+                rank = static_cast<int>(i);
+            }
+        }
+        recalled += rank >= 0;
+        first += rank == 0;
+        if (verbose || rank != 0) {
+            printf("%s %-24s -> %s (%zu hits)\n", rank == 0 ? "ok  " : rank > 0 ? "rank" : "MISS",
+                   probe.query.c_str(), hits.empty() ? "-" : hits[0].text.c_str(), hits.size());
+        }
+    }
+
+    const RetrievalStats& stats = index.GetStats();
+    const int n = static_cast<int>(probes.size());
+    const double recall = static_cast<double>(recalled) / n;
+    const double top1 = static_cast<double>(first) / n;
+    const double token_ratio = stats.full_tokens
+        ? static_cast<double>(stats.injected_tokens) / stats.full_tokens : 0;
+    printf("%zu memories, %d queries, top_k %zu, budget %d\n", texts.size(), n, top_k, budget);
+    printf("recall@%zu %d/%d  top-1 %d/%d  tokens %llu/%llu (%.0f%%)\n", top_k, recalled, n,
+           first, n, static_cast<unsigned long long>(stats.injected_tokens),
+           static_cast<unsigned long long>(stats.full_tokens), token_ratio * 100);
+
+    bool ok = true;
+    if (recall < min_recall) {
+        fprintf(stderr, "FAIL: recall %.2f < %.2f\n", recall, min_recall);
+        ok = false;
+    }
+    if (top1 < min_top1) {
+        fprintf(stderr, "FAIL: top-1 %.2f < %.2f\n", top1, min_top1);
+        ok = false;
+    }
+    if (token_ratio > max_token_ratio) {
+        fprintf(stderr, "FAIL: token ratio %.2f > %.2f\n", token_ratio, max_token_ratio);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#ifndef HOST_ESP_CRT_BUNDLE_H
+#define HOST_ESP_CRT_BUNDLE_H
+
+// 主机替身：HTTP 客户端只支持明文 http://，证书包不会被用到
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_crt_bundle_attach(void* conf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_CRT_BUNDLE_H
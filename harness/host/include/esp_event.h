@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_EVENT_H
+#define HOST_ESP_EVENT_H
+
+// 主机替身：只有类型（实时语音通道不在主机上编译，见 host/src/voice_off.cc）
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* handler_arg, esp_event_base_t base,
+                                    int32_t event_id, void* event_data);
+
+#define ESP_EVENT_ANY_ID -1
+
+#endif // HOST_ESP_EVENT_H
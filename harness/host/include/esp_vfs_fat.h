@@ -0,0 +1,36 @@
+#ifndef HOST_ESP_VFS_FAT_H
+#define HOST_ESP_VFS_FAT_H
+
+// 主机替身：挂载点映射到数据目录下的同名子目录（见 host_shim.h）
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef int32_t wl_handle_t;
+#define WL_INVALID_HANDLE -1
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+    bool disk_status_check_enable;
+    bool use_one_fat;
+} esp_vfs_fat_mount_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_vfs_fat_spiflash_mount_rw_wl(const char* base_path, const char* partition_label,
+                                           const esp_vfs_fat_mount_config_t* mount_config,
+                                           wl_handle_t* wl_handle);
+esp_err_t esp_vfs_fat_spiflash_unmount_rw_wl(const char* base_path, wl_handle_t wl_handle);
+esp_err_t esp_vfs_fat_info(const char* base_path, uint64_t* out_total_bytes, uint64_t* out_free_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_VFS_FAT_H
@@ -0,0 +1,25 @@
+#ifndef HOST_ESP_WEBSOCKET_CLIENT_H
+#define HOST_ESP_WEBSOCKET_CLIENT_H
+
+// 主机替身：只有 voice_channel.h 用到的类型（实时语音通道不在主机上编译，
+// 见 host/src/voice_off.cc）
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct esp_websocket_client* esp_websocket_client_handle_t;
+
+typedef struct {
+    const char* data_ptr;
+    int data_len;
+    bool fin;
+    uint8_t op_code;
+    esp_websocket_client_handle_t client;
+    void* user_context;
+    int payload_len;
+    int payload_offset;
+} esp_websocket_event_data_t;
+
+#endif // HOST_ESP_WEBSOCKET_CLIENT_H
@@ -0,0 +1,27 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+// 主机替身：只有 LinkQuality 读 RSSI 用到的部分，信号强度由 host_shim.h
+// 的 HostSetWifiRssi 设定
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+} wifi_ap_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_WIFI_H
@@ -0,0 +1,21 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// 主机替身：FreeRTOS 基本类型，节拍为 1 ms（同 sdkconfig 的 CONFIG_FREERTOS_HZ=1000）
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         ((BaseType_t)0)
+#define pdTRUE          ((BaseType_t)1)
+#define pdFAIL          pdFALSE
+#define pdPASS          pdTRUE
+
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      ((TickType_t)1)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,11 @@
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H
+#define HOST_FREERTOS_EVENT_GROUPS_H
+
+// 主机替身：只有类型（事件组只在实时语音里用，它不在主机上编译）
+
+#include "FreeRTOS.h"
+
+typedef struct HostEventGroup* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+#endif // HOST_FREERTOS_EVENT_GROUPS_H
@@ -0,0 +1,10 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+// 主机替身：只有类型（队列只在实时语音里用，它不在主机上编译）
+
+#include "FreeRTOS.h"
+
+typedef struct HostQueue* QueueHandle_t;
+
+#endif // HOST_FREERTOS_QUEUE_H
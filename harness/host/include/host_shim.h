@@ -0,0 +1,22 @@
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+// 主机替身层的控制接口（设备上没有对应物，只给主机上的程序用）
+
+#include <string>
+
+namespace EvoSpark {
+namespace Host {
+
+// 文件系统根目录：此后挂载的 /spiffs、/model 等映射到 root 下的同名子目录
+// （fopen、std::ifstream、stat、rename 等经符号插桩重定向）。要在挂载前调用
+void SetDataRoot(const std::string& root);
+const std::string& GetDataRoot();
+
+// esp_wifi_sta_get_ap_info 报告的信号强度，0 表示未连接
+void SetWifiRssi(int rssi);
+
+} // namespace Host
+} // namespace EvoSpark
+
+#endif // HOST_SHIM_H
@@ -0,0 +1,21 @@
+#ifndef HOST_LWIP_NETDB_H
+#define HOST_LWIP_NETDB_H
+
+// 主机替身：lwip 的解析接口转给系统 getaddrinfo。链接时同设备一样加
+// -Wl,--wrap=lwip_getaddrinfo，HTTP 客户端的解析经过 DnsCache
+
+#include <netdb.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lwip_getaddrinfo(const char* nodename, const char* servname,
+                     const struct addrinfo* hints, struct addrinfo** res);
+void lwip_freeaddrinfo(struct addrinfo* ai);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_LWIP_NETDB_H
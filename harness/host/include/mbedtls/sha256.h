@@ -0,0 +1,18 @@
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+// 主机替身：一次性 SHA-256 / SHA-224（OpenSSL 实现）
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char* output, int is224);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MBEDTLS_SHA256_H
@@ -0,0 +1,10 @@
+#ifndef HOST_OPUS_H
+#define HOST_OPUS_H
+
+// 主机替身：只有 opus_codec.h 用到的类型（实时语音通道不在主机上编译，
+// 见 host/src/voice_off.cc）
+
+typedef struct OpusEncoder OpusEncoder;
+typedef struct OpusDecoder OpusDecoder;
+
+#endif // HOST_OPUS_H
@@ -0,0 +1,111 @@
+#ifndef HOST_ROM_MINIZ_H
+#define HOST_ROM_MINIZ_H
+
+// 主机替身：ROM 里 miniz 的 tdefl / tinfl 接口，在 zlib 的原始 deflate 流
+// 上实现
+//
+// 状态结构由调用方分配（gzip_codec 用 heap_caps_malloc，内容未初始化）：
+// 用 magic 判断里面是否已有 zlib 状态，再次 init 时复用而不是重新分配。
+// zlib 在流结束处不多读输入，tinfl 的位缓冲区（m_num_bits / m_bit_buf）
+// 总是空的。
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+typedef int mz_bool;
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+typedef uint64_t mz_uint64;
+
+#define MZ_FALSE 0
+#define MZ_TRUE 1
+
+// ==================== tdefl ====================
+
+typedef mz_bool (*tdefl_put_buf_func_ptr)(const void* buf, int len, void* user);
+
+enum {
+    TDEFL_HUFFMAN_ONLY = 0,
+    TDEFL_DEFAULT_MAX_PROBES = 128,
+    TDEFL_MAX_PROBES_MASK = 0xFFF,
+};
+
+enum {
+    TDEFL_WRITE_ZLIB_HEADER = 0x01000,
+    TDEFL_COMPUTE_ADLER32 = 0x02000,
+    TDEFL_GREEDY_PARSING_FLAG = 0x04000,
+};
+
+typedef enum {
+    TDEFL_STATUS_BAD_PARAM = -2,
+    TDEFL_STATUS_PUT_BUF_FAILED = -1,
+    TDEFL_STATUS_OKAY = 0,
+    TDEFL_STATUS_DONE = 1,
+} tdefl_status;
+
+typedef enum {
+    TDEFL_NO_FLUSH = 0,
+    TDEFL_SYNC_FLUSH = 2,
+    TDEFL_FULL_FLUSH = 3,
+    TDEFL_FINISH = 4,
+} tdefl_flush;
+
+typedef struct {
+    z_stream m_stream;
+    mz_uint64 m_magic;
+    tdefl_put_buf_func_ptr m_put_buf;
+    void* m_put_buf_user;
+} tdefl_compressor;
+
+// ==================== tinfl ====================
+
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8,
+};
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+struct tinfl_decompressor_tag {
+    z_stream m_stream;
+    mz_uint64 m_magic;
+    mz_bool m_done;
+    mz_uint32 m_num_bits;
+    mz_uint64 m_bit_buf;
+};
+typedef struct tinfl_decompressor_tag tinfl_decompressor;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+tdefl_status tdefl_init(tdefl_compressor* d, tdefl_put_buf_func_ptr put_buf_func,
+                        void* put_buf_user, int flags);
+tdefl_status tdefl_compress_buffer(tdefl_compressor* d, const void* in_buf, size_t in_buf_size,
+                                   tdefl_flush flush);
+
+void tinfl_init_host(tinfl_decompressor* r);
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* in_buf_next,
+                              size_t* in_buf_size, mz_uint8* out_buf_start,
+                              mz_uint8* out_buf_next, size_t* out_buf_size,
+                              const mz_uint32 decomp_flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define tinfl_init(r) tinfl_init_host(r)
+
+#endif // HOST_ROM_MINIZ_H
@@ -0,0 +1,199 @@
+#include "cJSON.h"
+#include "json_codec.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <vector>
+
+// cJSON 只读子集：用固件的 JsonReader 扫描，在回调里建 cJSON 节点树
+
+using namespace EvoSpark;
+
+namespace {
+
+char* CopyString(const char* value, size_t length) {
+    char* copy = static_cast<char*>(malloc(length + 1));
+    if (copy) {
+        memcpy(copy, value, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+class TreeBuilder : public JsonHandler {
+public:
+    cJSON* root = nullptr;
+
+    bool OnNull() override { return Add(cJSON_NULL) != nullptr; }
+
+    bool OnBool(bool value) override {
+        cJSON* item = Add(value ? cJSON_True : cJSON_False);
+        if (!item) {
+            return false;
+        }
+        item->valueint = value ? 1 : 0;
+        return true;
+    }
+
+    bool OnNumber(double value, const char* raw, size_t raw_length) override {
+        (void)raw;
+        (void)raw_length;
+        cJSON* item = Add(cJSON_Number);
+        if (!item) {
+            return false;
+        }
+        item->valuedouble = value;
+        if (value >= 2147483647.0) {
+            item->valueint = 2147483647;
+        } else if (value <= -2147483648.0) {
+            item->valueint = -2147483647 - 1;
+        } else {
+            item->valueint = static_cast<int>(value);
+        }
+        return true;
+    }
+
+    bool OnString(const char* value, size_t length) override {
+        cJSON* item = Add(cJSON_String);
+        if (!item) {
+            return false;
+        }
+        item->valuestring = CopyString(value, length);
+        return item->valuestring != nullptr;
+    }
+
+    bool OnKey(const char* key, size_t length) override {
+        free(pending_key_);
+        pending_key_ = CopyString(key, length);
+        return pending_key_ != nullptr;
+    }
+
+    bool OnBeginObject() override { return Open(cJSON_Object); }
+    bool OnEndObject() override { return Close(); }
+    bool OnBeginArray() override { return Open(cJSON_Array); }
+    bool OnEndArray() override { return Close(); }
+
+    ~TreeBuilder() override { free(pending_key_); }
+
+private:
+    struct Frame {
+        cJSON* container;
+        cJSON* last;
+    };
+
+    std::vector<Frame> stack_;
+    char* pending_key_ = nullptr;
+
+    cJSON* Add(int type) {
+        cJSON* item = static_cast<cJSON*>(calloc(1, sizeof(cJSON)));
+        if (!item) {
+            return nullptr;
+        }
+        item->type = type;
+        if (stack_.empty()) {
+            root = item;
+            return item;
+        }
+        Frame& frame = stack_.back();
+        if (frame.container->type == cJSON_Object) {
+            item->string = pending_key_;
+            pending_key_ = nullptr;
+        }
+        if (frame.last) {
+            frame.last->next = item;
+            item->prev = frame.last;
+        } else {
+            frame.container->child = item;
+        }
+        frame.last = item;
+        return item;
+    }
+
+    bool Open(int type) {
+        cJSON* item = Add(type);
+        if (!item) {
+            return false;
+        }
+        stack_.push_back({item, nullptr});
+        return true;
+    }
+
+    bool Close() {
+        stack_.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+extern "C" {
+
+cJSON* cJSON_ParseWithLength(const char* value, size_t buffer_length) {
+    if (!value) {
+        return nullptr;
+    }
+    TreeBuilder builder;
+    JsonReader reader;
+    if (reader.Parse(value, buffer_length, builder) != JsonParseError::NONE) {
+        cJSON_Delete(builder.root);
+        return nullptr;
+    }
+    return builder.root;
+}
+
+cJSON* cJSON_Parse(const char* value) {
+    return value ? cJSON_ParseWithLength(value, strlen(value)) : nullptr;
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string) {
+    if (!object || !string || object->type != cJSON_Object) {
+        return nullptr;
+    }
+    for (cJSON* child = object->child; child; child = child->next) {
+        if (child->string && strcasecmp(child->string, string) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index) {
+    if (!array || index < 0) {
+        return nullptr;
+    }
+    cJSON* child = array->child;
+    while (child && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+int cJSON_GetArraySize(const cJSON* array) {
+    int size = 0;
+    for (cJSON* child = array ? array->child : nullptr; child; child = child->next) {
+        size++;
+    }
+    return size;
+}
+
+cJSON_bool cJSON_IsFalse(const cJSON* item) { return item && item->type == cJSON_False; }
+cJSON_bool cJSON_IsTrue(const cJSON* item) { return item && item->type == cJSON_True; }
+cJSON_bool cJSON_IsBool(const cJSON* item) { return item && (item->type & (cJSON_True | cJSON_False)); }
+cJSON_bool cJSON_IsNull(const cJSON* item) { return item && item->type == cJSON_NULL; }
+cJSON_bool cJSON_IsNumber(const cJSON* item) { return item && item->type == cJSON_Number; }
+cJSON_bool cJSON_IsString(const cJSON* item) { return item && item->type == cJSON_String; }
+cJSON_bool cJSON_IsArray(const cJSON* item) { return item && item->type == cJSON_Array; }
+cJSON_bool cJSON_IsObject(const cJSON* item) { return item && item->type == cJSON_Object; }
+
+} // extern "C"
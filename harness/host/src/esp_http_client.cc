@@ -0,0 +1,649 @@
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "lwip/netdb.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char* TAG = "HTTP_CLIENT";
+
+namespace {
+
+enum class BodyFraming {
+    LENGTH,         // Content-Length
+    CHUNKED,
+    CLOSE,          // 读到连接关闭为止
+};
+
+enum class ExchangeState {
+    IDLE,           // 连接空闲（或未连接），可以发下一个请求
+    REQUEST_SENT,   // 请求头已发出，正在写请求体或等响应头
+    BODY,           // 正在读响应体
+    DONE,           // 响应体读完
+};
+
+struct Header {
+    std::string key;
+    std::string value;
+};
+
+} // namespace
+
+struct esp_http_client {
+    // 请求
+    std::string url;
+    std::string scheme;
+    std::string host;
+    int port = 80;
+    std::string path;
+    esp_http_client_method_t method = HTTP_METHOD_GET;
+    int timeout_ms = 5000;
+    int buffer_size = 512;
+    http_event_handle_cb event_handler = nullptr;
+    void* user_data = nullptr;
+    std::vector<Header> headers;
+    const char* post_data = nullptr;
+    int post_len = 0;
+
+    // 连接
+    int fd = -1;
+    std::string conn_host;
+    int conn_port = 0;
+    std::atomic<bool> cancelled{false};
+    std::string rbuf;               // 已收到、还没解析的字节
+    size_t rpos = 0;
+
+    // 响应
+    ExchangeState state = ExchangeState::IDLE;
+    int status = 0;
+    int64_t content_length = -1;
+    BodyFraming framing = BodyFraming::CLOSE;
+    bool keep_alive = true;
+    int64_t remaining = 0;          // LENGTH：剩余字节；CHUNKED：当前块剩余字节
+    bool chunk_crlf = false;        // 上一块的数据读完，还差块尾的 CRLF
+    bool complete = false;
+};
+
+namespace {
+
+void Dispatch(esp_http_client* client, esp_http_client_event_id_t id, void* data = nullptr,
+              int data_len = 0, char* key = nullptr, char* value = nullptr) {
+    if (!client->event_handler) {
+        return;
+    }
+    esp_http_client_event_t evt = {};
+    evt.event_id = id;
+    evt.client = client;
+    evt.data = data;
+    evt.data_len = data_len;
+    evt.user_data = client->user_data;
+    evt.header_key = key;
+    evt.header_value = value;
+    client->event_handler(&evt);
+}
+
+bool ParseUrl(esp_http_client* client, const char* url) {
+    std::string u = url ? url : "";
+    size_t scheme_end = u.find("://");
+    if (scheme_end == std::string::npos) {
+        return false;
+    }
+    std::string scheme = u.substr(0, scheme_end);
+    size_t host_start = scheme_end + 3;
+    size_t path_start = u.find('/', host_start);
+    std::string authority = u.substr(host_start, path_start == std::string::npos
+                                                     ? std::string::npos : path_start - host_start);
+    int port = strcasecmp(scheme.c_str(), "https") == 0 ? 443 : 80;
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+        port = atoi(authority.c_str() + colon + 1);
+        authority.resize(colon);
+    }
+    if (authority.empty() || port <= 0) {
+        return false;
+    }
+
+    client->url = u;
+    client->scheme = scheme;
+    client->host = authority;
+    client->port = port;
+    client->path = path_start == std::string::npos ? "/" : u.substr(path_start);
+    return true;
+}
+
+void CloseSocket(esp_http_client* client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+        Dispatch(client, HTTP_EVENT_DISCONNECTED);
+    }
+    client->rbuf.clear();
+    client->rpos = 0;
+    client->state = ExchangeState::IDLE;
+}
+
+esp_err_t Connect(esp_http_client* client) {
+    if (strcasecmp(client->scheme.c_str(), "http") != 0) {
+        ESP_LOGE(TAG, "Only http:// is supported on the host (%s)", client->url.c_str());
+        return ESP_ERR_HTTP_INVALID_TRANSPORT;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string port = std::to_string(client->port);
+    if (lwip_getaddrinfo(client->host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        ESP_LOGE(TAG, "DNS lookup failed for %s", client->host.c_str());
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        // 非阻塞连接，按 timeout_ms 等待
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret != 0 && errno == EINPROGRESS) {
+            pollfd pfd = {fd, POLLOUT, 0};
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (poll(&pfd, 1, client->timeout_ms) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                ret = 0;
+            }
+        }
+        if (ret != 0) {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        fcntl(fd, F_SETFL, flags);
+    }
+    lwip_freeaddrinfo(res);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Connection to %s:%d failed", client->host.c_str(), client->port);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    timeval tv;
+    tv.tv_sec = client->timeout_ms / 1000;
+    tv.tv_usec = (client->timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+
+    client->fd = fd;
+    client->conn_host = client->host;
+    client->conn_port = client->port;
+    client->rbuf.clear();
+    client->rpos = 0;
+    Dispatch(client, HTTP_EVENT_ON_CONNECTED);
+    return ESP_OK;
+}
+
+bool SendAll(esp_http_client* client, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(client->fd, data, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+// 连上（需要时）并发出请求行和请求头；body 非空时一起发出，省一次小包
+esp_err_t SendRequest(esp_http_client* client, int64_t content_length, const char* body, int body_len) {
+    client->cancelled = false;
+    if (client->fd >= 0 && (client->state == ExchangeState::REQUEST_SENT ||
+                            client->state == ExchangeState::BODY)) {
+        // 上一次交换没有读完，连接上的数据对不上了
+        CloseSocket(client);
+    }
+    if (client->fd >= 0 && (client->conn_host != client->host || client->conn_port != client->port)) {
+        CloseSocket(client);
+    }
+    if (client->fd < 0) {
+        esp_err_t err = Connect(client);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    static const char* const METHODS[] = {"GET", "POST", "PUT", "PATCH", "DELETE", "HEAD"};
+    std::string request;
+    request.reserve(512 + (body ? body_len : 0));
+    request += METHODS[client->method];
+    request += ' ';
+    request += client->path;
+    request += " HTTP/1.1\r\nHost: ";
+    request += client->host;
+    if (client->port != 80) {
+        request += ':';
+        request += std::to_string(client->port);
+    }
+    request += "\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n";
+    if (content_length >= 0) {
+        request += "Content-Length: ";
+        request += std::to_string(content_length);
+        request += "\r\n";
+    }
+    for (const Header& header : client->headers) {
+        request += header.key;
+        request += ": ";
+        request += header.value;
+        request += "\r\n";
+    }
+    request += "\r\n";
+    if (body && body_len > 0) {
+        request.append(body, body_len);
+    }
+
+    client->state = ExchangeState::REQUEST_SENT;
+    client->status = 0;
+    client->complete = false;
+    if (!SendAll(client, request.data(), request.size())) {
+        CloseSocket(client);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    Dispatch(client, HTTP_EVENT_HEADERS_SENT);
+    return ESP_OK;
+}
+
+// 再收一些数据到 rbuf；返回收到的字节数，对端关闭为 0，出错为 -1
+ssize_t Fill(esp_http_client* client) {
+    if (client->rpos > 0 && client->rpos == client->rbuf.size()) {
+        client->rbuf.clear();
+        client->rpos = 0;
+    }
+    char buf[4096];
+    ssize_t n;
+    do {
+        n = recv(client->fd, buf, sizeof(buf), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        client->rbuf.append(buf, n);
+    }
+    return client->cancelled ? -1 : n;
+}
+
+// 从 rbuf 取一行（不含 CRLF），数据不够时继续收
+bool ReadLine(esp_http_client* client, std::string& line) {
+    while (true) {
+        size_t end = client->rbuf.find("\r\n", client->rpos);
+        if (end != std::string::npos) {
+            line.assign(client->rbuf, client->rpos, end - client->rpos);
+            client->rpos = end + 2;
+            return true;
+        }
+        if (client->rbuf.size() - client->rpos > 16 * 1024 || Fill(client) <= 0) {
+            return false;
+        }
+    }
+}
+
+bool ReadHeaders(esp_http_client* client) {
+    std::string line;
+    // 跳过 1xx 临时响应
+    do {
+        if (!ReadLine(client, line) || line.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        size_t sp = line.find(' ');
+        client->status = sp == std::string::npos ? 0 : atoi(line.c_str() + sp + 1);
+        bool informational = client->status >= 100 && client->status < 200;
+        client->content_length = -1;
+        client->framing = BodyFraming::CLOSE;
+        client->keep_alive = line.compare(0, 8, "HTTP/1.0") != 0;
+        while (true) {
+            if (!ReadLine(client, line)) {
+                return false;
+            }
+            if (line.empty()) {
+                break;
+            }
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, colon);
+            size_t value_start = line.find_first_not_of(" \t", colon + 1);
+            std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+                value.pop_back();
+            }
+            if (strcasecmp(key.c_str(), "Content-Length") == 0) {
+                client->content_length = atoll(value.c_str());
+                if (client->framing != BodyFraming::CHUNKED) {
+                    client->framing = BodyFraming::LENGTH;
+                }
+            } else if (strcasecmp(key.c_str(), "Transfer-Encoding") == 0 &&
+                       strcasestr(value.c_str(), "chunked") != nullptr) {
+                client->framing = BodyFraming::CHUNKED;
+            } else if (strcasecmp(key.c_str(), "Connection") == 0) {
+                if (strcasecmp(value.c_str(), "close") == 0) {
+                    client->keep_alive = false;
+                } else if (strcasecmp(value.c_str(), "keep-alive") == 0) {
+                    client->keep_alive = true;
+                }
+            }
+            if (!informational) {
+                Dispatch(client, HTTP_EVENT_ON_HEADER, nullptr, 0, &key[0], &value[0]);
+            }
+        }
+        if (!informational) {
+            break;
+        }
+    } while (true);
+
+    bool no_body = client->method == HTTP_METHOD_HEAD || client->status == 204 || client->status == 304;
+    if (no_body || (client->framing == BodyFraming::LENGTH && client->content_length == 0)) {
+        client->framing = BodyFraming::LENGTH;
+        client->content_length = 0;
+        client->remaining = 0;
+        client->complete = true;
+    } else {
+        client->remaining = client->framing == BodyFraming::LENGTH ? client->content_length : 0;
+        client->chunk_crlf = false;
+    }
+    if (client->framing == BodyFraming::CLOSE) {
+        client->keep_alive = false;
+    }
+    client->state = client->complete ? ExchangeState::DONE : ExchangeState::BODY;
+    return true;
+}
+
+// 从 rbuf（不够时从套接字）取最多 max 字节原始数据
+ssize_t TakeRaw(esp_http_client* client, char* out, size_t max) {
+    if (client->rpos == client->rbuf.size()) {
+        ssize_t n = Fill(client);
+        if (n <= 0) {
+            return n;
+        }
+    }
+    size_t n = std::min(max, client->rbuf.size() - client->rpos);
+    memcpy(out, client->rbuf.data() + client->rpos, n);
+    client->rpos += n;
+    return static_cast<ssize_t>(n);
+}
+
+// 读一段响应体（已去掉 chunked 分块），发 HTTP_EVENT_ON_DATA。
+// 返回字节数，读完为 0，出错为 -1
+int ReadBody(esp_http_client* client, char* out, int max) {
+    if (client->complete) {
+        return 0;
+    }
+    ssize_t n = 0;
+    switch (client->framing) {
+        case BodyFraming::LENGTH:
+            n = TakeRaw(client, out, static_cast<size_t>(std::min<int64_t>(max, client->remaining)));
+            if (n <= 0) {
+                return -1;
+            }
+            client->remaining -= n;
+            client->complete = client->remaining == 0;
+            break;
+
+        case BodyFraming::CHUNKED: {
+            std::string line;
+            if (client->chunk_crlf) {
+                if (!ReadLine(client, line)) {
+                    return -1;
+                }
+                client->chunk_crlf = false;
+            }
+            if (client->remaining == 0) {
+                if (!ReadLine(client, line)) {
+                    return -1;
+                }
+                client->remaining = strtoll(line.c_str(), nullptr, 16);
+                if (client->remaining == 0) {
+                    // 末尾分块，之后是（通常为空的）trailer
+                    do {
+                        if (!ReadLine(client, line)) {
+                            return -1;
+                        }
+                    } while (!line.empty());
+                    client->complete = true;
+                    break;
+                }
+            }
+            n = TakeRaw(client, out, static_cast<size_t>(std::min<int64_t>(max, client->remaining)));
+            if (n <= 0) {
+                return -1;
+            }
+            client->remaining -= n;
+            client->chunk_crlf = client->remaining == 0;
+            break;
+        }
+
+        case BodyFraming::CLOSE:
+            n = TakeRaw(client, out, max);
+            if (n < 0) {
+                return -1;
+            }
+            client->complete = n == 0;
+            break;
+    }
+
+    if (client->complete) {
+        client->state = ExchangeState::DONE;
+    }
+    if (n > 0) {
+        Dispatch(client, HTTP_EVENT_ON_DATA, out, static_cast<int>(n));
+        if (client->cancelled) {
+            return -1;
+        }
+    }
+    return static_cast<int>(n);
+}
+
+// 一次交换结束：服务端要求关闭或靠关闭分界时断开，否则留给下一次请求
+void FinishExchange(esp_http_client* client) {
+    Dispatch(client, HTTP_EVENT_ON_FINISH);
+    if (!client->keep_alive) {
+        CloseSocket(client);
+    } else {
+        client->state = ExchangeState::IDLE;
+    }
+}
+
+} // namespace
+
+extern "C" esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    esp_http_client* client = new esp_http_client();
+    if (!ParseUrl(client, config->url)) {
+        ESP_LOGE(TAG, "Invalid URL: %s", config->url ? config->url : "(null)");
+        delete client;
+        return nullptr;
+    }
+    client->method = config->method;
+    if (config->timeout_ms > 0) {
+        client->timeout_ms = config->timeout_ms;
+    }
+    if (config->buffer_size > 0) {
+        client->buffer_size = config->buffer_size;
+    }
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    return client;
+}
+
+extern "C" esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char* url) {
+    return ParseUrl(client, url) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+extern "C" esp_err_t esp_http_client_set_method(esp_http_client_handle_t client,
+                                                esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key,
+                                                const char* value) {
+    for (Header& header : client->headers) {
+        if (strcasecmp(header.key.c_str(), key) == 0) {
+            header.value = value;
+            return ESP_OK;
+        }
+    }
+    client->headers.push_back(Header{key, value});
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char* key) {
+    auto& headers = client->headers;
+    headers.erase(std::remove_if(headers.begin(), headers.end(),
+                                 [key](const Header& h) { return strcasecmp(h.key.c_str(), key) == 0; }),
+                  headers.end());
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char* data,
+                                                    int len) {
+    // 同设备上的实现：只记指针，不复制，perform 结束前调用方保证有效
+    client->post_data = data;
+    client->post_len = data ? len : 0;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms) {
+    client->timeout_ms = timeout_ms;
+    if (client->fd >= 0) {
+        timeval tv;
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    bool has_body = client->method == HTTP_METHOD_POST || client->method == HTTP_METHOD_PUT ||
+                    client->method == HTTP_METHOD_PATCH;
+    esp_err_t err = SendRequest(client, has_body ? client->post_len : -1,
+                                client->post_data, client->post_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!ReadHeaders(client)) {
+        CloseSocket(client);
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+
+    std::vector<char> buffer(client->buffer_size);
+    int n;
+    while ((n = ReadBody(client, buffer.data(), client->buffer_size)) > 0) {
+    }
+    if (n < 0) {
+        if (client->cancelled) {
+            ESP_LOGD(TAG, "Request cancelled");
+        }
+        CloseSocket(client);
+        return ESP_FAIL;
+    }
+    FinishExchange(client);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    return SendRequest(client, write_len, nullptr, 0);
+}
+
+extern "C" int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len) {
+    if (client->fd < 0 || client->state != ExchangeState::REQUEST_SENT) {
+        return -1;
+    }
+    return SendAll(client, buffer, len) ? len : -1;
+}
+
+extern "C" int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    if (client->fd < 0 || client->state != ExchangeState::REQUEST_SENT) {
+        return ESP_FAIL;
+    }
+    if (!ReadHeaders(client)) {
+        CloseSocket(client);
+        return ESP_FAIL;
+    }
+    // chunked（长度未知）时同设备上一样返回 0
+    return client->framing == BodyFraming::LENGTH ? client->content_length : 0;
+}
+
+extern "C" bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) {
+    return client->framing == BodyFraming::CHUNKED;
+}
+
+extern "C" int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len) {
+    // 读完后交换已结束（连接可能已回到空闲或被关闭），之后的 read 都返回 0
+    if (client->complete || client->state == ExchangeState::DONE) {
+        return 0;
+    }
+    if (client->fd < 0 || client->state != ExchangeState::BODY) {
+        return -1;
+    }
+    int n = ReadBody(client, buffer, len);
+    if (n < 0) {
+        CloseSocket(client);
+    } else if (client->complete) {
+        FinishExchange(client);
+    }
+    return n;
+}
+
+extern "C" int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return client->status;
+}
+
+extern "C" int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+    return client->content_length;
+}
+
+extern "C" bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+    return client->complete;
+}
+
+extern "C" esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    CloseSocket(client);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_cancel_request(esp_http_client_handle_t client) {
+    // 只关传输方向，套接字由正在读的一方在返回错误后关闭
+    client->cancelled = true;
+    if (client->fd >= 0) {
+        shutdown(client->fd, SHUT_RDWR);
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    CloseSocket(client);
+    delete client;
+    return ESP_OK;
+}
@@ -0,0 +1,63 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+std::atomic<int> g_level{ESP_LOG_INFO};
+
+} // namespace
+
+extern "C" void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    (void)tag;
+    g_level = level;
+}
+
+extern "C" void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > g_level.load(std::memory_order_relaxed) || level == ESP_LOG_NONE) {
+        return;
+    }
+    static const char letters[] = "NEWIDV";
+
+    // 整行先拼好再一次写出，多个任务同时打日志时不会交错
+    char line[1024];
+    int n = snprintf(line, sizeof(line), "%c (%lld) %s: ", letters[level],
+                     static_cast<long long>(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    if (n >= 0 && n < static_cast<int>(sizeof(line))) {
+        n += vsnprintf(line + n, sizeof(line) - n, format, args);
+    }
+    va_end(args);
+    if (n >= static_cast<int>(sizeof(line)) - 1) {
+        n = sizeof(line) - 2;
+    }
+    line[n] = '\n';
+    fwrite(line, 1, n + 1, stderr);
+}
+
+extern "C" const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_WIFI_NOT_CONNECT: return "ESP_ERR_WIFI_NOT_CONNECT";
+        case ESP_ERR_HTTP_MAX_REDIRECT: return "ESP_ERR_HTTP_MAX_REDIRECT";
+        case ESP_ERR_HTTP_CONNECT: return "ESP_ERR_HTTP_CONNECT";
+        case ESP_ERR_HTTP_WRITE_DATA: return "ESP_ERR_HTTP_WRITE_DATA";
+        case ESP_ERR_HTTP_FETCH_HEADER: return "ESP_ERR_HTTP_FETCH_HEADER";
+        case ESP_ERR_HTTP_INVALID_TRANSPORT: return "ESP_ERR_HTTP_INVALID_TRANSPORT";
+        case ESP_ERR_HTTP_CONNECTING: return "ESP_ERR_HTTP_CONNECTING";
+        case ESP_ERR_HTTP_EAGAIN: return "ESP_ERR_HTTP_EAGAIN";
+        case ESP_ERR_HTTP_CONNECTION_CLOSED: return "ESP_ERR_HTTP_CONNECTION_CLOSED";
+        default: return "UNKNOWN ERROR";
+    }
+}
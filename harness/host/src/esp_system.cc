@@ -0,0 +1,124 @@
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_crt_bundle.h"
+#include "esp_wifi.h"
+#include "mbedtls/sha256.h"
+#include "host_shim.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <openssl/sha.h>
+#include <zlib.h>
+
+namespace {
+
+// 启动后的典型空闲量（S3 N16R8，WiFi 已连接）
+constexpr size_t INTERNAL_FREE_BYTES = 180 * 1024;
+constexpr size_t PSRAM_FREE_BYTES = 7 * 1024 * 1024;
+
+std::atomic<int> g_rssi{-55};
+
+std::mutex g_random_mutex;
+
+std::mt19937& Generator() {
+    static std::mt19937 generator{std::random_device{}()};
+    return generator;
+}
+
+} // namespace
+
+namespace EvoSpark {
+namespace Host {
+
+void SetWifiRssi(int rssi) {
+    g_rssi = rssi;
+}
+
+} // namespace Host
+} // namespace EvoSpark
+
+// ==================== heap_caps ====================
+
+extern "C" void* heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+extern "C" void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    (void)caps;
+    return calloc(n, size);
+}
+
+extern "C" void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+    (void)caps;
+    return realloc(ptr, size);
+}
+
+extern "C" void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+extern "C" size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? PSRAM_FREE_BYTES : INTERNAL_FREE_BYTES;
+}
+
+extern "C" size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+extern "C" size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps) / 2;
+}
+
+// ==================== 随机数、CRC、SHA-256 ====================
+
+extern "C" uint32_t esp_random(void) {
+    std::lock_guard<std::mutex> lock(g_random_mutex);
+    return static_cast<uint32_t>(Generator()());
+}
+
+extern "C" void esp_fill_random(void* buf, size_t len) {
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        uint32_t word = esp_random();
+        size_t n = len < sizeof(word) ? len : sizeof(word);
+        memcpy(p, &word, n);
+        p += n;
+        len -= n;
+    }
+}
+
+extern "C" uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    return static_cast<uint32_t>(crc32(crc, buf, len));
+}
+
+extern "C" int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char* output, int is224) {
+    if (is224) {
+        SHA224(input, ilen, output);
+    } else {
+        SHA256(input, ilen, output);
+    }
+    return 0;
+}
+
+// ==================== 证书包、WiFi ====================
+
+extern "C" esp_err_t esp_crt_bundle_attach(void* conf) {
+    (void)conf;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+extern "C" esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info) {
+    int rssi = g_rssi;
+    if (rssi == 0) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->ssid, "host", 4);
+    ap_info->primary = 6;
+    ap_info->rssi = static_cast<int8_t>(rssi);
+    return ESP_OK;
+}
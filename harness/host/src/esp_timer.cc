@@ -0,0 +1,161 @@
+#include "esp_timer.h"
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <time.h>
+
+struct esp_timer {
+    esp_timer_cb_t callback = nullptr;
+    void* arg = nullptr;
+    std::string name;
+    int64_t due_us = 0;
+    uint64_t period_us = 0;       // 0 为单次
+    bool armed = false;
+};
+
+namespace {
+
+int64_t MonotonicUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 所有定时器的回调都在这一个线程上依次执行（设备上是 esp_timer 任务）
+class TimerService {
+public:
+    static TimerService& GetInstance() {
+        // 进程退出时工作线程可能还在等待，不析构
+        static TimerService* instance = new TimerService();
+        return *instance;
+    }
+
+    esp_err_t Start(esp_timer* timer, uint64_t timeout_us, uint64_t period_us) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (timer->armed) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        timer->due_us = esp_timer_get_time() + static_cast<int64_t>(timeout_us);
+        timer->period_us = period_us;
+        timer->armed = true;
+        timers_.insert(timer);
+        if (!thread_started_) {
+            thread_started_ = true;
+            std::thread(&TimerService::Loop, this).detach();
+        }
+        cv_.notify_all();
+        return ESP_OK;
+    }
+
+    esp_err_t Stop(esp_timer* timer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!timer->armed) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        timer->armed = false;
+        timers_.erase(timer);
+        cv_.notify_all();
+        return ESP_OK;
+    }
+
+    esp_err_t Delete(esp_timer* timer) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (timer->armed) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        // 回调正在执行（且不是在回调里删自己）时等它结束
+        if (std::this_thread::get_id() != thread_id_) {
+            cv_.wait(lock, [this, timer] { return running_ != timer; });
+        }
+        timers_.erase(timer);
+        delete timer;
+        return ESP_OK;
+    }
+
+private:
+    TimerService() = default;
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        thread_id_ = std::this_thread::get_id();
+        while (true) {
+            esp_timer* next = nullptr;
+            for (esp_timer* timer : timers_) {
+                if (!next || timer->due_us < next->due_us) {
+                    next = timer;
+                }
+            }
+            if (!next) {
+                cv_.wait(lock);
+                continue;
+            }
+            int64_t wait_us = next->due_us - esp_timer_get_time();
+            if (wait_us > 0) {
+                cv_.wait_for(lock, std::chrono::microseconds(wait_us));
+                continue;
+            }
+
+            if (next->period_us > 0) {
+                next->due_us += static_cast<int64_t>(next->period_us);
+            } else {
+                next->armed = false;
+                timers_.erase(next);
+            }
+            running_ = next;
+            esp_timer_cb_t callback = next->callback;
+            void* arg = next->arg;
+            lock.unlock();
+            callback(arg);
+            lock.lock();
+            running_ = nullptr;
+            cv_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::set<esp_timer*> timers_;     // 已启动的定时器
+    esp_timer* running_ = nullptr;
+    std::thread::id thread_id_;
+    bool thread_started_ = false;
+};
+
+} // namespace
+
+extern "C" int64_t esp_timer_get_time(void) {
+    static const int64_t boot_us = MonotonicUs();
+    return MonotonicUs() - boot_us;
+}
+
+extern "C" esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    if (!args || !args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer* timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->name = args->name ? args->name : "";
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer ? TimerService::GetInstance().Start(timer, timeout_us, 0) : ESP_ERR_INVALID_ARG;
+}
+
+extern "C" esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (!timer || period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return TimerService::GetInstance().Start(timer, period_us, period_us);
+}
+
+extern "C" esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    return timer ? TimerService::GetInstance().Stop(timer) : ESP_ERR_INVALID_ARG;
+}
+
+extern "C" esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    return timer ? TimerService::GetInstance().Delete(timer) : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,129 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <pthread.h>
+
+// 任务控制块：只记名字和入口，线程结束后不回收（任务数很少）
+struct HostTask {
+    std::string name;
+    TaskFunction_t entry = nullptr;
+    void* arg = nullptr;
+};
+
+struct HostSemaphore {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool available = false;
+};
+
+namespace {
+
+thread_local HostTask* t_current = nullptr;
+
+void* TaskTrampoline(void* param) {
+    HostTask* task = static_cast<HostTask*>(param);
+    t_current = task;
+    pthread_setname_np(pthread_self(), task->name.substr(0, 15).c_str());
+    task->entry(task->arg);
+    // FreeRTOS 任务不能从入口函数返回；这里容忍，当作 vTaskDelete(nullptr)
+    return nullptr;
+}
+
+} // namespace
+
+extern "C" BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                                  void* arg, UBaseType_t priority, TaskHandle_t* created_task) {
+    (void)stack_depth;
+    (void)priority;
+    HostTask* tcb = new HostTask();
+    tcb->name = name ? name : "task";
+    tcb->entry = task;
+    tcb->arg = arg;
+    // 句柄在线程启动前交给调用方，任务里立即查询自己的句柄也能对上
+    if (created_task) {
+        *created_task = tcb;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int ret = pthread_create(&thread, &attr, TaskTrampoline, tcb);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        if (created_task) {
+            *created_task = nullptr;
+        }
+        delete tcb;
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+extern "C" BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack_depth,
+                                              void* arg, UBaseType_t priority, TaskHandle_t* created_task,
+                                              BaseType_t core_id) {
+    (void)core_id;
+    return xTaskCreate(task, name, stack_depth, arg, priority, created_task);
+}
+
+extern "C" void vTaskDelete(TaskHandle_t task) {
+    // 只支持删除自己（固件里也只有这种用法）
+    if (task == nullptr || task == t_current) {
+        pthread_exit(nullptr);
+    }
+}
+
+extern "C" void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+extern "C" TickType_t xTaskGetTickCount(void) {
+    return static_cast<TickType_t>(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+extern "C" TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    // 不是 xTaskCreate 建的线程（主线程等）第一次查询时补一个控制块
+    if (!t_current) {
+        t_current = new HostTask();
+        t_current->name = "main";
+    }
+    return t_current;
+}
+
+extern "C" SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return new HostSemaphore();
+}
+
+extern "C" BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    auto ready = [semaphore] { return semaphore->available; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        semaphore->cv.wait(lock, ready);
+    } else if (!semaphore->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait * portTICK_PERIOD_MS),
+                                       ready)) {
+        return pdFALSE;
+    }
+    semaphore->available = false;
+    return pdTRUE;
+}
+
+extern "C" BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->available) {
+        return pdFALSE;
+    }
+    semaphore->available = true;
+    semaphore->cv.notify_one();
+    return pdTRUE;
+}
+
+extern "C" void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
@@ -0,0 +1,13 @@
+#include "lwip/netdb.h"
+
+// 单独一个编译单元：--wrap 只改写未定义的引用，HTTP 客户端对
+// lwip_getaddrinfo 的调用才会先经过 DnsCache 的 __wrap_lwip_getaddrinfo
+
+extern "C" int lwip_getaddrinfo(const char* nodename, const char* servname,
+                                const struct addrinfo* hints, struct addrinfo** res) {
+    return getaddrinfo(nodename, servname, hints, res);
+}
+
+extern "C" void lwip_freeaddrinfo(struct addrinfo* ai) {
+    freeaddrinfo(ai);
+}
@@ -0,0 +1,131 @@
+#include "rom/miniz.h"
+#include <cstring>
+
+// tdefl / tinfl 在 zlib 原始 deflate 流（windowBits = -15）上的实现
+
+namespace {
+
+constexpr mz_uint64 DEFLATE_MAGIC = 0x6465666C61746531ULL;   // "deflate1"
+constexpr mz_uint64 INFLATE_MAGIC = 0x696E666C61746531ULL;   // "inflate1"
+constexpr size_t PUT_BUF_SIZE = 4096;
+
+// miniz 的探测次数大致对应 zlib 的压缩级别
+int LevelFromProbes(int flags) {
+    int probes = flags & TDEFL_MAX_PROBES_MASK;
+    if (probes <= 4) return 1;
+    if (probes <= 16) return 3;
+    if (probes <= 128) return 6;
+    return 9;
+}
+
+} // namespace
+
+extern "C" {
+
+tdefl_status tdefl_init(tdefl_compressor* d, tdefl_put_buf_func_ptr put_buf_func,
+                        void* put_buf_user, int flags) {
+    if (!d || !put_buf_func) {
+        return TDEFL_STATUS_BAD_PARAM;
+    }
+    if (d->m_magic == DEFLATE_MAGIC) {
+        deflateEnd(&d->m_stream);
+    }
+    memset(&d->m_stream, 0, sizeof(d->m_stream));
+    int level = (flags & TDEFL_MAX_PROBES_MASK) == TDEFL_HUFFMAN_ONLY ? 0 : LevelFromProbes(flags);
+    int strategy = level == 0 ? Z_HUFFMAN_ONLY : Z_DEFAULT_STRATEGY;
+    int window_bits = (flags & TDEFL_WRITE_ZLIB_HEADER) ? 15 : -15;
+    if (deflateInit2(&d->m_stream, level == 0 ? 1 : level, Z_DEFLATED, window_bits, 8, strategy) != Z_OK) {
+        d->m_magic = 0;
+        return TDEFL_STATUS_BAD_PARAM;
+    }
+    d->m_magic = DEFLATE_MAGIC;
+    d->m_put_buf = put_buf_func;
+    d->m_put_buf_user = put_buf_user;
+    return TDEFL_STATUS_OKAY;
+}
+
+tdefl_status tdefl_compress_buffer(tdefl_compressor* d, const void* in_buf, size_t in_buf_size,
+                                   tdefl_flush flush) {
+    if (!d || d->m_magic != DEFLATE_MAGIC) {
+        return TDEFL_STATUS_BAD_PARAM;
+    }
+    int z_flush = Z_NO_FLUSH;
+    if (flush == TDEFL_FINISH) {
+        z_flush = Z_FINISH;
+    } else if (flush == TDEFL_SYNC_FLUSH) {
+        z_flush = Z_SYNC_FLUSH;
+    } else if (flush == TDEFL_FULL_FLUSH) {
+        z_flush = Z_FULL_FLUSH;
+    }
+
+    z_stream& s = d->m_stream;
+    s.next_in = static_cast<Bytef*>(const_cast<void*>(in_buf));
+    s.avail_in = static_cast<uInt>(in_buf_size);
+    Bytef out[PUT_BUF_SIZE];
+    int ret;
+    do {
+        s.next_out = out;
+        s.avail_out = sizeof(out);
+        ret = deflate(&s, z_flush);
+        if (ret == Z_STREAM_ERROR) {
+            return TDEFL_STATUS_BAD_PARAM;
+        }
+        size_t produced = sizeof(out) - s.avail_out;
+        if (produced > 0 && !d->m_put_buf(out, static_cast<int>(produced), d->m_put_buf_user)) {
+            return TDEFL_STATUS_PUT_BUF_FAILED;
+        }
+    } while (s.avail_out == 0 || (z_flush == Z_FINISH && ret != Z_STREAM_END));
+
+    return ret == Z_STREAM_END ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY;
+}
+
+void tinfl_init_host(tinfl_decompressor* r) {
+    if (r->m_magic == INFLATE_MAGIC) {
+        inflateReset(&r->m_stream);
+    } else {
+        memset(&r->m_stream, 0, sizeof(r->m_stream));
+        r->m_magic = inflateInit2(&r->m_stream, -15) == Z_OK ? INFLATE_MAGIC : 0;
+    }
+    r->m_done = MZ_FALSE;
+    r->m_num_bits = 0;
+    r->m_bit_buf = 0;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* in_buf_next,
+                              size_t* in_buf_size, mz_uint8* out_buf_start,
+                              mz_uint8* out_buf_next, size_t* out_buf_size,
+                              const mz_uint32 decomp_flags) {
+    (void)out_buf_start;
+    if (!r || r->m_magic != INFLATE_MAGIC || !in_buf_size || !out_buf_size) {
+        return TINFL_STATUS_BAD_PARAM;
+    }
+    if (r->m_done) {
+        *in_buf_size = 0;
+        *out_buf_size = 0;
+        return TINFL_STATUS_DONE;
+    }
+
+    z_stream& s = r->m_stream;
+    s.next_in = const_cast<Bytef*>(in_buf_next);
+    s.avail_in = static_cast<uInt>(*in_buf_size);
+    s.next_out = out_buf_next;
+    s.avail_out = static_cast<uInt>(*out_buf_size);
+    int ret = inflate(&s, Z_NO_FLUSH);
+    *in_buf_size -= s.avail_in;
+    *out_buf_size -= s.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        r->m_done = MZ_TRUE;
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    if (s.avail_out == 0) {
+        return TINFL_STATUS_HAS_MORE_OUTPUT;
+    }
+    return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT
+                                                      : TINFL_STATUS_FAILED;
+}
+
+} // extern "C"
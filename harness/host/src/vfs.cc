@@ -0,0 +1,289 @@
+#include "esp_spiffs.h"
+#include "esp_vfs_fat.h"
+#include "esp_log.h"
+#include "host_shim.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 挂载点重定向
+//
+// 固件用绝对路径访问挂载点（/spiffs/memory.json、/model/archive/...），
+// 主机上把挂载过的前缀映射到数据根目录下的同名子目录。重定向靠符号
+// 插桩：可执行文件里定义的 fopen、stat 等同名函数优先于 libc 的版本，
+// libstdc++ 内部（std::ifstream 打开文件）的调用同样会到这里，改写路径
+// 后经 dlsym(RTLD_NEXT) 交给 libc。没挂载的路径原样放过。
+
+static const char* TAG = "vfs";
+
+namespace {
+
+constexpr int MAX_MOUNTS = 8;
+constexpr size_t SPIFFS_TOTAL_BYTES = 1024 * 1024;      // partitions.csv 的 spiffs 分区
+constexpr uint64_t FAT_TOTAL_BYTES = 4 * 1024 * 1024;   // partitions.csv 的 model 分区
+
+char g_mounts[MAX_MOUNTS][32];
+std::atomic<int> g_mount_count{0};
+std::string* g_root = nullptr;
+
+bool Mount(const char* base_path) {
+    int count = g_mount_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(g_mounts[i], base_path) == 0) {
+            return true;
+        }
+    }
+    if (!g_root || count == MAX_MOUNTS || strlen(base_path) >= sizeof(g_mounts[0]) ||
+        base_path[0] != '/') {
+        return false;
+    }
+    std::string dir = *g_root + base_path;
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    strcpy(g_mounts[count], base_path);
+    g_mount_count.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+// 挂载过的路径返回改写后的路径（存在 out 里），否则原样返回
+const char* Redirect(const char* path, std::string& out) {
+    int count = g_mount_count.load(std::memory_order_acquire);
+    if (!path || path[0] != '/' || count == 0) {
+        return path;
+    }
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(g_mounts[i]);
+        if (strncmp(path, g_mounts[i], len) == 0 && (path[len] == '/' || path[len] == '\0')) {
+            out = *g_root;
+            out += path;
+            return out.c_str();
+        }
+    }
+    return path;
+}
+
+template <typename Fn>
+Fn Real(const char* name) {
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+uint64_t g_du_total = 0;
+
+int SumFile(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)path;
+    (void)ftw;
+    if (type == FTW_F) {
+        g_du_total += st->st_size;
+    }
+    return 0;
+}
+
+// 目录下所有文件的总字节数（只在查询分区用量时调用）
+uint64_t DirectoryBytes(const char* base_path) {
+    static std::atomic<bool> busy{false};
+    std::string dir = *g_root + base_path;
+    while (busy.exchange(true)) {
+    }
+    g_du_total = 0;
+    nftw(dir.c_str(), SumFile, 8, FTW_PHYS);
+    uint64_t total = g_du_total;
+    busy = false;
+    return total;
+}
+
+} // namespace
+
+namespace EvoSpark {
+namespace Host {
+
+void SetDataRoot(const std::string& root) {
+    if (!g_root) {
+        g_root = new std::string();
+    }
+    *g_root = root;
+    while (!g_root->empty() && g_root->back() == '/') {
+        g_root->pop_back();
+    }
+}
+
+const std::string& GetDataRoot() {
+    static const std::string empty;
+    return g_root ? *g_root : empty;
+}
+
+} // namespace Host
+} // namespace EvoSpark
+
+// ==================== 挂载 ====================
+
+extern "C" esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t* conf) {
+    if (!conf || !conf->base_path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!Mount(conf->base_path)) {
+        ESP_LOGE(TAG, "Cannot map %s (data root not set?)", conf->base_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_vfs_spiffs_unregister(const char* partition_label) {
+    (void)partition_label;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_spiffs_info(const char* partition_label, size_t* total_bytes, size_t* used_bytes) {
+    (void)partition_label;
+    if (!g_root) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *total_bytes = SPIFFS_TOTAL_BYTES;
+    *used_bytes = static_cast<size_t>(DirectoryBytes("/spiffs"));
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_vfs_fat_spiflash_mount_rw_wl(const char* base_path, const char* partition_label,
+                                                      const esp_vfs_fat_mount_config_t* mount_config,
+                                                      wl_handle_t* wl_handle) {
+    (void)partition_label;
+    (void)mount_config;
+    if (!Mount(base_path)) {
+        ESP_LOGE(TAG, "Cannot map %s (data root not set?)", base_path);
+        return ESP_FAIL;
+    }
+    *wl_handle = 0;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_vfs_fat_spiflash_unmount_rw_wl(const char* base_path, wl_handle_t wl_handle) {
+    (void)base_path;
+    (void)wl_handle;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_vfs_fat_info(const char* base_path, uint64_t* out_total_bytes,
+                                      uint64_t* out_free_bytes) {
+    if (!g_root) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint64_t used = DirectoryBytes(base_path);
+    *out_total_bytes = FAT_TOTAL_BYTES;
+    *out_free_bytes = used < FAT_TOTAL_BYTES ? FAT_TOTAL_BYTES - used : 0;
+    return ESP_OK;
+}
+
+// ==================== 路径重定向（符号插桩） ====================
+
+extern "C" FILE* fopen(const char* path, const char* mode) {
+    static auto real = Real<FILE* (*)(const char*, const char*)>("fopen");
+    std::string buf;
+    return real(Redirect(path, buf), mode);
+}
+
+extern "C" FILE* fopen64(const char* path, const char* mode) {
+    static auto real = Real<FILE* (*)(const char*, const char*)>("fopen64");
+    std::string buf;
+    return real(Redirect(path, buf), mode);
+}
+
+extern "C" int open(const char* path, int flags, ...) {
+    static auto real = Real<int (*)(const char*, int, ...)>("open");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    std::string buf;
+    return real(Redirect(path, buf), flags, mode);
+}
+
+extern "C" int open64(const char* path, int flags, ...) {
+    static auto real = Real<int (*)(const char*, int, ...)>("open64");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    std::string buf;
+    return real(Redirect(path, buf), flags, mode);
+}
+
+extern "C" DIR* opendir(const char* path) {
+    static auto real = Real<DIR* (*)(const char*)>("opendir");
+    std::string buf;
+    return real(Redirect(path, buf));
+}
+
+extern "C" int stat(const char* path, struct stat* st) noexcept {
+    static auto real = Real<int (*)(const char*, struct stat*)>("stat");
+    std::string buf;
+    return real(Redirect(path, buf), st);
+}
+
+extern "C" int stat64(const char* path, struct stat64* st) noexcept {
+    static auto real = Real<int (*)(const char*, struct stat64*)>("stat64");
+    std::string buf;
+    return real(Redirect(path, buf), st);
+}
+
+extern "C" int lstat(const char* path, struct stat* st) noexcept {
+    static auto real = Real<int (*)(const char*, struct stat*)>("lstat");
+    std::string buf;
+    return real(Redirect(path, buf), st);
+}
+
+extern "C" int access(const char* path, int type) noexcept {
+    static auto real = Real<int (*)(const char*, int)>("access");
+    std::string buf;
+    return real(Redirect(path, buf), type);
+}
+
+extern "C" int mkdir(const char* path, mode_t mode) noexcept {
+    static auto real = Real<int (*)(const char*, mode_t)>("mkdir");
+    std::string buf;
+    return real(Redirect(path, buf), mode);
+}
+
+extern "C" int rmdir(const char* path) noexcept {
+    static auto real = Real<int (*)(const char*)>("rmdir");
+    std::string buf;
+    return real(Redirect(path, buf));
+}
+
+extern "C" int unlink(const char* path) noexcept {
+    static auto real = Real<int (*)(const char*)>("unlink");
+    std::string buf;
+    return real(Redirect(path, buf));
+}
+
+extern "C" int remove(const char* path) noexcept {
+    static auto real = Real<int (*)(const char*)>("remove");
+    std::string buf;
+    return real(Redirect(path, buf));
+}
+
+extern "C" int rename(const char* old_path, const char* new_path) noexcept {
+    static auto real = Real<int (*)(const char*, const char*)>("rename");
+    std::string old_buf;
+    std::string new_buf;
+    return real(Redirect(old_path, old_buf), Redirect(new_path, new_buf));
+}
+
+extern "C" int truncate(const char* path, off_t length) noexcept {
+    static auto real = Real<int (*)(const char*, off_t)>("truncate");
+    std::string buf;
+    return real(Redirect(path, buf), length);
+}
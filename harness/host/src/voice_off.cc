@@ -0,0 +1,26 @@
+#include "core/voice_session.h"
+
+// 实时语音（VoiceChannel / VoiceSession / Opus）不在主机上编译：
+// SessionManager 只用到 Start / Stop，这里让语音模式始终启动失败，
+// 会话照常走文字 → LLM 的级联流程
+
+namespace EvoSpark {
+
+bool VoiceSession::Start(const Listener& listener) {
+    (void)listener;
+    return false;
+}
+
+void VoiceSession::Stop() {
+}
+
+VoiceSession::~VoiceSession() {
+}
+
+OpusVoiceEncoder::~OpusVoiceEncoder() {
+}
+
+OpusVoiceDecoder::~OpusVoiceDecoder() {
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,308 @@
+#!/usr/bin/env python3
+"""端到端延迟测试用的模拟服务端（只用标准库）
+
+两个 HTTP/1.1 keep-alive 服务，延迟、抖动和错误都可以注入：
+
+  LLM（--port）：OpenAI 兼容的 POST /v1/chat/completions
+    - "stream": true 时回 SSE（分块传输）：响应头立即发出，等 --ttft-ms 后
+      每 --token-ms 发一个 delta（--chunk-chars 个字），最后 usage 和 [DONE]
+    - 请求带 response_format 时当作记忆压缩，等 --compress-ms 后回复合法的
+      记忆 JSON（user_profile / key_events / preferences / last_session_summary）
+    - 非流式时整段回复，客户端接受 gzip 就压缩；请求体带
+      Content-Encoding: gzip 时先解压
+    - --error-rate 的请求回 500 或 429；--stall-rate 的请求在响应头之前
+      卡 --stall-ms（触发固件的对冲请求）
+    - --reset-rate 的请求收完请求体后直接 RST 断开（连接失败）；--drop-rate
+      的流式回复发到一半时 RST 断开（流中断）
+  语音（--speech-port）：
+    - POST /v1/asr?expect=<文字>：收完音频后等 --asr-ms，回 {"text": <expect>}
+    - POST /v1/tts {"text": ...}：等 --tts-ms 后按 --tts-chunk-ms 的间隔分块
+      回音频，块数与字数成正比
+    - --speech-error-rate 的请求回 503
+
+两个端口都有 GET /healthz 和 GET /stats。--jitter-ms 给每段等待加均匀抖动。
+
+用法：
+  python3 harness/mock_services.py --port 8090 --speech-port 8091 --ttft-ms 300 --jitter-ms 50
+"""
+
+import argparse
+import gzip
+import json
+import random
+import socket
+import struct
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+REPLY_SENTENCES = [
+    "好的，我明白你的意思了。",
+    "这个问题挺有意思的，我们一起想想。",
+    "我记得你之前也提到过类似的事情。",
+    "如果需要的话，我可以再详细说说。",
+    "今天辛苦了，记得早点休息！",
+    "换个角度看，也许会有新的发现。",
+    "你说得对，这确实值得试一试。",
+    "有什么想聊的随时叫我？",
+]
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.counts = {}
+
+    def add(self, key, n=1):
+        with self.lock:
+            self.counts[key] = self.counts.get(key, 0) + n
+
+    def snapshot(self):
+        with self.lock:
+            return dict(self.counts)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    args = None
+    stats = None
+
+    def log_message(self, fmt, *log_args):
+        if self.args.verbose:
+            super().log_message(fmt, *log_args)
+
+    def delay(self, ms):
+        jitter = random.uniform(-self.args.jitter_ms, self.args.jitter_ms) if self.args.jitter_ms else 0
+        time.sleep(max(ms + jitter, 0) / 1000)
+
+    def read_body(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if self.headers.get("Content-Encoding", "").lower() == "gzip":
+            body = gzip.decompress(body)
+            self.stats.add("gzip_requests")
+        return body
+
+    def send_body(self, status, body, content_type="application/json", headers=None):
+        if "gzip" in self.headers.get("Accept-Encoding", "") and len(body) >= 256:
+            body = gzip.compress(body)
+            headers = dict(headers or {}, **{"Content-Encoding": "gzip"})
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for key, value in (headers or {}).items():
+            self.send_header(key, value)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_json(self, status, message, headers=None):
+        self.send_body(status, json.dumps(message, ensure_ascii=False).encode(), headers=headers)
+
+    def reset_connection(self):
+        # SO_LINGER 0：关闭时发 RST 而不是 FIN，客户端看到的是连接被重置
+        self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+        self.close_connection = True
+
+    def begin_chunked(self, content_type):
+        self.send_response(200)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Transfer-Encoding", "chunked")
+        self.send_header("Cache-Control", "no-cache")
+        self.end_headers()
+        self.wfile.flush()
+
+    def send_chunk(self, data):
+        self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+        self.wfile.flush()
+
+    def end_chunked(self):
+        self.wfile.write(b"0\r\n\r\n")
+        self.wfile.flush()
+
+    def do_GET(self):
+        if self.path == "/healthz":
+            self.send_json(200, {"ok": True})
+        elif self.path == "/stats":
+            self.send_json(200, self.stats.snapshot())
+        else:
+            self.send_json(404, {"error": "not found"})
+
+    def do_POST(self):
+        try:
+            self.handle_post()
+        except (BrokenPipeError, ConnectionResetError):
+            # 客户端放弃了这个请求（对冲请求的另一路、结构化输出中途校验失败）
+            self.stats.add("cancelled")
+            self.close_connection = True
+
+
+class LLMHandler(Handler):
+    def handle_post(self):
+        if not self.path.endswith("/chat/completions"):
+            self.read_body()
+            self.send_json(404, {"error": {"message": "not found"}})
+            return
+        request = json.loads(self.read_body())
+        self.stats.add("requests")
+
+        if random.random() < self.args.error_rate:
+            status = random.choice([500, 429])
+            self.stats.add(f"status_{status}")
+            self.send_json(status, {"error": {"message": "injected failure", "code": status}})
+            return
+        if random.random() < self.args.stall_rate:
+            self.stats.add("stalls")
+            time.sleep(self.args.stall_ms / 1000)
+        # 比例为 0 时不取随机数，保持默认参数下的随机序列（baseline.json）不变
+        if self.args.reset_rate and random.random() < self.args.reset_rate:
+            self.stats.add("resets")
+            self.reset_connection()
+            return
+
+        messages = request.get("messages", [])
+        prompt_chars = sum(len(m.get("content", "")) if isinstance(m.get("content"), str) else 0
+                           for m in messages)
+        if "response_format" in request:
+            self.stats.add("compressions")
+            reply = self.memory_reply(messages)
+            ttft = self.args.compress_ms
+        else:
+            reply = self.chat_reply(messages)
+            ttft = self.args.ttft_ms
+        usage = {"prompt_tokens": prompt_chars // 2, "completion_tokens": len(reply),
+                 "total_tokens": prompt_chars // 2 + len(reply)}
+
+        if request.get("stream"):
+            self.stream_reply(request, reply, usage, ttft)
+            return
+        self.delay(ttft + len(reply) / self.args.chunk_chars * self.args.token_ms)
+        self.send_json(200, {
+            "id": "chatcmpl-mock",
+            "object": "chat.completion",
+            "model": request.get("model", "mock"),
+            "choices": [{"index": 0, "message": {"role": "assistant", "content": reply},
+                         "finish_reason": "stop"}],
+            "usage": usage,
+        })
+
+    def stream_reply(self, request, reply, usage, ttft):
+        self.begin_chunked("text/event-stream")
+        self.delay(ttft)
+        model = request.get("model", "mock")
+        step = self.args.chunk_chars
+        drop_at = len(reply) // 2 if self.args.drop_rate and random.random() < self.args.drop_rate else -1
+        for i in range(0, len(reply), step):
+            if i > 0:
+                self.delay(self.args.token_ms)
+            if 0 <= drop_at <= i:
+                self.stats.add("drops")
+                self.reset_connection()
+                return
+            event = {"id": "chatcmpl-mock", "object": "chat.completion.chunk", "model": model,
+                     "choices": [{"index": 0, "delta": {"content": reply[i:i + step]}, "finish_reason": None}]}
+            self.send_chunk(b"data: " + json.dumps(event, ensure_ascii=False).encode() + b"\n\n")
+        final = {"id": "chatcmpl-mock", "object": "chat.completion.chunk", "model": model,
+                 "choices": [{"index": 0, "delta": {}, "finish_reason": "stop"}], "usage": usage}
+        self.send_chunk(b"data: " + json.dumps(final, ensure_ascii=False).encode() + b"\n\n")
+        self.send_chunk(b"data: [DONE]\n\n")
+        self.end_chunked()
+
+    def chat_reply(self, messages):
+        last = next((m.get("content", "") for m in reversed(messages) if m.get("role") == "user"), "")
+        rng = random.Random(zlib.crc32(str(last).encode()))
+        reply = ""
+        while len(reply) < self.args.reply_chars:
+            reply += rng.choice(REPLY_SENTENCES)
+        return reply
+
+    def memory_reply(self, messages):
+        self.stats.add("memory_version")
+        version = self.stats.snapshot()["memory_version"]
+        return json.dumps({
+            "user_profile": "喜欢聊天、作息规律的用户",
+            "key_events": [f"第 {n} 次会话聊了日常安排" for n in range(max(1, version - 4), version + 1)],
+            "preferences": ["回答简短", "语气轻松"],
+            "last_session_summary": f"第 {version} 次会话：用户聊了日常安排，助手给了建议。",
+        }, ensure_ascii=False)
+
+
+class SpeechHandler(Handler):
+    def handle_post(self):
+        url = urlparse(self.path)
+        body = self.read_body()
+        if random.random() < self.args.speech_error_rate:
+            self.stats.add("status_503")
+            self.send_json(503, {"error": "injected failure"})
+            return
+
+        if url.path == "/v1/asr":
+            self.stats.add("asr")
+            self.stats.add("asr_audio_bytes", len(body))
+            expect = parse_qs(url.query).get("expect", [""])[0]
+            self.delay(self.args.asr_ms)
+            self.send_json(200, {"text": expect})
+        elif url.path == "/v1/tts":
+            self.stats.add("tts")
+            text = json.loads(body).get("text", "")
+            self.delay(self.args.tts_ms)
+            self.begin_chunked("audio/ogg")
+            chunks = max(1, len(text) // 4)
+            for i in range(chunks):
+                if i > 0:
+                    self.delay(self.args.tts_chunk_ms)
+                self.send_chunk(bytes(self.args.tts_chunk_bytes))
+            self.end_chunked()
+        else:
+            self.send_json(404, {"error": "not found"})
+
+
+def serve(handler_class, args, port, stats):
+    handler = type(handler_class.__name__, (handler_class,), {"args": args, "stats": stats})
+    server = ThreadingHTTPServer((args.host, port), handler)
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description="EvoSpark latency harness mock LLM / ASR / TTS")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8090, help="LLM 端口")
+    parser.add_argument("--speech-port", type=int, default=8091, help="ASR / TTS 端口")
+    parser.add_argument("--ttft-ms", type=int, default=300, help="流式回复的首 token 延迟")
+    parser.add_argument("--token-ms", type=int, default=30, help="两个 delta 的间隔")
+    parser.add_argument("--chunk-chars", type=int, default=2, help="每个 delta 的字数")
+    parser.add_argument("--reply-chars", type=int, default=40, help="回复的大致字数")
+    parser.add_argument("--compress-ms", type=int, default=800, help="记忆压缩的首 token 延迟")
+    parser.add_argument("--error-rate", type=float, default=0.0, help="回 500 / 429 的比例")
+    parser.add_argument("--stall-rate", type=float, default=0.0, help="响应头之前卡住的比例")
+    parser.add_argument("--stall-ms", type=int, default=3000)
+    parser.add_argument("--reset-rate", type=float, default=0.0, help="不回响应直接断开的比例")
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="流式回复中途断开的比例")
+    parser.add_argument("--asr-ms", type=int, default=150, help="收完音频到识别结果")
+    parser.add_argument("--tts-ms", type=int, default=120, help="TTS 首块延迟")
+    parser.add_argument("--tts-chunk-ms", type=int, default=20, help="TTS 音频块间隔")
+    parser.add_argument("--tts-chunk-bytes", type=int, default=960)
+    parser.add_argument("--speech-error-rate", type=float, default=0.0)
+    parser.add_argument("--jitter-ms", type=int, default=0)
+    parser.add_argument("--seed", type=int, default=None, help="固定随机数种子（抖动和错误注入可复现）")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+    if args.seed is not None:
+        random.seed(args.seed)
+
+    llm = serve(LLMHandler, args, args.port, Stats())
+    speech = serve(SpeechHandler, args, args.speech_port, Stats())
+    print(f"LLM on http://{args.host}:{args.port}/v1, ASR/TTS on http://{args.host}:{args.speech_port}",
+          flush=True)
+    try:
+        threading.Event().wait()
+    except KeyboardInterrupt:
+        pass
+    llm.shutdown()
+    speech.shutdown()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# 端到端延迟测试：启动模拟服务端 → 跑 evospark_harness → 停掉模拟服务端
+#
+# 用法：harness/run.sh [evospark_harness 的参数]
+#   模拟服务端的参数放在 MOCK_ARGS 里（默认 --jitter-ms 30 --seed 1，即 baseline.json 的条件）
+#   例：MOCK_ARGS="--error-rate 0.1 --stall-rate 0.1" harness/run.sh --iterations 5
+
+set -e
+
+cd "$(dirname "$0")"
+BUILD_DIR=${BUILD_DIR:-build}
+LLM_PORT=${LLM_PORT:-8090}
+SPEECH_PORT=${SPEECH_PORT:-8091}
+
+if [ ! -x "$BUILD_DIR/evospark_harness" ]; then
+    cmake -S . -B "$BUILD_DIR" > /dev/null
+    cmake --build "$BUILD_DIR" -j"$(nproc)"
+fi
+
+python3 mock_services.py --port "$LLM_PORT" --speech-port "$SPEECH_PORT" ${MOCK_ARGS:---jitter-ms 30 --seed 1} &
+MOCK_PID=$!
+trap 'kill $MOCK_PID 2> /dev/null' EXIT
+
+# 等两个端口都能响应
+python3 - "$LLM_PORT" "$SPEECH_PORT" <<'PY'
+import sys, time, urllib.request
+for _ in range(100):
+    try:
+        for port in sys.argv[1:]:
+            urllib.request.urlopen(f"http://127.0.0.1:{port}/healthz", timeout=1)
+        sys.exit(0)
+    except OSError:
+        time.sleep(0.1)
+sys.exit("mock services did not start")
+PY
+
+"$BUILD_DIR/evospark_harness" --llm "http://127.0.0.1:$LLM_PORT/v1" --speech "http://127.0.0.1:$SPEECH_PORT" "$@"
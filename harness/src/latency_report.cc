@@ -0,0 +1,140 @@
+#include "latency_report.h"
+#include "json_codec.h"
+#include "cJSON.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace EvoSpark {
+
+namespace {
+
+double Percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+double Round(double ms) {
+    return static_cast<double>(static_cast<long long>(ms * 10 + 0.5)) / 10;
+}
+
+} // namespace
+
+std::map<std::string, LatencySummary> LatencyReport::Summarize() const {
+    std::map<std::string, LatencySummary> result;
+    for (const auto& item : samples_) {
+        std::vector<double> values = item.second;
+        LatencySummary& summary = result[item.first];
+        summary.count = values.size();
+        summary.p50 = Percentile(values, 0.50);
+        summary.p95 = Percentile(values, 0.95);
+        summary.p99 = Percentile(values, 0.99);
+    }
+    return result;
+}
+
+void LatencyReport::Print(FILE* out) const {
+    for (const auto& item : Summarize()) {
+        const LatencySummary& s = item.second;
+        fprintf(out, "%-16s n=%-4zu p50 %7.1f  p95 %7.1f  p99 %7.1f\n", item.first.c_str(), s.count,
+                s.p50, s.p95, s.p99);
+    }
+    if (!counters_.empty()) {
+        fprintf(out, "counters:");
+        for (const auto& c : counters_) {
+            fprintf(out, " %s=%ld", c.first.c_str(), c.second);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+std::string LatencyReport::ToJson() const {
+    std::map<std::string, LatencySummary> summary = Summarize();
+    std::string json;
+    JsonWriteTo(json, [&](auto& w) {
+        w.BeginObject();
+        w.Key("metrics");
+        w.BeginObject();
+        for (const auto& item : summary) {
+            w.Key(item.first);
+            w.BeginObject();
+            w.Field("count", static_cast<unsigned long>(item.second.count));
+            w.Field("p50", Round(item.second.p50));
+            w.Field("p95", Round(item.second.p95));
+            w.Field("p99", Round(item.second.p99));
+            w.EndObject();
+        }
+        w.EndObject();
+        w.Key("counters");
+        w.BeginObject();
+        for (const auto& c : counters_) {
+            w.Field(c.first.c_str(), c.second);
+        }
+        w.EndObject();
+        w.EndObject();
+    }, 2);
+    json += '\n';
+    return json;
+}
+
+bool LatencyReport::Save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << ToJson();
+    return static_cast<bool>(file);
+}
+
+int LatencyReport::CompareWithBaseline(const std::string& path, double tolerance_percent, double slack_ms,
+                                       FILE* out) const {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(out, "cannot open baseline %s\n", path.c_str());
+        return -1;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    cJSON* root = cJSON_ParseWithLength(text.data(), text.size());
+    cJSON* metrics = cJSON_GetObjectItem(root, "metrics");
+    if (!cJSON_IsObject(metrics)) {
+        fprintf(out, "baseline %s has no metrics\n", path.c_str());
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    static const char* const PERCENTILES[] = {"p50", "p95", "p99"};
+    std::map<std::string, LatencySummary> current = Summarize();
+    int regressions = 0;
+    fprintf(out, "vs baseline %s (tolerance %.0f%%, slack %.0f ms):\n", path.c_str(), tolerance_percent,
+            slack_ms);
+    cJSON* metric = nullptr;
+    cJSON_ArrayForEach(metric, metrics) {
+        auto it = current.find(metric->string);
+        if (it == current.end()) {
+            fprintf(out, "  %-16s missing from this run\n", metric->string);
+            continue;
+        }
+        const double values[] = {it->second.p50, it->second.p95, it->second.p99};
+        fprintf(out, "  %-16s", metric->string);
+        for (int i = 0; i < 3; i++) {
+            cJSON* base = cJSON_GetObjectItem(metric, PERCENTILES[i]);
+            if (!cJSON_IsNumber(base)) {
+                continue;
+            }
+            double before = base->valuedouble;
+            double delta = values[i] - before;
+            double percent = before > 0 ? delta * 100 / before : 0;
+            bool regressed = delta > slack_ms && percent > tolerance_percent;
+            regressions += regressed ? 1 : 0;
+            fprintf(out, " %s %+6.1f%%%s", PERCENTILES[i], percent, regressed ? " (!)" : "    ");
+        }
+        fprintf(out, "\n");
+    }
+    cJSON_Delete(root);
+    return regressions;
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,52 @@
+#ifndef HARNESS_LATENCY_REPORT_H
+#define HARNESS_LATENCY_REPORT_H
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace EvoSpark {
+
+// 延迟样本的分位数汇总
+struct LatencySummary {
+    size_t count = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+};
+
+// 按指标收集延迟样本（毫秒），输出 p50 / p95 / p99，和保存的基线比较
+//
+// 报告和基线是同一种 JSON：
+//   {"metrics": {"first_token_ms": {"count": 40, "p50": 212, "p95": 380, "p99": 410}, ...},
+//    "counters": {"turns": 40, "llm_errors": 0, ...}}
+class LatencyReport {
+public:
+    void Add(const std::string& metric, double ms) { samples_[metric].push_back(ms); }
+    void Count(const std::string& counter, long value = 1) { counters_[counter] += value; }
+    long Counter(const std::string& counter) const {
+        auto it = counters_.find(counter);
+        return it == counters_.end() ? 0 : it->second;
+    }
+
+    std::map<std::string, LatencySummary> Summarize() const;
+
+    void Print(FILE* out) const;
+    std::string ToJson() const;
+    bool Save(const std::string& path) const;
+
+    // 逐项比较 p50 / p95 / p99：比基线慢 tolerance_percent 以上且差值超过
+    // slack_ms 算退化（很小的值上几毫秒的抖动不算）。返回退化的项数，
+    // 读不了基线返回 -1
+    int CompareWithBaseline(const std::string& path, double tolerance_percent, double slack_ms,
+                            FILE* out) const;
+
+private:
+    std::map<std::string, std::vector<double>> samples_;
+    std::map<std::string, long> counters_;
+};
+
+} // namespace EvoSpark
+
+#endif // HARNESS_LATENCY_REPORT_H
@@ -0,0 +1,555 @@
+// 端到端延迟测试：在 Linux 上跑固件的会话流程，对着模拟服务端逐轮计时
+//
+// 每次会话：按键唤醒 → 每句脚本输入依次走
+//   ASR（上传合成音频，模拟服务端回显脚本文字）
+//   → SessionManager::OnUserInput（PromptBuilder 打包上下文、MemoryManager
+//     检索记忆、LLMClient 流式请求）
+//   → 回复按句切开，逐句 TTS（一个播报线程按顺序合成）
+// → 按键结束，等 SessionManager 压缩、保存、归档记忆（MEMORY_COMPRESS 事件）。
+//
+// 指标（毫秒）：
+//   asr_ms          说完（开始上传音频）到拿到识别结果
+//   first_token_ms  OnUserInput 到第一个回复片段（AI_RESPONSE_CHUNK）
+//   first_audio_ms  说完到第一句 TTS 的第一段音频
+//   full_turn_ms    说完到最后一句 TTS 的音频收完
+//   compress_ms     结束会话到记忆压缩完成
+//
+// 结束后输出 p50 / p95 / p99，--out 写 JSON 报告，--baseline 和保存的基线
+// 比较，有退化时退出码为 3。
+
+#include "host_shim.h"
+#include "latency_report.h"
+#include "scenario.h"
+#include "speech_client.h"
+#include "core/event_bus.h"
+#include "core/session_manager.h"
+#include "memory/memory_manager.h"
+#include "storage/flash_storage.h"
+#include "ai/llm_client.h"
+#include "link_quality.h"
+#include "response_cache.h"
+#include "token_ledger.h"
+#include "esp_log.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <getopt.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+using namespace EvoSpark;
+
+static const char* TAG = "harness";
+
+namespace {
+
+struct HarnessOptions {
+    std::string llm_url = "http://127.0.0.1:8090/v1";
+    std::string speech_url = "http://127.0.0.1:8091";
+    std::string api_key = "harness";
+    std::string script = "conversations.txt";
+    std::string data_dir;               // 空为临时目录（结束后删除）
+    std::string out;
+    std::string baseline;
+    int iterations = 3;
+    int think_ms = 0;
+    int rssi = -55;
+    int ms_per_char = 250;              // 合成音频时长：每个字约 250 ms
+    double tolerance = 20;
+    double slack_ms = 10;
+    double max_error_rate = -1;         // 出错轮次的比例上限（%），负数不检查
+    bool verbose = false;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double MsBetween(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// UTF-8 文字的字数
+size_t CharCount(const std::string& text) {
+    size_t count = 0;
+    for (unsigned char c : text) {
+        count += (c & 0xC0) != 0x80;
+    }
+    return count;
+}
+
+// 第一个句末标点之后的位置，没有完整的句子返回 npos
+size_t SentenceEnd(const std::string& text) {
+    static const char* const DELIMITERS[] = {"。", "！", "？", "；", "!", "?", ";", "\n"};
+    size_t best = std::string::npos;
+    for (const char* d : DELIMITERS) {
+        size_t pos = text.find(d);
+        if (pos != std::string::npos && (best == std::string::npos || pos + strlen(d) < best)) {
+            best = pos + strlen(d);
+        }
+    }
+    return best;
+}
+
+bool IsBlank(const std::string& text) {
+    return text.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+// 一轮对话的计时状态。事件回调（网络任务上）和播报线程只在锁内记时间点、
+// 交接句子，不调用固件接口，也不发布事件（EventBus 发布期间持有锁）
+class TurnTracker {
+public:
+    explicit TurnTracker(SpeechClient& speech) : speech_(speech) {}
+
+    void Subscribe() {
+        EventBus& bus = EventBus::GetInstance();
+        bus.Subscribe(EventType::AI_RESPONSE_CHUNK, [this](const Event& e) { OnChunk(e.str_data); });
+        bus.Subscribe(EventType::AI_RESPONSE_END, [this](const Event&) { OnReplyEnd(); });
+        bus.Subscribe(EventType::AI_ERROR, [this](const Event&) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reply_error_ = true;
+        });
+        bus.Subscribe(EventType::STATE_CHANGE, [this](const Event& e) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state_ = e.new_state;
+            cv_.notify_all();
+        });
+        bus.Subscribe(EventType::MEMORY_COMPRESS, [this](const Event& e) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            compress_done_ = true;
+            compress_saved_ = e.int_data != 0;
+            compress_end_ = Clock::now();
+            cv_.notify_all();
+        });
+        std::thread([this]() { SpeakLoop(); }).detach();
+    }
+
+    bool WaitForState(SessionState state, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                            [&]() { return state_ == state; });
+    }
+
+    // 开始一轮：spoken 为说完的时刻
+    void BeginTurn(Clock::time_point spoken) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = true;
+        spoken_ = spoken;
+        input_ = Clock::now();
+        got_token_ = got_audio_ = reply_done_ = turn_done_ = reply_error_ = false;
+        pending_.clear();
+        sentences_.clear();
+        tts_errors_ = 0;
+    }
+
+    struct TurnResult {
+        bool completed = false;
+        bool reply_error = false;
+        int tts_errors = 0;
+        bool got_token = false;
+        bool got_audio = false;
+        double first_token_ms = 0;
+        double first_audio_ms = 0;
+        double full_turn_ms = 0;
+    };
+
+    TurnResult WaitTurn(int timeout_ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        TurnResult result;
+        result.completed = cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                        [&]() { return turn_done_; });
+        active_ = false;
+        sentences_.clear();
+        result.reply_error = reply_error_;
+        result.tts_errors = tts_errors_;
+        result.got_token = got_token_;
+        result.got_audio = got_audio_;
+        if (got_token_) {
+            result.first_token_ms = MsBetween(input_, first_token_);
+        }
+        if (got_audio_) {
+            result.first_audio_ms = MsBetween(spoken_, first_audio_);
+        }
+        if (turn_done_) {
+            result.full_turn_ms = MsBetween(spoken_, last_audio_);
+        }
+        return result;
+    }
+
+    void BeginCompress() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        compress_done_ = false;
+    }
+
+    // 等记忆压缩完成；返回耗时（毫秒），超时返回 -1
+    double WaitCompress(Clock::time_point since, int timeout_ms, bool& saved) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() { return compress_done_; })) {
+            return -1;
+        }
+        saved = compress_saved_;
+        return MsBetween(since, compress_end_);
+    }
+
+private:
+    void OnChunk(const std::string& chunk) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return;
+        }
+        if (!got_token_) {
+            got_token_ = true;
+            first_token_ = Clock::now();
+        }
+        pending_ += chunk;
+        for (size_t end = SentenceEnd(pending_); end != std::string::npos; end = SentenceEnd(pending_)) {
+            std::string sentence = pending_.substr(0, end);
+            pending_.erase(0, end);
+            if (!IsBlank(sentence)) {
+                sentences_.push_back(std::move(sentence));
+            }
+        }
+        cv_.notify_all();
+    }
+
+    void OnReplyEnd() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return;
+        }
+        if (!IsBlank(pending_)) {
+            sentences_.push_back(std::move(pending_));
+        }
+        pending_.clear();
+        reply_done_ = true;
+        if (sentences_.empty() && !speaking_) {
+            last_audio_ = Clock::now();
+            turn_done_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // 播报线程：按顺序合成每句话（设备上前一句播完才轮到下一句）
+    void SpeakLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this]() { return !sentences_.empty(); });
+            std::string sentence = std::move(sentences_.front());
+            sentences_.pop_front();
+            speaking_ = true;
+            lock.unlock();
+
+            size_t audio_bytes = 0;
+            int status = speech_.Synthesize(sentence, [this]() {
+                std::lock_guard<std::mutex> guard(mutex_);
+                if (active_ && !got_audio_) {
+                    got_audio_ = true;
+                    first_audio_ = Clock::now();
+                }
+            }, audio_bytes);
+
+            lock.lock();
+            speaking_ = false;
+            if (!active_) {
+                continue;
+            }
+            if (status != 200) {
+                ESP_LOGW(TAG, "TTS failed (%d)", status);
+                tts_errors_++;
+            }
+            if (reply_done_ && sentences_.empty()) {
+                last_audio_ = Clock::now();
+                turn_done_ = true;
+                cv_.notify_all();
+            }
+        }
+    }
+
+    SpeechClient& speech_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    SessionState state_ = SessionState::IDLE;
+    bool active_ = false;
+    Clock::time_point spoken_;
+    Clock::time_point input_;
+    Clock::time_point first_token_;
+    Clock::time_point first_audio_;
+    Clock::time_point last_audio_;
+    bool got_token_ = false;
+    bool got_audio_ = false;
+    bool reply_done_ = false;
+    bool reply_error_ = false;
+    bool turn_done_ = false;
+    bool speaking_ = false;
+    int tts_errors_ = 0;
+    std::string pending_;                   // 还没凑成整句的回复
+    std::deque<std::string> sentences_;     // 等待合成的句子
+
+    bool compress_done_ = false;
+    bool compress_saved_ = false;
+    Clock::time_point compress_end_;
+};
+
+constexpr int STATE_TIMEOUT_MS = 10000;
+constexpr int TURN_TIMEOUT_MS = 90000;
+constexpr int COMPRESS_TIMEOUT_MS = 120000;
+
+// 跑一句输入；返回这句是否进入了会话（ASR 成功）
+bool RunTurn(const std::string& utterance, const HarnessOptions& options, SpeechClient& speech,
+             TurnTracker& tracker, LatencyReport& report) {
+    Clock::time_point spoken = Clock::now();
+    int audio_ms = std::max<int>(600, static_cast<int>(CharCount(utterance)) * options.ms_per_char);
+    std::string text;
+    int status = speech.Recognize(utterance, audio_ms, text);
+    if (status != 200 || text.empty()) {
+        ESP_LOGW(TAG, "ASR failed (%d): %s", status, utterance.c_str());
+        report.Count("asr_errors");
+        return false;
+    }
+    report.Add("asr_ms", MsBetween(spoken, Clock::now()));
+
+    SessionManager& session = SessionManager::GetInstance();
+    if (!tracker.WaitForState(SessionState::LISTENING, STATE_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Session stuck in %s", StateToString(session.GetState()));
+        report.Count("timeouts");
+        return false;
+    }
+
+    uint32_t cache_hits = ResponseCache::GetInstance().GetStats().hits;
+    tracker.BeginTurn(spoken);
+    session.OnUserInput(text);
+    TurnTracker::TurnResult result = tracker.WaitTurn(TURN_TIMEOUT_MS);
+
+    report.Count("turns");
+    if (ResponseCache::GetInstance().GetStats().hits != cache_hits) {
+        report.Count("cache_hits");
+    }
+    if (result.reply_error) {
+        report.Count("llm_errors");
+    }
+    if (result.tts_errors > 0) {
+        report.Count("tts_errors", result.tts_errors);
+    }
+    if (!result.completed) {
+        ESP_LOGE(TAG, "Turn timed out: %s", utterance.c_str());
+        report.Count("timeouts");
+        return true;
+    }
+    if (result.got_token) {
+        report.Add("first_token_ms", result.first_token_ms);
+    }
+    if (result.got_audio) {
+        report.Add("first_audio_ms", result.first_audio_ms);
+    }
+    report.Add("full_turn_ms", result.full_turn_ms);
+    return true;
+}
+
+void RunConversation(const Conversation& conversation, const HarnessOptions& options, SpeechClient& speech,
+                     TurnTracker& tracker, LatencyReport& report) {
+    SessionManager& session = SessionManager::GetInstance();
+    session.OnButtonPress();
+    if (!tracker.WaitForState(SessionState::LISTENING, STATE_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Session did not start");
+        report.Count("timeouts");
+        return;
+    }
+    report.Count("sessions");
+
+    bool any_input = false;
+    for (const std::string& utterance : conversation.turns) {
+        any_input |= RunTurn(utterance, options, speech, tracker, report);
+        if (options.think_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.think_ms));
+        }
+    }
+
+    // 结束会话；缓冲区为空时 SessionManager 不压缩，也就没有完成事件
+    tracker.BeginCompress();
+    Clock::time_point end = Clock::now();
+    session.OnButtonPress();
+    if (!any_input) {
+        return;
+    }
+    bool saved = false;
+    double compress_ms = tracker.WaitCompress(end, COMPRESS_TIMEOUT_MS, saved);
+    if (compress_ms < 0) {
+        ESP_LOGE(TAG, "Memory compression did not finish");
+        report.Count("timeouts");
+        return;
+    }
+    report.Add("compress_ms", compress_ms);
+    report.Count(saved ? "memory_saved" : "memory_unchanged");
+}
+
+void Usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --llm URL              OpenAI-compatible base URL (default http://127.0.0.1:8090/v1)\n"
+            "  --speech URL           ASR / TTS base URL (default http://127.0.0.1:8091)\n"
+            "  --script FILE          conversations, blank line between sessions (default conversations.txt)\n"
+            "  --iterations N         passes over the script (default 3)\n"
+            "  --think-ms N           pause between turns (default 0)\n"
+            "  --rssi DBM             WiFi signal reported to LinkQuality (default -55)\n"
+            "  --data DIR             keep flash contents in DIR (default: temporary, removed at exit)\n"
+            "  --out FILE             write the JSON report\n"
+            "  --baseline FILE        compare with a saved report, exit 3 on regression\n"
+            "  --tolerance PCT        allowed slowdown per percentile (default 20)\n"
+            "  --slack-ms N           ignore slowdowns smaller than this (default 10)\n"
+            "  --max-error-rate PCT   exit 4 if more than PCT%% of turns end in an LLM error or timeout\n"
+            "  -v, --verbose          firmware INFO logs\n",
+            program);
+}
+
+// 固件的网络任务和定时器线程都是分离的，退出时不跑静态析构
+[[noreturn]] void Exit(int code) {
+    fflush(stdout);
+    fflush(stderr);
+    _exit(code);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    HarnessOptions options;
+
+    enum {
+        OPT_LLM = 1000, OPT_SPEECH, OPT_SCRIPT, OPT_ITERATIONS, OPT_THINK, OPT_RSSI, OPT_DATA, OPT_OUT,
+        OPT_BASELINE, OPT_TOLERANCE, OPT_SLACK, OPT_MAX_ERROR_RATE,
+    };
+    static const struct option LONG_OPTIONS[] = {
+        {"llm", required_argument, nullptr, OPT_LLM},
+        {"speech", required_argument, nullptr, OPT_SPEECH},
+        {"script", required_argument, nullptr, OPT_SCRIPT},
+        {"iterations", required_argument, nullptr, OPT_ITERATIONS},
+        {"think-ms", required_argument, nullptr, OPT_THINK},
+        {"rssi", required_argument, nullptr, OPT_RSSI},
+        {"data", required_argument, nullptr, OPT_DATA},
+        {"out", required_argument, nullptr, OPT_OUT},
+        {"baseline", required_argument, nullptr, OPT_BASELINE},
+        {"tolerance", required_argument, nullptr, OPT_TOLERANCE},
+        {"slack-ms", required_argument, nullptr, OPT_SLACK},
+        {"max-error-rate", required_argument, nullptr, OPT_MAX_ERROR_RATE},
+        {"verbose", no_argument, nullptr, 'v'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "vh", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case OPT_LLM: options.llm_url = optarg; break;
+            case OPT_SPEECH: options.speech_url = optarg; break;
+            case OPT_SCRIPT: options.script = optarg; break;
+            case OPT_ITERATIONS: options.iterations = std::max(1, atoi(optarg)); break;
+            case OPT_THINK: options.think_ms = std::max(0, atoi(optarg)); break;
+            case OPT_RSSI: options.rssi = atoi(optarg); break;
+            case OPT_DATA: options.data_dir = optarg; break;
+            case OPT_OUT: options.out = optarg; break;
+            case OPT_BASELINE: options.baseline = optarg; break;
+            case OPT_TOLERANCE: options.tolerance = atof(optarg); break;
+            case OPT_SLACK: options.slack_ms = atof(optarg); break;
+            case OPT_MAX_ERROR_RATE: options.max_error_rate = atof(optarg); break;
+            case 'v': options.verbose = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    std::vector<Conversation> conversations;
+    std::string error;
+    if (!LoadConversations(options.script, conversations, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    esp_log_level_set("*", options.verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+    // Flash 分区映射到数据目录
+    bool temporary = options.data_dir.empty();
+    if (temporary) {
+        char dir[] = "/tmp/evospark_harness.XXXXXX";
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        options.data_dir = dir;
+    } else {
+        std::filesystem::create_directories(options.data_dir);
+    }
+    Host::SetDataRoot(options.data_dir);
+    Host::SetWifiRssi(options.rssi);
+
+    // 与 app_main 相同的初始化顺序（没有外设和 Web 服务）
+    if (!FlashStorage::GetInstance().Init() ||
+        !MemoryManager::GetInstance().Init(options.api_key)) {
+        ESP_LOGE(TAG, "Storage init failed");
+        Exit(1);
+    }
+    ResponseCache::GetInstance().Init("/spiffs/resp_cache.bin");
+    TokenLedger::GetInstance().Init("/spiffs/token_ledger.bin");
+    if (!LLMClient::GetInstance().Init(options.api_key, options.llm_url)) {
+        ESP_LOGE(TAG, "LLM client init failed");
+        Exit(1);
+    }
+    LinkQuality::GetInstance().Start();
+    if (!SessionManager::GetInstance().Init()) {
+        ESP_LOGE(TAG, "SessionManager init failed");
+        Exit(1);
+    }
+
+    SpeechClient speech(options.speech_url);
+    TurnTracker tracker(speech);
+    tracker.Subscribe();
+
+    LatencyReport report;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < options.iterations; i++) {
+        for (const Conversation& conversation : conversations) {
+            RunConversation(conversation, options, speech, tracker, report);
+        }
+        fprintf(stderr, "pass %d/%d done (%.1f s)\n", i + 1, options.iterations,
+                MsBetween(start, Clock::now()) / 1000);
+    }
+
+    TransportStats transport = LLMClient::GetInstance().GetTransportStats();
+    report.Count("llm_retries", transport.retries);
+    report.Count("llm_hedges", transport.hedges);
+    report.Count("llm_hedge_wins", transport.hedge_wins);
+
+    report.Print(stdout);
+    int code = 0;
+    if (!options.out.empty() && !report.Save(options.out)) {
+        fprintf(stderr, "cannot write %s\n", options.out.c_str());
+        code = 1;
+    }
+    if (!options.baseline.empty()) {
+        int regressions = report.CompareWithBaseline(options.baseline, options.tolerance, options.slack_ms,
+                                                     stdout);
+        if (regressions < 0) {
+            code = 1;
+        } else if (regressions > 0) {
+            printf("%d percentile(s) regressed\n", regressions);
+            code = 3;
+        }
+    }
+    if (options.max_error_rate >= 0) {
+        // 故障注入时看固件能不能扛住：回复出错或超时的轮次不能超过上限
+        long turns = report.Counter("turns");
+        long failed = report.Counter("llm_errors") + report.Counter("timeouts");
+        double rate = turns > 0 ? 100.0 * failed / turns : 100;
+        printf("failed turns: %ld/%ld (%.1f%%, limit %.1f%%)\n", failed, turns, rate, options.max_error_rate);
+        if (rate > options.max_error_rate && code == 0) {
+            code = 4;
+        }
+    }
+
+    if (temporary) {
+        std::error_code ignored;
+        std::filesystem::remove_all(options.data_dir, ignored);
+    }
+    Exit(code);
+}
@@ -0,0 +1,50 @@
+#include "scenario.h"
+#include <fstream>
+
+namespace EvoSpark {
+
+static std::string Trim(const std::string& line) {
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = line.find_last_not_of(" \t\r");
+    return line.substr(begin, end - begin + 1);
+}
+
+bool LoadConversations(const std::string& path, std::vector<Conversation>& out, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    out.clear();
+    Conversation current;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = Trim(line);
+        if (!line.empty() && line[0] == '#') {
+            continue;
+        }
+        if (line.empty()) {
+            if (!current.turns.empty()) {
+                out.push_back(std::move(current));
+                current = Conversation();
+            }
+            continue;
+        }
+        current.turns.push_back(line);
+    }
+    if (!current.turns.empty()) {
+        out.push_back(std::move(current));
+    }
+
+    if (out.empty()) {
+        error = path + " has no conversations";
+        return false;
+    }
+    return true;
+}
+
+} // namespace EvoSpark
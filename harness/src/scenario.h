@@ -0,0 +1,19 @@
+#ifndef HARNESS_SCENARIO_H
+#define HARNESS_SCENARIO_H
+
+#include <string>
+#include <vector>
+
+namespace EvoSpark {
+
+// 脚本化的对话：一次会话是按键唤醒后依次说出的几句话
+struct Conversation {
+    std::vector<std::string> turns;
+};
+
+// 读取对话脚本：每行一句用户输入，空行分隔会话，# 开头的行是注释
+bool LoadConversations(const std::string& path, std::vector<Conversation>& out, std::string& error);
+
+} // namespace EvoSpark
+
+#endif // HARNESS_SCENARIO_H
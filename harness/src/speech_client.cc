@@ -0,0 +1,108 @@
+#include "speech_client.h"
+#include "http_pool.h"
+#include "json_codec.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace EvoSpark {
+
+namespace {
+
+std::string UrlEncode(const std::string& text) {
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(text.size() * 3);
+    for (unsigned char c : text) {
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += HEX[c >> 4];
+            out += HEX[c & 0x0F];
+        }
+    }
+    return out;
+}
+
+// 一块低幅度的伪随机噪声，上传时循环使用（内容不影响模拟服务端）
+const int16_t* NoiseBlock(size_t& samples) {
+    static int16_t block[512];
+    static bool ready = false;
+    if (!ready) {
+        uint32_t seed = 0x2545F491;
+        for (int16_t& s : block) {
+            seed = seed * 1664525u + 1013904223u;
+            s = static_cast<int16_t>(static_cast<int32_t>(seed >> 16) % 600 - 300);
+        }
+        ready = true;
+    }
+    samples = sizeof(block) / sizeof(block[0]);
+    return block;
+}
+
+} // namespace
+
+int SpeechClient::Recognize(const std::string& expect, int audio_ms, std::string& text) {
+    size_t block_samples = 0;
+    const int16_t* block = NoiseBlock(block_samples);
+    const size_t block_bytes = block_samples * sizeof(int16_t);
+    const size_t total = static_cast<size_t>(audio_ms) * SAMPLE_RATE / 1000 * sizeof(int16_t);
+
+    std::string response;
+    HttpConnectionPool::Headers headers = {
+        {"Content-Type", "audio/L16; rate=16000; channels=1"},
+    };
+    int status = HttpConnectionPool::GetInstance().Upload(
+        base_url_ + "/v1/asr?expect=" + UrlEncode(expect), total,
+        [&](const HttpConnectionPool::ChunkWriter& write) {
+            for (size_t sent = 0; sent < total;) {
+                size_t n = std::min(block_bytes, total - sent);
+                if (!write(reinterpret_cast<const char*>(block), n)) {
+                    return false;
+                }
+                sent += n;
+            }
+            return true;
+        },
+        headers,
+        [&response](const char* data, size_t length) { response.append(data, length); },
+        TIMEOUT_MS);
+
+    text.clear();
+    if (status == 200) {
+        JsonFieldReader fields;
+        if (!fields.Parse(response.data(), response.size()) || !fields.GetString("text", text)) {
+            return -1;
+        }
+    }
+    return status;
+}
+
+int SpeechClient::Synthesize(const std::string& text, const std::function<void()>& on_first_audio,
+                             size_t& audio_bytes) {
+    std::string body;
+    JsonWriteTo(body, [&text](auto& w) {
+        w.BeginObject();
+        w.Field("text", text);
+        w.Field("format", "opus");
+        w.EndObject();
+    });
+
+    audio_bytes = 0;
+    HttpConnectionPool::Headers headers = {
+        {"Content-Type", "application/json"},
+    };
+    return HttpConnectionPool::GetInstance().Post(
+        base_url_ + "/v1/tts", body, headers,
+        [&](const char* data, size_t length) {
+            (void)data;
+            if (audio_bytes == 0 && length > 0 && on_first_audio) {
+                on_first_audio();
+            }
+            audio_bytes += length;
+        },
+        TIMEOUT_MS);
+}
+
+} // namespace EvoSpark
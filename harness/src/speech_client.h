@@ -0,0 +1,36 @@
+#ifndef HARNESS_SPEECH_CLIENT_H
+#define HARNESS_SPEECH_CLIENT_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace EvoSpark {
+
+// 级联语音流程里 ASR / TTS 两段的 HTTP 客户端（走固件的 HttpConnectionPool）
+//
+//   ASR：POST <base>/v1/asr，请求体是 16 kHz 16 bit 单声道 PCM，边生成边上传；
+//        模拟服务端不做识别，直接回显查询参数 expect 里的文字 {"text": "..."}
+//   TTS：POST <base>/v1/tts {"text": "..."}，响应体是分块到达的音频
+class SpeechClient {
+public:
+    explicit SpeechClient(const std::string& base_url) : base_url_(base_url) {}
+
+    // 上传 audio_ms 毫秒的合成音频，识别结果写入 text；返回 HTTP 状态码，网络错误 -1
+    int Recognize(const std::string& expect, int audio_ms, std::string& text);
+
+    // 合成一句话；收到第一段音频时调用 on_first_audio，audio_bytes 为音频总字节数。
+    // 返回 HTTP 状态码，网络错误 -1
+    int Synthesize(const std::string& text, const std::function<void()>& on_first_audio,
+                   size_t& audio_bytes);
+
+    static constexpr int SAMPLE_RATE = 16000;
+    static constexpr int TIMEOUT_MS = 15000;
+
+private:
+    std::string base_url_;
+};
+
+} // namespace EvoSpark
+
+#endif // HARNESS_SPEECH_CLIENT_H
@@ -0,0 +1,205 @@
+#include "device_registry.h"
+#include "relay_log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+namespace EvoSpark {
+
+static const char* TAG = "DeviceRegistry";
+
+const char* AdmissionToString(Admission admission) {
+    switch (admission) {
+        case Admission::OK: return "ok";
+        case Admission::UNKNOWN_DEVICE: return "unknown device";
+        case Admission::RATE_LIMITED: return "request rate limit";
+        case Admission::TOO_MANY_ACTIVE: return "concurrency limit";
+        case Admission::DAILY_EXHAUSTED: return "daily token quota";
+        default: return "unknown";
+    }
+}
+
+bool DeviceRegistry::Load(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::map<std::string, Device> devices;
+    std::map<std::string, std::string> names;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.resize(hash);
+        }
+        std::istringstream fields(line);
+        std::string token;
+        std::string name;
+        if (!(fields >> token)) {
+            continue;
+        }
+        if (!(fields >> name)) {
+            error = path + ":" + std::to_string(line_number) + ": missing device name";
+            return false;
+        }
+
+        Device device;
+        device.info.name = name;
+        device.info.quota = default_quota_;
+        uint32_t* limits[] = {&device.info.quota.daily_tokens, &device.info.quota.requests_per_minute,
+                              &device.info.quota.concurrency};
+        for (uint32_t* limit : limits) {
+            std::string value;
+            if (!(fields >> value)) {
+                break;
+            }
+            char* end = nullptr;
+            unsigned long parsed = strtoul(value.c_str(), &end, 10);
+            if (*end != '\0') {
+                error = path + ":" + std::to_string(line_number) + ": bad number '" + value + "'";
+                return false;
+            }
+            *limit = static_cast<uint32_t>(parsed);
+        }
+        if (devices.count(token) || names.count(name)) {
+            error = path + ":" + std::to_string(line_number) + ": duplicate token or name";
+            return false;
+        }
+        device.bucket = device.info.quota.requests_per_minute;
+        names[name] = token;
+        devices[token] = device;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    devices_ = std::move(devices);
+    names_ = std::move(names);
+    closed_ = true;
+    RELAY_LOGI(TAG, "Loaded %zu devices from %s", devices_.size(), path.c_str());
+    return true;
+}
+
+int DeviceRegistry::Today() {
+    time_t now = time(nullptr);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return (tm.tm_year + 1900) * 1000 + tm.tm_yday;
+}
+
+void DeviceRegistry::RollDay(Device& device) {
+    int today = Today();
+    if (device.day != today) {
+        device.day = today;
+        device.info.tokens_today = 0;
+    }
+}
+
+DeviceRegistry::Device* DeviceRegistry::Find(const std::string& token) {
+    auto it = devices_.find(token);
+    if (it != devices_.end()) {
+        return &it->second;
+    }
+    if (closed_ || devices_.size() >= MAX_OPEN_DEVICES) {
+        return nullptr;
+    }
+
+    // 开放模式：第一次见到的 token 用默认配额登记；名字只露出 token 开头
+    Device device;
+    device.info.name = token.empty() ? "anonymous" : token.substr(0, 12);
+    std::string name = device.info.name;
+    for (int suffix = 2; names_.count(device.info.name); suffix++) {
+        device.info.name = name + "#" + std::to_string(suffix);
+    }
+    device.info.quota = default_quota_;
+    device.bucket = default_quota_.requests_per_minute;
+    names_[device.info.name] = token;
+    return &(devices_[token] = device);
+}
+
+Admission DeviceRegistry::Begin(const std::string& token, std::string& device_name, uint32_t& retry_after_s) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retry_after_s = 0;
+    Device* device = Find(token);
+    if (!device) {
+        return Admission::UNKNOWN_DEVICE;
+    }
+    DeviceSnapshot& info = device->info;
+    const DeviceQuota& quota = info.quota;
+    device_name = info.name;
+    info.last_seen = time(nullptr);
+    RollDay(*device);
+
+    Admission result = Admission::OK;
+    if (quota.daily_tokens > 0 && info.tokens_today >= quota.daily_tokens) {
+        // 到本地零点
+        time_t now = time(nullptr);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        retry_after_s = static_cast<uint32_t>(86400 - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec));
+        result = Admission::DAILY_EXHAUSTED;
+    } else if (quota.concurrency > 0 && info.active >= quota.concurrency) {
+        retry_after_s = 1;
+        result = Admission::TOO_MANY_ACTIVE;
+    } else if (quota.requests_per_minute > 0) {
+        int64_t now = NowUs();
+        double rate = quota.requests_per_minute / 60.0;     // 每秒补充
+        if (device->bucket_us > 0) {
+            device->bucket = std::min<double>(quota.requests_per_minute,
+                                              device->bucket + (now - device->bucket_us) / 1e6 * rate);
+        }
+        device->bucket_us = now;
+        if (device->bucket < 1.0) {
+            retry_after_s = static_cast<uint32_t>(std::ceil((1.0 - device->bucket) / rate));
+            result = Admission::RATE_LIMITED;
+        } else {
+            device->bucket -= 1.0;
+        }
+    }
+
+    if (result != Admission::OK) {
+        info.rejected++;
+        return result;
+    }
+    info.requests++;
+    info.active++;
+    return Admission::OK;
+}
+
+void DeviceRegistry::End(const std::string& device_name, uint64_t tokens, bool shared) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto name = names_.find(device_name);
+    if (name == names_.end()) {
+        return;
+    }
+    Device& device = devices_[name->second];
+    DeviceSnapshot& info = device.info;
+    if (info.active > 0) {
+        info.active--;
+    }
+    RollDay(device);
+    if (shared) {
+        info.shared++;
+        info.tokens_saved += tokens;
+    } else {
+        info.tokens_today += tokens;
+        info.tokens_total += tokens;
+    }
+}
+
+std::vector<DeviceSnapshot> DeviceRegistry::GetSnapshots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<DeviceSnapshot> snapshots;
+    snapshots.reserve(devices_.size());
+    for (const auto& item : devices_) {
+        snapshots.push_back(item.second.info);
+    }
+    return snapshots;
+}
+
+} // namespace EvoSpark
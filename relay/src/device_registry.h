@@ -0,0 +1,94 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EvoSpark {
+
+// 一台设备的配额（0 为不限）
+struct DeviceQuota {
+    uint32_t daily_tokens = 0;          // 每天（本地时间零点重置）可用的 token
+    uint32_t requests_per_minute = 0;   // 令牌桶：容量和每分钟补充量都是这个数
+    uint32_t concurrency = 0;           // 同时进行中的请求
+};
+
+// 准入结果
+enum class Admission {
+    OK,
+    UNKNOWN_DEVICE,     // 设备表里没有这个 token → 401
+    RATE_LIMITED,       // 每分钟请求数 → 429
+    TOO_MANY_ACTIVE,    // 并发数 → 429
+    DAILY_EXHAUSTED,    // 当天 token 用完 → 429
+};
+
+const char* AdmissionToString(Admission admission);
+
+struct DeviceSnapshot {
+    std::string name;
+    DeviceQuota quota;
+    uint64_t requests = 0;
+    uint64_t rejected = 0;
+    uint64_t shared = 0;             // 由缓存或合并请求服务的
+    uint64_t tokens_today = 0;       // 当天记账的 token
+    uint64_t tokens_total = 0;
+    uint64_t tokens_saved = 0;       // 共享响应省下的上游 token
+    uint32_t active = 0;
+    int64_t last_seen = 0;           // 墙钟秒
+};
+
+// 设备表和配额记账
+//
+// 设备用 Authorization: Bearer <token> 标识（固件里就是 LLMClient 的
+// api_key，换成中继分配的设备 token，真正的上游密钥只留在中继上）。
+// 设备表文件每行一台：
+//   <token> <名字> [每日 token] [每分钟请求] [并发]
+// 缺省的列用默认配额，# 开头为注释。没有设备表时任何 token 都接受，
+// 按 token 区分设备，都用默认配额。
+//
+// Begin 在请求转发前检查配额并占一个并发名额，End 归还名额并按上游
+// 响应的 usage 记账。命中缓存或合并到别的设备请求上的响应不消耗上游
+// token，不计入配额，只记为节省量。
+class DeviceRegistry {
+public:
+    explicit DeviceRegistry(const DeviceQuota& default_quota) : default_quota_(default_quota) {}
+
+    // 读设备表；失败写 error
+    bool Load(const std::string& path, std::string& error);
+    bool IsOpen() const { return !closed_; }
+
+    // 成功时 device 为设备名；被限流时 retry_after_s 为建议的重试等待
+    Admission Begin(const std::string& token, std::string& device, uint32_t& retry_after_s);
+
+    // tokens 为这次请求实际消耗的上游 token；shared 表示响应来自缓存或合并
+    void End(const std::string& device, uint64_t tokens, bool shared);
+
+    std::vector<DeviceSnapshot> GetSnapshots() const;
+
+    static constexpr size_t MAX_OPEN_DEVICES = 4096;   // 开放模式下最多记住的 token 数
+
+private:
+    struct Device {
+        DeviceSnapshot info;
+        double bucket = 0;            // 剩余的请求令牌
+        int64_t bucket_us = 0;        // 上次补充时间
+        int day = -1;                 // tokens_today 所属的日期
+    };
+
+    Device* Find(const std::string& token);
+    static int Today();
+    void RollDay(Device& device);
+
+    DeviceQuota default_quota_;
+    bool closed_ = false;             // 已加载设备表，只接受表里的 token
+    std::map<std::string, Device> devices_;            // token → 设备
+    std::map<std::string, std::string> names_;         // 设备名 → token
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // DEVICE_REGISTRY_H
@@ -0,0 +1,327 @@
+#include "http_message.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace EvoSpark {
+
+namespace {
+
+constexpr size_t MAX_HEADER_LINE = 8192;
+constexpr size_t MAX_HEADERS = 64;
+
+void Trim(std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    size_t end = text.find_last_not_of(" \t");
+    text = begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+bool ReadHeaders(BufferedReader& reader, HttpHeaders& headers) {
+    std::string line;
+    for (size_t count = 0; count <= MAX_HEADERS; count++) {
+        if (!reader.ReadLine(line, MAX_HEADER_LINE)) {
+            return false;
+        }
+        if (line.empty()) {
+            return true;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            return false;
+        }
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        Trim(value);
+        headers.Add(std::move(name), std::move(value));
+    }
+    return false;
+}
+
+// 由请求头决定分帧；不合法返回 false
+bool ResolveFraming(const HttpHeaders& headers, BodyFraming& framing, size_t& length) {
+    const std::string* transfer = headers.Find("Transfer-Encoding");
+    if (transfer) {
+        if (strcasecmp(transfer->c_str(), "chunked") != 0) {
+            return false;
+        }
+        framing = BodyFraming::CHUNKED;
+        return true;
+    }
+    const std::string* content_length = headers.Find("Content-Length");
+    if (content_length) {
+        char* end = nullptr;
+        unsigned long long value = strtoull(content_length->c_str(), &end, 10);
+        if (content_length->empty() || *end != '\0') {
+            return false;
+        }
+        framing = value > 0 ? BodyFraming::LENGTH : BodyFraming::NONE;
+        length = static_cast<size_t>(value);
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// ==================== HttpHeaders ====================
+
+const std::string* HttpHeaders::Find(const char* name) const {
+    for (const auto& item : items_) {
+        if (strcasecmp(item.first.c_str(), name) == 0) {
+            return &item.second;
+        }
+    }
+    return nullptr;
+}
+
+std::string HttpHeaders::Get(const char* name, const std::string& fallback) const {
+    const std::string* value = Find(name);
+    return value ? *value : fallback;
+}
+
+void HttpHeaders::Remove(const char* name) {
+    for (auto it = items_.begin(); it != items_.end();) {
+        if (strcasecmp(it->first.c_str(), name) == 0) {
+            it = items_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool HttpHeaders::HasToken(const char* name, const char* token) const {
+    const std::string* value = Find(name);
+    if (!value) {
+        return false;
+    }
+    size_t token_length = strlen(token);
+    size_t pos = 0;
+    while (pos < value->size()) {
+        size_t comma = value->find(',', pos);
+        if (comma == std::string::npos) {
+            comma = value->size();
+        }
+        std::string item = value->substr(pos, comma - pos);
+        Trim(item);
+        if (item.size() == token_length && strncasecmp(item.c_str(), token, token_length) == 0) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// ==================== 读取 ====================
+
+bool ReadRequest(BufferedReader& reader, HttpRequest& request, size_t max_body, int& error_status) {
+    error_status = 0;
+    std::string line;
+    // keep-alive 连接上请求之间允许空行
+    do {
+        if (!reader.ReadLine(line, MAX_HEADER_LINE)) {
+            return false;
+        }
+    } while (line.empty());
+
+    size_t first = line.find(' ');
+    size_t second = first == std::string::npos ? std::string::npos : line.find(' ', first + 1);
+    if (second == std::string::npos) {
+        error_status = 400;
+        return false;
+    }
+    request.method = line.substr(0, first);
+    request.target = line.substr(first + 1, second - first - 1);
+    std::string version = line.substr(second + 1);
+
+    if (!ReadHeaders(reader, request.headers)) {
+        error_status = 400;
+        return false;
+    }
+
+    if (version == "HTTP/1.0") {
+        request.keep_alive = request.headers.HasToken("Connection", "keep-alive");
+    } else {
+        request.keep_alive = !request.headers.HasToken("Connection", "close");
+    }
+
+    BodyFraming framing = BodyFraming::NONE;
+    size_t length = 0;
+    if ((request.headers.Find("Transfer-Encoding") || request.headers.Find("Content-Length")) &&
+        !ResolveFraming(request.headers, framing, length)) {
+        error_status = 400;
+        return false;
+    }
+    if (framing == BodyFraming::LENGTH && length > max_body) {
+        error_status = 413;
+        return false;
+    }
+
+    request.body.clear();
+    if (framing == BodyFraming::LENGTH) {
+        request.body.reserve(length);
+    }
+    bool too_large = false;
+    bool complete = ReadBody(reader, framing, length, [&](const char* data, size_t size) {
+        if (request.body.size() + size > max_body) {
+            too_large = true;
+            return false;
+        }
+        request.body.append(data, size);
+        return true;
+    });
+    if (too_large) {
+        error_status = 413;
+        return false;
+    }
+    return complete;
+}
+
+bool ReadResponseHead(BufferedReader& reader, HttpResponseHead& head, const std::string& request_method) {
+    std::string line;
+    // 跳过 100 Continue 之类的临时响应
+    while (true) {
+        if (!reader.ReadLine(line, MAX_HEADER_LINE) || line.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            return false;
+        }
+        head.status = atoi(line.c_str() + space + 1);
+        head.headers = HttpHeaders();
+        if (!ReadHeaders(reader, head.headers)) {
+            return false;
+        }
+        if (head.status >= 200) {
+            break;
+        }
+    }
+
+    bool http10 = line.compare(0, 8, "HTTP/1.0") == 0;
+    head.keep_alive = http10 ? head.headers.HasToken("Connection", "keep-alive")
+                             : !head.headers.HasToken("Connection", "close");
+
+    head.content_length = 0;
+    if (request_method == "HEAD" || head.status == 204 || head.status == 304) {
+        head.framing = BodyFraming::NONE;
+    } else if (head.headers.Find("Transfer-Encoding") || head.headers.Find("Content-Length")) {
+        if (!ResolveFraming(head.headers, head.framing, head.content_length)) {
+            return false;
+        }
+    } else {
+        head.framing = BodyFraming::CLOSE;
+        head.keep_alive = false;
+    }
+    return true;
+}
+
+bool ReadBody(BufferedReader& reader, BodyFraming framing, size_t content_length, const BodySink& sink) {
+    char buffer[16384];
+
+    switch (framing) {
+        case BodyFraming::NONE:
+            return true;
+
+        case BodyFraming::LENGTH: {
+            size_t remaining = content_length;
+            while (remaining > 0) {
+                ssize_t n = reader.ReadSome(buffer, std::min(sizeof(buffer), remaining));
+                if (n <= 0) {
+                    return false;
+                }
+                if (!sink(buffer, static_cast<size_t>(n))) {
+                    return false;
+                }
+                remaining -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        case BodyFraming::CHUNKED: {
+            std::string line;
+            while (true) {
+                if (!reader.ReadLine(line, 1024)) {
+                    return false;
+                }
+                char* end = nullptr;
+                unsigned long long size = strtoull(line.c_str(), &end, 16);   // 忽略 ;扩展
+                if (end == line.c_str()) {
+                    return false;
+                }
+                if (size == 0) {
+                    // 尾部字段，直到空行
+                    do {
+                        if (!reader.ReadLine(line, MAX_HEADER_LINE)) {
+                            return false;
+                        }
+                    } while (!line.empty());
+                    return true;
+                }
+                size_t remaining = static_cast<size_t>(size);
+                while (remaining > 0) {
+                    ssize_t n = reader.ReadSome(buffer, std::min(sizeof(buffer), remaining));
+                    if (n <= 0) {
+                        return false;
+                    }
+                    if (!sink(buffer, static_cast<size_t>(n))) {
+                        return false;
+                    }
+                    remaining -= static_cast<size_t>(n);
+                }
+                if (!reader.ReadLine(line, 2) || !line.empty()) {
+                    return false;
+                }
+            }
+        }
+
+        case BodyFraming::CLOSE:
+            while (true) {
+                ssize_t n = reader.ReadSome(buffer, sizeof(buffer));
+                if (n == 0) {
+                    return true;
+                }
+                if (n < 0 || !sink(buffer, static_cast<size_t>(n))) {
+                    return false;
+                }
+            }
+    }
+    return false;
+}
+
+// ==================== 写出 ====================
+
+const char* ReasonPhrase(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return status < 400 ? "OK" : "Error";
+    }
+}
+
+bool WriteChunk(Stream& stream, const char* data, size_t length) {
+    char size_line[24];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+    if (length == 0) {
+        return stream.WriteAll("0\r\n\r\n", 5);
+    }
+    std::string chunk;
+    chunk.reserve(static_cast<size_t>(n) + length + 2);
+    chunk.append(size_line, static_cast<size_t>(n));
+    chunk.append(data, length);
+    chunk.append("\r\n", 2);
+    return stream.WriteAll(chunk);
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,72 @@
+#ifndef HTTP_MESSAGE_H
+#define HTTP_MESSAGE_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "net_stream.h"
+
+namespace EvoSpark {
+
+// 请求头 / 响应头（名字不区分大小写，保留原顺序）
+class HttpHeaders {
+public:
+    const std::string* Find(const char* name) const;
+    std::string Get(const char* name, const std::string& fallback = "") const;
+    void Add(std::string name, std::string value) { items_.emplace_back(std::move(name), std::move(value)); }
+    void Remove(const char* name);
+
+    // 逗号分隔的值里是否有 token（如 Connection: keep-alive, Cache-Control: no-store）
+    bool HasToken(const char* name, const char* token) const;
+
+    const std::vector<std::pair<std::string, std::string>>& Items() const { return items_; }
+
+private:
+    std::vector<std::pair<std::string, std::string>> items_;
+};
+
+// 消息体的分帧方式
+enum class BodyFraming {
+    NONE,           // 没有消息体
+    LENGTH,         // Content-Length
+    CHUNKED,        // Transfer-Encoding: chunked
+    CLOSE,          // 读到连接关闭（只用于响应）
+};
+
+struct HttpRequest {
+    std::string method;
+    std::string target;
+    HttpHeaders headers;
+    std::string body;         // 已去掉分块编码
+    bool keep_alive = true;
+};
+
+struct HttpResponseHead {
+    int status = 0;
+    HttpHeaders headers;
+    BodyFraming framing = BodyFraming::NONE;
+    size_t content_length = 0;
+    bool keep_alive = true;
+};
+
+// 读请求；失败时 error_status 为应回复的状态码（0 表示连接已断，不必回复）
+bool ReadRequest(BufferedReader& reader, HttpRequest& request, size_t max_body, int& error_status);
+
+// 读响应行和响应头；request_method 为 HEAD 时没有消息体
+bool ReadResponseHead(BufferedReader& reader, HttpResponseHead& head, const std::string& request_method);
+
+// 按分帧读完消息体，每段数据交给 sink（返回 false 时中止）；返回是否完整读完
+using BodySink = std::function<bool(const char* data, size_t length)>;
+bool ReadBody(BufferedReader& reader, BodyFraming framing, size_t content_length, const BodySink& sink);
+
+// 状态行原因短语
+const char* ReasonPhrase(int status);
+
+// 写一段分块编码的数据（length 为 0 时写结束块）
+bool WriteChunk(Stream& stream, const char* data, size_t length);
+
+} // namespace EvoSpark
+
+#endif // HTTP_MESSAGE_H
@@ -0,0 +1,120 @@
+#include "relay_log.h"
+#include "relay_server.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <thread>
+
+using namespace EvoSpark;
+
+static const char* TAG = "main";
+
+static void Usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --host ADDR            listen address (default 0.0.0.0)\n"
+            "  --port N               listen port (default 8080)\n"
+            "  --upstream URL         upstream base URL (default https://open.bigmodel.cn/api/paas/v4)\n"
+            "  --upstream-key KEY     upstream API key (default $EVOSPARK_UPSTREAM_KEY)\n"
+            "  --max-upstream N       upstream connection limit (default 32)\n"
+            "  --insecure             skip upstream certificate checks\n"
+            "  --devices FILE         device table: <token> <name> [daily_tokens] [rpm] [concurrency]\n"
+            "  --daily-tokens N       default daily token quota (0 = unlimited)\n"
+            "  --rpm N                default requests per minute (0 = unlimited)\n"
+            "  --concurrency N        default concurrent requests per device (0 = unlimited)\n"
+            "  --cache-ttl S          shared cache TTL in seconds, 0 disables (default 300)\n"
+            "  --cache-mb N           shared cache size (default 64)\n"
+            "  --no-coalesce          do not share in-flight upstream requests\n"
+            "  -v, --verbose          debug logging (per request)\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    RelayOptions options;
+    if (const char* key = getenv("EVOSPARK_UPSTREAM_KEY")) {
+        options.upstream_key = key;
+    }
+    options.default_quota.requests_per_minute = 60;
+    options.default_quota.concurrency = 4;
+
+    enum {
+        OPT_HOST = 1000, OPT_PORT, OPT_UPSTREAM, OPT_UPSTREAM_KEY, OPT_MAX_UPSTREAM, OPT_INSECURE,
+        OPT_DEVICES, OPT_DAILY_TOKENS, OPT_RPM, OPT_CONCURRENCY, OPT_CACHE_TTL, OPT_CACHE_MB, OPT_NO_COALESCE,
+    };
+    static const struct option LONG_OPTIONS[] = {
+        {"host", required_argument, nullptr, OPT_HOST},
+        {"port", required_argument, nullptr, OPT_PORT},
+        {"upstream", required_argument, nullptr, OPT_UPSTREAM},
+        {"upstream-key", required_argument, nullptr, OPT_UPSTREAM_KEY},
+        {"max-upstream", required_argument, nullptr, OPT_MAX_UPSTREAM},
+        {"insecure", no_argument, nullptr, OPT_INSECURE},
+        {"devices", required_argument, nullptr, OPT_DEVICES},
+        {"daily-tokens", required_argument, nullptr, OPT_DAILY_TOKENS},
+        {"rpm", required_argument, nullptr, OPT_RPM},
+        {"concurrency", required_argument, nullptr, OPT_CONCURRENCY},
+        {"cache-ttl", required_argument, nullptr, OPT_CACHE_TTL},
+        {"cache-mb", required_argument, nullptr, OPT_CACHE_MB},
+        {"no-coalesce", no_argument, nullptr, OPT_NO_COALESCE},
+        {"verbose", no_argument, nullptr, 'v'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "vh", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case OPT_HOST: options.listen_host = optarg; break;
+            case OPT_PORT: options.port = atoi(optarg); break;
+            case OPT_UPSTREAM: options.upstream_url = optarg; break;
+            case OPT_UPSTREAM_KEY: options.upstream_key = optarg; break;
+            case OPT_MAX_UPSTREAM: options.upstream.max_connections = std::max(1, atoi(optarg)); break;
+            case OPT_INSECURE: options.upstream.insecure = true; break;
+            case OPT_DEVICES: options.devices_file = optarg; break;
+            case OPT_DAILY_TOKENS: options.default_quota.daily_tokens = strtoul(optarg, nullptr, 10); break;
+            case OPT_RPM: options.default_quota.requests_per_minute = strtoul(optarg, nullptr, 10); break;
+            case OPT_CONCURRENCY: options.default_quota.concurrency = strtoul(optarg, nullptr, 10); break;
+            case OPT_CACHE_TTL: options.cache_ttl_s = atoi(optarg); break;
+            case OPT_CACHE_MB: options.cache_bytes = static_cast<size_t>(atoi(optarg)) << 20; break;
+            case OPT_NO_COALESCE: options.coalesce = false; break;
+            case 'v': g_log_level = 3; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (options.upstream_key.empty()) {
+        RELAY_LOGW(TAG, "No upstream key (--upstream-key or EVOSPARK_UPSTREAM_KEY); forwarding without Authorization");
+    }
+
+    // 信号交给专门的线程处理，其余线程都屏蔽
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    RelayServer server(options);
+    std::string error;
+    if (!server.Start(error)) {
+        RELAY_LOGE(TAG, "%s", error.c_str());
+        return 1;
+    }
+
+    std::thread([&server, signals]() {
+        int received = 0;
+        sigwait(&signals, &received);
+        RELAY_LOGI(TAG, "Signal %d, shutting down", received);
+        server.Stop();
+    }).detach();
+
+    server.Run();
+
+    RelayStats stats = server.GetStats();
+    RELAY_LOGI(TAG, "%llu requests, %llu upstream tokens, %llu saved by sharing",
+               static_cast<unsigned long long>(stats.requests),
+               static_cast<unsigned long long>(stats.tokens_upstream),
+               static_cast<unsigned long long>(stats.tokens_saved));
+    return 0;
+}
@@ -0,0 +1,291 @@
+#include "net_stream.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+namespace EvoSpark {
+
+namespace {
+
+void ApplySocketTimeout(int fd, int timeout_ms) {
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+std::string OpenSslError() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown TLS error";
+    }
+    char text[256];
+    ERR_error_string_n(code, text, sizeof(text));
+    ERR_clear_error();
+    return text;
+}
+
+} // namespace
+
+// ==================== 明文 TCP ====================
+
+SocketStream::~SocketStream() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+ssize_t SocketStream::Read(char* buffer, size_t size) {
+    while (true) {
+        ssize_t n = recv(fd_, buffer, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n;
+    }
+}
+
+bool SocketStream::WriteAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd_, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void SocketStream::SetTimeout(int timeout_ms) {
+    ApplySocketTimeout(fd_, timeout_ms);
+}
+
+void SocketStream::Shutdown() {
+    shutdown(fd_, SHUT_RDWR);
+}
+
+// ==================== TLS ====================
+
+TlsStream::~TlsStream() {
+    SSL_free(ssl_);
+    close(fd_);
+}
+
+ssize_t TlsStream::Read(char* buffer, size_t size) {
+    int n = SSL_read(ssl_, buffer, static_cast<int>(size));
+    if (n > 0) {
+        return n;
+    }
+    int error = SSL_get_error(ssl_, n);
+    if (error == SSL_ERROR_ZERO_RETURN) {
+        return 0;
+    }
+    ERR_clear_error();
+    return -1;
+}
+
+bool TlsStream::WriteAll(const char* data, size_t size) {
+    while (size > 0) {
+        int n = SSL_write(ssl_, data, static_cast<int>(size));
+        if (n <= 0) {
+            ERR_clear_error();
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void TlsStream::SetTimeout(int timeout_ms) {
+    ApplySocketTimeout(fd_, timeout_ms);
+}
+
+void TlsStream::Shutdown() {
+    shutdown(fd_, SHUT_RDWR);
+}
+
+// ==================== 连接 ====================
+
+int ConnectTcp(const std::string& host, int port, int timeout_ms, std::string& error) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(port);
+    int ret = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+    if (ret != 0) {
+        error = std::string("resolve failed: ") + gai_strerror(ret);
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        // 非阻塞连接，poll 等到超时
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc < 0 && errno == EINPROGRESS) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            rc = poll(&pfd, 1, timeout_ms) == 1 ? 0 : -1;
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            if (rc == 0 && (getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0 || so_error)) {
+                errno = so_error;
+                rc = -1;
+            }
+        }
+        if (rc == 0) {
+            fcntl(fd, F_SETFL, flags);
+            break;
+        }
+        error = std::string("connect failed: ") + strerror(errno ? errno : ETIMEDOUT);
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        ApplySocketTimeout(fd, timeout_ms);
+    }
+    return fd;
+}
+
+TlsClient::TlsClient() {
+    ctx_ = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    SSL_CTX_set_default_verify_paths(ctx_);
+    SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+    // TLS 1.3 的票据在握手之后才到，由回调记下
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_set_app_data(ctx_, this);
+    SSL_CTX_sess_set_new_cb(ctx_, &TlsClient::OnNewSession);
+}
+
+int TlsClient::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+    TlsClient* self = static_cast<TlsClient*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!self || !host) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    SSL_SESSION*& slot = self->sessions_[host];
+    if (slot) {
+        SSL_SESSION_free(slot);
+    }
+    slot = session;
+    return 1;   // 会话归我们所有
+}
+
+TlsClient::~TlsClient() {
+    for (auto& entry : sessions_) {
+        SSL_SESSION_free(entry.second);
+    }
+    SSL_CTX_free(ctx_);
+}
+
+std::unique_ptr<Stream> TlsClient::Handshake(int fd, const std::string& host, int timeout_ms,
+                                             bool& resumed, std::string& error) {
+    resumed = false;
+    SSL* ssl = SSL_new(ctx_);
+    SSL_set_fd(ssl, fd);
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+    if (insecure_) {
+        SSL_set_verify(ssl, SSL_VERIFY_NONE, nullptr);
+    } else {
+        SSL_set1_host(ssl, host.c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(host);
+        if (it != sessions_.end()) {
+            SSL_set_session(ssl, it->second);
+        }
+    }
+
+    ApplySocketTimeout(fd, timeout_ms);
+    if (SSL_connect(ssl) != 1) {
+        error = "TLS handshake failed: " + OpenSslError();
+        SSL_free(ssl);
+        close(fd);
+        return nullptr;
+    }
+    resumed = SSL_session_reused(ssl) == 1;
+    return std::unique_ptr<Stream>(new TlsStream(ssl, fd));
+}
+
+// ==================== 缓冲读取 ====================
+
+bool BufferedReader::Fill() {
+    if (begin_ > 0) {
+        memmove(buffer_, buffer_ + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == sizeof(buffer_)) {
+        return false;
+    }
+    ssize_t n = stream_.Read(buffer_ + end_, sizeof(buffer_) - end_);
+    if (n <= 0) {
+        return false;
+    }
+    end_ += static_cast<size_t>(n);
+    return true;
+}
+
+bool BufferedReader::ReadLine(std::string& line, size_t max_length) {
+    line.clear();
+    while (true) {
+        char* start = buffer_ + begin_;
+        char* newline = static_cast<char*>(memchr(start, '\n', end_ - begin_));
+        if (newline) {
+            size_t length = static_cast<size_t>(newline - start);
+            line.append(start, length);
+            begin_ += length + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return line.size() <= max_length;
+        }
+        line.append(start, end_ - begin_);
+        begin_ = end_ = 0;
+        if (line.size() > max_length || !Fill()) {
+            return false;
+        }
+    }
+}
+
+ssize_t BufferedReader::ReadSome(char* buffer, size_t size) {
+    if (begin_ < end_) {
+        size_t n = std::min(size, end_ - begin_);
+        memcpy(buffer, buffer_ + begin_, n);
+        begin_ += n;
+        return static_cast<ssize_t>(n);
+    }
+    return stream_.Read(buffer, size);
+}
+
+} // namespace EvoSpark
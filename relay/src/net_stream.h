@@ -0,0 +1,125 @@
+#ifndef NET_STREAM_H
+#define NET_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
+
+namespace EvoSpark {
+
+// 双向字节流（明文 TCP 或 TLS）
+class Stream {
+public:
+    virtual ~Stream() = default;
+
+    // 读到的字节数；对端关闭返回 0，出错或超时返回 -1
+    virtual ssize_t Read(char* buffer, size_t size) = 0;
+
+    // 全部写出才返回 true
+    virtual bool WriteAll(const char* data, size_t size) = 0;
+
+    bool WriteAll(const std::string& data) { return WriteAll(data.data(), data.size()); }
+
+    // 读写超时（毫秒，0 为不限）
+    virtual void SetTimeout(int timeout_ms) = 0;
+
+    // 从其他线程打断阻塞中的读写（不释放资源）
+    virtual void Shutdown() = 0;
+};
+
+class SocketStream : public Stream {
+public:
+    explicit SocketStream(int fd) : fd_(fd) {}
+    ~SocketStream() override;
+
+    ssize_t Read(char* buffer, size_t size) override;
+    bool WriteAll(const char* data, size_t size) override;
+    using Stream::WriteAll;
+    void SetTimeout(int timeout_ms) override;
+    void Shutdown() override;
+
+    int Fd() const { return fd_; }
+
+private:
+    int fd_;
+};
+
+class TlsStream : public Stream {
+public:
+    TlsStream(SSL* ssl, int fd) : ssl_(ssl), fd_(fd) {}
+    ~TlsStream() override;
+
+    ssize_t Read(char* buffer, size_t size) override;
+    bool WriteAll(const char* data, size_t size) override;
+    using Stream::WriteAll;
+    void SetTimeout(int timeout_ms) override;
+    void Shutdown() override;
+
+private:
+    SSL* ssl_;
+    int fd_;
+};
+
+// 建立 TCP 连接（带超时，关闭 Nagle），失败返回 -1 并写 error
+int ConnectTcp(const std::string& host, int port, int timeout_ms, std::string& error);
+
+// TLS 客户端上下文：校验证书和主机名，按主机记住最近的会话票据，
+// 新连接带上票据做会话恢复（省一次往返和证书校验）
+class TlsClient {
+public:
+    TlsClient();
+    ~TlsClient();
+
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+
+    // 在已连接的 fd 上握手；成功后 fd 归返回的流所有
+    std::unique_ptr<Stream> Handshake(int fd, const std::string& host, int timeout_ms,
+                                      bool& resumed, std::string& error);
+
+    // 不校验证书（只用于自签名的测试服务端）
+    void SetInsecure(bool insecure) { insecure_ = insecure; }
+
+private:
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+
+    SSL_CTX* ctx_ = nullptr;
+    bool insecure_ = false;
+    std::map<std::string, SSL_SESSION*> sessions_;
+    std::mutex mutex_;
+};
+
+// 带缓冲的读取（HTTP 解析用）
+class BufferedReader {
+public:
+    explicit BufferedReader(Stream& stream) : stream_(stream) {}
+
+    // 读一行（去掉行尾的 \r\n）；超过 max_length 或连接断开返回 false
+    bool ReadLine(std::string& line, size_t max_length = 8192);
+
+    // 先取缓冲区里的数据，没有再读一次流；语义同 Stream::Read
+    ssize_t ReadSome(char* buffer, size_t size);
+
+    // 缓冲区里还有未取走的字节（keep-alive 连接上多余的数据说明对端不守规矩）
+    size_t Buffered() const { return end_ - begin_; }
+
+private:
+    bool Fill();
+
+    Stream& stream_;
+    char buffer_[16384];
+    size_t begin_ = 0;
+    size_t end_ = 0;
+};
+
+} // namespace EvoSpark
+
+#endif // NET_STREAM_H
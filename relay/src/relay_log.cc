@@ -0,0 +1,38 @@
+#include "relay_log.h"
+#include <cstdarg>
+#include <mutex>
+
+namespace EvoSpark {
+
+int g_log_level = 2;
+
+int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void LogWrite(int level, const char* tag, const char* format, ...) {
+    if (level > g_log_level) {
+        return;
+    }
+    static const char LEVELS[] = "EWID";
+    static std::mutex mutex;
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    struct tm tm;
+    localtime_r(&tv.tv_sec, &tm);
+
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    fprintf(stderr, "%c (%02d:%02d:%02d.%03d) %s: %s\n", LEVELS[level], tm.tm_hour, tm.tm_min,
+            tm.tm_sec, static_cast<int>(tv.tv_usec / 1000), tag, message);
+}
+
+} // namespace EvoSpark
@@ -0,0 +1,27 @@
+#ifndef RELAY_LOG_H
+#define RELAY_LOG_H
+
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <sys/time.h>
+
+namespace EvoSpark {
+
+// 单调时钟（微秒），用于计时和过期判断
+int64_t NowUs();
+
+// 日志级别：0 错误，1 警告，2 信息，3 调试
+extern int g_log_level;
+
+void LogWrite(int level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+} // namespace EvoSpark
+
+// 与固件的 ESP_LOGx 用法一致
+#define RELAY_LOGE(tag, ...) ::EvoSpark::LogWrite(0, tag, __VA_ARGS__)
+#define RELAY_LOGW(tag, ...) ::EvoSpark::LogWrite(1, tag, __VA_ARGS__)
+#define RELAY_LOGI(tag, ...) ::EvoSpark::LogWrite(2, tag, __VA_ARGS__)
+#define RELAY_LOGD(tag, ...) ::EvoSpark::LogWrite(3, tag, __VA_ARGS__)
+
+#endif // RELAY_LOG_H
@@ -0,0 +1,558 @@
+#include "relay_server.h"
+#include "completion_parser.h"
+#include "json_codec.h"
+#include "relay_log.h"
+#include "sse_parser.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace EvoSpark {
+
+static const char* TAG = "RelayServer";
+
+namespace {
+
+// 从上游响应里取 usage：流式响应逐个事件解析（usage 在最后一个事件），
+// 完整响应结束后解析一次。上游没给 usage 时按字节粗略估计（约 4 字节 1 token）
+class UsageMeter {
+public:
+    explicit UsageMeter(bool streaming)
+        : streaming_(streaming), sse_([this](const std::string& data) { OnEvent(data); }) {}
+
+    void Feed(const char* data, size_t length) {
+        if (streaming_) {
+            sse_.Feed(data, length);
+        }
+    }
+
+    uint64_t Tokens(const std::string& body, size_t request_bytes) {
+        if (streaming_) {
+            sse_.Finish();
+        } else {
+            CompletionHandler handler("message", content_, usage_);
+            reader_.Parse(body, handler);
+            content_bytes_ = content_.size();
+        }
+        if (usage_.present && usage_.total_tokens > 0) {
+            return static_cast<uint64_t>(usage_.total_tokens);
+        }
+        return (request_bytes + content_bytes_) / 4;
+    }
+
+private:
+    void OnEvent(const std::string& data) {
+        if (data == "[DONE]") {
+            return;
+        }
+        CompletionHandler handler("delta", content_, usage_);
+        if (reader_.Parse(data, handler) == JsonParseError::NONE && handler.FoundContent()) {
+            content_bytes_ += content_.size();
+        }
+    }
+
+    bool streaming_;
+    SseParser sse_;
+    JsonReader reader_;
+    std::string content_;
+    CompletionUsage usage_;
+    size_t content_bytes_ = 0;
+};
+
+// OpenAI 风格的错误响应（LLMClient 的 retry_policy 按状态码处理，429 会按 Retry-After 重试）
+bool SendError(Stream& client, int status, const char* type, const std::string& message,
+               uint32_t retry_after_s, bool keep_alive) {
+    std::string body;
+    JsonWriteTo(body, [&](auto& json) {
+        json.BeginObject();
+        json.Key("error");
+        json.BeginObject();
+        json.Field("message", message);
+        json.Field("type", type);
+        json.EndObject();
+        json.EndObject();
+    });
+
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + ReasonPhrase(status) + "\r\n";
+    response += "Content-Type: application/json\r\n";
+    if (retry_after_s > 0) {
+        response += "Retry-After: " + std::to_string(retry_after_s) + "\r\n";
+    }
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    response += body;
+    return client.WriteAll(response) && keep_alive;
+}
+
+std::string ResponseHead(const Flight::Head& head, const char* cache_state, size_t content_length) {
+    std::string response = "HTTP/1.1 " + std::to_string(head.status) + " " + ReasonPhrase(head.status) + "\r\n";
+    if (!head.content_type.empty()) {
+        response += "Content-Type: " + head.content_type + "\r\n";
+    }
+    if (!head.retry_after.empty()) {
+        response += "Retry-After: " + head.retry_after + "\r\n";
+    }
+    response += "X-Relay-Cache: ";
+    response += cache_state;
+    response += "\r\n";
+    if (head.streaming) {
+        response += "Transfer-Encoding: chunked\r\nCache-Control: no-cache\r\n";
+    } else {
+        response += "Content-Length: " + std::to_string(content_length) + "\r\n";
+    }
+    response += "Connection: keep-alive\r\n\r\n";
+    return response;
+}
+
+// 转发给上游时去掉的请求头：逐跳的、由连接池重写的、以及设备的凭据
+bool IsDroppedHeader(const std::string& name) {
+    static const char* const DROPPED[] = {
+        "Host", "Authorization", "Connection", "Keep-Alive", "Proxy-Connection", "Transfer-Encoding",
+        "Content-Length", "Accept-Encoding", "TE", "Upgrade", "Expect",
+    };
+    for (const char* dropped : DROPPED) {
+        if (strcasecmp(name.c_str(), dropped) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string BearerToken(const HttpHeaders& headers) {
+    std::string value = headers.Get("Authorization");
+    if (value.size() > 7 && strncasecmp(value.c_str(), "Bearer ", 7) == 0) {
+        return value.substr(7);
+    }
+    return "";
+}
+
+} // namespace
+
+RelayServer::RelayServer(const RelayOptions& options)
+    : options_(options),
+      registry_(options.default_quota),
+      cache_(options.cache_ttl_s, options.cache_bytes, options.coalesce) {}
+
+RelayServer::~RelayServer() {
+    Stop();
+}
+
+bool RelayServer::Start(std::string& error) {
+    UpstreamTarget target;
+    if (!ParseBaseUrl(options_.upstream_url, target)) {
+        error = "bad upstream URL: " + options_.upstream_url;
+        return false;
+    }
+    if (!options_.devices_file.empty() && !registry_.Load(options_.devices_file, error)) {
+        return false;
+    }
+    upstream_ = std::make_unique<UpstreamPool>(target, options_.upstream);
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* result = nullptr;
+    std::string port = std::to_string(options_.port);
+    int rc = getaddrinfo(options_.listen_host.empty() ? nullptr : options_.listen_host.c_str(),
+                         port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = std::string("resolve listen address: ") + gai_strerror(rc);
+        return false;
+    }
+    listen_fd_ = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    int on = 1;
+    if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(listen_fd_, result->ai_addr, result->ai_addrlen) != 0 || listen(listen_fd_, 512) != 0) {
+        error = std::string("listen on port ") + port + ": " + strerror(errno);
+        freeaddrinfo(result);
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+            listen_fd_ = -1;
+        }
+        return false;
+    }
+    freeaddrinfo(result);
+
+    start_us_ = NowUs();
+    running_ = true;
+    RELAY_LOGI(TAG, "Listening on %s:%d, upstream %s://%s:%d%s (%d connections max)",
+               options_.listen_host.c_str(), options_.port, target.tls ? "https" : "http",
+               target.host.c_str(), target.port, target.base_path.c_str(), options_.upstream.max_connections);
+    return true;
+}
+
+void RelayServer::Run() {
+    while (running_) {
+        struct sockaddr_storage addr;
+        socklen_t addr_length = sizeof(addr);
+        int fd = accept(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), &addr_length);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (running_) {
+                RELAY_LOGE(TAG, "accept: %s", strerror(errno));
+            }
+            break;
+        }
+
+        if (clients_ >= static_cast<uint32_t>(options_.max_clients)) {
+            RELAY_LOGW(TAG, "Too many clients, refusing connection");
+            close(fd);
+            continue;
+        }
+
+        char host[INET6_ADDRSTRLEN] = "?";
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in*>(&addr)->sin_addr, host, sizeof(host));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_addr, host, sizeof(host));
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            if (!running_) {
+                close(fd);
+                break;
+            }
+            client_fds_.insert(fd);
+        }
+        connections_++;
+        clients_++;
+        std::thread(&RelayServer::ServeClient, this, fd, std::string(host)).detach();
+    }
+
+    // 连接线程都用着本对象，全部退出后才能返回（返回后 main 会析构 server）
+    std::unique_lock<std::mutex> lock(clients_mutex_);
+    if (clients_ > 0) {
+        RELAY_LOGI(TAG, "Waiting for %u client connections to close", static_cast<unsigned>(clients_.load()));
+    }
+    clients_done_.wait(lock, [this]() { return clients_ == 0; });
+}
+
+void RelayServer::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    if (listen_fd_ >= 0) {
+        shutdown(listen_fd_, SHUT_RDWR);
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    // 只 shutdown 不 close：fd 仍归连接线程所有，阻塞中的读写立即返回，
+    // 线程随后自行退出并关闭
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (int fd : client_fds_) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void RelayServer::ServeClient(int fd, const std::string& peer) {
+    {
+        SocketStream client(fd);
+        client.SetTimeout(options_.client_idle_ms);
+        BufferedReader reader(client);
+
+        RELAY_LOGD(TAG, "Client %s connected", peer.c_str());
+        while (running_) {
+            HttpRequest request;
+            int error_status = 0;
+            if (!ReadRequest(reader, request, options_.max_body, error_status)) {
+                if (error_status != 0) {
+                    SendError(client, error_status, "invalid_request_error", ReasonPhrase(error_status), 0, false);
+                }
+                break;
+            }
+            requests_++;
+            if (!HandleRequest(client, request, peer) || !request.keep_alive) {
+                break;
+            }
+        }
+        RELAY_LOGD(TAG, "Client %s disconnected", peer.c_str());
+
+        // 关闭 fd 之前撤下，Stop 不会 shutdown 到被复用的 fd
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        client_fds_.erase(fd);
+    }
+
+    // 持锁通知：Run 醒来时本线程已不再访问本对象
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    clients_--;
+    clients_done_.notify_all();
+}
+
+bool RelayServer::HandleRequest(Stream& client, const HttpRequest& request, const std::string& peer) {
+    const std::string& target = request.target;
+    if (target.compare(0, 4, "/v1/") == 0) {
+        return Proxy(client, request);
+    }
+    if (request.method == "GET" && target == "/relay/stats") {
+        return SendStats(client, request.keep_alive);
+    }
+    if (request.method == "GET" && target == "/healthz") {
+        return client.WriteAll("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 3\r\n"
+                               "Connection: keep-alive\r\n\r\nok\n");
+    }
+    RELAY_LOGD(TAG, "%s %s from %s: not found", request.method.c_str(), target.c_str(), peer.c_str());
+    return SendError(client, 404, "invalid_request_error", "unknown endpoint " + target, 0, true);
+}
+
+bool RelayServer::Proxy(Stream& client, const HttpRequest& request) {
+    std::string device;
+    uint32_t retry_after_s = 0;
+    Admission admission = registry_.Begin(BearerToken(request.headers), device, retry_after_s);
+    if (admission != Admission::OK) {
+        rejected_++;
+        if (admission == Admission::UNKNOWN_DEVICE) {
+            return SendError(client, 401, "invalid_api_key", "unknown device token", 0, true);
+        }
+        RELAY_LOGD(TAG, "%s: %s, retry after %us", device.c_str(), AdmissionToString(admission),
+                   static_cast<unsigned>(retry_after_s));
+        return SendError(client, 429, "rate_limit_exceeded",
+                         std::string("device ") + AdmissionToString(admission) + " exceeded", retry_after_s, true);
+    }
+
+    // Cache-Control: no-cache 的请求一定要请求上游；no-store 的响应也不进缓存
+    bool no_store = request.headers.HasToken("Cache-Control", "no-store");
+    bool shareable = !no_store && !request.headers.HasToken("Cache-Control", "no-cache") &&
+                     (request.method == "POST" || request.method == "GET");
+    std::string key = ResponseCache::MakeKey(request.method, request.target,
+                                             request.headers.Get("Content-Encoding"), request.body);
+
+    ResponseCache::Role role;
+    std::shared_ptr<Flight> flight = cache_.Join(key, device, shareable, role);
+    const char* cache_state = ResponseCache::RoleToString(role);
+
+    bool keep_alive;
+    uint64_t tokens = 0;
+    bool shared = role == ResponseCache::Role::FOLLOWER || role == ResponseCache::Role::HIT;
+    if (shared) {
+        keep_alive = Replay(client, flight, cache_state);
+        tokens = flight->Tokens();
+        tokens_saved_ += tokens;
+    } else {
+        keep_alive = FetchUpstream(client, request, flight, cache_state, !no_store, tokens);
+        cache_.Complete(key, flight);
+        tokens_upstream_ += tokens;
+    }
+    registry_.End(device, tokens, shared);
+    RELAY_LOGD(TAG, "%s %s %s -> %s, %llu tokens", device.c_str(), request.method.c_str(),
+               request.target.c_str(), cache_state, static_cast<unsigned long long>(tokens));
+    return keep_alive;
+}
+
+bool RelayServer::FetchUpstream(Stream& client, const HttpRequest& request, const std::shared_ptr<Flight>& flight,
+                                const char* cache_state, bool store, uint64_t& tokens) {
+    HttpHeaders headers;
+    for (const auto& item : request.headers.Items()) {
+        if (!IsDroppedHeader(item.first)) {
+            headers.Add(item.first, item.second);
+        }
+    }
+    if (!options_.upstream_key.empty()) {
+        headers.Add("Authorization", "Bearer " + options_.upstream_key);
+    }
+    // 要明文响应：中继要从响应里读 usage 记账，局域网里也不需要压缩
+    headers.Add("Accept-Encoding", "identity");
+    std::string path = upstream_->Target().base_path + request.target.substr(3);
+
+    Flight::Head head;
+    bool head_sent = false;
+    bool client_ok = true;                  // 设备断开后继续读完，跟随者还在等
+    std::unique_ptr<UsageMeter> meter;
+
+    auto on_head = [&](const HttpResponseHead& response) {
+        head.status = response.status;
+        head.content_type = response.headers.Get("Content-Type");
+        head.retry_after = response.headers.Get("Retry-After");
+        head.streaming = head.content_type.find("text/event-stream") != std::string::npos;
+        bool cacheable = store && !response.headers.HasToken("Cache-Control", "no-store") &&
+                         !response.headers.HasToken("Cache-Control", "private");
+        flight->SetHead(head.status, head.content_type, head.retry_after, head.streaming, cacheable);
+        meter = std::make_unique<UsageMeter>(head.streaming);
+        if (head.streaming) {
+            client_ok = client.WriteAll(ResponseHead(head, cache_state, 0));
+            head_sent = true;
+        }
+        return true;
+    };
+    auto on_body = [&](const char* data, size_t length) {
+        flight->Append(data, length);
+        if (head.status == 200) {
+            meter->Feed(data, length);
+        }
+        if (head.streaming && client_ok) {
+            client_ok = WriteChunk(client, data, length);
+        }
+        return true;
+    };
+
+    std::string error;
+    int status = upstream_->Exchange(request.method, path, headers, request.body, on_head, on_body, error);
+
+    std::string body;
+    bool finished = false;
+    bool complete = false;
+    if (status > 0) {
+        flight->WaitData(0, body, finished, complete);   // 领头请求自己写的，不会阻塞
+        tokens = head.status == 200 ? meter->Tokens(body, request.body.size()) : 0;
+    }
+    flight->Finish(status > 0, tokens);
+
+    if (status <= 0) {
+        upstream_errors_++;
+        RELAY_LOGW(TAG, "Upstream %s %s failed: %s", request.method.c_str(), path.c_str(), error.c_str());
+        if (head_sent) {
+            return false;                   // 流已经开始，只能断开让设备看到不完整
+        }
+        return SendError(client, 502, "upstream_error", error, 0, true);
+    }
+    if (status >= 500) {
+        upstream_errors_++;
+    }
+
+    if (head.streaming) {
+        return client_ok && WriteChunk(client, nullptr, 0);
+    }
+    return client.WriteAll(ResponseHead(head, cache_state, body.size()) + body);
+}
+
+bool RelayServer::Replay(Stream& client, const std::shared_ptr<Flight>& flight, const char* cache_state) {
+    Flight::Head head;
+    if (!flight->WaitHead(head)) {
+        return SendError(client, 502, "upstream_error", "shared upstream request failed", 0, true);
+    }
+
+    std::string data;
+    bool finished = false;
+    bool complete = false;
+    if (!head.streaming) {
+        do {
+            flight->WaitData(0, data, finished, complete);
+        } while (!finished);
+        if (!complete) {
+            return SendError(client, 502, "upstream_error", "shared upstream request failed", 0, true);
+        }
+        return client.WriteAll(ResponseHead(head, cache_state, data.size()) + data);
+    }
+
+    if (!client.WriteAll(ResponseHead(head, cache_state, 0))) {
+        return false;
+    }
+    size_t offset = 0;
+    while (true) {
+        flight->WaitData(offset, data, finished, complete);
+        if (!data.empty()) {
+            if (!WriteChunk(client, data.data(), data.size())) {
+                return false;
+            }
+            offset += data.size();
+        }
+        if (finished) {
+            return complete && WriteChunk(client, nullptr, 0);
+        }
+    }
+}
+
+RelayStats RelayServer::GetStats() const {
+    RelayStats stats;
+    stats.connections = connections_;
+    stats.clients = clients_;
+    stats.requests = requests_;
+    stats.rejected = rejected_;
+    stats.upstream_errors = upstream_errors_;
+    stats.tokens_upstream = tokens_upstream_;
+    stats.tokens_saved = tokens_saved_;
+    return stats;
+}
+
+bool RelayServer::SendStats(Stream& client, bool keep_alive) {
+    RelayStats relay = GetStats();
+    UpstreamStats upstream = upstream_->GetStats();
+    CacheStats cache = cache_.GetStats();
+    std::vector<DeviceSnapshot> devices = registry_.GetSnapshots();
+
+    std::string body;
+    JsonWriteTo(body, [&](auto& json) {
+        json.BeginObject();
+        json.Field("uptime_s", static_cast<unsigned long long>((NowUs() - start_us_) / 1000000));
+
+        json.Key("relay");
+        json.BeginObject();
+        json.Field("connections", static_cast<unsigned long long>(relay.connections));
+        json.Field("clients", relay.clients);
+        json.Field("requests", static_cast<unsigned long long>(relay.requests));
+        json.Field("rejected", static_cast<unsigned long long>(relay.rejected));
+        json.Field("upstream_errors", static_cast<unsigned long long>(relay.upstream_errors));
+        json.Field("tokens_upstream", static_cast<unsigned long long>(relay.tokens_upstream));
+        json.Field("tokens_saved", static_cast<unsigned long long>(relay.tokens_saved));
+        json.EndObject();
+
+        json.Key("upstream");
+        json.BeginObject();
+        json.Field("connections_opened", static_cast<unsigned long long>(upstream.connections_opened));
+        json.Field("tls_handshakes", static_cast<unsigned long long>(upstream.tls_handshakes));
+        json.Field("tls_resumed", static_cast<unsigned long long>(upstream.tls_resumed));
+        json.Field("connect_failures", static_cast<unsigned long long>(upstream.connect_failures));
+        json.Field("requests", static_cast<unsigned long long>(upstream.requests));
+        json.Field("reused_requests", static_cast<unsigned long long>(upstream.reused_requests));
+        json.Field("stale_retries", static_cast<unsigned long long>(upstream.stale_retries));
+        json.Field("queued", static_cast<unsigned long long>(upstream.queued));
+        json.Field("failures", static_cast<unsigned long long>(upstream.failures));
+        json.Field("active", upstream.active);
+        json.Field("idle", upstream.idle);
+        json.EndObject();
+
+        json.Key("cache");
+        json.BeginObject();
+        json.Field("hits", static_cast<unsigned long long>(cache.hits));
+        json.Field("coalesced", static_cast<unsigned long long>(cache.coalesced));
+        json.Field("misses", static_cast<unsigned long long>(cache.misses));
+        json.Field("bypassed", static_cast<unsigned long long>(cache.bypassed));
+        json.Field("stored", static_cast<unsigned long long>(cache.stored));
+        json.Field("evicted", static_cast<unsigned long long>(cache.evicted));
+        json.Field("entries", static_cast<unsigned long long>(cache.entries));
+        json.Field("bytes", static_cast<unsigned long long>(cache.bytes));
+        json.Field("in_flight", cache.in_flight);
+        json.EndObject();
+
+        json.Key("devices");
+        json.BeginArray();
+        for (const DeviceSnapshot& device : devices) {
+            json.BeginObject();
+            json.Field("name", device.name);
+            json.Field("requests", static_cast<unsigned long long>(device.requests));
+            json.Field("rejected", static_cast<unsigned long long>(device.rejected));
+            json.Field("shared", static_cast<unsigned long long>(device.shared));
+            json.Field("active", device.active);
+            json.Field("tokens_today", static_cast<unsigned long long>(device.tokens_today));
+            json.Field("tokens_total", static_cast<unsigned long long>(device.tokens_total));
+            json.Field("tokens_saved", static_cast<unsigned long long>(device.tokens_saved));
+            json.Field("daily_tokens", device.quota.daily_tokens);
+            json.Field("requests_per_minute", device.quota.requests_per_minute);
+            json.Field("concurrency", device.quota.concurrency);
+            json.Field("last_seen", static_cast<long long>(device.last_seen));
+            json.EndObject();
+        }
+        json.EndArray();
+        json.EndObject();
+    }, 2);
+
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\n";
+    response += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    return client.WriteAll(response + body) && keep_alive;
+}
+
+} // namespace EvoSpark
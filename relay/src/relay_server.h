@@ -0,0 +1,119 @@
+#ifndef RELAY_SERVER_H
+#define RELAY_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include "device_registry.h"
+#include "http_message.h"
+#include "response_cache.h"
+#include "upstream_pool.h"
+
+namespace EvoSpark {
+
+struct RelayOptions {
+    std::string listen_host = "0.0.0.0";
+    int port = 8080;
+
+    std::string upstream_url = "https://open.bigmodel.cn/api/paas/v4";   // 与 LLMClient 默认的 base_url_ 相同
+    std::string upstream_key;          // 上游 API 密钥（设备不再持有）
+    UpstreamOptions upstream;
+
+    std::string devices_file;          // 空为开放模式
+    DeviceQuota default_quota;
+
+    int cache_ttl_s = 300;             // 0 为不缓存（仍合并同时发出的相同请求）
+    size_t cache_bytes = 64 << 20;
+    bool coalesce = true;
+
+    size_t max_body = 4 << 20;         // 设备请求体上限（图片请求是 base64）
+    int client_idle_ms = 60000;        // 设备 keep-alive 连接空闲超时
+    int max_clients = 2048;
+};
+
+struct RelayStats {
+    uint64_t connections = 0;
+    uint32_t clients = 0;              // 当前连接着的设备连接
+    uint64_t requests = 0;
+    uint64_t rejected = 0;             // 401 和 429
+    uint64_t upstream_errors = 0;      // 502 / 504 或流中途断开
+    uint64_t tokens_upstream = 0;      // 上游实际消耗
+    uint64_t tokens_saved = 0;         // 缓存和合并省下的
+};
+
+// 设备到 LLM 后端的中继
+//
+// 对设备暴露和上游相同的 OpenAI 兼容接口：设备把 base_url 设为
+// http://<中继>:<端口>/v1，/v1/xxx 转发到上游 base URL + /xxx。局域网内
+// 用明文 keep-alive HTTP，省掉每台设备各自的 TLS 握手和内存；设备的
+// Authorization 只用于识别设备和配额，转发时换成上游密钥。
+//
+// 每个设备连接一个线程（局域网里几百台设备，线程足够便宜，流式响应
+// 也不用写状态机）。另外提供：
+//   GET /relay/stats   统计（JSON）
+//   GET /healthz       存活检查
+class RelayServer {
+public:
+    explicit RelayServer(const RelayOptions& options);
+    ~RelayServer();
+
+    RelayServer(const RelayServer&) = delete;
+    RelayServer& operator=(const RelayServer&) = delete;
+
+    // 加载设备表、监听端口；失败写 error
+    bool Start(std::string& error);
+
+    // 接受连接直到 Stop，并等所有设备连接的线程退出后返回
+    void Run();
+    // 停止接受连接并断开已连接的设备（任意线程）
+    void Stop();
+
+    RelayStats GetStats() const;
+
+private:
+    void ServeClient(int fd, const std::string& peer);
+
+    // 处理一个请求；返回连接能否继续复用
+    bool HandleRequest(Stream& client, const HttpRequest& request, const std::string& peer);
+    bool Proxy(Stream& client, const HttpRequest& request);
+
+    // 领头请求：请求上游，写入 flight，同时直接回给自己的设备；返回上游消耗的 token
+    bool FetchUpstream(Stream& client, const HttpRequest& request, const std::shared_ptr<Flight>& flight,
+                       const char* cache_state, bool store, uint64_t& tokens);
+
+    // 跟随者和缓存命中：从 flight 读出回给设备
+    bool Replay(Stream& client, const std::shared_ptr<Flight>& flight, const char* cache_state);
+
+    bool SendStats(Stream& client, bool keep_alive);
+
+    RelayOptions options_;
+    std::unique_ptr<UpstreamPool> upstream_;
+    DeviceRegistry registry_;
+    ResponseCache cache_;
+
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    int64_t start_us_ = 0;
+
+    // 连接线程是分离的：Stop 按 client_fds_ 断开连接，Run 等 clients_ 归零才返回，
+    // 之后才能析构本对象。clients_ 在 clients_mutex_ 下递减
+    std::mutex clients_mutex_;
+    std::condition_variable clients_done_;
+    std::unordered_set<int> client_fds_;
+
+    std::atomic<uint64_t> connections_{0};
+    std::atomic<uint32_t> clients_{0};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> upstream_errors_{0};
+    std::atomic<uint64_t> tokens_upstream_{0};
+    std::atomic<uint64_t> tokens_saved_{0};
+};
+
+} // namespace EvoSpark
+
+#endif // RELAY_SERVER_H
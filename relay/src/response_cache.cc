@@ -0,0 +1,220 @@
+#include "response_cache.h"
+#include "relay_log.h"
+#include <algorithm>
+#include <openssl/evp.h>
+
+namespace EvoSpark {
+
+static const char* TAG = "ResponseCache";
+
+// ==================== Flight ====================
+
+void Flight::SetHead(int status, const std::string& content_type, const std::string& retry_after,
+                     bool streaming, bool cacheable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_.status = status;
+    head_.content_type = content_type;
+    head_.retry_after = retry_after;
+    head_.streaming = streaming;
+    cacheable_ = cacheable;
+    head_ready_ = true;
+    changed_.notify_all();
+}
+
+void Flight::Append(const char* data, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_.append(data, length);
+    changed_.notify_all();
+}
+
+void Flight::Finish(bool complete, uint64_t tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    complete_ = complete;
+    tokens_ = tokens;
+    changed_.notify_all();
+}
+
+bool Flight::WaitHead(Head& head) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return head_ready_ || done_; });
+    if (!head_ready_) {
+        return false;
+    }
+    head = head_;
+    return true;
+}
+
+void Flight::WaitData(size_t offset, std::string& data, bool& finished, bool& complete) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this, offset] { return body_.size() > offset || done_; });
+    data.assign(body_, std::min(offset, body_.size()), std::string::npos);
+    finished = done_;
+    complete = complete_;
+}
+
+bool Flight::Cacheable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_ && complete_ && cacheable_ && head_.status == 200;
+}
+
+uint64_t Flight::Tokens() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tokens_;
+}
+
+size_t Flight::Bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return body_.size() + head_.content_type.size();
+}
+
+// ==================== ResponseCache ====================
+
+const char* ResponseCache::RoleToString(Role role) {
+    switch (role) {
+        case Role::LEADER: return "MISS";
+        case Role::FOLLOWER: return "COALESCED";
+        case Role::HIT: return "HIT";
+        case Role::BYPASS: return "BYPASS";
+        default: return "UNKNOWN";
+    }
+}
+
+std::string ResponseCache::MakeKey(const std::string& method, const std::string& path,
+                                   const std::string& content_encoding, const std::string& body) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    // 字段之间用换行分隔（方法、路径和编码里都不会出现换行）
+    EVP_DigestUpdate(ctx, method.data(), method.size());
+    EVP_DigestUpdate(ctx, "\n", 1);
+    EVP_DigestUpdate(ctx, path.data(), path.size());
+    EVP_DigestUpdate(ctx, "\n", 1);
+    EVP_DigestUpdate(ctx, content_encoding.data(), content_encoding.size());
+    EVP_DigestUpdate(ctx, "\n", 1);
+    EVP_DigestUpdate(ctx, body.data(), body.size());
+    EVP_DigestFinal_ex(ctx, digest, &length);
+    EVP_MD_CTX_free(ctx);
+
+    static const char HEX[] = "0123456789abcdef";
+    std::string key;
+    key.reserve(length * 2);
+    for (unsigned int i = 0; i < length; i++) {
+        key.push_back(HEX[digest[i] >> 4]);
+        key.push_back(HEX[digest[i] & 0x0F]);
+    }
+    return key;
+}
+
+std::shared_ptr<Flight> ResponseCache::Join(const std::string& key, const std::string& device,
+                                            bool shareable, Role& role) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookups++;
+
+    if (shareable) {
+        auto cached = index_.find(key);
+        if (cached != index_.end()) {
+            if (cached->second->expires_us > NowUs()) {
+                lru_.splice(lru_.begin(), lru_, cached->second);
+                stats_.hits++;
+                role = Role::HIT;
+                return cached->second->flight;
+            }
+            bytes_ -= cached->second->bytes;
+            lru_.erase(cached->second);
+            index_.erase(cached);
+        }
+
+        if (coalesce_) {
+            auto running = in_flight_.find(key);
+            if (running != in_flight_.end()) {
+                if (running->second->Leader() != device) {
+                    stats_.coalesced++;
+                    role = Role::FOLLOWER;
+                    return running->second;
+                }
+            } else {
+                auto flight = std::make_shared<Flight>(device);
+                in_flight_[key] = flight;
+                stats_.misses++;
+                role = Role::LEADER;
+                return flight;
+            }
+        }
+    }
+
+    stats_.bypassed++;
+    role = Role::BYPASS;
+    return std::make_shared<Flight>(device);
+}
+
+void ResponseCache::Complete(const std::string& key, const std::shared_ptr<Flight>& flight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto running = in_flight_.find(key);
+    if (running != in_flight_.end() && running->second == flight) {
+        in_flight_.erase(running);
+    }
+
+    if (ttl_us_ <= 0 || !flight->Cacheable()) {
+        return;
+    }
+    size_t bytes = flight->Bytes() + key.size() + sizeof(Entry);
+    if (bytes > max_bytes_ / 8) {
+        RELAY_LOGD(TAG, "Response too large to cache (%zu bytes)", bytes);
+        return;
+    }
+
+    auto existing = index_.find(key);
+    if (existing != index_.end()) {
+        bytes_ -= existing->second->bytes;
+        lru_.erase(existing->second);
+        index_.erase(existing);
+    }
+    Evict(bytes);
+
+    Entry entry;
+    entry.key = key;
+    entry.flight = flight;
+    entry.expires_us = NowUs() + ttl_us_;
+    entry.bytes = bytes;
+    lru_.push_front(std::move(entry));
+    index_[key] = lru_.begin();
+    bytes_ += bytes;
+    stats_.stored++;
+}
+
+void ResponseCache::Evict(size_t needed) {
+    // 放得下就不动；否则先淘汰过期的，再从最久没用的开始
+    if (bytes_ + needed <= max_bytes_) {
+        return;
+    }
+    int64_t now = NowUs();
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        if (it->expires_us <= now) {
+            bytes_ -= it->bytes;
+            index_.erase(it->key);
+            it = lru_.erase(it);
+            stats_.evicted++;
+        } else {
+            ++it;
+        }
+    }
+    while (!lru_.empty() && bytes_ + needed > max_bytes_) {
+        bytes_ -= lru_.back().bytes;
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        stats_.evicted++;
+    }
+}
+
+CacheStats ResponseCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CacheStats stats = stats_;
+    stats.entries = lru_.size();
+    stats.bytes = bytes_;
+    stats.in_flight = static_cast<uint32_t>(in_flight_.size());
+    return stats;
+}
+
+} // namespace EvoSpark
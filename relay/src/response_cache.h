@@ -0,0 +1,132 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace EvoSpark {
+
+// 一次上游请求的响应，领头请求写入，合并进来的请求边等边读
+//
+// 流式响应逐个事件追加到 body，跟随者按自己的读取位置取新增部分，
+// 和领头设备几乎同时收到每个 token。完成后对象不再变化，可以直接
+// 放进缓存重放。
+class Flight {
+public:
+    explicit Flight(std::string leader) : leader_(std::move(leader)) {}
+
+    const std::string& Leader() const { return leader_; }
+
+    // 领头请求：响应头到达、消息体到达、结束
+    void SetHead(int status, const std::string& content_type, const std::string& retry_after,
+                 bool streaming, bool cacheable);
+    void Append(const char* data, size_t length);
+    void Finish(bool complete, uint64_t tokens);
+
+    struct Head {
+        int status = 0;
+        std::string content_type;
+        std::string retry_after;
+        bool streaming = false;
+    };
+
+    // 等到响应头；领头请求在此之前失败返回 false
+    bool WaitHead(Head& head);
+
+    // 取 offset 之后的新数据（没有就等）；finished 为已结束，complete 为完整结束
+    void WaitData(size_t offset, std::string& data, bool& finished, bool& complete);
+
+    // 以下只在 Finish 之后读
+    bool Cacheable() const;
+    uint64_t Tokens() const;
+    size_t Bytes() const;
+
+private:
+    std::string leader_;
+    Head head_;
+    bool head_ready_ = false;
+    bool cacheable_ = false;
+    std::string body_;
+    bool done_ = false;
+    bool complete_ = false;
+    uint64_t tokens_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+struct CacheStats {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t coalesced = 0;
+    uint64_t misses = 0;
+    uint64_t bypassed = 0;        // 设备要求不用缓存，或同一设备的重复请求（对冲）
+    uint64_t stored = 0;
+    uint64_t evicted = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    uint32_t in_flight = 0;
+};
+
+// 共享响应缓存和请求合并
+//
+// 多台设备常在同一时刻发出相同的请求（同一段开机问候、整点播报、同一套
+// 系统提示词下的同一个问题）。请求按方法、路径、压缩方式和请求体做
+// SHA-256 作为键：
+//   - 缓存里有未过期的完整响应：直接重放，不请求上游（HIT）
+//   - 相同请求正在请求上游：挂到它上面，共用同一个上游响应（COALESCED）
+//   - 否则自己请求上游并登记，完成后成功的响应进缓存（MISS）
+// 同一设备发出的重复请求是 LLMClient 的对冲请求，本意是换一条连接抢先
+// 拿到首 token，合并后就失去了意义，照常单独请求上游（BYPASS）。
+// 缓存按字节数上限做 LRU 淘汰，TTL 为 0 时只合并不缓存。
+class ResponseCache {
+public:
+    ResponseCache(int ttl_s, size_t max_bytes, bool coalesce)
+        : ttl_us_(static_cast<int64_t>(ttl_s) * 1000000), max_bytes_(max_bytes), coalesce_(coalesce) {}
+
+    enum class Role { LEADER, FOLLOWER, HIT, BYPASS };
+
+    static const char* RoleToString(Role role);
+
+    // 请求键（SHA-256 十六进制）
+    static std::string MakeKey(const std::string& method, const std::string& path,
+                               const std::string& content_encoding, const std::string& body);
+
+    // 取得这个请求要读的 Flight；LEADER 和 BYPASS 需要自己请求上游并写入，
+    // 完成后调用 Complete。shareable 为 false 时（Cache-Control: no-cache）直接 BYPASS
+    std::shared_ptr<Flight> Join(const std::string& key, const std::string& device, bool shareable, Role& role);
+
+    // 领头请求结束：撤销登记，成功的响应进缓存
+    void Complete(const std::string& key, const std::shared_ptr<Flight>& flight);
+
+    CacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<Flight> flight;
+        int64_t expires_us = 0;
+        size_t bytes = 0;
+    };
+
+    void Evict(size_t needed);
+
+    int64_t ttl_us_;
+    size_t max_bytes_;
+    bool coalesce_;
+
+    std::unordered_map<std::string, std::shared_ptr<Flight>> in_flight_;
+    std::list<Entry> lru_;                                          // 最近用过的在前
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+    CacheStats stats_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace EvoSpark
+
+#endif // RESPONSE_CACHE_H
@@ -0,0 +1,229 @@
+#include "upstream_pool.h"
+#include "relay_log.h"
+#include <cstdlib>
+
+namespace EvoSpark {
+
+static const char* TAG = "UpstreamPool";
+
+bool ParseBaseUrl(const std::string& url, UpstreamTarget& target) {
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) {
+        return false;
+    }
+    std::string scheme = url.substr(0, scheme_end);
+    if (scheme == "https") {
+        target.tls = true;
+        target.port = 443;
+    } else if (scheme == "http") {
+        target.tls = false;
+        target.port = 80;
+    } else {
+        return false;
+    }
+
+    size_t host_begin = scheme_end + 3;
+    size_t path_begin = url.find('/', host_begin);
+    std::string authority = url.substr(host_begin, path_begin == std::string::npos
+                                                       ? std::string::npos : path_begin - host_begin);
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+        target.port = atoi(authority.c_str() + colon + 1);
+        authority.resize(colon);
+    }
+    if (authority.empty() || target.port <= 0 || target.port > 65535) {
+        return false;
+    }
+    target.host = authority;
+    target.base_path = path_begin == std::string::npos ? "" : url.substr(path_begin);
+    while (!target.base_path.empty() && target.base_path.back() == '/') {
+        target.base_path.pop_back();
+    }
+    return true;
+}
+
+UpstreamPool::UpstreamPool(const UpstreamTarget& target, const UpstreamOptions& options)
+    : target_(target), options_(options) {
+    bool default_port = target_.port == (target_.tls ? 443 : 80);
+    host_header_ = default_port ? target_.host : target_.host + ":" + std::to_string(target_.port);
+    tls_.SetInsecure(options_.insecure);
+}
+
+UpstreamPool::~UpstreamPool() = default;
+
+std::unique_ptr<UpstreamPool::Connection> UpstreamPool::Open(std::string& error) {
+    int fd = ConnectTcp(target_.host, target_.port, options_.connect_timeout_ms, error);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    auto connection = std::make_unique<Connection>();
+    if (target_.tls) {
+        bool resumed = false;
+        connection->stream = tls_.Handshake(fd, target_.host, options_.connect_timeout_ms, resumed, error);
+        if (!connection->stream) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.tls_handshakes++;
+        if (resumed) {
+            stats_.tls_resumed++;
+        }
+    } else {
+        connection->stream = std::make_unique<SocketStream>(fd);
+    }
+    connection->stream->SetTimeout(options_.io_timeout_ms);
+    connection->reader = std::make_unique<BufferedReader>(*connection->stream);
+    return connection;
+}
+
+std::unique_ptr<UpstreamPool::Connection> UpstreamPool::Acquire(bool fresh, bool& reused, std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool counted_wait = false;
+    while (true) {
+        // 丢掉空闲太久的连接（对端多半已经关了）
+        int64_t now = NowUs();
+        while (!idle_.empty() &&
+               now - idle_.front()->idle_since_us > static_cast<int64_t>(options_.idle_timeout_ms) * 1000) {
+            idle_.pop_front();
+            open_count_--;
+        }
+        if (fresh && !idle_.empty() && open_count_ >= options_.max_connections) {
+            // 要新连接但已到上限：关掉最旧的空闲连接腾出名额
+            idle_.pop_front();
+            open_count_--;
+        }
+        if (!fresh && !idle_.empty()) {
+            std::unique_ptr<Connection> connection = std::move(idle_.back());
+            idle_.pop_back();
+            reused = true;
+            return connection;
+        }
+        if (open_count_ < options_.max_connections) {
+            break;
+        }
+        if (!counted_wait) {
+            stats_.queued++;
+            counted_wait = true;
+        }
+        available_.wait(lock);
+    }
+
+    open_count_++;
+    lock.unlock();
+
+    reused = false;
+    std::unique_ptr<Connection> connection = Open(error);
+
+    lock.lock();
+    if (!connection) {
+        open_count_--;
+        stats_.connect_failures++;
+        available_.notify_one();
+        return nullptr;
+    }
+    stats_.connections_opened++;
+    return connection;
+}
+
+void UpstreamPool::Release(std::unique_ptr<Connection> connection, bool reusable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reusable) {
+        connection->idle_since_us = NowUs();
+        idle_.push_back(std::move(connection));
+    } else {
+        open_count_--;
+    }
+    available_.notify_one();
+}
+
+std::string UpstreamPool::BuildHead(const std::string& method, const std::string& path,
+                                    const HttpHeaders& headers, size_t body_length) const {
+    std::string head;
+    head.reserve(512);
+    head.append(method).append(" ").append(path).append(" HTTP/1.1\r\n");
+    head.append("Host: ").append(host_header_).append("\r\n");
+    for (const auto& item : headers.Items()) {
+        head.append(item.first).append(": ").append(item.second).append("\r\n");
+    }
+    if (body_length > 0 || method == "POST" || method == "PUT") {
+        head.append("Content-Length: ").append(std::to_string(body_length)).append("\r\n");
+    }
+    head.append("Connection: keep-alive\r\n\r\n");
+    return head;
+}
+
+int UpstreamPool::Exchange(const std::string& method, const std::string& path, const HttpHeaders& headers,
+                           const std::string& body, const HeadHandler& on_head, const BodySink& on_body,
+                           std::string& error) {
+    std::string head = BuildHead(method, path, headers, body.size());
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = false;
+        // 重发时一定用新连接：同一批空闲连接可能都已被对端关闭
+        std::unique_ptr<Connection> connection = Acquire(attempt > 0, reused, error);
+        if (!connection) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.requests++;
+            if (reused) {
+                stats_.reused_requests++;
+            }
+        }
+
+        // 小请求体和请求头合成一次写
+        bool sent;
+        if (body.size() <= 4096) {
+            sent = connection->stream->WriteAll(head + body);
+        } else {
+            sent = connection->stream->WriteAll(head) && connection->stream->WriteAll(body);
+        }
+
+        HttpResponseHead response;
+        if (!sent || !ReadResponseHead(*connection->reader, response, method)) {
+            Release(std::move(connection), false);
+            if (reused && attempt == 0) {
+                // 还没收到响应，对端处理不到这个请求，换新连接重发是安全的
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.stale_retries++;
+                RELAY_LOGD(TAG, "Stale upstream connection, retrying on a new one");
+                continue;
+            }
+            error = sent ? "no response from upstream" : "failed to send request";
+            break;
+        }
+        connection->requests++;
+
+        if (!on_head(response)) {
+            Release(std::move(connection), false);
+            error = "aborted";
+            break;
+        }
+        bool complete = ReadBody(*connection->reader, response.framing, response.content_length, on_body);
+        bool reusable = complete && response.keep_alive && connection->reader->Buffered() == 0;
+        Release(std::move(connection), reusable);
+        if (!complete) {
+            error = "upstream response truncated";
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.failures++;
+            return -1;
+        }
+        return response.status;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.failures++;
+    return -1;
+}
+
+UpstreamStats UpstreamPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    UpstreamStats stats = stats_;
+    stats.idle = static_cast<uint32_t>(idle_.size());
+    stats.active = static_cast<uint32_t>(open_count_) - stats.idle;
+    return stats;
+}
+
+} // namespace EvoSpark
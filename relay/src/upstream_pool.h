@@ -0,0 +1,105 @@
+#ifndef UPSTREAM_POOL_H
+#define UPSTREAM_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "http_message.h"
+#include "net_stream.h"
+
+namespace EvoSpark {
+
+// 上游服务地址（由 base URL 解析）
+struct UpstreamTarget {
+    bool tls = true;
+    std::string host;
+    int port = 443;
+    std::string base_path;        // 如 /api/paas/v4（不带结尾的 /）
+};
+
+// 解析 http(s)://host[:port][/path]；格式不对返回 false
+bool ParseBaseUrl(const std::string& url, UpstreamTarget& target);
+
+struct UpstreamOptions {
+    int max_connections = 32;         // 同时打开的上游连接上限，满了请求排队
+    int connect_timeout_ms = 5000;    // TCP 连接 + TLS 握手
+    int io_timeout_ms = 120000;       // 单次读写（流式响应两个事件之间）
+    int idle_timeout_ms = 30000;      // 空闲连接超过这个时间不再复用
+    bool insecure = false;            // 不校验证书
+};
+
+struct UpstreamStats {
+    uint64_t connections_opened = 0;
+    uint64_t tls_handshakes = 0;
+    uint64_t tls_resumed = 0;         // 其中会话恢复的
+    uint64_t connect_failures = 0;
+    uint64_t requests = 0;
+    uint64_t reused_requests = 0;     // 在已有连接上发出的请求
+    uint64_t stale_retries = 0;       // 复用的连接已被对端关闭，换新连接重发
+    uint64_t queued = 0;              // 因连接数到上限而排队的请求
+    uint64_t failures = 0;            // 没拿到完整响应
+    uint32_t active = 0;              // 正在使用的连接
+    uint32_t idle = 0;                // 池里空闲的连接
+};
+
+// 上游 HTTP/1.1 连接池
+//
+// 每台设备各自连 GLM 时，每个连接都要做一次 TLS 握手、各自维护空闲超时；
+// 经中继后所有设备的请求共享这里的 keep-alive 连接：连接用完放回池里，
+// 下一个请求直接复用，新建连接时用保存的会话票据恢复 TLS。连接总数有
+// 上限，超过时请求排队等待空闲连接，不会因设备数增长而压垮上游。
+class UpstreamPool {
+public:
+    UpstreamPool(const UpstreamTarget& target, const UpstreamOptions& options);
+    ~UpstreamPool();
+
+    UpstreamPool(const UpstreamPool&) = delete;
+    UpstreamPool& operator=(const UpstreamPool&) = delete;
+
+    // 响应头到达（返回 false 中止）
+    using HeadHandler = std::function<bool(const HttpResponseHead& head)>;
+
+    // 发一个请求并读完响应。headers 不含 Host、Content-Length 和连接相关的头，
+    // 由这里补上。复用的连接在收到任何响应前失败时换新连接重发一次
+    // （对端在空闲超时后关闭连接的正常情况）。返回状态码，失败返回 -1。
+    int Exchange(const std::string& method, const std::string& path, const HttpHeaders& headers,
+                 const std::string& body, const HeadHandler& on_head, const BodySink& on_body,
+                 std::string& error);
+
+    const UpstreamTarget& Target() const { return target_; }
+    UpstreamStats GetStats() const;
+
+private:
+    struct Connection {
+        std::unique_ptr<Stream> stream;
+        std::unique_ptr<BufferedReader> reader;
+        int64_t idle_since_us = 0;
+        uint32_t requests = 0;
+    };
+
+    // 取一条连接（fresh 为 false 时优先复用空闲的）；reused 表示是池里的旧连接
+    std::unique_ptr<Connection> Acquire(bool fresh, bool& reused, std::string& error);
+    void Release(std::unique_ptr<Connection> connection, bool reusable);
+    std::unique_ptr<Connection> Open(std::string& error);
+
+    std::string BuildHead(const std::string& method, const std::string& path,
+                          const HttpHeaders& headers, size_t body_length) const;
+
+    UpstreamTarget target_;
+    UpstreamOptions options_;
+    std::string host_header_;
+    TlsClient tls_;
+
+    std::deque<std::unique_ptr<Connection>> idle_;   // 后放回的在后面（先取最近用过的）
+    int open_count_ = 0;                             // 已打开的（空闲 + 使用中 + 正在建立）
+    UpstreamStats stats_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+} // namespace EvoSpark
+
+#endif // UPSTREAM_POOL_H
@@ -0,0 +1,349 @@
+// 模拟一批设备压测中继（或直连上游做对照）
+//
+// 每台设备一个线程、一条 keep-alive 连接，循环：思考 --think-ms（0.5～1.5
+// 倍随机）→ 发一次聊天请求 → 读完响应。--shared 比例的请求从 --prompts
+// 条公共问题里抽（多台设备问同样的问题），其余每次都不同。前 --greedy
+// 台设备不思考、连续发请求，用来观察配额是否挡住它们而不影响其他设备。
+// 收到 429 时按 Retry-After 等待。
+//
+// 结束后输出首字节和整轮延迟的 p50/p95/p99、状态码、X-Relay-Cache 分布；
+// --mock 指定模拟上游时，输出压测前后上游连接数和请求数的差值。
+
+#include "http_message.h"
+#include "json_codec.h"
+#include "net_stream.h"
+#include "relay_log.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace EvoSpark;
+
+namespace {
+
+struct LoadOptions {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string path = "/v1/chat/completions";
+    int devices = 300;
+    int duration_s = 60;
+    int think_ms = 5000;
+    double shared = 0.3;
+    int prompts = 20;
+    int greedy = 5;
+    bool stream = true;
+    std::string mock;               // host:port
+};
+
+LoadOptions g_options;
+
+struct DeviceResult {
+    std::vector<double> ttfb_ms;    // 200 响应的首字节
+    std::vector<double> total_ms;   // 200 响应的整轮
+    std::map<int, uint64_t> statuses;
+    std::map<std::string, uint64_t> cache;
+    uint64_t failures = 0;          // 连接失败或响应不完整
+    uint64_t connects = 0;
+    bool greedy = false;
+};
+
+bool SplitHostPort(const std::string& text, std::string& host, int& port) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    host = text.substr(0, colon);
+    port = atoi(text.c_str() + colon + 1);
+    return !host.empty() && port > 0;
+}
+
+std::string BuildBody(int device, int turn, std::mt19937& rng) {
+    std::string question;
+    if (std::uniform_real_distribution<double>(0, 1)(rng) < g_options.shared) {
+        int k = std::uniform_int_distribution<int>(0, g_options.prompts - 1)(rng);
+        question = "公共问题 " + std::to_string(k) + "：今天适合出门吗？";
+    } else {
+        question = "设备 " + std::to_string(device) + " 的第 " + std::to_string(turn) + " 个问题";
+    }
+    std::string body;
+    JsonWriteTo(body, [&](auto& w) {
+        w.BeginObject();
+        w.Field("model", "glm-4-flash");
+        w.Key("messages");
+        w.BeginArray();
+        w.BeginObject();
+        w.Field("role", "system");
+        w.Field("content", "你是 EvoSpark，一个住在桌面上的小机器人。回答简短、口语化。");
+        w.EndObject();
+        w.BeginObject();
+        w.Field("role", "user");
+        w.Field("content", question);
+        w.EndObject();
+        w.EndArray();
+        w.Field("stream", g_options.stream);
+        w.EndObject();
+    });
+    return body;
+}
+
+// 一次 GET，返回响应体（失败返回空）
+std::string HttpGet(const std::string& host, int port, const std::string& path) {
+    std::string error;
+    int fd = ConnectTcp(host, port, 3000, error);
+    if (fd < 0) {
+        return "";
+    }
+    SocketStream stream(fd);
+    stream.SetTimeout(5000);
+    if (!stream.WriteAll("GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n")) {
+        return "";
+    }
+    BufferedReader reader(stream);
+    HttpResponseHead head;
+    std::string body;
+    if (!ReadResponseHead(reader, head, "GET") || head.status != 200 ||
+        !ReadBody(reader, head.framing, head.content_length, [&](const char* data, size_t length) {
+            body.append(data, length);
+            return true;
+        })) {
+        return "";
+    }
+    return body;
+}
+
+double Number(const std::string& json, const char* key) {
+    JsonFieldReader fields;
+    double value = 0;
+    if (fields.Parse(json.data(), json.size())) {
+        fields.GetNumber(key, value);
+    }
+    return value;
+}
+
+void RunDevice(int index, int64_t deadline_us, DeviceResult& result) {
+    std::mt19937 rng(static_cast<uint32_t>(index) * 7919u + 17u);
+    result.greedy = index < g_options.greedy;
+    char token[32];
+    snprintf(token, sizeof(token), "device-%03d", index);
+
+    auto think = [&](double scale) {
+        if (result.greedy) {
+            return;
+        }
+        int ms = static_cast<int>(g_options.think_ms * scale);
+        int64_t wake = std::min(NowUs() + static_cast<int64_t>(ms) * 1000, deadline_us);
+        while (NowUs() < wake) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min<int64_t>(200, (wake - NowUs()) / 1000 + 1)));
+        }
+    };
+    // 错开开始时间
+    think(std::uniform_real_distribution<double>(0, 1)(rng));
+
+    std::unique_ptr<SocketStream> stream;
+    std::unique_ptr<BufferedReader> reader;
+    for (int turn = 0; NowUs() < deadline_us; turn++) {
+        if (!stream) {
+            std::string error;
+            int fd = ConnectTcp(g_options.host, g_options.port, 5000, error);
+            if (fd < 0) {
+                result.failures++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                continue;
+            }
+            result.connects++;
+            stream = std::make_unique<SocketStream>(fd);
+            stream->SetTimeout(60000);
+            reader = std::make_unique<BufferedReader>(*stream);
+        }
+
+        std::string body = BuildBody(index, turn, rng);
+        std::string request = "POST " + g_options.path + " HTTP/1.1\r\nHost: " + g_options.host +
+                              "\r\nAuthorization: Bearer " + token + "\r\nContent-Type: application/json\r\n" +
+                              (g_options.stream ? "Accept: text/event-stream\r\n" : "") +
+                              "Content-Length: " + std::to_string(body.size()) +
+                              "\r\nConnection: keep-alive\r\n\r\n" + body;
+
+        int64_t start = NowUs();
+        int64_t first_byte = 0;
+        HttpResponseHead head;
+        bool ok = stream->WriteAll(request) && ReadResponseHead(*reader, head, "POST") &&
+                  ReadBody(*reader, head.framing, head.content_length, [&](const char*, size_t length) {
+                      if (first_byte == 0 && length > 0) {
+                          first_byte = NowUs();
+                      }
+                      return true;
+                  });
+        int64_t end = NowUs();
+        if (!ok) {
+            result.failures++;
+            stream.reset();
+            reader.reset();
+            continue;
+        }
+
+        result.statuses[head.status]++;
+        std::string cache = head.headers.Get("X-Relay-Cache");
+        if (!cache.empty()) {
+            result.cache[cache]++;
+        }
+        if (head.status == 200) {
+            result.ttfb_ms.push_back((first_byte ? first_byte - start : end - start) / 1000.0);
+            result.total_ms.push_back((end - start) / 1000.0);
+        }
+        if (!head.keep_alive) {
+            stream.reset();
+            reader.reset();
+        }
+
+        if (head.status == 429) {
+            int retry = atoi(head.headers.Get("Retry-After", "1").c_str());
+            int64_t wake = std::min<int64_t>(NowUs() + std::max(retry, 1) * 1000000LL, deadline_us);
+            while (NowUs() < wake) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        } else {
+            think(std::uniform_real_distribution<double>(0.5, 1.5)(rng));
+        }
+    }
+}
+
+double Percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    static const struct option LONG_OPTIONS[] = {
+        {"target", required_argument, nullptr, 'T'},
+        {"path", required_argument, nullptr, 'P'},
+        {"devices", required_argument, nullptr, 'n'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"think-ms", required_argument, nullptr, 't'},
+        {"shared", required_argument, nullptr, 's'},
+        {"prompts", required_argument, nullptr, 'p'},
+        {"greedy", required_argument, nullptr, 'g'},
+        {"no-stream", no_argument, nullptr, 'N'},
+        {"mock", required_argument, nullptr, 'm'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'T':
+                if (!SplitHostPort(optarg, g_options.host, g_options.port)) {
+                    fprintf(stderr, "bad --target %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'P': g_options.path = optarg; break;
+            case 'n': g_options.devices = std::max(1, atoi(optarg)); break;
+            case 'd': g_options.duration_s = std::max(1, atoi(optarg)); break;
+            case 't': g_options.think_ms = atoi(optarg); break;
+            case 's': g_options.shared = atof(optarg); break;
+            case 'p': g_options.prompts = std::max(1, atoi(optarg)); break;
+            case 'g': g_options.greedy = atoi(optarg); break;
+            case 'N': g_options.stream = false; break;
+            case 'm': g_options.mock = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [--target HOST:PORT] [--path P] [--devices N] [--duration S]\n"
+                                "          [--think-ms N] [--shared F] [--prompts N] [--greedy N] [--no-stream]\n"
+                                "          [--mock HOST:PORT]\n", argv[0]);
+                return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::string mock_host;
+    int mock_port = 0;
+    std::string mock_before;
+    if (!g_options.mock.empty()) {
+        SplitHostPort(g_options.mock, mock_host, mock_port);
+        mock_before = HttpGet(mock_host, mock_port, "/stats");
+    }
+
+    printf("%d devices (%d greedy) -> %s:%d%s for %d s, think %d ms, %.0f%% shared prompts from %d\n",
+           g_options.devices, g_options.greedy, g_options.host.c_str(), g_options.port, g_options.path.c_str(),
+           g_options.duration_s, g_options.think_ms, g_options.shared * 100, g_options.prompts);
+    fflush(stdout);
+
+    std::vector<DeviceResult> results(g_options.devices);
+    std::vector<std::thread> threads;
+    int64_t deadline = NowUs() + static_cast<int64_t>(g_options.duration_s) * 1000000;
+    for (int i = 0; i < g_options.devices; i++) {
+        threads.emplace_back(RunDevice, i, deadline, std::ref(results[i]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // 汇总
+    std::vector<double> ttfb;
+    std::vector<double> total;
+    std::map<int, uint64_t> statuses;
+    std::map<std::string, uint64_t> cache;
+    uint64_t failures = 0;
+    uint64_t connects = 0;
+    uint64_t greedy_ok = 0, greedy_429 = 0, normal_ok = 0, normal_429 = 0;
+    for (DeviceResult& r : results) {
+        ttfb.insert(ttfb.end(), r.ttfb_ms.begin(), r.ttfb_ms.end());
+        total.insert(total.end(), r.total_ms.begin(), r.total_ms.end());
+        for (const auto& s : r.statuses) {
+            statuses[s.first] += s.second;
+        }
+        for (const auto& c : r.cache) {
+            cache[c.first] += c.second;
+        }
+        failures += r.failures;
+        connects += r.connects;
+        (r.greedy ? greedy_ok : normal_ok) += r.statuses[200];
+        (r.greedy ? greedy_429 : normal_429) += r.statuses[429];
+    }
+
+    uint64_t requests = failures;
+    printf("status:");
+    for (const auto& s : statuses) {
+        printf(" %d=%llu", s.first, static_cast<unsigned long long>(s.second));
+        requests += s.second;
+    }
+    printf(", failed=%llu, device connections=%llu\n", static_cast<unsigned long long>(failures),
+           static_cast<unsigned long long>(connects));
+    printf("throughput: %.1f req/s\n", static_cast<double>(requests) / g_options.duration_s);
+    if (!cache.empty()) {
+        printf("relay cache:");
+        for (const auto& c : cache) {
+            printf(" %s=%llu", c.first.c_str(), static_cast<unsigned long long>(c.second));
+        }
+        printf("\n");
+    }
+    printf("first byte ms: p50 %.0f  p95 %.0f  p99 %.0f\n", Percentile(ttfb, 0.50), Percentile(ttfb, 0.95),
+           Percentile(ttfb, 0.99));
+    printf("full reply ms: p50 %.0f  p95 %.0f  p99 %.0f\n", Percentile(total, 0.50), Percentile(total, 0.95),
+           Percentile(total, 0.99));
+    if (g_options.greedy > 0) {
+        printf("greedy devices: %llu ok / %llu throttled; others: %llu ok / %llu throttled\n",
+               static_cast<unsigned long long>(greedy_ok), static_cast<unsigned long long>(greedy_429),
+               static_cast<unsigned long long>(normal_ok), static_cast<unsigned long long>(normal_429));
+    }
+
+    if (!mock_before.empty()) {
+        std::string after = HttpGet(mock_host, mock_port, "/stats");
+        printf("upstream: +%.0f connections, +%.0f requests, +%.0f tokens, peak %.0f concurrent during the run\n",
+               Number(after, "connections") - Number(mock_before, "connections"),
+               Number(after, "requests") - Number(mock_before, "requests"),
+               Number(after, "tokens") - Number(mock_before, "tokens"), Number(after, "peak_active"));
+    }
+    return 0;
+}
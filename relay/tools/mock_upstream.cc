@@ -0,0 +1,312 @@
+// 模拟 OpenAI 兼容的 LLM 上游，给中继做压测用
+//
+//   POST .../chat/completions   按请求体哈希生成固定的回复（同样的请求同样的回复），
+//                               stream 为 true 时按 SSE 分块发出，最后一个事件带 usage
+//   GET  /stats                 连接数、请求数、上次查询以来的并发峰值
+//
+// 延迟：首 token 等 --ttft-ms ± --jitter-ms，之后每块间隔 --chunk-ms；
+// --handshake-ms 为每个新连接额外的等待，模拟 TLS 握手；--error-rate
+// 按比例返回 503；空闲超过 --idle-ms 的连接由服务端关闭（和真实上游一样）。
+
+#include "http_message.h"
+#include "json_codec.h"
+#include "net_stream.h"
+#include "relay_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace EvoSpark;
+
+static const char* TAG = "MockUpstream";
+
+namespace {
+
+struct MockOptions {
+    int port = 9000;
+    int ttft_ms = 400;
+    int jitter_ms = 100;
+    int chunks = 20;
+    int chunk_ms = 20;
+    int handshake_ms = 0;
+    int idle_ms = 15000;
+    double error_rate = 0;
+    std::string key;            // 非空时检查 Authorization
+};
+
+MockOptions g_options;
+std::atomic<uint64_t> g_connections{0};
+std::atomic<uint64_t> g_requests{0};
+std::atomic<uint64_t> g_errors{0};
+std::atomic<uint64_t> g_tokens{0};
+std::atomic<int> g_active{0};
+std::atomic<int> g_peak_active{0};
+
+uint64_t Fnv1a(const std::string& data) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void SleepMs(int ms) {
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+bool SendJson(Stream& client, int status, const std::string& body) {
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + ReasonPhrase(status) +
+                           "\r\nContent-Type: application/json\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\nConnection: keep-alive\r\n\r\n";
+    return client.WriteAll(response + body);
+}
+
+std::string ChunkJson(const std::string& id, const std::string& content, const char* finish,
+                      int prompt_tokens, int completion_tokens) {
+    std::string json;
+    JsonWriteTo(json, [&](auto& w) {
+        w.BeginObject();
+        w.Field("id", id);
+        w.Field("object", "chat.completion.chunk");
+        w.Field("model", "mock");
+        w.Key("choices");
+        w.BeginArray();
+        w.BeginObject();
+        w.Field("index", 0);
+        w.Key("delta");
+        w.BeginObject();
+        if (!content.empty()) {
+            w.Field("content", content);
+        }
+        w.EndObject();
+        if (finish) {
+            w.Field("finish_reason", finish);
+        }
+        w.EndObject();
+        w.EndArray();
+        if (finish) {
+            w.Key("usage");
+            w.BeginObject();
+            w.Field("prompt_tokens", prompt_tokens);
+            w.Field("completion_tokens", completion_tokens);
+            w.Field("total_tokens", prompt_tokens + completion_tokens);
+            w.EndObject();
+        }
+        w.EndObject();
+    });
+    return json;
+}
+
+bool HandleCompletion(Stream& client, const HttpRequest& request, std::mt19937& rng) {
+    if (!g_options.key.empty() && request.headers.Get("Authorization") != "Bearer " + g_options.key) {
+        return SendJson(client, 401, "{\"error\":{\"message\":\"bad key\",\"type\":\"invalid_api_key\"}}");
+    }
+    if (!request.headers.Get("Content-Encoding").empty()) {
+        return SendJson(client, 415, "{\"error\":{\"message\":\"encoded body\",\"type\":\"invalid_request_error\"}}");
+    }
+    JsonFieldReader fields;
+    bool stream = false;
+    if (!fields.Parse(request.body.data(), request.body.size())) {
+        return SendJson(client, 400, "{\"error\":{\"message\":\"bad json\",\"type\":\"invalid_request_error\"}}");
+    }
+    fields.GetBool("stream", stream);
+
+    int jitter = g_options.jitter_ms > 0
+                     ? std::uniform_int_distribution<int>(-g_options.jitter_ms, g_options.jitter_ms)(rng) : 0;
+    SleepMs(std::max(0, g_options.ttft_ms + jitter));
+
+    if (std::uniform_real_distribution<double>(0, 1)(rng) < g_options.error_rate) {
+        g_errors++;
+        return SendJson(client, 503, "{\"error\":{\"message\":\"overloaded\",\"type\":\"server_error\"}}");
+    }
+
+    // 回复由请求体决定：相同请求得到相同回复，方便核对合并和缓存
+    char id[24];
+    snprintf(id, sizeof(id), "mock-%016llx", static_cast<unsigned long long>(Fnv1a(request.body)));
+    int prompt_tokens = static_cast<int>(request.body.size() / 4);
+    int completion_tokens = g_options.chunks;
+    g_tokens += prompt_tokens + completion_tokens;
+
+    if (!stream) {
+        std::string content;
+        for (int i = 0; i < g_options.chunks; i++) {
+            content += "词" + std::to_string(i);
+        }
+        SleepMs(g_options.chunk_ms * g_options.chunks);
+        std::string body;
+        JsonWriteTo(body, [&](auto& w) {
+            w.BeginObject();
+            w.Field("id", id);
+            w.Field("object", "chat.completion");
+            w.Key("choices");
+            w.BeginArray();
+            w.BeginObject();
+            w.Field("index", 0);
+            w.Key("message");
+            w.BeginObject();
+            w.Field("role", "assistant");
+            w.Field("content", content);
+            w.EndObject();
+            w.Field("finish_reason", "stop");
+            w.EndObject();
+            w.EndArray();
+            w.Key("usage");
+            w.BeginObject();
+            w.Field("prompt_tokens", prompt_tokens);
+            w.Field("completion_tokens", completion_tokens);
+            w.Field("total_tokens", prompt_tokens + completion_tokens);
+            w.EndObject();
+            w.EndObject();
+        });
+        return SendJson(client, 200, body);
+    }
+
+    if (!client.WriteAll("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                         "Transfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n")) {
+        return false;
+    }
+    for (int i = 0; i < g_options.chunks; i++) {
+        if (i > 0) {
+            SleepMs(g_options.chunk_ms);
+        }
+        bool last = i == g_options.chunks - 1;
+        std::string event = "data: " + ChunkJson(id, "词" + std::to_string(i), last ? "stop" : nullptr,
+                                                 prompt_tokens, completion_tokens) + "\n\n";
+        if (last) {
+            event += "data: [DONE]\n\n";
+        }
+        if (!WriteChunk(client, event.data(), event.size())) {
+            return false;
+        }
+    }
+    return WriteChunk(client, nullptr, 0);
+}
+
+bool HandleStats(Stream& client) {
+    int peak = g_peak_active.exchange(g_active.load());
+    std::string body;
+    JsonWriteTo(body, [peak](auto& w) {
+        w.BeginObject();
+        w.Field("connections", static_cast<unsigned long long>(g_connections.load()));
+        w.Field("requests", static_cast<unsigned long long>(g_requests.load()));
+        w.Field("errors", static_cast<unsigned long long>(g_errors.load()));
+        w.Field("tokens", static_cast<unsigned long long>(g_tokens.load()));
+        w.Field("active", g_active.load());
+        w.Field("peak_active", peak);
+        w.EndObject();
+    });
+    return SendJson(client, 200, body);
+}
+
+void ServeClient(int fd, uint32_t seed) {
+    SocketStream client(fd);
+    std::mt19937 rng(seed);
+    SleepMs(g_options.handshake_ms);
+    client.SetTimeout(g_options.idle_ms);
+    BufferedReader reader(client);
+
+    while (true) {
+        HttpRequest request;
+        int error_status = 0;
+        if (!ReadRequest(reader, request, 8 << 20, error_status)) {
+            break;
+        }
+        bool ok;
+        if (request.method == "GET" && request.target == "/stats") {
+            ok = HandleStats(client);
+        } else if (request.method == "POST" && request.target.size() >= 17 &&
+                   request.target.compare(request.target.size() - 17, 17, "/chat/completions") == 0) {
+            g_requests++;
+            int active = ++g_active;
+            int peak = g_peak_active;
+            while (active > peak && !g_peak_active.compare_exchange_weak(peak, active)) {
+            }
+            ok = HandleCompletion(client, request, rng);
+            g_active--;
+        } else {
+            ok = SendJson(client, 404, "{\"error\":{\"message\":\"not found\",\"type\":\"invalid_request_error\"}}");
+        }
+        if (!ok || !request.keep_alive) {
+            break;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    static const struct option LONG_OPTIONS[] = {
+        {"port", required_argument, nullptr, 'p'},
+        {"ttft-ms", required_argument, nullptr, 't'},
+        {"jitter-ms", required_argument, nullptr, 'j'},
+        {"chunks", required_argument, nullptr, 'c'},
+        {"chunk-ms", required_argument, nullptr, 'i'},
+        {"handshake-ms", required_argument, nullptr, 's'},
+        {"idle-ms", required_argument, nullptr, 'l'},
+        {"error-rate", required_argument, nullptr, 'e'},
+        {"key", required_argument, nullptr, 'k'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", LONG_OPTIONS, nullptr)) != -1) {
+        switch (opt) {
+            case 'p': g_options.port = atoi(optarg); break;
+            case 't': g_options.ttft_ms = atoi(optarg); break;
+            case 'j': g_options.jitter_ms = atoi(optarg); break;
+            case 'c': g_options.chunks = std::max(1, atoi(optarg)); break;
+            case 'i': g_options.chunk_ms = atoi(optarg); break;
+            case 's': g_options.handshake_ms = atoi(optarg); break;
+            case 'l': g_options.idle_ms = atoi(optarg); break;
+            case 'e': g_options.error_rate = atof(optarg); break;
+            case 'k': g_options.key = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [--port N] [--ttft-ms N] [--jitter-ms N] [--chunks N] [--chunk-ms N]\n"
+                                "          [--handshake-ms N] [--idle-ms N] [--error-rate F] [--key KEY]\n", argv[0]);
+                return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(g_options.port));
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, 1024) != 0) {
+        RELAY_LOGE(TAG, "listen on port %d: %s", g_options.port, strerror(errno));
+        return 1;
+    }
+    RELAY_LOGI(TAG, "Listening on port %d (ttft %d±%d ms, %d chunks every %d ms, handshake %d ms, errors %.1f%%)",
+               g_options.port, g_options.ttft_ms, g_options.jitter_ms, g_options.chunks, g_options.chunk_ms,
+               g_options.handshake_ms, g_options.error_rate * 100);
+
+    std::random_device seeds;
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            RELAY_LOGE(TAG, "accept: %s", strerror(errno));
+            return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        g_connections++;
+        std::thread(ServeClient, fd, seeds()).detach();
+    }
+}